@@ -22,6 +22,8 @@
 #include "mpp.h"
 #include "lsp_channels.h"
 #include "gossip_store.h"
+#include "gossip_log.h"
+#include "rgs_server.h"
 #include "fee_estimator.h"
 #include "pathfind.h"
 #include "wallet_source.h"
@@ -41,6 +43,8 @@ typedef struct {
     payment_table_t        *payments;
     bolt11_invoice_table_t *invoices;
     gossip_store_t         *gossip;
+    gossip_log_t           *gossip_log;         /* binary gossip log; preferred for exportrgs */
+    rgs_server_t           *rgs_server;         /* cached RGS snapshots/deltas; preferred over both */
     htlc_forward_table_t   *fwd;
     mpp_table_t            *mpp;
     fee_estimator_t        *fee_est;
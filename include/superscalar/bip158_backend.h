@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 /*
  * BIP 157/158 compact block filter light client backend.
@@ -57,9 +58,16 @@ typedef struct {
 typedef struct {
     chain_backend_t  base;   /* Must be first — cast-compatible              */
 
-    /* Script registry */
+    /* Script registry.  register_script may be called from any thread,
+       including while a scan runs, so both are guarded by scripts_lock. */
     bip158_script_t  scripts[BIP158_MAX_SCRIPTS];
     size_t           n_scripts;
+    pthread_mutex_t  scripts_lock;
+
+    /* Per-scan scratch for bip158_scan_filter(): query hashes + sort buffer
+       (2 * n_scripts values).  Grown on demand, freed by bip158_backend_free(). */
+    uint64_t        *match_scratch;
+    size_t           match_scratch_cap;
 
     /* Confirmed tx cache: populated when a filter match triggers a full-block
        download and the committing tx is found inside */
@@ -324,6 +332,22 @@ int bip158_backend_connect_p2p(bip158_backend_t *backend,
  */
 int bip158_backend_scan(bip158_backend_t *backend);
 
+/*
+ * P2P half of bip158_backend_scan(): scan heights [start, tip] using every
+ * connected peer.  getcfilters requests are spread across peers, filter
+ * header validation and GCS matching run on a worker pool while later
+ * batches download, and filter-hit blocks are fetched with pipelined
+ * getdata.  The range goes in segments, each matched against the scripts
+ * registered when it starts.  A segment's heights are committed strictly
+ * in order on the calling thread once its threads have exited, so
+ * tip_height, block_connected_cb and the UTXO callbacks behave exactly as
+ * in a serial scan.  A peer that fails or serves a filter not matching
+ * the synced filter-header chain is closed and its work reassigned.
+ * header_hashes must cover [start, tip].  Stops at the first height no peer
+ * could serve.  Returns the number of matched blocks.
+ */
+int bip158_scan_p2p_range(bip158_backend_t *backend, int start, int tip);
+
 /*
  * Low-level GCS helpers — exposed for unit testing.
  *
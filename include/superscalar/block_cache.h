@@ -0,0 +1,135 @@
+#ifndef SUPERSCALAR_BLOCK_CACHE_H
+#define SUPERSCALAR_BLOCK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * Bounded in-process LRU of parsed blocks, keyed by block hash.
+ *
+ * Confirmation scans, the chain event bus and BIP 158 filter matches all
+ * look at the same handful of recent blocks.  Each block is downloaded and
+ * parsed once into its txid list, the outpoints it spends and the outputs
+ * it creates; later consumers read the parsed form from here.
+ *
+ * Keyed by hash, so a reorged-out block simply stops being asked for;
+ * block_cache_invalidate_from() drops entries at or above a fork height
+ * eagerly so they do not occupy capacity.
+ *
+ * Thread-safe.  Lookups return a pinned entry; call block_cache_release()
+ * when done.  An entry evicted or invalidated while pinned is freed on
+ * its last release.
+ */
+
+#define BLOCK_CACHE_DEFAULT_CAPACITY  64   /* blocks kept by block_cache_shared() */
+
+/* Output created by a block tx. */
+typedef struct {
+    uint32_t tx_index;     /* index into entry->txids */
+    uint32_t vout;
+    uint64_t amount_sats;
+    uint32_t spk_off;      /* offset into entry->spk_data */
+    uint32_t spk_len;
+} block_cache_output_t;
+
+/* Outpoint spent by a block tx (coinbase inputs are not recorded). */
+typedef struct {
+    uint32_t      tx_index;      /* spending tx, index into entry->txids */
+    unsigned char prev_txid[32]; /* internal byte order */
+    uint32_t      prev_vout;
+} block_cache_spend_t;
+
+typedef struct block_cache_entry block_cache_entry_t;
+struct block_cache_entry {
+    char      hash_hex[65];    /* display order, lowercase */
+    char      prev_hash_hex[65]; /* "" when not parsed from the raw header */
+    int32_t   height;          /* -1 if unknown */
+
+    char    (*txids)[65];      /* display-order txids, block order */
+    size_t    n_tx;
+
+    /* Populated only for entries parsed from the raw block (has_io == 1);
+       entries built from a getblock verbosity-1 txid list leave them empty. */
+    int                   has_io;
+    block_cache_output_t *outputs;
+    size_t                n_outputs;
+    block_cache_spend_t  *spends;
+    size_t                n_spends;
+    unsigned char        *spk_data;
+
+    /* Internal: LRU links, pin count, detached-from-table flag. */
+    block_cache_entry_t  *lru_prev, *lru_next;
+    int                   refs;
+    int                   detached;
+};
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+    uint64_t evictions;
+    uint64_t invalidations;
+    size_t   n_entries;
+    size_t   capacity;
+} block_cache_stats_t;
+
+typedef struct {
+    pthread_mutex_t      lock;
+    size_t               capacity;
+    size_t               n_entries;
+    block_cache_entry_t *lru_head;   /* most recently used */
+    block_cache_entry_t *lru_tail;   /* eviction candidate */
+    block_cache_stats_t  stats;
+} block_cache_t;
+
+/* Initialize an empty cache holding at most capacity blocks (0 = default).
+   Returns 1 on success. */
+int  block_cache_init(block_cache_t *c, size_t capacity);
+
+/* Free every unpinned entry and the lock.  Pinned entries must be released
+   before calling. */
+void block_cache_free(block_cache_t *c);
+
+/* Process-wide cache shared by regtest, the chain backends and the chain
+   event bus.  Created on first use with BLOCK_CACHE_DEFAULT_CAPACITY. */
+block_cache_t *block_cache_shared(void);
+
+/* Look up a block by display-order hex hash.  Returns a pinned entry (hit)
+   or NULL (miss). */
+block_cache_entry_t *block_cache_get(block_cache_t *c, const char *hash_hex);
+
+/* Parse a raw serialized block and insert it, replacing any txid-only entry
+   for the same hash.  Returns the pinned entry, or NULL on parse/alloc
+   failure.  height may be -1. */
+block_cache_entry_t *block_cache_put_raw(block_cache_t *c, const char *hash_hex,
+                                         int height,
+                                         const unsigned char *raw, size_t raw_len);
+
+/* Insert a txid-only entry (e.g. from getblock verbosity 1).  A fuller
+   entry already cached for the hash is kept.  Returns the pinned entry or
+   NULL on alloc failure. */
+block_cache_entry_t *block_cache_put_txids(block_cache_t *c, const char *hash_hex,
+                                           int height,
+                                           const char *const *txids, size_t n_tx);
+
+/* Unpin an entry returned by get / put_*.  NULL is a no-op. */
+void block_cache_release(block_cache_t *c, block_cache_entry_t *e);
+
+/* Index of txid_hex (display order, any case) in e->txids, or -1. */
+long block_cache_find_tx(const block_cache_entry_t *e, const char *txid_hex);
+
+/* Drop a single block.  Returns 1 if it was cached. */
+int  block_cache_invalidate(block_cache_t *c, const char *hash_hex);
+
+/* Drop every entry with height >= height (reorg to fork height - 1).
+   Returns the number of entries dropped. */
+size_t block_cache_invalidate_from(block_cache_t *c, int height);
+
+/* Snapshot counters. */
+void block_cache_get_stats(block_cache_t *c, block_cache_stats_t *out);
+
+/* hits / (hits + misses) as a percentage; 0 before the first lookup. */
+double block_cache_hit_rate_pct(const block_cache_stats_t *s);
+
+#endif /* SUPERSCALAR_BLOCK_CACHE_H */
@@ -116,6 +116,18 @@ struct chain_backend {
                                   const char *txid_hex_display,
                                   uint32_t vout);
 
+    /*
+     * Batched is_outpoint_unspent: unspent_out[i] receives the same
+     * 1 / 0 / -1 answer for (txids_hex_display[i], vouts[i]).  Returns 1
+     * on success.  Optional — may be NULL; callers fall back to
+     * is_outpoint_unspent per outpoint.  RPC backends answer the whole
+     * sweep in one round-trip.
+     */
+    int  (*is_outpoint_unspent_batch)(chain_backend_t *self,
+                                      const char **txids_hex_display,
+                                      const uint32_t *vouts, size_t n,
+                                      int *unspent_out);
+
     /*
      * Broadcast a raw transaction. Writes the resulting txid (64 hex chars
      * + NUL) to txid_out if non-NULL. Returns 1 on success, 0 on failure.
@@ -135,6 +147,24 @@ struct chain_backend {
     int  (*unregister_script)(chain_backend_t *self,
                               const unsigned char *spk, size_t spk_len);
 
+    /*
+     * Block hash (display-order hex, 64 chars + NUL) of the active-chain
+     * block at height.  Returns 1 on success, 0 on error.  Optional — may
+     * be NULL; the chain event bus (chain_events.h) needs it for reorg
+     * detection.
+     */
+    int  (*get_block_hash)(chain_backend_t *self, int height,
+                           char *hash_hex_out);
+
+    /*
+     * Fetch the raw serialized block for a display-order hex hash.
+     * *block_out is heap-allocated (caller frees).  Returns 1 on success.
+     * Optional — NULL for filter-based backends that only download matched
+     * blocks; chain event subscribers then see header-only events.
+     */
+    int  (*get_block)(chain_backend_t *self, const char *hash_hex,
+                      unsigned char **block_out, size_t *block_len_out);
+
     /* Optional reorg notification. When the backend detects a chain
        reorganisation (tip height decrease), it fires this callback.
        Higher layers (watchtower, channel manager) register to re-validate
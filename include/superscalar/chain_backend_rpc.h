@@ -2,6 +2,7 @@
 #define SUPERSCALAR_CHAIN_BACKEND_RPC_H
 
 #include "chain_backend.h"
+#include "rpc_client.h"
 
 /* Context for HTTP JSON-RPC chain backend (direct bitcoind connection). */
 typedef struct {
@@ -10,6 +11,7 @@ typedef struct {
     char rpcuser[128];
     char rpcpassword[128];
     char wallet[128];
+    rpc_client_t *client;   /* shared keep-alive client for host:port */
 } chain_backend_rpc_ctx_t;
 
 /* Initialize a chain_backend_t backed by HTTP JSON-RPC to bitcoind.
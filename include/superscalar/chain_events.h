@@ -0,0 +1,139 @@
+#ifndef SUPERSCALAR_CHAIN_EVENTS_H
+#define SUPERSCALAR_CHAIN_EVENTS_H
+
+#include "chain_backend.h"
+#include "block_cache.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Chain event bus on top of chain_backend_t.
+ *
+ * One poll per tick asks the backend for the tip, fetches and parses each
+ * new block exactly once, and delivers typed events to every registered
+ * subscriber, so per-block cost is one fetch rather than one per poller.
+ * Subscribers today: the standalone watchtower, and the LSP's per-block
+ * checks (CLTV deadlines, onion replay windows, LSPS1 confirmations,
+ * dispatch watchtower), polled from the daemon loop.  The daemon loop's
+ * reorg handling and the sweeper still query the backend directly.
+ *
+ * Ordering guarantees:
+ *   - BLOCK_DISCONNECTED events for a reorg are delivered first, tip down
+ *     to fork+1, then BLOCK_CONNECTED for fork+1 up to the new tip.
+ *   - Every subscriber sees an event before the next event is delivered;
+ *     subscribers are called in registration order.
+ *   - When the body is fetched, a connected block's parent hash is
+ *     checked against the previous block; a mismatch (reorg during
+ *     catch-up) stops the poll and the next poll unwinds it.
+ *
+ * Mempool events are pushed, not polled: feed chain_events_push_mempool()
+ * (or pass chain_events_mempool_cb to bip158_backend_set_mempool_cb).
+ *
+ * Requires backend->get_block_height and backend->get_block_hash.  Block
+ * bodies are only fetched when a subscriber asked for them and the backend
+ * implements get_block; otherwise events are header-only (height + hash).
+ * Parsed bodies go through the shared block cache (block_cache.h), so a
+ * block already parsed by another consumer is not downloaded again, and
+ * disconnected blocks are dropped from the cache after delivery.
+ */
+
+#define CHAIN_EVENTS_MAX_SUBSCRIBERS  32
+#define CHAIN_EVENTS_REORG_DEPTH     144   /* remembered hashes for fork search */
+#define CHAIN_EVENTS_MAX_CATCHUP     144   /* blocks connected per poll */
+
+typedef enum {
+    CHAIN_EVENT_BLOCK_CONNECTED    = 1u << 0,
+    CHAIN_EVENT_BLOCK_DISCONNECTED = 1u << 1,
+    CHAIN_EVENT_MEMPOOL_TX         = 1u << 2,
+} chain_event_type_t;
+
+#define CHAIN_EVENT_ALL  (CHAIN_EVENT_BLOCK_CONNECTED | \
+                          CHAIN_EVENT_BLOCK_DISCONNECTED | \
+                          CHAIN_EVENT_MEMPOOL_TX)
+
+/* A block as delivered to subscribers.  parsed / txids are NULL when the
+   body is not available (header-only event).  Valid only during the
+   callback; pin parsed->hash_hex via block_cache_get() to keep it. */
+typedef struct {
+    int32_t                    height;
+    char                       hash_hex[65];  /* display order */
+    const block_cache_entry_t *parsed;        /* txids, outputs, spends */
+    char                     (*txids)[65];    /* == parsed->txids */
+    size_t                     n_tx;
+} chain_block_t;
+
+typedef struct {
+    chain_event_type_t   type;
+    int32_t              tip_height;   /* bus tip after this event */
+    const chain_block_t *block;        /* BLOCK_CONNECTED / _DISCONNECTED */
+    const char          *txid_hex;     /* MEMPOOL_TX (display order) */
+} chain_event_t;
+
+typedef void (*chain_event_cb_t)(const chain_event_t *ev, void *ctx);
+
+typedef struct {
+    chain_event_cb_t cb;
+    void            *ctx;
+    unsigned         mask;       /* chain_event_type_t bits */
+    int              want_body;  /* 1 = needs raw/txids on connected blocks */
+} chain_event_sub_t;
+
+typedef struct {
+    chain_backend_t  *backend;   /* not owned */
+    block_cache_t    *cache;     /* not owned; block_cache_shared() by default */
+
+    chain_event_sub_t subs[CHAIN_EVENTS_MAX_SUBSCRIBERS];
+    size_t            n_subs;
+
+    /* Active chain as seen by subscribers: hashes[h % REORG_DEPTH] holds
+       the hash delivered for height h, for h in (tip - REORG_DEPTH, tip]. */
+    int32_t           tip_height;          /* -1 until first poll */
+    char              hashes[CHAIN_EVENTS_REORG_DEPTH][65];
+    int32_t           start_height;        /* first height to deliver; -1 = tip */
+
+    /* Counters */
+    uint64_t          n_polls;
+    uint64_t          n_blocks_fetched;    /* get_block downloads (cache misses) */
+    uint64_t          n_connected;
+    uint64_t          n_disconnected;
+    uint64_t          n_mempool;
+} chain_events_t;
+
+/* Initialize the bus.  start_height < 0 starts at the current tip without
+   replaying history; otherwise blocks from start_height onward are
+   delivered (capped per poll by CHAIN_EVENTS_MAX_CATCHUP).
+   Returns 1 on success, 0 if the backend lacks get_block_height /
+   get_block_hash. */
+int  chain_events_init(chain_events_t *bus, chain_backend_t *backend,
+                        int start_height);
+
+/* Use a private block cache instead of the shared one (tests, tools that
+   want isolated hit-rate numbers).  Call before the first poll. */
+void chain_events_set_cache(chain_events_t *bus, block_cache_t *cache);
+
+/* Register a subscriber for the event types in mask.  want_body asks the
+   bus to fetch and parse block bodies for BLOCK_CONNECTED.
+   Returns 1 on success, 0 if the table is full or args are invalid. */
+int  chain_events_subscribe(chain_events_t *bus, unsigned mask,
+                             int want_body, chain_event_cb_t cb, void *ctx);
+
+/* Remove the subscriber registered with (cb, ctx).  Returns 1 if found. */
+int  chain_events_unsubscribe(chain_events_t *bus, chain_event_cb_t cb,
+                               void *ctx);
+
+/* Poll the backend once and deliver any pending events.
+   Returns the number of block events delivered (connected + disconnected),
+   0 if nothing changed, -1 on backend error. */
+int  chain_events_poll(chain_events_t *bus);
+
+/* Current tip as delivered to subscribers (-1 before the first poll).
+   Cheap: no backend call. */
+int  chain_events_tip_height(const chain_events_t *bus);
+
+/* Deliver a MEMPOOL_TX event for txid_hex (display order). */
+void chain_events_push_mempool(chain_events_t *bus, const char *txid_hex);
+
+/* Adapter with the bip158 mempool callback signature; ctx is the bus. */
+void chain_events_mempool_cb(const char *txid_hex, void *ctx);
+
+#endif /* SUPERSCALAR_CHAIN_EVENTS_H */
@@ -106,12 +106,22 @@ typedef struct {
     uint64_t local_amount;
     uint64_t remote_amount;
 
-    /* HTLCs (dynamically allocated, capacity htlcs_cap) */
+    /* HTLCs (dynamically allocated, capacity htlcs_cap), ordered by id */
     htlc_t *htlcs;
     size_t n_htlcs;
     size_t htlcs_cap;
     uint64_t next_htlc_id;
 
+    /* payment_hash -> htlc id index behind channel_find_htlc_by_hash:
+       open addressing holding id + 1 (0 = empty), built on first use and
+       rebuilt whenever htlcs / n_htlcs no longer match base / n, i.e. the
+       array was changed outside channel.c. */
+    uint64_t *htlc_hash_idx;
+    size_t htlc_hash_idx_cap;
+    size_t htlc_hash_idx_used;
+    const htlc_t *htlc_hash_idx_base;
+    size_t htlc_hash_idx_n;
+
     /* PTLCs */
     ptlc_t          *ptlcs;
     size_t           n_ptlcs;
@@ -194,6 +204,12 @@ typedef struct {
     void    *persist_db;         /* persist_t* or NULL — opaque to avoid header dep */
     uint32_t persist_channel_id; /* DB channel_id used for persist_save_revocation */
 
+    /* Expiry deadline hook (optional).  When cltv_deadlines is non-NULL,
+       channel_add_htlc() pushes each new HTLC's cltv_expiry onto it.  Set
+       via cltv_deadlines_watch(). */
+    void    *cltv_deadlines;     /* cltv_deadlines_t* or NULL */
+    uint32_t cltv_chan_idx;      /* this channel's index in cltv_deadlines */
+
     /* Latest commitment TX signature (trustless force-close).
        After each MuSig2 aggregation, the client stores the full 64-byte
        Schnorr sig so it can rebuild + broadcast the commitment TX
@@ -467,6 +483,16 @@ int channel_fulfill_htlc(channel_t *ch, uint64_t htlc_id,
 
 int channel_fail_htlc(channel_t *ch, uint64_t htlc_id);
 
+/* Active HTLC with this id, or NULL.  Binary search over the id-ordered
+   htlcs array. */
+htlc_t *channel_find_htlc(const channel_t *ch, uint64_t htlc_id);
+
+/* First active HTLC (in id order of insertion) with payment_hash in the
+   given direction, or NULL. */
+htlc_t *channel_find_htlc_by_hash(channel_t *ch,
+                                    const unsigned char *payment_hash32,
+                                    htlc_direction_t direction);
+
 /* Fail all HTLCs whose cltv_expiry <= current_height. Returns count failed. */
 int channel_check_htlc_timeouts(channel_t *ch, uint32_t current_height);
 
@@ -14,11 +14,20 @@
  * HTLC_TEMPORARY_CHANNEL_FAILURE so the sender can retry another route.
  *
  * Token-bucket rate limiter (max_htlcs_per_hour):
- *   tokens refilled once per hour up to max_htlcs_per_hour.
- *   Each accepted HTLC consumes one token.
+ *   tokens refill continuously at max_htlcs_per_hour per hour, up to
+ *   max_htlcs_per_hour; the refill is computed from the elapsed time when
+ *   the bucket is next touched.  Each accepted HTLC consumes one token.
+ *
+ * The same limits apply per peer (keyed by node id) and, when the
+ * forwarding engine names one, per outgoing channel (keyed by scid).  Both
+ * live in hash tables, so an admission check is O(1) and the number of
+ * peers is unbounded.  Entries are created on first use with the default
+ * limits; ones that were never configured explicitly are evicted by
+ * circuit_breaker_evict_idle() once idle for CIRCUIT_BREAKER_IDLE_SECS,
+ * by which time their bucket is full again and they carry no state.
  */
 
-#define CIRCUIT_BREAKER_MAX_PEERS 64
+#define CIRCUIT_BREAKER_IDLE_SECS              3600
 #define CIRCUIT_BREAKER_DEFAULT_MAX_PENDING    483  /* BOLT #2 max_accepted_htlcs */
 #define CIRCUIT_BREAKER_DEFAULT_MAX_MSAT       100000000000ULL  /* 1 BTC */
 #define CIRCUIT_BREAKER_DEFAULT_HOURLY_RATE    3600  /* 1/sec */
@@ -37,9 +46,28 @@ typedef struct {
     uint16_t      pending_htlc_count;      /* currently in-flight */
     uint64_t      pending_msat;            /* currently in-flight amount */
     uint32_t      tokens;                  /* available tokens (rate limit) */
-    uint32_t      last_refill_unix;        /* when tokens were last replenished */
+    uint32_t      last_refill_unix;        /* refill accounted up to here */
+    uint32_t      last_active_unix;        /* last check_add / settle */
+    int           configured;              /* limits set explicitly; never evicted */
 } circuit_breaker_peer_t;
 
+/* Per outgoing channel limits; same fields and rules as a peer. */
+typedef struct {
+    uint64_t      scid;
+    int           active;
+
+    uint16_t      max_pending_htlcs;
+    uint64_t      max_pending_msat;
+    uint32_t      max_htlcs_per_hour;
+
+    uint16_t      pending_htlc_count;
+    uint64_t      pending_msat;
+    uint32_t      tokens;
+    uint32_t      last_refill_unix;
+    uint32_t      last_active_unix;
+    int           configured;
+} circuit_breaker_chan_t;
+
 /*
  * Ban escalation callback: called when a peer exhausts its token bucket.
  * The handler may call peer_db_ban() or similar to block the peer.
@@ -49,8 +77,23 @@ typedef void (*circuit_breaker_ban_fn_t)(void *ctx,
                                           uint32_t duration_secs);
 
 typedef struct {
-    circuit_breaker_peer_t peers[CIRCUIT_BREAKER_MAX_PEERS];
-    int                    n_peers;
+    circuit_breaker_peer_t *peers;       /* n_peers slots used; inactive = free */
+    int                     n_peers;
+    int                     peers_cap;
+    uint32_t               *free_peers;
+    int                     n_free_peers;
+    uint32_t               *peer_idx;    /* node id -> slot + 1 */
+    size_t                  peer_idx_cap;
+    int                     n_live_peers;
+
+    circuit_breaker_chan_t *chans;       /* n_chans slots used; inactive = free */
+    int                     n_chans;
+    int                     chans_cap;
+    uint32_t               *free_chans;
+    int                     n_free_chans;
+    uint32_t               *chan_idx;    /* scid -> slot + 1 */
+    size_t                  chan_idx_cap;
+    int                     n_live_chans;
 
     /* Global defaults applied to peers with no explicit config */
     uint16_t default_max_pending_htlcs;
@@ -66,6 +109,9 @@ typedef struct {
 /* Initialise circuit_breaker_t with default limits. */
 void circuit_breaker_init(circuit_breaker_t *cb);
 
+/* Release the peer and channel tables. */
+void circuit_breaker_free(circuit_breaker_t *cb);
+
 /*
  * Configure limits for a specific peer (identified by 33-byte pubkey).
  * Creates a peer slot if it doesn't exist.
@@ -87,6 +133,26 @@ int circuit_breaker_check_add(circuit_breaker_t *cb,
                                uint64_t amount_msat,
                                uint32_t now_unix);
 
+/*
+ * Configure limits for one outgoing channel.
+ * Creates the channel entry if it doesn't exist.
+ */
+void circuit_breaker_set_channel_limits(circuit_breaker_t *cb, uint64_t scid,
+                                         uint16_t max_pending_htlcs,
+                                         uint64_t max_pending_msat,
+                                         uint32_t max_htlcs_per_hour);
+
+/*
+ * circuit_breaker_check_add() that also charges the outgoing channel
+ * out_scid (0 = peer only).  The HTLC is accepted only if both the peer
+ * and the channel are within limits.
+ */
+int circuit_breaker_check_add_ex(circuit_breaker_t *cb,
+                                  const unsigned char peer_pubkey[33],
+                                  uint64_t out_scid,
+                                  uint64_t amount_msat,
+                                  uint32_t now_unix);
+
 /*
  * Record that an HTLC was settled (fulfilled or failed) for peer_pubkey.
  * Decrements the pending count and amount.
@@ -95,12 +161,28 @@ void circuit_breaker_record_settled(circuit_breaker_t *cb,
                                      const unsigned char peer_pubkey[33],
                                      uint64_t amount_msat);
 
+/* record_settled() for an HTLC admitted with circuit_breaker_check_add_ex(). */
+void circuit_breaker_record_settled_ex(circuit_breaker_t *cb,
+                                        const unsigned char peer_pubkey[33],
+                                        uint64_t out_scid,
+                                        uint64_t amount_msat,
+                                        uint32_t now_unix);
+
 /*
  * Refill token buckets for all peers based on elapsed time.
+ * Not needed for admission (buckets refill lazily); useful before
+ * inspecting tokens directly.
  * now_unix: current UNIX timestamp.
  */
 void circuit_breaker_refill_tokens(circuit_breaker_t *cb, uint32_t now_unix);
 
+/*
+ * Drop unconfigured peer and channel entries with nothing in flight that
+ * have been idle for CIRCUIT_BREAKER_IDLE_SECS.
+ * Returns the number of entries evicted.
+ */
+int circuit_breaker_evict_idle(circuit_breaker_t *cb, uint32_t now_unix);
+
 /*
  * Query current pending count and amount for a peer.
  * Returns 1 if peer found, 0 if unknown (use defaults).
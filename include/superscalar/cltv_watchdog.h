@@ -10,6 +10,8 @@
  *   cltv_watchdog_expire  — fail all HTLCs that have already expired (wraps
  *                           channel_check_htlc_timeouts)
  *   cltv_watchdog_earliest_expiry — lowest cltv_expiry across active inbound HTLCs
+ *   cltv_deadlines_*      — node-wide min-heap of HTLC expiries, so each block
+ *                           touches only the HTLCs whose deadline it crossed
  *
  * Typical usage (called from the block-processing loop):
  *
@@ -26,6 +28,7 @@
 #define SUPERSCALAR_CLTV_WATCHDOG_H
 
 #include <stdint.h>
+#include <pthread.h>
 #include "channel.h"
 
 /* Default safety margin: 18 blocks (BOLT #2 minimum CLTV expiry delta). */
@@ -64,4 +67,83 @@ int cltv_watchdog_expire(cltv_watchdog_t *wd, uint32_t current_height);
  */
 uint32_t cltv_watchdog_earliest_expiry(const channel_t *ch);
 
+/* ---- Node-wide deadline heap ---- */
+
+/*
+ * One pending deadline.  chan indexes cltv_deadlines_t.chans; the HTLC is
+ * looked up again by id when the entry is popped.
+ */
+typedef struct {
+    uint32_t cltv_expiry;
+    uint32_t chan;
+    uint64_t htlc_id;
+} cltv_deadline_t;
+
+/*
+ * Expiry deadlines of every HTLC on the watched channels.
+ *
+ * channel_add_htlc() pushes each new HTLC onto `pending`.  When a block
+ * brings it within expiry_delta it moves to `at_risk` (reported once), and
+ * it is failed when the block height reaches its expiry.  HTLCs settled or
+ * failed in the meantime are not removed from the heaps: a popped entry is
+ * checked against the channel and dropped if that HTLC is gone.
+ *
+ * HTLCs are pushed from whichever thread adds them while blocks are
+ * processed on another, so every call takes `lock`.
+ */
+typedef struct {
+    channel_t      **chans;        /* watched channels, by index */
+    size_t           n_chans;
+    size_t           chans_cap;
+    cltv_deadline_t *pending;      /* min-heap, not yet within expiry_delta */
+    size_t           n_pending;
+    size_t           pending_cap;
+    cltv_deadline_t *at_risk;      /* min-heap, reported, awaiting expiry */
+    size_t           n_at_risk;
+    size_t           at_risk_cap;
+    uint32_t         expiry_delta;
+    uint32_t         last_height;  /* last height expired, for the reorg guard */
+    pthread_mutex_t  lock;         /* everything above */
+} cltv_deadlines_t;
+
+/* Called once for each inbound HTLC that comes within expiry_delta. */
+typedef void (*cltv_deadlines_at_risk_fn)(void *ctx, channel_t *ch,
+                                          const htlc_t *h);
+
+/* Initialize an empty set.  expiry_delta == 0 → CLTV_EXPIRY_DELTA. */
+void cltv_deadlines_init(cltv_deadlines_t *dl, uint32_t expiry_delta);
+
+/* Detach the watched channels and release the heaps, leaving dl all-zero
+   (uninitialised); an all-zero dl is left alone.  Channels must still
+   be alive. */
+void cltv_deadlines_free(cltv_deadlines_t *dl);
+
+/*
+ * Watch ch: push its active HTLCs and hook channel_add_htlc() so later ones
+ * are pushed as they are added.  HTLCs written into ch->htlcs directly
+ * after this call must be passed to cltv_deadlines_add().  Watching the
+ * same channel again is a no-op.  Returns 1 on success, 0 on error.
+ */
+int cltv_deadlines_watch(cltv_deadlines_t *dl, channel_t *ch);
+
+/* Push one HTLC of ch (which must be watched).  Returns 1 on success. */
+int cltv_deadlines_add(cltv_deadlines_t *dl, channel_t *ch,
+                       uint64_t htlc_id, uint32_t cltv_expiry);
+
+/*
+ * Pop every deadline within current_height + expiry_delta and report the
+ * inbound HTLCs among them through fn (may be NULL), called with dl
+ * locked.  Each HTLC is reported at most once.  Returns the number of
+ * inbound HTLCs reported.
+ */
+int cltv_deadlines_check(cltv_deadlines_t *dl, uint32_t current_height,
+                         cltv_deadlines_at_risk_fn fn, void *ctx);
+
+/*
+ * Fail every active HTLC, in either direction, whose cltv_expiry <=
+ * current_height.  Does nothing if current_height is below the last height
+ * seen (reorg).  Returns count of HTLCs failed.
+ */
+int cltv_deadlines_expire(cltv_deadlines_t *dl, uint32_t current_height);
+
 #endif /* SUPERSCALAR_CLTV_WATCHDOG_H */
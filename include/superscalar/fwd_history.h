@@ -11,6 +11,23 @@
  *   - Network health monitoring
  *   - Automatic rebalancing decisions
  *
+ * The last FWD_HISTORY_MAX forwards are kept verbatim in a ring.  Every
+ * settled or failed forward is also added, as it is recorded, to rollups
+ * for the channel pair, its inbound and outbound channel and the node as a
+ * whole, at three granularities: minute buckets for the last day, hour
+ * buckets for the last FWD_ROLLUP_HOUR_KEEP hours and day buckets kept
+ * indefinitely.  Statistics queries read those buckets, never the ring: a
+ * window costs one lookup per bucket of the coarsest tier that fits it,
+ * however much traffic it covers, and [0, 0] reads the all-time totals.
+ *
+ * A bucket counts toward [since, until] if it starts inside the window, so
+ * window edges resolve to the minute over the last day, to the hour over
+ * the hour tier and to the day beyond it.
+ *
+ * Buckets changed since they were last saved are flagged dirty, so
+ * persist_save_fwd_rollups() writes only those; persist_load_fwd_rollups()
+ * restores them (and the all-time totals, from the day buckets) on start.
+ *
  * Reference:
  *   CLN: forwarding.c (listforwards), plugins/bookkeeper/
  *   LND: routing/payment_lifecycle.go, lnrpc.ForwardingHistory
@@ -22,6 +39,10 @@
 
 #define FWD_HISTORY_MAX    2048   /* ring buffer size */
 
+#define FWD_ROLLUP_MINUTE_KEEP  1440   /* minute buckets kept (1 day) */
+#define FWD_ROLLUP_HOUR_KEEP    2160   /* hour buckets kept (90 days) */
+#define FWD_ROLLUP_LEVELS       3      /* minute, hour, day */
+
 typedef enum {
     FWD_STATUS_SETTLED   = 0,   /* HTLC fulfilled (fee collected) */
     FWD_STATUS_FAILED    = 1,   /* HTLC failed (no fee) */
@@ -39,17 +60,65 @@ typedef struct {
     fwd_status_t    status;
 } fwd_history_entry_t;
 
+/* Aggregated forwards: one rollup bucket, or a query result. */
+typedef struct {
+    uint64_t fee_msat;        /* settled only */
+    uint64_t in_msat;         /* settled only */
+    uint64_t out_msat;        /* settled only */
+    uint64_t n_settled;
+    uint64_t n_failed;
+} fwd_rollup_t;
+
+/* A rollup series: one channel pair, one channel side, or everything. */
+typedef struct {
+    uint64_t     scid_in;     /* 0 = any */
+    uint64_t     scid_out;    /* 0 = any */
+    fwd_rollup_t total;       /* all-time */
+} fwd_series_t;
+
+typedef struct {
+    uint32_t     series;
+    uint32_t     level;       /* 0 = minute, 1 = hour, 2 = day */
+    uint32_t     start;       /* bucket start, Unix time */
+    uint32_t     dirty;       /* changed since last saved */
+    fwd_rollup_t r;
+} fwd_bucket_t;
+
 typedef struct {
     fwd_history_entry_t entries[FWD_HISTORY_MAX];
     int   count;          /* total entries stored (wraps at FWD_HISTORY_MAX) */
     int   head;           /* next write position (ring buffer) */
     uint64_t total_settled;  /* cumulative settled count since init */
     uint64_t total_failed;   /* cumulative failed count since init */
+
+    /* Rollups; allocated on first use, released by fwd_history_free() */
+    fwd_series_t *series;
+    uint32_t      n_series;
+    uint32_t      series_cap;
+    uint32_t     *series_idx;     /* (scid_in, scid_out) -> series + 1 */
+    uint32_t      series_idx_cap;
+    fwd_bucket_t *buckets;
+    uint32_t      n_bucket_slots;
+    uint32_t      bucket_cap;
+    uint32_t     *free_buckets;
+    uint32_t      n_free_buckets;
+    uint32_t     *bucket_idx;     /* (series, level, start) -> bucket + 1 */
+    uint32_t      bucket_idx_cap;
+    uint32_t      n_buckets;
+    uint32_t     *expiry[2];      /* minute / hour buckets, creation order */
+    uint32_t      expiry_cap[2];
+    uint32_t      expiry_head[2];
+    uint32_t      expiry_len[2];
+    uint32_t      first_at;       /* oldest / newest forward rolled up */
+    uint32_t      last_at;
 } fwd_history_t;
 
 /* Initialise an empty history table. */
 void fwd_history_init(fwd_history_t *h);
 
+/* Release the rollups; the table is left empty. */
+void fwd_history_free(fwd_history_t *h);
+
 /*
  * Record a forwarding result.
  * scid_out = 0 for final-hop (local payment, not relay).
@@ -62,6 +131,24 @@ void fwd_history_add(fwd_history_t *h,
                      const unsigned char payment_hash[32],
                      fwd_status_t status);
 
+/*
+ * Aggregate forwards in [since, until] (0 = open end) for the pair
+ * (scid_in, scid_out); either scid may be 0 for "any".
+ * Returns 1 if that series has any forwards, 0 otherwise (out zeroed).
+ */
+int fwd_history_stats(const fwd_history_t *h,
+                      uint64_t scid_in, uint64_t scid_out,
+                      uint32_t since, uint32_t until,
+                      fwd_rollup_t *out);
+
+/*
+ * Failed share of forwards out through scid_out (0 = all) in
+ * [since, until], in parts per million.  0 if there were none.
+ */
+uint32_t fwd_history_failure_rate_ppm(const fwd_history_t *h,
+                                      uint64_t scid_out,
+                                      uint32_t since, uint32_t until);
+
 /*
  * Total fees earned from successful forwards in time range [since, until].
  * Pass 0 for since/until to include all entries.
@@ -104,9 +191,27 @@ uint64_t fwd_history_top_channel(const fwd_history_t *h,
                                   uint64_t *scid_out_out);
 
 /*
- * Remove all entries older than cutoff_unix.
+ * Remove all ring entries older than cutoff_unix.  Rollups are kept; they
+ * age out by tier.
  * Returns count of entries removed.
  */
 int fwd_history_prune(fwd_history_t *h, uint32_t cutoff_unix);
 
+/*
+ * Oldest bucket start still kept at level 0 (minute) or 1 (hour); older
+ * buckets of that level have been dropped.  0 for the day level.
+ */
+uint32_t fwd_history_level_cutoff(const fwd_history_t *h, uint32_t level);
+
+/*
+ * Restore a saved bucket of series (scid_in, scid_out).  Day buckets also
+ * add to the series' all-time totals.  Restore each level oldest first;
+ * a bucket already past its level's retention is skipped.
+ * Returns 1 on success (also if skipped), 0 on bad arguments or OOM.
+ */
+int fwd_history_restore_bucket(fwd_history_t *h,
+                               uint64_t scid_in, uint64_t scid_out,
+                               uint32_t level, uint32_t start,
+                               const fwd_rollup_t *r);
+
 #endif /* SUPERSCALAR_FWD_HISTORY_H */
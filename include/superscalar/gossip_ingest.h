@@ -10,9 +10,16 @@
  *   258  channel_update         — verify sig against stored node_id, store policy
  *   265  gossip_timestamp_filter — parse peer's desired gossip window
  *
- * All types validated before being written to the gossip_store.
+ * All types validated before being written to the gossip_store, and --
+ * when a gossip_log is attached (log field) -- appended to it verbatim;
+ * known channels are then looked up in the log first.  An attached
+ * rgs_server (rgs field) is fed the same way, for incremental RGS deltas,
+ * as is a gossip_query index (qidx field) for answering range queries.
+ * When a live routing graph is attached (graph field), every accepted
+ * announcement, update and closure is applied to it in place as well.
  * Rate limiting prevents spam: same key may not be updated within
- * GOSSIP_INGEST_MIN_INTERVAL seconds.
+ * GOSSIP_INGEST_MIN_INTERVAL seconds.  Gossip relayed again by other peers
+ * is answered from a bounded seen cache before any of that work.
  *
  * Reference:
  *   BOLT #7 §gossip-messages
@@ -25,6 +32,10 @@
 #include <stddef.h>
 #include <secp256k1.h>
 #include "gossip_store.h"
+#include "gossip_log.h"
+#include "rgs_server.h"
+#include "gossip_query.h"
+#include "pathfind.h"
 
 /* Ingest result codes */
 #define GOSSIP_INGEST_OK           0   /* accepted and stored */
@@ -34,6 +45,7 @@
 #define GOSSIP_INGEST_MALFORMED    4   /* message too short / cannot parse */
 #define GOSSIP_INGEST_UNKNOWN_TYPE 5   /* not a gossip message type */
 #define GOSSIP_INGEST_NO_VERIFY    6   /* ctx=NULL, stored without sig check */
+#define GOSSIP_INGEST_DUPLICATE    7   /* already seen, or not newer */
 
 /* Minimum seconds between updates for the same key (anti-spam) */
 #define GOSSIP_INGEST_MIN_INTERVAL  60
@@ -41,6 +53,29 @@
 /* Maximum entries in the rate-limit table */
 #define GOSSIP_INGEST_RATE_MAX      512
 
+/* Signature-check threads used by gossip_ingest_batch() */
+#define GOSSIP_INGEST_MAX_WORKERS   8
+
+/*
+ * Seen-gossip cache: an identical message (by SHA256) gets its earlier
+ * verdict back without re-verification, and a channel_update no newer than
+ * the last one accepted for its scid+direction is dropped as DUPLICATE.
+ * Bounded: two generations of at most GOSSIP_INGEST_SEEN_MAX / 2 entries
+ * per table; the older generation is discarded when the newer fills.
+ */
+#define GOSSIP_INGEST_SEEN_MAX      262144
+
+typedef struct {
+    uint64_t *keys;              /* 0 = empty slot */
+    uint32_t *vals;
+    size_t    n_slots;           /* power of two, 0 until first insert */
+    size_t    count;
+} gossip_ingest_seen_gen_t;
+
+typedef struct {
+    gossip_ingest_seen_gen_t gen[2];   /* [0] current, [1] previous */
+} gossip_ingest_seen_t;
+
 /* One rate-limit entry (keyed by pubkey33 or scid+dir(1)) */
 typedef struct {
     unsigned char key[34];   /* node: 33-byte pubkey; channel: 8-byte scid + 1-byte dir */
@@ -51,10 +86,17 @@ typedef struct {
 typedef struct {
     secp256k1_context    *ctx;           /* for sig verification; NULL = skip verify */
     gossip_store_t       *gs;            /* storage; NULL = verify only, no persist */
+    pathfind_graph_t     *graph;         /* live routing graph; NULL = none */
+    gossip_log_t         *log;           /* raw-message store; NULL = none */
+    rgs_server_t         *rgs;           /* RGS snapshot/delta cache; NULL = none */
+    gossip_query_index_t *qidx;          /* channel_range query index; NULL = none */
 
     gossip_ingest_rate_t  rate[GOSSIP_INGEST_RATE_MAX];
     int                   rate_count;
 
+    gossip_ingest_seen_t  seen_msg;      /* message hash -> verdict */
+    gossip_ingest_seen_t  seen_upd;      /* scid|dir -> newest timestamp */
+
     /* diagnostic counters */
     uint32_t n_channel_ann;     /* channel_announcements accepted */
     uint32_t n_node_ann;        /* node_announcements accepted */
@@ -63,6 +105,9 @@ typedef struct {
     uint32_t n_rejected_rate;   /* rejected: rate limited */
     uint32_t n_rejected_orphan; /* rejected: channel_update for unknown scid */
     uint32_t n_rejected_malformed; /* rejected: parse failure */
+    uint32_t n_rejected_dup;    /* rejected: already seen / superseded */
+    uint32_t n_seen_hit;        /* seen cache answered without verifying */
+    uint32_t n_seen_miss;       /* seen cache lookups that fell through */
 } gossip_ingest_t;
 
 /* Initialise. ctx and gs may be NULL (disables sig verification / storage). */
@@ -70,6 +115,9 @@ void gossip_ingest_init(gossip_ingest_t *gi,
                         secp256k1_context *ctx,
                         gossip_store_t    *gs);
 
+/* Release the seen-gossip cache.  gi may be re-initialised afterwards. */
+void gossip_ingest_free(gossip_ingest_t *gi);
+
 /*
  * Dispatch a raw wire message to the appropriate ingest handler.
  * msg must include the 2-byte type prefix.
@@ -116,6 +164,35 @@ int gossip_ingest_channel_update(gossip_ingest_t     *gi,
                                   size_t               msg_len,
                                   uint32_t             now_unix);
 
+/*
+ * Ingest n messages at once (initial sync, backlog from a peer or RGS).
+ * All messages are parsed and deduplicated before any signature is
+ * checked: of several channel_updates for one scid+direction, or
+ * node_announcements for one node, only the newest by timestamp is kept,
+ * and channel_announcements for channels already in the store, like anything
+ * the seen cache knows, are skipped (GOSSIP_INGEST_DUPLICATE).  The remaining signatures are checked on up to
+ * GOSSIP_INGEST_MAX_WORKERS threads, then everything accepted is written to
+ * gossip_store in one transaction and applied to the live graph.
+ * A channel_update may be vouched for by an announcement anywhere in the
+ * same batch.  Otherwise verdicts are those of gossip_ingest_message().
+ * results_out (n entries, may be NULL) receives each message's result.
+ * Returns the number of messages accepted.
+ */
+size_t gossip_ingest_batch(gossip_ingest_t            *gi,
+                           const unsigned char *const *msgs,
+                           const size_t               *lens,
+                           size_t                      n,
+                           uint32_t                    now_unix,
+                           int                        *results_out);
+
+/*
+ * A channel was closed (funding output spent, or a permanent failure).
+ * Marks it spent in gossip_store and drops it from the live graph.
+ */
+void gossip_ingest_channel_closed(gossip_ingest_t *gi,
+                                  uint64_t         scid,
+                                  uint32_t         now_unix);
+
 /*
  * Parse a gossip_timestamp_filter (type 265).
  * Extracts chain_hash, first_timestamp, and timestamp_range.
@@ -0,0 +1,154 @@
+/*
+ * gossip_log.h — Append-only binary gossip store, memory-mapped
+ *
+ * Accepted gossip is kept as the raw BOLT #7 wire messages it arrived as,
+ * one length-prefixed record each, in a single append-only file:
+ *
+ *   header:  "SSGL" version(4)
+ *   record:  flags(2) len(2) timestamp(4) msg(len)       (big-endian)
+ *
+ * The file is mmap()ed and an in-memory index (scid -> announcement /
+ * per-direction update / capacity record, node_id -> node_announcement)
+ * is rebuilt by one linear scan on open.  Readers -- graph load, RGS
+ * export, query_channel_range / query_short_channel_ids answers -- walk
+ * the index and parse fields straight out of the mapping: no SQL, no hex.
+ * Forwarding the stored messages also means peers get the original
+ * signatures.
+ *
+ * A superseded update or announcement is flagged GOSSIP_LOG_DELETED in
+ * place; once deleted bytes outweigh live ones (and exceed
+ * GOSSIP_LOG_COMPACT_MIN) the log is compacted: live records are copied to
+ * a fresh file which atomically replaces the old one.
+ *
+ * All calls lock the log internally; callbacks run with the lock held and
+ * must not call back into the same log.  Message pointers handed to
+ * callbacks are valid only for the duration of the call.
+ *
+ * Reference: CLN common/gossip_store.h, common/gossmap.c
+ */
+
+#ifndef SUPERSCALAR_GOSSIP_LOG_H
+#define SUPERSCALAR_GOSSIP_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "gossip_store.h"
+
+#define GOSSIP_LOG_VERSION       1u
+#define GOSSIP_LOG_HDR_LEN       8u
+#define GOSSIP_LOG_REC_HDR_LEN   8u
+
+/* Record flags */
+#define GOSSIP_LOG_DELETED       0x8000u
+
+/* Private record: channel capacity, type(2) scid(8) satoshis(8) */
+#define GOSSIP_LOG_CHANNEL_AMOUNT  4101
+
+/* Compact when dead bytes exceed both this and the live bytes. */
+#define GOSSIP_LOG_COMPACT_MIN   (1u << 20)
+
+typedef struct {
+    uint64_t scid;           /* 0 = empty slot */
+    uint64_t ann_off;        /* 0 = none (spent, or update seen first) */
+    uint64_t upd_off[2];
+    uint64_t amount_off;
+    uint32_t upd_ts[2];      /* channel_update timestamps, for superseding */
+} gossip_log_chan_t;
+
+typedef struct {
+    unsigned char node_id[33];
+    uint64_t      off;       /* 0 = empty slot */
+    uint32_t      ts;
+} gossip_log_node_t;
+
+typedef struct {
+    int              fd;
+    char            *path;
+    unsigned char   *map;           /* read-only mapping of [0, map_len) */
+    size_t           map_len;       /* >= file_len; grows geometrically */
+    uint64_t         file_len;      /* append offset */
+    uint64_t         live_bytes;
+    uint64_t         dead_bytes;
+
+    gossip_log_chan_t *chans;       /* open addressing by scid */
+    size_t             n_chan_slots;
+    size_t             n_chans;
+    gossip_log_node_t *nodes;       /* open addressing by node_id */
+    size_t             n_node_slots;
+    size_t             n_nodes;
+
+    uint64_t        *sorted;        /* announced scids, ascending */
+    size_t           n_sorted;
+    int              sorted_dirty;
+
+    uint32_t         n_compactions;
+    uint32_t         n_maps;        /* mmap() calls, including remaps */
+    pthread_mutex_t  lock;
+} gossip_log_t;
+
+/* Open (or create) the log at path and index it.  A torn record at the
+ * tail (crash mid-append) is truncated away.  Returns 1 on success. */
+int  gossip_log_open(gossip_log_t *gl, const char *path);
+void gossip_log_close(gossip_log_t *gl);
+
+/*
+ * Append an accepted gossip message (type 256/257/258), already verified.
+ * A channel_update or node_announcement replaces (and deletes) the stored
+ * one if its timestamp is newer; a channel_announcement for a channel we
+ * have, or an update for a channel we have no announcement for, is not
+ * stored.  recv_time is recorded in the record header.
+ * Returns 1 if appended, 0 if not stored or on error.
+ */
+int gossip_log_append(gossip_log_t *gl, const unsigned char *msg, size_t len,
+                      uint32_t recv_time);
+
+/* Record (or replace) a channel's capacity.  Returns 1 on success. */
+int gossip_log_set_amount(gossip_log_t *gl, uint64_t scid, uint64_t capacity_sat);
+
+/* Forget channel scid (funding spent): its records are deleted.
+ * Returns 1 if it was present. */
+int gossip_log_mark_spent(gossip_log_t *gl, uint64_t scid);
+
+/* Look up an announced channel.  Any out-pointer may be NULL.
+ * Returns 1 if found. */
+int gossip_log_get_channel(gossip_log_t *gl, uint64_t scid,
+                           unsigned char node1_out[33],
+                           unsigned char node2_out[33],
+                           uint64_t *capacity_out);
+
+/* Rewrite the log without deleted records now.  Returns 1 on success. */
+int gossip_log_compact(gossip_log_t *gl);
+
+/* Live channel count (announced, not spent). */
+size_t gossip_log_channel_count(gossip_log_t *gl);
+
+/* Emit every enabled directed edge, as gossip_store_enumerate_channels()
+ * does.  htlc_max is the advertised htlc_maximum_msat, else capacity.
+ * Returns count of edges, -1 on error. */
+int gossip_log_enumerate_channels(gossip_log_t *gl,
+                                  gossip_store_full_channel_cb_t cb,
+                                  void *ctx);
+
+/* Stored wire messages of one channel; upd[d] is NULL (len 0) if none. */
+typedef void (*gossip_log_channel_cb_t)(uint64_t scid,
+    const unsigned char *ann, size_t ann_len,
+    const unsigned char *const upd[2], const size_t upd_len[2],
+    void *userdata);
+
+/* Announced channels whose block is in [first_blocknum,
+ * first_blocknum+num_blocks), in scid order.  Returns count. */
+int gossip_log_channels_in_range(gossip_log_t *gl,
+                                 uint32_t first_blocknum, uint32_t num_blocks,
+                                 gossip_log_channel_cb_t cb, void *userdata);
+
+/* Announced channels from a list of scids.  Returns count found. */
+int gossip_log_channels_by_scids(gossip_log_t *gl,
+                                 const uint64_t *scids, int n_scids,
+                                 gossip_log_channel_cb_t cb, void *userdata);
+
+/* Build an RGS snapshot of the log (see gossip_store_export_rgs()).
+ * Returns bytes written, or 0 on error. */
+size_t gossip_log_export_rgs(gossip_log_t *gl, unsigned char *out, size_t out_cap);
+
+#endif /* SUPERSCALAR_GOSSIP_LOG_H */
@@ -12,6 +12,11 @@
  *   - Per-channel token-bucket rate limiting (LND: 10 burst / 60s)
  *   - 5-minute new-peer embargo (Eclair)
  *   - Peer prioritization (important vs transient)
+ *
+ * Announcements and updates are collected per peer and handed to
+ * gossip_ingest_batch() GOSSIP_PEER_BATCH_MAX at a time, or once the
+ * connection has been idle GOSSIP_PEER_BATCH_WAIT_MS with a partial batch,
+ * so an initial sync verifies signatures in parallel.
  */
 
 #ifndef SUPERSCALAR_GOSSIP_PEER_H
@@ -22,6 +27,7 @@
 #include <pthread.h>
 #include <secp256k1.h>
 #include "superscalar/gossip_store.h"
+#include "superscalar/gossip_ingest.h"
 
 /* -----------------------------------------------------------------------
  * Config constants
@@ -32,6 +38,8 @@
 #define GOSSIP_BOOTSTRAP_PEER_COUNT  5   /* LDK: first 5 get 2-week filter */
 #define GOSSIP_TRANSIENT_MAX_RETRIES 5   /* transient peers give up after 5 failures */
 #define GOSSIP_EMBARGO_SECS        300   /* Eclair: ignore gossip for 5min from new peers */
+#define GOSSIP_PEER_BATCH_MAX      512   /* messages per gossip_ingest_batch() */
+#define GOSSIP_PEER_BATCH_WAIT_MS  500   /* idle time before a partial batch goes */
 
 /* -----------------------------------------------------------------------
  * Per-peer config
@@ -52,10 +60,36 @@ typedef struct {
     secp256k1_context *ctx;
     unsigned char     our_priv32[32];
     gossip_store_t    *store;
+    gossip_ingest_t   *gi;           /* verifies and stores; writes to store */
+    pthread_mutex_t   *gi_lock;      /* held around gi (shared by every peer) */
     const char        *network;      /* "bitcoin","signet","testnet","regtest" */
     volatile int      *shutdown_flag;
 } gossip_peer_mgr_cfg_t;
 
+/* -----------------------------------------------------------------------
+ * Per-peer batch of gossip awaiting verification
+ * --------------------------------------------------------------------- */
+typedef struct {
+    unsigned char *msgs[GOSSIP_PEER_BATCH_MAX];  /* owned copies */
+    size_t         lens[GOSSIP_PEER_BATCH_MAX];
+    size_t         n;
+    uint64_t       first_ms;    /* monotonic ms the oldest message arrived */
+} gossip_peer_batch_t;
+
+/*
+ * Copy msg into b.  Returns 1 if b is now full (flush it), 0 if there is
+ * room left, -1 if the copy could not be allocated (msg dropped).
+ */
+int gossip_peer_batch_add(gossip_peer_batch_t *b, const unsigned char *msg,
+                          size_t msg_len, uint64_t now_ms);
+
+/*
+ * Run b through gossip_ingest_batch() on cfg->gi, under cfg->gi_lock when
+ * set, then empty it.  Returns the number of messages accepted.
+ */
+size_t gossip_peer_batch_flush(const gossip_peer_mgr_cfg_t *cfg,
+                               gossip_peer_batch_t *b, uint32_t now_unix);
+
 /* -----------------------------------------------------------------------
  * Rejection LRU cache (added Commit 3)
  * --------------------------------------------------------------------- */
@@ -160,7 +194,7 @@ int gossip_next_backoff_ms(int current_ms);
 
 /*
  * Connect to one gossip peer, exchange init + timestamp_filter, loop
- * reading gossip until disconnected.
+ * reading gossip into batches for cfg->gi until disconnected.
  * Returns 1 if graceful, 0 on error.
  */
 int gossip_peer_run_once(const gossip_peer_cfg_t *peer,
@@ -185,7 +219,8 @@ int gossip_peer_parse_list(const char *list, gossip_peer_cfg_t *out, int max);
 int gossip_peer_is_important(const gossip_peer_mgr_cfg_t *cfg, int peer_index);
 
 /*
- * Start one pthread per peer. Returns number of threads started.
+ * Start one pthread per peer; cfg->gi is required.
+ * Returns number of threads started.
  */
 int gossip_peer_mgr_start(gossip_peer_mgr_cfg_t *cfg, pthread_t *tids_out);
 
@@ -31,6 +31,15 @@ int  gossip_store_open_in_memory(gossip_store_t *gs);
 
 void gossip_store_close(gossip_store_t *gs);
 
+/*
+ * Group writes into one transaction (bulk ingest, RGS import): one journal
+ * sync for the lot instead of one per row.  gossip_store_begin() returns 1
+ * if it opened a transaction -- the caller then owes a gossip_store_commit()
+ * -- or 0 if one is already open or on error (writes then proceed as usual).
+ */
+int  gossip_store_begin(gossip_store_t *gs);
+int  gossip_store_commit(gossip_store_t *gs);
+
 /*
  * Upsert a node record. pubkey33 is the 33-byte compressed pubkey.
  * alias: up to GOSSIP_STORE_ALIAS_MAX bytes (NUL-padded in BOLT #7).
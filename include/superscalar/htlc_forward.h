@@ -4,7 +4,14 @@
  * Receives inbound HTLCs, decrypts the onion to find the next hop or
  * recognizes the final-hop case, and tracks in-flight state until settled.
  *
- * Reference: LDK ChannelManager, CLN channeld/channeld.c
+ * Relayed HTLCs live in a slab of fixed-size chunks, so entry addresses
+ * stay valid while the table grows, and are indexed three ways: by
+ * (incoming channel, htlc id), by (outgoing channel, htlc id) once the
+ * outbound add is sent, and by payment_hash.  A min-heap on the incoming
+ * cltv_expiry orders them for timeout.  Settle / fail are O(1) lookups
+ * however many HTLCs are in flight.
+ *
+ * Reference: LDK ChannelManager, CLN channeld/channeld.c, lnd htlcswitch
  */
 
 #ifndef SUPERSCALAR_HTLC_FORWARD_H
@@ -16,7 +23,11 @@
 #include "onion_last_hop.h"
 #include "mpp.h"
 
-#define FORWARD_TABLE_MAX  256
+/* Hard ceiling on live (unreleased) entries */
+#define FORWARD_TABLE_MAX         65536
+
+/* Entries per slab chunk (log2) */
+#define FORWARD_SLAB_CHUNK_SHIFT  8
 
 /* Return codes for htlc_forward_process */
 #define FORWARD_FINAL   1   /* we are the final destination */
@@ -50,22 +61,101 @@ typedef struct {
     unsigned char in_channel_id[32];    /* BOLT #2 channel_id of inbound HTLC */
     unsigned char payment_secret[32];   /* final-hop payment_secret from onion TLV type 8 */
     int           has_payment_secret;    /* 1 if payment_secret was extracted */
+    /* Circuit breaker charge taken at update_add, refunded on release */
+    unsigned char cb_peer[33];          /* inbound peer charged */
+    uint64_t      cb_scid;              /* outgoing channel charged */
+    int           cb_charged;           /* 1 if a charge is outstanding */
+    /* Table bookkeeping — owned by htlc_forward.c */
+    uint32_t      slot;                 /* slab slot */
+    uint32_t      heap_pos;             /* expiry heap position, UINT32_MAX = none */
+    int           out_indexed;          /* 1 if in the outgoing index */
 } htlc_forward_entry_t;
-/* NOTE: htlc_forward_table_t is ~390 KB due to next_onion[]. Declare as
- * global or heap-allocated, NOT on the stack. */
 
 typedef struct {
-    htlc_forward_entry_t entries[FORWARD_TABLE_MAX];
-    int count;
+    htlc_forward_entry_t **chunks;      /* slab; entries never move */
+    uint32_t  n_slots;                  /* slots handed out so far */
+    uint32_t  slot_cap;                 /* chunks allocated * chunk size */
+    uint32_t *free_slots;               /* released slots (stack) */
+    uint32_t  n_free;
+
+    /* Open-addressing indexes holding slot + 1 (0 = empty) */
+    uint32_t *idx_in;                   /* (in_chan_id, in_htlc_id) */
+    uint32_t *idx_out;                  /* (out_chan_id, out_htlc_id) */
+    uint32_t *idx_hash;                 /* payment_hash */
+    uint32_t  idx_cap;                  /* power of two */
+
+    uint32_t *expiry;                   /* min-heap of slots on in_cltv */
+    uint32_t  n_expiry;
+
+    int count;                          /* live entries */
+    int n_pending;                      /* entries in FORWARD_STATE_PENDING_OUT */
 } htlc_forward_table_t;
 
-/* Initialise an empty forward table. */
+/* Initialise an empty forward table.  Nothing is allocated until the first
+ * HTLC is added. */
 void htlc_forward_init(htlc_forward_table_t *fwd);
 
+/* Release all storage; the table is left empty and reusable. */
+void htlc_forward_free(htlc_forward_table_t *fwd);
+
+/*
+ * Copy tmpl into a new slot and index it by (in_chan_id, in_htlc_id),
+ * payment_hash and in_cltv, plus (out_chan_id, out_htlc_id) if tmpl is
+ * FORWARD_STATE_INFLIGHT.  Returns the stored entry, NULL when full or
+ * out of memory.
+ */
+htlc_forward_entry_t *htlc_forward_add(htlc_forward_table_t *fwd,
+                                       const htlc_forward_entry_t *tmpl);
+
+/* Entry stored in slab slot (0 <= slot < fwd->n_slots), NULL if free. */
+htlc_forward_entry_t *htlc_forward_get(htlc_forward_table_t *fwd, uint32_t slot);
+
+/* Lookups — NULL if not found. */
+htlc_forward_entry_t *htlc_forward_find_in(htlc_forward_table_t *fwd,
+                                           uint64_t in_chan_id, uint64_t in_htlc_id);
+htlc_forward_entry_t *htlc_forward_find_out(htlc_forward_table_t *fwd,
+                                            uint64_t out_chan_id, uint64_t out_htlc_id);
+
+/* Up to max entries carrying payment_hash (MPP parts share it).
+ * Returns the number written. */
+size_t htlc_forward_find_by_hash(htlc_forward_table_t *fwd,
+                                 const unsigned char payment_hash[32],
+                                 htlc_forward_entry_t **out, size_t max);
+
+/* Set the payment_hash of a stored entry and re-index it. */
+void htlc_forward_set_payment_hash(htlc_forward_table_t *fwd,
+                                   htlc_forward_entry_t *e,
+                                   const unsigned char payment_hash[32]);
+
+/* Outbound add sent: record (out_chan_id, out_htlc_id), index it and move
+ * the entry to FORWARD_STATE_INFLIGHT. */
+void htlc_forward_set_inflight(htlc_forward_table_t *fwd,
+                               htlc_forward_entry_t *e,
+                               uint64_t out_chan_id, uint64_t out_htlc_id);
+
+/* Unindex e and return its slot to the slab.  e is invalid afterwards. */
+void htlc_forward_release(htlc_forward_table_t *fwd, htlc_forward_entry_t *e);
+
+/* Smallest in_cltv among unresolved entries, 0 if none. */
+uint32_t htlc_forward_next_expiry(const htlc_forward_table_t *fwd);
+
+/*
+ * Time out every entry still FORWARD_STATE_PENDING_OUT (never relayed)
+ * with in_cltv <= height, earliest first: each is marked
+ * FORWARD_STATE_FAILED and passed to fn, which should fail the inbound
+ * HTLC back and may release the entry itself; it is released afterwards
+ * otherwise.  In-flight entries are left alone: they resolve downstream
+ * or on chain.  Pass the current height plus the safety margin.  Returns
+ * the number expired.
+ */
+typedef void (*htlc_forward_expire_fn)(void *ctx, htlc_forward_entry_t *e);
+size_t htlc_forward_expire(htlc_forward_table_t *fwd, uint32_t height,
+                           htlc_forward_expire_fn fn, void *ctx);
+
 /*
  * Process an inbound HTLC.
  * Decrypts the onion layer:
- *   - FORWARD_FINAL: delivers to mpp table.
+ *   - FORWARD_FINAL: delivers to mpp table; nothing is kept in the table.
  *   - FORWARD_RELAY: adds to forward table, fills *out with next-hop info.
  *   - FORWARD_FAIL:  malformed onion or routing failure.
  */
@@ -78,21 +168,49 @@ int htlc_forward_process(htlc_forward_table_t *fwd,
                           uint64_t amount_msat, uint32_t cltv,
                           htlc_forward_entry_t *out);
 
+/*
+ * htlc_forward_process() for an onion already peeled (onion_peel_ex() or
+ * onion_proc_peel_batch()): next_onion, the hop payload, is_final and the
+ * layer's shared secret ss.
+ */
+int htlc_forward_process_peeled(htlc_forward_table_t *fwd,
+                                mpp_table_t *mpp,
+                                const unsigned char next_onion[ONION_PACKET_SIZE],
+                                const onion_hop_payload_t *payload,
+                                int is_final,
+                                const unsigned char ss[32],
+                                uint64_t in_htlc_id, uint64_t in_chan_id,
+                                uint64_t amount_msat, uint32_t cltv,
+                                htlc_forward_entry_t *out);
+
 /*
  * Settle: preimage received on outbound HTLC → propagate backward.
  * Finds the inbound HTLC by (out_htlc_id, out_chan_id) and marks it settled.
+ * Returns the entry (still stored, so the caller can fulfill in_htlc_id on
+ * in_chan_id and then release it), or NULL if no in-flight HTLC matched.
  */
-void htlc_forward_settle(htlc_forward_table_t *fwd,
-                          uint64_t out_htlc_id, uint64_t out_chan_id,
-                          const unsigned char preimage[32]);
+htlc_forward_entry_t *htlc_forward_settle(htlc_forward_table_t *fwd,
+                                          uint64_t out_htlc_id, uint64_t out_chan_id,
+                                          const unsigned char preimage[32]);
 
 /*
  * Fail: failure received on outbound HTLC → propagate backward.
  * Re-encrypts the onion error with this hop's shared secret.
+ * Returns the entry as for htlc_forward_settle.
+ */
+htlc_forward_entry_t *htlc_forward_fail(htlc_forward_table_t *fwd,
+                                        uint64_t out_htlc_id, uint64_t out_chan_id,
+                                        const unsigned char *onion_error, size_t err_len,
+                                        unsigned char out_error[256]);
+
+/*
+ * Failure onion for an HTLC this hop fails itself (failure_msg is a
+ * BOLT #4 failure message, at most 220 bytes): HMAC'd with um and
+ * encrypted with ammag for e's shared secret, ready for update_fail_htlc.
+ * Returns 1 on success, 0 on bad arguments.
  */
-void htlc_forward_fail(htlc_forward_table_t *fwd,
-                        uint64_t out_htlc_id, uint64_t out_chan_id,
-                        const unsigned char *onion_error, size_t err_len,
-                        unsigned char out_error[256]);
+int htlc_forward_fail_local(const htlc_forward_entry_t *e,
+                            const unsigned char *failure_msg, size_t len,
+                            unsigned char out_error[256]);
 
 #endif /* SUPERSCALAR_HTLC_FORWARD_H */
@@ -7,15 +7,31 @@
  * Generates payment_hash/secret pairs, tracks pending invoices,
  * and redeems them when the final HTLC arrives.
  *
+ * The table grows on demand and is indexed by payment_hash, so matching
+ * an HTLC to its invoice is O(1) however many are outstanding.  Every
+ * invoice also sits in a timer wheel keyed on its expiry; invoice_expire()
+ * sweeps the wheel and drops invoices that have expired or been settled
+ * (their ln_invoices row is the archive).
+ *
+ * The table is shared between the admin RPC, which creates invoices, and
+ * the LN dispatch loop, which claims and expires them.  Every function
+ * below takes tbl->lock, except invoice_find() and invoice_last(): their
+ * pointers are only stable while the caller holds invoice_lock().
+ *
  * Reference: CLN lightningd/invoices.c, LND invoices/invoiceregistry.go,
  *            LDK lightning/src/ln/channelmanager.rs (create_inbound_payment)
  */
 
 #include <stdint.h>
 #include <stddef.h>
+#include <pthread.h>
 #include <secp256k1.h>
 
-#define INVOICE_TABLE_MAX  64
+#define INVOICE_TABLE_MAX         (1u << 24)  /* hard cap on live entries */
+
+/* Timer wheel: 4096 buckets of 64 s, about three days per revolution */
+#define INVOICE_WHEEL_SLOTS       4096
+#define INVOICE_WHEEL_TICK_SHIFT  6
 
 typedef struct {
     unsigned char payment_hash[32];
@@ -30,11 +46,22 @@ typedef struct {
     int           has_stateless_secret;   /* 1 = payment_secret is HMAC-derived */
     int           has_stateless_preimage; /* 1 = preimage is nonce-derived (Level 2) */
     unsigned char stateless_nonce[32];    /* Level 2 nonce embedded in invoice metadata */
+    uint32_t      wheel_next;        /* next slot + 1 in the same wheel bucket */
 } bolt11_invoice_entry_t;
 
 typedef struct {
-    bolt11_invoice_entry_t entries[INVOICE_TABLE_MAX];
+    bolt11_invoice_entry_t *entries; /* n_slots used; inactive slots are free */
+    size_t          n_slots;
+    size_t          cap;
+    uint32_t       *free_slots;
+    size_t          n_free;
+    uint32_t       *idx;             /* payment_hash -> slot + 1, linear probing */
+    size_t          idx_cap;
+    uint32_t       *wheel;           /* bucket heads, slot + 1 */
+    uint32_t        wheel_tick;      /* next tick to sweep; 0 = nothing scheduled */
+    uint32_t        last_slot;       /* slot + 1 of the newest invoice */
     int             count;           /* number of active entries */
+    pthread_mutex_t lock;            /* everything above */
 } bolt11_invoice_table_t;
 
 /*
@@ -42,6 +69,36 @@ typedef struct {
  */
 void invoice_init(bolt11_invoice_table_t *tbl);
 
+/* Release the table's storage; it is left empty and reusable. */
+void invoice_free(bolt11_invoice_table_t *tbl);
+
+/* Hold the table across invoice_find() / invoice_last() and any use of
+   the entry they return.  Not to be held across the other calls. */
+void invoice_lock(bolt11_invoice_table_t *tbl);
+void invoice_unlock(bolt11_invoice_table_t *tbl);
+
+/*
+ * Insert a copy of an existing entry (e.g. restored from the database),
+ * marking it active.  Returns the stored entry, or NULL if the
+ * payment_hash is already present or the table is full.  Entry pointers
+ * stay valid until the next invoice_add() or invoice_expire().
+ */
+bolt11_invoice_entry_t *invoice_add(bolt11_invoice_table_t *tbl,
+                                    const bolt11_invoice_entry_t *e);
+
+/* Active invoice for payment_hash, or NULL. */
+bolt11_invoice_entry_t *invoice_find(bolt11_invoice_table_t *tbl,
+                                     const unsigned char payment_hash[32]);
+
+/* Copy the active invoice for payment_hash into *out.  Returns 1 if
+   found, 0 if not. */
+int invoice_get(bolt11_invoice_table_t *tbl,
+                const unsigned char payment_hash[32],
+                bolt11_invoice_entry_t *out);
+
+/* The invoice most recently created or added, or NULL if it is gone. */
+bolt11_invoice_entry_t *invoice_last(bolt11_invoice_table_t *tbl);
+
 /*
  * Generate a new invoice and encode it as a BOLT #11 bech32 string.
  *
@@ -84,6 +141,23 @@ int invoice_create_with_hint(bolt11_invoice_table_t *tbl,
                               uint16_t hint_cltv_delta,
                               char *bech32_out, size_t out_cap);
 
+/* invoice_create_with_hint(), also copying the stored entry to entry_out
+   (may be NULL) so the caller need not look it up again. */
+int invoice_create_ex(bolt11_invoice_table_t *tbl,
+                      secp256k1_context *ctx,
+                      const unsigned char node_privkey[32],
+                      const char *network,
+                      uint64_t amount_msat,
+                      const char *description,
+                      uint32_t expiry_secs,
+                      const unsigned char *hint_pubkey,
+                      uint64_t hint_scid,
+                      uint32_t hint_fee_base,
+                      uint32_t hint_fee_ppm,
+                      uint16_t hint_cltv_delta,
+                      char *bech32_out, size_t out_cap,
+                      bolt11_invoice_entry_t *entry_out);
+
 /*
  * Redeem a pending invoice when the final HTLC arrives.
  *
@@ -106,4 +180,17 @@ int invoice_claim(bolt11_invoice_table_t *tbl,
  */
 void invoice_settle(bolt11_invoice_table_t *tbl, const unsigned char payment_hash[32]);
 
+/* Called for each invoice invoice_expire() drops, just before it goes,
+   with the table locked. */
+typedef void (*invoice_archive_fn)(void *ctx, const bolt11_invoice_entry_t *e);
+
+/*
+ * Sweep the expiry wheel up to now (Unix seconds), dropping invoices that
+ * have expired and settled invoices in the buckets passed.  Cost is
+ * proportional to the buckets swept, not the table size.  archive may be
+ * NULL.  Returns the number of invoices dropped.
+ */
+size_t invoice_expire(bolt11_invoice_table_t *tbl, uint32_t now,
+                      invoice_archive_fn archive, void *ctx);
+
 #endif /* SUPERSCALAR_INVOICE_H */
@@ -21,6 +21,7 @@
 #include "htlc_forward.h"
 #include "mpp.h"
 #include "payment.h"
+#include "payment_engine.h"
 #include "invoice.h"
 #include "watchtower.h"
 #include "lsps.h"
@@ -29,6 +30,11 @@
 #include "scb.h"
 #include "gossip_ingest.h"
 #include "circuit_breaker.h"
+#include "onion_proc.h"
+
+/* A forward still waiting for its outgoing peer is failed back this many
+ * blocks before its incoming HTLC expires. */
+#define LN_DISPATCH_FORWARD_EXPIRY_MARGIN  10
 
 /*
  * Aggregate context for the LN dispatch loop.
@@ -39,6 +45,7 @@ typedef struct {
     htlc_forward_table_t  *fwd;           /* in-flight HTLC forwards */
     mpp_table_t           *mpp;           /* MPP part aggregation */
     payment_table_t       *payments;      /* outbound payment tracking */
+    payment_engine_t      *pay_engine;    /* concurrent outbound payments; NULL = disabled */
     secp256k1_context     *ctx;           /* secp256k1 context */
     unsigned char          our_privkey[32]; /* node private key */
     volatile int          *shutdown_flag; /* set non-zero to stop loop */
@@ -54,6 +61,8 @@ typedef struct {
     channel_t             **peer_channels;
     gossip_store_t        *gs;            /* gossip store for query responses; NULL=disabled */
     gossip_ingest_t       *gi;            /* gossip ingest pipeline; NULL = passthrough gs only */
+    gossip_log_t          *glog;          /* raw gossip log; answers queries instead of gs */
+    gossip_query_index_t  *gqi;           /* scid index; answers query_channel_range */
     struct persist_t      *persist;       /* factory work queue; NULL=disabled */
     /* Cooperative close: callback to broadcast signed closing tx */
     void (*broadcast_tx_cb)(void *ctx, const unsigned char *tx, size_t tx_len);
@@ -62,14 +71,11 @@ typedef struct {
        NULL = disabled. Updated automatically when channels change state. */
     const char *scb_path;
     circuit_breaker_t     *cb;           /* per-peer HTLC limits; NULL=disabled */
+    onion_proc_t          *onion_proc;   /* batch peel + replay filter; NULL = inline peel */
+    uint32_t              *block_height; /* chain tip for forward expiry and payment CLTVs; NULL = none */
     const char            *network;      /* "mainnet"/"signet"/"testnet"; NULL=mainnet */
 } ln_dispatch_t;
 
-/*
- * Flush all FORWARD_STATE_PENDING_OUT entries in d->fwd to next peers.
- * Looks up next peer by next_hop_scid via peer_mgr_find_by_scid().
- * Returns number of HTLCs successfully sent.
- */
 
 /*
  * Load persisted state (invoices, peer channels) into dispatch tables.
@@ -79,8 +85,31 @@ typedef struct {
  */
 int ln_dispatch_load_state(ln_dispatch_t *d);
 
+/*
+ * Flush all FORWARD_STATE_PENDING_OUT entries in d->fwd to next peers.
+ * Looks up next peer by next_hop_scid via peer_mgr_find_by_scid().
+ * Forwards are keyed by peer index on both sides (in_chan_id / out_chan_id),
+ * as the update_fulfill/fail messages that resolve them arrive per peer.
+ * A refused outbound add is failed back upstream.
+ * Returns number of HTLCs successfully sent.
+ */
 int ln_dispatch_flush_relay(ln_dispatch_t *d);
 
+/*
+ * Fail back upstream every forward never relayed whose incoming HTLC
+ * expires within LN_DISPATCH_FORWARD_EXPIRY_MARGIN blocks of height.
+ * Run from the dispatch loop with *d->block_height; returns the number
+ * failed back.
+ */
+size_t ln_dispatch_expire_forwards(ln_dispatch_t *d, uint32_t height);
+
+/*
+ * Drop invoices expired or settled by now (Unix seconds).  With persist
+ * set, the ln_invoices rows of those that expired unpaid are deleted.
+ * Run from the dispatch loop; returns the number dropped.
+ */
+size_t ln_dispatch_expire_invoices(ln_dispatch_t *d, uint32_t now);
+
 /*
  * Process a single plaintext BOLT #2 message already stripped of BOLT #8
  * framing (msg includes the 2-byte type prefix).
@@ -99,11 +128,23 @@ int ln_dispatch_flush_relay(ln_dispatch_t *d);
 int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
                              const unsigned char *msg, size_t msg_len);
 
+/*
+ * Process n messages as ln_dispatch_process_msg() would, in order, with
+ * the onions of all update_add_htlc among them peeled as one batch on
+ * d->onion_proc (if set).  Returns the number of messages processed
+ * without a parse error.
+ */
+int ln_dispatch_process_batch(ln_dispatch_t *d, const int *peer_idx,
+                              const unsigned char *const *msgs,
+                              const size_t *msg_lens, size_t n);
+
 /*
  * Run the LN peer message dispatch loop (blocking).
  * Call from a dedicated pthread after peer_mgr is populated.
  * Reads from all connected peer fds via select(2) with a 100 ms timeout,
- * dispatches via ln_dispatch_process_msg(), and repeats until
+ * dispatches via ln_dispatch_process_msg() (one message per ready peer
+ * through ln_dispatch_process_batch() when d->onion_proc is set), and
+ * repeats until
  * *d->shutdown_flag becomes non-zero.
  */
 void ln_dispatch_run(ln_dispatch_t *d);
@@ -47,7 +47,8 @@ typedef struct {
     uint64_t accumulated_fees_sats; /* routing fees earned on THIS channel */
 } lsp_channel_entry_t;
 
-/* Invoice registry entry for bridge inbound payments (Phase 14) */
+/* Invoice registry entry for bridge inbound payments (Phase 14).
+   Initial capacity; the registry grows on demand. */
 #define MAX_INVOICE_REGISTRY 256
 
 typedef struct {
@@ -59,7 +60,8 @@ typedef struct {
     int active;
 } invoice_entry_t;
 
-/* HTLC origin tracking for bridge back-propagation (Phase 14) */
+/* HTLC origin tracking for bridge back-propagation (Phase 14).
+   Initial capacity; the origin table grows on demand. */
 #define MAX_HTLC_ORIGINS 256
 
 typedef struct {
@@ -83,9 +85,28 @@ typedef struct {
     invoice_entry_t *invoices;
     size_t n_invoices;
     size_t invoices_cap;
+    /* payment_hash index over invoices, slot + 1; same scheme as the
+       origin indexes below. */
+    uint32_t *invoice_by_hash;
+    size_t invoice_idx_cap;
+    size_t invoice_idx_used;
+    size_t invoices_indexed;
+    uint32_t *invoice_free;
+    size_t n_invoice_free;
     htlc_origin_t *htlc_origins;
     size_t n_htlc_origins;
     size_t htlc_origins_cap;
+    /* Origin lookup indexes: open addressing over htlc_origins, slot + 1
+       (0 = empty).  Entries are checked on lookup, so stale ones left by
+       slot reuse or direct deactivation are harmless until the next
+       rebuild.  See lsp_bridge.c. */
+    uint32_t *origin_by_hash;
+    uint32_t *origin_by_request;
+    size_t origin_idx_cap;
+    size_t origin_idx_used;      /* inserts since last rebuild */
+    size_t origins_indexed;      /* slots below this were indexed when appended */
+    uint32_t *origin_free;       /* inactive slots to reuse (stack) */
+    size_t n_origin_free;
     uint64_t next_request_id;    /* for outbound pay correlation */
 
     /* Watchtower (Phase 18) */
@@ -181,6 +202,7 @@ typedef struct {
 
     /* Chain backend and wallet source for mode-agnostic funding/broadcast */
     void *chain_be;   /* chain_backend_t* — regtest or bip158 */
+    void *chain_events; /* chain_events_t* on chain_be or NULL — polled in daemon loop */
     void *wallet_src; /* wallet_source_t* — rpc or hd */
 
     /* Admin RPC (JSON-RPC 2.0 Unix socket — serviced in daemon loop) */
@@ -457,15 +479,47 @@ int lsp_channels_lookup_invoice(lsp_channel_mgr_t *mgr,
                                   const unsigned char *payment_hash32,
                                   size_t *dest_client_out);
 
+/* Active registry entry for payment_hash, NULL if none. */
+invoice_entry_t *lsp_channels_find_invoice(lsp_channel_mgr_t *mgr,
+                                             const unsigned char *payment_hash32);
+
+/* Claim a zeroed registry slot (reusing inactive ones, growing when none
+   are free) without persisting it -- for restoring from the DB.  Fill it
+   in, set active, then call lsp_channels_index_invoice.  NULL on failure. */
+invoice_entry_t *lsp_channels_alloc_invoice(lsp_channel_mgr_t *mgr);
+void lsp_channels_index_invoice(lsp_channel_mgr_t *mgr, invoice_entry_t *inv);
+
+/* Free the invoice registry and its index. */
+void lsp_channels_free_invoices(lsp_channel_mgr_t *mgr);
+
 /* Handle a MSG_BRIDGE_* message from the bridge daemon.
    Dispatches based on msg_type. Returns 1 on success. */
 int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
                                      const wire_msg_t *msg);
 
-/* Track that an HTLC came from the bridge (for back-propagation). */
-void lsp_channels_track_bridge_origin(lsp_channel_mgr_t *mgr,
-                                        const unsigned char *payment_hash32,
-                                        uint64_t bridge_htlc_id);
+/* Track that an HTLC came from the bridge (for back-propagation).
+   Returns the new origin, or NULL on allocation failure. */
+htlc_origin_t *lsp_channels_track_bridge_origin(lsp_channel_mgr_t *mgr,
+                                                  const unsigned char *payment_hash32,
+                                                  uint64_t bridge_htlc_id);
+
+/* Claim a zeroed origin slot, reusing inactive ones and growing the table
+   when none are free.  Fill it in, then call lsp_channels_index_bridge_origin.
+   Returns NULL on allocation failure. */
+htlc_origin_t *lsp_channels_alloc_bridge_origin(lsp_channel_mgr_t *mgr);
+
+/* (Re)index an origin under its current payment_hash and request_id. */
+void lsp_channels_index_bridge_origin(lsp_channel_mgr_t *mgr,
+                                        htlc_origin_t *origin);
+
+/* Active origin for payment_hash / outbound request_id, NULL if none. */
+htlc_origin_t *lsp_channels_find_bridge_origin(lsp_channel_mgr_t *mgr,
+                                                 const unsigned char *payment_hash32);
+htlc_origin_t *lsp_channels_find_origin_by_request(lsp_channel_mgr_t *mgr,
+                                                     uint64_t request_id);
+
+/* Free the origin table and its indexes. */
+void lsp_channels_free_bridge_origins(lsp_channel_mgr_t *mgr);
 
 /* Check bridge HTLC timeouts: fail back any HTLC whose cltv_expiry is
    approaching (within FACTORY_CLTV_DELTA blocks of current height).
@@ -9,12 +9,22 @@
  * Pathfinder uses these penalties to exclude recently-failed hops during
  * payment retry.
  *
+ * Each entry also carries a liquidity estimate: amounts known to have
+ * passed (lower bound) and known to have failed (upper bound).  Both
+ * bounds relax toward "unknown" with half-life MC_LIQ_HALF_LIFE_SECS, and
+ * mc_success_probability_ppm() turns them into a success probability
+ * (uniform liquidity prior) that the pathfinder folds into edge costs.
+ *
+ * Entries live in an open-addressing hash table keyed by (scid, direction),
+ * grown on demand up to MC_MAX_ENTRIES.
+ *
  * Design follows LDK's MissionControl / ProbabilisticScorer:
  *   - Channel pairs scored by (scid, direction)
  *   - Failure records include the amount that failed
  *   - Penalty decays exponentially over MC_DECAY_SECS (1 hour)
  *   - Success resets the failure score for that direction
  *   - Amount-awareness: penalty only applies if amount >= min_fail_msat
+ *   - Liquidity bounds with offset decay (ProbabilisticScorer)
  *
  * Reference:
  *   LDK: lightning/src/routing/scoring.rs (ProbabilisticScorer)
@@ -25,11 +35,19 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define MC_MAX_ENTRIES      256   /* max tracked channel-direction pairs */
+#define MC_MAX_ENTRIES   262144   /* max tracked channel-direction pairs */
 #define MC_DECAY_SECS      3600u  /* 1-hour penalty half-life (LDK default) */
 #define MC_BASE_PENALTY    1000u  /* base msat penalty at t=0 (proportional decay) */
 #define MC_MAX_PENALTY  1000000u  /* cap at 1000 sat (prevent runaway exclusion) */
 
+/* Liquidity model (LDK ProbabilisticScorer defaults) */
+#define MC_LIQ_HALF_LIFE_SECS     21600u  /* bounds decay half-life: 6 hours */
+#define MC_LIQ_UNKNOWN        UINT64_MAX  /* liq_max_msat: no upper bound known */
+#define MC_PROB_PPM_ONE         1000000u  /* probability 1.0 in ppm */
+/* Edge cost = -log2(P) * (BASE + amount * AMOUNT_PPM / 1e6) */
+#define MC_LIQ_PENALTY_BASE_MSAT    10000u
+#define MC_LIQ_PENALTY_AMOUNT_PPM     200u
+
 typedef struct {
     uint64_t scid;              /* short channel ID */
     int      direction;         /* 0 or 1 */
@@ -37,27 +55,40 @@ typedef struct {
     uint32_t fail_time;         /* Unix timestamp of last failure */
     uint32_t success_time;      /* Unix timestamp of last success (0 if none) */
     int      fail_count;        /* number of consecutive failures */
+    uint64_t liq_min_msat;      /* amount known to have passed (0 = none) */
+    uint64_t liq_max_msat;      /* largest amount that may pass; MC_LIQ_UNKNOWN */
+    uint32_t liq_min_time;      /* when liq_min_msat was observed */
+    uint32_t liq_max_time;      /* when liq_max_msat was observed */
 } mc_entry_t;
 
 typedef struct {
-    mc_entry_t entries[MC_MAX_ENTRIES];
-    int        count;
+    mc_entry_t *entries;        /* dense; order changes on removal */
+    int         count;
+    int         cap;
+    int32_t    *slots;          /* open-addressing index into entries, -1 = empty */
+    int         n_slots;        /* power of two */
 } mc_table_t;
 
-/* Initialise an empty mission-control table. */
+/* Initialise an empty mission-control table (allocates lazily). */
 void mc_init(mc_table_t *mc);
 
+/* Release the table's storage; the table is left empty and reusable. */
+void mc_free(mc_table_t *mc);
+
 /*
  * Record a payment failure on (scid, direction) for amount_msat.
  * Increments fail_count; sets fail_time = now_unix; updates min_fail_msat.
- * If the table is full, evicts the oldest failure entry.
+ * The channel could not carry amount_msat, so the liquidity upper bound
+ * drops below it.  If the table is full, stale entries are pruned and then
+ * the least recently updated entry is evicted.
  */
 void mc_record_failure(mc_table_t *mc, uint64_t scid, int direction,
                        uint64_t amount_msat, uint32_t now_unix);
 
 /*
  * Record a successful payment through (scid, direction) for amount_msat.
- * Resets fail_count to 0 and updates success_time.
+ * Resets fail_count to 0 and updates success_time.  The channel carried
+ * amount_msat, so the liquidity lower bound rises to it.
  */
 void mc_record_success(mc_table_t *mc, uint64_t scid, int direction,
                        uint64_t amount_msat, uint32_t now_unix);
@@ -95,4 +126,35 @@ int mc_prune_stale(mc_table_t *mc, uint32_t now_unix);
  */
 const mc_entry_t *mc_find(const mc_table_t *mc, uint64_t scid, int direction);
 
+/*
+ * Current liquidity bounds of (scid, direction), after decay: *lo_msat is
+ * known to pass and nothing above *hi_msat is expected to.  Without
+ * history the bounds are [0, capacity_msat]; capacity_msat == 0 means
+ * unknown (hi relaxes toward UINT64_MAX).  Either out pointer may be NULL.
+ */
+void mc_liquidity_bounds(const mc_table_t *mc, uint64_t scid, int direction,
+                         uint64_t capacity_msat, uint32_t now_unix,
+                         uint64_t *lo_msat, uint64_t *hi_msat);
+
+/*
+ * Probability, in ppm of MC_PROB_PPM_ONE, that (scid, direction) can carry
+ * amount_msat now.  The decayed bounds [lo, hi] come from the entry, with
+ * hi relaxing toward capacity_msat; inside them liquidity is taken as
+ * uniform: P = (hi + 1 - amount) / (hi + 1 - lo).  Channels without an
+ * entry (or mc == NULL) get the plain prior over [0, capacity_msat].
+ * capacity_msat == 0 means unknown: MC_PROB_PPM_ONE without an entry,
+ * otherwise twice the largest known amount is assumed.
+ */
+uint32_t mc_success_probability_ppm(const mc_table_t *mc, uint64_t scid,
+                                    int direction, uint64_t amount_msat,
+                                    uint64_t capacity_msat, uint32_t now_unix);
+
+/*
+ * Routing cost in msat for a success probability:
+ *   -log2(P) * (MC_LIQ_PENALTY_BASE_MSAT + amount * MC_LIQ_PENALTY_AMOUNT_PPM / 1e6)
+ * Costs add along a path the way log-probabilities do.  Returns UINT64_MAX
+ * for P == 0 (the hop cannot succeed).
+ */
+uint64_t mc_probability_cost_msat(uint32_t prob_ppm, uint64_t amount_msat);
+
 #endif /* SUPERSCALAR_MISSION_CONTROL_H */
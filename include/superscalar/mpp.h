@@ -9,6 +9,14 @@
  *   - collected_msat >= total_msat to fulfil
  *   - collected_msat <= 2 * total_msat (overpayment guard — Eclair)
  *   - Incomplete sets fail after MPP_TIMEOUT_SECS (BOLT #4)
+ *   - Parts carrying a payment_hash must agree on it (BOLT #4)
+ *
+ * Sets live in a growable pool indexed by payment_secret, so adding a part
+ * is O(1) however many payments are in flight; each set's part list grows
+ * as parts arrive.  A min-heap on first_received_unix yields timed-out sets
+ * without scanning.  Limits default to the MPP_MAX_* / MPP_TIMEOUT_SECS
+ * values and can be changed with mpp_set_limits().  An all-zero table is a
+ * valid empty one.
  */
 
 #ifndef SUPERSCALAR_MPP_H
@@ -17,8 +25,8 @@
 #include <stdint.h>
 #include <stddef.h>
 
-#define MPP_MAX_PAYMENTS   32   /* max concurrent multi-part payments */
-#define MPP_MAX_PARTS      10   /* max HTLCs per payment (LDK default) */
+#define MPP_MAX_PAYMENTS   1024 /* default max concurrent multi-part payments */
+#define MPP_MAX_PARTS      10   /* default max HTLCs per payment (LDK default) */
 #define MPP_TIMEOUT_SECS   60   /* fail incomplete set after 60s (BOLT #4) */
 
 typedef struct {
@@ -29,22 +37,44 @@ typedef struct {
 
 typedef struct {
     unsigned char payment_secret[32];
+    unsigned char payment_hash[32];     /* valid if has_payment_hash */
     uint64_t      total_msat;           /* target from invoice */
-    mpp_part_t    parts[MPP_MAX_PARTS];
+    mpp_part_t   *parts;                /* n_parts used, parts_cap allocated */
     int           n_parts;
+    int           parts_cap;
     uint64_t      collected_msat;
     uint32_t      first_received_unix;
+    uint32_t      heap_pos;
+    int           has_payment_hash;
     int           active;
 } mpp_payment_t;
 
 typedef struct {
-    mpp_payment_t entries[MPP_MAX_PAYMENTS];
-    int count;
+    mpp_payment_t *entries;             /* n_slots used; inactive slots are free */
+    size_t         n_slots;
+    size_t         cap;
+    uint32_t      *free_slots;
+    size_t         n_free;
+    uint32_t      *idx;                 /* payment_secret -> slot + 1 */
+    size_t         idx_cap;
+    uint32_t      *heap;                /* active slots, min first_received_unix */
+    size_t         heap_len;
+    int            max_payments;        /* 0 = MPP_MAX_PAYMENTS */
+    int            max_parts;           /* 0 = MPP_MAX_PARTS */
+    uint32_t       timeout_secs;        /* 0 = MPP_TIMEOUT_SECS */
+    int            count;
 } mpp_table_t;
 
 /* Initialise an empty MPP table. */
 void mpp_init(mpp_table_t *tbl);
 
+/* Release the table's storage; it is left empty, limits kept. */
+void mpp_free(mpp_table_t *tbl);
+
+/* Override the limits; 0 keeps the default for that limit. */
+void mpp_set_limits(mpp_table_t *tbl, int max_payments, int max_parts,
+                    uint32_t timeout_secs);
+
 /*
  * Add one HTLC part.
  *
@@ -59,9 +89,23 @@ int mpp_add_part(mpp_table_t *tbl,
                  uint64_t total_msat, uint32_t cltv_expiry);
 
 /*
- * Fail all parts of incomplete sets whose first_received + MPP_TIMEOUT_SECS <= now.
- * Writes up to max_out htlc_ids into failed_htlc_ids_out.
- * Returns count of htlc_ids written.
+ * As mpp_add_part, with an explicit arrival time and optional payment_hash
+ * (NULL = not checked).  A part whose payment_hash differs from the one
+ * its set was opened with is rejected (-1).
+ */
+int mpp_add_part_ex(mpp_table_t *tbl,
+                    const unsigned char *payment_hash,
+                    const unsigned char payment_secret[32],
+                    uint64_t htlc_id, uint64_t amount_msat,
+                    uint64_t total_msat, uint32_t cltv_expiry,
+                    uint32_t now_unix);
+
+/*
+ * Fail all parts of sets whose first_received + timeout <= now, oldest
+ * first, removing them.  Writes up to max_out htlc_ids into
+ * failed_htlc_ids_out; a set that would not fit is left for the next
+ * call.  failed_htlc_ids_out may be NULL to just drop them.
+ * Returns count of htlc_ids written (or dropped).
  */
 int mpp_check_timeouts(mpp_table_t *tbl, uint32_t now_unix,
                        uint64_t *failed_htlc_ids_out, int max_out);
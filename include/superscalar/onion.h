@@ -67,6 +67,22 @@ int onion_peel(const unsigned char node_priv32[32],
                onion_hop_payload_t *payload_out,
                int *is_final);
 
+/*
+ * onion_peel() that also returns the layer's shared secret in ss_out (may
+ * be NULL), so callers need not repeat the ECDH for error encryption.
+ * cipher is an EVP_CIPHER_CTX reused for the ChaCha20 stream, or NULL to
+ * use a temporary one.  Returns 1 on success.
+ */
+struct evp_cipher_ctx_st;
+int onion_peel_ex(const unsigned char node_priv32[32],
+                  secp256k1_context *ctx,
+                  struct evp_cipher_ctx_st *cipher,
+                  const unsigned char onion_in[ONION_PACKET_SIZE],
+                  unsigned char onion_out[ONION_PACKET_SIZE],
+                  onion_hop_payload_t *payload_out,
+                  int *is_final,
+                  unsigned char ss_out[32]);
+
 /*
  * Decrypt a failure onion (error message propagated back toward sender).
  * session_keys: per-hop ephemeral keys used during onion_build.
@@ -0,0 +1,151 @@
+/*
+ * onion_proc.h — Batched onion peeling and shared-secret replay filter
+ *
+ * Incoming HTLCs each need one Sphinx layer peeled: an ECDH, the key
+ * derivations and a ChaCha20 pass over the 1300-byte hops_data.  This
+ * module peels a batch of onions on a pool of worker threads, each with
+ * its own reusable cipher context, then checks every shared secret
+ * against a replay filter (BOLT #4: a node MUST reject an onion it has
+ * already seen).
+ *
+ * Replay filter: the shared secrets of accepted onions are kept in
+ * windows of ONION_REPLAY_WINDOW_BLOCKS blocks by incoming cltv_expiry.
+ * Once the chain tip passes a window, every HTLC recorded in it has
+ * expired, so a replay would be refused anyway and the window is dropped.
+ * Each window is an open-addressing table of 64-bit fingerprints that
+ * grows on demand: memory is 16 bytes per live HTLC, a lookup is one
+ * probe per window, and a false positive needs a 64-bit collision.
+ *
+ * A fingerprint is stored with the HTLC that carried it, so the same
+ * update_add_htlc retransmitted after a reconnect (BOLT #2) is not taken
+ * for a replay.
+ *
+ * Reference: LND htlcswitch/decayedlog.go, CLN lightningd/peer_htlcs.c.
+ */
+
+#ifndef SUPERSCALAR_ONION_PROC_H
+#define SUPERSCALAR_ONION_PROC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <secp256k1.h>
+#include "onion.h"
+
+#define ONION_PROC_WORKERS          4    /* default peeling threads */
+#define ONION_REPLAY_WINDOW_BLOCKS  144  /* blocks per replay window */
+#define ONION_REPLAY_WINDOWS        32   /* windows kept: ~4600 blocks of cltv */
+
+/* Per-onion result of onion_proc_peel_batch() */
+typedef enum {
+    ONION_PEEL_OK = 0,
+    ONION_PEEL_BAD,        /* bad version, key or HMAC, or bad payload */
+    ONION_PEEL_REPLAY,     /* shared secret already seen */
+    ONION_PEEL_EXPIRY,     /* cltv_expiry already past */
+    ONION_PEEL_EXPIRY_FAR  /* cltv_expiry beyond the windows kept */
+} onion_peel_result_t;
+
+typedef struct {
+    /* In */
+    const unsigned char *onion_in;          /* ONION_PACKET_SIZE bytes */
+    uint32_t             cltv_expiry;       /* incoming HTLC's */
+    uint64_t             htlc_key;          /* onion_replay_htlc_key(); 0 = none */
+    /* Out */
+    unsigned char        onion_out[ONION_PACKET_SIZE];
+    onion_hop_payload_t  payload;
+    unsigned char        shared_secret[32];
+    int                  is_final;
+    onion_peel_result_t  result;
+} onion_peel_job_t;
+
+typedef struct {
+    uint64_t fp;           /* shared secret fingerprint, 0 = empty */
+    uint64_t htlc_key;     /* HTLC that carried it */
+} onion_replay_slot_t;
+
+/* One window of the replay filter; window == 0 means unused. */
+typedef struct {
+    uint32_t             window;  /* cltv_expiry / ONION_REPLAY_WINDOW_BLOCKS + 1 */
+    onion_replay_slot_t *slots;
+    size_t               cap;     /* power of two */
+    size_t               count;
+} onion_replay_window_t;
+
+typedef struct {
+    onion_replay_window_t windows[ONION_REPLAY_WINDOWS];  /* by window % N */
+    uint64_t              n_replays;
+} onion_replay_t;
+
+typedef struct {
+    unsigned char           node_priv[32];
+    secp256k1_context      *ctx;
+    onion_replay_t          replay;
+    uint32_t                block_height;  /* tip; 0 = unknown */
+
+    /* Worker pool; the calling thread peels too.  Each worker owns a
+       cipher context; cipher is the calling thread's. */
+    pthread_t              *workers;
+    int                     n_workers;
+    struct evp_cipher_ctx_st *cipher;
+    pthread_mutex_t         batch_lock;    /* one batch at a time; replay, cipher */
+    pthread_mutex_t         lock;          /* jobs and the counters below */
+    pthread_cond_t          work_cv;
+    pthread_cond_t          done_cv;
+    onion_peel_job_t       *jobs;          /* current batch, NULL between */
+    size_t                  n_jobs;
+    size_t                  next_job;      /* next unclaimed job */
+    size_t                  n_done;
+    int                     stop;
+} onion_proc_t;
+
+/*
+ * Initialise with our node key and n_workers peeling threads (0 = peel on
+ * the calling thread only).  Returns 1 on success, 0 on error.
+ */
+int onion_proc_init(onion_proc_t *op, secp256k1_context *ctx,
+                    const unsigned char node_priv32[32], int n_workers);
+
+/* Stop the workers and release everything. */
+void onion_proc_free(onion_proc_t *op);
+
+/* Record the chain tip; replay windows below it are dropped. */
+void onion_proc_set_height(onion_proc_t *op, uint32_t height);
+
+/*
+ * Peel jobs[0..n) in parallel, then check their shared secrets against
+ * the replay filter in order (of two identical onions in one batch the
+ * first wins).  Safe to call from several threads.
+ * Returns the number of jobs with result ONION_PEEL_OK.
+ */
+size_t onion_proc_peel_batch(onion_proc_t *op, onion_peel_job_t *jobs,
+                             size_t n);
+
+/* ---- Replay filter (also usable on its own; not thread-safe) ---- */
+
+void onion_replay_init(onion_replay_t *rf);
+void onion_replay_free(onion_replay_t *rf);
+
+/* Drop windows whose HTLCs have all expired at height. */
+void onion_replay_expire(onion_replay_t *rf, uint32_t height);
+
+/* Identity of HTLC htlc_id on channel_id, for onion_replay_check_add(). */
+uint64_t onion_replay_htlc_key(const unsigned char channel_id[32],
+                               uint64_t htlc_id);
+
+/*
+ * Check shared_secret against every live window, then record it in the
+ * window of cltv_expiry for the HTLC htlc_key (0 = none).  height is the
+ * chain tip; if 0 (unknown) the secret is checked but not recorded.
+ * Returns ONION_PEEL_OK if new or seen only on htlc_key itself,
+ * ONION_PEEL_REPLAY if recorded for another HTLC, ONION_PEEL_EXPIRY if
+ * cltv_expiry has passed, ONION_PEEL_EXPIRY_FAR if it is more than
+ * ONION_REPLAY_WINDOWS windows ahead, or ONION_PEEL_BAD on allocation
+ * failure.
+ */
+onion_peel_result_t onion_replay_check_add(onion_replay_t *rf,
+                                           const unsigned char shared_secret[32],
+                                           uint32_t cltv_expiry,
+                                           uint32_t height,
+                                           uint64_t htlc_key);
+
+#endif /* SUPERSCALAR_ONION_PROC_H */
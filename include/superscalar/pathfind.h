@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "gossip_store.h"
+#include "gossip_log.h"
 #include "mission_control.h"
 #include "pathfind_exclude.h"
 
@@ -31,6 +32,7 @@
 
 typedef struct {
     uint64_t      scid;
+    uint8_t       direction;        /* BOLT #7 channel direction of this hop */
     unsigned char node_id[33];      /* next-hop node pubkey */
     uint32_t      fee_base_msat;
     uint32_t      fee_ppm;
@@ -63,6 +65,122 @@ void pathfind_graph_free(pathfind_graph_t *g);
  * Returns number of directed edges loaded, or -1 on error. */
 int pathfind_graph_load_from_gossip(pathfind_graph_t *g, gossip_store_t *gs);
 
+/* Same, from a binary gossip log (parsed straight out of its mapping). */
+int pathfind_graph_load_from_log(pathfind_graph_t *g, gossip_log_t *gl);
+
+/* ---- Live routing graph ----
+ *
+ * A graph from pathfind_graph_alloc() can be kept for the life of the node
+ * and updated in place: gossip_ingest applies each accepted
+ * channel_announcement / channel_update / closure (see gossip_ingest_t.graph),
+ * so routes never pay a reload.  Channels are found by scid and nodes by
+ * binary pubkey in O(1).  All calls below lock the graph internally.
+ */
+
+/* Add channel scid between node1 and node2 (BOLT #7 order).  Re-announcing a
+ * known scid keeps its policies; capacity_sat 0 leaves capacity unchanged.
+ * Returns 1 on success, 0 on error. */
+int pathfind_graph_add_channel(pathfind_graph_t *g, uint64_t scid,
+                               const unsigned char node1[33],
+                               const unsigned char node2[33],
+                               uint64_t capacity_sat);
+
+/* Apply a channel_update policy for direction 0 (node1->node2) or 1.
+ * htlc_max_msat 0 means "not advertised" (capacity is used instead).
+ * disabled edges stay in the graph but are never routed through.
+ * Returns 1 on success, 0 if the channel is unknown. */
+int pathfind_graph_update_channel(pathfind_graph_t *g, uint64_t scid,
+                                  int direction,
+                                  uint32_t fee_base_msat, uint32_t fee_ppm,
+                                  uint16_t cltv_delta,
+                                  uint64_t htlc_min_msat, uint64_t htlc_max_msat,
+                                  int disabled);
+
+/* Drop channel scid and both of its edges.  Returns 1 if it was present. */
+int pathfind_graph_remove_channel(pathfind_graph_t *g, uint64_t scid);
+
+/* Look up channel scid.  Any out-pointer may be NULL.  Returns 1 if found. */
+int pathfind_graph_get_channel(pathfind_graph_t *g, uint64_t scid,
+                               unsigned char node1_out[33],
+                               unsigned char node2_out[33],
+                               uint64_t *capacity_out);
+
+/* Returns 1 if pubkey is a node of the graph. */
+int pathfind_graph_has_node(pathfind_graph_t *g, const unsigned char pubkey[33]);
+
+/* Current node / channel / directed-edge counts (any pointer may be NULL). */
+void pathfind_graph_counts(pathfind_graph_t *g,
+                           int *n_nodes, int *n_channels, int *n_edges);
+
+/* pathfind_route() / pathfind_route_ex() over an already-built graph. */
+int pathfind_graph_route(pathfind_graph_t *g,
+                         const unsigned char our_node[33],
+                         const unsigned char dest_pubkey[33],
+                         uint64_t amount_msat,
+                         pathfind_route_t *out);
+
+int pathfind_graph_route_ex(pathfind_graph_t *g,
+                            const unsigned char our_node[33],
+                            const unsigned char dest_pubkey[33],
+                            uint64_t amount_msat,
+                            uint32_t current_height,
+                            mc_table_t *mc,
+                            pathfind_route_t *out);
+
+/*
+ * Plan a multi-part payment: up to max_parts channel-disjoint routes from
+ * our_node to dest_pubkey, with amounts_out[i] summing to total_msat.
+ * Candidate routes (the best overall, and the best through each of our
+ * cheapest first hops) are searched in parallel on a worker pool over the
+ * graph, so planning takes about one search.  Amounts follow each route's
+ * bottleneck: channel capacity / htlc_maximum_msat, narrowed by mc's
+ * liquidity bounds.  No part exceeds its route's bottleneck (less the
+ * route's fees) or falls below a hop's htlc_minimum_msat; a route whose
+ * share would is dropped.  mc may be NULL.  Returns the number of routes,
+ * 0 if none, or if the routes found cannot carry total_msat.
+ */
+#define PATHFIND_MPP_MAX_PARTS  16
+
+int pathfind_graph_mpp_plan(pathfind_graph_t *g,
+                            const unsigned char our_node[33],
+                            const unsigned char dest_pubkey[33],
+                            uint64_t total_msat,
+                            int max_parts,
+                            uint32_t now_unix,
+                            mc_table_t *mc,
+                            pathfind_route_t *routes_out,
+                            uint64_t *amounts_out,
+                            int max_out);
+
+/* ---- Goal-directed search (ALT: A*, landmarks, triangle inequality) ----
+ *
+ * With a landmark table in place, pathfind_graph_route*() run A* instead of
+ * Dijkstra: same routes, far fewer settled nodes.  The table stores per-node
+ * cost bounds to/from each landmark at ref_amount_msat; it is used for
+ * queries with amount >= ref_amount_msat, and is set aside automatically
+ * (plain Dijkstra) after any change that could shorten a path -- a new
+ * edge or a cheaper policy -- until the next refresh.  Disables, fee
+ * increases, closures and MC exclusions keep it valid.
+ */
+#define PATHFIND_ALT_LANDMARKS      24   /* default landmark count */
+#define PATHFIND_ALT_MAX_LANDMARKS  64
+#define PATHFIND_ALT_ACTIVE          4   /* landmarks consulted per query */
+
+/* Rebuild the landmark table now (graph lock held only to snapshot and
+ * install).  Returns 1 if installed, 0 on error or if the graph changed
+ * in a path-shortening way while computing. */
+int pathfind_graph_alt_refresh(pathfind_graph_t *g, int n_landmarks,
+                               uint64_t ref_amount_msat);
+
+/* Returns 1 if a current landmark table is installed. */
+int pathfind_graph_alt_ready(pathfind_graph_t *g);
+
+/* Start / stop a background thread that refreshes a stale table at most
+ * once per interval_ms.  pathfind_graph_free() stops it implicitly. */
+int  pathfind_graph_alt_start(pathfind_graph_t *g, int n_landmarks,
+                              uint64_t ref_amount_msat, uint32_t interval_ms);
+void pathfind_graph_alt_stop(pathfind_graph_t *g);
+
 
 /*
  * Find the lowest-fee single-path route from our_node to dest_pubkey
@@ -77,8 +195,8 @@ int pathfind_route(gossip_store_t *gs,
                    pathfind_route_t *out);
 
 /*
- * MPP variant: find up to max_paths routes each carrying
- * roughly total_msat / max_paths.
+ * MPP variant: find up to max_paths channel-disjoint routes, searched for
+ * total_msat / max_paths each (see pathfind_graph_mpp_plan()).
  * Returns count of routes found (0 = failure).
  */
 int pathfind_mpp_routes(gossip_store_t *gs,
@@ -90,9 +208,12 @@ int pathfind_mpp_routes(gossip_store_t *gs,
                         int max_out);
 
 /*
- * Like pathfind_route() but skips channels penalised in mc.
+ * Like pathfind_route() but skips channels penalised in mc, and adds to
+ * each edge mc has liquidity history for the cost of its success
+ * probability (mc_probability_cost_msat), preferring likely-liquid hops.
  * mc may be NULL (falls back to plain pathfind_route).
- * current_height is the current block tip (used for MC penalty decay).
+ * current_height is the clock mc entries were recorded with (used for MC
+ * penalty and liquidity decay).
  * Returns 1 on success, 0 if no path found (or all paths excluded by MC).
  */
 int pathfind_route_ex(gossip_store_t *gs,
@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <pthread.h>
 #include <secp256k1.h>
 #include "bolt11.h"
 #include "pathfind.h"
@@ -63,6 +64,7 @@ typedef struct {
     int             count;
     mc_table_t     *mc;               /* mission control for failure recording; NULL = disabled */
     gossip_ingest_t *gi;              /* gossip ingest for embedded channel_updates; NULL = skip */
+    pthread_mutex_t *gi_lock;         /* held around gi calls when shared; NULL = unshared */
     uint32_t        last_block_height; /* most recent tip passed to payment_send/keysend */
 } payment_table_t;
 
@@ -141,9 +143,37 @@ int payment_check_timeouts(payment_table_t *pt,
                             const unsigned char *our_priv,
                             uint32_t now);
 
+/*
+ * Build the onion for one route and hand update_add_htlc to the first-hop
+ * peer (pmgr may be NULL: built but not sent).  payment_secret and
+ * keysend_preimage may be NULL.  The session key is returned for error
+ * decryption, and the peer index (-1 = not sent) and htlc_id of the HTLC
+ * so its update_fail_htlc can be matched (peer_out / htlc_id_out may be
+ * NULL).  Returns 1 on success, 0 on error.
+ */
+int payment_send_route(peer_mgr_t *pmgr, secp256k1_context *ctx,
+                       const pathfind_route_t *route, uint64_t amount_msat,
+                       uint32_t final_cltv,
+                       const unsigned char payment_hash[32],
+                       const unsigned char *payment_secret,
+                       const unsigned char *keysend_preimage,
+                       unsigned char session_key_out[32],
+                       int *peer_out, uint64_t *htlc_id_out);
+
+/*
+ * Feed one attempt's outcome into mission control: the hops before
+ * failing_hop carried the HTLC, failing_hop could not.  failing_hop -1
+ * records success on every hop.
+ */
+void payment_mc_record(mc_table_t *mc, const pathfind_route_t *route,
+                       uint64_t amount_msat, int failing_hop, uint32_t now);
+
 /*
  * Send an AMP (Atomic Multi-Path) payment with n_shards independent shards.
  * Each shard has an independent root_share derived from a random set_id.
+ * On the live graph (pt->gi->graph) the shards are planned together with
+ * pathfind_graph_mpp_plan(): channel-disjoint routes, amounts sized to
+ * each route, and fewer shards if fewer disjoint routes exist.
  * payment_hash: the aggregate hash for this AMP set (SHA256 of XOR of shares).
  * Returns 1 on success (routes found and HTLCs sent), 0 on failure.
  */
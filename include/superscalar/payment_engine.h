@@ -0,0 +1,234 @@
+/*
+ * payment_engine.h — Concurrent outbound payment engine
+ *
+ * Keeps many outbound payments in flight at once.  Each payment is a small
+ * state machine advanced by events instead of a blocking route / send /
+ * wait / retry sequence:
+ *
+ *   QUEUED --destination slot free--> ROUTING --worker done--> ROUTED
+ *   ROUTED --HTLC sent--> INFLIGHT --settle--> SUCCESS
+ *   INFLIGHT --fail--> RETRY_WAIT --backoff elapsed--> ROUTING
+ *   (permanent failure, no route, attempts exhausted or timeout) --> FAILED
+ *
+ * A new attempt is only made once the previous HTLC has failed.  An
+ * attempt past its timeout fails the payment (last_error "timeout")
+ * instead of being retried, as sending again while the HTLC may still
+ * settle could pay twice; a settle or fail arriving after that is
+ * ignored.  Outbound HTLCs are tracked by (peer, htlc_id), so the
+ * update_fail_htlc that resolves one finds its payment.
+ *
+ * Route searches run on a pool of worker threads over the live routing
+ * graph, reading mission control under a shared lock.  Everything else --
+ * sending HTLCs, settle / fail handling, mission-control updates, the
+ * retry and timeout timer -- runs on the thread that calls
+ * payment_engine_tick() and the payment_engine_on_*() hooks (the dispatch
+ * loop), so one slow payment never holds up the others.
+ *
+ * Payments are found by payment_hash in O(1); retry and timeout deadlines
+ * share one min-heap; at most max_per_dest payments per destination are
+ * active at a time and the rest wait FIFO behind them.  Finished payments
+ * are reported through on_result and their slots reused.
+ *
+ * Reference: LDK OutboundPayments (retry strategy), CLN pay plugin.
+ */
+
+#ifndef SUPERSCALAR_PAYMENT_ENGINE_H
+#define SUPERSCALAR_PAYMENT_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <secp256k1.h>
+#include "payment.h"
+
+#define PAYMENT_ENGINE_WORKERS          4   /* default routing threads */
+#define PAYMENT_ENGINE_MAX_PER_DEST     8   /* default active payments per destination */
+#define PAYMENT_ENGINE_RETRY_BASE_SECS  1   /* first retry delay; doubles per attempt */
+
+typedef enum {
+    PAY_ENGINE_QUEUED = 0,    /* waiting for a destination slot */
+    PAY_ENGINE_ROUTING,       /* queued for / on a routing worker */
+    PAY_ENGINE_ROUTED,        /* route search done, send on next tick */
+    PAY_ENGINE_INFLIGHT,
+    PAY_ENGINE_RETRY_WAIT,
+    PAY_ENGINE_SUCCESS,
+    PAY_ENGINE_FAILED
+} pay_engine_state_t;
+
+typedef struct {
+    unsigned char      payment_hash[32];
+    unsigned char      payment_secret[32];    /* valid if has_payment_secret */
+    unsigned char      keysend_preimage[32];  /* valid if is_keysend */
+    unsigned char      preimage[32];          /* set on success */
+    unsigned char      session_key[32];       /* current attempt's onion key */
+    unsigned char      dest[33];
+    uint64_t           amount_msat;
+    uint32_t           min_final_cltv;
+    uint32_t           route_at;              /* MC clock for the route search */
+    uint32_t           deadline;              /* INFLIGHT: timeout, RETRY_WAIT: retry */
+    uint32_t           heap_pos;
+    uint32_t           next;                  /* routing / done / wait list link */
+    uint32_t           dest_slot;
+    int                out_peer;              /* current attempt's HTLC: peer, */
+    uint64_t           out_htlc_id;           /* its htlc_id there */
+    uint64_t           htlc_key;              /* index key of the two */
+    int                htlc_indexed;          /* 1 if found by (peer, htlc_id) */
+    int                n_attempts;
+    int                has_payment_secret;
+    int                is_keysend;
+    int                route_ok;
+    pathfind_route_t   route;
+    pay_engine_state_t state;
+    char               last_error[64];
+} payment_engine_entry_t;
+
+/* Per-destination bookkeeping; exists while the destination has payments. */
+typedef struct {
+    unsigned char node[33];
+    int           n_active;                   /* payments past QUEUED */
+    int           n_entries;                  /* active + queued */
+    uint32_t      wait_head, wait_tail;       /* QUEUED payments, FIFO */
+} payment_engine_dest_t;
+
+/*
+ * Send one attempt: build the onion for route and add the HTLC, returning
+ * the session key and the HTLC's peer index and htlc_id (leave *peer_out
+ * at -1 if unknown: the attempt then resolves only by payment_hash).
+ * Defaults to payment_send_route() on pmgr / ctx.
+ * Returns 1 on success, 0 on error.
+ */
+typedef int (*payment_engine_send_fn)(void *ctx,
+                                      const payment_engine_entry_t *e,
+                                      uint32_t final_cltv,
+                                      unsigned char session_key_out[32],
+                                      int *peer_out, uint64_t *htlc_id_out);
+
+/* Called once per payment when it reaches SUCCESS or FAILED. */
+typedef void (*payment_engine_result_fn)(void *ctx,
+                                         const payment_engine_entry_t *e);
+
+typedef struct {
+    payment_engine_entry_t *entries;      /* n_slots used; free slots listed */
+    size_t                  n_slots;
+    size_t                  cap;
+    uint32_t               *free_slots;
+    size_t                  n_free;
+    payment_engine_dest_t  *dests;        /* same capacity as entries */
+    size_t                  n_dest_slots;
+    uint32_t               *free_dests;
+    size_t                  n_free_dests;
+    uint32_t               *idx_hash;     /* payment_hash -> slot + 1 */
+    uint32_t               *idx_dest;     /* destination -> dest slot + 1 */
+    uint32_t               *idx_htlc;     /* (peer, htlc_id) -> slot + 1 */
+    size_t                  idx_cap;
+    uint32_t               *heap;         /* INFLIGHT / RETRY_WAIT, min deadline */
+    size_t                  heap_len;
+    uint32_t                route_head;   /* ROUTING, not yet picked up */
+    uint32_t                route_tail;
+    uint32_t                done_head;    /* ROUTED, awaiting tick */
+    size_t                  count;        /* unfinished payments */
+
+    int                     max_per_dest;   /* 0 = PAYMENT_ENGINE_MAX_PER_DEST */
+    int                     max_attempts;   /* 0 = PAYMENT_MAX_ATTEMPTS */
+    uint32_t                timeout_secs;   /* 0 = PAYMENT_TIMEOUT_SECS */
+    uint32_t                retry_base_secs;/* 0 = PAYMENT_ENGINE_RETRY_BASE_SECS */
+
+    pathfind_graph_t       *graph;          /* live routing graph */
+    mc_table_t             *mc;             /* NULL = no mission control */
+    gossip_ingest_t        *gi;             /* embedded channel_updates; NULL = skip */
+    pthread_mutex_t        *gi_lock;        /* held around gi calls when shared; NULL = unshared */
+    peer_mgr_t             *pmgr;
+    secp256k1_context      *ctx;
+    unsigned char           our_node[33];
+    uint32_t                block_height;   /* tip for final CLTVs; 0 = estimate */
+    payment_engine_send_fn  send;           /* NULL = payment_send_route */
+    void                   *send_ctx;
+    payment_engine_result_fn on_result;     /* NULL = not reported */
+    void                   *result_ctx;
+
+    uint64_t                n_sent;         /* HTLCs sent */
+    uint64_t                n_succeeded;
+    uint64_t                n_failed;
+
+    pthread_t              *workers;
+    int                     n_workers;
+    int                     stop;
+    pthread_mutex_t         lock;           /* entries array, route / done lists */
+    pthread_cond_t          work_cv;
+    pthread_rwlock_t        mc_lock;        /* workers read, engine thread writes */
+} payment_engine_t;
+
+/*
+ * Initialise an engine routing over graph from our_node, with n_workers
+ * routing threads (0 = route inline in payment_engine_tick()).  mc may be
+ * NULL.  While the engine runs, mc must only be written through it.
+ * Returns 1 on success, 0 on error.
+ */
+int payment_engine_init(payment_engine_t *pe, pathfind_graph_t *graph,
+                        mc_table_t *mc, const unsigned char our_node[33],
+                        int n_workers);
+
+/* Stop the workers and release everything; pending payments are dropped. */
+void payment_engine_free(payment_engine_t *pe);
+
+/* Override the limits; 0 keeps the default for that limit. */
+void payment_engine_set_limits(payment_engine_t *pe, int max_per_dest,
+                               int max_attempts, uint32_t timeout_secs,
+                               uint32_t retry_base_secs);
+
+/*
+ * Queue a payment of amount_msat to dest.  payment_secret and
+ * keysend_preimage may be NULL; min_final_cltv 0 means 18.  Fails if a
+ * payment with the same hash is still unfinished.
+ * Returns 1 if queued, 0 on error.
+ */
+int payment_engine_pay(payment_engine_t *pe,
+                       const unsigned char dest[33], uint64_t amount_msat,
+                       const unsigned char payment_hash[32],
+                       const unsigned char *payment_secret,
+                       const unsigned char *keysend_preimage,
+                       uint32_t min_final_cltv, uint32_t now);
+
+/* payment_engine_pay() for a BOLT #11 invoice. */
+int payment_engine_pay_invoice(payment_engine_t *pe,
+                               const bolt11_invoice_t *inv, uint32_t now);
+
+/*
+ * Advance the engine: route inline (no workers), send HTLCs for finished
+ * route searches, and act on expired retry delays and timeouts (a timed
+ * out HTLC is never resent: its payment fails).
+ * Returns the number of HTLCs sent.
+ */
+int payment_engine_tick(payment_engine_t *pe, uint32_t now);
+
+/* An outbound HTLC settled.  Returns 1 if it completed one of our payments. */
+int payment_engine_on_settle(payment_engine_t *pe,
+                             const unsigned char payment_hash[32],
+                             const unsigned char preimage[32], uint32_t now);
+
+/*
+ * An outbound HTLC failed.  The failure onion (plaintext if ctx is NULL)
+ * feeds mission control and decides between a delayed retry and failing
+ * the payment.  Returns 1 if a retry is scheduled, 0 otherwise.
+ */
+int payment_engine_on_fail(payment_engine_t *pe,
+                           const unsigned char payment_hash[32],
+                           const unsigned char *onion_error, size_t err_len,
+                           uint32_t now);
+
+/*
+ * payment_engine_on_fail() for the update_fail_htlc of htlc_id from peer
+ * peer_idx (onion_error may be NULL for update_fail_malformed_htlc).
+ * Returns 1 if a retry is scheduled, 0 otherwise (also if no attempt of
+ * ours has that HTLC).
+ */
+int payment_engine_on_fail_htlc(payment_engine_t *pe, int peer_idx,
+                                uint64_t htlc_id,
+                                const unsigned char *onion_error, size_t err_len,
+                                uint32_t now);
+
+/* State of the unfinished payment for payment_hash, or -1 if none. */
+int payment_engine_state(payment_engine_t *pe,
+                         const unsigned char payment_hash[32]);
+
+#endif /* SUPERSCALAR_PAYMENT_ENGINE_H */
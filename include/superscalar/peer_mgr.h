@@ -30,6 +30,7 @@ typedef struct {
     int           has_channel;       /* 1 if a channel is open with this peer */
     uint16_t      peer_features;     /* features from their BOLT #1 init */
     uint64_t      channel_scid;      /* short_channel_id of open channel (0=none) */
+    uint64_t      next_htlc_id;      /* htlc_id of our next update_add_htlc */
     /* Phase O: reconnect state */
     uint32_t      disconnected_at;   /* Unix ts of disconnect; 0 = connected */
     int           reconnect_attempts;
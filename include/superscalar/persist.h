@@ -19,7 +19,7 @@ typedef struct {
 } persist_t;
 
 /* Current schema version. Bump when adding migrations. */
-#define PERSIST_SCHEMA_VERSION 39
+#define PERSIST_SCHEMA_VERSION 41
 
 /* #185 / wallet-team CEREMONY_DESIGN.md §6.1:
    Ceremony state enum (column `ceremonies.state`).
@@ -728,6 +728,8 @@ int persist_save_invoice(persist_t *p,
                           size_t dest_client, uint64_t amount_msat);
 int persist_deactivate_invoice(persist_t *p,
                                 const unsigned char *payment_hash32);
+/* Number of active invoice_registry rows (to size persist_load_invoices). */
+size_t persist_count_invoices(persist_t *p);
 size_t persist_load_invoices(persist_t *p,
                               unsigned char (*hashes_out)[32],
                               size_t *dest_clients_out,
@@ -1126,8 +1128,9 @@ int persist_update_htlc_inbound(persist_t *p, uint64_t htlc_id,
 int persist_save_ln_invoice(persist_t *p, const bolt11_invoice_entry_t *e);
 
 /*
- * Load all entries from ln_invoices into the caller-supplied table.
- * Fills tbl->entries[] and sets tbl->count.
+ * Load the unsettled entries of ln_invoices into the caller-supplied table
+ * via invoice_add().  Settled invoices stay archived in the database;
+ * expired ones are loaded and dropped by the first invoice_expire().
  * Returns number of invoices loaded, or -1 on error.
  */
 int persist_load_ln_invoices(persist_t *p, bolt11_invoice_table_t *tbl);
@@ -1195,6 +1198,24 @@ int persist_save_circuit_breaker_peer(persist_t *p,
  */
 int persist_load_circuit_breaker_peers(persist_t *p, circuit_breaker_t *cb);
 
+/* --- Forwarding rollups (schema v41) --- */
+
+#include "superscalar/fwd_history.h"
+
+/*
+ * Upsert the rollup buckets of h changed since the last save, clear their
+ * dirty flags and delete minute / hour rows past h's retention.
+ * Returns the number of buckets written, or -1 on error.
+ */
+int persist_save_fwd_rollups(persist_t *p, fwd_history_t *h);
+
+/*
+ * Restore the saved rollup buckets into h (normally freshly initialised)
+ * via fwd_history_restore_bucket().
+ * Returns the number of rows read, or -1 on error.
+ */
+int persist_load_fwd_rollups(persist_t *p, fwd_history_t *h);
+
 /* --- PTLC persistence (schema v10) --- */
 
 int persist_save_ptlc(persist_t *p, uint32_t channel_id, const ptlc_t *ptlc);
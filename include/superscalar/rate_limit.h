@@ -2,43 +2,78 @@
 #define SUPERSCALAR_RATE_LIMIT_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <time.h>
 
 /*
- * Per-IP sliding window rate limiter with concurrent handshake cap.
+ * Per-source connection rate limiter with concurrent handshake cap.
  *
- * - Tracks connection timestamps per IP (hashed to fixed-size table).
- * - Rejects connections exceeding max_per_window within window_secs.
+ * - Each source gets a GCRA (generic cell rate algorithm) counter: a burst
+ *   of max_per_window connections, then one per window_secs/max_per_window.
+ *   State is one timestamp per source, so admission is O(1).
+ * - Sources are exact keys in an open-addressing table: an IPv4 address,
+ *   or an IPv6 /64 (one host's usual allocation).  Strings that are not
+ *   addresses are keyed by a 128-bit hash.
+ * - Each IPv4 /24 and IPv6 /48 also has its own counter, max_per_subnet,
+ *   so a flood spread across one network is limited as a whole.
+ * - Memory is bounded at max_sources entries; when full, the least
+ *   recently seen entry is evicted.  Table storage grows on demand.
  * - Rejects new handshakes when active handshakes >= max_handshakes.
  */
 
-#define RATE_LIMIT_BUCKETS 256
-#define RATE_LIMIT_RING_SIZE 64  /* max timestamps per bucket */
+#define RATE_LIMIT_MAX_SOURCES    262144  /* default table bound */
+#define RATE_LIMIT_SUBNET_FACTOR  8       /* default subnet limit, x per-source */
 
 typedef struct {
-    uint32_t ip_hash;
-    time_t   timestamps[RATE_LIMIT_RING_SIZE];
-    size_t   head;   /* next write position */
-    size_t   count;  /* total entries (up to RING_SIZE) */
-} rate_limit_bucket_t;
+    unsigned char key[16];
+    uint8_t       kind;      /* address family / subnet tag, 0 = unused */
+    uint64_t      tat_us;    /* GCRA theoretical arrival time */
+    uint32_t      lru_prev;  /* towards most recently seen */
+    uint32_t      lru_next;  /* towards least recently seen */
+} rate_limit_entry_t;
 
 typedef struct {
-    rate_limit_bucket_t buckets[RATE_LIMIT_BUCKETS];
     int    max_per_window;   /* max connections per IP per window */
     int    window_secs;      /* sliding window duration */
     int    max_handshakes;   /* max concurrent handshakes */
     int    active_handshakes;
+    int    max_per_subnet;   /* per /24 or /48; 0 = no subnet limit */
+
+    rate_limit_entry_t *entries;     /* n_entries used */
+    uint32_t            n_entries;
+    uint32_t            cap;
+    uint32_t            max_sources;
+    uint32_t           *idx;         /* key -> entry + 1 */
+    uint32_t            idx_cap;
+    uint32_t            lru_head;    /* most recently seen */
+    uint32_t            lru_tail;    /* eviction candidate */
+    uint64_t            n_evicted;
 } rate_limiter_t;
 
-/* Initialize rate limiter. */
+/* Initialize rate limiter.  Storage is allocated on first use. */
 void rate_limiter_init(rate_limiter_t *rl, int max_per_window,
                        int window_secs, int max_handshakes);
 
+/* Release the source table; limits are kept. */
+void rate_limiter_free(rate_limiter_t *rl);
+
+/*
+ * Override the table bound and the subnet limit.  0 keeps the default
+ * (RATE_LIMIT_MAX_SOURCES, RATE_LIMIT_SUBNET_FACTOR * max_per_window);
+ * max_per_subnet < 0 disables subnet aggregation.
+ */
+void rate_limiter_set_limits(rate_limiter_t *rl, uint32_t max_sources,
+                             int max_per_subnet);
+
 /* Check if a connection from this IP is allowed.
-   ip_addr: dotted-quad string (e.g. "192.168.1.1") or any string key.
+   ip_addr: dotted-quad / IPv6 string (e.g. "192.168.1.1") or any string key.
    Returns 1 if allowed, 0 if rate-limited. */
 int rate_limiter_allow(rate_limiter_t *rl, const char *ip_addr);
 
+/* rate_limiter_allow() at now_us, microseconds on a monotonic clock. */
+int rate_limiter_allow_at(rate_limiter_t *rl, const char *ip_addr,
+                          uint64_t now_us);
+
 /* Record start of a handshake. Returns 1 if allowed, 0 if at cap. */
 int rate_limiter_handshake_start(rate_limiter_t *rl);
 
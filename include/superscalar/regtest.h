@@ -36,6 +36,11 @@ int   regtest_get_best_block_hash(regtest_t *rt, char *hash_out_buf);
 int   regtest_get_block_hash(regtest_t *rt, int height,
                               char *hash_out, size_t hash_out_len);
 
+/* Fetch the serialized block for a display-order hex hash (getblock <hash> 0).
+   *block_out is heap-allocated (caller frees).  Returns 1 on success, 0 on error. */
+int   regtest_get_raw_block(regtest_t *rt, const char *block_hash,
+                             unsigned char **block_out, size_t *block_len_out);
+
 /* Get the BIP 158 basic compact block filter for a block.
    Requires bitcoind to be running with -blockfilterindex=1.
    filter_hex_out: caller-allocated buffer of at least filter_hex_max bytes.
@@ -80,10 +85,18 @@ int   regtest_send_raw_tx(regtest_t *rt, const char *tx_hex, char *txid_out);
 int   regtest_outpoint_unspent(regtest_t *rt,
                                  const char *txid_hex_display,
                                  uint32_t vout);
+/* Batched regtest_outpoint_unspent: unspent_out[i] gets 1/0/-1 for
+   (txids_hex_display[i], vouts[i]).  One gettxout batch round-trip on the
+   HTTP path; per-call fallback otherwise.  Returns 1 on success. */
+int   regtest_outpoints_unspent_batch(regtest_t *rt,
+                                      const char **txids_hex_display,
+                                      const uint32_t *vouts, size_t n,
+                                      int *unspent_out);
 int   regtest_get_confirmations(regtest_t *rt, const char *txid);
 /*
  * Batch confirmations for n_txids display-order hex txids.
- * Fetches each block only once (getblock hash 1), O(scan_depth) RPCs total.
+ * On the HTTP path one JSON-RPC batch settles wallet/-txindex/mempool txs;
+ * only unplaced txids trigger a batched block scan (each block fetched once).
  * confs_out[i] = confirmation count (>= 1) if confirmed, -1 if not found.
  * Returns 1 on success.
  */
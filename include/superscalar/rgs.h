@@ -52,6 +52,11 @@
 #define RGS_MAX_CHANNELS   16384
 #define RGS_MAX_UPDATES_PER_CHAN 2
 
+/* Largest blob rgs_build() writes within the limits above: header, node
+   table, then per channel 25 bytes plus 33 per update. */
+#define RGS_MAX_BLOB_LEN  (RGS_MAGIC_LEN + 4 + 3 + RGS_MAX_NODE_IDS * 33 + 4 + \
+                           RGS_MAX_CHANNELS * (25 + RGS_MAX_UPDATES_PER_CHAN * 33))
+
 typedef struct {
     unsigned char pubkey[33];
 } rgs_node_id_t;
@@ -0,0 +1,127 @@
+#ifndef SUPERSCALAR_RGS_SERVER_H
+#define SUPERSCALAR_RGS_SERVER_H
+
+/*
+ * rgs_server.h — Precomputed Rapid Gossip Sync snapshots and deltas.
+ *
+ * Serving RGS to many wallets by exporting the whole gossip state per
+ * request re-encodes the same graph over and over.  rgs_server_t instead
+ * keeps its own channel table, fed one announcement / update at a time
+ * (gossip_ingest does this when attached), and only encodes at fixed
+ * boundaries (every interval_secs of wall time):
+ *
+ *   - one full snapshot of the table, and
+ *   - for each of the last RGS_SERVER_HISTORY boundaries B, a delta
+ *     holding only the channels and channel_updates received since B.
+ *
+ * Every blob carries last_sync_timestamp = the newest boundary, which the
+ * client sends back next time.  rgs_server_get() maps that to the delta
+ * from the newest boundary at or before it (full snapshot if it predates
+ * the retained history) and copies out the cached bytes -- no encoding on
+ * the request path.  Deltas use the ordinary RGS v1 layout; importing one
+ * on top of the previous state (gossip_store_import_rgs) upserts exactly
+ * what changed.  RGS v1 has no removal records: closed channels leave the
+ * full snapshot, and delta clients age them out as stale.
+ *
+ * All calls lock internally.
+ *
+ * Reference: LDK rapid-gossip-sync-server (snapshot intervals, deltas)
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "rgs.h"
+
+#define RGS_SERVER_DEFAULT_INTERVAL  86400u   /* one snapshot per day */
+#define RGS_SERVER_HISTORY           8        /* boundaries with cached deltas */
+
+typedef struct {
+    uint64_t             scid;          /* 0 = empty slot */
+    unsigned char        node1[33];
+    unsigned char        node2[33];
+    uint64_t             funding_sat;
+    uint32_t             ann_seen;      /* receipt time of the announcement */
+    uint32_t             upd_seen[2];   /* receipt time of each update, 0 = none */
+    rgs_channel_update_t upd[2];
+} rgs_server_chan_t;
+
+typedef struct {
+    uint32_t       since;               /* boundary the delta starts from */
+    unsigned char *blob;
+    size_t         len;
+} rgs_server_blob_t;
+
+typedef struct {
+    uint32_t           interval;
+    uint32_t           last_boundary;   /* 0 until the first seal */
+
+    rgs_server_chan_t *chans;           /* open addressing by scid */
+    size_t             n_slots;
+    size_t             n_chans;
+
+    rgs_server_blob_t  full;
+    rgs_server_blob_t  deltas[RGS_SERVER_HISTORY];  /* newest boundary first */
+    int                n_deltas;
+    uint32_t           history[RGS_SERVER_HISTORY]; /* sealed boundaries, newest first */
+    int                n_history;
+
+    uint32_t           n_seals;
+    uint64_t           n_served_full;
+    uint64_t           n_served_delta;
+    pthread_mutex_t    lock;
+} rgs_server_t;
+
+/* Initialise; interval_secs 0 = RGS_SERVER_DEFAULT_INTERVAL.
+ * Returns 1 on success. */
+int  rgs_server_init(rgs_server_t *srv, uint32_t interval_secs);
+void rgs_server_free(rgs_server_t *srv);
+
+/*
+ * Seed the table from an RGS blob (e.g. gossip_log_export_rgs() at start-up).
+ * Seeded entries count as older than any boundary: they appear in full
+ * snapshots only.  Returns channels loaded, -1 on parse error.
+ */
+int rgs_server_seed(rgs_server_t *srv, const unsigned char *blob, size_t len);
+
+/* A channel was announced.  No-op if already known.  Returns 1 on success. */
+int rgs_server_add_channel(rgs_server_t *srv, uint64_t scid,
+                           const unsigned char node1[33],
+                           const unsigned char node2[33],
+                           uint64_t funding_sat, uint32_t now_unix);
+
+/* A channel_update was accepted for a known channel (upd->direction selects
+ * the side; only a newer timestamp replaces).  Returns 1 if applied. */
+int rgs_server_apply_update(rgs_server_t *srv, uint64_t scid,
+                            const rgs_channel_update_t *upd, uint32_t now_unix);
+
+/* Drop a closed channel.  Returns 1 if it was present. */
+int rgs_server_remove_channel(rgs_server_t *srv, uint64_t scid);
+
+/*
+ * Seal the boundary now_unix falls in (now rounded down to the interval)
+ * if it is newer than the last one: rebuild the full snapshot and every
+ * delta.  Cheap no-op otherwise; call it from any periodic tick.
+ * Returns 1 if a new boundary was sealed, 0 if not, -1 on OOM.
+ */
+int rgs_server_tick(rgs_server_t *srv, uint32_t now_unix);
+
+/*
+ * Copy the blob for a client whose last snapshot carried
+ * last_sync_timestamp = since (0 = never synced) into out.
+ * Returns bytes written; 0 if nothing is sealed yet or out_cap is too
+ * small (rgs_server_blob_len() gives the size needed).
+ */
+size_t rgs_server_get(rgs_server_t *srv, uint32_t since,
+                      unsigned char *out, size_t out_cap);
+
+/* Size rgs_server_get() would write for since. */
+size_t rgs_server_blob_len(rgs_server_t *srv, uint32_t since);
+
+/* rgs_server_get() into a malloc()ed buffer sized under the same lock, so
+ * a seal in between cannot change the length.  Caller frees.  Returns NULL
+ * (*len_out = 0) if nothing is sealed yet or on OOM. */
+unsigned char *rgs_server_get_copy(rgs_server_t *srv, uint32_t since,
+                                   size_t *len_out);
+
+#endif /* SUPERSCALAR_RGS_SERVER_H */
@@ -0,0 +1,98 @@
+#ifndef SUPERSCALAR_RPC_CLIENT_H
+#define SUPERSCALAR_RPC_CLIENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* Forward declaration — avoid pulling in cJSON.h in the public header */
+struct cJSON;
+
+/*
+ * Shared keep-alive JSON-RPC client for Bitcoin Core.
+ *
+ * Every regtest_exec HTTP call and every chain_backend_rpc call used to
+ * open a fresh HTTP/1.0 "Connection: close" socket and re-encode the
+ * Basic-auth header.  This client keeps a small pool of persistent
+ * HTTP/1.1 connections per (host, port, credentials), builds the auth
+ * header once, and supports native JSON-RPC array batching so N lookups
+ * cost one round-trip instead of N connects.
+ *
+ * Use rpc_client_shared() to get the process-wide client for a bitcoind
+ * endpoint; regtest.c and chain_backend_rpc.c both go through it.
+ */
+
+#define RPC_CLIENT_POOL_SIZE     4    /* persistent connections per endpoint */
+#define RPC_CLIENT_MAX_SHARED    8    /* distinct endpoints in the shared table */
+#define RPC_CLIENT_TIMEOUT_SECS  30   /* per-socket send/recv timeout */
+
+typedef struct {
+    int fd;      /* -1 when not connected */
+    int in_use;  /* 1 while a caller holds this connection */
+} rpc_conn_t;
+
+typedef struct {
+    char host[256];
+    int  port;
+    char rpcuser[128];
+    char rpcpassword[128];
+    char auth_header[400];   /* "Authorization: Basic <b64>\r\n", built once */
+
+    rpc_conn_t      conns[RPC_CLIENT_POOL_SIZE];
+    pthread_mutex_t lock;
+
+    /* Counters (read under lock or after quiescence). */
+    uint64_t n_connects;     /* TCP connects performed */
+    uint64_t n_requests;     /* HTTP round-trips */
+    uint64_t n_calls;        /* JSON-RPC calls carried (batch counts each) */
+} rpc_client_t;
+
+/* JSON-RPC error reported by bitcoind.  code == 0 with a non-empty
+   message means the request never got an RPC-level answer (connect,
+   send, HTTP or parse failure). */
+typedef struct {
+    int  code;
+    char message[160];
+    int  timed_out;  /* sent, no answer in time: the call may have run */
+} rpc_error_t;
+
+/* One call inside a batch.  params is consumed (freed) by
+   rpc_client_batch; NULL sends [].  result is the detached "result"
+   value (caller cJSON_Delete), NULL when err.code != 0. */
+typedef struct {
+    const char   *method;
+    struct cJSON *params;
+    struct cJSON *result;
+    rpc_error_t   err;
+} rpc_batch_item_t;
+
+/* Initialize a client.  No connection is made until the first call.
+   Returns 1 on success, 0 on bad arguments. */
+int  rpc_client_init(rpc_client_t *c, const char *host, int port,
+                      const char *rpcuser, const char *rpcpassword);
+
+/* Close all pooled connections.  The client may be reused afterwards
+   (connections are re-established lazily). */
+void rpc_client_close(rpc_client_t *c);
+
+/* Process-wide client for this endpoint + credentials, created on first
+   use.  Returns NULL if RPC_CLIENT_MAX_SHARED endpoints are in use. */
+rpc_client_t *rpc_client_shared(const char *host, int port,
+                                 const char *rpcuser, const char *rpcpassword);
+
+/* Single call.  wallet selects the /wallet/<name> endpoint (NULL or ""
+   for the node root).  params is consumed; NULL sends [].  Returns the
+   detached "result" (caller cJSON_Delete) or NULL on error, with the
+   error written to err_out if non-NULL. */
+struct cJSON *rpc_client_call(rpc_client_t *c, const char *wallet,
+                               const char *method, struct cJSON *params,
+                               rpc_error_t *err_out);
+
+/* Batched call: sends all items as one JSON-RPC array request and fills
+   each item's result/err by id.  Returns 1 if bitcoind answered (items
+   may still carry individual errors), 0 on transport failure (every
+   item's err.code stays 0 with a message set). */
+int rpc_client_batch(rpc_client_t *c, const char *wallet,
+                      rpc_batch_item_t *items, size_t n_items);
+
+#endif /* SUPERSCALAR_RPC_CLIENT_H */
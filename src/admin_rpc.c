@@ -257,7 +257,8 @@ static cJSON *method_listinvoices(admin_rpc_t *rpc)
 {
     cJSON *arr = cJSON_CreateArray();
     if (!rpc->invoices) return arr;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    invoice_lock(rpc->invoices);
+    for (size_t i = 0; i < rpc->invoices->n_slots; i++) {
         bolt11_invoice_entry_t *inv = &rpc->invoices->entries[i];
         if (!inv->active) continue;
         cJSON *ie = cJSON_CreateObject();
@@ -271,6 +272,7 @@ static cJSON *method_listinvoices(admin_rpc_t *rpc)
         cJSON_AddNumberToObject(ie, "expiry",      (double)inv->expiry);
         cJSON_AddItemToArray(arr, ie);
     }
+    invoice_unlock(rpc->invoices);
     return arr;
 }
 
@@ -335,69 +337,54 @@ static cJSON *method_createinvoice(admin_rpc_t *rpc, const cJSON *params,
 
     /* Use the LSP's configured network for BOLT11 encoding */
     const char *net = rpc->network[0] ? rpc->network : "signet";
-    if (has_hint) {
-        if (!invoice_create_with_hint(rpc->invoices, rpc->ctx, rpc->node_privkey,
-                                       net, amount_msat, desc, expiry,
-                                       hint_pk, hint_scid, hint_fee_base,
-                                       hint_fee_ppm, hint_cltv,
-                                       bech32, sizeof(bech32))) {
-            snprintf(errmsg, errcap, "invoice_create_with_hint failed");
-            return NULL;
-        }
-    } else {
-        if (!invoice_create(rpc->invoices, rpc->ctx, rpc->node_privkey,
-                            net, amount_msat, desc, expiry,
-                            bech32, sizeof(bech32))) {
-            snprintf(errmsg, errcap, "invoice_create failed");
-            return NULL;
-        }
+    bolt11_invoice_entry_t created;
+    if (!invoice_create_ex(rpc->invoices, rpc->ctx, rpc->node_privkey,
+                           net, amount_msat, desc, expiry,
+                           has_hint ? hint_pk : NULL, hint_scid, hint_fee_base,
+                           hint_fee_ppm, hint_cltv,
+                           bech32, sizeof(bech32), &created)) {
+        snprintf(errmsg, errcap, has_hint ? "invoice_create_with_hint failed"
+                                          : "invoice_create failed");
+        return NULL;
     }
     /* Register in bridge invoice table, deliver preimage to client, notify bridge.
        1. Register hash so LSP can look up the HTLC when it arrives
        2. Send preimage to client so it can fulfill
        3. Notify bridge so CLN plugin knows about the invoice */
     if (rpc->channel_mgr) {
-        bolt11_invoice_entry_t *found = NULL;
-        for (int i = INVOICE_TABLE_MAX - 1; i >= 0; i--) {
-            bolt11_invoice_entry_t *e = &rpc->invoices->entries[i];
-            if (e->active && !e->settled && e->amount_msat == amount_msat) {
-                found = e; break;
-            }
+        const bolt11_invoice_entry_t *found = &created;
+        lsp_channel_mgr_t *mgr = rpc->channel_mgr;
+        lsp_t *lsp = (lsp_t *)rpc->lsp;
+        extern void hex_encode(const unsigned char *, size_t, char *);
+        char hash_hex[65];
+        hex_encode(found->payment_hash, 32, hash_hex);
+        hash_hex[64] = '\0';
+        /* 1. Register in bridge invoice table */
+        lsp_channels_register_invoice(mgr,
+            found->payment_hash, found->preimage, 0, amount_msat);
+
+        /* 2. Deliver preimage to client 0 via MSG_DELIVER_PREIMAGE */
+        if (lsp && lsp->client_fds[0] >= 0) {
+            cJSON *dp = cJSON_CreateObject();
+            wire_json_add_hex(dp, "payment_hash", found->payment_hash, 32);
+            wire_json_add_hex(dp, "preimage", found->preimage, 32);
+            cJSON_AddNumberToObject(dp, "amount_msat", (double)amount_msat);
+            wire_send(lsp->client_fds[0], MSG_DELIVER_PREIMAGE, dp);
+            cJSON_Delete(dp);
+            printf("LSP: delivered preimage to client 0 for %s\n", hash_hex);
         }
-        if (found) {
-            lsp_channel_mgr_t *mgr = rpc->channel_mgr;
-            lsp_t *lsp = (lsp_t *)rpc->lsp;
-            extern void hex_encode(const unsigned char *, size_t, char *);
-            char hash_hex[65];
-            hex_encode(found->payment_hash, 32, hash_hex);
-            hash_hex[64] = '\0';
-            /* 1. Register in bridge invoice table */
-            lsp_channels_register_invoice(mgr,
-                found->payment_hash, found->preimage, 0, amount_msat);
-
-            /* 2. Deliver preimage to client 0 via MSG_DELIVER_PREIMAGE */
-            if (lsp && lsp->client_fds[0] >= 0) {
-                cJSON *dp = cJSON_CreateObject();
-                wire_json_add_hex(dp, "payment_hash", found->payment_hash, 32);
-                wire_json_add_hex(dp, "preimage", found->preimage, 32);
-                cJSON_AddNumberToObject(dp, "amount_msat", (double)amount_msat);
-                wire_send(lsp->client_fds[0], MSG_DELIVER_PREIMAGE, dp);
-                cJSON_Delete(dp);
-                printf("LSP: delivered preimage to client 0 for %s\n", hash_hex);
-            }
 
-            /* 3. Notify bridge so CLN plugin creates matching CLN invoice */
-            if (mgr->bridge_fd >= 0) {
-                cJSON *reg = wire_build_bridge_register(
-                    found->payment_hash, found->preimage, amount_msat, 0);
-                wire_send(mgr->bridge_fd, MSG_BRIDGE_REGISTER, reg);
-                cJSON_Delete(reg);
-                printf("LSP: sent BRIDGE_REGISTER for %s\n", hash_hex);
-            }
-
-            printf("LSP: registered bridge invoice %s (client 0, %llu msat)\n",
-                   hash_hex, (unsigned long long)amount_msat);
+        /* 3. Notify bridge so CLN plugin creates matching CLN invoice */
+        if (mgr->bridge_fd >= 0) {
+            cJSON *reg = wire_build_bridge_register(
+                found->payment_hash, found->preimage, amount_msat, 0);
+            wire_send(mgr->bridge_fd, MSG_BRIDGE_REGISTER, reg);
+            cJSON_Delete(reg);
+            printf("LSP: sent BRIDGE_REGISTER for %s\n", hash_hex);
         }
+
+        printf("LSP: registered bridge invoice %s (client 0, %llu msat)\n",
+               hash_hex, (unsigned long long)amount_msat);
     }
 
     cJSON *r = cJSON_CreateObject();
@@ -758,7 +745,13 @@ static cJSON *method_getroute(admin_rpc_t *rpc, const cJSON *params,
     }
     pathfind_route_t route;
     memset(&route, 0, sizeof(route));
-    if (!pathfind_route(rpc->gossip, our_pub, dest, amount_msat, &route)) {
+    /* The daemon's live graph when gossip ingest keeps one */
+    pathfind_graph_t *graph = (rpc->payments && rpc->payments->gi)
+                              ? rpc->payments->gi->graph : NULL;
+    int found = graph
+        ? pathfind_graph_route(graph, our_pub, dest, amount_msat, &route)
+        : pathfind_route(rpc->gossip, our_pub, dest, amount_msat, &route);
+    if (!found) {
         snprintf(errmsg, errcap, "no route found");
         return NULL;
     }
@@ -981,15 +974,9 @@ static cJSON *method_createoffer(admin_rpc_t *rpc, const cJSON *params)
 
 /* ------------------------------------------------------------------ */
 
-/* Method: exportrgs — export gossip store as RGS binary blob (hex-encoded) */
-static cJSON *method_exportrgs(admin_rpc_t *rpc)
+/* {rgs_hex, rgs_bytes} result object for an RGS blob */
+static cJSON *rgs_hex_result(const unsigned char *blob, size_t blen)
 {
-    if (!rpc->gossip) return NULL;
-
-    unsigned char blob[256 * 1024];  /* 256 KB max */
-    size_t blen = gossip_store_export_rgs(rpc->gossip, blob, sizeof(blob));
-    if (blen == 0) return NULL;
-
     /* Hex-encode the blob */
     char *hex = (char *)malloc(blen * 2 + 1);
     if (!hex) return NULL;
@@ -1004,6 +991,36 @@ static cJSON *method_exportrgs(admin_rpc_t *rpc)
     return result;
 }
 
+/* Method: exportrgs — export gossip store as RGS binary blob (hex-encoded).
+   Optional param last_sync_timestamp: with an rgs_server attached, the
+   cached delta since that snapshot is returned instead of a full one. */
+static cJSON *method_exportrgs(admin_rpc_t *rpc, const cJSON *params)
+{
+    if (rpc->rgs_server) {
+        const cJSON *ts = params
+            ? cJSON_GetObjectItemCaseSensitive(params, "last_sync_timestamp") : NULL;
+        uint32_t since = cJSON_IsNumber(ts) ? (uint32_t)ts->valuedouble : 0;
+        size_t clen = 0;
+        unsigned char *cached = rgs_server_get_copy(rpc->rgs_server, since, &clen);
+        if (cached) {
+            cJSON *result = rgs_hex_result(cached, clen);
+            free(cached);
+            return result;
+        }
+        /* nothing sealed yet: fall back to a live export */
+    }
+    if (!rpc->gossip && !rpc->gossip_log) return NULL;
+
+    unsigned char *blob = (unsigned char *)malloc(RGS_MAX_BLOB_LEN);
+    if (!blob) return NULL;
+    size_t blen = rpc->gossip_log
+        ? gossip_log_export_rgs(rpc->gossip_log, blob, RGS_MAX_BLOB_LEN)
+        : gossip_store_export_rgs(rpc->gossip, blob, RGS_MAX_BLOB_LEN);
+    cJSON *result = blen ? rgs_hex_result(blob, blen) : NULL;
+    free(blob);
+    return result;
+}
+
 /* Method: importrgs — import RGS binary blob (hex-encoded) into gossip store */
 static cJSON *method_importrgs(admin_rpc_t *rpc, const cJSON *params,
                                  char *errmsg, size_t errmsg_cap)
@@ -1239,7 +1256,7 @@ size_t admin_rpc_handle_request(admin_rpc_t *rpc,
     } else if (strcmp(m, "sweepfactory") == 0) {
         result = method_sweepfactory(rpc, params, errmsg, sizeof(errmsg));
     } else if (strcmp(m, "exportrgs") == 0) {
-        result = method_exportrgs(rpc);
+        result = method_exportrgs(rpc, params);
     } else if (strcmp(m, "importrgs") == 0) {
         result = method_importrgs(rpc, params, errmsg, sizeof(errmsg));
     } else if (strcmp(m, "payoffer") == 0) {
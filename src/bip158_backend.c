@@ -2,11 +2,14 @@
 #include "superscalar/p2p_bitcoin.h"
 #include "superscalar/persist.h"
 #include "superscalar/regtest.h"
+#include "superscalar/block_cache.h"
 #include "superscalar/sha256.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
 
 /* Forward declaration — defined later in the SipHash section */
 static uint64_t load_le64(const unsigned char *p);
@@ -134,31 +137,28 @@ static uint64_t load_le64(const unsigned char *p)
            ((uint64_t)p[6] << 48)| ((uint64_t)p[7] << 56);
 }
 
-static uint64_t siphash24(const unsigned char *key16,
-                           const unsigned char *data, size_t len)
+/* Per-key initial state.  Every script in a block is hashed under the same
+   key, so the key schedule is computed once per block, not once per script. */
+typedef struct {
+    uint64_t v0, v1, v2, v3;
+} siphash_key_t;
+
+static void siphash_key_init(siphash_key_t *k, const unsigned char *key16)
 {
     uint64_t k0 = load_le64(key16);
     uint64_t k1 = load_le64(key16 + 8);
+    k->v0 = k0 ^ 0x736f6d6570736575ULL;
+    k->v1 = k1 ^ 0x646f72616e646f6dULL;
+    k->v2 = k0 ^ 0x6c7967656e657261ULL;
+    k->v3 = k1 ^ 0x7465646279746573ULL;
+}
 
-    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
-    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
-    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
-    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
-
-    size_t blocks = len / 8;
-    for (size_t i = 0; i < blocks; i++) {
-        uint64_t m = load_le64(data + i * 8);
-        v3 ^= m;
-        SIPHASH_ROUND(v0,v1,v2,v3);
-        SIPHASH_ROUND(v0,v1,v2,v3);
-        v0 ^= m;
-    }
-
-    /* Last (partial) block — pad with message length in high byte */
+/* Last (partial) block — pad with message length in high byte */
+static uint64_t siphash_tail(const unsigned char *data, size_t len)
+{
     uint64_t last = (uint64_t)(len & 0xff) << 56;
-    size_t rem = len & 7;
-    const unsigned char *tail = data + blocks * 8;
-    switch (rem) {
+    const unsigned char *tail = data + (len & ~(size_t)7);
+    switch (len & 7) {
         case 7: last |= (uint64_t)tail[6] << 48; /* fall through */
         case 6: last |= (uint64_t)tail[5] << 40; /* fall through */
         case 5: last |= (uint64_t)tail[4] << 32; /* fall through */
@@ -168,6 +168,24 @@ static uint64_t siphash24(const unsigned char *key16,
         case 1: last |= (uint64_t)tail[0];        /* fall through */
         default: break;
     }
+    return last;
+}
+
+static uint64_t siphash24_keyed(const siphash_key_t *k,
+                                 const unsigned char *data, size_t len)
+{
+    uint64_t v0 = k->v0, v1 = k->v1, v2 = k->v2, v3 = k->v3;
+
+    size_t blocks = len / 8;
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t m = load_le64(data + i * 8);
+        v3 ^= m;
+        SIPHASH_ROUND(v0,v1,v2,v3);
+        SIPHASH_ROUND(v0,v1,v2,v3);
+        v0 ^= m;
+    }
+
+    uint64_t last = siphash_tail(data, len);
     v3 ^= last;
     SIPHASH_ROUND(v0,v1,v2,v3);
     SIPHASH_ROUND(v0,v1,v2,v3);
@@ -182,16 +200,83 @@ static uint64_t siphash24(const unsigned char *key16,
     return v0 ^ v1 ^ v2 ^ v3;
 }
 
+static uint64_t siphash24(const unsigned char *key16,
+                           const unsigned char *data, size_t len)
+{
+    siphash_key_t k;
+    siphash_key_init(&k, key16);
+    return siphash24_keyed(&k, data, len);
+}
+
+/*
+ * Multi-lane SipHash-2-4: SIPHASH_LANES equal-length messages under one key.
+ *
+ * State is kept as one small array per SipHash word and every step is a
+ * plain loop across lanes, so the compiler emits vector adds/xors/rotates
+ * where the target has them (SSE2/AVX2/NEON) and independent scalar chains
+ * otherwise.  No intrinsics: builds unchanged on every platform we ship.
+ */
+#define SIPHASH_LANES 4
+
+#define SIPHASH_ROUND_LANES(v0,v1,v2,v3) do {                            \
+    for (int l_ = 0; l_ < SIPHASH_LANES; l_++) {                         \
+        v0[l_] += v1[l_]; v1[l_] = ROTL64(v1[l_],13); v1[l_] ^= v0[l_];   \
+        v0[l_] = ROTL64(v0[l_],32);                                      \
+        v2[l_] += v3[l_]; v3[l_] = ROTL64(v3[l_],16); v3[l_] ^= v2[l_];   \
+        v0[l_] += v3[l_]; v3[l_] = ROTL64(v3[l_],21); v3[l_] ^= v0[l_];   \
+        v2[l_] += v1[l_]; v1[l_] = ROTL64(v1[l_],17); v1[l_] ^= v2[l_];   \
+        v2[l_] = ROTL64(v2[l_],32);                                      \
+    }                                                                    \
+} while(0)
+
+static void siphash24_lanes(const siphash_key_t *k,
+                             const unsigned char *const data[SIPHASH_LANES],
+                             size_t len, uint64_t out[SIPHASH_LANES])
+{
+    uint64_t v0[SIPHASH_LANES], v1[SIPHASH_LANES];
+    uint64_t v2[SIPHASH_LANES], v3[SIPHASH_LANES];
+    uint64_t m[SIPHASH_LANES];
+
+    for (int l = 0; l < SIPHASH_LANES; l++) {
+        v0[l] = k->v0; v1[l] = k->v1; v2[l] = k->v2; v3[l] = k->v3;
+    }
+
+    size_t blocks = len / 8;
+    for (size_t i = 0; i < blocks; i++) {
+        for (int l = 0; l < SIPHASH_LANES; l++) {
+            m[l] = load_le64(data[l] + i * 8);
+            v3[l] ^= m[l];
+        }
+        SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+        SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+        for (int l = 0; l < SIPHASH_LANES; l++) v0[l] ^= m[l];
+    }
+
+    for (int l = 0; l < SIPHASH_LANES; l++) {
+        m[l] = siphash_tail(data[l], len);
+        v3[l] ^= m[l];
+    }
+    SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+    SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+    for (int l = 0; l < SIPHASH_LANES; l++) {
+        v0[l] ^= m[l];
+        v2[l] ^= 0xff;
+    }
+    SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+    SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+    SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+    SIPHASH_ROUND_LANES(v0,v1,v2,v3);
+    for (int l = 0; l < SIPHASH_LANES; l++)
+        out[l] = v0[l] ^ v1[l] ^ v2[l] ^ v3[l];
+}
+
 /* -------------------------------------------------------------------------
  * BIP 158 hash: map a scriptPubKey to [0, F) where F = N * M
  * Uses 128-bit multiply-shift to avoid modulo bias.
  * ------------------------------------------------------------------------- */
 
-static uint64_t bip158_hash(const unsigned char *key16,
-                             const unsigned char *spk, size_t spk_len,
-                             uint64_t F)
+static uint64_t bip158_reduce(uint64_t h, uint64_t F)
 {
-    uint64_t h = siphash24(key16, spk, spk_len);
 #ifdef __SIZEOF_INT128__
     return (uint64_t)((__uint128_t)h * F >> 64);
 #else
@@ -212,42 +297,108 @@ static uint64_t bip158_hash(const unsigned char *key16,
 #endif
 }
 
+static uint64_t bip158_hash(const unsigned char *key16,
+                             const unsigned char *spk, size_t spk_len,
+                             uint64_t F)
+{
+    return bip158_reduce(siphash24(key16, spk, spk_len), F);
+}
+
+/* Hash n scripts into out[0..n) under one block key.  Runs of
+   SIPHASH_LANES consecutive equal-length scripts (the common case: a watch
+   set is mostly P2TR/P2WSH, all 34 bytes) go through the multi-lane path;
+   anything else falls back to the scalar hash. */
+static void bip158_hash_batch(const unsigned char *key16,
+                               const bip158_script_t *scripts, size_t n,
+                               uint64_t F, uint64_t *out)
+{
+    siphash_key_t k;
+    siphash_key_init(&k, key16);
+
+    size_t i = 0;
+    while (i + SIPHASH_LANES <= n) {
+        size_t len = scripts[i].spk_len;
+        int same = 1;
+        for (int l = 1; l < SIPHASH_LANES; l++)
+            if (scripts[i + l].spk_len != len) { same = 0; break; }
+        if (!same) {
+            out[i] = bip158_reduce(siphash24_keyed(&k, scripts[i].spk, len), F);
+            i++;
+            continue;
+        }
+        const unsigned char *data[SIPHASH_LANES];
+        uint64_t h[SIPHASH_LANES];
+        for (int l = 0; l < SIPHASH_LANES; l++) data[l] = scripts[i + l].spk;
+        siphash24_lanes(&k, data, len, h);
+        for (int l = 0; l < SIPHASH_LANES; l++)
+            out[i + l] = bip158_reduce(h[l], F);
+        i += SIPHASH_LANES;
+    }
+    for (; i < n; i++)
+        out[i] = bip158_reduce(siphash24_keyed(&k, scripts[i].spk,
+                                               scripts[i].spk_len), F);
+}
+
 /* -------------------------------------------------------------------------
  * Bit reader (MSB-first) for Golomb-Rice decoding
+ *
+ * Buffers up to 64 bits left-aligned in acc, refilled a byte at a time, so
+ * the unary quotient is counted with one count-leading-zeros per word
+ * instead of one branch per bit.
  * ------------------------------------------------------------------------- */
 
 typedef struct {
     const unsigned char *data;
-    size_t               len_bits;
-    size_t               pos;    /* current bit position */
+    size_t               len;    /* bytes */
+    size_t               next;   /* next byte to load into acc */
+    uint64_t             acc;    /* buffered bits, MSB-aligned; rest zero */
+    int                  n;      /* number of valid bits in acc */
 } bit_reader_t;
 
 static void bit_reader_init(bit_reader_t *r,
                              const unsigned char *data, size_t len_bytes)
 {
-    r->data     = data;
-    r->len_bits = len_bytes * 8;
-    r->pos      = 0;
+    r->data = data;
+    r->len  = len_bytes;
+    r->next = 0;
+    r->acc  = 0;
+    r->n    = 0;
+}
+
+static void bit_reader_refill(bit_reader_t *r)
+{
+    while (r->n <= 56 && r->next < r->len) {
+        r->acc |= (uint64_t)r->data[r->next++] << (56 - r->n);
+        r->n += 8;
+    }
 }
 
-/* Read one bit (MSB-first). Returns 0 or 1, or -1 on overrun. */
-static int read_bit(bit_reader_t *r)
+static void bit_reader_consume(bit_reader_t *r, int k)
 {
-    if (r->pos >= r->len_bits) return -1;
-    int bit = (r->data[r->pos / 8] >> (7 - (r->pos % 8))) & 1;
-    r->pos++;
-    return bit;
+    r->acc = (k >= 64) ? 0 : r->acc << k;
+    r->n  -= k;
+}
+
+static int clz64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while (!(x & (1ULL << 63))) { x <<= 1; n++; }
+    return n;
+#endif
 }
 
-/* Read P bits as a uint64. Returns -1 on overrun. */
+/* Read p (<= 57) bits as a uint64. Returns -1 on overrun. */
 static int64_t read_bits(bit_reader_t *r, int p)
 {
-    uint64_t val = 0;
-    for (int i = 0; i < p; i++) {
-        int b = read_bit(r);
-        if (b < 0) return -1;
-        val = (val << 1) | (uint64_t)b;
+    if (r->n < p) {
+        bit_reader_refill(r);
+        if (r->n < p) return -1;
     }
+    uint64_t val = r->acc >> (64 - p);
+    bit_reader_consume(r, p);
     return (int64_t)val;
 }
 
@@ -257,11 +408,25 @@ static int64_t golomb_rice_decode(bit_reader_t *r)
     /* Unary quotient: q one-bits followed by a zero-bit (BIP 158 Golomb-Rice).
        Bound to prevent runaway decode on malformed / fuzz input. */
     uint64_t q = 0;
-    int b;
-    while ((b = read_bit(r)) == 1) {
-        if (++q > (1ULL << 30)) return -1;  /* unreasonably large quotient */
+    for (;;) {
+        if (r->n == 0) {
+            bit_reader_refill(r);
+            if (r->n == 0) return -1;  /* overrun */
+        }
+        /* Bits past n are zero in acc, hence one in ~acc: the count is
+           capped at n without masking. */
+        uint64_t inv  = ~r->acc;
+        int      ones = inv ? clz64(inv) : 64;
+        if (ones < r->n) {
+            q += (uint64_t)ones;
+            bit_reader_consume(r, ones + 1);
+            break;
+        }
+        q += (uint64_t)r->n;
+        bit_reader_consume(r, r->n);
+        if (q > (1ULL << 30)) return -1;  /* unreasonably large quotient */
     }
-    if (b < 0) return -1;  /* overrun */
+    if (q > (1ULL << 30)) return -1;
 
     /* P-bit remainder */
     int64_t rem = read_bits(r, BIP158_P);
@@ -387,6 +552,15 @@ uint64_t _bip158_test_hash(const unsigned char *key16,
     return bip158_hash(key16, spk, spk_len, F);
 }
 
+/* Test-only export: the multi-lane batch path, compared against the scalar
+ * hash above by the unit tests. */
+void _bip158_test_hash_batch(const unsigned char *key16,
+                              const bip158_script_t *scripts, size_t n,
+                              uint64_t F, uint64_t *out)
+{
+    bip158_hash_batch(key16, scripts, n, F, out);
+}
+
 /* -------------------------------------------------------------------------
  * GCS batch match (public, exposed for unit tests)
  *
@@ -396,37 +570,64 @@ uint64_t _bip158_test_hash(const unsigned char *key16,
  * key16: 16-byte SipHash key (first 16 bytes of the block hash).
  *
  * Algorithm:
- *   1. Hash each watched script to [0, F) where F = N * M
- *   2. Sort query hashes
+ *   1. Hash each watched script to [0, F) where F = N * M (multi-lane SipHash)
+ *   2. Sort query hashes (radix sort)
  *   3. Decode the GCS (sorted delta-encoded values) and merge with queries
  * Returns 1 on any match (including false positives), 0 if no match.
  * ------------------------------------------------------------------------- */
 
-static int cmp_uint64(const void *a, const void *b)
+/* Sort v[0..n) ascending.  Values are < F, so an LSD radix sort needs only
+   as many byte passes as F has bytes (3-4 for realistic filters).  tmp must
+   hold n values.  Small inputs use insertion sort. */
+static void sort_hashes(uint64_t *v, uint64_t *tmp, size_t n, uint64_t F)
 {
-    uint64_t x = *(const uint64_t *)a;
-    uint64_t y = *(const uint64_t *)b;
-    return (x > y) - (x < y);
+    if (n < 64) {
+        for (size_t i = 1; i < n; i++) {
+            uint64_t x = v[i];
+            size_t j = i;
+            while (j > 0 && v[j - 1] > x) { v[j] = v[j - 1]; j--; }
+            v[j] = x;
+        }
+        return;
+    }
+
+    int passes = 0;
+    for (uint64_t top = F ? F - 1 : 0; top; top >>= 8) passes++;
+
+    uint64_t *src = v, *dst = tmp;
+    for (int p = 0; p < passes; p++) {
+        int    shift = p * 8;
+        size_t count[256];
+        memset(count, 0, sizeof(count));
+        for (size_t i = 0; i < n; i++) count[(src[i] >> shift) & 0xff]++;
+        size_t sum = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t c = count[b];
+            count[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++)
+            dst[count[(src[i] >> shift) & 0xff]++] = src[i];
+        uint64_t *t = src; src = dst; dst = t;
+    }
+    if (src != v) memcpy(v, src, n * sizeof(uint64_t));
 }
 
-int bip158_gcs_match_any(const unsigned char *filter_data, size_t filter_len,
-                          uint64_t n_items,
-                          const unsigned char *key16,
-                          const bip158_script_t *scripts, size_t n_scripts)
+/* Match with caller-provided scratch of at least 2 * n_scripts values. */
+static int gcs_match_any_scratch(const unsigned char *filter_data, size_t filter_len,
+                                  uint64_t n_items,
+                                  const unsigned char *key16,
+                                  const bip158_script_t *scripts, size_t n_scripts,
+                                  uint64_t *scratch)
 {
-    if (!n_items || !n_scripts || !filter_data || !scripts) return 0;
-
     /* Guard against overflow in F = n_items * M */
     if (n_items > UINT64_MAX / BIP158_M) return 0;
     uint64_t F = n_items * BIP158_M;
 
     /* Hash all watched scripts */
-    uint64_t *qhash = malloc(n_scripts * sizeof(uint64_t));
-    if (!qhash) return 0;
-    for (size_t i = 0; i < n_scripts; i++)
-        qhash[i] = bip158_hash(key16, scripts[i].spk, scripts[i].spk_len, F);
-
-    qsort(qhash, n_scripts, sizeof(uint64_t), cmp_uint64);
+    uint64_t *qhash = scratch;
+    bip158_hash_batch(key16, scripts, n_scripts, F, qhash);
+    sort_hashes(qhash, scratch + n_scripts, n_scripts, F);
 
     /* Merge-scan the GCS */
     bit_reader_t r;
@@ -434,7 +635,6 @@ int bip158_gcs_match_any(const unsigned char *filter_data, size_t filter_len,
 
     uint64_t value = 0;
     size_t   qi    = 0;
-    int      found = 0;
 
     for (uint64_t i = 0; i < n_items && qi < n_scripts; i++) {
         int64_t delta = golomb_rice_decode(&r);
@@ -445,13 +645,28 @@ int bip158_gcs_match_any(const unsigned char *filter_data, size_t filter_len,
         while (qi < n_scripts && qhash[qi] < value)
             qi++;
 
-        if (qi < n_scripts && qhash[qi] == value) {
-            found = 1;
-            break;
-        }
+        if (qi < n_scripts && qhash[qi] == value)
+            return 1;
     }
+    return 0;
+}
 
-    free(qhash);
+int bip158_gcs_match_any(const unsigned char *filter_data, size_t filter_len,
+                          uint64_t n_items,
+                          const unsigned char *key16,
+                          const bip158_script_t *scripts, size_t n_scripts)
+{
+    if (!n_items || !n_scripts || !filter_data || !scripts) return 0;
+
+    uint64_t  stack_buf[128];
+    uint64_t *scratch = stack_buf;
+    if (n_scripts > sizeof(stack_buf) / sizeof(stack_buf[0]) / 2) {
+        scratch = malloc(2 * n_scripts * sizeof(uint64_t));
+        if (!scratch) return 0;
+    }
+    int found = gcs_match_any_scratch(filter_data, filter_len, n_items, key16,
+                                      scripts, n_scripts, scratch);
+    if (scratch != stack_buf) free(scratch);
     return found;
 }
 
@@ -494,11 +709,10 @@ size_t bip158_gcs_build(const bip158_script_t *scripts, size_t n,
     /* Hash all scripts into [0, F) */
     uint64_t *vals = NULL;
     if (n > 0) {
-        vals = malloc(n * sizeof(uint64_t));
+        vals = malloc(2 * n * sizeof(uint64_t));
         if (!vals) return 0;
-        for (size_t i = 0; i < n; i++)
-            vals[i] = bip158_hash(key16, scripts[i].spk, scripts[i].spk_len, F);
-        qsort(vals, n, sizeof(uint64_t), cmp_uint64);
+        bip158_hash_batch(key16, scripts, n, F, vals);
+        sort_hashes(vals, vals + n, n, F);
     }
 
     /* Write varint(N) */
@@ -603,6 +817,29 @@ static bool cb_is_in_mempool(chain_backend_t *self, const char *txid_hex)
     return false;
 }
 
+/* Block hash from the synced header ring; falls back to RPC when the
+   height is outside the window.  No get_block slot: a light client only
+   downloads filter-matched blocks, so chain events from this backend are
+   header-only. */
+static int cb_get_block_hash(chain_backend_t *self, int height,
+                              char *hash_hex_out)
+{
+    bip158_backend_t *b = (bip158_backend_t *)self;
+    if (height < 0 || !hash_hex_out) return 0;
+    if (b->headers_synced >= height &&
+        b->headers_synced - height < BIP158_HEADER_WINDOW) {
+        const uint8_t *hh = b->header_hashes[height % BIP158_HEADER_WINDOW];
+        for (int i = 0; i < 32; i++)
+            sprintf(hash_hex_out + i * 2, "%02x", hh[31 - i]);
+        hash_hex_out[64] = '\0';
+        return 1;
+    }
+    if (b->rpc_ctx)
+        return regtest_get_block_hash((regtest_t *)b->rpc_ctx, height,
+                                      hash_hex_out, 65);
+    return 0;
+}
+
 /* hex_decode: convert an even-length hex string to bytes.
    Returns number of bytes written, or -1 on invalid input. */
 static int hex_decode(const char *hex, unsigned char *out, size_t max_out)
@@ -655,34 +892,45 @@ static int cb_register_script(chain_backend_t *self,
 {
     bip158_backend_t *b = (bip158_backend_t *)self;
     if (!spk || spk_len == 0 || spk_len > 34) return 0;
-    if (b->n_scripts >= BIP158_MAX_SCRIPTS)    return 0;
+    int ok = 1;
+    pthread_mutex_lock(&b->scripts_lock);
 
     /* Deduplicate */
     for (size_t i = 0; i < b->n_scripts; i++) {
         if (b->scripts[i].spk_len == spk_len &&
             memcmp(b->scripts[i].spk, spk, spk_len) == 0)
-            return 1;
+            goto out;
+    }
+    if (b->n_scripts >= BIP158_MAX_SCRIPTS) {
+        ok = 0;
+        goto out;
     }
 
     memcpy(b->scripts[b->n_scripts].spk, spk, spk_len);
     b->scripts[b->n_scripts].spk_len = spk_len;
     b->n_scripts++;
-    return 1;
+out:
+    pthread_mutex_unlock(&b->scripts_lock);
+    return ok;
 }
 
 static int cb_unregister_script(chain_backend_t *self,
                                  const unsigned char *spk, size_t spk_len)
 {
     bip158_backend_t *b = (bip158_backend_t *)self;
+    int found = 0;
+    pthread_mutex_lock(&b->scripts_lock);
     for (size_t i = 0; i < b->n_scripts; i++) {
         if (b->scripts[i].spk_len == spk_len &&
             memcmp(b->scripts[i].spk, spk, spk_len) == 0) {
             /* Swap with last */
             b->scripts[i] = b->scripts[--b->n_scripts];
-            return 1;
+            found = 1;
+            break;
         }
     }
-    return 0;
+    pthread_mutex_unlock(&b->scripts_lock);
+    return found;
 }
 
 /* -------------------------------------------------------------------------
@@ -796,6 +1044,7 @@ int bip158_backend_init(bip158_backend_t *backend, const char *network)
 {
     if (!backend) return 0;
     memset(backend, 0, sizeof(*backend));
+    pthread_mutex_init(&backend->scripts_lock, NULL);
 
     backend->base.get_block_height  = cb_get_block_height;
     backend->base.get_confirmations = cb_get_confirmations;
@@ -803,6 +1052,7 @@ int bip158_backend_init(bip158_backend_t *backend, const char *network)
     backend->base.send_raw_tx       = cb_send_raw_tx;
     backend->base.register_script   = cb_register_script;
     backend->base.unregister_script = cb_unregister_script;
+    backend->base.get_block_hash    = cb_get_block_hash;
     backend->base.ctx               = backend;
     conf_targets_default(&backend->base.conf);
     backend->base.is_regtest = (network && strcmp(network, "regtest") == 0);
@@ -828,6 +1078,10 @@ void bip158_backend_free(bip158_backend_t *backend)
     for (int i = 0; i < BIP158_MAX_PEERS; i++) {
         p2p_close(&backend->peers[i]);
     }
+    free(backend->match_scratch);
+    backend->match_scratch     = NULL;
+    backend->match_scratch_cap = 0;
+    pthread_mutex_destroy(&backend->scripts_lock);
 }
 
 /*
@@ -839,15 +1093,32 @@ int bip158_scan_filter(bip158_backend_t *backend,
                         const unsigned char *filter_bytes, size_t filter_len,
                         const unsigned char *key16)
 {
-    if (!backend->n_scripts || !filter_bytes || filter_len < 1) return 0;
+    if (!filter_bytes || filter_len < 1) return 0;
 
     uint64_t n_items = 0;
     size_t   hdr     = read_varint(filter_bytes, filter_len, &n_items);
     if (!hdr || !n_items) return 0;
 
-    return bip158_gcs_match_any(filter_bytes + hdr, filter_len - hdr,
-                                 n_items, key16,
-                                 backend->scripts, backend->n_scripts);
+    /* Query hash + radix buffers live on the backend and grow with the watch
+       set, so a rescan over many blocks allocates once.  Sized and used
+       under scripts_lock so a concurrent register cannot outgrow them. */
+    int hit = 0;
+    pthread_mutex_lock(&backend->scripts_lock);
+    size_t need = 2 * backend->n_scripts;
+    if (need > backend->match_scratch_cap) {
+        uint64_t *p = realloc(backend->match_scratch, need * sizeof(uint64_t));
+        if (!p) goto out;
+        backend->match_scratch     = p;
+        backend->match_scratch_cap = need;
+    }
+    if (backend->n_scripts)
+        hit = gcs_match_any_scratch(filter_bytes + hdr, filter_len - hdr,
+                                    n_items, key16,
+                                    backend->scripts, backend->n_scripts,
+                                    backend->match_scratch);
+out:
+    pthread_mutex_unlock(&backend->scripts_lock);
+    return hit;
 }
 
 /* -------------------------------------------------------------------------
@@ -949,27 +1220,69 @@ static void scan_tx_callback(const char *txid_hex,
 {
     scan_cb_ctx_t    *sc = (scan_cb_ctx_t *)ctx;
     bip158_backend_t *b  = sc->backend;
+    int hit = 0;
 
-    for (size_t i = 0; i < n_outputs; i++) {
+    pthread_mutex_lock(&b->scripts_lock);
+    for (size_t i = 0; i < n_outputs && !hit; i++) {
         for (size_t j = 0; j < b->n_scripts; j++) {
             if (b->scripts[j].spk_len == spk_lens[i] &&
                 memcmp(b->scripts[j].spk, spks[i], spk_lens[i]) == 0) {
-                /* Convert display-order hex txid to internal byte order:
-                   decode 64-char hex then reverse the 32 bytes. */
-                unsigned char txid[32];
-                if (hex_decode(txid_hex, txid, 32) == 32) {
-                    for (int lo = 0, hi = 31; lo < hi; lo++, hi--) {
-                        unsigned char t = txid[lo];
-                        txid[lo] = txid[hi];
-                        txid[hi] = t;
-                    }
-                    bip158_cache_tx(b, txid, sc->height);
-                }
-                sc->found = 1;
-                return;  /* one cache entry per tx is sufficient */
+                hit = 1;
+                break;
             }
         }
     }
+    pthread_mutex_unlock(&b->scripts_lock);
+    if (!hit) return;
+
+    /* Convert display-order hex txid to internal byte order:
+       decode 64-char hex then reverse the 32 bytes. */
+    unsigned char txid[32];
+    if (hex_decode(txid_hex, txid, 32) == 32) {
+        for (int lo = 0, hi = 31; lo < hi; lo++, hi--) {
+            unsigned char t = txid[lo];
+            txid[lo] = txid[hi];
+            txid[hi] = t;
+        }
+        bip158_cache_tx(b, txid, sc->height);
+    }
+    sc->found = 1;  /* one cache entry per tx is sufficient */
+}
+
+/* Replay a parsed block from the block cache through scan_tx_callback and
+   the UTXO callbacks, in the same per-tx order (outputs, then inputs) as
+   a fresh p2p_scan_block_full pass.  Returns 1, or 0 on alloc failure. */
+static int scan_cached_block(const block_cache_entry_t *e, scan_cb_ctx_t *sc)
+{
+    bip158_backend_t *b = sc->backend;
+    const unsigned char **spks = calloc(e->n_outputs ? e->n_outputs : 1,
+                                        sizeof(*spks));
+    size_t *lens = calloc(e->n_outputs ? e->n_outputs : 1, sizeof(*lens));
+    if (!spks || !lens) { free(spks); free(lens); return 0; }
+
+    size_t oi = 0, si = 0;
+    for (size_t t = 0; t < e->n_tx; t++) {
+        size_t first = oi;
+        for (; oi < e->n_outputs && e->outputs[oi].tx_index == t; oi++) {
+            const block_cache_output_t *o = &e->outputs[oi];
+            spks[oi - first] = e->spk_data + o->spk_off;
+            lens[oi - first] = o->spk_len;
+            if (b->utxo_found_cb)
+                b->utxo_found_cb(e->txids[t], o->vout, o->amount_sats,
+                                 e->spk_data + o->spk_off, o->spk_len,
+                                 b->utxo_cb_ctx);
+        }
+        for (; si < e->n_spends && e->spends[si].tx_index == t; si++) {
+            if (b->utxo_spent_cb)
+                b->utxo_spent_cb(e->txids[t], e->spends[si].prev_txid,
+                                 e->spends[si].prev_vout, b->utxo_cb_ctx);
+        }
+        if (oi > first)
+            scan_tx_callback(e->txids[t], oi - first, spks, lens, sc);
+    }
+    free(spks);
+    free(lens);
+    return 1;
 }
 
 /*
@@ -1411,13 +1724,592 @@ int bip158_backend_connect_all(bip158_backend_t *backend)
     return connected;
 }
 
+/* -------------------------------------------------------------------------
+ * Parallel P2P scan (Phase 8)
+ *
+ * The range is scanned in segments of up to BIP158_SCAN_RING heights.  For
+ * each, one fetch thread per connected peer pulls jobs from a shared queue:
+ * getcfilters chunks, and getdata batches for filter hits (served first, so
+ * block downloads overlap the remaining filter traffic).  Each received
+ * filter goes to a worker pool for BIP 157 header validation and GCS
+ * matching against a copy of the watch set taken under scripts_lock when
+ * the segment starts.  Once the segment's threads are joined, the calling
+ * thread commits its heights strictly in order from a ring of per-height
+ * slots and runs every user-visible callback itself, so subscribers see
+ * the same sequence as a serial scan and nothing else is using the peers.
+ * ------------------------------------------------------------------------- */
+
+#define BIP158_SCAN_CHUNK        250   /* heights per getcfilters job          */
+#define BIP158_SCAN_RING        2000   /* heights per segment                  */
+#define BIP158_SCAN_BLOCK_BATCH   16   /* getdata requests pipelined per peer  */
+#define BIP158_SCAN_MAX_WORKERS    8
+
+typedef enum {
+    SLOT_QUEUED,        /* filter requested                            */
+    SLOT_HIT,           /* filter matched; block download queued       */
+    SLOT_NO_MATCH,      /* resolved: nothing to do but advance         */
+    SLOT_CACHED,        /* resolved: parsed block in the block cache   */
+    SLOT_BLOCK,         /* resolved: raw block downloaded              */
+    SLOT_BLOCK_FAILED,  /* resolved: hit, but no peer served the block */
+    SLOT_FAILED         /* resolved: no valid filter from any peer     */
+} scan_slot_state_t;
+
+typedef struct {
+    scan_slot_state_t state;
+    int               attempts;
+    uint8_t           hash[32];
+    uint8_t          *block;
+    size_t            block_len;
+} scan_slot_t;
+
+typedef struct scan_job {
+    struct scan_job *next;
+    int              start, end;   /* heights; start == end for a block job */
+    int              attempts;
+} scan_job_t;
+
+typedef struct scan_filter {
+    struct scan_filter *next;
+    int                 height;
+    int                 peer;
+    uint8_t             hash[32];
+    uint8_t             key[16];
+    uint8_t            *data;
+    size_t              len;
+} scan_filter_t;
+
+struct scan_pipe;
+
+typedef struct {
+    struct scan_pipe *pipe;
+    int               peer;
+} scan_fetch_arg_t;
+
+typedef struct scan_pipe {
+    bip158_backend_t *b;
+    bip158_script_t  *scripts;     /* watch set when the segment started */
+    size_t            n_scripts;
+    pthread_mutex_t   lock;
+    pthread_cond_t    job_cv;      /* fetchers: job queued, peer flagged, done */
+    pthread_cond_t    filter_cv;   /* workers: filter queued, done             */
+    pthread_cond_t    commit_cv;   /* committer: slot resolved, thread exited  */
+    scan_slot_t       ring[BIP158_SCAN_RING];
+    scan_job_t       *block_head, *block_tail;
+    scan_job_t       *chunk_head, *chunk_tail;
+    scan_filter_t    *filt_head, *filt_tail;
+    int               n_fetchers;  /* fetch threads started  */
+    int               n_live;      /* fetch threads running  */
+    int               n_busy;      /* workers mid-filter     */
+    int               peer_bad[BIP158_MAX_PEERS];
+    int               done;
+    scan_fetch_arg_t  fetch_args[BIP158_MAX_PEERS];
+} scan_pipe_t;
+
+static scan_slot_t *scan_slot(scan_pipe_t *p, int height)
+{
+    return &p->ring[height % BIP158_SCAN_RING];
+}
+
+static int scan_slot_resolved(const scan_slot_t *s)
+{
+    return s->state >= SLOT_NO_MATCH;
+}
+
+/* Queue helpers — lock held. */
+static void scan_job_push(scan_job_t **head, scan_job_t **tail, scan_job_t *j)
+{
+    j->next = NULL;
+    if (*tail) (*tail)->next = j; else *head = j;
+    *tail = j;
+}
+
+static scan_job_t *scan_job_pop(scan_job_t **head, scan_job_t **tail)
+{
+    scan_job_t *j = *head;
+    if (j) {
+        *head = j->next;
+        if (!*head) *tail = NULL;
+    }
+    return j;
+}
+
+static int scan_queue_job(scan_pipe_t *p, int block, int start, int end)
+{
+    scan_job_t *j = calloc(1, sizeof(*j));
+    if (!j) return 0;
+    j->start = start;
+    j->end   = end;
+    if (block) scan_job_push(&p->block_head, &p->block_tail, j);
+    else       scan_job_push(&p->chunk_head, &p->chunk_tail, j);
+    pthread_cond_broadcast(&p->job_cv);
+    return 1;
+}
+
+/* Hand a job back after a peer failed it.  Each job may be tried once per
+   fetcher; past that its heights resolve as failed so the committer stops
+   (filters) or falls back to RPC (blocks) instead of waiting forever. */
+static void scan_requeue(scan_pipe_t *p, scan_job_t *j, int block)
+{
+    pthread_mutex_lock(&p->lock);
+    if (++j->attempts < p->n_fetchers) {
+        if (block) scan_job_push(&p->block_head, &p->block_tail, j);
+        else       scan_job_push(&p->chunk_head, &p->chunk_tail, j);
+        pthread_cond_broadcast(&p->job_cv);
+    } else {
+        for (int h = j->start; h <= j->end; h++)
+            scan_slot(p, h)->state = block ? SLOT_BLOCK_FAILED : SLOT_FAILED;
+        free(j);
+        pthread_cond_broadcast(&p->commit_cv);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+static int scan_fetch_chunk(scan_pipe_t *p, int peer, scan_job_t *j)
+{
+    bip158_backend_t *b    = p->b;
+    p2p_conn_t       *conn = &b->peers[peer];
+    const uint8_t    *stop = b->header_hashes[j->end % BIP158_HEADER_WINDOW];
+
+    if (!p2p_send_getcfilters(conn, (uint32_t)j->start, stop)) {
+        scan_requeue(p, j, 0);
+        return 0;
+    }
+    for (int h = j->start; h <= j->end; h++) {
+        scan_filter_t *f = calloc(1, sizeof(*f));
+        int r = f ? p2p_recv_cfilter(conn, f->hash, &f->data, &f->len, f->key) : 0;
+        if (r != 1) {
+            if (f) free(f->data);
+            free(f);
+            j->start = h;   /* the rest of the chunk goes to another peer */
+            scan_requeue(p, j, 0);
+            return 0;
+        }
+        f->height = h;
+        f->peer   = peer;
+        pthread_mutex_lock(&p->lock);
+        if (p->filt_tail) p->filt_tail->next = f; else p->filt_head = f;
+        p->filt_tail = f;
+        pthread_cond_signal(&p->filter_cv);
+        int bad = p->peer_bad[peer];
+        pthread_mutex_unlock(&p->lock);
+
+        /* A worker rejected one of this peer's filters: stop trusting the
+           rest of the chunk. */
+        if (bad && h < j->end) {
+            j->start = h + 1;
+            scan_requeue(p, j, 0);
+            return 0;
+        }
+    }
+    free(j);
+    return 1;
+}
+
+/* Send getdata for every block in the batch, then receive them.  Peers
+   answer in request order; the hash check tolerates reordering anyway. */
+static int scan_fetch_blocks(scan_pipe_t *p, int peer,
+                             scan_job_t **batch, int n)
+{
+    p2p_conn_t *conn = &p->b->peers[peer];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (!p2p_send_getdata_block(conn, scan_slot(p, batch[i]->start)->hash))
+            break;
+    }
+    if (i < n) {
+        for (i = 0; i < n; i++) scan_requeue(p, batch[i], 1);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {
+        uint8_t *blk  = NULL;
+        size_t   blen = 0;
+        int      k    = n;
+        if (p2p_recv_block(conn, &blk, &blen) == 1 && blen >= 80) {
+            uint8_t h[32];
+            sha256_double(blk, 80, h);
+            for (k = i; k < n; k++)
+                if (memcmp(h, scan_slot(p, batch[k]->start)->hash, 32) == 0) break;
+        }
+        if (k == n) {
+            free(blk);
+            for (; i < n; i++) scan_requeue(p, batch[i], 1);
+            return 0;
+        }
+        scan_job_t *t = batch[i]; batch[i] = batch[k]; batch[k] = t;
+
+        pthread_mutex_lock(&p->lock);
+        scan_slot_t *s = scan_slot(p, batch[i]->start);
+        s->block     = blk;
+        s->block_len = blen;
+        s->state     = SLOT_BLOCK;
+        pthread_cond_broadcast(&p->commit_cv);
+        pthread_mutex_unlock(&p->lock);
+        free(batch[i]);
+    }
+    return 1;
+}
+
+static void *scan_fetch_thread(void *arg)
+{
+    scan_fetch_arg_t *fa = (scan_fetch_arg_t *)arg;
+    scan_pipe_t      *p  = fa->pipe;
+    int               ok = 1;
+
+    pthread_mutex_lock(&p->lock);
+    while (ok && !p->done && !p->peer_bad[fa->peer]) {
+        if (p->block_head) {
+            scan_job_t *batch[BIP158_SCAN_BLOCK_BATCH];
+            int n = 0;
+            while (n < BIP158_SCAN_BLOCK_BATCH && p->block_head)
+                batch[n++] = scan_job_pop(&p->block_head, &p->block_tail);
+            pthread_mutex_unlock(&p->lock);
+            ok = scan_fetch_blocks(p, fa->peer, batch, n);
+            pthread_mutex_lock(&p->lock);
+        } else if (p->chunk_head) {
+            scan_job_t *j = scan_job_pop(&p->chunk_head, &p->chunk_tail);
+            pthread_mutex_unlock(&p->lock);
+            ok = scan_fetch_chunk(p, fa->peer, j);
+            pthread_mutex_lock(&p->lock);
+        } else {
+            pthread_cond_wait(&p->job_cv, &p->lock);
+        }
+    }
+    int drop = !ok || p->peer_bad[fa->peer];
+    pthread_mutex_unlock(&p->lock);
+
+    /* Only this thread touches the connection while the scan runs. */
+    if (drop) {
+        fprintf(stderr, "BIP158: dropping peer %d (%s:%d) after failed "
+                "filter/block request\n", fa->peer,
+                p->b->peer_hosts[fa->peer], p->b->peer_ports[fa->peer]);
+        p2p_close(&p->b->peers[fa->peer]);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->n_live--;
+    pthread_cond_broadcast(&p->commit_cv);
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/* Validate a filter against the synced BIP 157 header chain and match it
+   against the pipe's snapshot of the watch set.  Returns -1 on header
+   mismatch, else 1 on match, 0 on none. */
+static int scan_check_filter(const scan_pipe_t *p, const scan_filter_t *f,
+                             uint64_t *scratch)
+{
+    const bip158_backend_t *b = p->b;
+    if (!f->len) return 0;
+    if (b->filter_headers_synced >= f->height) {
+        static const uint8_t genesis_prev[32] = {0};
+        const uint8_t *prev_fh =
+            (f->height > 0)
+            ? b->filter_headers[(f->height - 1) % BIP158_HEADER_WINDOW]
+            : genesis_prev;
+        uint8_t computed_fh[32];
+        compute_filter_header(f->data, f->len, prev_fh, computed_fh);
+        if (memcmp(computed_fh,
+                   b->filter_headers[f->height % BIP158_HEADER_WINDOW], 32) != 0)
+            return -1;
+    }
+
+    uint64_t n_items = 0;
+    size_t   hdr     = read_varint(f->data, f->len, &n_items);
+    if (!hdr || !n_items) return 0;
+    if (!scratch)
+        return bip158_gcs_match_any(f->data + hdr, f->len - hdr, n_items,
+                                     f->key, p->scripts, p->n_scripts);
+    return gcs_match_any_scratch(f->data + hdr, f->len - hdr, n_items, f->key,
+                                 p->scripts, p->n_scripts, scratch);
+}
+
+static void *scan_match_thread(void *arg)
+{
+    scan_pipe_t      *p = (scan_pipe_t *)arg;
+    uint64_t *scratch = malloc(2 * p->n_scripts * sizeof(uint64_t));
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->filt_head && !p->done)
+            pthread_cond_wait(&p->filter_cv, &p->lock);
+        if (p->done) break;
+        scan_filter_t *f = p->filt_head;
+        p->filt_head = f->next;
+        if (!p->filt_head) p->filt_tail = NULL;
+        p->n_busy++;
+        pthread_mutex_unlock(&p->lock);
+
+        int verdict = scan_check_filter(p, f, scratch);
+        int cached  = 0;
+        if (verdict == 1) {
+            char hx[65];
+            for (int i = 0; i < 32; i++)
+                sprintf(hx + i * 2, "%02x", f->hash[31 - i]);
+            block_cache_t       *bc = block_cache_shared();
+            block_cache_entry_t *e  = block_cache_get(bc, hx);
+            cached = e && e->has_io;
+            block_cache_release(bc, e);
+        }
+
+        pthread_mutex_lock(&p->lock);
+        p->n_busy--;
+        scan_slot_t *s = scan_slot(p, f->height);
+        memcpy(s->hash, f->hash, 32);
+        if (verdict < 0) {
+            /* Peer sent a filter that doesn't match the committed header —
+               likely a misbehaving or stale peer.  Drop it, ask another. */
+            p->peer_bad[f->peer] = 1;
+            if (++s->attempts >= p->n_fetchers ||
+                !scan_queue_job(p, 0, f->height, f->height))
+                s->state = SLOT_FAILED;
+            pthread_cond_broadcast(&p->job_cv);
+        } else if (verdict == 0) {
+            s->state = SLOT_NO_MATCH;
+        } else if (cached) {
+            s->state = SLOT_CACHED;
+        } else {
+            s->state = SLOT_HIT;
+            if (!scan_queue_job(p, 1, f->height, f->height))
+                s->state = SLOT_BLOCK_FAILED;
+        }
+        pthread_cond_broadcast(&p->commit_cv);
+        free(f->data);
+        free(f);
+    }
+    pthread_mutex_unlock(&p->lock);
+    free(scratch);
+    return NULL;
+}
+
+/* Commit one height on the calling thread: scan the block for a hit, fire
+   callbacks, advance tip_height.  Returns 1 if a watched script was found. */
+static int scan_commit_height(bip158_backend_t *b, int h,
+                              scan_slot_state_t state, const uint8_t hash[32],
+                              uint8_t *blk, size_t blen)
+{
+    regtest_t *rt = (regtest_t *)b->rpc_ctx;
+    int found = 0;
+
+    if (state != SLOT_NO_MATCH) {
+        /* Filter hit: scan the block downloaded via P2P, or replay one that
+           another consumer already parsed from the shared block cache (no
+           fee sample in that case: the raw coinbase is not kept).  Falls
+           back to RPC if no peer served the block. */
+        scan_cb_ctx_t sc = { b, (int32_t)h, 0 };
+        int block_scanned = 0;
+        char hx[65];
+        for (int i = 0; i < 32; i++)
+            sprintf(hx + i*2, "%02x", hash[31 - i]);
+        hx[64] = 0;
+        block_cache_t *bc = block_cache_shared();
+
+        if (state == SLOT_CACHED) {
+            block_cache_entry_t *cached = block_cache_get(bc, hx);
+            if (cached && cached->has_io && scan_cached_block(cached, &sc))
+                block_scanned = 1;
+            block_cache_release(bc, cached);
+        } else if (state == SLOT_BLOCK && blk) {
+            p2p_scan_block_txs(blk, blen, (p2p_block_scan_cb_t)scan_tx_callback,
+                               &sc);
+            block_scanned = 1;
+            block_cache_release(bc, block_cache_put_raw(bc, hx, h, blk, blen));
+
+            /* Fire UTXO tracking callbacks if registered */
+            if (b->utxo_found_cb || b->utxo_spent_cb)
+                p2p_scan_block_full(blk, blen, b->utxo_found_cb,
+                                    b->utxo_spent_cb, b->utxo_cb_ctx);
+
+            /* Extract fee sample from coinbase for fee estimator */
+            if (b->fee_estimator && blen > 80 + 4 + 1) {
+                uint64_t sample = bip158_extract_block_fee_sample(
+                    blk, blen, (uint32_t)h);
+                if (sample > 0)
+                    fee_estimator_blocks_add_sample(
+                        (fee_estimator_blocks_t *)b->fee_estimator, sample);
+            }
+        }
+        /* Phase 5: fall back to RPC scan if P2P block download failed */
+        if (!block_scanned && rt) {
+            regtest_scan_block_txs(rt, hx, scan_tx_callback, &sc);
+        } else if (!block_scanned) {
+            fprintf(stderr, "BIP158: block %d P2P download failed, no RPC fallback\n", h);
+        }
+        found = sc.found;
+    }
+
+    b->tip_height = h;
+    if (b->block_connected_cb)
+        b->block_connected_cb((uint32_t)h, b->block_connected_ctx);
+    return found;
+}
+
+static scan_pipe_t *scan_pipe_new(bip158_backend_t *b)
+{
+    scan_pipe_t *p = calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    p->b = b;
+    pthread_mutex_lock(&b->scripts_lock);
+    size_t n = b->n_scripts;
+    if (n && (p->scripts = malloc(n * sizeof(bip158_script_t)))) {
+        memcpy(p->scripts, b->scripts, n * sizeof(bip158_script_t));
+        p->n_scripts = n;
+    }
+    pthread_mutex_unlock(&b->scripts_lock);
+    if (n && !p->scripts) {
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->job_cv, NULL);
+    pthread_cond_init(&p->filter_cv, NULL);
+    pthread_cond_init(&p->commit_cv, NULL);
+    return p;
+}
+
+static void scan_pipe_free(scan_pipe_t *p)
+{
+    for (int i = 0; i < BIP158_SCAN_RING; i++) free(p->ring[i].block);
+    free(p->scripts);
+    pthread_cond_destroy(&p->commit_cv);
+    pthread_cond_destroy(&p->filter_cv);
+    pthread_cond_destroy(&p->job_cv);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+
+/* Fetch and match the filters of [start, end], at most BIP158_SCAN_RING
+   heights, leaving each height's outcome in its ring slot.  Every thread
+   has been joined on return.  Returns how many heights from start on are
+   resolved; the first one after them could not be served. */
+static int scan_run_segment(scan_pipe_t *p, int start, int end)
+{
+    bip158_backend_t *b = p->b;
+
+    pthread_t fetch_tids[BIP158_MAX_PEERS];
+    int       fetch_peer[BIP158_MAX_PEERS];
+    for (int i = 0; i < BIP158_MAX_PEERS; i++) {
+        if (b->peers[i].fd < 0) continue;
+        p->fetch_args[p->n_fetchers].pipe = p;
+        p->fetch_args[p->n_fetchers].peer = i;
+        fetch_peer[p->n_fetchers] = i;
+        p->n_fetchers++;
+    }
+    p->n_live = p->n_fetchers;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int  n_workers = ncpu < 1 ? 1 : ncpu > BIP158_SCAN_MAX_WORKERS
+                                    ? BIP158_SCAN_MAX_WORKERS : (int)ncpu;
+    pthread_t work_tids[BIP158_SCAN_MAX_WORKERS];
+    int n_work_started = 0, n_fetch_started = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (int i = 0; i < p->n_fetchers; i++) {
+        if (pthread_create(&fetch_tids[n_fetch_started], NULL,
+                           scan_fetch_thread, &p->fetch_args[i]) == 0)
+            n_fetch_started++;
+        else
+            p->n_live--;
+    }
+    for (int i = 0; i < n_workers; i++) {
+        if (pthread_create(&work_tids[n_work_started], NULL,
+                           scan_match_thread, p) == 0)
+            n_work_started++;
+    }
+    int runnable = n_fetch_started > 0 && n_work_started > 0;
+
+    for (int k = start; runnable && k <= end; k += BIP158_SCAN_CHUNK) {
+        int last = k + BIP158_SCAN_CHUNK - 1;
+        if (last > end) last = end;
+        for (int i = k; i <= last; i++) {
+            scan_slot_t *s = scan_slot(p, i);
+            memset(s, 0, sizeof(*s));
+            s->state = SLOT_QUEUED;
+        }
+        if (!scan_queue_job(p, 0, k, last)) {
+            for (int i = k; i <= last; i++)
+                scan_slot(p, i)->state = SLOT_FAILED;
+        }
+    }
+
+    int h = start;
+    for (; runnable && h <= end; h++) {
+        scan_slot_t *s = scan_slot(p, h);
+        while (!scan_slot_resolved(s) &&
+               !(p->n_live == 0 && !p->filt_head && p->n_busy == 0))
+            pthread_cond_wait(&p->commit_cv, &p->lock);
+        if (s->state == SLOT_HIT) s->state = SLOT_BLOCK_FAILED;  /* peers all gone */
+        if (s->state == SLOT_QUEUED || s->state == SLOT_FAILED) break;
+    }
+    p->done = 1;
+    pthread_cond_broadcast(&p->job_cv);
+    pthread_cond_broadcast(&p->filter_cv);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < n_fetch_started; i++) pthread_join(fetch_tids[i], NULL);
+    for (int i = 0; i < n_work_started; i++)  pthread_join(work_tids[i], NULL);
+
+    /* Drain whatever an early stop left queued. */
+    scan_job_t *j;
+    while ((j = scan_job_pop(&p->block_head, &p->block_tail))) free(j);
+    while ((j = scan_job_pop(&p->chunk_head, &p->chunk_tail))) free(j);
+    while (p->filt_head) {
+        scan_filter_t *f = p->filt_head;
+        p->filt_head = f->next;
+        free(f->data);
+        free(f);
+    }
+
+    for (int i = 0; i < p->n_fetchers; i++) {
+        int peer = fetch_peer[i];
+        if (b->peers[peer].fd < 0 && b->peer_connected[peer]) {
+            b->peer_connected[peer] = 0;
+            if (b->n_connected > 0) b->n_connected--;
+        }
+    }
+    return h - start;
+}
+
+int bip158_scan_p2p_range(bip158_backend_t *b, int start, int tip)
+{
+    if (!b || start < 0 || start > tip) return 0;
+
+    int matched = 0;
+    for (int h = start; h <= tip; ) {
+        int end = tip - h >= BIP158_SCAN_RING ? h + BIP158_SCAN_RING - 1 : tip;
+        scan_pipe_t *p = scan_pipe_new(b);
+        if (!p) return h == start ? -1 : matched;
+        if (!p->n_scripts) {
+            scan_pipe_free(p);
+            break;
+        }
+
+        int n = scan_run_segment(p, h, end);
+        /* No fetcher or worker is left: callbacks may use the peer
+           connections and register scripts for the next segment. */
+        for (int k = h; k < h + n; k++) {
+            scan_slot_t *s = scan_slot(p, k);
+            matched += scan_commit_height(b, k, s->state, s->hash,
+                                          s->block, s->block_len);
+            free(s->block);
+            s->block = NULL;
+        }
+        scan_pipe_free(p);
+        if (h + n <= end) break;
+        h = end + 1;
+    }
+    return matched;
+}
+
 /*
  * BIP 158 scan loop — Phase 5 complete (P2P primary, RPC fallback).
  *
  * P2P path (preferred when backend->peers[backend->current_peer].fd >= 0):
  *   1. bip158_sync_headers() fetches block hashes into the ring buffer and
  *      provides the chain tip height — no RPC needed for header data.
- *   2. getcfilters requests are batched in chunks of 1000 blocks.
+ *   2. bip158_scan_p2p_range() spreads getcfilters requests over every
+ *      connected peer and matches filters on a worker pool.
  *   3. Filter hits download full block via P2P; on failure, fall back to
  *      regtest_scan_block_txs() if rpc_ctx is available.
  *
@@ -1434,7 +2326,10 @@ int bip158_backend_scan(bip158_backend_t *backend)
     regtest_t *rt = (regtest_t *)backend->rpc_ctx;
 
     if (backend->peers[backend->current_peer].fd < 0 && !rt && backend->n_peers == 0) return -1;
-    if (!backend->n_scripts) return 0;
+    pthread_mutex_lock(&backend->scripts_lock);
+    size_t n_scripts = backend->n_scripts;
+    pthread_mutex_unlock(&backend->scripts_lock);
+    if (!n_scripts) return 0;
 
     /* Determine chain tip — P2P path syncs headers + filter headers.
        Phase 6: attempt peer rotation on disconnect before falling back. */
@@ -1472,131 +2367,11 @@ int bip158_backend_scan(bip158_backend_t *backend)
     int start = (backend->tip_height >= 0) ? backend->tip_height + 1 : tip;
     if (start > tip) return 0;
 
-#define FILTER_BUF_MAX (4 * 1024 * 1024)
-    unsigned char *filter_buf = malloc(FILTER_BUF_MAX);
-    if (!filter_buf) return -1;
-
     int matched = 0;
 
     if (backend->peers[backend->current_peer].fd >= 0) {
-        /* === P2P path: batched getcfilters, ring-buffer block hashes === */
-        for (int h = start; h <= tip && backend->peers[backend->current_peer].fd >= 0; ) {
-            int batch_end = (h + 999 < tip) ? h + 999 : tip;
-            const uint8_t *stop = backend->header_hashes[batch_end % BIP158_HEADER_WINDOW];
-
-            if (!p2p_send_getcfilters(&backend->peers[backend->current_peer], (uint32_t)h, stop)) {
-                p2p_close(&backend->peers[backend->current_peer]);
-                break;
-            }
-
-            int batch_ok = 1;
-            for (int bh = h; bh <= batch_end; bh++) {
-                uint8_t *pf = NULL;
-                size_t   pf_len;
-                uint8_t  recv_hash[32], recv_key[16];
-
-                int r = p2p_recv_cfilter(&backend->peers[backend->current_peer], recv_hash,
-                                          &pf, &pf_len, recv_key);
-                if (r != 1) {
-                    free(pf);
-                    if (r == -1) p2p_close(&backend->peers[backend->current_peer]);
-                    batch_ok = 0;
-                    break;
-                }
-
-                size_t use_len = (pf_len <= FILTER_BUF_MAX) ? pf_len : 0;
-                if (use_len) memcpy(filter_buf, pf, use_len);
-                free(pf);
-
-                /* BIP 157 filter header validation — verify filter is authentic.
-                   Skip if filter headers haven't been synced for this height. */
-                if (backend->filter_headers_synced >= bh && use_len > 0) {
-                    static const uint8_t genesis_prev[32] = {0};
-                    const uint8_t *prev_fh =
-                        (bh > 0)
-                        ? backend->filter_headers[(bh - 1) % BIP158_HEADER_WINDOW]
-                        : genesis_prev;
-                    uint8_t computed_fh[32];
-                    compute_filter_header(filter_buf, use_len, prev_fh,
-                                          computed_fh);
-                    if (memcmp(computed_fh,
-                               backend->filter_headers[bh % BIP158_HEADER_WINDOW],
-                               32) != 0) {
-                        /* Peer sent a filter that doesn't match the committed
-                           header — likely a misbehaving or stale peer. */
-                        p2p_close(&backend->peers[backend->current_peer]);
-                        batch_ok = 0;
-                        break;
-                    }
-                }
-
-                if (!bip158_scan_filter(backend, filter_buf, use_len, recv_key)) {
-                    backend->tip_height = bh;
-                    if (backend->block_connected_cb)
-                        backend->block_connected_cb((uint32_t)bh,
-                                                     backend->block_connected_ctx);
-                    continue;
-                }
-
-                /* Filter hit: download full block via P2P and scan txs.
-                   Falls back to RPC if P2P block download fails. */
-                scan_cb_ctx_t sc = { backend, (int32_t)bh, 0 };
-                int block_scanned = 0;
-                if (p2p_send_getdata_block(&backend->peers[backend->current_peer], recv_hash)) {
-                    uint8_t *blk  = NULL;
-                    size_t   blen = 0;
-                    int br = p2p_recv_block(&backend->peers[backend->current_peer], &blk, &blen);
-                    if (br == 1) {
-                        p2p_scan_block_txs(blk, blen,
-                                           (p2p_block_scan_cb_t)scan_tx_callback,
-                                           &sc);
-                        block_scanned = 1;
-
-                        /* Fire UTXO tracking callbacks if registered */
-                        if (backend->utxo_found_cb || backend->utxo_spent_cb) {
-                            p2p_scan_block_full(blk, blen,
-                                                backend->utxo_found_cb,
-                                                backend->utxo_spent_cb,
-                                                backend->utxo_cb_ctx);
-                        }
-
-                        /* Extract fee sample from coinbase for fee estimator */
-                        if (backend->fee_estimator && blen > 80 + 4 + 1) {
-                            uint64_t sample = bip158_extract_block_fee_sample(
-                                blk, blen, (uint32_t)bh);
-                            if (sample > 0)
-                                fee_estimator_blocks_add_sample(
-                                    (fee_estimator_blocks_t *)backend->fee_estimator,
-                                    sample);
-                        }
-                    } else if (br < 0) {
-                        p2p_close(&backend->peers[backend->current_peer]);
-                    }
-                    free(blk);
-                } else {
-                    p2p_close(&backend->peers[backend->current_peer]);
-                }
-                /* Phase 5: fall back to RPC scan if P2P block download failed */
-                if (!block_scanned && rt) {
-                    char hx[65];
-                    for (int b = 0; b < 32; b++)
-                        sprintf(hx + b*2, "%02x", recv_hash[31 - b]);
-                    hx[64] = 0;
-                    regtest_scan_block_txs(rt, hx, scan_tx_callback, &sc);
-                    block_scanned = 1;
-                } else if (!block_scanned) {
-                    fprintf(stderr, "BIP158: block %d P2P download failed, no RPC fallback\n", bh);
-                }
-                if (sc.found) matched++;
-                backend->tip_height = bh;
-                if (backend->block_connected_cb)
-                    backend->block_connected_cb((uint32_t)bh,
-                                                 backend->block_connected_ctx);
-            }
-
-            if (!batch_ok) break;
-            h = batch_end + 1;
-        }
+        /* === P2P path: getcfilters spread over every connected peer === */
+        matched = bip158_scan_p2p_range(backend, start, tip);
     } else if (backend->peers[backend->current_peer].fd < 0) {
         /* === Fallback path: ring-buffer hashes + P2P reconnect + RPC last resort === */
         /* Phase 5: when P2P is down but we have header data in the ring buffer,
@@ -1611,6 +2386,9 @@ int bip158_backend_scan(bip158_backend_t *backend)
 
         /* True fallback: RPC path for environments without P2P peers */
         if (!rt) return 0;  /* no RPC either; caller retries later */
+#define FILTER_BUF_MAX (4 * 1024 * 1024)
+        unsigned char *filter_buf = malloc(FILTER_BUF_MAX);
+        if (!filter_buf) return -1;
         for (int h = start; h <= tip; h++) {
             char          hash_hex[65];
             size_t        filter_len = 0;
@@ -1659,11 +2437,9 @@ int bip158_backend_scan(bip158_backend_t *backend)
                 backend->block_connected_cb((uint32_t)h,
                                              backend->block_connected_ctx);
         }
-    }
-
-
-    free(filter_buf);
+        free(filter_buf);
 #undef FILTER_BUF_MAX
+    }
 
     /* Phase 4: persist scan checkpoint so the next startup resumes here */
     if (backend->db) {
@@ -1821,6 +2597,9 @@ int bip158_handle_reorg(bip158_backend_t *b, int fork_height)
             b->block_disconnected_cb((uint32_t)h, b->block_disconnected_ctx);
     }
 
+    /* Drop parsed blocks above the fork from the shared block cache */
+    block_cache_invalidate_from(block_cache_shared(), fork_height + 1);
+
     /* Invalidate tx_cache entries above fork height */
     for (size_t i = 0; i < b->n_tx_cache; i++) {
         if (b->tx_cache[i].height > fork_height) {
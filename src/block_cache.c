@@ -0,0 +1,359 @@
+/*
+ * block_cache.c — bounded LRU of parsed blocks keyed by block hash
+ *
+ * See block_cache.h for the API description.
+ */
+
+#include "superscalar/block_cache.h"
+#include "superscalar/p2p_bitcoin.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+int block_cache_init(block_cache_t *c, size_t capacity)
+{
+    if (!c) return 0;
+    memset(c, 0, sizeof(*c));
+    c->capacity = capacity ? capacity : BLOCK_CACHE_DEFAULT_CAPACITY;
+    c->stats.capacity = c->capacity;
+    if (pthread_mutex_init(&c->lock, NULL) != 0) return 0;
+    return 1;
+}
+
+static void entry_free(block_cache_entry_t *e)
+{
+    if (!e) return;
+    free(e->txids);
+    free(e->outputs);
+    free(e->spends);
+    free(e->spk_data);
+    free(e);
+}
+
+/* --- LRU list helpers (caller holds lock) --- */
+
+static void lru_unlink(block_cache_t *c, block_cache_entry_t *e)
+{
+    if (e->lru_prev) e->lru_prev->lru_next = e->lru_next;
+    else             c->lru_head = e->lru_next;
+    if (e->lru_next) e->lru_next->lru_prev = e->lru_prev;
+    else             c->lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_push_front(block_cache_t *c, block_cache_entry_t *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = c->lru_head;
+    if (c->lru_head) c->lru_head->lru_prev = e;
+    c->lru_head = e;
+    if (!c->lru_tail) c->lru_tail = e;
+}
+
+/* Remove from the table; frees now if unpinned, else on last release. */
+static void detach(block_cache_t *c, block_cache_entry_t *e)
+{
+    lru_unlink(c, e);
+    c->n_entries--;
+    e->detached = 1;
+    if (e->refs == 0)
+        entry_free(e);
+}
+
+static block_cache_entry_t *find_locked(block_cache_t *c, const char *hash_hex)
+{
+    for (block_cache_entry_t *e = c->lru_head; e; e = e->lru_next) {
+        if (strcmp(e->hash_hex, hash_hex) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static int normalize_hash(const char *in, char out[65])
+{
+    if (!in || strlen(in) != 64) return 0;
+    for (int i = 0; i < 64; i++)
+        out[i] = (char)tolower((unsigned char)in[i]);
+    out[64] = '\0';
+    return 1;
+}
+
+void block_cache_free(block_cache_t *c)
+{
+    if (!c) return;
+    pthread_mutex_lock(&c->lock);
+    while (c->lru_head)
+        detach(c, c->lru_head);
+    pthread_mutex_unlock(&c->lock);
+    pthread_mutex_destroy(&c->lock);
+}
+
+static block_cache_t   g_shared_cache;
+static pthread_once_t  g_shared_once = PTHREAD_ONCE_INIT;
+static int             g_shared_ok;
+
+static void shared_init(void)
+{
+    g_shared_ok = block_cache_init(&g_shared_cache, BLOCK_CACHE_DEFAULT_CAPACITY);
+}
+
+block_cache_t *block_cache_shared(void)
+{
+    pthread_once(&g_shared_once, shared_init);
+    return g_shared_ok ? &g_shared_cache : NULL;
+}
+
+block_cache_entry_t *block_cache_get(block_cache_t *c, const char *hash_hex)
+{
+    char key[65];
+    if (!c || !normalize_hash(hash_hex, key)) return NULL;
+
+    pthread_mutex_lock(&c->lock);
+    block_cache_entry_t *e = find_locked(c, key);
+    if (e) {
+        lru_unlink(c, e);
+        lru_push_front(c, e);
+        e->refs++;
+        c->stats.hits++;
+    } else {
+        c->stats.misses++;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return e;
+}
+
+void block_cache_release(block_cache_t *c, block_cache_entry_t *e)
+{
+    if (!c || !e) return;
+    pthread_mutex_lock(&c->lock);
+    if (--e->refs == 0 && e->detached)
+        entry_free(e);
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* Insert a freshly built entry, evicting from the tail as needed.  An
+   existing entry for the same hash is replaced unless keep_existing is
+   set and it already carries inputs/outputs.  Returns the pinned winner. */
+static block_cache_entry_t *insert(block_cache_t *c, block_cache_entry_t *e,
+                                   int keep_existing)
+{
+    pthread_mutex_lock(&c->lock);
+    block_cache_entry_t *old = find_locked(c, e->hash_hex);
+    if (old && keep_existing && old->has_io) {
+        lru_unlink(c, old);
+        lru_push_front(c, old);
+        old->refs++;
+        pthread_mutex_unlock(&c->lock);
+        entry_free(e);
+        return old;
+    }
+    if (old)
+        detach(c, old);
+
+    while (c->n_entries >= c->capacity && c->lru_tail) {
+        detach(c, c->lru_tail);
+        c->stats.evictions++;
+    }
+    lru_push_front(c, e);
+    c->n_entries++;
+    c->stats.inserts++;
+    e->refs = 1;
+    pthread_mutex_unlock(&c->lock);
+    return e;
+}
+
+/* --- Raw block parsing --- */
+
+typedef struct {
+    block_cache_entry_t *e;
+    size_t cap_tx, cap_out, cap_spend, cap_spk, spk_len;
+    int    oom;
+} parse_ctx_t;
+
+static int grow(void **buf, size_t *cap, size_t need, size_t elem)
+{
+    if (need <= *cap) return 1;
+    size_t ncap = *cap ? *cap * 2 : 64;
+    while (ncap < need) ncap *= 2;
+    void *nb = realloc(*buf, ncap * elem);
+    if (!nb) return 0;
+    *buf = nb;
+    *cap = ncap;
+    return 1;
+}
+
+/* Outputs then inputs fire per tx, so a txid differing from the last one
+   appended starts the next tx. */
+static uint32_t tx_index_for(parse_ctx_t *pc, const char *txid_hex)
+{
+    block_cache_entry_t *e = pc->e;
+    if (e->n_tx > 0 && memcmp(e->txids[e->n_tx - 1], txid_hex, 64) == 0)
+        return (uint32_t)(e->n_tx - 1);
+    if (!grow((void **)&e->txids, &pc->cap_tx, e->n_tx + 1, sizeof(*e->txids))) {
+        pc->oom = 1;
+        return 0;
+    }
+    memcpy(e->txids[e->n_tx], txid_hex, 64);
+    e->txids[e->n_tx][64] = '\0';
+    return (uint32_t)e->n_tx++;
+}
+
+static void parse_output_cb(const char *txid_hex, uint32_t vout_idx,
+                            uint64_t amount_sats, const unsigned char *spk,
+                            size_t spk_len, void *ctx)
+{
+    parse_ctx_t *pc = (parse_ctx_t *)ctx;
+    if (pc->oom) return;
+    block_cache_entry_t *e = pc->e;
+    uint32_t ti = tx_index_for(pc, txid_hex);
+    if (pc->oom) return;
+    if (!grow((void **)&e->outputs, &pc->cap_out, e->n_outputs + 1,
+              sizeof(*e->outputs)) ||
+        !grow((void **)&e->spk_data, &pc->cap_spk, pc->spk_len + spk_len + 1, 1)) {
+        pc->oom = 1;
+        return;
+    }
+    block_cache_output_t *o = &e->outputs[e->n_outputs++];
+    o->tx_index    = ti;
+    o->vout        = vout_idx;
+    o->amount_sats = amount_sats;
+    o->spk_off     = (uint32_t)pc->spk_len;
+    o->spk_len     = (uint32_t)spk_len;
+    if (spk_len) memcpy(e->spk_data + pc->spk_len, spk, spk_len);
+    pc->spk_len += spk_len;
+}
+
+static void parse_input_cb(const char *txid_hex, const uint8_t prev_txid32[32],
+                           uint32_t prev_vout, void *ctx)
+{
+    static const uint8_t null_txid[32] = {0};
+    parse_ctx_t *pc = (parse_ctx_t *)ctx;
+    if (pc->oom) return;
+    block_cache_entry_t *e = pc->e;
+    uint32_t ti = tx_index_for(pc, txid_hex);
+    if (pc->oom) return;
+    if (prev_vout == 0xFFFFFFFFu && memcmp(prev_txid32, null_txid, 32) == 0)
+        return;  /* coinbase */
+    if (!grow((void **)&e->spends, &pc->cap_spend, e->n_spends + 1,
+              sizeof(*e->spends))) {
+        pc->oom = 1;
+        return;
+    }
+    block_cache_spend_t *s = &e->spends[e->n_spends++];
+    s->tx_index = ti;
+    memcpy(s->prev_txid, prev_txid32, 32);
+    s->prev_vout = prev_vout;
+}
+
+block_cache_entry_t *block_cache_put_raw(block_cache_t *c, const char *hash_hex,
+                                         int height,
+                                         const unsigned char *raw, size_t raw_len)
+{
+    if (!c || !raw || raw_len < 80) return NULL;
+    block_cache_entry_t *e = calloc(1, sizeof(*e));
+    if (!e) return NULL;
+    if (!normalize_hash(hash_hex, e->hash_hex)) { free(e); return NULL; }
+    e->height = height;
+
+    parse_ctx_t pc;
+    memset(&pc, 0, sizeof(pc));
+    pc.e = e;
+    if (p2p_scan_block_full(raw, raw_len, parse_output_cb, parse_input_cb,
+                            &pc) < 0 || pc.oom) {
+        entry_free(e);
+        return NULL;
+    }
+    /* hashPrevBlock: header bytes 4..35, internal order */
+    static const char hx[] = "0123456789abcdef";
+    for (int i = 0; i < 32; i++) {
+        e->prev_hash_hex[i * 2]     = hx[raw[4 + 31 - i] >> 4];
+        e->prev_hash_hex[i * 2 + 1] = hx[raw[4 + 31 - i] & 0xf];
+    }
+    e->prev_hash_hex[64] = '\0';
+    e->has_io = 1;
+    return insert(c, e, 0);
+}
+
+block_cache_entry_t *block_cache_put_txids(block_cache_t *c, const char *hash_hex,
+                                           int height,
+                                           const char *const *txids, size_t n_tx)
+{
+    if (!c || (!txids && n_tx)) return NULL;
+    block_cache_entry_t *e = calloc(1, sizeof(*e));
+    if (!e) return NULL;
+    if (!normalize_hash(hash_hex, e->hash_hex)) { free(e); return NULL; }
+    e->height = height;
+    if (n_tx) {
+        e->txids = malloc(n_tx * sizeof(*e->txids));
+        if (!e->txids) { free(e); return NULL; }
+        for (size_t i = 0; i < n_tx; i++) {
+            if (!normalize_hash(txids[i], e->txids[i])) {
+                entry_free(e);
+                return NULL;
+            }
+        }
+    }
+    e->n_tx = n_tx;
+    return insert(c, e, 1);
+}
+
+long block_cache_find_tx(const block_cache_entry_t *e, const char *txid_hex)
+{
+    char key[65];
+    if (!e || !normalize_hash(txid_hex, key)) return -1;
+    for (size_t i = 0; i < e->n_tx; i++) {
+        if (memcmp(e->txids[i], key, 64) == 0)
+            return (long)i;
+    }
+    return -1;
+}
+
+int block_cache_invalidate(block_cache_t *c, const char *hash_hex)
+{
+    char key[65];
+    if (!c || !normalize_hash(hash_hex, key)) return 0;
+    pthread_mutex_lock(&c->lock);
+    block_cache_entry_t *e = find_locked(c, key);
+    if (e) {
+        detach(c, e);
+        c->stats.invalidations++;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return e != NULL;
+}
+
+size_t block_cache_invalidate_from(block_cache_t *c, int height)
+{
+    if (!c) return 0;
+    size_t n = 0;
+    pthread_mutex_lock(&c->lock);
+    block_cache_entry_t *e = c->lru_head;
+    while (e) {
+        block_cache_entry_t *next = e->lru_next;
+        if (e->height >= 0 && e->height >= height) {
+            detach(c, e);
+            n++;
+        }
+        e = next;
+    }
+    c->stats.invalidations += n;
+    pthread_mutex_unlock(&c->lock);
+    return n;
+}
+
+void block_cache_get_stats(block_cache_t *c, block_cache_stats_t *out)
+{
+    if (!c || !out) return;
+    pthread_mutex_lock(&c->lock);
+    *out = c->stats;
+    out->n_entries = c->n_entries;
+    out->capacity  = c->capacity;
+    pthread_mutex_unlock(&c->lock);
+}
+
+double block_cache_hit_rate_pct(const block_cache_stats_t *s)
+{
+    if (!s) return 0.0;
+    uint64_t total = s->hits + s->misses;
+    return total ? 100.0 * (double)s->hits / (double)total : 0.0;
+}
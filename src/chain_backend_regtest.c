@@ -30,6 +30,16 @@ static int cb_is_outpoint_unspent(chain_backend_t *self,
     return regtest_outpoint_unspent((regtest_t *)self->ctx, txid_hex_display, vout);
 }
 
+static int cb_is_outpoint_unspent_batch(chain_backend_t *self,
+                                         const char **txids_hex_display,
+                                         const uint32_t *vouts, size_t n,
+                                         int *unspent_out)
+{
+    return regtest_outpoints_unspent_batch((regtest_t *)self->ctx,
+                                           txids_hex_display, vouts, n,
+                                           unspent_out);
+}
+
 static int cb_send_raw_tx(chain_backend_t *self, const char *tx_hex,
                           char *txid_out)
 {
@@ -44,6 +54,20 @@ static int cb_get_confirmations_batch(chain_backend_t *self,
                                            txids_hex, n_txids, confs_out);
 }
 
+static int cb_get_block_hash(chain_backend_t *self, int height,
+                              char *hash_hex_out)
+{
+    return regtest_get_block_hash((regtest_t *)self->ctx, height,
+                                  hash_hex_out, 65);
+}
+
+static int cb_get_block(chain_backend_t *self, const char *hash_hex,
+                         unsigned char **block_out, size_t *block_len_out)
+{
+    return regtest_get_raw_block((regtest_t *)self->ctx, hash_hex,
+                                 block_out, block_len_out);
+}
+
 static int cb_register_script(chain_backend_t *self,
                                const unsigned char *spk, size_t spk_len)
 {
@@ -60,14 +84,20 @@ static int cb_unregister_script(chain_backend_t *self,
 
 void chain_backend_regtest_init(chain_backend_t *backend, regtest_t *rt)
 {
+    /* Optional slots not set below (reorg_cb, ...) must read as NULL even
+       when the caller's chain_backend_t lives uninitialized on the stack. */
+    memset(backend, 0, sizeof(*backend));
     backend->get_block_height        = cb_get_block_height;
     backend->get_confirmations       = cb_get_confirmations;
     backend->get_confirmations_batch = cb_get_confirmations_batch;
     backend->is_in_mempool           = cb_is_in_mempool;
     backend->is_outpoint_unspent     = cb_is_outpoint_unspent;
+    backend->is_outpoint_unspent_batch = cb_is_outpoint_unspent_batch;
     backend->send_raw_tx       = cb_send_raw_tx;
     backend->register_script   = cb_register_script;
     backend->unregister_script = cb_unregister_script;
+    backend->get_block_hash    = cb_get_block_hash;
+    backend->get_block         = cb_get_block;
     backend->ctx               = rt;
     backend->is_regtest        = (rt && strcmp(rt->network, "regtest") == 0);
     conf_targets_default(&backend->conf);
@@ -2,8 +2,8 @@
  * chain_backend_rpc.c — HTTP JSON-RPC chain backend for Bitcoin Core.
  *
  * Works with any network (mainnet, signet, testnet, regtest).
- * Uses direct TCP socket + HTTP/1.0 POST to bitcoind's JSON-RPC interface.
- * No external dependencies beyond POSIX sockets and cJSON (already vendored).
+ * Transport is the shared keep-alive JSON-RPC client (rpc_client.c):
+ * pooled HTTP/1.1 connections, and batch slots answered in one round-trip.
  */
 
 #include "superscalar/chain_backend_rpc.h"
@@ -12,48 +12,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netdb.h>
 
-/* ------------------------------------------------------------------ */
-/* Base64 encoder (for HTTP Basic Auth)                                 */
-/* ------------------------------------------------------------------ */
-
-static int rpc_base64(const char *in, size_t in_len, char *out, size_t out_cap)
-{
-    static const char b64[] =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t olen = ((in_len + 2) / 3) * 4;
-    if (olen + 1 > out_cap) return -1;
-    size_t i, j;
-    for (i = 0, j = 0; i + 2 < in_len; i += 3) {
-        unsigned c0 = (unsigned char)in[i];
-        unsigned c1 = (unsigned char)in[i+1];
-        unsigned c2 = (unsigned char)in[i+2];
-        out[j++] = b64[(c0 >> 2) & 0x3f];
-        out[j++] = b64[((c0 << 4) | (c1 >> 4)) & 0x3f];
-        out[j++] = b64[((c1 << 2) | (c2 >> 6)) & 0x3f];
-        out[j++] = b64[c2 & 0x3f];
-    }
-    if (i < in_len) {
-        unsigned c0 = (unsigned char)in[i];
-        unsigned c1 = (i + 1 < in_len) ? (unsigned char)in[i+1] : 0;
-        out[j++] = b64[(c0 >> 2) & 0x3f];
-        out[j++] = b64[((c0 << 4) | (c1 >> 4)) & 0x3f];
-        out[j++] = (i + 1 < in_len) ? b64[(c1 << 2) & 0x3f] : '=';
-        out[j++] = '=';
-    }
-    out[j] = '\0';
-    return (int)j;
-}
+extern int hex_decode(const char *hex, unsigned char *out, size_t out_len);
 
 /* ------------------------------------------------------------------ */
-/* Core HTTP JSON-RPC call                                              */
+/* Core JSON-RPC call                                                   */
 /* ------------------------------------------------------------------ */
 
 /* Send a JSON-RPC call to bitcoind and return the parsed "result" field.
    Caller must cJSON_Delete the returned object. Returns NULL on error.
+   Transport goes through the shared keep-alive client (rpc_client.h).
 
    If expected_err_code is non-zero and the RPC returns that error code,
    the call returns NULL silently (no stderr spam). Used by poll loops
@@ -63,120 +31,33 @@ static cJSON *rpc_call_ex(const chain_backend_rpc_ctx_t *rpc,
                            const char *method, cJSON *params,
                            int expected_err_code)
 {
-    /* Basic Auth header */
-    char credentials[512];
-    snprintf(credentials, sizeof(credentials), "%s:%s",
-             rpc->rpcuser, rpc->rpcpassword);
-    char auth_b64[512];
-    if (rpc_base64(credentials, strlen(credentials), auth_b64, sizeof(auth_b64)) < 0)
-        return NULL;
-
-    /* Build JSON-RPC body */
-    cJSON *req_json = cJSON_CreateObject();
-    cJSON_AddStringToObject(req_json, "jsonrpc", "1.0");
-    cJSON_AddNumberToObject(req_json, "id", 1);
-    cJSON_AddStringToObject(req_json, "method", method);
-    if (params)
-        cJSON_AddItemToObject(req_json, "params", params);
-    else
-        cJSON_AddItemToObject(req_json, "params", cJSON_CreateArray());
-
-    char *body = cJSON_PrintUnformatted(req_json);
-    cJSON_Delete(req_json);
-    if (!body) return NULL;
-    int body_len = (int)strlen(body);
-
-    /* Wallet path */
-    char path[256] = "/";
-    if (rpc->wallet[0] != '\0')
-        snprintf(path, sizeof(path), "/wallet/%s", rpc->wallet);
-
-    /* Build HTTP request */
-    size_t reqcap = (size_t)body_len + 512;
-    char *req = malloc(reqcap);
-    if (!req) { free(body); return NULL; }
-    int req_len = snprintf(req, reqcap,
-        "POST %s HTTP/1.0\r\n"
-        "Host: %s:%d\r\n"
-        "Authorization: Basic %s\r\n"
-        "Content-Type: application/json\r\n"
-        "Content-Length: %d\r\n"
-        "Connection: close\r\n"
-        "\r\n"
-        "%s",
-        path, rpc->host, rpc->port, auth_b64, body_len, body);
-    free(body);
-    if (req_len <= 0 || (size_t)req_len >= reqcap) { free(req); return NULL; }
-
-    /* Connect */
-    struct addrinfo hints, *res = NULL;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family   = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    char port_str[16];
-    snprintf(port_str, sizeof(port_str), "%d", rpc->port);
-    if (getaddrinfo(rpc->host, port_str, &hints, &res) != 0) {
-        free(req); return NULL;
+    rpc_error_t err;
+    cJSON *result = rpc_client_call(rpc->client, rpc->wallet, method,
+                                    params, &err);
+    if (!result && err.code != 0 &&
+        (expected_err_code == 0 || err.code != expected_err_code)) {
+        fprintf(stderr, "HTTP RPC %s error: {\"code\":%d,\"message\":\"%s\"}\n",
+                method, err.code, err.message);
     }
+    return result;
+}
 
-    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (fd < 0) { freeaddrinfo(res); free(req); return NULL; }
-    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
-        close(fd); freeaddrinfo(res); free(req); return NULL;
-    }
-    freeaddrinfo(res);
-
-    /* Send */
-    ssize_t sent = send(fd, req, (size_t)req_len, 0);
-    free(req);
-    if (sent != (ssize_t)req_len) { close(fd); return NULL; }
-
-    /* Receive */
-    size_t cap = 65536, used = 0;
-    char *resp = malloc(cap);
-    if (!resp) { close(fd); return NULL; }
-    ssize_t n;
-    while ((n = recv(fd, resp + used, cap - used - 1, 0)) > 0) {
-        used += (size_t)n;
-        if (used + 1 >= cap) {
-            cap *= 2;
-            char *tmp = realloc(resp, cap);
-            if (!tmp) { free(resp); close(fd); return NULL; }
-            resp = tmp;
-        }
-    }
-    close(fd);
-    resp[used] = '\0';
-
-    /* Parse HTTP body */
-    char *bodyp = strstr(resp, "\r\n\r\n");
-    if (!bodyp) { free(resp); return NULL; }
-    bodyp += 4;
-
-    cJSON *jresp = cJSON_Parse(bodyp);
-    free(resp);
-    if (!jresp) return NULL;
-
-    /* Check for RPC error */
-    cJSON *err = cJSON_GetObjectItem(jresp, "error");
-    if (err && !cJSON_IsNull(err)) {
-        cJSON *ecode = cJSON_GetObjectItem(err, "code");
-        cJSON *emsg  = cJSON_GetObjectItem(err, "message");
-        int code = ecode ? ecode->valueint : 0;
-        /* Silently swallow the expected "not found" code for poll loops. */
-        if (expected_err_code == 0 || code != expected_err_code) {
+/* Batched variant: every item goes out in one round-trip.  Errors other
+   than expected_err_code are logged per item.  Returns 1 if bitcoind
+   answered. */
+static int rpc_batch_ex(const chain_backend_rpc_ctx_t *rpc,
+                         rpc_batch_item_t *items, size_t n_items,
+                         int expected_err_code)
+{
+    if (!rpc_client_batch(rpc->client, rpc->wallet, items, n_items))
+        return 0;
+    for (size_t i = 0; i < n_items; i++) {
+        int code = items[i].err.code;
+        if (code != 0 && (expected_err_code == 0 || code != expected_err_code))
             fprintf(stderr, "HTTP RPC %s error: {\"code\":%d,\"message\":\"%s\"}\n",
-                    method, code,
-                    emsg && cJSON_IsString(emsg) ? emsg->valuestring : "unknown");
-        }
-        cJSON_Delete(jresp);
-        return NULL;
+                    items[i].method, code, items[i].err.message);
     }
-
-    /* Detach and return result */
-    cJSON *result = cJSON_DetachItemFromObject(jresp, "result");
-    cJSON_Delete(jresp);
-    return result;
+    return 1;
 }
 
 /* Back-compat wrapper: errors always printed. */
@@ -228,11 +109,43 @@ static int cb_rpc_get_confirmations(chain_backend_t *self, const char *txid_hex)
     return -1; /* TX not found */
 }
 
+/* One getrawtransaction batch for all txids — watchtower polling pays a
+   single round-trip per cycle.  Falls back to per-txid calls if the
+   batch request itself fails. */
 static int cb_rpc_get_confirmations_batch(chain_backend_t *self,
                                            const char **txids_hex,
                                            size_t n_txids,
                                            int *confs_out)
 {
+    chain_backend_rpc_ctx_t *rpc = (chain_backend_rpc_ctx_t *)self->ctx;
+    if (!txids_hex || !confs_out || n_txids == 0) return 0;
+
+    rpc_batch_item_t *items = calloc(n_txids, sizeof(*items));
+    if (items) {
+        for (size_t i = 0; i < n_txids; i++) {
+            items[i].method = "getrawtransaction";
+            items[i].params = cJSON_CreateArray();
+            cJSON_AddItemToArray(items[i].params, cJSON_CreateString(txids_hex[i]));
+            cJSON_AddItemToArray(items[i].params, cJSON_CreateBool(1));
+        }
+        /* -5 = "No such mempool or blockchain transaction" — normal miss. */
+        if (rpc_batch_ex(rpc, items, n_txids, -5)) {
+            for (size_t i = 0; i < n_txids; i++) {
+                if (!items[i].result) {
+                    confs_out[i] = -1;
+                    continue;
+                }
+                cJSON *confs = cJSON_GetObjectItem(items[i].result, "confirmations");
+                int c = confs && cJSON_IsNumber(confs) ? (int)confs->valuedouble : 0;
+                confs_out[i] = c > 0 ? c : 0;
+                cJSON_Delete(items[i].result);
+            }
+            free(items);
+            return 1;
+        }
+        free(items);
+    }
+
     for (size_t i = 0; i < n_txids; i++)
         confs_out[i] = self->get_confirmations(self, txids_hex[i]);
     return 1;
@@ -252,6 +165,52 @@ static bool cb_rpc_is_in_mempool(chain_backend_t *self, const char *txid_hex)
     return false;
 }
 
+static int cb_rpc_is_outpoint_unspent(chain_backend_t *self,
+                                       const char *txid_hex_display,
+                                       uint32_t vout)
+{
+    chain_backend_rpc_ctx_t *rpc = (chain_backend_rpc_ctx_t *)self->ctx;
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateString(txid_hex_display));
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(vout));
+    cJSON_AddItemToArray(params, cJSON_CreateBool(1)); /* include_mempool */
+    cJSON *result = rpc_call(rpc, "gettxout", params);
+    if (!result) return -1;
+    /* gettxout answers JSON null for spent / unknown outpoints. */
+    int unspent = cJSON_IsNull(result) ? 0 : 1;
+    cJSON_Delete(result);
+    return unspent;
+}
+
+static int cb_rpc_is_outpoint_unspent_batch(chain_backend_t *self,
+                                             const char **txids_hex_display,
+                                             const uint32_t *vouts, size_t n,
+                                             int *unspent_out)
+{
+    chain_backend_rpc_ctx_t *rpc = (chain_backend_rpc_ctx_t *)self->ctx;
+    if (!txids_hex_display || !vouts || !unspent_out || n == 0) return 0;
+
+    rpc_batch_item_t *items = calloc(n, sizeof(*items));
+    if (!items) return 0;
+    for (size_t i = 0; i < n; i++) {
+        items[i].method = "gettxout";
+        items[i].params = cJSON_CreateArray();
+        cJSON_AddItemToArray(items[i].params, cJSON_CreateString(txids_hex_display[i]));
+        cJSON_AddItemToArray(items[i].params, cJSON_CreateNumber(vouts[i]));
+        cJSON_AddItemToArray(items[i].params, cJSON_CreateBool(1));
+    }
+    int ok = rpc_batch_ex(rpc, items, n, 0);
+    for (size_t i = 0; i < n; i++) {
+        if (!ok || !items[i].result)
+            unspent_out[i] = -1;
+        else
+            unspent_out[i] = cJSON_IsNull(items[i].result) ? 0 : 1;
+        cJSON_Delete(items[i].result);
+    }
+    free(items);
+    return ok;
+}
+
 static int cb_rpc_send_raw_tx(chain_backend_t *self, const char *tx_hex,
                                 char *txid_out)
 {
@@ -282,6 +241,51 @@ static int cb_rpc_unregister_script(chain_backend_t *self,
     return 1;
 }
 
+static int cb_rpc_get_block_hash(chain_backend_t *self, int height,
+                                  char *hash_hex_out)
+{
+    chain_backend_rpc_ctx_t *rpc = (chain_backend_rpc_ctx_t *)self->ctx;
+    if (height < 0 || !hash_hex_out) return 0;
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(height));
+    /* -8 = "Block height out of range" — tip moved under us. */
+    cJSON *result = rpc_call_ex(rpc, "getblockhash", params, -8);
+    if (!result) return 0;
+    int ok = 0;
+    if (cJSON_IsString(result) && strlen(result->valuestring) == 64) {
+        memcpy(hash_hex_out, result->valuestring, 65);
+        ok = 1;
+    }
+    cJSON_Delete(result);
+    return ok;
+}
+
+static int cb_rpc_get_block(chain_backend_t *self, const char *hash_hex,
+                             unsigned char **block_out, size_t *block_len_out)
+{
+    chain_backend_rpc_ctx_t *rpc = (chain_backend_rpc_ctx_t *)self->ctx;
+    if (!hash_hex || !block_out || !block_len_out) return 0;
+    cJSON *params = cJSON_CreateArray();
+    cJSON_AddItemToArray(params, cJSON_CreateString(hash_hex));
+    cJSON_AddItemToArray(params, cJSON_CreateNumber(0)); /* raw hex */
+    cJSON *result = rpc_call(rpc, "getblock", params);
+    if (!result) return 0;
+    int ok = 0;
+    if (cJSON_IsString(result)) {
+        size_t hlen = strlen(result->valuestring);
+        unsigned char *blk = (hlen && hlen % 2 == 0) ? malloc(hlen / 2) : NULL;
+        if (blk && hex_decode(result->valuestring, blk, hlen / 2) == (int)(hlen / 2)) {
+            *block_out = blk;
+            *block_len_out = hlen / 2;
+            ok = 1;
+        } else {
+            free(blk);
+        }
+    }
+    cJSON_Delete(result);
+    return ok;
+}
+
 /* ------------------------------------------------------------------ */
 /* Initialization                                                       */
 /* ------------------------------------------------------------------ */
@@ -296,6 +300,9 @@ int chain_backend_rpc_init(chain_backend_t *backend,
 
     chain_backend_rpc_ctx_t *rpc = calloc(1, sizeof(chain_backend_rpc_ctx_t));
     if (!rpc) return 0;
+    /* Optional slots not set below (reorg_cb, ...) must read as NULL even
+       when the caller's chain_backend_t lives uninitialized on the stack. */
+    memset(backend, 0, sizeof(*backend));
 
     strncpy(rpc->host, host, sizeof(rpc->host) - 1);
     rpc->port = port;
@@ -313,13 +320,24 @@ int chain_backend_rpc_init(chain_backend_t *backend,
         else                                        rpc->port = 8332; /* mainnet */
     }
 
+    rpc->client = rpc_client_shared(rpc->host, rpc->port,
+                                    rpc->rpcuser, rpc->rpcpassword);
+    if (!rpc->client) {
+        free(rpc);
+        return 0;
+    }
+
     backend->get_block_height        = cb_rpc_get_block_height;
     backend->get_confirmations       = cb_rpc_get_confirmations;
     backend->get_confirmations_batch = cb_rpc_get_confirmations_batch;
     backend->is_in_mempool           = cb_rpc_is_in_mempool;
+    backend->is_outpoint_unspent     = cb_rpc_is_outpoint_unspent;
+    backend->is_outpoint_unspent_batch = cb_rpc_is_outpoint_unspent_batch;
     backend->send_raw_tx             = cb_rpc_send_raw_tx;
     backend->register_script         = cb_rpc_register_script;
     backend->unregister_script       = cb_rpc_unregister_script;
+    backend->get_block_hash          = cb_rpc_get_block_hash;
+    backend->get_block               = cb_rpc_get_block;
     backend->ctx                     = rpc;
     backend->is_regtest              = (network && strcmp(network, "regtest") == 0);
     conf_targets_default(&backend->conf);
@@ -0,0 +1,272 @@
+/*
+ * chain_events.c — chain event bus over chain_backend_t
+ *
+ * See chain_events.h for the ordering guarantees and API description.
+ */
+
+#include "superscalar/chain_events.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT(h)  ((size_t)(h) % CHAIN_EVENTS_REORG_DEPTH)
+
+int chain_events_init(chain_events_t *bus, chain_backend_t *backend,
+                       int start_height)
+{
+    if (!bus || !backend) return 0;
+    if (!backend->get_block_height || !backend->get_block_hash) return 0;
+    memset(bus, 0, sizeof(*bus));
+    bus->backend      = backend;
+    bus->cache        = block_cache_shared();
+    bus->tip_height   = -1;
+    bus->start_height = start_height < 0 ? -1 : start_height;
+    return 1;
+}
+
+void chain_events_set_cache(chain_events_t *bus, block_cache_t *cache)
+{
+    if (bus) bus->cache = cache;
+}
+
+int chain_events_subscribe(chain_events_t *bus, unsigned mask,
+                            int want_body, chain_event_cb_t cb, void *ctx)
+{
+    if (!bus || !cb || !(mask & CHAIN_EVENT_ALL)) return 0;
+
+    /* Reuse a slot freed by chain_events_unsubscribe() first. */
+    size_t slot = bus->n_subs;
+    for (size_t i = 0; i < bus->n_subs; i++) {
+        if (!bus->subs[i].cb) { slot = i; break; }
+    }
+    if (slot == CHAIN_EVENTS_MAX_SUBSCRIBERS) return 0;
+
+    bus->subs[slot].cb        = cb;
+    bus->subs[slot].ctx       = ctx;
+    bus->subs[slot].mask      = mask;
+    bus->subs[slot].want_body = want_body ? 1 : 0;
+    if (slot == bus->n_subs) bus->n_subs++;
+    return 1;
+}
+
+int chain_events_unsubscribe(chain_events_t *bus, chain_event_cb_t cb,
+                              void *ctx)
+{
+    if (!bus || !cb) return 0;
+    for (size_t i = 0; i < bus->n_subs; i++) {
+        if (bus->subs[i].cb == cb && bus->subs[i].ctx == ctx) {
+            /* Clear in place rather than compacting so an unsubscribe
+               from inside a callback does not shift the delivery loop. */
+            memset(&bus->subs[i], 0, sizeof(bus->subs[i]));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int chain_events_tip_height(const chain_events_t *bus)
+{
+    return bus ? (int)bus->tip_height : -1;
+}
+
+static void deliver(chain_events_t *bus, const chain_event_t *ev)
+{
+    for (size_t i = 0; i < bus->n_subs; i++) {
+        chain_event_sub_t *s = &bus->subs[i];
+        if (s->cb && (s->mask & (unsigned)ev->type))
+            s->cb(ev, s->ctx);
+    }
+}
+
+static int any_wants_body(const chain_events_t *bus)
+{
+    for (size_t i = 0; i < bus->n_subs; i++) {
+        if (bus->subs[i].cb && bus->subs[i].want_body &&
+            (bus->subs[i].mask & CHAIN_EVENT_BLOCK_CONNECTED))
+            return 1;
+    }
+    return 0;
+}
+
+void chain_events_push_mempool(chain_events_t *bus, const char *txid_hex)
+{
+    if (!bus || !txid_hex) return;
+    chain_event_t ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.type       = CHAIN_EVENT_MEMPOOL_TX;
+    ev.tip_height = bus->tip_height;
+    ev.txid_hex   = txid_hex;
+    bus->n_mempool++;
+    deliver(bus, &ev);
+}
+
+void chain_events_mempool_cb(const char *txid_hex, void *ctx)
+{
+    chain_events_push_mempool((chain_events_t *)ctx, txid_hex);
+}
+
+/* --- Block bodies (via the block cache) --- */
+
+/* Pin the parsed body for blk (hash already set): cache first, then one
+   get_block download on a miss or a txid-only entry.  Returns NULL when
+   the backend cannot serve blocks. */
+static block_cache_entry_t *fetch_body(chain_events_t *bus, chain_block_t *blk)
+{
+    chain_backend_t *be = bus->backend;
+    block_cache_entry_t *e = bus->cache ? block_cache_get(bus->cache, blk->hash_hex)
+                                        : NULL;
+    if (e && e->has_io) return e;
+    if (!be->get_block || !bus->cache) return e;
+
+    unsigned char *raw = NULL;
+    size_t raw_len = 0;
+    if (!be->get_block(be, blk->hash_hex, &raw, &raw_len)) {
+        free(raw);
+        return e;  /* txid-only entry beats nothing */
+    }
+    bus->n_blocks_fetched++;
+    block_cache_entry_t *full = block_cache_put_raw(bus->cache, blk->hash_hex,
+                                                    blk->height, raw, raw_len);
+    free(raw);
+    if (!full) return e;
+    block_cache_release(bus->cache, e);
+    return full;
+}
+
+static void attach_body(chain_block_t *blk, const block_cache_entry_t *e)
+{
+    blk->parsed = e;
+    blk->txids  = e ? e->txids : NULL;
+    blk->n_tx   = e ? e->n_tx  : 0;
+}
+
+/* Highest height at or below min(tip, new_tip) whose hash still matches
+   the backend.  With no match in the remembered window, the height below
+   both the window and new_tip: everything remembered is disconnected and
+   the new chain is connected from there.  Returns -2 on backend error. */
+static int find_fork(chain_events_t *bus, int new_tip)
+{
+    chain_backend_t *be = bus->backend;
+    int h = bus->tip_height < new_tip ? bus->tip_height : new_tip;
+    int lowest = bus->tip_height - CHAIN_EVENTS_REORG_DEPTH + 1;
+    if (lowest < 0) lowest = 0;
+
+    for (; h >= lowest; h--) {
+        const char *known = bus->hashes[SLOT(h)];
+        if (!known[0]) return h;  /* replay start: nothing delivered here */
+        char cur[65];
+        if (!be->get_block_hash(be, h, cur)) return -2;
+        if (strcmp(cur, known) == 0) return h;
+    }
+    fprintf(stderr, "chain_events: reorg deeper than %d blocks; "
+            "disconnecting all remembered blocks\n", CHAIN_EVENTS_REORG_DEPTH);
+    return (lowest - 1 < new_tip - 1) ? lowest - 1 : new_tip - 1;
+}
+
+int chain_events_poll(chain_events_t *bus)
+{
+    if (!bus || !bus->backend) return -1;
+    chain_backend_t *be = bus->backend;
+    bus->n_polls++;
+
+    int new_tip = be->get_block_height(be);
+    if (new_tip < 0) return -1;
+
+    if (bus->tip_height < 0) {
+        if (bus->start_height < 0 || bus->start_height > new_tip) {
+            /* Start at the tip without replaying history. */
+            char h[65];
+            if (!be->get_block_hash(be, new_tip, h)) return -1;
+            memcpy(bus->hashes[SLOT(new_tip)], h, 65);
+            bus->tip_height = new_tip;
+            return 0;
+        }
+        bus->tip_height = bus->start_height - 1;
+    }
+
+    int delivered = 0;
+    int fork = bus->tip_height;
+    if (bus->tip_height >= 0) {
+        fork = find_fork(bus, new_tip);
+        if (fork == -2) return -1;
+    }
+
+    int want_body = any_wants_body(bus);
+
+    /* Disconnect: old tip down to fork + 1. */
+    while (bus->tip_height > fork) {
+        int h = bus->tip_height;
+        if (!bus->hashes[SLOT(h)][0]) {
+            /* Rewound past the window: nothing below it was remembered,
+               so there is nothing more to disconnect */
+            bus->tip_height = fork;
+            break;
+        }
+        chain_block_t blk;
+        memset(&blk, 0, sizeof(blk));
+        blk.height = h;
+        memcpy(blk.hash_hex, bus->hashes[SLOT(h)], 65);
+        /* Subscribers get the body if it is still cached (no download:
+           the backend no longer serves it on the active chain). */
+        block_cache_entry_t *e = (want_body && bus->cache)
+                                 ? block_cache_get(bus->cache, blk.hash_hex) : NULL;
+        attach_body(&blk, e);
+
+        bus->hashes[SLOT(h)][0] = '\0';
+        bus->tip_height = h - 1;
+
+        chain_event_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type       = CHAIN_EVENT_BLOCK_DISCONNECTED;
+        ev.tip_height = bus->tip_height;
+        ev.block      = &blk;
+        bus->n_disconnected++;
+        deliver(bus, &ev);
+        delivered++;
+
+        if (bus->cache) {
+            block_cache_release(bus->cache, e);
+            block_cache_invalidate(bus->cache, blk.hash_hex);
+        }
+    }
+
+    /* Connect: fork + 1 up to the new tip (bounded per poll). */
+    int last = new_tip;
+    if (last - bus->tip_height > CHAIN_EVENTS_MAX_CATCHUP)
+        last = bus->tip_height + CHAIN_EVENTS_MAX_CATCHUP;
+
+    for (int h = bus->tip_height + 1; h <= last; h++) {
+        chain_block_t blk;
+        memset(&blk, 0, sizeof(blk));
+        blk.height = h;
+        if (!be->get_block_hash(be, h, blk.hash_hex)) break;
+
+        block_cache_entry_t *e = want_body ? fetch_body(bus, &blk) : NULL;
+        attach_body(&blk, e);
+
+        /* Parent check: the chain moved under us mid-catch-up.  Stop here;
+           the next poll's fork search unwinds to the common ancestor. */
+        const char *parent = h > 0 ? bus->hashes[SLOT(h - 1)] : "";
+        if (e && e->prev_hash_hex[0] && parent[0] &&
+            strcmp(e->prev_hash_hex, parent) != 0) {
+            block_cache_release(bus->cache, e);
+            break;
+        }
+
+        memcpy(bus->hashes[SLOT(h)], blk.hash_hex, 65);
+        bus->tip_height = h;
+
+        chain_event_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type       = CHAIN_EVENT_BLOCK_CONNECTED;
+        ev.tip_height = h;
+        ev.block      = &blk;
+        bus->n_connected++;
+        deliver(bus, &ev);
+        delivered++;
+
+        block_cache_release(bus->cache, e);
+    }
+
+    return delivered;
+}
@@ -2,6 +2,7 @@
 #include "superscalar/tapscript.h"
 #include "superscalar/fee_estimator.h"
 #include "superscalar/persist.h"
+#include "superscalar/cltv_watchdog.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -297,6 +298,12 @@ void channel_cleanup(channel_t *ch) {
     ch->htlcs = NULL;
     ch->htlcs_cap = 0;
     ch->n_htlcs = 0;
+    free(ch->htlc_hash_idx);
+    ch->htlc_hash_idx = NULL;
+    ch->htlc_hash_idx_cap = 0;
+    ch->htlc_hash_idx_used = 0;
+    ch->htlc_hash_idx_base = NULL;
+    ch->htlc_hash_idx_n = 0;
 
     free(ch->ptlcs);
     ch->ptlcs = NULL;
@@ -1751,8 +1758,105 @@ void channel_set_remote_htlc_basepoint(channel_t *ch,
 
 /* ---- HTLC operations ---- */
 
+/*
+ * ch->htlcs is kept in id order: channel_add_htlc appends ids from the
+ * monotonic next_htlc_id, removal preserves order, and persisted HTLCs
+ * load ORDER BY htlc_id.  Commitment outputs are emitted in this order,
+ * so it is also the order both sides agree on.  Lookups by id are a
+ * binary search; lookups by payment_hash go through htlc_hash_idx, which
+ * maps to ids (stable across removals) rather than array positions.
+ */
+
+htlc_t *channel_find_htlc(const channel_t *ch, uint64_t htlc_id) {
+    if (!ch || !ch->htlcs) return NULL;
+    size_t lo = 0, hi = ch->n_htlcs;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ch->htlcs[mid].id < htlc_id) lo = mid + 1;
+        else hi = mid;
+    }
+    for (size_t i = lo; i < ch->n_htlcs && ch->htlcs[i].id == htlc_id; i++)
+        if (ch->htlcs[i].state == HTLC_STATE_ACTIVE) return &ch->htlcs[i];
+    /* Not found: fall back to a scan in case the array was filled out of
+       order by hand (tests, ad-hoc recovery code). */
+    for (size_t i = 0; i < ch->n_htlcs; i++)
+        if (ch->htlcs[i].id == htlc_id && ch->htlcs[i].state == HTLC_STATE_ACTIVE)
+            return &ch->htlcs[i];
+    return NULL;
+}
+
+static size_t htlc_hash_pos(const unsigned char *payment_hash32, size_t mask) {
+    uint64_t k;
+    memcpy(&k, payment_hash32, 8);
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static void htlc_hash_idx_put(channel_t *ch, const htlc_t *h) {
+    size_t mask = ch->htlc_hash_idx_cap - 1;
+    size_t i = htlc_hash_pos(h->payment_hash, mask);
+    while (ch->htlc_hash_idx[i]) i = (i + 1) & mask;
+    ch->htlc_hash_idx[i] = h->id + 1;
+    ch->htlc_hash_idx_used++;
+}
+
+/* Rebuild from the active HTLCs.  Removed ids are never reused, so the
+   index only drops them here; lookups skip them meanwhile. */
+static int htlc_hash_idx_rebuild(channel_t *ch) {
+    size_t cap = 16;
+    while (cap < 4 * (ch->n_htlcs + 1)) cap *= 2;
+    if (cap != ch->htlc_hash_idx_cap) {
+        uint64_t *t = realloc(ch->htlc_hash_idx, cap * sizeof(uint64_t));
+        if (!t) return 0;
+        ch->htlc_hash_idx = t;
+        ch->htlc_hash_idx_cap = cap;
+    }
+    memset(ch->htlc_hash_idx, 0, cap * sizeof(uint64_t));
+    ch->htlc_hash_idx_used = 0;
+    for (size_t i = 0; i < ch->n_htlcs; i++)
+        if (ch->htlcs[i].state == HTLC_STATE_ACTIVE)
+            htlc_hash_idx_put(ch, &ch->htlcs[i]);
+    ch->htlc_hash_idx_base = ch->htlcs;
+    ch->htlc_hash_idx_n = ch->n_htlcs;
+    return 1;
+}
+
+static int htlc_hash_idx_valid(const channel_t *ch) {
+    return ch->htlc_hash_idx_cap &&
+           ch->htlc_hash_idx_base == ch->htlcs &&
+           ch->htlc_hash_idx_n == ch->n_htlcs;
+}
+
+htlc_t *channel_find_htlc_by_hash(channel_t *ch,
+                                    const unsigned char *payment_hash32,
+                                    htlc_direction_t direction) {
+    if (!ch || !payment_hash32 || ch->n_htlcs == 0) return NULL;
+    if (!htlc_hash_idx_valid(ch) && !htlc_hash_idx_rebuild(ch)) return NULL;
+    size_t mask = ch->htlc_hash_idx_cap - 1;
+    for (size_t i = htlc_hash_pos(payment_hash32, mask); ch->htlc_hash_idx[i];
+         i = (i + 1) & mask) {
+        htlc_t *h = channel_find_htlc(ch, ch->htlc_hash_idx[i] - 1);
+        if (h && h->direction == direction &&
+            memcmp(h->payment_hash, payment_hash32, 32) == 0)
+            return h;
+    }
+    return NULL;
+}
+
+/* Remove one resolved HTLC, keeping id order. */
+static void channel_remove_htlc(channel_t *ch, htlc_t *h) {
+    int idx_valid = htlc_hash_idx_valid(ch);
+    size_t i = (size_t)(h - ch->htlcs);
+    memmove(h, h + 1, (ch->n_htlcs - i - 1) * sizeof(htlc_t));
+    ch->n_htlcs--;
+    if (idx_valid) ch->htlc_hash_idx_n = ch->n_htlcs;
+}
+
 /* Remove settled (fulfilled/failed) HTLCs from the array to free slots. */
 static void channel_compact_htlcs(channel_t *ch) {
+    int idx_valid = htlc_hash_idx_valid(ch);
     size_t write = 0;
     for (size_t read = 0; read < ch->n_htlcs; read++) {
         if (ch->htlcs[read].state == HTLC_STATE_ACTIVE) {
@@ -1762,6 +1866,7 @@ static void channel_compact_htlcs(channel_t *ch) {
         }
     }
     ch->n_htlcs = write;
+    if (idx_valid) ch->htlc_hash_idx_n = ch->n_htlcs;
 }
 
 int channel_add_htlc(channel_t *ch, htlc_direction_t direction,
@@ -1782,6 +1887,8 @@ int channel_add_htlc(channel_t *ch, htlc_direction_t direction,
         return 0;
     }
 
+    int idx_valid = htlc_hash_idx_valid(ch);
+
     /* Grow htlc array if at capacity (up to MAX_HTLCS) */
     if (ch->n_htlcs >= ch->htlcs_cap) {
         size_t new_cap = ch->htlcs_cap < DEFAULT_HTLCS_CAP
@@ -1859,6 +1966,20 @@ int channel_add_htlc(channel_t *ch, htlc_direction_t direction,
     h->id = ch->next_htlc_id++;
     h->fee_at_add = per_htlc_fee;
 
+    /* Keep the payment_hash index current; once half full it is left
+       stale and rebuilt (sized for the live set) on the next lookup. */
+    if (idx_valid && (ch->htlc_hash_idx_used + 1) * 2 <= ch->htlc_hash_idx_cap) {
+        htlc_hash_idx_put(ch, h);
+        ch->htlc_hash_idx_base = ch->htlcs;
+        ch->htlc_hash_idx_n = ch->n_htlcs;
+    }
+
+    if (ch->cltv_deadlines && cltv_expiry &&
+        !cltv_deadlines_add((cltv_deadlines_t *)ch->cltv_deadlines, ch,
+                            h->id, cltv_expiry))
+        fprintf(stderr, "channel_add_htlc: warning — HTLC %" PRIu64
+                " not added to expiry deadlines\n", h->id);
+
     if (htlc_id_out)
         *htlc_id_out = h->id;
 
@@ -1869,14 +1990,7 @@ int channel_add_htlc(channel_t *ch, htlc_direction_t direction,
 
 int channel_fulfill_htlc(channel_t *ch, uint64_t htlc_id,
                            const unsigned char *preimage32) {
-    /* Find HTLC by id */
-    htlc_t *h = NULL;
-    for (size_t i = 0; i < ch->n_htlcs; i++) {
-        if (ch->htlcs[i].id == htlc_id && ch->htlcs[i].state == HTLC_STATE_ACTIVE) {
-            h = &ch->htlcs[i];
-            break;
-        }
-    }
+    htlc_t *h = channel_find_htlc(ch, htlc_id);
     if (!h) return 0;
 
     /* Verify SHA256(preimage) == payment_hash */
@@ -1904,21 +2018,12 @@ int channel_fulfill_htlc(channel_t *ch, uint64_t htlc_id,
     h->state = HTLC_STATE_FULFILLED;
     ch->commitment_number++;
     channel_generate_local_pcs(ch, ch->commitment_number + 1);
-    channel_compact_htlcs(ch);
+    channel_remove_htlc(ch, h);
     return 1;
 }
 
-int channel_fail_htlc(channel_t *ch, uint64_t htlc_id) {
-    /* Find HTLC by id */
-    htlc_t *h = NULL;
-    for (size_t i = 0; i < ch->n_htlcs; i++) {
-        if (ch->htlcs[i].id == htlc_id && ch->htlcs[i].state == HTLC_STATE_ACTIVE) {
-            h = &ch->htlcs[i];
-            break;
-        }
-    }
-    if (!h) return 0;
-
+/* Refund a failed HTLC and advance the commitment; caller removes it. */
+static void channel_resolve_failed_htlc(channel_t *ch, htlc_t *h) {
     /* Return funds to offerer */
     if (h->direction == HTLC_OFFERED) {
         ch->local_amount += h->amount_sats;
@@ -1935,7 +2040,13 @@ int channel_fail_htlc(channel_t *ch, uint64_t htlc_id) {
     h->state = HTLC_STATE_FAILED;
     ch->commitment_number++;
     channel_generate_local_pcs(ch, ch->commitment_number + 1);
-    channel_compact_htlcs(ch);
+}
+
+int channel_fail_htlc(channel_t *ch, uint64_t htlc_id) {
+    htlc_t *h = channel_find_htlc(ch, htlc_id);
+    if (!h) return 0;
+    channel_resolve_failed_htlc(ch, h);
+    channel_remove_htlc(ch, h);
     return 1;
 }
 
@@ -1949,15 +2060,17 @@ int channel_check_htlc_timeouts(channel_t *ch, uint32_t current_height) {
         return 0;
     ch->last_htlc_check_height = current_height;
 
+    /* Fail every expired HTLC in one pass, then compact once */
     int failed = 0;
     for (size_t i = 0; i < ch->n_htlcs; i++) {
         if (ch->htlcs[i].state == HTLC_STATE_ACTIVE &&
             ch->htlcs[i].cltv_expiry > 0 &&
             current_height >= ch->htlcs[i].cltv_expiry) {
-            channel_fail_htlc(ch, ch->htlcs[i].id);
+            channel_resolve_failed_htlc(ch, &ch->htlcs[i]);
             failed++;
         }
     }
+    if (failed) channel_compact_htlcs(ch);
     return failed;
 }
 
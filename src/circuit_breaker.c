@@ -6,6 +6,7 @@
  */
 
 #include "superscalar/circuit_breaker.h"
+#include <stdlib.h>
 #include <string.h>
 
 /* ---- Helpers ---- */
@@ -23,15 +24,106 @@ static uint32_t get_be32(const unsigned char *b) {
 
 /* ---- Internal helpers ---- */
 
-static circuit_breaker_peer_t *find_peer(circuit_breaker_t *cb,
-                                          const unsigned char pubkey[33])
+static uint64_t mix64(uint64_t x)
 {
-    for (int i = 0; i < cb->n_peers; i++) {
-        if (cb->peers[i].active &&
-            memcmp(cb->peers[i].peer_pubkey, pubkey, 33) == 0)
-            return &cb->peers[i];
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t pubkey_hash(const unsigned char pk[33])
+{
+    /* Skip the parity byte; the x coordinate is already uniform */
+    uint64_t k = 0;
+    for (int i = 1; i <= 8; i++) k = (k << 8) | pk[i];
+    return mix64(k);
+}
+
+/*
+ * Lazy refill: credit rate tokens per hour for the time since *last, keeping
+ * the unspent fraction of a token by moving *last forward only as far as the
+ * whole tokens credited.
+ */
+static void bucket_refill(uint32_t *tokens, uint32_t *last, uint32_t rate,
+                          uint32_t now)
+{
+    if (*tokens >= rate) {
+        if (now > *last) *last = now;
+        return;
+    }
+    if (now <= *last) return;
+    uint64_t units = (uint64_t)(now - *last) * rate;
+    uint64_t add = units / CIRCUIT_BREAKER_SECS_PER_HOUR;
+    if (add == 0) return;
+    if (add >= (uint64_t)(rate - *tokens)) {
+        *tokens = rate;
+        *last = now;
+        return;
+    }
+    *tokens += (uint32_t)add;
+    *last = now - (uint32_t)((units % CIRCUIT_BREAKER_SECS_PER_HOUR) / rate);
+}
+
+static int within_limits(uint16_t pending_htlcs, uint16_t max_htlcs,
+                         uint64_t pending_msat, uint64_t max_msat,
+                         uint64_t amount_msat)
+{
+    if (pending_htlcs >= max_htlcs) return 0;
+    if (max_msat > 0 && pending_msat + amount_msat > max_msat) return 0;
+    return 1;
+}
+
+/* -- Peer table -- */
+
+static long peer_lookup(const circuit_breaker_t *cb,
+                        const unsigned char pubkey[33])
+{
+    if (cb->peer_idx_cap == 0) return -1;
+    size_t mask = cb->peer_idx_cap - 1;
+    for (size_t s = (size_t)pubkey_hash(pubkey) & mask; ; s = (s + 1) & mask) {
+        uint32_t v = cb->peer_idx[s];
+        if (v == 0) return -1;
+        if (memcmp(cb->peers[v - 1].peer_pubkey, pubkey, 33) == 0)
+            return (long)(v - 1);
+    }
+}
+
+static void peer_idx_put(circuit_breaker_t *cb, uint32_t slot)
+{
+    size_t mask = cb->peer_idx_cap - 1;
+    size_t s = (size_t)pubkey_hash(cb->peers[slot].peer_pubkey) & mask;
+    while (cb->peer_idx[s] != 0) s = (s + 1) & mask;
+    cb->peer_idx[s] = slot + 1;
+}
+
+static void peer_idx_del(circuit_breaker_t *cb, uint32_t slot)
+{
+    size_t mask = cb->peer_idx_cap - 1;
+    size_t s = (size_t)pubkey_hash(cb->peers[slot].peer_pubkey) & mask;
+    while (cb->peer_idx[s] != slot + 1) s = (s + 1) & mask;
+
+    /* Backward-shift deletion keeps probe chains intact */
+    size_t hole = s;
+    for (size_t j = (hole + 1) & mask; cb->peer_idx[j] != 0; j = (j + 1) & mask) {
+        size_t home = (size_t)pubkey_hash(
+            cb->peers[cb->peer_idx[j] - 1].peer_pubkey) & mask;
+        int stays = (hole <= j) ? (hole < home && home <= j)
+                                : (hole < home || home <= j);
+        if (stays) continue;
+        cb->peer_idx[hole] = cb->peer_idx[j];
+        hole = j;
     }
-    return NULL;
+    cb->peer_idx[hole] = 0;
+}
+
+static circuit_breaker_peer_t *find_peer(const circuit_breaker_t *cb,
+                                          const unsigned char pubkey[33])
+{
+    long i = peer_lookup(cb, pubkey);
+    return i >= 0 ? &cb->peers[i] : NULL;
 }
 
 static circuit_breaker_peer_t *find_or_create_peer(circuit_breaker_t *cb,
@@ -39,8 +131,31 @@ static circuit_breaker_peer_t *find_or_create_peer(circuit_breaker_t *cb,
 {
     circuit_breaker_peer_t *p = find_peer(cb, pubkey);
     if (p) return p;
-    if (cb->n_peers >= CIRCUIT_BREAKER_MAX_PEERS) return NULL;
-    p = &cb->peers[cb->n_peers++];
+
+    if (cb->n_free_peers == 0 && cb->n_peers == cb->peers_cap) {
+        int nc = cb->peers_cap ? cb->peers_cap * 2 : 16;
+        circuit_breaker_peer_t *np = realloc(cb->peers, (size_t)nc * sizeof(*np));
+        if (!np) return NULL;
+        cb->peers = np;
+        uint32_t *nf = realloc(cb->free_peers, (size_t)nc * sizeof(*nf));
+        if (!nf) return NULL;
+        cb->free_peers = nf;
+        cb->peers_cap = nc;
+    }
+    if ((size_t)(cb->n_live_peers + 1) * 2 > cb->peer_idx_cap) {
+        size_t nc = cb->peer_idx_cap ? cb->peer_idx_cap * 2 : 32;
+        uint32_t *ni = calloc(nc, sizeof(*ni));
+        if (!ni) return NULL;
+        free(cb->peer_idx);
+        cb->peer_idx = ni;
+        cb->peer_idx_cap = nc;
+        for (int i = 0; i < cb->n_peers; i++)
+            if (cb->peers[i].active) peer_idx_put(cb, (uint32_t)i);
+    }
+
+    uint32_t slot = cb->n_free_peers ? cb->free_peers[--cb->n_free_peers]
+                                     : (uint32_t)cb->n_peers++;
+    p = &cb->peers[slot];
     memset(p, 0, sizeof(*p));
     memcpy(p->peer_pubkey, pubkey, 33);
     p->active               = 1;
@@ -48,9 +163,92 @@ static circuit_breaker_peer_t *find_or_create_peer(circuit_breaker_t *cb,
     p->max_pending_msat     = cb->default_max_pending_msat;
     p->max_htlcs_per_hour   = cb->default_max_htlcs_per_hour;
     p->tokens               = p->max_htlcs_per_hour;
+    peer_idx_put(cb, slot);
+    cb->n_live_peers++;
     return p;
 }
 
+/* -- Channel table -- */
+
+static long chan_lookup(const circuit_breaker_t *cb, uint64_t scid)
+{
+    if (cb->chan_idx_cap == 0) return -1;
+    size_t mask = cb->chan_idx_cap - 1;
+    for (size_t s = (size_t)mix64(scid) & mask; ; s = (s + 1) & mask) {
+        uint32_t v = cb->chan_idx[s];
+        if (v == 0) return -1;
+        if (cb->chans[v - 1].scid == scid) return (long)(v - 1);
+    }
+}
+
+static void chan_idx_put(circuit_breaker_t *cb, uint32_t slot)
+{
+    size_t mask = cb->chan_idx_cap - 1;
+    size_t s = (size_t)mix64(cb->chans[slot].scid) & mask;
+    while (cb->chan_idx[s] != 0) s = (s + 1) & mask;
+    cb->chan_idx[s] = slot + 1;
+}
+
+static void chan_idx_del(circuit_breaker_t *cb, uint32_t slot)
+{
+    size_t mask = cb->chan_idx_cap - 1;
+    size_t s = (size_t)mix64(cb->chans[slot].scid) & mask;
+    while (cb->chan_idx[s] != slot + 1) s = (s + 1) & mask;
+
+    size_t hole = s;
+    for (size_t j = (hole + 1) & mask; cb->chan_idx[j] != 0; j = (j + 1) & mask) {
+        size_t home = (size_t)mix64(cb->chans[cb->chan_idx[j] - 1].scid) & mask;
+        int stays = (hole <= j) ? (hole < home && home <= j)
+                                : (hole < home || home <= j);
+        if (stays) continue;
+        cb->chan_idx[hole] = cb->chan_idx[j];
+        hole = j;
+    }
+    cb->chan_idx[hole] = 0;
+}
+
+static circuit_breaker_chan_t *find_or_create_chan(circuit_breaker_t *cb,
+                                                    uint64_t scid)
+{
+    long i = chan_lookup(cb, scid);
+    if (i >= 0) return &cb->chans[i];
+
+    if (cb->n_free_chans == 0 && cb->n_chans == cb->chans_cap) {
+        int nc = cb->chans_cap ? cb->chans_cap * 2 : 16;
+        circuit_breaker_chan_t *nch = realloc(cb->chans, (size_t)nc * sizeof(*nch));
+        if (!nch) return NULL;
+        cb->chans = nch;
+        uint32_t *nf = realloc(cb->free_chans, (size_t)nc * sizeof(*nf));
+        if (!nf) return NULL;
+        cb->free_chans = nf;
+        cb->chans_cap = nc;
+    }
+    if ((size_t)(cb->n_live_chans + 1) * 2 > cb->chan_idx_cap) {
+        size_t nc = cb->chan_idx_cap ? cb->chan_idx_cap * 2 : 32;
+        uint32_t *ni = calloc(nc, sizeof(*ni));
+        if (!ni) return NULL;
+        free(cb->chan_idx);
+        cb->chan_idx = ni;
+        cb->chan_idx_cap = nc;
+        for (int k = 0; k < cb->n_chans; k++)
+            if (cb->chans[k].active) chan_idx_put(cb, (uint32_t)k);
+    }
+
+    uint32_t slot = cb->n_free_chans ? cb->free_chans[--cb->n_free_chans]
+                                     : (uint32_t)cb->n_chans++;
+    circuit_breaker_chan_t *c = &cb->chans[slot];
+    memset(c, 0, sizeof(*c));
+    c->scid               = scid;
+    c->active             = 1;
+    c->max_pending_htlcs  = cb->default_max_pending_htlcs;
+    c->max_pending_msat   = cb->default_max_pending_msat;
+    c->max_htlcs_per_hour = cb->default_max_htlcs_per_hour;
+    c->tokens             = c->max_htlcs_per_hour;
+    chan_idx_put(cb, slot);
+    cb->n_live_chans++;
+    return c;
+}
+
 /* ---- Public API ---- */
 
 void circuit_breaker_init(circuit_breaker_t *cb)
@@ -62,6 +260,23 @@ void circuit_breaker_init(circuit_breaker_t *cb)
     cb->default_max_htlcs_per_hour = CIRCUIT_BREAKER_DEFAULT_HOURLY_RATE;
 }
 
+void circuit_breaker_free(circuit_breaker_t *cb)
+{
+    if (!cb) return;
+    free(cb->peers);
+    free(cb->free_peers);
+    free(cb->peer_idx);
+    free(cb->chans);
+    free(cb->free_chans);
+    free(cb->chan_idx);
+    cb->peers = NULL;      cb->n_peers = 0;  cb->peers_cap = 0;
+    cb->free_peers = NULL; cb->n_free_peers = 0;
+    cb->peer_idx = NULL;   cb->peer_idx_cap = 0;  cb->n_live_peers = 0;
+    cb->chans = NULL;      cb->n_chans = 0;  cb->chans_cap = 0;
+    cb->free_chans = NULL; cb->n_free_chans = 0;
+    cb->chan_idx = NULL;   cb->chan_idx_cap = 0;  cb->n_live_chans = 0;
+}
+
 void circuit_breaker_set_peer_limits(circuit_breaker_t *cb,
                                       const unsigned char peer_pubkey[33],
                                       uint16_t max_pending_htlcs,
@@ -74,37 +289,56 @@ void circuit_breaker_set_peer_limits(circuit_breaker_t *cb,
     p->max_pending_htlcs  = max_pending_htlcs;
     p->max_pending_msat   = max_pending_msat;
     p->max_htlcs_per_hour = max_htlcs_per_hour;
+    p->configured         = 1;
     if (p->tokens > max_htlcs_per_hour)
         p->tokens = max_htlcs_per_hour;
 }
 
-int circuit_breaker_check_add(circuit_breaker_t *cb,
-                               const unsigned char peer_pubkey[33],
-                               uint64_t amount_msat,
-                               uint32_t now_unix)
+void circuit_breaker_set_channel_limits(circuit_breaker_t *cb, uint64_t scid,
+                                         uint16_t max_pending_htlcs,
+                                         uint64_t max_pending_msat,
+                                         uint32_t max_htlcs_per_hour)
+{
+    if (!cb || scid == 0) return;
+    circuit_breaker_chan_t *c = find_or_create_chan(cb, scid);
+    if (!c) return;
+    c->max_pending_htlcs  = max_pending_htlcs;
+    c->max_pending_msat   = max_pending_msat;
+    c->max_htlcs_per_hour = max_htlcs_per_hour;
+    c->configured         = 1;
+    if (c->tokens > max_htlcs_per_hour)
+        c->tokens = max_htlcs_per_hour;
+}
+
+int circuit_breaker_check_add_ex(circuit_breaker_t *cb,
+                                  const unsigned char peer_pubkey[33],
+                                  uint64_t out_scid,
+                                  uint64_t amount_msat,
+                                  uint32_t now_unix)
 {
     if (!cb || !peer_pubkey) return 0;
 
     circuit_breaker_peer_t *p = find_or_create_peer(cb, peer_pubkey);
     if (!p) return 0;
+    p->last_active_unix = now_unix;
+    bucket_refill(&p->tokens, &p->last_refill_unix, p->max_htlcs_per_hour,
+                  now_unix);
 
-    /* Refill tokens if an hour has passed */
-    if (now_unix >= p->last_refill_unix + CIRCUIT_BREAKER_SECS_PER_HOUR) {
-        uint32_t periods = (now_unix - p->last_refill_unix)
-                           / CIRCUIT_BREAKER_SECS_PER_HOUR;
-        uint32_t add = periods * p->max_htlcs_per_hour;
-        p->tokens = (add > p->max_htlcs_per_hour - p->tokens)
-                    ? p->max_htlcs_per_hour
-                    : p->tokens + add;
-        p->last_refill_unix += periods * CIRCUIT_BREAKER_SECS_PER_HOUR;
+    circuit_breaker_chan_t *c = NULL;
+    if (out_scid != 0) {
+        c = find_or_create_chan(cb, out_scid);
+        if (!c) return 0;
+        c->last_active_unix = now_unix;
+        bucket_refill(&c->tokens, &c->last_refill_unix, c->max_htlcs_per_hour,
+                      now_unix);
     }
 
-    /* Check pending HTLC count */
-    if (p->pending_htlc_count >= p->max_pending_htlcs) return 0;
-
-    /* Check pending amount */
-    if (p->max_pending_msat > 0 &&
-        p->pending_msat + amount_msat > p->max_pending_msat) return 0;
+    if (!within_limits(p->pending_htlc_count, p->max_pending_htlcs,
+                       p->pending_msat, p->max_pending_msat, amount_msat))
+        return 0;
+    if (c && !within_limits(c->pending_htlc_count, c->max_pending_htlcs,
+                            c->pending_msat, c->max_pending_msat, amount_msat))
+        return 0;
 
     /* Check rate limit token; escalate to ban on exhaustion */
     if (p->tokens == 0) {
@@ -112,37 +346,104 @@ int circuit_breaker_check_add(circuit_breaker_t *cb,
             cb->ban_fn(cb->ban_ctx, peer_pubkey, cb->ban_duration_secs);
         return 0;
     }
+    if (c && c->tokens == 0) return 0;
 
-    /* Accept: consume token and increment counters */
+    /* Accept: consume tokens and increment counters */
     p->tokens--;
     p->pending_htlc_count++;
     p->pending_msat += amount_msat;
+    if (c) {
+        c->tokens--;
+        c->pending_htlc_count++;
+        c->pending_msat += amount_msat;
+    }
     return 1;
 }
 
+int circuit_breaker_check_add(circuit_breaker_t *cb,
+                               const unsigned char peer_pubkey[33],
+                               uint64_t amount_msat,
+                               uint32_t now_unix)
+{
+    return circuit_breaker_check_add_ex(cb, peer_pubkey, 0, amount_msat,
+                                        now_unix);
+}
+
+void circuit_breaker_record_settled_ex(circuit_breaker_t *cb,
+                                        const unsigned char peer_pubkey[33],
+                                        uint64_t out_scid,
+                                        uint64_t amount_msat,
+                                        uint32_t now_unix)
+{
+    if (!cb || !peer_pubkey) return;
+    circuit_breaker_peer_t *p = find_peer(cb, peer_pubkey);
+    if (p) {
+        if (p->pending_htlc_count > 0) p->pending_htlc_count--;
+        if (p->pending_msat >= amount_msat) p->pending_msat -= amount_msat;
+        else p->pending_msat = 0;
+        if (now_unix > p->last_active_unix) p->last_active_unix = now_unix;
+    }
+    long ci = out_scid ? chan_lookup(cb, out_scid) : -1;
+    if (ci >= 0) {
+        circuit_breaker_chan_t *c = &cb->chans[ci];
+        if (c->pending_htlc_count > 0) c->pending_htlc_count--;
+        if (c->pending_msat >= amount_msat) c->pending_msat -= amount_msat;
+        else c->pending_msat = 0;
+        if (now_unix > c->last_active_unix) c->last_active_unix = now_unix;
+    }
+}
+
 void circuit_breaker_record_settled(circuit_breaker_t *cb,
                                      const unsigned char peer_pubkey[33],
                                      uint64_t amount_msat)
 {
-    if (!cb || !peer_pubkey) return;
-    circuit_breaker_peer_t *p = find_peer(cb, peer_pubkey);
-    if (!p) return;
-    if (p->pending_htlc_count > 0) p->pending_htlc_count--;
-    if (p->pending_msat >= amount_msat) p->pending_msat -= amount_msat;
-    else p->pending_msat = 0;
+    circuit_breaker_record_settled_ex(cb, peer_pubkey, 0, amount_msat, 0);
 }
 
 void circuit_breaker_refill_tokens(circuit_breaker_t *cb, uint32_t now_unix)
 {
     if (!cb) return;
     for (int i = 0; i < cb->n_peers; i++) {
-        if (!cb->peers[i].active) continue;
         circuit_breaker_peer_t *p = &cb->peers[i];
-        if (now_unix >= p->last_refill_unix + CIRCUIT_BREAKER_SECS_PER_HOUR) {
-            p->tokens = p->max_htlcs_per_hour;
-            p->last_refill_unix = now_unix;
-        }
+        if (!p->active) continue;
+        bucket_refill(&p->tokens, &p->last_refill_unix, p->max_htlcs_per_hour,
+                      now_unix);
+    }
+    for (int i = 0; i < cb->n_chans; i++) {
+        circuit_breaker_chan_t *c = &cb->chans[i];
+        if (!c->active) continue;
+        bucket_refill(&c->tokens, &c->last_refill_unix, c->max_htlcs_per_hour,
+                      now_unix);
+    }
+}
+
+int circuit_breaker_evict_idle(circuit_breaker_t *cb, uint32_t now_unix)
+{
+    if (!cb) return 0;
+    int evicted = 0;
+    /* After an hour idle the bucket (rate per hour) is full again, so an
+     * unconfigured entry with nothing pending equals a fresh default one. */
+    for (int i = 0; i < cb->n_peers; i++) {
+        circuit_breaker_peer_t *p = &cb->peers[i];
+        if (!p->active || p->configured || p->pending_htlc_count > 0) continue;
+        if (now_unix < p->last_active_unix + CIRCUIT_BREAKER_IDLE_SECS) continue;
+        peer_idx_del(cb, (uint32_t)i);
+        p->active = 0;
+        cb->free_peers[cb->n_free_peers++] = (uint32_t)i;
+        cb->n_live_peers--;
+        evicted++;
+    }
+    for (int i = 0; i < cb->n_chans; i++) {
+        circuit_breaker_chan_t *c = &cb->chans[i];
+        if (!c->active || c->configured || c->pending_htlc_count > 0) continue;
+        if (now_unix < c->last_active_unix + CIRCUIT_BREAKER_IDLE_SECS) continue;
+        chan_idx_del(cb, (uint32_t)i);
+        c->active = 0;
+        cb->free_chans[cb->n_free_chans++] = (uint32_t)i;
+        cb->n_live_chans--;
+        evicted++;
     }
+    return evicted;
 }
 
 int circuit_breaker_get_peer_state(const circuit_breaker_t *cb,
@@ -151,15 +452,11 @@ int circuit_breaker_get_peer_state(const circuit_breaker_t *cb,
                                     uint64_t *pending_msat_out)
 {
     if (!cb || !peer_pubkey) return 0;
-    for (int i = 0; i < cb->n_peers; i++) {
-        if (cb->peers[i].active &&
-            memcmp(cb->peers[i].peer_pubkey, peer_pubkey, 33) == 0) {
-            if (pending_htlcs_out) *pending_htlcs_out = cb->peers[i].pending_htlc_count;
-            if (pending_msat_out)  *pending_msat_out  = cb->peers[i].pending_msat;
-            return 1;
-        }
-    }
-    return 0;
+    const circuit_breaker_peer_t *p = find_peer(cb, peer_pubkey);
+    if (!p) return 0;
+    if (pending_htlcs_out) *pending_htlcs_out = p->pending_htlc_count;
+    if (pending_msat_out)  *pending_msat_out  = p->pending_msat;
+    return 1;
 }
 
 /* ---- Channel-Type TLV ---- */
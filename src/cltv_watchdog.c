@@ -7,6 +7,8 @@
 #include "superscalar/cltv_watchdog.h"
 #include "superscalar/channel.h"
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 void cltv_watchdog_init(cltv_watchdog_t *wd, channel_t *ch,
                          uint32_t expiry_delta)
@@ -56,3 +58,186 @@ uint32_t cltv_watchdog_earliest_expiry(const channel_t *ch)
 
     return earliest;
 }
+
+/* ---- Node-wide deadline heap ---- */
+
+static void heap_up(cltv_deadline_t *h, size_t i)
+{
+    cltv_deadline_t v = h[i];
+    while (i > 0) {
+        size_t p = (i - 1) / 2;
+        if (h[p].cltv_expiry <= v.cltv_expiry) break;
+        h[i] = h[p];
+        i = p;
+    }
+    h[i] = v;
+}
+
+static cltv_deadline_t heap_pop(cltv_deadline_t *h, size_t *n)
+{
+    cltv_deadline_t top = h[0];
+    cltv_deadline_t v = h[--*n];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= *n) break;
+        if (c + 1 < *n && h[c + 1].cltv_expiry < h[c].cltv_expiry) c++;
+        if (v.cltv_expiry <= h[c].cltv_expiry) break;
+        h[i] = h[c];
+        i = c;
+    }
+    if (*n > 0) h[i] = v;
+    return top;
+}
+
+static int heap_reserve(cltv_deadline_t **h, size_t n, size_t *cap)
+{
+    if (n < *cap) return 1;
+    size_t nc = *cap ? *cap * 2 : 64;
+    cltv_deadline_t *t = realloc(*h, nc * sizeof(*t));
+    if (!t) return 0;
+    *h = t;
+    *cap = nc;
+    return 1;
+}
+
+static int heap_push(cltv_deadline_t **h, size_t *n, size_t *cap,
+                     cltv_deadline_t v)
+{
+    if (!heap_reserve(h, *n, cap)) return 0;
+    (*h)[*n] = v;
+    heap_up(*h, (*n)++);
+    return 1;
+}
+
+/* The HTLC an entry refers to, or NULL if it was resolved since. */
+static htlc_t *deadline_htlc(const cltv_deadlines_t *dl,
+                             const cltv_deadline_t *e)
+{
+    htlc_t *h = channel_find_htlc(dl->chans[e->chan], e->htlc_id);
+    if (!h || h->cltv_expiry != e->cltv_expiry) return NULL;
+    return h;
+}
+
+void cltv_deadlines_init(cltv_deadlines_t *dl, uint32_t expiry_delta)
+{
+    memset(dl, 0, sizeof(*dl));
+    dl->expiry_delta = expiry_delta ? expiry_delta : CLTV_EXPIRY_DELTA;
+    pthread_mutex_init(&dl->lock, NULL);
+}
+
+void cltv_deadlines_free(cltv_deadlines_t *dl)
+{
+    if (!dl || dl->expiry_delta == 0) return;  /* never initialised, or freed */
+    pthread_mutex_lock(&dl->lock);
+    for (size_t i = 0; i < dl->n_chans; i++)
+        if (dl->chans[i]->cltv_deadlines == dl)
+            dl->chans[i]->cltv_deadlines = NULL;
+    free(dl->chans);
+    free(dl->pending);
+    free(dl->at_risk);
+    pthread_mutex_unlock(&dl->lock);
+    pthread_mutex_destroy(&dl->lock);
+    memset(dl, 0, sizeof(*dl));
+}
+
+/* cltv_deadlines_add() with dl->lock held. */
+static int add_locked(cltv_deadlines_t *dl, channel_t *ch,
+                      uint64_t htlc_id, uint32_t cltv_expiry)
+{
+    if (ch->cltv_deadlines != dl) return 0;
+    cltv_deadline_t e = { cltv_expiry, ch->cltv_chan_idx, htlc_id };
+    return heap_push(&dl->pending, &dl->n_pending, &dl->pending_cap, e);
+}
+
+int cltv_deadlines_watch(cltv_deadlines_t *dl, channel_t *ch)
+{
+    if (!dl || !ch) return 0;
+    int ok = 1;
+    pthread_mutex_lock(&dl->lock);
+    if (ch->cltv_deadlines == dl) goto out;
+
+    if (dl->n_chans == dl->chans_cap) {
+        size_t nc = dl->chans_cap ? dl->chans_cap * 2 : 16;
+        channel_t **t = realloc(dl->chans, nc * sizeof(*t));
+        if (!t) {
+            ok = 0;
+            goto out;
+        }
+        dl->chans = t;
+        dl->chans_cap = nc;
+    }
+    ch->cltv_chan_idx = (uint32_t)dl->n_chans;
+    dl->chans[dl->n_chans++] = ch;
+    ch->cltv_deadlines = dl;
+
+    for (size_t i = 0; i < ch->n_htlcs && ok; i++) {
+        const htlc_t *h = &ch->htlcs[i];
+        if (h->state != HTLC_STATE_ACTIVE || h->cltv_expiry == 0) continue;
+        ok = add_locked(dl, ch, h->id, h->cltv_expiry);
+    }
+out:
+    pthread_mutex_unlock(&dl->lock);
+    return ok;
+}
+
+int cltv_deadlines_add(cltv_deadlines_t *dl, channel_t *ch,
+                       uint64_t htlc_id, uint32_t cltv_expiry)
+{
+    if (!dl || !ch) return 0;
+    pthread_mutex_lock(&dl->lock);
+    int ok = add_locked(dl, ch, htlc_id, cltv_expiry);
+    pthread_mutex_unlock(&dl->lock);
+    return ok;
+}
+
+int cltv_deadlines_check(cltv_deadlines_t *dl, uint32_t current_height,
+                         cltv_deadlines_at_risk_fn fn, void *ctx)
+{
+    int count = 0;
+    pthread_mutex_lock(&dl->lock);
+    uint32_t threshold = current_height + dl->expiry_delta;
+
+    while (dl->n_pending > 0 && dl->pending[0].cltv_expiry <= threshold) {
+        /* Reserve first so a popped deadline is never dropped */
+        if (!heap_reserve(&dl->at_risk, dl->n_at_risk, &dl->at_risk_cap))
+            break;
+        cltv_deadline_t e = heap_pop(dl->pending, &dl->n_pending);
+        htlc_t *h = deadline_htlc(dl, &e);
+        if (!h) continue;
+        heap_push(&dl->at_risk, &dl->n_at_risk, &dl->at_risk_cap, e);
+        if (h->direction != HTLC_RECEIVED) continue;
+        count++;
+        if (fn) fn(ctx, dl->chans[e.chan], h);
+    }
+    pthread_mutex_unlock(&dl->lock);
+    return count;
+}
+
+int cltv_deadlines_expire(cltv_deadlines_t *dl, uint32_t current_height)
+{
+    pthread_mutex_lock(&dl->lock);
+    /* Same monotonicity guard as channel_check_htlc_timeouts */
+    if (current_height < dl->last_height) {
+        pthread_mutex_unlock(&dl->lock);
+        return 0;
+    }
+    dl->last_height = current_height;
+
+    int failed = 0;
+    cltv_deadline_t *heaps[2]  = { dl->at_risk, dl->pending };
+    size_t          *counts[2] = { &dl->n_at_risk, &dl->n_pending };
+    for (int k = 0; k < 2; k++) {
+        while (*counts[k] > 0 && heaps[k][0].cltv_expiry <= current_height) {
+            cltv_deadline_t e = heap_pop(heaps[k], counts[k]);
+            channel_t *ch = dl->chans[e.chan];
+            if (!deadline_htlc(dl, &e)) continue;
+            if (current_height > ch->last_htlc_check_height)
+                ch->last_htlc_check_height = current_height;
+            if (channel_fail_htlc(ch, e.htlc_id))
+                failed++;
+        }
+    }
+    pthread_mutex_unlock(&dl->lock);
+    return failed;
+}
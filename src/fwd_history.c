@@ -1,19 +1,347 @@
 /*
  * fwd_history.c — HTLC forwarding history and channel statistics
  *
+ * Rollups live in two open-addressed tables: series keyed by
+ * (scid_in, scid_out) and buckets keyed by (series, level, start).
+ * Minute and hour buckets are queued in creation order and freed once they
+ * fall behind their tier's retention window.
+ *
  * Reference: CLN forwarding.c, LND routing/payment_lifecycle.go
  */
 
 #include "superscalar/fwd_history.h"
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
+#define FWD_MINUTE  60u
+#define FWD_HOUR    3600u
+#define FWD_DAY     86400u
+#define FWD_LEVELS  FWD_ROLLUP_LEVELS
+
+static const uint32_t level_secs[FWD_LEVELS] = { FWD_MINUTE, FWD_HOUR, FWD_DAY };
+static const uint32_t level_keep[2] = { FWD_ROLLUP_MINUTE_KEEP, FWD_ROLLUP_HOUR_KEEP };
+
+/* ---- Internal helpers ---- */
+
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t series_key(uint64_t scid_in, uint64_t scid_out)
+{
+    return mix64(scid_in ^ mix64(scid_out ^ 0x9e3779b97f4a7c15ULL));
+}
+
+static uint64_t bucket_key(uint32_t series, uint32_t level, uint32_t start)
+{
+    return mix64(((uint64_t)series << 34) | ((uint64_t)level << 32) | start);
+}
+
+/* Series index for (scid_in, scid_out), or -1. */
+static long find_series(const fwd_history_t *h,
+                        uint64_t scid_in, uint64_t scid_out)
+{
+    if (h->series_idx_cap == 0) return -1;
+    uint32_t mask = h->series_idx_cap - 1;
+    for (uint32_t s = (uint32_t)series_key(scid_in, scid_out) & mask; ;
+         s = (s + 1) & mask) {
+        uint32_t v = h->series_idx[s];
+        if (v == 0) return -1;
+        const fwd_series_t *se = &h->series[v - 1];
+        if (se->scid_in == scid_in && se->scid_out == scid_out)
+            return (long)(v - 1);
+    }
+}
+
+static void series_idx_put(fwd_history_t *h, uint32_t i)
+{
+    uint32_t mask = h->series_idx_cap - 1;
+    uint32_t s = (uint32_t)series_key(h->series[i].scid_in,
+                                      h->series[i].scid_out) & mask;
+    while (h->series_idx[s] != 0) s = (s + 1) & mask;
+    h->series_idx[s] = i + 1;
+}
+
+/* Series for (scid_in, scid_out), created if missing; -1 on OOM. */
+static long get_series(fwd_history_t *h, uint64_t scid_in, uint64_t scid_out)
+{
+    long i = find_series(h, scid_in, scid_out);
+    if (i >= 0) return i;
+
+    if (h->n_series == h->series_cap) {
+        uint32_t nc = h->series_cap ? h->series_cap * 2 : 16;
+        fwd_series_t *ns = realloc(h->series, (size_t)nc * sizeof(*ns));
+        if (!ns) return -1;
+        h->series = ns;
+        h->series_cap = nc;
+    }
+    if ((h->n_series + 1) * 2 > h->series_idx_cap) {
+        uint32_t nc = h->series_idx_cap ? h->series_idx_cap * 2 : 32;
+        uint32_t *ni = calloc(nc, sizeof(*ni));
+        if (!ni) return -1;
+        free(h->series_idx);
+        h->series_idx = ni;
+        h->series_idx_cap = nc;
+        for (uint32_t k = 0; k < h->n_series; k++)
+            series_idx_put(h, k);
+    }
+    fwd_series_t *se = &h->series[h->n_series];
+    memset(se, 0, sizeof(*se));
+    se->scid_in  = scid_in;
+    se->scid_out = scid_out;
+    series_idx_put(h, h->n_series);
+    return (long)h->n_series++;
+}
+
+/* Bucket slot for (series, level, start), or -1. */
+static long find_bucket(const fwd_history_t *h, uint32_t series,
+                        uint32_t level, uint32_t start)
+{
+    if (h->bucket_idx_cap == 0) return -1;
+    uint32_t mask = h->bucket_idx_cap - 1;
+    for (uint32_t s = (uint32_t)bucket_key(series, level, start) & mask; ;
+         s = (s + 1) & mask) {
+        uint32_t v = h->bucket_idx[s];
+        if (v == 0) return -1;
+        const fwd_bucket_t *b = &h->buckets[v - 1];
+        if (b->series == series && b->level == level && b->start == start)
+            return (long)(v - 1);
+    }
+}
+
+static void bucket_idx_put(fwd_history_t *h, uint32_t slot)
+{
+    const fwd_bucket_t *b = &h->buckets[slot];
+    uint32_t mask = h->bucket_idx_cap - 1;
+    uint32_t s = (uint32_t)bucket_key(b->series, b->level, b->start) & mask;
+    while (h->bucket_idx[s] != 0) s = (s + 1) & mask;
+    h->bucket_idx[s] = slot + 1;
+}
+
+static void bucket_idx_del(fwd_history_t *h, uint32_t slot)
+{
+    const fwd_bucket_t *b = &h->buckets[slot];
+    uint32_t mask = h->bucket_idx_cap - 1;
+    uint32_t s = (uint32_t)bucket_key(b->series, b->level, b->start) & mask;
+    while (h->bucket_idx[s] != slot + 1) s = (s + 1) & mask;
+
+    /* Backward-shift deletion keeps probe chains intact */
+    uint32_t hole = s;
+    for (uint32_t j = (hole + 1) & mask; h->bucket_idx[j] != 0;
+         j = (j + 1) & mask) {
+        const fwd_bucket_t *o = &h->buckets[h->bucket_idx[j] - 1];
+        uint32_t home = (uint32_t)bucket_key(o->series, o->level, o->start) & mask;
+        int stays = (hole <= j) ? (hole < home && home <= j)
+                                : (hole < home || home <= j);
+        if (stays) continue;
+        h->bucket_idx[hole] = h->bucket_idx[j];
+        hole = j;
+    }
+    h->bucket_idx[hole] = 0;
+}
+
+static int expiry_push(fwd_history_t *h, int level, uint32_t slot)
+{
+    if (h->expiry_len[level] == h->expiry_cap[level]) {
+        uint32_t oc = h->expiry_cap[level];
+        uint32_t nc = oc ? oc * 2 : 64;
+        uint32_t *nq = malloc((size_t)nc * sizeof(*nq));
+        if (!nq) return 0;
+        for (uint32_t k = 0; k < h->expiry_len[level]; k++)
+            nq[k] = h->expiry[level][(h->expiry_head[level] + k) % oc];
+        free(h->expiry[level]);
+        h->expiry[level] = nq;
+        h->expiry_cap[level] = nc;
+        h->expiry_head[level] = 0;
+    }
+    uint32_t at = (h->expiry_head[level] + h->expiry_len[level])
+                  % h->expiry_cap[level];
+    h->expiry[level][at] = slot;
+    h->expiry_len[level]++;
+    return 1;
+}
+
+/* Bucket for (series, level, start), created if missing; NULL on OOM. */
+static fwd_bucket_t *get_bucket(fwd_history_t *h, uint32_t series,
+                                uint32_t level, uint32_t start)
+{
+    long found = find_bucket(h, series, level, start);
+    if (found >= 0) return &h->buckets[found];
+
+    if (h->n_free_buckets == 0 && h->n_bucket_slots == h->bucket_cap) {
+        uint32_t nc = h->bucket_cap ? h->bucket_cap * 2 : 64;
+        fwd_bucket_t *nb = realloc(h->buckets, (size_t)nc * sizeof(*nb));
+        if (!nb) return NULL;
+        h->buckets = nb;
+        uint32_t *nf = realloc(h->free_buckets, (size_t)nc * sizeof(*nf));
+        if (!nf) return NULL;
+        h->free_buckets = nf;
+        h->bucket_cap = nc;
+    }
+    if ((h->n_buckets + 1) * 2 > h->bucket_idx_cap) {
+        uint32_t nc = h->bucket_idx_cap ? h->bucket_idx_cap * 2 : 128;
+        while ((h->n_buckets + 1) * 2 > nc) nc *= 2;
+        uint32_t *ni = calloc(nc, sizeof(*ni));
+        if (!ni) return NULL;
+        free(h->bucket_idx);
+        h->bucket_idx = ni;
+        h->bucket_idx_cap = nc;
+        /* Free slots have level == FWD_LEVELS */
+        for (uint32_t k = 0; k < h->n_bucket_slots; k++)
+            if (h->buckets[k].level < FWD_LEVELS)
+                bucket_idx_put(h, k);
+    }
+
+    uint32_t slot = h->n_free_buckets ? h->free_buckets[--h->n_free_buckets]
+                                      : h->n_bucket_slots++;
+    if (level < 2 && !expiry_push(h, (int)level, slot)) {
+        h->buckets[slot].level = FWD_LEVELS;
+        h->free_buckets[h->n_free_buckets++] = slot;
+        return NULL;
+    }
+    fwd_bucket_t *b = &h->buckets[slot];
+    memset(b, 0, sizeof(*b));
+    b->series = series;
+    b->level  = level;
+    b->start  = start;
+    bucket_idx_put(h, slot);
+    h->n_buckets++;
+    return b;
+}
+
+/* Oldest bucket start still kept at level (minute / hour), as of last_at. */
+static uint64_t level_cutoff(const fwd_history_t *h, int level)
+{
+    uint64_t sz = level_secs[level];
+    uint64_t newest = (uint64_t)h->last_at / sz * sz;
+    uint64_t span = (uint64_t)(level_keep[level] - 1) * sz;
+    return newest > span ? newest - span : 0;
+}
+
+/* Drop minute / hour buckets that fell out of their retention window. */
+static void expire_buckets(fwd_history_t *h)
+{
+    for (int level = 0; level < 2; level++) {
+        uint64_t cut = level_cutoff(h, level);
+        while (h->expiry_len[level] > 0) {
+            uint32_t slot = h->expiry[level][h->expiry_head[level]];
+            if (h->buckets[slot].start >= cut) break;
+            bucket_idx_del(h, slot);
+            h->buckets[slot].level = FWD_LEVELS;
+            h->free_buckets[h->n_free_buckets++] = slot;
+            h->n_buckets--;
+            h->expiry_head[level] = (h->expiry_head[level] + 1)
+                                    % h->expiry_cap[level];
+            h->expiry_len[level]--;
+        }
+    }
+}
+
+static void rollup_acc(fwd_rollup_t *r, const fwd_rollup_t *d)
+{
+    r->fee_msat  += d->fee_msat;
+    r->in_msat   += d->in_msat;
+    r->out_msat  += d->out_msat;
+    r->n_settled += d->n_settled;
+    r->n_failed  += d->n_failed;
+}
+
+static void rollup_add(fwd_history_t *h, uint64_t scid_in, uint64_t scid_out,
+                       const fwd_rollup_t *d, uint32_t t)
+{
+    if (h->n_series == 0 || t < h->first_at) h->first_at = t;
+    if (t > h->last_at) {
+        h->last_at = t;
+        expire_buckets(h);
+    }
+
+    /* The pair, each side, and the whole node; a pair with a zero scid
+     * coincides with its side series and is only counted once. */
+    uint64_t keys[4][2] = {
+        { 0, 0 }, { scid_in, 0 }, { 0, scid_out }, { scid_in, scid_out }
+    };
+    long done[4];
+    for (int k = 0; k < 4; k++) {
+        long si = get_series(h, keys[k][0], keys[k][1]);
+        done[k] = si;
+        if (si < 0) continue;
+        int dup = 0;
+        for (int j = 0; j < k; j++)
+            if (done[j] == si) dup = 1;
+        if (dup) continue;
+
+        rollup_acc(&h->series[si].total, d);
+        for (uint32_t level = 0; level < FWD_LEVELS; level++) {
+            uint32_t start = t / level_secs[level] * level_secs[level];
+            if (level < 2 && start < level_cutoff(h, (int)level)) continue;
+            fwd_bucket_t *b = get_bucket(h, (uint32_t)si, level, start);
+            if (b) {
+                rollup_acc(&b->r, d);
+                b->dirty = 1;
+            }
+        }
+    }
+}
+
+/* Sum of series si's buckets starting in [since, until]. */
+static void series_window(const fwd_history_t *h, uint32_t si,
+                          uint32_t since, uint32_t until, fwd_rollup_t *out)
+{
+    if (since == 0 && until == 0) {
+        *out = h->series[si].total;
+        return;
+    }
+    uint64_t lo = (uint64_t)h->first_at / FWD_DAY * FWD_DAY;
+    uint64_t c = since > lo ? since : lo;
+    uint64_t u = (until == 0 || until > h->last_at) ? h->last_at : until;
+    uint64_t cut[2] = { level_cutoff(h, 0), level_cutoff(h, 1) };
+
+    /* Walk bucket starts in the window, taking the coarsest aligned bucket
+     * that fits and snapping to the finest level still retained at c. */
+    while (c <= u) {
+        uint32_t level = (c >= cut[0]) ? 0 : (c >= cut[1]) ? 1 : 2;
+        uint64_t sz = level_secs[level];
+        c = (c + sz - 1) / sz * sz;
+        if (c > u) break;
+        while (level + 1 < FWD_LEVELS) {
+            uint64_t up = level_secs[level + 1];
+            if (c % up != 0 || c + up - 1 > u) break;
+            level++;
+        }
+        long b = find_bucket(h, si, level, (uint32_t)c);
+        if (b >= 0) rollup_acc(out, &h->buckets[b].r);
+        c += level_secs[level];
+    }
+}
+
+/* ---- Public API ---- */
+
 void fwd_history_init(fwd_history_t *h)
 {
     if (!h) return;
     memset(h, 0, sizeof(*h));
 }
 
+void fwd_history_free(fwd_history_t *h)
+{
+    if (!h) return;
+    free(h->series);
+    free(h->series_idx);
+    free(h->buckets);
+    free(h->free_buckets);
+    free(h->bucket_idx);
+    free(h->expiry[0]);
+    free(h->expiry[1]);
+    memset(h, 0, sizeof(*h));
+}
+
 void fwd_history_add(fwd_history_t *h,
                      uint64_t scid_in, uint64_t scid_out,
                      uint64_t in_amount_msat, uint64_t out_amount_msat,
@@ -40,76 +368,79 @@ void fwd_history_add(fwd_history_t *h,
     h->head = (h->head + 1) % FWD_HISTORY_MAX;
     if (h->count < FWD_HISTORY_MAX) h->count++;
 
-    if (status == FWD_STATUS_SETTLED) h->total_settled++;
-    else if (status == FWD_STATUS_FAILED) h->total_failed++;
+    fwd_rollup_t d;
+    memset(&d, 0, sizeof(d));
+    if (status == FWD_STATUS_SETTLED) {
+        h->total_settled++;
+        d.fee_msat  = e->fee_msat;
+        d.in_msat   = in_amount_msat;
+        d.out_msat  = out_amount_msat;
+        d.n_settled = 1;
+    } else if (status == FWD_STATUS_FAILED) {
+        h->total_failed++;
+        d.n_failed = 1;
+    } else {
+        return;   /* local payments are not forwards */
+    }
+    rollup_add(h, scid_in, scid_out, &d, resolved_at);
 }
 
-static int in_range(uint32_t t, uint32_t since, uint32_t until) {
-    if (since > 0 && t < since) return 0;
-    if (until > 0 && t > until) return 0;
+int fwd_history_stats(const fwd_history_t *h,
+                      uint64_t scid_in, uint64_t scid_out,
+                      uint32_t since, uint32_t until,
+                      fwd_rollup_t *out)
+{
+    if (!out) return 0;
+    memset(out, 0, sizeof(*out));
+    if (!h) return 0;
+    long si = find_series(h, scid_in, scid_out);
+    if (si < 0) return 0;
+    series_window(h, (uint32_t)si, since, until, out);
     return 1;
 }
 
+uint32_t fwd_history_failure_rate_ppm(const fwd_history_t *h,
+                                      uint64_t scid_out,
+                                      uint32_t since, uint32_t until)
+{
+    fwd_rollup_t r;
+    if (!fwd_history_stats(h, 0, scid_out, since, until, &r)) return 0;
+    uint64_t n = r.n_settled + r.n_failed;
+    return n ? (uint32_t)(r.n_failed * 1000000 / n) : 0;
+}
+
 uint64_t fwd_history_fee_total(const fwd_history_t *h,
                                 uint32_t since, uint32_t until)
 {
-    if (!h) return 0;
-    uint64_t total = 0;
-    for (int i = 0; i < h->count; i++) {
-        const fwd_history_entry_t *e = &h->entries[i];
-        if (e->status != FWD_STATUS_SETTLED) continue;
-        if (!in_range(e->resolved_at, since, until)) continue;
-        total += e->fee_msat;
-    }
-    return total;
+    fwd_rollup_t r;
+    fwd_history_stats(h, 0, 0, since, until, &r);
+    return r.fee_msat;
 }
 
 uint64_t fwd_history_volume(const fwd_history_t *h,
                               uint64_t scid_out,
                               uint32_t since, uint32_t until)
 {
-    if (!h) return 0;
-    uint64_t total = 0;
-    for (int i = 0; i < h->count; i++) {
-        const fwd_history_entry_t *e = &h->entries[i];
-        if (e->status != FWD_STATUS_SETTLED) continue;
-        if (scid_out != 0 && e->scid_out != scid_out) continue;
-        if (!in_range(e->resolved_at, since, until)) continue;
-        total += e->out_amount_msat;
-    }
-    return total;
+    fwd_rollup_t r;
+    fwd_history_stats(h, 0, scid_out, since, until, &r);
+    return r.out_msat;
 }
 
 int fwd_history_count(const fwd_history_t *h,
                        uint64_t scid_in,
                        uint32_t since, uint32_t until)
 {
-    if (!h) return 0;
-    int cnt = 0;
-    for (int i = 0; i < h->count; i++) {
-        const fwd_history_entry_t *e = &h->entries[i];
-        if (e->status != FWD_STATUS_SETTLED) continue;
-        if (scid_in != 0 && e->scid_in != scid_in) continue;
-        if (!in_range(e->resolved_at, since, until)) continue;
-        cnt++;
-    }
-    return cnt;
+    fwd_rollup_t r;
+    fwd_history_stats(h, scid_in, 0, since, until, &r);
+    return (int)r.n_settled;
 }
 
 uint64_t fwd_history_avg_fee(const fwd_history_t *h,
                               uint32_t since, uint32_t until)
 {
-    if (!h) return 0;
-    uint64_t total_fee = 0;
-    int cnt = 0;
-    for (int i = 0; i < h->count; i++) {
-        const fwd_history_entry_t *e = &h->entries[i];
-        if (e->status != FWD_STATUS_SETTLED) continue;
-        if (!in_range(e->resolved_at, since, until)) continue;
-        total_fee += e->fee_msat;
-        cnt++;
-    }
-    return (cnt > 0) ? (total_fee / cnt) : 0;
+    fwd_rollup_t r;
+    fwd_history_stats(h, 0, 0, since, until, &r);
+    return (r.n_settled > 0) ? (r.fee_msat / r.n_settled) : 0;
 }
 
 uint64_t fwd_history_top_channel(const fwd_history_t *h,
@@ -121,38 +452,19 @@ uint64_t fwd_history_top_channel(const fwd_history_t *h,
     *scid_in_out = 0;
     *scid_out_out = 0;
 
-    /* Find all unique (scid_in, scid_out) pairs and their total fees */
-    struct { uint64_t in, out, fee; } pairs[64];
-    int n_pairs = 0;
-
-    for (int i = 0; i < h->count; i++) {
-        const fwd_history_entry_t *e = &h->entries[i];
-        if (e->status != FWD_STATUS_SETTLED) continue;
-        if (!in_range(e->resolved_at, since, until)) continue;
-
-        /* Find existing pair */
-        int found = 0;
-        for (int j = 0; j < n_pairs; j++) {
-            if (pairs[j].in == e->scid_in && pairs[j].out == e->scid_out) {
-                pairs[j].fee += e->fee_msat;
-                found = 1;
-                break;
-            }
-        }
-        if (!found && n_pairs < 64) {
-            pairs[n_pairs].in  = e->scid_in;
-            pairs[n_pairs].out = e->scid_out;
-            pairs[n_pairs].fee = e->fee_msat;
-            n_pairs++;
-        }
-    }
-
+    /* Rank the pair series; side and node-wide series have a zero scid */
     uint64_t best = 0;
-    for (int i = 0; i < n_pairs; i++) {
-        if (pairs[i].fee > best) {
-            best = pairs[i].fee;
-            *scid_in_out  = pairs[i].in;
-            *scid_out_out = pairs[i].out;
+    for (uint32_t i = 0; i < h->n_series; i++) {
+        const fwd_series_t *se = &h->series[i];
+        if (se->scid_in == 0 || se->scid_out == 0) continue;
+        if (se->total.fee_msat <= best) continue;
+        fwd_rollup_t r;
+        memset(&r, 0, sizeof(r));
+        series_window(h, i, since, until, &r);
+        if (r.fee_msat > best) {
+            best = r.fee_msat;
+            *scid_in_out  = se->scid_in;
+            *scid_out_out = se->scid_out;
         }
     }
     return best;
@@ -179,3 +491,34 @@ int fwd_history_prune(fwd_history_t *h, uint32_t cutoff_unix)
     }
     return removed;
 }
+
+uint32_t fwd_history_level_cutoff(const fwd_history_t *h, uint32_t level)
+{
+    if (!h || level >= 2) return 0;
+    return (uint32_t)level_cutoff(h, (int)level);
+}
+
+int fwd_history_restore_bucket(fwd_history_t *h,
+                               uint64_t scid_in, uint64_t scid_out,
+                               uint32_t level, uint32_t start,
+                               const fwd_rollup_t *r)
+{
+    if (!h || !r || level >= FWD_LEVELS) return 0;
+    if (start % level_secs[level] != 0) return 0;
+
+    if (h->n_series == 0 || start < h->first_at) h->first_at = start;
+    if (start > h->last_at) {
+        h->last_at = start;
+        expire_buckets(h);
+    }
+    if (level < 2 && start < level_cutoff(h, (int)level)) return 1;
+
+    long si = get_series(h, scid_in, scid_out);
+    if (si < 0) return 0;
+    fwd_bucket_t *b = get_bucket(h, (uint32_t)si, level, start);
+    if (!b) return 0;
+    b->r = *r;
+    b->dirty = 0;
+    if (level == 2) rollup_acc(&h->series[si].total, r);
+    return 1;
+}
@@ -12,6 +12,8 @@
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
 
 /* -----------------------------------------------------------------------
  * Wire helpers
@@ -104,6 +106,194 @@ static int rate_check(gossip_ingest_t *gi, const unsigned char *key, int klen,
     return 1; /* admitted */
 }
 
+/* channel_update fields (layout: see channel_update below) */
+typedef struct {
+    uint64_t scid;
+    uint32_t timestamp;
+    int      direction;
+    int      disabled;
+    uint16_t cltv;
+    uint64_t htlc_min;
+    uint32_t fee_base;
+    uint32_t fee_ppm;
+    uint64_t htlc_max;          /* 0 = not advertised */
+} chan_update_t;
+
+static int parse_chan_update(const unsigned char *msg, size_t msg_len,
+                             chan_update_t *u)
+{
+    if (msg_len < 130) return 0;
+
+    uint8_t msg_flags  = msg[110];
+    uint8_t chan_flags = msg[111];
+    u->scid      = rd64(msg + 98);
+    u->timestamp = rd32(msg + 106);
+    u->direction = (int)(chan_flags & 0x01);
+    u->disabled  = (chan_flags & 0x02) ? 1 : 0;
+    u->cltv      = (uint16_t)(((uint16_t)msg[112] << 8) | msg[113]);
+    u->htlc_min  = rd64(msg + 114);
+    u->fee_base  = rd32(msg + 122);
+    u->fee_ppm   = rd32(msg + 126);
+    u->htlc_max  = ((msg_flags & 0x01) && msg_len >= 138) ? rd64(msg + 130) : 0;
+    return 1;
+}
+
+/* -----------------------------------------------------------------------
+ * Seen-gossip cache
+ *
+ * Two generations of an open-addressing map on 64-bit keys (0 = empty).
+ * Inserts go to the current generation, growing it up to half of
+ * GOSSIP_INGEST_SEEN_MAX; then the previous generation is dropped and the
+ * current one takes its place.  Lookups consult both, so anything seen
+ * within the last one to two generations' worth of traffic is found.
+ * The cache is an optimisation only: on OOM it simply stops remembering.
+ * --------------------------------------------------------------------- */
+
+#define SEEN_INIT_SLOTS  1024u
+
+static size_t seen_slot(uint64_t key, size_t mask)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key & mask;
+}
+
+static int seen_gen_get(const gossip_ingest_seen_gen_t *g, uint64_t key,
+                        uint32_t *val_out)
+{
+    if (!g->n_slots) return 0;
+    size_t mask = g->n_slots - 1;
+    for (size_t i = seen_slot(key, mask); g->keys[i]; i = (i + 1) & mask) {
+        if (g->keys[i] == key) {
+            *val_out = g->vals[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void seen_gen_set(gossip_ingest_seen_gen_t *g, uint64_t key, uint32_t val)
+{
+    size_t mask = g->n_slots - 1;
+    size_t i = seen_slot(key, mask);
+    while (g->keys[i] && g->keys[i] != key)
+        i = (i + 1) & mask;
+    if (!g->keys[i]) g->count++;
+    g->keys[i] = key;
+    g->vals[i] = val;
+}
+
+static int seen_gen_grow(gossip_ingest_seen_gen_t *g)
+{
+    size_t n = g->n_slots ? g->n_slots * 2 : SEEN_INIT_SLOTS;
+    uint64_t *keys = (uint64_t *)calloc(n, sizeof(uint64_t));
+    uint32_t *vals = (uint32_t *)malloc(n * sizeof(uint32_t));
+    if (!keys || !vals) {
+        free(keys);
+        free(vals);
+        return 0;
+    }
+    gossip_ingest_seen_gen_t old = *g;
+    g->keys = keys;
+    g->vals = vals;
+    g->n_slots = n;
+    g->count = 0;
+    for (size_t i = 0; i < old.n_slots; i++)
+        if (old.keys[i]) seen_gen_set(g, old.keys[i], old.vals[i]);
+    free(old.keys);
+    free(old.vals);
+    return 1;
+}
+
+static void seen_gen_free(gossip_ingest_seen_gen_t *g)
+{
+    free(g->keys);
+    free(g->vals);
+    memset(g, 0, sizeof(*g));
+}
+
+static int seen_get(const gossip_ingest_seen_t *s, uint64_t key, uint32_t *val_out)
+{
+    return seen_gen_get(&s->gen[0], key, val_out) ||
+           seen_gen_get(&s->gen[1], key, val_out);
+}
+
+static void seen_put(gossip_ingest_seen_t *s, uint64_t key, uint32_t val)
+{
+    gossip_ingest_seen_gen_t *cur = &s->gen[0];
+    uint32_t dummy;
+    if (!seen_gen_get(cur, key, &dummy)) {
+        if (cur->count >= GOSSIP_INGEST_SEEN_MAX / 2) {
+            seen_gen_free(&s->gen[1]);
+            s->gen[1] = *cur;
+            memset(cur, 0, sizeof(*cur));
+        }
+        /* Keep the load factor at or below 1/2. */
+        if ((cur->count + 1) * 2 > cur->n_slots && !seen_gen_grow(cur))
+            return;
+    }
+    seen_gen_set(cur, key, val);
+}
+
+/* Message key: leading 8 bytes of SHA256(msg); 0 is reserved for empty. */
+static uint64_t seen_msg_key(const unsigned char *msg, size_t msg_len)
+{
+    unsigned char h[32];
+    sha256(msg, msg_len, h);
+    uint64_t key = rd64(h);
+    return key ? key : 1;
+}
+
+static uint64_t seen_upd_key(const chan_update_t *u)
+{
+    return ((u->scid << 1) | (uint64_t)u->direction) + 1;
+}
+
+/*
+ * Short-circuit already-seen gossip: an identical message gets its earlier
+ * verdict (a forgery stays BAD_SIG, anything accepted is DUPLICATE), and a
+ * channel_update no newer than the last one accepted for its scid+direction
+ * is DUPLICATE.  Returns that verdict, or -1 to process the message (with
+ * *key_out set for seen_note()).
+ */
+static int seen_lookup(gossip_ingest_t *gi, const unsigned char *msg,
+                       size_t msg_len, const chan_update_t *u,
+                       uint64_t *key_out)
+{
+    uint32_t v;
+    *key_out = seen_msg_key(msg, msg_len);
+    if (seen_get(&gi->seen_msg, *key_out, &v)) {
+        gi->n_seen_hit++;
+        if (v == GOSSIP_INGEST_BAD_SIG) {
+            gi->n_rejected_sig++;
+            return GOSSIP_INGEST_BAD_SIG;
+        }
+        gi->n_rejected_dup++;
+        return GOSSIP_INGEST_DUPLICATE;
+    }
+    if (u && seen_get(&gi->seen_upd, seen_upd_key(u), &v) && u->timestamp <= v) {
+        gi->n_seen_hit++;
+        gi->n_rejected_dup++;
+        return GOSSIP_INGEST_DUPLICATE;
+    }
+    gi->n_seen_miss++;
+    return -1;
+}
+
+/* Remember a final verdict.  Rate limits and orphans are transient and
+ * are not cached. */
+static void seen_note(gossip_ingest_t *gi, uint64_t key, int verdict,
+                      const chan_update_t *u)
+{
+    if (verdict != GOSSIP_INGEST_OK && verdict != GOSSIP_INGEST_NO_VERIFY &&
+        verdict != GOSSIP_INGEST_BAD_SIG)
+        return;
+    seen_put(&gi->seen_msg, key, (uint32_t)verdict);
+    if (u && verdict != GOSSIP_INGEST_BAD_SIG)
+        seen_put(&gi->seen_upd, seen_upd_key(u), u->timestamp);
+}
+
 /* -----------------------------------------------------------------------
  * Public API
  * --------------------------------------------------------------------- */
@@ -118,6 +308,26 @@ void gossip_ingest_init(gossip_ingest_t *gi,
     gi->gs  = gs;
 }
 
+/* Endpoints of a known channel, from the gossip log if attached, else
+ * gossip_store.  node1/node2 may be NULL. */
+static int lookup_channel(gossip_ingest_t *gi, uint64_t scid,
+                          unsigned char *node1, unsigned char *node2)
+{
+    if (gi->log && gossip_log_get_channel(gi->log, scid, node1, node2, NULL))
+        return 1;
+    return gi->gs && gossip_store_get_channel(gi->gs, scid, node1, node2,
+                                              NULL, NULL);
+}
+
+void gossip_ingest_free(gossip_ingest_t *gi)
+{
+    if (!gi) return;
+    for (int i = 0; i < 2; i++) {
+        seen_gen_free(&gi->seen_msg.gen[i]);
+        seen_gen_free(&gi->seen_upd.gen[i]);
+    }
+}
+
 /* -----------------------------------------------------------------------
  * channel_announcement (type 256)
  *
@@ -140,30 +350,56 @@ void gossip_ingest_init(gossip_ingest_t *gi,
  *
  * Min length without features: 2+4*64+2+0+32+8+4*33 = 2+256+2+32+8+132 = 432
  * --------------------------------------------------------------------- */
-int gossip_ingest_channel_announcement(gossip_ingest_t     *gi,
-                                        const unsigned char *msg,
-                                        size_t               msg_len,
-                                        uint32_t             now_unix)
+static int parse_channel_ann(const unsigned char *msg, size_t msg_len,
+                             size_t *base_out)
 {
-    if (!gi) return GOSSIP_INGEST_MALFORMED;
-
     /* minimum: type(2) + 4*sig(64) + flen(2) + chain(32) + scid(8) + 4*key(33) */
-    if (msg_len < 432) {
-        gi->n_rejected_malformed++;
-        return GOSSIP_INGEST_MALFORMED;
-    }
+    if (msg_len < 432) return 0;
 
     /* flen at offset 258 */
     uint16_t flen = rd16(msg + 258);
     size_t min_needed = 432 + flen;
-    if (msg_len < min_needed) {
-        gi->n_rejected_malformed++;
-        return GOSSIP_INGEST_MALFORMED;
-    }
+    if (msg_len < min_needed) return 0;
 
     size_t base = (size_t)(260 + flen);   /* offset of chain_hash */
     /* chain_hash + scid + node_id_1 + node_id_2 + bitcoin_key_1 + bitcoin_key_2 */
-    if (msg_len < base + 32 + 8 + 33 + 33 + 33 + 33) {
+    if (msg_len < base + 32 + 8 + 33 + 33 + 33 + 33) return 0;
+
+    *base_out = base;
+    return 1;
+}
+
+static void store_channel_ann(gossip_ingest_t *gi, const unsigned char *msg,
+                              size_t msg_len, uint64_t scid,
+                              const unsigned char *node_id_1,
+                              const unsigned char *node_id_2,
+                              uint32_t now_unix)
+{
+    if (gi->log)
+        gossip_log_append(gi->log, msg, msg_len, now_unix);
+    if (gi->gs) {
+        gossip_store_upsert_channel(gi->gs, scid, node_id_1, node_id_2,
+                                    0, now_unix);
+    }
+    if (gi->graph)
+        pathfind_graph_add_channel(gi->graph, scid, node_id_1, node_id_2, 0);
+    if (gi->rgs)
+        rgs_server_add_channel(gi->rgs, scid, node_id_1, node_id_2, 0, now_unix);
+    if (gi->qidx)
+        gossip_query_index_add(gi->qidx, scid);
+
+    gi->n_channel_ann++;
+}
+
+int gossip_ingest_channel_announcement(gossip_ingest_t     *gi,
+                                        const unsigned char *msg,
+                                        size_t               msg_len,
+                                        uint32_t             now_unix)
+{
+    if (!gi) return GOSSIP_INGEST_MALFORMED;
+
+    size_t base;
+    if (!parse_channel_ann(msg, msg_len, &base)) {
         gi->n_rejected_malformed++;
         return GOSSIP_INGEST_MALFORMED;
     }
@@ -172,10 +408,12 @@ int gossip_ingest_channel_announcement(gossip_ingest_t     *gi,
     const unsigned char *node_id_1    = msg + base + 40;
     const unsigned char *node_id_2    = msg + base + 73;
 
+    uint64_t seen_key;
+    int seen = seen_lookup(gi, msg, msg_len, NULL, &seen_key);
+    if (seen >= 0) return seen;
+
     /* Rate limit on scid */
-    unsigned char rate_key[8];
-    memcpy(rate_key, msg + base + 32, 8);
-    if (!rate_check(gi, rate_key, 8, now_unix)) {
+    if (!rate_check(gi, msg + base + 32, 8, now_unix)) {
         gi->n_rejected_rate++;
         return GOSSIP_INGEST_RATE_LIMITED;
     }
@@ -184,18 +422,15 @@ int gossip_ingest_channel_announcement(gossip_ingest_t     *gi,
     if (gi->ctx) {
         if (!gossip_validate_channel_announcement(gi->ctx, msg, msg_len)) {
             gi->n_rejected_sig++;
+            seen_note(gi, seen_key, GOSSIP_INGEST_BAD_SIG, NULL);
             return GOSSIP_INGEST_BAD_SIG;
         }
     }
 
-    /* Store */
-    if (gi->gs) {
-        gossip_store_upsert_channel(gi->gs, scid, node_id_1, node_id_2,
-                                    0, now_unix);
-    }
-
-    gi->n_channel_ann++;
-    return gi->ctx ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+    store_channel_ann(gi, msg, msg_len, scid, node_id_1, node_id_2, now_unix);
+    int res = gi->ctx ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+    seen_note(gi, seen_key, res, NULL);
+    return res;
 }
 
 /* -----------------------------------------------------------------------
@@ -208,35 +443,63 @@ int gossip_ingest_channel_announcement(gossip_ingest_t     *gi,
  * node_id at msg[2+64+2+flen+4] = msg[72+flen]
  * Min length (no features, no addrs): 2+64+2+0+4+33+3+32+2 = 142
  * --------------------------------------------------------------------- */
-int gossip_ingest_node_announcement(gossip_ingest_t     *gi,
-                                     const unsigned char *msg,
-                                     size_t               msg_len,
-                                     uint32_t             now_unix)
+static int parse_node_ann(const unsigned char *msg, size_t msg_len,
+                          size_t *nid_off_out)
 {
-    if (!gi) return GOSSIP_INGEST_MALFORMED;
-
     /* Minimum: type(2)+sig(64)+flen(2)+features(0)+timestamp(4)+node_id(33)
      *          +rgb(3)+alias(32)+addrlen(2) = 142 */
-    if (msg_len < 142) {
-        gi->n_rejected_malformed++;
-        return GOSSIP_INGEST_MALFORMED;
-    }
+    if (msg_len < 142) return 0;
 
     uint16_t flen = rd16(msg + 66);  /* flen at offset 2+64 = 66 */
-    if (msg_len < (size_t)(142 + flen)) {
-        gi->n_rejected_malformed++;
-        return GOSSIP_INGEST_MALFORMED;
-    }
+    if (msg_len < (size_t)(142 + flen)) return 0;
 
     /* node_id at offset 2+64+2+flen+4 = 72+flen */
     size_t nid_off = (size_t)(72 + flen);
-    if (msg_len < nid_off + 33) {
+    if (msg_len < nid_off + 33) return 0;
+
+    *nid_off_out = nid_off;
+    return 1;
+}
+
+static void store_node_ann(gossip_ingest_t *gi, const unsigned char *msg,
+                           size_t msg_len, size_t nid_off, uint32_t now_unix)
+{
+    /* Extract alias (32 bytes at nid_off+33+3) */
+    char alias[33] = {0};
+    if (msg_len >= nid_off + 33 + 3 + 32) {
+        memcpy(alias, msg + nid_off + 33 + 3, 32);
+        alias[32] = '\0';
+    }
+
+    /* Store */
+    if (gi->log)
+        gossip_log_append(gi->log, msg, msg_len, now_unix);
+    if (gi->gs) {
+        gossip_store_upsert_node(gi->gs, msg + nid_off, alias, "", now_unix);
+    }
+
+    gi->n_node_ann++;
+}
+
+int gossip_ingest_node_announcement(gossip_ingest_t     *gi,
+                                     const unsigned char *msg,
+                                     size_t               msg_len,
+                                     uint32_t             now_unix)
+{
+    if (!gi) return GOSSIP_INGEST_MALFORMED;
+
+    size_t nid_off;
+    if (!parse_node_ann(msg, msg_len, &nid_off)) {
         gi->n_rejected_malformed++;
         return GOSSIP_INGEST_MALFORMED;
     }
 
     const unsigned char *node_id = msg + nid_off;
 
+    uint64_t seen_key;
+    int seen = seen_lookup(gi, msg, msg_len, NULL, &seen_key);
+    if (seen >= 0) return seen;
+
     /* Rate limit on node_id */
     if (!rate_check(gi, node_id, 33, now_unix)) {
         gi->n_rejected_rate++;
@@ -247,24 +510,15 @@ int gossip_ingest_node_announcement(gossip_ingest_t     *gi,
     if (gi->ctx) {
         if (!gossip_verify_node_announcement(gi->ctx, msg, msg_len)) {
             gi->n_rejected_sig++;
+            seen_note(gi, seen_key, GOSSIP_INGEST_BAD_SIG, NULL);
             return GOSSIP_INGEST_BAD_SIG;
         }
     }
 
-    /* Extract alias (32 bytes at nid_off+33+3) */
-    char alias[33] = {0};
-    if (msg_len >= nid_off + 33 + 3 + 32) {
-        memcpy(alias, msg + nid_off + 33 + 3, 32);
-        alias[32] = '\0';
-    }
-
-    /* Store */
-    if (gi->gs) {
-        gossip_store_upsert_node(gi->gs, node_id, alias, "", now_unix);
-    }
-
-    gi->n_node_ann++;
-    return gi->ctx ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+    store_node_ann(gi, msg, msg_len, nid_off, now_unix);
+    int res = gi->ctx ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+    seen_note(gi, seen_key, res, NULL);
+    return res;
 }
 
 /* -----------------------------------------------------------------------
@@ -291,6 +545,53 @@ int gossip_ingest_node_announcement(gossip_ingest_t     *gi,
  *
  * Min length (without htlc_max): 2+64+32+8+4+1+1+2+8+4+4 = 130
  * --------------------------------------------------------------------- */
+/* node1/node2 are the channel's endpoints when known (have_signer). */
+static void store_chan_update(gossip_ingest_t *gi, const unsigned char *msg,
+                              size_t msg_len, const chan_update_t *u,
+                              const unsigned char *node1,
+                              const unsigned char *node2,
+                              int have_signer, uint32_t now_unix)
+{
+    if (gi->log)
+        gossip_log_append(gi->log, msg, msg_len, now_unix);
+    if (gi->gs) {
+        gossip_store_upsert_channel_update(gi->gs, u->scid, u->direction,
+                                           u->fee_base, u->fee_ppm,
+                                           u->cltv, now_unix);
+    }
+    if (gi->graph) {
+        /* Channel may predate the graph (loaded store, or graph attached
+         * late): seed it from the store's endpoints first. */
+        if (have_signer && !pathfind_graph_get_channel(gi->graph, u->scid, NULL, NULL, NULL))
+            pathfind_graph_add_channel(gi->graph, u->scid, node1, node2, 0);
+        pathfind_graph_update_channel(gi->graph, u->scid, u->direction,
+                                      u->fee_base, u->fee_ppm, u->cltv,
+                                      u->htlc_min, u->htlc_max, u->disabled);
+    }
+    if (gi->rgs) {
+        rgs_channel_update_t ru;
+        memset(&ru, 0, sizeof(ru));
+        ru.direction = u->direction;
+        ru.cltv_expiry_delta = u->cltv;
+        ru.htlc_minimum_msat = u->htlc_min;
+        ru.htlc_maximum_msat = u->htlc_max;
+        ru.fee_base_msat = u->fee_base;
+        ru.fee_proportional_millionths = u->fee_ppm;
+        ru.flags = u->disabled ? 1 : 0;
+        ru.timestamp = u->timestamp;
+        if (have_signer)
+            rgs_server_add_channel(gi->rgs, u->scid, node1, node2, 0, now_unix);
+        rgs_server_apply_update(gi->rgs, u->scid, &ru, now_unix);
+    }
+    if (gi->qidx) {
+        if (have_signer)
+            gossip_query_index_add(gi->qidx, u->scid);
+        gossip_query_index_update(gi->qidx, msg, msg_len);
+    }
+
+    gi->n_chan_update++;
+}
+
 int gossip_ingest_channel_update(gossip_ingest_t     *gi,
                                   const unsigned char *msg,
                                   size_t               msg_len,
@@ -298,22 +599,20 @@ int gossip_ingest_channel_update(gossip_ingest_t     *gi,
 {
     if (!gi) return GOSSIP_INGEST_MALFORMED;
 
-    if (msg_len < 130) {
+    chan_update_t u;
+    if (!parse_chan_update(msg, msg_len, &u)) {
         gi->n_rejected_malformed++;
         return GOSSIP_INGEST_MALFORMED;
     }
 
-    uint64_t scid        = rd64(msg + 98);
-    uint8_t  chan_flags  = msg[111];
-    int      direction   = (int)(chan_flags & 0x01);
-    uint16_t cltv        = (uint16_t)(((uint16_t)msg[112] << 8) | msg[113]);
-    uint32_t fee_base    = rd32(msg + 122);
-    uint32_t fee_ppm     = rd32(msg + 126);
+    uint64_t seen_key;
+    int seen = seen_lookup(gi, msg, msg_len, &u, &seen_key);
+    if (seen >= 0) return seen;
 
     /* Rate limit: key = scid(8) + direction(1) */
     unsigned char rate_key[9];
     memcpy(rate_key, msg + 98, 8);
-    rate_key[8] = (unsigned char)direction;
+    rate_key[8] = (unsigned char)u.direction;
     if (!rate_check(gi, rate_key, 9, now_unix)) {
         gi->n_rejected_rate++;
         return GOSSIP_INGEST_RATE_LIMITED;
@@ -321,15 +620,9 @@ int gossip_ingest_channel_update(gossip_ingest_t     *gi,
 
     /* Look up channel to get signer pubkey */
     unsigned char node1[33] = {0}, node2[33] = {0};
-    int have_signer = 0;
-    if (gi->gs) {
-        uint64_t cap; uint32_t lu;
-        if (gossip_store_get_channel(gi->gs, scid, node1, node2, &cap, &lu)) {
-            have_signer = 1;
-        }
-    }
+    int have_signer = lookup_channel(gi, u.scid, node1, node2);
 
-    if (!have_signer && gi->gs) {
+    if (!have_signer && (gi->gs || gi->log)) {
         /* Channel unknown — orphan update */
         gi->n_rejected_orphan++;
         return GOSSIP_INGEST_ORPHAN;
@@ -337,23 +630,39 @@ int gossip_ingest_channel_update(gossip_ingest_t     *gi,
 
     /* Signature verification */
     if (gi->ctx && have_signer) {
-        const unsigned char *signer = (direction == 0) ? node1 : node2;
+        const unsigned char *signer = (u.direction == 0) ? node1 : node2;
         const unsigned char *sig64  = msg + 2;
         if (!verify_schnorr(gi->ctx, sig64, signer, msg, msg_len)) {
             gi->n_rejected_sig++;
+            seen_note(gi, seen_key, GOSSIP_INGEST_BAD_SIG, &u);
             return GOSSIP_INGEST_BAD_SIG;
         }
     }
 
-    /* Store */
-    if (gi->gs) {
-        gossip_store_upsert_channel_update(gi->gs, scid, direction,
-                                           fee_base, fee_ppm,
-                                           cltv, now_unix);
-    }
+    store_chan_update(gi, msg, msg_len, &u, node1, node2, have_signer, now_unix);
+    int res = (gi->ctx && have_signer) ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+    seen_note(gi, seen_key, res, &u);
+    return res;
+}
 
-    gi->n_chan_update++;
-    return (gi->ctx && have_signer) ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+/* -----------------------------------------------------------------------
+ * Channel closure
+ * --------------------------------------------------------------------- */
+void gossip_ingest_channel_closed(gossip_ingest_t *gi,
+                                  uint64_t         scid,
+                                  uint32_t         now_unix)
+{
+    if (!gi) return;
+    if (gi->gs)
+        gossip_store_mark_channel_spent(gi->gs, scid, now_unix);
+    if (gi->log)
+        gossip_log_mark_spent(gi->log, scid);
+    if (gi->rgs)
+        rgs_server_remove_channel(gi->rgs, scid);
+    if (gi->qidx)
+        gossip_query_index_remove(gi->qidx, scid);
+    if (gi->graph)
+        pathfind_graph_remove_channel(gi->graph, scid);
 }
 
 /* -----------------------------------------------------------------------
@@ -378,6 +687,404 @@ int gossip_ingest_timestamp_filter(gossip_ingest_t     *gi,
     return GOSSIP_INGEST_OK;
 }
 
+/* -----------------------------------------------------------------------
+ * Batch ingest
+ *
+ * Initial sync delivers gossip in bulk and much of it is redundant:
+ * several channel_updates per direction, re-announcements of channels we
+ * already have.  Everything is parsed and deduplicated first, so signature
+ * checks are only spent on messages that could be stored; those checks are
+ * independent and run on a worker pool.  Survivors are then written in a
+ * single store transaction.
+ * --------------------------------------------------------------------- */
+
+#define BATCH_PENDING          (-1)
+#define BATCH_JOBS_PER_WORKER  32   /* don't wake a thread for less */
+
+typedef struct {
+    const unsigned char *msg;
+    size_t        len;
+    uint16_t      type;
+    int           result;       /* GOSSIP_INGEST_* or BATCH_PENDING */
+    uint32_t      timestamp;    /* dedupe order; 0 for channel_announcement */
+    uint64_t      seen_key;
+    size_t        off;          /* channel_ann: chain_hash; node_ann: node_id */
+    chan_update_t upd;
+    int           have_signer;  /* channel_update: endpoints known */
+    int           ann_ref;      /* channel_update: same-batch announcement */
+    unsigned char node1[33];
+    unsigned char node2[33];
+    int           sig_ok;
+} batch_rec_t;
+
+typedef struct {
+    batch_rec_t *recs;
+    int32_t     *slots;         /* open addressing, -1 = empty */
+    size_t       n_slots;       /* power of two */
+    int         *jobs;          /* records awaiting a signature check */
+} batch_t;
+
+/* Dedupe key: kind(1) || scid(8) [|| direction(1)], or kind(1) || node_id(33). */
+static int batch_key(const batch_rec_t *r, unsigned char key[34])
+{
+    switch (r->type) {
+    case 256:
+        key[0] = 0;
+        memcpy(key + 1, r->msg + r->off + 32, 8);
+        return 9;
+    case 257:
+        key[0] = 1;
+        memcpy(key + 1, r->msg + r->off, 33);
+        return 34;
+    case 258:
+        key[0] = 2;
+        memcpy(key + 1, r->msg + 98, 8);
+        key[9] = (unsigned char)r->upd.direction;
+        return 10;
+    default:
+        return 0;
+    }
+}
+
+static size_t key_hash(const unsigned char *key, int len, size_t mask)
+{
+    uint64_t h = 1469598103934665603ULL;     /* FNV-1a */
+    for (int i = 0; i < len; i++) {
+        h ^= key[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)(h ^ (h >> 32)) & mask;
+}
+
+/* Slot holding key, or the empty slot where it would go. */
+static size_t batch_slot(const batch_t *b, const unsigned char *key, int len)
+{
+    size_t mask = b->n_slots - 1;
+    size_t i = key_hash(key, len, mask);
+    unsigned char other[34];
+    while (b->slots[i] >= 0) {
+        if (batch_key(&b->recs[b->slots[i]], other) == len &&
+            memcmp(other, key, (size_t)len) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+typedef struct {
+    secp256k1_context *ctx;
+    batch_rec_t       *recs;
+    const int         *jobs;
+    int                n_jobs;
+    int                next;
+    pthread_mutex_t    lock;
+} verify_pool_t;
+
+static int batch_verify_one(secp256k1_context *ctx, const batch_rec_t *r)
+{
+    switch (r->type) {
+    case 256:
+        return gossip_validate_channel_announcement(ctx, r->msg, r->len);
+    case 257:
+        return gossip_verify_node_announcement(ctx, r->msg, r->len);
+    default:
+        return verify_schnorr(ctx, r->msg + 2,
+                              r->upd.direction == 0 ? r->node1 : r->node2,
+                              r->msg, r->len);
+    }
+}
+
+/* Verification only reads ctx, so one context serves every worker. */
+static void *verify_worker(void *arg)
+{
+    verify_pool_t *p = (verify_pool_t *)arg;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        int i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+        if (i >= p->n_jobs) break;
+        batch_rec_t *r = &p->recs[p->jobs[i]];
+        r->sig_ok = batch_verify_one(p->ctx, r);
+    }
+    return NULL;
+}
+
+/* Check every job; the calling thread takes a share too. */
+static void verify_run(verify_pool_t *p)
+{
+    p->next = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int n_threads = (ncpu < 1 ? 1 : ncpu > GOSSIP_INGEST_MAX_WORKERS
+                     ? GOSSIP_INGEST_MAX_WORKERS : (int)ncpu);
+    int by_work = (p->n_jobs + BATCH_JOBS_PER_WORKER - 1) / BATCH_JOBS_PER_WORKER;
+    if (n_threads > by_work) n_threads = by_work;
+
+    pthread_t tids[GOSSIP_INGEST_MAX_WORKERS];
+    int started = 0;
+    for (int i = 1; i < n_threads; i++)
+        if (pthread_create(&tids[started], NULL, verify_worker, p) == 0)
+            started++;
+    verify_worker(p);
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+}
+
+static void batch_parse(gossip_ingest_t *gi, batch_rec_t *r)
+{
+    r->ann_ref = -1;
+    if (!r->msg || r->len < 2) {
+        gi->n_rejected_malformed++;
+        r->result = GOSSIP_INGEST_MALFORMED;
+        return;
+    }
+    r->type = rd16(r->msg);
+    r->result = BATCH_PENDING;
+    switch (r->type) {
+    case 256:
+        if (!parse_channel_ann(r->msg, r->len, &r->off))
+            r->result = GOSSIP_INGEST_MALFORMED;
+        break;
+    case 257:
+        if (!parse_node_ann(r->msg, r->len, &r->off))
+            r->result = GOSSIP_INGEST_MALFORMED;
+        else
+            r->timestamp = rd32(r->msg + r->off - 4);
+        break;
+    case 258:
+        if (!parse_chan_update(r->msg, r->len, &r->upd))
+            r->result = GOSSIP_INGEST_MALFORMED;
+        else
+            r->timestamp = r->upd.timestamp;
+        break;
+    case 265:
+        /* Nothing to store; the peer session interprets the filter. */
+        r->result = r->len >= 42 ? GOSSIP_INGEST_OK : GOSSIP_INGEST_MALFORMED;
+        return;
+    default:
+        r->result = GOSSIP_INGEST_UNKNOWN_TYPE;
+        return;
+    }
+    if (r->result == GOSSIP_INGEST_MALFORMED) {
+        gi->n_rejected_malformed++;
+        return;
+    }
+    int seen = seen_lookup(gi, r->msg, r->len, r->type == 258 ? &r->upd : NULL,
+                           &r->seen_key);
+    if (seen >= 0)
+        r->result = seen;
+}
+
+/* Keep the newest message per key (the first one on a tie). */
+static void batch_dedupe(gossip_ingest_t *gi, batch_t *b, size_t n)
+{
+    unsigned char key[34];
+    for (size_t i = 0; i < n; i++) {
+        batch_rec_t *r = &b->recs[i];
+        if (r->result != BATCH_PENDING) continue;
+        int klen = batch_key(r, key);
+        size_t s = batch_slot(b, key, klen);
+        if (b->slots[s] < 0) {
+            b->slots[s] = (int32_t)i;
+            continue;
+        }
+        batch_rec_t *prev = &b->recs[b->slots[s]];
+        if (r->timestamp > prev->timestamp) {
+            prev->result = GOSSIP_INGEST_DUPLICATE;
+            b->slots[s] = (int32_t)i;
+        } else {
+            r->result = GOSSIP_INGEST_DUPLICATE;
+        }
+        gi->n_rejected_dup++;
+    }
+}
+
+/* Known channels, rate limits and channel_update signers, in arrival
+ * order -- announcements first, so an update can be checked against an
+ * announcement later in the same batch. */
+static void batch_admit(gossip_ingest_t *gi, batch_t *b, size_t n,
+                        uint32_t now_unix)
+{
+    for (size_t i = 0; i < n; i++) {
+        batch_rec_t *r = &b->recs[i];
+        if (r->result != BATCH_PENDING || r->type == 258) continue;
+        const unsigned char *rate_key = r->msg + r->off;
+        int rate_len = 33;
+        if (r->type == 256) {
+            rate_key += 32;
+            rate_len = 8;
+            if (lookup_channel(gi, rd64(rate_key), NULL, NULL)) {
+                gi->n_rejected_dup++;
+                r->result = GOSSIP_INGEST_DUPLICATE;
+                continue;
+            }
+        }
+        if (!rate_check(gi, rate_key, rate_len, now_unix)) {
+            gi->n_rejected_rate++;
+            r->result = GOSSIP_INGEST_RATE_LIMITED;
+        }
+    }
+
+    unsigned char key[34];
+    for (size_t i = 0; i < n; i++) {
+        batch_rec_t *r = &b->recs[i];
+        if (r->result != BATCH_PENDING || r->type != 258) continue;
+        unsigned char rate_key[9];
+        memcpy(rate_key, r->msg + 98, 8);
+        rate_key[8] = (unsigned char)r->upd.direction;
+        if (!rate_check(gi, rate_key, 9, now_unix)) {
+            gi->n_rejected_rate++;
+            r->result = GOSSIP_INGEST_RATE_LIMITED;
+            continue;
+        }
+
+        key[0] = 0;
+        memcpy(key + 1, r->msg + 98, 8);
+        int32_t a = b->slots[batch_slot(b, key, 9)];
+        if (a >= 0 && b->recs[a].result == BATCH_PENDING) {
+            const batch_rec_t *ann = &b->recs[a];
+            memcpy(r->node1, ann->msg + ann->off + 40, 33);
+            memcpy(r->node2, ann->msg + ann->off + 73, 33);
+            r->ann_ref = a;
+            r->have_signer = 1;
+        } else if (gi->gs || gi->log) {
+            r->have_signer = lookup_channel(gi, r->upd.scid, r->node1, r->node2);
+            if (!r->have_signer) {
+                gi->n_rejected_orphan++;
+                r->result = GOSSIP_INGEST_ORPHAN;
+            }
+        }
+    }
+}
+
+static void batch_verify(gossip_ingest_t *gi, batch_t *b, size_t n)
+{
+    int *jobs = b->jobs;
+    int n_jobs = 0;
+    for (size_t i = 0; i < n; i++) {
+        const batch_rec_t *r = &b->recs[i];
+        if (r->result == BATCH_PENDING && (r->type != 258 || r->have_signer))
+            jobs[n_jobs++] = (int)i;
+    }
+
+    verify_pool_t pool;
+    pool.ctx    = gi->ctx;
+    pool.recs   = b->recs;
+    pool.jobs   = jobs;
+    pool.n_jobs = n_jobs;
+    pthread_mutex_init(&pool.lock, NULL);
+    verify_run(&pool);
+    pthread_mutex_destroy(&pool.lock);
+
+    for (int j = 0; j < n_jobs; j++) {
+        batch_rec_t *r = &b->recs[jobs[j]];
+        if (!r->sig_ok) {
+            gi->n_rejected_sig++;
+            r->result = GOSSIP_INGEST_BAD_SIG;
+            seen_note(gi, r->seen_key, r->result,
+                      r->type == 258 ? &r->upd : NULL);
+        }
+    }
+
+    /* An update vouched for only by a rejected announcement is an orphan. */
+    for (size_t i = 0; i < n; i++) {
+        batch_rec_t *r = &b->recs[i];
+        if (r->result == BATCH_PENDING && r->ann_ref >= 0 &&
+            b->recs[r->ann_ref].result != BATCH_PENDING) {
+            gi->n_rejected_orphan++;
+            r->result = GOSSIP_INGEST_ORPHAN;
+        }
+    }
+}
+
+static size_t batch_commit(gossip_ingest_t *gi, batch_t *b, size_t n,
+                           uint32_t now_unix)
+{
+    int verified = gi->ctx != NULL;
+    int txn = gi->gs ? gossip_store_begin(gi->gs) : 0;
+    size_t accepted = 0;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < n; i++) {
+            batch_rec_t *r = &b->recs[i];
+            if (r->result != BATCH_PENDING || (r->type == 258) != pass)
+                continue;
+            if (r->type == 256) {
+                store_channel_ann(gi, r->msg, r->len, rd64(r->msg + r->off + 32),
+                                  r->msg + r->off + 40, r->msg + r->off + 73,
+                                  now_unix);
+                r->result = verified ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+            } else if (r->type == 257) {
+                store_node_ann(gi, r->msg, r->len, r->off, now_unix);
+                r->result = verified ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+            } else {
+                store_chan_update(gi, r->msg, r->len, &r->upd, r->node1, r->node2,
+                                  r->have_signer, now_unix);
+                r->result = (verified && r->have_signer)
+                            ? GOSSIP_INGEST_OK : GOSSIP_INGEST_NO_VERIFY;
+            }
+            seen_note(gi, r->seen_key, r->result,
+                      r->type == 258 ? &r->upd : NULL);
+            accepted++;
+        }
+    }
+
+    if (txn) gossip_store_commit(gi->gs);
+    return accepted;
+}
+
+size_t gossip_ingest_batch(gossip_ingest_t            *gi,
+                           const unsigned char *const *msgs,
+                           const size_t               *lens,
+                           size_t                      n,
+                           uint32_t                    now_unix,
+                           int                        *results_out)
+{
+    if (!gi || !msgs || !lens || n == 0 || n > (size_t)INT32_MAX / 2)
+        return 0;
+
+    batch_t b;
+    b.n_slots = 16;
+    while (b.n_slots < 2 * n) b.n_slots <<= 1;
+    b.recs  = (batch_rec_t *)calloc(n, sizeof(batch_rec_t));
+    b.slots = (int32_t *)malloc(b.n_slots * sizeof(int32_t));
+    b.jobs  = (int *)malloc(n * sizeof(int));
+    if (!b.recs || !b.slots || !b.jobs) {
+        free(b.recs);
+        free(b.slots);
+        free(b.jobs);
+        /* Out of memory for the pipeline: fall back to one at a time. */
+        size_t accepted = 0;
+        for (size_t i = 0; i < n; i++) {
+            int r = gossip_ingest_message(gi, msgs[i], lens[i], now_unix);
+            if (results_out) results_out[i] = r;
+            if (r == GOSSIP_INGEST_OK || r == GOSSIP_INGEST_NO_VERIFY)
+                accepted++;
+        }
+        return accepted;
+    }
+    memset(b.slots, 0xff, b.n_slots * sizeof(int32_t));
+
+    for (size_t i = 0; i < n; i++) {
+        b.recs[i].msg = msgs[i];
+        b.recs[i].len = lens[i];
+        batch_parse(gi, &b.recs[i]);
+    }
+    batch_dedupe(gi, &b, n);
+    batch_admit(gi, &b, n, now_unix);
+
+    if (gi->ctx)
+        batch_verify(gi, &b, n);
+    size_t accepted = batch_commit(gi, &b, n, now_unix);
+
+    if (results_out)
+        for (size_t i = 0; i < n; i++)
+            results_out[i] = b.recs[i].result;
+    free(b.recs);
+    free(b.slots);
+    free(b.jobs);
+    return accepted;
+}
+
 /* -----------------------------------------------------------------------
  * Dispatcher
  * --------------------------------------------------------------------- */
@@ -421,6 +1128,7 @@ const char *gossip_ingest_result_str(int result)
     case GOSSIP_INGEST_MALFORMED:    return "malformed";
     case GOSSIP_INGEST_UNKNOWN_TYPE: return "unknown_type";
     case GOSSIP_INGEST_NO_VERIFY:    return "no_verify";
+    case GOSSIP_INGEST_DUPLICATE:    return "duplicate";
     default:                          return "unknown";
     }
 }
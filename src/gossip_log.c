@@ -0,0 +1,755 @@
+/*
+ * gossip_log.c — Append-only binary gossip store, memory-mapped
+ *
+ * See gossip_log.h for the file format.
+ */
+
+#include "superscalar/gossip_log.h"
+#include "superscalar/rgs.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+static const unsigned char LOG_MAGIC[4] = { 'S', 'S', 'G', 'L' };
+
+#define INIT_SLOTS       256u
+#define COMPACT_BUF_LEN  (1u << 20)
+#define MAP_MIN_LEN      (1u << 20)   /* first mapping; doubles from here */
+
+/* -----------------------------------------------------------------------
+ * Wire helpers
+ * --------------------------------------------------------------------- */
+
+static uint16_t rd16(const unsigned char *p)
+{
+    return (uint16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static uint32_t rd32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] <<  8) | (uint32_t)p[3];
+}
+
+static uint64_t rd64(const unsigned char *p)
+{
+    return ((uint64_t)rd32(p) << 32) | rd32(p + 4);
+}
+
+static void wr16(unsigned char *p, uint16_t v)
+{
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+static void wr32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void wr64(unsigned char *p, uint64_t v)
+{
+    wr32(p, (uint32_t)(v >> 32));
+    wr32(p + 4, (uint32_t)v);
+}
+
+/* channel_announcement: offset of chain_hash (scid +32, node_id_1 +40,
+ * node_id_2 +73), or 0 if too short. */
+static size_t ann_base(const unsigned char *msg, size_t len)
+{
+    if (len < 432) return 0;
+    size_t base = 260 + (size_t)rd16(msg + 258);
+    return len >= base + 32 + 8 + 4 * 33 ? base : 0;
+}
+
+/* -----------------------------------------------------------------------
+ * Mapping and raw records
+ * --------------------------------------------------------------------- */
+
+/*
+ * Map at least [0, file_len).  The mapping runs past the end of the file
+ * and doubles when the file outgrows it, so appends and lookups do not
+ * remap: records appended since show through MAP_SHARED, and nothing
+ * past file_len is ever read.
+ */
+static int map_sync(gossip_log_t *gl)
+{
+    if (gl->map && gl->map_len >= gl->file_len) return 1;
+    size_t len = gl->map_len ? gl->map_len : MAP_MIN_LEN;
+    while (len < gl->file_len) len *= 2;
+    if (gl->map) munmap(gl->map, gl->map_len);
+    gl->map = NULL;
+    gl->map_len = 0;
+    void *m = mmap(NULL, len, PROT_READ, MAP_SHARED, gl->fd, 0);
+    if (m == MAP_FAILED) return 0;
+    gl->map = (unsigned char *)m;
+    gl->map_len = len;
+    gl->n_maps++;
+    return 1;
+}
+
+/* Record at off (map must cover it): message and its length. */
+static const unsigned char *rec_msg(const gossip_log_t *gl, uint64_t off, size_t *len)
+{
+    *len = rd16(gl->map + off + 2);
+    return gl->map + off + GOSSIP_LOG_REC_HDR_LEN;
+}
+
+static uint64_t write_record(gossip_log_t *gl, uint32_t ts,
+                             const unsigned char *msg, size_t len)
+{
+    unsigned char hdr[GOSSIP_LOG_REC_HDR_LEN];
+    wr16(hdr, 0);
+    wr16(hdr + 2, (uint16_t)len);
+    wr32(hdr + 4, ts);
+    struct iovec iov[2] = {
+        { hdr, sizeof(hdr) },
+        { (void *)msg, len },
+    };
+    uint64_t off = gl->file_len;
+    ssize_t n = pwritev(gl->fd, iov, 2, (off_t)off);
+    if (n != (ssize_t)(sizeof(hdr) + len)) {
+        /* Leave no partial record behind. */
+        if (ftruncate(gl->fd, (off_t)off) != 0) { /* reopened as torn tail */ }
+        return 0;
+    }
+    gl->file_len += sizeof(hdr) + len;
+    gl->live_bytes += sizeof(hdr) + len;
+    return off;
+}
+
+static void mark_deleted(gossip_log_t *gl, uint64_t off)
+{
+    unsigned char hdr[4];
+    if (pread(gl->fd, hdr, 4, (off_t)off) != 4) return;
+    uint16_t flags = rd16(hdr);
+    if (flags & GOSSIP_LOG_DELETED) return;
+    wr16(hdr, (uint16_t)(flags | GOSSIP_LOG_DELETED));
+    if (pwrite(gl->fd, hdr, 2, (off_t)off) != 2) return;
+    uint64_t sz = GOSSIP_LOG_REC_HDR_LEN + rd16(hdr + 2);
+    gl->live_bytes -= sz;
+    gl->dead_bytes += sz;
+}
+
+/* -----------------------------------------------------------------------
+ * Index
+ * --------------------------------------------------------------------- */
+
+static size_t mix(uint64_t k, size_t mask)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static gossip_log_chan_t *chan_find(const gossip_log_t *gl, uint64_t scid)
+{
+    if (!gl->n_chan_slots || !scid) return NULL;
+    size_t mask = gl->n_chan_slots - 1;
+    for (size_t i = mix(scid, mask); gl->chans[i].scid; i = (i + 1) & mask)
+        if (gl->chans[i].scid == scid) return &gl->chans[i];
+    return NULL;
+}
+
+static gossip_log_chan_t *chan_add(gossip_log_t *gl, uint64_t scid)
+{
+    gossip_log_chan_t *c = chan_find(gl, scid);
+    if (c || !scid) return c;
+    if ((gl->n_chans + 1) * 2 > gl->n_chan_slots) {
+        size_t n = gl->n_chan_slots ? gl->n_chan_slots * 2 : INIT_SLOTS;
+        gossip_log_chan_t *t = (gossip_log_chan_t *)calloc(n, sizeof(*t));
+        if (!t) return NULL;
+        for (size_t i = 0; i < gl->n_chan_slots; i++) {
+            if (!gl->chans[i].scid) continue;
+            size_t j = mix(gl->chans[i].scid, n - 1);
+            while (t[j].scid) j = (j + 1) & (n - 1);
+            t[j] = gl->chans[i];
+        }
+        free(gl->chans);
+        gl->chans = t;
+        gl->n_chan_slots = n;
+    }
+    size_t mask = gl->n_chan_slots - 1;
+    size_t i = mix(scid, mask);
+    while (gl->chans[i].scid) i = (i + 1) & mask;
+    gl->chans[i].scid = scid;
+    gl->n_chans++;
+    return &gl->chans[i];
+}
+
+static uint64_t node_key(const unsigned char id[33])
+{
+    return rd64(id + 1) ^ rd64(id + 25);
+}
+
+static gossip_log_node_t *node_slot(gossip_log_t *gl, const unsigned char id[33],
+                                    int create)
+{
+    if (create && (gl->n_nodes + 1) * 2 > gl->n_node_slots) {
+        size_t n = gl->n_node_slots ? gl->n_node_slots * 2 : INIT_SLOTS;
+        gossip_log_node_t *t = (gossip_log_node_t *)calloc(n, sizeof(*t));
+        if (!t) return NULL;
+        for (size_t i = 0; i < gl->n_node_slots; i++) {
+            if (!gl->nodes[i].off) continue;
+            size_t j = mix(node_key(gl->nodes[i].node_id), n - 1);
+            while (t[j].off) j = (j + 1) & (n - 1);
+            t[j] = gl->nodes[i];
+        }
+        free(gl->nodes);
+        gl->nodes = t;
+        gl->n_node_slots = n;
+    }
+    if (!gl->n_node_slots) return NULL;
+    size_t mask = gl->n_node_slots - 1;
+    size_t i = mix(node_key(id), mask);
+    for (; gl->nodes[i].off; i = (i + 1) & mask)
+        if (memcmp(gl->nodes[i].node_id, id, 33) == 0) return &gl->nodes[i];
+    if (!create) return NULL;
+    memcpy(gl->nodes[i].node_id, id, 33);
+    gl->n_nodes++;
+    return &gl->nodes[i];   /* off still 0: caller fills it in */
+}
+
+/*
+ * Where msg belongs in the index.  Returns 1 with *slot pointing at the
+ * offset field to (re)point -- its old value, if any, is the record this
+ * one supersedes -- and *ts_slot / *ts for the timestamp to keep; 0 if
+ * the message is redundant or unusable.
+ */
+static int index_place(gossip_log_t *gl, const unsigned char *msg, size_t len,
+                       uint64_t **slot, uint32_t **ts_slot, uint32_t *ts)
+{
+    if (len < 2) return 0;
+    *ts_slot = NULL;
+    *ts = 0;
+    switch (rd16(msg)) {
+    case 256: {
+        size_t base = ann_base(msg, len);
+        if (!base) return 0;
+        gossip_log_chan_t *c = chan_add(gl, rd64(msg + base + 32));
+        if (!c || c->ann_off) return 0;
+        gl->sorted_dirty = 1;
+        *slot = &c->ann_off;
+        return 1;
+    }
+    case 257: {
+        if (len < 142) return 0;
+        size_t flen = rd16(msg + 66);
+        if (len < 142 + flen) return 0;
+        gossip_log_node_t *nd = node_slot(gl, msg + 72 + flen, 1);
+        if (!nd) return 0;
+        *ts = rd32(msg + 68 + flen);
+        if (nd->off && *ts <= nd->ts) return 0;
+        *slot = &nd->off;
+        *ts_slot = &nd->ts;
+        return 1;
+    }
+    case 258: {
+        if (len < 130) return 0;
+        gossip_log_chan_t *c = chan_find(gl, rd64(msg + 98));
+        if (!c || !c->ann_off) return 0;
+        int dir = msg[111] & 1;
+        *ts = rd32(msg + 106);
+        if (c->upd_off[dir] && *ts <= c->upd_ts[dir]) return 0;
+        *slot = &c->upd_off[dir];
+        *ts_slot = &c->upd_ts[dir];
+        return 1;
+    }
+    case GOSSIP_LOG_CHANNEL_AMOUNT: {
+        if (len < 18) return 0;
+        gossip_log_chan_t *c = chan_add(gl, rd64(msg + 2));
+        if (!c) return 0;
+        *slot = &c->amount_off;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+static void index_set(gossip_log_t *gl, uint64_t *slot, uint32_t *ts_slot,
+                      uint32_t ts, uint64_t off)
+{
+    if (*slot) mark_deleted(gl, *slot);
+    *slot = off;
+    if (ts_slot) *ts_slot = ts;
+}
+
+static void index_clear(gossip_log_t *gl)
+{
+    free(gl->chans);
+    free(gl->nodes);
+    free(gl->sorted);
+    gl->chans = NULL;
+    gl->nodes = NULL;
+    gl->sorted = NULL;
+    gl->n_chan_slots = gl->n_chans = 0;
+    gl->n_node_slots = gl->n_nodes = 0;
+    gl->n_sorted = 0;
+    gl->sorted_dirty = 1;
+}
+
+static int scid_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int sorted_refresh(gossip_log_t *gl)
+{
+    if (!gl->sorted_dirty) return 1;
+    uint64_t *s = (uint64_t *)malloc((gl->n_chans ? gl->n_chans : 1) * sizeof(uint64_t));
+    if (!s) return 0;
+    size_t n = 0;
+    for (size_t i = 0; i < gl->n_chan_slots; i++)
+        if (gl->chans[i].scid && gl->chans[i].ann_off)
+            s[n++] = gl->chans[i].scid;
+    qsort(s, n, sizeof(uint64_t), scid_cmp);
+    free(gl->sorted);
+    gl->sorted = s;
+    gl->n_sorted = n;
+    gl->sorted_dirty = 0;
+    return 1;
+}
+
+/* -----------------------------------------------------------------------
+ * Open / scan / compact
+ * --------------------------------------------------------------------- */
+
+/* Open path and index every live record.  Called with the lock held. */
+static int load(gossip_log_t *gl)
+{
+    gl->fd = open(gl->path, O_RDWR | O_CREAT, 0600);
+    if (gl->fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(gl->fd, &st) != 0) return 0;
+    uint64_t size = (uint64_t)st.st_size;
+    if (size < GOSSIP_LOG_HDR_LEN) {
+        unsigned char hdr[GOSSIP_LOG_HDR_LEN];
+        memcpy(hdr, LOG_MAGIC, 4);
+        wr32(hdr + 4, GOSSIP_LOG_VERSION);
+        if (ftruncate(gl->fd, 0) != 0 ||
+            pwrite(gl->fd, hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr))
+            return 0;
+        size = GOSSIP_LOG_HDR_LEN;
+    }
+    gl->file_len = size;
+    gl->live_bytes = gl->dead_bytes = 0;
+    if (!map_sync(gl)) return 0;
+    if (memcmp(gl->map, LOG_MAGIC, 4) != 0 ||
+        rd32(gl->map + 4) != GOSSIP_LOG_VERSION) {
+        fprintf(stderr, "gossip_log: %s: not a gossip log\n", gl->path);
+        return 0;
+    }
+
+    uint64_t off = GOSSIP_LOG_HDR_LEN;
+    while (off + GOSSIP_LOG_REC_HDR_LEN <= size) {
+        const unsigned char *r = gl->map + off;
+        uint64_t sz = GOSSIP_LOG_REC_HDR_LEN + rd16(r + 2);
+        if (off + sz > size) break;
+        if (rd16(r) & GOSSIP_LOG_DELETED) {
+            gl->dead_bytes += sz;
+        } else {
+            gl->live_bytes += sz;
+            uint64_t *slot; uint32_t *ts_slot; uint32_t ts;
+            size_t len;
+            const unsigned char *msg = rec_msg(gl, off, &len);
+            if (index_place(gl, msg, len, &slot, &ts_slot, &ts))
+                index_set(gl, slot, ts_slot, ts, off);
+            else
+                mark_deleted(gl, off);
+        }
+        off += sz;
+    }
+    if (off < size) {
+        /* Torn tail from a crash mid-append. */
+        if (ftruncate(gl->fd, (off_t)off) != 0) return 0;
+        gl->file_len = off;
+    }
+    return map_sync(gl);
+}
+
+static void unload(gossip_log_t *gl)
+{
+    if (gl->map) munmap(gl->map, gl->map_len);
+    gl->map = NULL;
+    gl->map_len = 0;
+    if (gl->fd >= 0) close(gl->fd);
+    gl->fd = -1;
+    index_clear(gl);
+}
+
+static int compact_locked(gossip_log_t *gl)
+{
+    if (!map_sync(gl)) return 0;
+    size_t plen = strlen(gl->path);
+    char *tmp = (char *)malloc(plen + sizeof(".compact"));
+    unsigned char *buf = (unsigned char *)malloc(COMPACT_BUF_LEN);
+    int fd = -1, ok = 0;
+    if (!tmp || !buf) goto out;
+    memcpy(tmp, gl->path, plen);
+    memcpy(tmp + plen, ".compact", sizeof(".compact"));
+
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) goto out;
+    size_t used = GOSSIP_LOG_HDR_LEN;
+    memcpy(buf, gl->map, GOSSIP_LOG_HDR_LEN);
+    for (uint64_t off = GOSSIP_LOG_HDR_LEN; off < gl->file_len; ) {
+        const unsigned char *r = gl->map + off;
+        size_t sz = GOSSIP_LOG_REC_HDR_LEN + rd16(r + 2);
+        if (!(rd16(r) & GOSSIP_LOG_DELETED)) {
+            if (used + sz > COMPACT_BUF_LEN) {
+                if (write(fd, buf, used) != (ssize_t)used) goto out;
+                used = 0;
+            }
+            memcpy(buf + used, r, sz);
+            used += sz;
+        }
+        off += sz;
+    }
+    if (write(fd, buf, used) != (ssize_t)used || fsync(fd) != 0) goto out;
+    close(fd);
+    fd = -1;
+    if (rename(tmp, gl->path) != 0) goto out;
+
+    unload(gl);
+    ok = load(gl);
+    gl->n_compactions++;
+out:
+    if (fd >= 0) {
+        close(fd);
+        unlink(tmp);
+    }
+    free(tmp);
+    free(buf);
+    return ok;
+}
+
+static void maybe_compact(gossip_log_t *gl)
+{
+    if (gl->dead_bytes > GOSSIP_LOG_COMPACT_MIN && gl->dead_bytes > gl->live_bytes)
+        compact_locked(gl);
+}
+
+/* -----------------------------------------------------------------------
+ * Public API
+ * --------------------------------------------------------------------- */
+
+int gossip_log_open(gossip_log_t *gl, const char *path)
+{
+    if (!gl || !path) return 0;
+    memset(gl, 0, sizeof(*gl));
+    gl->fd = -1;
+    gl->path = strdup(path);
+    if (!gl->path) return 0;
+    pthread_mutex_init(&gl->lock, NULL);
+    if (!load(gl)) {
+        unload(gl);
+        pthread_mutex_destroy(&gl->lock);
+        free(gl->path);
+        gl->path = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void gossip_log_close(gossip_log_t *gl)
+{
+    if (!gl || !gl->path) return;
+    unload(gl);
+    pthread_mutex_destroy(&gl->lock);
+    free(gl->path);
+    gl->path = NULL;
+}
+
+int gossip_log_append(gossip_log_t *gl, const unsigned char *msg, size_t len,
+                      uint32_t recv_time)
+{
+    if (!gl || !gl->path || !msg || len > 0xFFFF) return 0;
+    uint16_t type = len >= 2 ? rd16(msg) : 0;
+    if (type < 256 || type > 258) return 0;
+
+    pthread_mutex_lock(&gl->lock);
+    uint64_t *slot; uint32_t *ts_slot; uint32_t ts;
+    int ok = 0;
+    if (index_place(gl, msg, len, &slot, &ts_slot, &ts)) {
+        uint64_t off = write_record(gl, recv_time, msg, len);
+        if (off) {
+            index_set(gl, slot, ts_slot, ts, off);
+            ok = 1;
+        } else if (type == 256) {
+            gl->sorted_dirty = 1;
+        }
+        maybe_compact(gl);
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return ok;
+}
+
+int gossip_log_set_amount(gossip_log_t *gl, uint64_t scid, uint64_t capacity_sat)
+{
+    if (!gl || !gl->path) return 0;
+    unsigned char msg[18];
+    wr16(msg, GOSSIP_LOG_CHANNEL_AMOUNT);
+    wr64(msg + 2, scid);
+    wr64(msg + 10, capacity_sat);
+
+    pthread_mutex_lock(&gl->lock);
+    uint64_t *slot; uint32_t *ts_slot; uint32_t ts;
+    int ok = 0;
+    if (index_place(gl, msg, sizeof(msg), &slot, &ts_slot, &ts)) {
+        uint64_t off = write_record(gl, (uint32_t)time(NULL), msg, sizeof(msg));
+        if (off) {
+            index_set(gl, slot, ts_slot, ts, off);
+            ok = 1;
+        }
+        maybe_compact(gl);
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return ok;
+}
+
+int gossip_log_mark_spent(gossip_log_t *gl, uint64_t scid)
+{
+    if (!gl || !gl->path) return 0;
+    pthread_mutex_lock(&gl->lock);
+    gossip_log_chan_t *c = chan_find(gl, scid);
+    int found = c && c->ann_off;
+    if (c) {
+        uint64_t *offs[4] = { &c->ann_off, &c->upd_off[0], &c->upd_off[1],
+                              &c->amount_off };
+        for (int i = 0; i < 4; i++) {
+            if (*offs[i]) mark_deleted(gl, *offs[i]);
+            *offs[i] = 0;
+        }
+        c->upd_ts[0] = c->upd_ts[1] = 0;
+        gl->sorted_dirty = 1;
+        maybe_compact(gl);
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return found;
+}
+
+int gossip_log_get_channel(gossip_log_t *gl, uint64_t scid,
+                           unsigned char node1_out[33],
+                           unsigned char node2_out[33],
+                           uint64_t *capacity_out)
+{
+    if (!gl || !gl->path) return 0;
+    pthread_mutex_lock(&gl->lock);
+    const gossip_log_chan_t *c = chan_find(gl, scid);
+    int found = c && c->ann_off && map_sync(gl);
+    if (found) {
+        size_t len;
+        const unsigned char *ann = rec_msg(gl, c->ann_off, &len);
+        size_t base = ann_base(ann, len);
+        if (node1_out) memcpy(node1_out, ann + base + 40, 33);
+        if (node2_out) memcpy(node2_out, ann + base + 73, 33);
+        if (capacity_out)
+            *capacity_out = c->amount_off
+                ? rd64(rec_msg(gl, c->amount_off, &len) + 10) : 0;
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return found;
+}
+
+int gossip_log_compact(gossip_log_t *gl)
+{
+    if (!gl || !gl->path) return 0;
+    pthread_mutex_lock(&gl->lock);
+    int ok = compact_locked(gl);
+    pthread_mutex_unlock(&gl->lock);
+    return ok;
+}
+
+size_t gossip_log_channel_count(gossip_log_t *gl)
+{
+    if (!gl || !gl->path) return 0;
+    pthread_mutex_lock(&gl->lock);
+    size_t n = sorted_refresh(gl) ? gl->n_sorted : 0;
+    pthread_mutex_unlock(&gl->lock);
+    return n;
+}
+
+/* ---- Readers ---- */
+
+int gossip_log_enumerate_channels(gossip_log_t *gl,
+                                  gossip_store_full_channel_cb_t cb,
+                                  void *ctx)
+{
+    if (!gl || !gl->path || !cb) return -1;
+    pthread_mutex_lock(&gl->lock);
+    if (!map_sync(gl)) {
+        pthread_mutex_unlock(&gl->lock);
+        return -1;
+    }
+    int count = 0;
+    for (size_t i = 0; i < gl->n_chan_slots; i++) {
+        const gossip_log_chan_t *c = &gl->chans[i];
+        if (!c->scid || !c->ann_off) continue;
+        size_t len;
+        const unsigned char *ann = rec_msg(gl, c->ann_off, &len);
+        size_t base = ann_base(ann, len);
+        const unsigned char *n1 = ann + base + 40, *n2 = ann + base + 73;
+        uint64_t cap_sat = c->amount_off
+            ? rd64(rec_msg(gl, c->amount_off, &len) + 10) : 0;
+
+        for (int dir = 0; dir < 2; dir++) {
+            if (!c->upd_off[dir]) continue;
+            const unsigned char *u = rec_msg(gl, c->upd_off[dir], &len);
+            if (u[111] & 0x02) continue;          /* disabled */
+            uint64_t htlc_max = ((u[110] & 0x01) && len >= 138)
+                                ? rd64(u + 130) : cap_sat * 1000ULL;
+            cb(c->scid, dir ? n2 : n1, dir ? n1 : n2,
+               rd32(u + 122), rd32(u + 126), rd16(u + 112),
+               rd64(u + 114), htlc_max, cap_sat, ctx);
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return count;
+}
+
+static void emit_channel(const gossip_log_t *gl, const gossip_log_chan_t *c,
+                         gossip_log_channel_cb_t cb, void *userdata)
+{
+    size_t ann_len;
+    const unsigned char *ann = rec_msg(gl, c->ann_off, &ann_len);
+    const unsigned char *upd[2] = { NULL, NULL };
+    size_t upd_len[2] = { 0, 0 };
+    for (int dir = 0; dir < 2; dir++)
+        if (c->upd_off[dir])
+            upd[dir] = rec_msg(gl, c->upd_off[dir], &upd_len[dir]);
+    cb(c->scid, ann, ann_len, upd, upd_len, userdata);
+}
+
+int gossip_log_channels_in_range(gossip_log_t *gl,
+                                 uint32_t first_blocknum, uint32_t num_blocks,
+                                 gossip_log_channel_cb_t cb, void *userdata)
+{
+    if (!gl || !gl->path || !cb) return 0;
+    pthread_mutex_lock(&gl->lock);
+    int found = 0;
+    if (sorted_refresh(gl) && map_sync(gl)) {
+        uint64_t lo = (uint64_t)first_blocknum << 40;
+        uint64_t end_block = (uint64_t)first_blocknum + num_blocks;
+        /* First scid >= lo */
+        size_t a = 0, b = gl->n_sorted;
+        while (a < b) {
+            size_t m = a + (b - a) / 2;
+            if (gl->sorted[m] < lo) a = m + 1; else b = m;
+        }
+        for (size_t i = a; i < gl->n_sorted && (gl->sorted[i] >> 40) < end_block; i++) {
+            emit_channel(gl, chan_find(gl, gl->sorted[i]), cb, userdata);
+            found++;
+        }
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return found;
+}
+
+int gossip_log_channels_by_scids(gossip_log_t *gl,
+                                 const uint64_t *scids, int n_scids,
+                                 gossip_log_channel_cb_t cb, void *userdata)
+{
+    if (!gl || !gl->path || !scids || n_scids <= 0 || !cb) return 0;
+    pthread_mutex_lock(&gl->lock);
+    int found = 0;
+    if (map_sync(gl)) {
+        for (int i = 0; i < n_scids; i++) {
+            const gossip_log_chan_t *c = chan_find(gl, scids[i]);
+            if (!c || !c->ann_off) continue;
+            emit_channel(gl, c, cb, userdata);
+            found++;
+        }
+    }
+    pthread_mutex_unlock(&gl->lock);
+    return found;
+}
+
+/* Index of node id in nodes[], adding it if there is room; -1 if full. */
+static int rgs_node_idx(rgs_node_id_t *nodes, uint32_t *n_nodes,
+                        int32_t *slots, size_t mask, const unsigned char id[33])
+{
+    size_t i = mix(node_key(id), mask);
+    for (; slots[i] >= 0; i = (i + 1) & mask)
+        if (memcmp(nodes[slots[i]].pubkey, id, 33) == 0) return slots[i];
+    if (*n_nodes >= RGS_MAX_NODE_IDS) return -1;
+    memcpy(nodes[*n_nodes].pubkey, id, 33);
+    slots[i] = (int32_t)*n_nodes;
+    return (int)(*n_nodes)++;
+}
+
+size_t gossip_log_export_rgs(gossip_log_t *gl, unsigned char *out, size_t out_cap)
+{
+    if (!gl || !gl->path || !out) return 0;
+
+    size_t n_slots = 2 * RGS_MAX_NODE_IDS;
+    rgs_node_id_t *nodes = (rgs_node_id_t *)calloc(RGS_MAX_NODE_IDS, sizeof(rgs_node_id_t));
+    rgs_channel_t *channels = (rgs_channel_t *)calloc(RGS_MAX_CHANNELS, sizeof(rgs_channel_t));
+    int32_t *slots = (int32_t *)malloc(n_slots * sizeof(int32_t));
+    if (!nodes || !channels || !slots) {
+        free(nodes); free(channels); free(slots);
+        return 0;
+    }
+    memset(slots, 0xff, n_slots * sizeof(int32_t));
+    uint32_t n_nodes = 0, n_channels = 0;
+
+    pthread_mutex_lock(&gl->lock);
+    if (sorted_refresh(gl) && map_sync(gl)) {
+        for (size_t i = 0; i < gl->n_sorted && n_channels < RGS_MAX_CHANNELS; i++) {
+            const gossip_log_chan_t *c = chan_find(gl, gl->sorted[i]);
+            size_t len;
+            const unsigned char *ann = rec_msg(gl, c->ann_off, &len);
+            size_t base = ann_base(ann, len);
+            int i1 = rgs_node_idx(nodes, &n_nodes, slots, n_slots - 1, ann + base + 40);
+            int i2 = rgs_node_idx(nodes, &n_nodes, slots, n_slots - 1, ann + base + 73);
+            if (i1 < 0 || i2 < 0) continue;
+
+            rgs_channel_t *ch = &channels[n_channels++];
+            ch->short_channel_id = c->scid;
+            ch->node_id_1_idx = (uint32_t)i1;
+            ch->node_id_2_idx = (uint32_t)i2;
+            ch->funding_satoshis = c->amount_off
+                ? rd64(rec_msg(gl, c->amount_off, &len) + 10) : 0;
+            for (int dir = 0; dir < 2; dir++) {
+                if (!c->upd_off[dir]) continue;
+                const unsigned char *u = rec_msg(gl, c->upd_off[dir], &len);
+                rgs_channel_update_t *ru = &ch->updates[ch->update_count++];
+                ru->direction = dir;
+                ru->timestamp = rd32(u + 106);
+                ru->flags = (u[111] & 0x02) ? 1 : 0;
+                ru->cltv_expiry_delta = rd16(u + 112);
+                ru->htlc_minimum_msat = rd64(u + 114);
+                ru->fee_base_msat = rd32(u + 122);
+                ru->fee_proportional_millionths = rd32(u + 126);
+                ru->htlc_maximum_msat = ((u[110] & 0x01) && len >= 138)
+                                        ? rd64(u + 130) : 0;
+            }
+        }
+    }
+    pthread_mutex_unlock(&gl->lock);
+
+    rgs_snapshot_t snap;
+    snap.last_sync_timestamp = (uint32_t)time(NULL);
+    snap.node_id_count = n_nodes;
+    snap.node_ids = nodes;
+    snap.channel_count = n_channels;
+    snap.channels = channels;
+    size_t result = rgs_build(&snap, nodes, channels, out, out_cap);
+    free(nodes);
+    free(channels);
+    free(slots);
+    return result;
+}
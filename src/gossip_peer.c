@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/socket.h>
+#include <poll.h>
 
 /* -----------------------------------------------------------------------
  * Timestamp filter strategy
@@ -266,6 +267,46 @@ int gossip_peer_parse_list(const char *list, gossip_peer_cfg_t *out, int max) {
     return count;
 }
 
+/* -----------------------------------------------------------------------
+ * Batched ingest
+ * --------------------------------------------------------------------- */
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+int gossip_peer_batch_add(gossip_peer_batch_t *b, const unsigned char *msg,
+                          size_t msg_len, uint64_t now_ms) {
+    if (!b || !msg || b->n >= GOSSIP_PEER_BATCH_MAX) return -1;
+    unsigned char *copy = (unsigned char *)malloc(msg_len);
+    if (!copy) return -1;
+    memcpy(copy, msg, msg_len);
+    if (b->n == 0) b->first_ms = now_ms;
+    b->msgs[b->n] = copy;
+    b->lens[b->n] = msg_len;
+    b->n++;
+    return b->n == GOSSIP_PEER_BATCH_MAX;
+}
+
+size_t gossip_peer_batch_flush(const gossip_peer_mgr_cfg_t *cfg,
+                               gossip_peer_batch_t *b, uint32_t now_unix) {
+    if (!b || b->n == 0) return 0;
+    size_t accepted = 0;
+    if (cfg && cfg->gi) {
+        if (cfg->gi_lock) pthread_mutex_lock(cfg->gi_lock);
+        accepted = gossip_ingest_batch(cfg->gi,
+                                       (const unsigned char *const *)b->msgs,
+                                       b->lens, b->n, now_unix, NULL);
+        if (cfg->gi_lock) pthread_mutex_unlock(cfg->gi_lock);
+    }
+    for (size_t i = 0; i < b->n; i++)
+        free(b->msgs[i]);
+    b->n = 0;
+    return accepted;
+}
+
 /* -----------------------------------------------------------------------
  * Per-peer connection loop
  * --------------------------------------------------------------------- */
@@ -278,7 +319,7 @@ typedef struct {
 int gossip_peer_run_once(const gossip_peer_cfg_t *peer,
                           const gossip_peer_mgr_cfg_t *cfg,
                           int peer_index) {
-    if (!peer || !cfg || !cfg->store) return 0;
+    if (!peer || !cfg || !cfg->gi) return 0;
 
     int fd = wire_connect_direct_internal(peer->host, peer->port);
     if (fd < 0) return 0;
@@ -313,13 +354,6 @@ int gossip_peer_run_once(const gossip_peer_cfg_t *peer,
     if (filter_len > 0)
         bolt8_send(&state, fd, filter_buf, filter_len);
 
-    gossip_reject_cache_t  reject_cache;
-    gossip_waiting_proof_store_t waiting;
-    gossip_rate_table_t    rate;
-    memset(&reject_cache, 0, sizeof(reject_cache));
-    memset(&waiting,      0, sizeof(waiting));
-    memset(&rate,         0, sizeof(rate));
-
     /* 5-minute new-peer embargo */
     uint32_t embargo_until = now + GOSSIP_EMBARGO_SECS;
 
@@ -329,9 +363,27 @@ int gossip_peer_run_once(const gossip_peer_cfg_t *peer,
     setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
     unsigned char *msg_buf = (unsigned char *)malloc(65536);
-    if (!msg_buf) { close(fd); return 0; }
+    gossip_peer_batch_t *batch = (gossip_peer_batch_t *)calloc(1, sizeof(*batch));
+    if (!msg_buf || !batch) {
+        free(msg_buf);
+        free(batch);
+        close(fd);
+        return 0;
+    }
 
     while (!(*cfg->shutdown_flag)) {
+        /* A partial batch waits for more gossip, but not for long */
+        if (batch->n > 0) {
+            uint64_t age = monotonic_ms() - batch->first_ms;
+            int wait = age >= GOSSIP_PEER_BATCH_WAIT_MS
+                       ? 0 : (int)(GOSSIP_PEER_BATCH_WAIT_MS - age);
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            if (wait == 0 || poll(&pfd, 1, wait) == 0) {
+                gossip_peer_batch_flush(cfg, batch, (uint32_t)time(NULL));
+                continue;
+            }
+        }
+
         size_t msg_len = 0;
         if (!bolt8_recv(&state, fd, msg_buf, &msg_len, 65536))
             break;
@@ -340,58 +392,15 @@ int gossip_peer_run_once(const gossip_peer_cfg_t *peer,
 
         uint16_t wire_type = ((uint16_t)msg_buf[0] << 8) | msg_buf[1];
         uint32_t recv_now  = (uint32_t)time(NULL);
-        int embargoing = (recv_now < embargo_until);
+        if (recv_now < embargo_until)
+            continue;
 
         switch (wire_type) {
-        case GOSSIP_MSG_NODE_ANNOUNCEMENT:  /* 257 */
-            if (!embargoing) {
-                /* Verify and store node announcement */
-                if (gossip_verify_node_announcement(cfg->ctx, msg_buf, msg_len)) {
-                    /* Extract alias and address for storage (simplified) */
-                    unsigned char zero_pub[33] = {0};
-                    gossip_store_upsert_node(cfg->store, zero_pub, NULL, NULL,
-                                              recv_now);
-                }
-            }
-            break;
-
-        case GOSSIP_MSG_CHANNEL_UPDATE: {  /* 258 */
-            if (msg_len < 114) break;
-            uint64_t scid = 0;
-            for (int i = 0; i < 8; i++)
-                scid = (scid << 8) | msg_buf[2 + 64 + 32 + i];
-            int direction = (msg_buf[2 + 64 + 32 + 8 + 4 + 1] & 0x01);
-            if (!embargoing && !gossip_reject_cache_contains(&reject_cache, scid)) {
-                if (gossip_rate_allow_update(&rate, scid, direction, recv_now)) {
-                    /* Parse fee_base, fee_ppm, cltv_delta, timestamp */
-                    uint32_t ts = ((uint32_t)msg_buf[2+64+32+8] << 24) |
-                                  ((uint32_t)msg_buf[2+64+32+9] << 16) |
-                                  ((uint32_t)msg_buf[2+64+32+10] << 8) |
-                                             msg_buf[2+64+32+11];
-                    uint16_t cltv = ((uint16_t)msg_buf[2+64+32+8+4+2] << 8) |
-                                               msg_buf[2+64+32+8+4+3];
-                    if (msg_len >= 2+64+32+8+4+2+2+8+4+4) {
-                        uint32_t fee_base = ((uint32_t)msg_buf[2+64+32+8+4+2+2+8] << 24) |
-                                            ((uint32_t)msg_buf[2+64+32+8+4+2+2+9] << 16) |
-                                            ((uint32_t)msg_buf[2+64+32+8+4+2+2+10] << 8) |
-                                                       msg_buf[2+64+32+8+4+2+2+11];
-                        uint32_t fee_ppm = ((uint32_t)msg_buf[2+64+32+8+4+2+2+12] << 24) |
-                                           ((uint32_t)msg_buf[2+64+32+8+4+2+2+13] << 16) |
-                                           ((uint32_t)msg_buf[2+64+32+8+4+2+2+14] << 8) |
-                                                      msg_buf[2+64+32+8+4+2+2+15];
-                        gossip_store_upsert_channel_update(cfg->store, scid, direction,
-                                                            fee_base, fee_ppm, cltv, ts);
-                    }
-                }
-            }
-            break;
-        }
-
         case GOSSIP_MSG_CHANNEL_ANNOUNCEMENT:  /* 256 */
-            if (!embargoing) {
-                gossip_waiting_proof_add(&waiting, cfg->store, cfg->ctx,
-                                          msg_buf, msg_len);
-            }
+        case GOSSIP_MSG_NODE_ANNOUNCEMENT:     /* 257 */
+        case GOSSIP_MSG_CHANNEL_UPDATE:        /* 258 */
+            if (gossip_peer_batch_add(batch, msg_buf, msg_len, monotonic_ms()) == 1)
+                gossip_peer_batch_flush(cfg, batch, recv_now);
             break;
 
         case GOSSIP_MSG_TIMESTAMP_FILTER:  /* 265 */
@@ -402,6 +411,8 @@ int gossip_peer_run_once(const gossip_peer_cfg_t *peer,
         }
     }
 
+    gossip_peer_batch_flush(cfg, batch, (uint32_t)time(NULL));
+    free(batch);
     free(msg_buf);
     close(fd);
     return 1;
@@ -447,7 +458,7 @@ void *gossip_peer_thread(void *arg) {
  * --------------------------------------------------------------------- */
 
 int gossip_peer_mgr_start(gossip_peer_mgr_cfg_t *cfg, pthread_t *tids_out) {
-    if (!cfg || !tids_out || cfg->n_peers <= 0) return 0;
+    if (!cfg || !tids_out || !cfg->gi || cfg->n_peers <= 0) return 0;
 
     int started = 0;
     for (int i = 0; i < cfg->n_peers && i < GOSSIP_PEER_MAX; i++) {
@@ -0,0 +1,402 @@
+/*
+ * gossip_query.c — Indexed query_channel_range responder (BOLT #7)
+ *
+ * Reference: BOLT #7 §query-messages, CLN gossipd/queries.c
+ */
+
+#include "superscalar/gossip_query.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t rd32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] <<  8) | (uint32_t)p[3];
+}
+
+static uint64_t rd64(const unsigned char *p)
+{
+    return ((uint64_t)rd32(p) << 32) | rd32(p + 4);
+}
+
+static void wr32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static uint32_t scid_block(uint64_t scid) { return (uint32_t)(scid >> 40); }
+
+/* ---- CRC32C (Castagnoli, RFC 3720) ---- */
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32c(uint32_t crc, const unsigned char *p, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+        crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t gossip_query_update_checksum(const unsigned char *msg, size_t len)
+{
+    /* type(2) sig(64) | chain_hash scid (66..105) | timestamp (106..109) | rest */
+    if (!msg || len < 130) return 0;
+    pthread_once(&crc_once, crc_init);
+    uint32_t crc = crc32c(0, msg + 66, 106 - 66);
+    return crc32c(crc, msg + 110, len - 110);
+}
+
+/* ---- Index ---- */
+
+/* Position of scid, or of the first entry above it. */
+static size_t lower_bound(const gossip_query_index_t *qi, uint64_t scid)
+{
+    size_t a = 0, b = qi->n;
+    while (a < b) {
+        size_t m = a + (b - a) / 2;
+        if (qi->entries[m].scid < scid) a = m + 1; else b = m;
+    }
+    return a;
+}
+
+static gossip_query_entry_t *entry_find(gossip_query_index_t *qi, uint64_t scid)
+{
+    size_t i = lower_bound(qi, scid);
+    return (i < qi->n && qi->entries[i].scid == scid) ? &qi->entries[i] : NULL;
+}
+
+static int entry_add(gossip_query_index_t *qi, uint64_t scid)
+{
+    /* Usually a new block at the tip: the append path. */
+    size_t i = (qi->n && qi->entries[qi->n - 1].scid < scid) ? qi->n
+                                                             : lower_bound(qi, scid);
+    if (i < qi->n && qi->entries[i].scid == scid) return 1;
+    if (qi->n == qi->cap) {
+        size_t cap = qi->cap ? qi->cap * 2 : 1024;
+        gossip_query_entry_t *e = (gossip_query_entry_t *)realloc(
+            qi->entries, cap * sizeof(*e));
+        if (!e) return 0;
+        qi->entries = e;
+        qi->cap = cap;
+    }
+    memmove(&qi->entries[i + 1], &qi->entries[i], (qi->n - i) * sizeof(*qi->entries));
+    memset(&qi->entries[i], 0, sizeof(qi->entries[i]));
+    qi->entries[i].scid = scid;
+    qi->n++;
+    qi->buckets_dirty = 1;
+    return 1;
+}
+
+static int entry_update(gossip_query_index_t *qi, const unsigned char *msg, size_t len)
+{
+    if (!msg || len < 130 || msg[0] != 0x01 || msg[1] != 0x02) return 0;
+    gossip_query_entry_t *e = entry_find(qi, rd64(msg + 98));
+    if (!e) return 0;
+    int dir = msg[111] & 1;
+    uint32_t ts = rd32(msg + 106);
+    if (e->ts[dir] && ts <= e->ts[dir]) return 0;
+    e->ts[dir] = ts;
+    e->csum[dir] = gossip_query_update_checksum(msg, len);
+    return 1;
+}
+
+static int buckets_refresh(gossip_query_index_t *qi)
+{
+    if (!qi->buckets_dirty) return 1;
+    free(qi->buckets);
+    qi->buckets = NULL;
+    qi->n_buckets = 0;
+    if (qi->n) {
+        uint32_t lo = scid_block(qi->entries[0].scid) >> GOSSIP_QUERY_BUCKET_SHIFT;
+        uint32_t hi = scid_block(qi->entries[qi->n - 1].scid) >> GOSSIP_QUERY_BUCKET_SHIFT;
+        size_t nb = (size_t)(hi - lo) + 2;        /* + end sentinel */
+        uint32_t *b = (uint32_t *)malloc(nb * sizeof(uint32_t));
+        if (!b) return 0;
+        size_t i = 0;
+        for (size_t k = 0; k < nb; k++) {
+            uint32_t bucket = lo + (uint32_t)k;
+            while (i < qi->n &&
+                   (scid_block(qi->entries[i].scid) >> GOSSIP_QUERY_BUCKET_SHIFT) < bucket)
+                i++;
+            b[k] = (uint32_t)i;
+        }
+        qi->buckets = b;
+        qi->n_buckets = nb;
+        qi->first_bucket = lo;
+    }
+    qi->buckets_dirty = 0;
+    return 1;
+}
+
+/* First entry with block >= blocknum.  Buckets fresh, lock held. */
+static size_t range_start(const gossip_query_index_t *qi, uint32_t blocknum)
+{
+    if (!qi->n) return 0;
+    uint32_t bucket = blocknum >> GOSSIP_QUERY_BUCKET_SHIFT;
+    if (bucket < qi->first_bucket) return 0;
+    if (bucket - qi->first_bucket >= qi->n_buckets - 1) return qi->n;
+    size_t i = qi->buckets[bucket - qi->first_bucket];
+    while (i < qi->n && scid_block(qi->entries[i].scid) < blocknum) i++;
+    return i;
+}
+
+/* ---- Public API ---- */
+
+int gossip_query_index_init(gossip_query_index_t *qi)
+{
+    if (!qi) return 0;
+    memset(qi, 0, sizeof(*qi));
+    pthread_mutex_init(&qi->lock, NULL);
+    return 1;
+}
+
+void gossip_query_index_free(gossip_query_index_t *qi)
+{
+    if (!qi) return;
+    free(qi->entries);
+    free(qi->buckets);
+    pthread_mutex_destroy(&qi->lock);
+    memset(qi, 0, sizeof(*qi));
+}
+
+int gossip_query_index_add(gossip_query_index_t *qi, uint64_t scid)
+{
+    if (!qi || !scid) return 0;
+    pthread_mutex_lock(&qi->lock);
+    int ok = entry_add(qi, scid);
+    pthread_mutex_unlock(&qi->lock);
+    return ok;
+}
+
+int gossip_query_index_update(gossip_query_index_t *qi,
+                              const unsigned char *msg, size_t len)
+{
+    if (!qi) return 0;
+    pthread_mutex_lock(&qi->lock);
+    int ok = entry_update(qi, msg, len);
+    pthread_mutex_unlock(&qi->lock);
+    return ok;
+}
+
+int gossip_query_index_remove(gossip_query_index_t *qi, uint64_t scid)
+{
+    if (!qi) return 0;
+    pthread_mutex_lock(&qi->lock);
+    size_t i = lower_bound(qi, scid);
+    int found = i < qi->n && qi->entries[i].scid == scid;
+    if (found) {
+        memmove(&qi->entries[i], &qi->entries[i + 1],
+                (qi->n - i - 1) * sizeof(*qi->entries));
+        qi->n--;
+        qi->buckets_dirty = 1;
+    }
+    pthread_mutex_unlock(&qi->lock);
+    return found;
+}
+
+typedef struct {
+    gossip_query_index_t *qi;
+    int                   ok;
+    int                   count;
+} load_ctx_t;
+
+static void load_cb(uint64_t scid, const unsigned char *ann, size_t ann_len,
+                    const unsigned char *const upd[2], const size_t upd_len[2],
+                    void *ud)
+{
+    (void)ann; (void)ann_len;
+    load_ctx_t *lc = (load_ctx_t *)ud;
+    if (!lc->ok) return;
+    if (!entry_add(lc->qi, scid)) {
+        lc->ok = 0;
+        return;
+    }
+    for (int d = 0; d < 2; d++)
+        if (upd[d]) entry_update(lc->qi, upd[d], upd_len[d]);
+    lc->count++;
+}
+
+int gossip_query_index_load_log(gossip_query_index_t *qi, gossip_log_t *gl)
+{
+    if (!qi || !gl) return -1;
+    pthread_mutex_lock(&qi->lock);
+    qi->n = 0;
+    qi->buckets_dirty = 1;
+    load_ctx_t lc = { qi, 1, 0 };
+    gossip_log_channels_in_range(gl, 0, UINT32_MAX, load_cb, &lc);
+    pthread_mutex_unlock(&qi->lock);
+    return lc.ok ? lc.count : -1;
+}
+
+size_t gossip_query_index_count(gossip_query_index_t *qi,
+                                uint32_t first_blocknum, uint32_t num_blocks)
+{
+    if (!qi) return 0;
+    uint64_t end = (uint64_t)first_blocknum + num_blocks;
+    pthread_mutex_lock(&qi->lock);
+    size_t n = 0;
+    if (buckets_refresh(qi)) {
+        size_t i = range_start(qi, first_blocknum);
+        size_t j = end > 0xFFFFFFFFu ? qi->n : range_start(qi, (uint32_t)end);
+        n = j - i;
+    }
+    pthread_mutex_unlock(&qi->lock);
+    return n;
+}
+
+/* ---- Wire ---- */
+
+static size_t put_bigsize(unsigned char *p, uint32_t v)
+{
+    if (v < 0xFD) {
+        p[0] = (unsigned char)v;
+        return 1;
+    }
+    p[0] = 0xFD;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)v;
+    return 3;
+}
+
+/* BigSize at *off; 0 if truncated or wider than 32 bits. */
+static int get_bigsize(const unsigned char *msg, size_t len, size_t *off, uint32_t *v)
+{
+    if (*off >= len) return 0;
+    unsigned char b = msg[(*off)++];
+    if (b < 0xFD) { *v = b; return 1; }
+    size_t w = b == 0xFD ? 2 : b == 0xFE ? 4 : 8;
+    if (w == 8 || *off + w > len) return 0;
+    uint32_t x = 0;
+    for (size_t i = 0; i < w; i++) x = (x << 8) | msg[(*off)++];
+    *v = x;
+    return 1;
+}
+
+int gossip_query_parse_range_options(const unsigned char *msg, size_t len,
+                                     uint32_t *query_option_out)
+{
+    if (!msg || len < 42) return 0;
+    uint32_t opt = 0;
+    size_t off = 42;
+    while (off < len) {
+        uint32_t type, vlen;
+        if (!get_bigsize(msg, len, &off, &type) ||
+            !get_bigsize(msg, len, &off, &vlen) || off + vlen > len)
+            return 0;
+        if (type == 1) {
+            size_t voff = off;
+            if (!get_bigsize(msg, off + vlen, &voff, &opt)) return 0;
+        }
+        off += vlen;
+    }
+    if (query_option_out) *query_option_out = opt;
+    return 1;
+}
+
+/* Encode reply_channel_range for entries [a, b). */
+static size_t encode_reply(unsigned char *out, const unsigned char chain_hash[32],
+                           uint32_t first, uint32_t num,
+                           const gossip_query_entry_t *e, size_t a, size_t b,
+                           uint32_t query_option)
+{
+    size_t n = b - a;
+    out[0] = 0x01; out[1] = 0x08;               /* type 264 */
+    if (chain_hash) memcpy(out + 2, chain_hash, 32);
+    else            memset(out + 2, 0, 32);
+    wr32(out + 34, first);
+    wr32(out + 38, num);
+    out[42] = 1;                                /* sync_complete */
+    uint16_t enc_len = (uint16_t)(1 + 8 * n);
+    out[43] = (unsigned char)(enc_len >> 8);
+    out[44] = (unsigned char)enc_len;
+    out[45] = 0x00;                             /* uncompressed */
+    size_t off = 46;
+    for (size_t i = a; i < b; i++) {
+        wr32(out + off,     (uint32_t)(e[i].scid >> 32));
+        wr32(out + off + 4, (uint32_t)e[i].scid);
+        off += 8;
+    }
+    if (query_option & GOSSIP_QUERY_WANT_TIMESTAMPS) {
+        off += put_bigsize(out + off, 1);
+        off += put_bigsize(out + off, (uint32_t)(1 + 8 * n));
+        out[off++] = 0x00;
+        for (size_t i = a; i < b; i++) {
+            wr32(out + off,     e[i].ts[0]);
+            wr32(out + off + 4, e[i].ts[1]);
+            off += 8;
+        }
+    }
+    if (query_option & GOSSIP_QUERY_WANT_CHECKSUMS) {
+        off += put_bigsize(out + off, 3);
+        off += put_bigsize(out + off, (uint32_t)(8 * n));
+        for (size_t i = a; i < b; i++) {
+            wr32(out + off,     e[i].csum[0]);
+            wr32(out + off + 4, e[i].csum[1]);
+            off += 8;
+        }
+    }
+    return off;
+}
+
+int gossip_query_reply_range(gossip_query_index_t *qi,
+                             const unsigned char chain_hash[32],
+                             uint32_t first_blocknum, uint32_t num_blocks,
+                             uint32_t query_option,
+                             gossip_query_send_fn send, void *ctx)
+{
+    if (!qi || !send) return -1;
+    unsigned char *buf = (unsigned char *)malloc(GOSSIP_QUERY_MAX_MSG);
+    if (!buf) return -1;
+
+    /* Entries per message: scid, plus 8 bytes per requested TLV. */
+    size_t fixed = 46, per = 8;
+    if (query_option & GOSSIP_QUERY_WANT_TIMESTAMPS) { fixed += 1 + 3 + 1; per += 8; }
+    if (query_option & GOSSIP_QUERY_WANT_CHECKSUMS)  { fixed += 1 + 3;     per += 8; }
+    size_t max_n = (GOSSIP_QUERY_MAX_MSG - fixed) / per;
+
+    uint64_t end = (uint64_t)first_blocknum + num_blocks;
+    if (end > 0xFFFFFFFFu) end = 0xFFFFFFFFu;
+
+    pthread_mutex_lock(&qi->lock);
+    int sent = -1;
+    if (buckets_refresh(qi)) {
+        size_t a = range_start(qi, first_blocknum);
+        size_t b = range_start(qi, (uint32_t)end);
+        sent = 0;
+        size_t i = a;
+        do {
+            size_t j = (b - i > max_n) ? i + max_n : b;
+            /* Blocks covered: from the query start (first reply) or this
+             * reply's first scid, through its last scid -- or to the end
+             * of the query for the final reply. */
+            uint32_t first = (i == a) ? first_blocknum
+                                      : scid_block(qi->entries[i].scid);
+            uint64_t stop = (j == b) ? end
+                                     : (uint64_t)scid_block(qi->entries[j - 1].scid) + 1;
+            size_t len = encode_reply(buf, chain_hash, first, (uint32_t)(stop - first),
+                                      qi->entries, i, j, query_option);
+            sent++;
+            qi->n_replies++;
+            if (!send(ctx, buf, len)) break;
+            i = j;
+        } while (i < b);
+    }
+    pthread_mutex_unlock(&qi->lock);
+    free(buf);
+    return sent;
+}
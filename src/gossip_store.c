@@ -109,6 +109,16 @@ void gossip_store_close(gossip_store_t *gs) {
     }
 }
 
+int gossip_store_begin(gossip_store_t *gs) {
+    if (!gs || !gs->db || !sqlite3_get_autocommit(gs->db)) return 0;
+    return run_sql(gs->db, "BEGIN;");
+}
+
+int gossip_store_commit(gossip_store_t *gs) {
+    if (!gs || !gs->db) return 0;
+    return run_sql(gs->db, "COMMIT;");
+}
+
 int gossip_store_upsert_node(gossip_store_t *gs,
                               const unsigned char pubkey33[33],
                               const char *alias,
@@ -683,6 +693,7 @@ int gossip_store_import_rgs(gossip_store_t *gs, const unsigned char *blob, size_
         return -1;
     }
 
+    int txn = gossip_store_begin(gs);
     int imported = 0;
     for (uint32_t i = 0; i < snap.channel_count; i++) {
         const rgs_channel_t *ch = &channels[i];
@@ -708,6 +719,7 @@ int gossip_store_import_rgs(gossip_store_t *gs, const unsigned char *blob, size_
         }
         imported++;
     }
+    if (txn) gossip_store_commit(gs);
     free(nodes);
     free(channels);
     return imported;
@@ -11,14 +11,403 @@
 #include "superscalar/onion.h"
 #include "superscalar/onion_last_hop.h"
 #include "superscalar/noise.h"    /* hmac_sha256 */
+#include <stdlib.h>
 #include <string.h>
 #include <openssl/evp.h>
 
+#define CHUNK_SIZE  (1u << FORWARD_SLAB_CHUNK_SHIFT)
+#define CHUNK_MASK  (CHUNK_SIZE - 1)
+#define NO_SLOT     UINT32_MAX
+
+enum { IDX_IN, IDX_OUT, IDX_HASH };
+
+static size_t mix(uint64_t k, size_t mask)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static size_t pair_pos(uint64_t chan, uint64_t htlc, size_t mask)
+{
+    return mix(chan * 0x9e3779b97f4a7c15ULL ^ htlc, mask);
+}
+
+static size_t hash_pos(const unsigned char h[32], size_t mask)
+{
+    uint64_t k;
+    memcpy(&k, h, 8);
+    return mix(k, mask);
+}
+
+static htlc_forward_entry_t *slot_entry(const htlc_forward_table_t *fwd,
+                                        uint32_t slot)
+{
+    return &fwd->chunks[slot >> FORWARD_SLAB_CHUNK_SHIFT][slot & CHUNK_MASK];
+}
+
+static uint32_t *idx_table(htlc_forward_table_t *fwd, int kind)
+{
+    return kind == IDX_IN ? fwd->idx_in : kind == IDX_OUT ? fwd->idx_out
+                                                          : fwd->idx_hash;
+}
+
+static size_t entry_pos(const htlc_forward_entry_t *e, int kind, size_t mask)
+{
+    switch (kind) {
+    case IDX_IN:  return pair_pos(e->in_chan_id, e->in_htlc_id, mask);
+    case IDX_OUT: return pair_pos(e->out_chan_id, e->out_htlc_id, mask);
+    default:      return hash_pos(e->payment_hash, mask);
+    }
+}
+
+static void idx_insert(htlc_forward_table_t *fwd, int kind, uint32_t slot)
+{
+    uint32_t *t = idx_table(fwd, kind);
+    size_t mask = fwd->idx_cap - 1;
+    size_t i = entry_pos(slot_entry(fwd, slot), kind, mask);
+    while (t[i]) i = (i + 1) & mask;
+    t[i] = slot + 1;
+}
+
+/* Linear probing with backward-shift deletion, so no tombstones build up
+ * under constant add / release churn.  Must run before the key changes. */
+static void idx_remove(htlc_forward_table_t *fwd, int kind, uint32_t slot)
+{
+    uint32_t *t = idx_table(fwd, kind);
+    size_t mask = fwd->idx_cap - 1;
+    size_t i = entry_pos(slot_entry(fwd, slot), kind, mask);
+    while (t[i] != slot + 1) {
+        if (!t[i]) return;
+        i = (i + 1) & mask;
+    }
+    t[i] = 0;
+    for (size_t j = (i + 1) & mask; t[j]; j = (j + 1) & mask) {
+        size_t k = entry_pos(slot_entry(fwd, t[j] - 1), kind, mask);
+        /* t[j] may move into the hole unless its home lies in (i, j] */
+        int stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        t[i] = t[j];
+        t[j] = 0;
+        i = j;
+    }
+}
+
+/* Keep the indexes at most half full for need live entries. */
+static int ensure_index(htlc_forward_table_t *fwd, uint32_t need)
+{
+    if ((size_t)need * 2 <= fwd->idx_cap) return 1;
+    uint32_t cap = fwd->idx_cap ? fwd->idx_cap * 2 : 64;
+    while ((size_t)need * 2 > cap) cap *= 2;
+
+    uint32_t *in = calloc(cap, sizeof(uint32_t));
+    uint32_t *out = calloc(cap, sizeof(uint32_t));
+    uint32_t *hash = calloc(cap, sizeof(uint32_t));
+    if (!in || !out || !hash) {
+        free(in); free(out); free(hash);
+        return 0;
+    }
+    free(fwd->idx_in); free(fwd->idx_out); free(fwd->idx_hash);
+    fwd->idx_in = in;
+    fwd->idx_out = out;
+    fwd->idx_hash = hash;
+    fwd->idx_cap = cap;
+
+    for (uint32_t s = 0; s < fwd->n_slots; s++) {
+        htlc_forward_entry_t *e = slot_entry(fwd, s);
+        if (e->slot == NO_SLOT) continue;
+        idx_insert(fwd, IDX_IN, s);
+        idx_insert(fwd, IDX_HASH, s);
+        if (e->out_indexed) idx_insert(fwd, IDX_OUT, s);
+    }
+    return 1;
+}
+
+static int grow_slab(htlc_forward_table_t *fwd)
+{
+    uint32_t n_chunks = fwd->slot_cap >> FORWARD_SLAB_CHUNK_SHIFT;
+    uint32_t cap = fwd->slot_cap + CHUNK_SIZE;
+
+    htlc_forward_entry_t **chunks = realloc(fwd->chunks,
+                                            (n_chunks + 1) * sizeof(*chunks));
+    if (!chunks) return 0;
+    fwd->chunks = chunks;
+    uint32_t *free_slots = realloc(fwd->free_slots, cap * sizeof(uint32_t));
+    if (!free_slots) return 0;
+    fwd->free_slots = free_slots;
+    uint32_t *expiry = realloc(fwd->expiry, cap * sizeof(uint32_t));
+    if (!expiry) return 0;
+    fwd->expiry = expiry;
+
+    chunks[n_chunks] = calloc(CHUNK_SIZE, sizeof(htlc_forward_entry_t));
+    if (!chunks[n_chunks]) return 0;
+    fwd->slot_cap = cap;
+    return 1;
+}
+
+/* ---- expiry min-heap on in_cltv ---- */
+
+static uint32_t heap_key(const htlc_forward_table_t *fwd, uint32_t i)
+{
+    return slot_entry(fwd, fwd->expiry[i])->in_cltv;
+}
+
+static void heap_set(htlc_forward_table_t *fwd, uint32_t i, uint32_t slot)
+{
+    fwd->expiry[i] = slot;
+    slot_entry(fwd, slot)->heap_pos = i;
+}
+
+static void heap_up(htlc_forward_table_t *fwd, uint32_t i)
+{
+    uint32_t slot = fwd->expiry[i];
+    uint32_t key = slot_entry(fwd, slot)->in_cltv;
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (heap_key(fwd, parent) <= key) break;
+        heap_set(fwd, i, fwd->expiry[parent]);
+        i = parent;
+    }
+    heap_set(fwd, i, slot);
+}
+
+static void heap_down(htlc_forward_table_t *fwd, uint32_t i)
+{
+    uint32_t slot = fwd->expiry[i];
+    uint32_t key = slot_entry(fwd, slot)->in_cltv;
+    for (;;) {
+        uint32_t c = 2 * i + 1;
+        if (c >= fwd->n_expiry) break;
+        if (c + 1 < fwd->n_expiry && heap_key(fwd, c + 1) < heap_key(fwd, c))
+            c++;
+        if (key <= heap_key(fwd, c)) break;
+        heap_set(fwd, i, fwd->expiry[c]);
+        i = c;
+    }
+    heap_set(fwd, i, slot);
+}
+
+static void heap_push(htlc_forward_table_t *fwd, htlc_forward_entry_t *e)
+{
+    uint32_t i = fwd->n_expiry++;
+    heap_set(fwd, i, e->slot);
+    heap_up(fwd, i);
+}
+
+static void heap_remove(htlc_forward_table_t *fwd, htlc_forward_entry_t *e)
+{
+    uint32_t i = e->heap_pos;
+    if (i == NO_SLOT) return;
+    e->heap_pos = NO_SLOT;
+    uint32_t last = --fwd->n_expiry;
+    if (i == last) return;
+    uint32_t moved = fwd->expiry[last];
+    heap_set(fwd, i, moved);
+    heap_down(fwd, i);
+    heap_up(fwd, slot_entry(fwd, moved)->heap_pos);
+}
+
 void htlc_forward_init(htlc_forward_table_t *fwd) {
     if (!fwd) return;
     memset(fwd, 0, sizeof(*fwd));
 }
 
+void htlc_forward_free(htlc_forward_table_t *fwd) {
+    if (!fwd) return;
+    for (uint32_t c = 0; c < (fwd->slot_cap >> FORWARD_SLAB_CHUNK_SHIFT); c++)
+        free(fwd->chunks[c]);
+    free(fwd->chunks);
+    free(fwd->free_slots);
+    free(fwd->idx_in);
+    free(fwd->idx_out);
+    free(fwd->idx_hash);
+    free(fwd->expiry);
+    memset(fwd, 0, sizeof(*fwd));
+}
+
+htlc_forward_entry_t *htlc_forward_add(htlc_forward_table_t *fwd,
+                                       const htlc_forward_entry_t *tmpl) {
+    if (!fwd || !tmpl) return NULL;
+    if (fwd->count >= FORWARD_TABLE_MAX) return NULL;
+    if (!ensure_index(fwd, (uint32_t)fwd->count + 1)) return NULL;
+
+    uint32_t slot;
+    if (fwd->n_free > 0) {
+        slot = fwd->free_slots[--fwd->n_free];
+    } else {
+        if (fwd->n_slots == fwd->slot_cap && !grow_slab(fwd)) return NULL;
+        slot = fwd->n_slots++;
+    }
+
+    htlc_forward_entry_t *e = slot_entry(fwd, slot);
+    memcpy(e, tmpl, sizeof(*e));
+    e->slot        = slot;
+    e->heap_pos    = NO_SLOT;
+    e->out_indexed = 0;
+    idx_insert(fwd, IDX_IN, slot);
+    idx_insert(fwd, IDX_HASH, slot);
+    if (e->state == FORWARD_STATE_INFLIGHT) {
+        idx_insert(fwd, IDX_OUT, slot);
+        e->out_indexed = 1;
+    }
+    if (e->state == FORWARD_STATE_PENDING_OUT) fwd->n_pending++;
+    if (e->state == FORWARD_STATE_PENDING_OUT ||
+        e->state == FORWARD_STATE_INFLIGHT)
+        heap_push(fwd, e);
+    fwd->count++;
+    return e;
+}
+
+htlc_forward_entry_t *htlc_forward_get(htlc_forward_table_t *fwd, uint32_t slot) {
+    if (!fwd || slot >= fwd->n_slots) return NULL;
+    htlc_forward_entry_t *e = slot_entry(fwd, slot);
+    return e->slot == NO_SLOT ? NULL : e;
+}
+
+htlc_forward_entry_t *htlc_forward_find_in(htlc_forward_table_t *fwd,
+                                           uint64_t in_chan_id, uint64_t in_htlc_id) {
+    if (!fwd || !fwd->idx_cap) return NULL;
+    size_t mask = fwd->idx_cap - 1;
+    for (size_t i = pair_pos(in_chan_id, in_htlc_id, mask); fwd->idx_in[i];
+         i = (i + 1) & mask) {
+        htlc_forward_entry_t *e = slot_entry(fwd, fwd->idx_in[i] - 1);
+        if (e->in_chan_id == in_chan_id && e->in_htlc_id == in_htlc_id)
+            return e;
+    }
+    return NULL;
+}
+
+htlc_forward_entry_t *htlc_forward_find_out(htlc_forward_table_t *fwd,
+                                            uint64_t out_chan_id, uint64_t out_htlc_id) {
+    if (!fwd || !fwd->idx_cap) return NULL;
+    size_t mask = fwd->idx_cap - 1;
+    for (size_t i = pair_pos(out_chan_id, out_htlc_id, mask); fwd->idx_out[i];
+         i = (i + 1) & mask) {
+        htlc_forward_entry_t *e = slot_entry(fwd, fwd->idx_out[i] - 1);
+        if (e->out_chan_id == out_chan_id && e->out_htlc_id == out_htlc_id)
+            return e;
+    }
+    return NULL;
+}
+
+size_t htlc_forward_find_by_hash(htlc_forward_table_t *fwd,
+                                 const unsigned char payment_hash[32],
+                                 htlc_forward_entry_t **out, size_t max) {
+    if (!fwd || !payment_hash || !fwd->idx_cap) return 0;
+    size_t mask = fwd->idx_cap - 1, n = 0;
+    for (size_t i = hash_pos(payment_hash, mask); fwd->idx_hash[i] && n < max;
+         i = (i + 1) & mask) {
+        htlc_forward_entry_t *e = slot_entry(fwd, fwd->idx_hash[i] - 1);
+        if (memcmp(e->payment_hash, payment_hash, 32) == 0 && out)
+            out[n++] = e;
+    }
+    return n;
+}
+
+void htlc_forward_set_payment_hash(htlc_forward_table_t *fwd,
+                                   htlc_forward_entry_t *e,
+                                   const unsigned char payment_hash[32]) {
+    if (!fwd || !e || !payment_hash || e->slot == NO_SLOT) return;
+    idx_remove(fwd, IDX_HASH, e->slot);
+    memcpy(e->payment_hash, payment_hash, 32);
+    idx_insert(fwd, IDX_HASH, e->slot);
+}
+
+void htlc_forward_set_inflight(htlc_forward_table_t *fwd,
+                               htlc_forward_entry_t *e,
+                               uint64_t out_chan_id, uint64_t out_htlc_id) {
+    if (!fwd || !e || e->slot == NO_SLOT) return;
+    if (e->out_indexed) idx_remove(fwd, IDX_OUT, e->slot);
+    if (e->state == FORWARD_STATE_PENDING_OUT) fwd->n_pending--;
+    e->out_chan_id = out_chan_id;
+    e->out_htlc_id = out_htlc_id;
+    e->state       = FORWARD_STATE_INFLIGHT;
+    idx_insert(fwd, IDX_OUT, e->slot);
+    e->out_indexed = 1;
+    if (e->heap_pos == NO_SLOT) heap_push(fwd, e);
+}
+
+void htlc_forward_release(htlc_forward_table_t *fwd, htlc_forward_entry_t *e) {
+    if (!fwd || !e || e->slot == NO_SLOT) return;
+    uint32_t slot = e->slot;
+    idx_remove(fwd, IDX_IN, slot);
+    idx_remove(fwd, IDX_HASH, slot);
+    if (e->out_indexed) idx_remove(fwd, IDX_OUT, slot);
+    heap_remove(fwd, e);
+    if (e->state == FORWARD_STATE_PENDING_OUT) fwd->n_pending--;
+    e->out_indexed = 0;
+    e->slot = NO_SLOT;
+    fwd->free_slots[fwd->n_free++] = slot;
+    fwd->count--;
+}
+
+uint32_t htlc_forward_next_expiry(const htlc_forward_table_t *fwd) {
+    if (!fwd || fwd->n_expiry == 0) return 0;
+    return heap_key(fwd, 0);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+size_t htlc_forward_expire(htlc_forward_table_t *fwd, uint32_t height,
+                           htlc_forward_expire_fn fn, void *ctx) {
+    if (!fwd || fwd->n_pending == 0 || fwd->n_expiry == 0 ||
+        heap_key(fwd, 0) > height)
+        return 0;
+
+    /* Walk the heap below height (in-flight entries stay in it, so it is
+       not simply popped), collecting (in_cltv, slot) of pending ones */
+    uint32_t *stack = malloc(fwd->n_expiry * sizeof(uint32_t));
+    uint64_t *due = malloc((size_t)fwd->n_pending * sizeof(uint64_t));
+    if (!stack || !due) {
+        free(stack);
+        free(due);
+        return 0;
+    }
+    size_t n_stack = 0, n_due = 0;
+    stack[n_stack++] = 0;
+    while (n_stack > 0) {
+        uint32_t i = stack[--n_stack];
+        if (heap_key(fwd, i) > height) continue;
+        uint32_t slot = fwd->expiry[i];
+        if (slot_entry(fwd, slot)->state == FORWARD_STATE_PENDING_OUT)
+            due[n_due++] = (uint64_t)heap_key(fwd, i) << 32 | slot;
+        for (uint32_t c = 2 * i + 1; c <= 2 * i + 2 && c < fwd->n_expiry; c++)
+            stack[n_stack++] = c;
+    }
+    free(stack);
+    qsort(due, n_due, sizeof(uint64_t), cmp_u64);
+
+    for (size_t k = 0; k < n_due; k++) {
+        htlc_forward_entry_t *e = slot_entry(fwd, (uint32_t)due[k]);
+        fwd->n_pending--;
+        e->state = FORWARD_STATE_FAILED;
+        if (fn) fn(ctx, e);
+        htlc_forward_release(fwd, e);   /* no-op if fn released it */
+    }
+    free(due);
+    return n_due;
+}
+
+/* Resolve the in-flight HTLC on (out_chan_id, out_htlc_id): it leaves the
+ * outgoing index and the expiry heap but stays stored for the caller. */
+static htlc_forward_entry_t *resolve_out(htlc_forward_table_t *fwd,
+                                         uint64_t out_htlc_id, uint64_t out_chan_id,
+                                         htlc_forward_state_t state)
+{
+    htlc_forward_entry_t *e = htlc_forward_find_out(fwd, out_chan_id, out_htlc_id);
+    if (!e || e->state != FORWARD_STATE_INFLIGHT) return NULL;
+    idx_remove(fwd, IDX_OUT, e->slot);
+    e->out_indexed = 0;
+    heap_remove(fwd, e);
+    e->state = state;
+    return e;
+}
+
 int htlc_forward_process(htlc_forward_table_t *fwd,
                           mpp_table_t *mpp,
                           const unsigned char our_privkey[32],
@@ -28,21 +417,34 @@ int htlc_forward_process(htlc_forward_table_t *fwd,
                           uint64_t amount_msat, uint32_t cltv,
                           htlc_forward_entry_t *out) {
     if (!fwd || !our_privkey || !ctx || !onion || !out) return FORWARD_FAIL;
-    if (fwd->count >= FORWARD_TABLE_MAX) return FORWARD_FAIL;
 
-    /* Peel one onion layer */
+    /* Peel one onion layer, keeping the shared secret for error
+       re-encryption */
     unsigned char next_onion[ONION_PACKET_SIZE];
     onion_hop_payload_t payload;
     int is_final = 0;
+    unsigned char ss[32];
 
-    if (!onion_peel(our_privkey, ctx, onion, next_onion, &payload, &is_final))
+    if (!onion_peel_ex(our_privkey, ctx, NULL, onion, next_onion, &payload,
+                       &is_final, ss))
         return FORWARD_FAIL;
 
-    /* Derive shared secret for this hop (for error re-encryption) */
-    unsigned char ss[32];
-    const unsigned char *eph_pub33 = onion + 1;
-    if (!onion_ecdh_shared_secret(ctx, our_privkey, eph_pub33, ss))
-        return FORWARD_FAIL;
+    return htlc_forward_process_peeled(fwd, mpp, next_onion, &payload,
+                                       is_final, ss, in_htlc_id, in_chan_id,
+                                       amount_msat, cltv, out);
+}
+
+int htlc_forward_process_peeled(htlc_forward_table_t *fwd,
+                                mpp_table_t *mpp,
+                                const unsigned char next_onion[ONION_PACKET_SIZE],
+                                const onion_hop_payload_t *peeled,
+                                int is_final,
+                                const unsigned char ss[32],
+                                uint64_t in_htlc_id, uint64_t in_chan_id,
+                                uint64_t amount_msat, uint32_t cltv,
+                                htlc_forward_entry_t *out) {
+    if (!fwd || !next_onion || !peeled || !ss || !out) return FORWARD_FAIL;
+    onion_hop_payload_t payload = *peeled;
 
     if (is_final) {
         /* Final hop: feed into MPP table */
@@ -52,24 +454,24 @@ int htlc_forward_process(htlc_forward_table_t *fwd,
                          payload.total_msat, cltv);
         }
 
-        /* Record in forward table as settled immediately */
-        htlc_forward_entry_t *e = &fwd->entries[fwd->count++];
-        memset(e, 0, sizeof(*e));
-        e->in_htlc_id    = in_htlc_id;
-        e->in_chan_id     = in_chan_id;
-        e->out_htlc_id   = 0;
-        e->out_chan_id    = 0;
-        e->in_amount_msat = amount_msat;
-        e->out_amount_msat = amount_msat;
-        e->in_cltv       = cltv;
-        e->state         = FORWARD_STATE_SETTLED;
-        memcpy(e->onion_shared_secret, ss, 32);
+        /* Settled on arrival; handed to the caller, not kept in the table */
+        htlc_forward_entry_t fe;
+        memset(&fe, 0, sizeof(fe));
+        fe.in_htlc_id      = in_htlc_id;
+        fe.in_chan_id      = in_chan_id;
+        fe.in_amount_msat  = amount_msat;
+        fe.out_amount_msat = amount_msat;
+        fe.in_cltv         = cltv;
+        fe.state           = FORWARD_STATE_SETTLED;
+        fe.slot            = NO_SLOT;
+        fe.heap_pos        = NO_SLOT;
+        memcpy(fe.onion_shared_secret, ss, 32);
         if (payload.has_payment_data) {
-            memcpy(e->payment_secret,  payload.payment_secret, 32);
-            e->has_payment_secret = 1;
+            memcpy(fe.payment_secret,  payload.payment_secret, 32);
+            fe.has_payment_secret = 1;
         }
         if (payload.has_amt)
-            memcpy(out, e, sizeof(*e));
+            memcpy(out, &fe, sizeof(fe));
         return FORWARD_FINAL;
     }
 
@@ -95,87 +497,99 @@ int htlc_forward_process(htlc_forward_table_t *fwd,
     /* For relay, we have the outgoing amount from payload.amt_to_forward */
     if (!payload.has_amt || !payload.has_cltv) return FORWARD_FAIL;
 
-    htlc_forward_entry_t *e = &fwd->entries[fwd->count++];
-    memset(e, 0, sizeof(*e));
-    e->in_htlc_id     = in_htlc_id;
-    e->in_chan_id      = in_chan_id;
-    e->out_htlc_id    = 0;  /* set when add_htlc succeeds */
-    e->out_chan_id     = 0;  /* derived from scid */
-    e->in_amount_msat  = amount_msat;
-    e->out_amount_msat = payload.amt_to_forward;
-    e->in_cltv         = cltv;
-    e->out_cltv        = payload.outgoing_cltv_value;
-    e->state           = FORWARD_STATE_PENDING_OUT;
-    memcpy(e->onion_shared_secret, ss, 32);
+    htlc_forward_entry_t fe;
+    memset(&fe, 0, sizeof(fe));
+    fe.in_htlc_id      = in_htlc_id;
+    fe.in_chan_id      = in_chan_id;
+    fe.out_htlc_id     = 0;  /* set when add_htlc succeeds */
+    fe.out_chan_id     = 0;  /* derived from scid */
+    fe.in_amount_msat  = amount_msat;
+    fe.out_amount_msat = payload.amt_to_forward;
+    fe.in_cltv         = cltv;
+    fe.out_cltv        = payload.outgoing_cltv_value;
+    fe.state           = FORWARD_STATE_PENDING_OUT;
+    memcpy(fe.onion_shared_secret, ss, 32);
     /* Phase N: store peeled onion for relay pump */
-    memcpy(e->next_onion, next_onion, ONION_PACKET_SIZE);
+    memcpy(fe.next_onion, next_onion, ONION_PACKET_SIZE);
     /* Phase N: set next_hop_scid from TLV type 6 if present */
     if (payload.has_scid)
-        e->next_hop_scid = payload.short_channel_id;
+        fe.next_hop_scid = payload.short_channel_id;
+
+    htlc_forward_entry_t *e = htlc_forward_add(fwd, &fe);
+    if (!e) return FORWARD_FAIL;
 
     if (out) memcpy(out, e, sizeof(*e));
     return FORWARD_RELAY;
 }
 
-void htlc_forward_settle(htlc_forward_table_t *fwd,
-                          uint64_t out_htlc_id, uint64_t out_chan_id,
-                          const unsigned char preimage[32]) {
-    if (!fwd || !preimage) return;
-    for (int i = 0; i < fwd->count; i++) {
-        htlc_forward_entry_t *e = &fwd->entries[i];
-        if (e->out_htlc_id == out_htlc_id &&
-            e->out_chan_id  == out_chan_id &&
-            e->state == FORWARD_STATE_INFLIGHT) {
-            e->state = FORWARD_STATE_SETTLED;
-            /* Preimage is propagated back; caller sends update_fulfill_htlc
-               on the inbound channel using e->in_htlc_id, e->in_chan_id */
-            (void)preimage; /* caller handles actual channel update */
-            return;
+htlc_forward_entry_t *htlc_forward_settle(htlc_forward_table_t *fwd,
+                                          uint64_t out_htlc_id, uint64_t out_chan_id,
+                                          const unsigned char preimage[32]) {
+    if (!fwd || !preimage) return NULL;
+    /* Preimage is propagated back; caller sends update_fulfill_htlc
+       on the inbound channel using e->in_htlc_id, e->in_chan_id */
+    return resolve_out(fwd, out_htlc_id, out_chan_id, FORWARD_STATE_SETTLED);
+}
+
+/* XOR buf[0..256) with the ChaCha20 stream keyed by ammag for ss */
+static void ammag_xor(const unsigned char ss[32], unsigned char buf[256])
+{
+    unsigned char ammag[32];
+    hmac_sha256(ammag, (const unsigned char *)"ammag", 5, ss, 32);
+    EVP_CIPHER_CTX *evp = EVP_CIPHER_CTX_new();
+    if (evp) {
+        static const unsigned char zero_iv[16] = {0};
+        unsigned char stream[256];
+        unsigned char zeros[256] = {0};
+        int outlen = 0;
+        if (EVP_EncryptInit_ex(evp, EVP_chacha20(), NULL, ammag, zero_iv) == 1 &&
+            EVP_EncryptUpdate(evp, stream, &outlen, zeros, 256) == 1) {
+            for (int k = 0; k < 256; k++)
+                buf[k] ^= stream[k];
         }
+        EVP_CIPHER_CTX_free(evp);
     }
 }
 
-void htlc_forward_fail(htlc_forward_table_t *fwd,
-                        uint64_t out_htlc_id, uint64_t out_chan_id,
-                        const unsigned char *onion_error, size_t err_len,
-                        unsigned char out_error[256]) {
-    if (!fwd) return;
-    for (int i = 0; i < fwd->count; i++) {
-        htlc_forward_entry_t *e = &fwd->entries[i];
-        if (e->out_htlc_id == out_htlc_id &&
-            e->out_chan_id  == out_chan_id &&
-            e->state == FORWARD_STATE_INFLIGHT) {
-            e->state = FORWARD_STATE_FAILED;
-
-            /* Re-encrypt error onion with ammag for this hop's shared secret */
-            if (out_error) {
-                memset(out_error, 0, 256);
-                if (onion_error && err_len > 0) {
-                    size_t copy_len = err_len < 256 ? err_len : 256;
-                    memcpy(out_error, onion_error, copy_len);
-                }
-
-                /* XOR with ChaCha20(ammag, ss) */
-                unsigned char ammag[32];
-                hmac_sha256(ammag,
-                            (const unsigned char *)"ammag", 5,
-                            e->onion_shared_secret, 32);
-                /* Apply ammag stream */
-                EVP_CIPHER_CTX *evp = EVP_CIPHER_CTX_new();
-                if (evp) {
-                    static const unsigned char zero_iv[16] = {0};
-                    unsigned char stream[256];
-                    unsigned char zeros[256] = {0};
-                    int outlen = 0;
-                    if (EVP_EncryptInit_ex(evp, EVP_chacha20(), NULL, ammag, zero_iv) == 1 &&
-                        EVP_EncryptUpdate(evp, stream, &outlen, zeros, 256) == 1) {
-                        for (int k = 0; k < 256; k++)
-                            out_error[k] ^= stream[k];
-                    }
-                    EVP_CIPHER_CTX_free(evp);
-                }
-            }
-            return;
+htlc_forward_entry_t *htlc_forward_fail(htlc_forward_table_t *fwd,
+                                        uint64_t out_htlc_id, uint64_t out_chan_id,
+                                        const unsigned char *onion_error, size_t err_len,
+                                        unsigned char out_error[256]) {
+    if (!fwd) return NULL;
+    htlc_forward_entry_t *e = resolve_out(fwd, out_htlc_id, out_chan_id,
+                                          FORWARD_STATE_FAILED);
+    if (!e) return NULL;
+
+    /* Re-encrypt error onion with ammag for this hop's shared secret */
+    if (out_error) {
+        memset(out_error, 0, 256);
+        if (onion_error && err_len > 0) {
+            size_t copy_len = err_len < 256 ? err_len : 256;
+            memcpy(out_error, onion_error, copy_len);
         }
+        ammag_xor(e->onion_shared_secret, out_error);
     }
+    return e;
+}
+
+int htlc_forward_fail_local(const htlc_forward_entry_t *e,
+                            const unsigned char *failure_msg, size_t len,
+                            unsigned char out_error[256]) {
+    if (!e || !failure_msg || !out_error || len > 224 - 4) return 0;
+
+    /* HMAC(um, payload) || len || failure_msg || pad_len || pad */
+    unsigned char *payload = out_error + 32;
+    memset(out_error, 0, 256);
+    payload[0] = (unsigned char)(len >> 8);
+    payload[1] = (unsigned char)len;
+    memcpy(payload + 2, failure_msg, len);
+    size_t pad = 224 - 4 - len;
+    payload[2 + len] = (unsigned char)(pad >> 8);
+    payload[3 + len] = (unsigned char)pad;
+
+    unsigned char um[32];
+    hmac_sha256(um, (const unsigned char *)"um", 2, e->onion_shared_secret, 32);
+    hmac_sha256(out_error, um, 32, payload, 224);
+    ammag_xor(e->onion_shared_secret, out_error);
+    return 1;
 }
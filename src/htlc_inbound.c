@@ -5,6 +5,7 @@
 #include "superscalar/htlc_inbound.h"
 #include "superscalar/mpp.h"
 #include <string.h>
+#include <time.h>
 
 void htlc_inbound_init(htlc_inbound_table_t *tbl) {
     if (!tbl) return;
@@ -38,8 +39,8 @@ int htlc_inbound_add(htlc_inbound_table_t *tbl,
 
     /* MPP integration: register this part.
      * A total_msat of 0 means single-part (amount == total). */
-    mpp_add_part(&tbl->mpp, payment_secret, htlc_id, amount_msat,
-                 amount_msat, cltv_expiry);
+    mpp_add_part_ex(&tbl->mpp, payment_hash, payment_secret, htlc_id,
+                    amount_msat, amount_msat, cltv_expiry, (uint32_t)time(NULL));
     return 1;
 }
 
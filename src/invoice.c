@@ -4,6 +4,16 @@
  * Generates payment_hash/secret pairs, tracks pending invoices,
  * and redeems them when the final HTLC arrives.
  *
+ * Storage is a growable slot array with a free list.  payment_hash lookups
+ * go through an open-addressing index of slot + 1 with backward-shift
+ * deletion.  Each entry is also linked into one bucket of a hashed timer
+ * wheel (deadline >> INVOICE_WHEEL_TICK_SHIFT), so invoice_expire() only
+ * touches the buckets between the last sweep and now; entries whose
+ * deadline is more than one revolution out simply stay put when visited.
+ *
+ * The public calls lock tbl->lock around static helpers that assume it is
+ * held; invoice_find() and invoice_last() leave locking to the caller.
+ *
  * Reference: CLN lightningd/invoices.c, LND invoices/invoiceregistry.go
  */
 
@@ -38,28 +48,249 @@ void invoice_init(bolt11_invoice_table_t *tbl)
 {
     if (!tbl) return;
     memset(tbl, 0, sizeof(*tbl));
+    pthread_mutex_init(&tbl->lock, NULL);
 }
 
-int invoice_create(bolt11_invoice_table_t *tbl,
-                   secp256k1_context *ctx,
-                   const unsigned char node_privkey[32],
-                   const char *network,
-                   uint64_t amount_msat,
-                   const char *description,
-                   uint32_t expiry_secs,
-                   char *bech32_out, size_t out_cap)
+void invoice_free(bolt11_invoice_table_t *tbl)
 {
-    if (!tbl || !ctx || !node_privkey || !network || !bech32_out) return 0;
-    if (tbl->count >= INVOICE_TABLE_MAX) return 0;
+    if (!tbl) return;
+    free(tbl->entries);
+    free(tbl->free_slots);
+    free(tbl->idx);
+    free(tbl->wheel);
+    pthread_mutex_destroy(&tbl->lock);
+    invoice_init(tbl);
+}
 
-    /* Find a free slot */
-    int slot = -1;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
-        if (!tbl->entries[i].active) { slot = i; break; }
+void invoice_lock(bolt11_invoice_table_t *tbl)
+{
+    if (tbl) pthread_mutex_lock(&tbl->lock);
+}
+
+void invoice_unlock(bolt11_invoice_table_t *tbl)
+{
+    if (tbl) pthread_mutex_unlock(&tbl->lock);
+}
+
+/* ---- payment_hash index ---- */
+
+static size_t hash_pos(const unsigned char h[32], size_t mask)
+{
+    uint64_t k;
+    memcpy(&k, h, 8);
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static void idx_insert(bolt11_invoice_table_t *tbl, uint32_t slot)
+{
+    size_t mask = tbl->idx_cap - 1;
+    size_t i = hash_pos(tbl->entries[slot].payment_hash, mask);
+    while (tbl->idx[i]) i = (i + 1) & mask;
+    tbl->idx[i] = slot + 1;
+}
+
+static void idx_remove(bolt11_invoice_table_t *tbl, uint32_t slot)
+{
+    uint32_t *t = tbl->idx;
+    size_t mask = tbl->idx_cap - 1;
+    size_t i = hash_pos(tbl->entries[slot].payment_hash, mask);
+    while (t[i] != slot + 1) {
+        if (!t[i]) return;
+        i = (i + 1) & mask;
+    }
+    t[i] = 0;
+    for (size_t j = (i + 1) & mask; t[j]; j = (j + 1) & mask) {
+        size_t k = hash_pos(tbl->entries[t[j] - 1].payment_hash, mask);
+        /* t[j] may move into the hole unless its home lies in (i, j] */
+        int stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        t[i] = t[j];
+        t[j] = 0;
+        i = j;
     }
-    if (slot < 0) return 0;
+}
 
+/* Keep the index at most half full for need live entries. */
+static int ensure_index(bolt11_invoice_table_t *tbl, size_t need)
+{
+    if (need * 2 <= tbl->idx_cap) return 1;
+    size_t cap = tbl->idx_cap ? tbl->idx_cap * 2 : 64;
+    while (need * 2 > cap) cap *= 2;
+    uint32_t *idx = calloc(cap, sizeof(uint32_t));
+    if (!idx) return 0;
+    free(tbl->idx);
+    tbl->idx = idx;
+    tbl->idx_cap = cap;
+    for (size_t s = 0; s < tbl->n_slots; s++)
+        if (tbl->entries[s].active) idx_insert(tbl, (uint32_t)s);
+    return 1;
+}
+
+static int grow_slots(bolt11_invoice_table_t *tbl)
+{
+    size_t cap = tbl->cap ? tbl->cap * 2 : 64;
+    bolt11_invoice_entry_t *entries = realloc(tbl->entries, cap * sizeof(*entries));
+    if (!entries) return 0;
+    tbl->entries = entries;
+    uint32_t *free_slots = realloc(tbl->free_slots, cap * sizeof(uint32_t));
+    if (!free_slots) return 0;
+    tbl->free_slots = free_slots;
+    tbl->cap = cap;
+    return 1;
+}
+
+/* ---- expiry wheel ---- */
+
+static uint32_t entry_deadline(const bolt11_invoice_entry_t *e)
+{
+    uint64_t d = (uint64_t)e->created_at + e->expiry;
+    return d > UINT32_MAX ? UINT32_MAX : (uint32_t)d;
+}
+
+static void wheel_insert(bolt11_invoice_table_t *tbl, uint32_t slot)
+{
     bolt11_invoice_entry_t *e = &tbl->entries[slot];
+    uint32_t tick = entry_deadline(e) >> INVOICE_WHEEL_TICK_SHIFT;
+    if (!tbl->wheel_tick) {
+        tbl->wheel_tick = e->created_at >> INVOICE_WHEEL_TICK_SHIFT;
+        if (!tbl->wheel_tick) tbl->wheel_tick = 1;
+    }
+    /* Already behind the sweep: due on the next one */
+    if (tick < tbl->wheel_tick) tick = tbl->wheel_tick;
+    uint32_t *head = &tbl->wheel[tick & (INVOICE_WHEEL_SLOTS - 1)];
+    e->wheel_next = *head;
+    *head = slot + 1;
+}
+
+/* Drop an entry already unlinked from its wheel bucket. */
+static void release_slot(bolt11_invoice_table_t *tbl, uint32_t slot)
+{
+    idx_remove(tbl, slot);
+    tbl->entries[slot].active = 0;
+    tbl->free_slots[tbl->n_free++] = slot;
+    if (tbl->last_slot == slot + 1) tbl->last_slot = 0;
+    tbl->count--;
+}
+
+static bolt11_invoice_entry_t *add_locked(bolt11_invoice_table_t *tbl,
+                                          const bolt11_invoice_entry_t *e)
+{
+    if (tbl->count >= (int)INVOICE_TABLE_MAX) return NULL;
+    if (invoice_find(tbl, e->payment_hash)) return NULL;
+    if (!tbl->wheel) {
+        tbl->wheel = calloc(INVOICE_WHEEL_SLOTS, sizeof(uint32_t));
+        if (!tbl->wheel) return NULL;
+    }
+    if (!ensure_index(tbl, (size_t)tbl->count + 1)) return NULL;
+
+    uint32_t slot;
+    if (tbl->n_free > 0) {
+        slot = tbl->free_slots[--tbl->n_free];
+    } else {
+        if (tbl->n_slots == tbl->cap && !grow_slots(tbl)) return NULL;
+        slot = (uint32_t)tbl->n_slots++;
+    }
+
+    bolt11_invoice_entry_t *dst = &tbl->entries[slot];
+    *dst = *e;
+    dst->active = 1;
+    idx_insert(tbl, slot);
+    wheel_insert(tbl, slot);
+    tbl->last_slot = slot + 1;
+    tbl->count++;
+    return dst;
+}
+
+bolt11_invoice_entry_t *invoice_add(bolt11_invoice_table_t *tbl,
+                                    const bolt11_invoice_entry_t *e)
+{
+    if (!tbl || !e) return NULL;
+    pthread_mutex_lock(&tbl->lock);
+    bolt11_invoice_entry_t *dst = add_locked(tbl, e);
+    pthread_mutex_unlock(&tbl->lock);
+    return dst;
+}
+
+bolt11_invoice_entry_t *invoice_find(bolt11_invoice_table_t *tbl,
+                                     const unsigned char payment_hash[32])
+{
+    if (!tbl || !payment_hash || !tbl->idx_cap) return NULL;
+    size_t mask = tbl->idx_cap - 1;
+    for (size_t i = hash_pos(payment_hash, mask); tbl->idx[i];
+         i = (i + 1) & mask) {
+        bolt11_invoice_entry_t *e = &tbl->entries[tbl->idx[i] - 1];
+        if (e->active && memcmp(e->payment_hash, payment_hash, 32) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+int invoice_get(bolt11_invoice_table_t *tbl,
+                const unsigned char payment_hash[32],
+                bolt11_invoice_entry_t *out)
+{
+    if (!tbl || !out) return 0;
+    pthread_mutex_lock(&tbl->lock);
+    bolt11_invoice_entry_t *e = invoice_find(tbl, payment_hash);
+    if (e) *out = *e;
+    pthread_mutex_unlock(&tbl->lock);
+    return e != NULL;
+}
+
+bolt11_invoice_entry_t *invoice_last(bolt11_invoice_table_t *tbl)
+{
+    if (!tbl || !tbl->last_slot) return NULL;
+    return &tbl->entries[tbl->last_slot - 1];
+}
+
+size_t invoice_expire(bolt11_invoice_table_t *tbl, uint32_t now,
+                      invoice_archive_fn archive, void *ctx)
+{
+    if (!tbl) return 0;
+    pthread_mutex_lock(&tbl->lock);
+    if (!tbl->wheel || !tbl->wheel_tick) {
+        pthread_mutex_unlock(&tbl->lock);
+        return 0;
+    }
+
+    uint32_t now_tick = now >> INVOICE_WHEEL_TICK_SHIFT;
+    uint32_t first = tbl->wheel_tick;
+    /* The current bucket is revisited each sweep: entries can fall due
+     * part-way through a tick, and late inserts are clamped onto it. */
+    uint32_t steps = now_tick > first ? now_tick - first + 1 : 1;
+    if (steps > INVOICE_WHEEL_SLOTS) steps = INVOICE_WHEEL_SLOTS;
+
+    size_t dropped = 0;
+    for (uint32_t k = 0; k < steps; k++) {
+        uint32_t *link = &tbl->wheel[(first + k) & (INVOICE_WHEEL_SLOTS - 1)];
+        while (*link) {
+            uint32_t slot = *link - 1;
+            bolt11_invoice_entry_t *e = &tbl->entries[slot];
+            if (!e->settled && entry_deadline(e) > now) {
+                link = &e->wheel_next;
+                continue;
+            }
+            *link = e->wheel_next;
+            if (archive) archive(ctx, e);
+            release_slot(tbl, slot);
+            dropped++;
+        }
+    }
+    if (now_tick > first) tbl->wheel_tick = now_tick;
+    pthread_mutex_unlock(&tbl->lock);
+    return dropped;
+}
+
+/* Fill a fresh entry with a Level 2 stateless preimage / secret pair. */
+static int invoice_new_entry(bolt11_invoice_entry_t *e,
+                             const unsigned char node_privkey[32],
+                             uint64_t amount_msat,
+                             const char *description,
+                             uint32_t expiry_secs)
+{
     memset(e, 0, sizeof(*e));
 
     /* Level 2 stateless: generate nonce, derive preimage + secret deterministically.
@@ -87,10 +318,16 @@ int invoice_create(bolt11_invoice_table_t *tbl,
         strncpy(e->description, description, sizeof(e->description) - 1);
         e->description[sizeof(e->description) - 1] = '\0';
     }
+    return 1;
+}
 
-    /* Build and encode the BOLT #11 invoice */
-    bolt11_invoice_t inv;
-    memset(&inv, 0, sizeof(inv));
+/* BOLT #11 fields common to every invoice we issue for entry e. */
+static void invoice_fill_bolt11(bolt11_invoice_t *inv,
+                                const bolt11_invoice_entry_t *e,
+                                const char *network,
+                                const char *description)
+{
+    memset(inv, 0, sizeof(*inv));
 
     /* Network prefix */
     const char *pfx = "bcrt";  /* default regtest */
@@ -98,37 +335,43 @@ int invoice_create(bolt11_invoice_table_t *tbl,
     else if (strcmp(network, "testnet") == 0) pfx = "tb";
     else if (strcmp(network, "signet") == 0)  pfx = "tbs";
     else if (strcmp(network, "testnet4") == 0) pfx = "tb";
-    strncpy(inv.network, pfx, sizeof(inv.network) - 1);
+    strncpy(inv->network, pfx, sizeof(inv->network) - 1);
 
-    inv.amount_msat = amount_msat;
-    inv.has_amount  = (amount_msat > 0);
-    inv.timestamp   = e->created_at;
-    inv.expiry      = e->expiry;
-    inv.min_final_cltv_expiry = 18;
-    memcpy(inv.payment_hash,   e->payment_hash,   32);
-    memcpy(inv.payment_secret, e->payment_secret, 32);
-    inv.has_payment_secret = 1;
+    inv->amount_msat = e->amount_msat;
+    inv->has_amount  = (e->amount_msat > 0);
+    inv->timestamp   = e->created_at;
+    inv->expiry      = e->expiry;
+    inv->min_final_cltv_expiry = 18;
+    memcpy(inv->payment_hash,   e->payment_hash,   32);
+    memcpy(inv->payment_secret, e->payment_secret, 32);
+    inv->has_payment_secret = 1;
 
     /* Level 2: embed nonce in BOLT #11 metadata (tagged field type 27) */
-    memcpy(inv.metadata, e->stateless_nonce, 32);
-    inv.metadata_len = 32;
-    inv.has_metadata = 1;
+    memcpy(inv->metadata, e->stateless_nonce, 32);
+    inv->metadata_len = 32;
+    inv->has_metadata = 1;
 
     if (description) {
-        strncpy(inv.description, description,
-                sizeof(inv.description) - 1);
+        strncpy(inv->description, description,
+                sizeof(inv->description) - 1);
     }
 
     /* Mandatory BOLT #11 v1.1 features */
-    inv.features = (1 << BOLT11_FEATURE_PAYMENT_SECRET);
-
-    if (!bolt11_encode(&inv, node_privkey, ctx, bech32_out, out_cap)) {
-        e->active = 0;
-        return 0;
-    }
+    inv->features = (1 << BOLT11_FEATURE_PAYMENT_SECRET);
+}
 
-    tbl->count++;
-    return 1;
+int invoice_create(bolt11_invoice_table_t *tbl,
+                   secp256k1_context *ctx,
+                   const unsigned char node_privkey[32],
+                   const char *network,
+                   uint64_t amount_msat,
+                   const char *description,
+                   uint32_t expiry_secs,
+                   char *bech32_out, size_t out_cap)
+{
+    return invoice_create_ex(tbl, ctx, node_privkey, network,
+                             amount_msat, description, expiry_secs,
+                             NULL, 0, 0, 0, 0, bech32_out, out_cap, NULL);
 }
 
 int invoice_create_with_hint(bolt11_invoice_table_t *tbl,
@@ -145,69 +388,56 @@ int invoice_create_with_hint(bolt11_invoice_table_t *tbl,
                               uint16_t hint_cltv_delta,
                               char *bech32_out, size_t out_cap)
 {
-    /* Create the base invoice first (without hint) into a temp buffer */
-    char tmp[512];
-    if (!invoice_create(tbl, ctx, node_privkey, network, amount_msat,
-                        description, expiry_secs, tmp, sizeof(tmp)))
-        return 0;
+    return invoice_create_ex(tbl, ctx, node_privkey, network,
+                             amount_msat, description, expiry_secs,
+                             hint_pubkey, hint_scid, hint_fee_base,
+                             hint_fee_ppm, hint_cltv_delta,
+                             bech32_out, out_cap, NULL);
+}
 
-    /* If no hint requested, just copy and return */
-    if (!hint_pubkey) {
-        strncpy(bech32_out, tmp, out_cap - 1);
-        bech32_out[out_cap - 1] = '\0';
-        return 1;
-    }
+int invoice_create_ex(bolt11_invoice_table_t *tbl,
+                      secp256k1_context *ctx,
+                      const unsigned char node_privkey[32],
+                      const char *network,
+                      uint64_t amount_msat,
+                      const char *description,
+                      uint32_t expiry_secs,
+                      const unsigned char *hint_pubkey,
+                      uint64_t hint_scid,
+                      uint32_t hint_fee_base,
+                      uint32_t hint_fee_ppm,
+                      uint16_t hint_cltv_delta,
+                      char *bech32_out, size_t out_cap,
+                      bolt11_invoice_entry_t *entry_out)
+{
+    if (!tbl || !ctx || !node_privkey || !network || !bech32_out) return 0;
 
-    /* Undo: decrement count since invoice_create already incremented it.
-       We'll re-encode with the hint and the count stays correct. */
-    tbl->count--;
+    bolt11_invoice_entry_t e;
+    if (!invoice_new_entry(&e, node_privkey, amount_msat, description,
+                           expiry_secs))
+        return 0;
 
-    /* Find the entry that was just created (last active slot) */
-    bolt11_invoice_entry_t *e2 = NULL;
-    for (int i = INVOICE_TABLE_MAX - 1; i >= 0; i--) {
-        if (tbl->entries[i].active) { e2 = &tbl->entries[i]; break; }
+    /* Build and encode the BOLT #11 invoice */
+    bolt11_invoice_t inv;
+    invoice_fill_bolt11(&inv, &e, network, description);
+
+    /* Optional route hint for private channels */
+    if (hint_pubkey) {
+        bolt11_route_hint_t *h = &inv.hints[0];
+        memcpy(h->hops[0].pubkey, hint_pubkey, 33);
+        h->hops[0].short_channel_id = hint_scid;
+        h->hops[0].fee_base_msat = hint_fee_base;
+        h->hops[0].fee_ppm = hint_fee_ppm;
+        h->hops[0].cltv_expiry_delta = hint_cltv_delta;
+        h->n_hops = 1;
+        inv.n_hints = 1;
     }
-    if (!e2) return 0;
 
-    /* Build invoice struct directly with hint included */
-    bolt11_invoice_t inv;
-    memset(&inv, 0, sizeof(inv));
-    const char *pfx2 = "bcrt";
-    if (strcmp(network, "mainnet") == 0) pfx2 = "bc";
-    else if (strcmp(network, "testnet") == 0) pfx2 = "tb";
-    else if (strcmp(network, "signet") == 0) pfx2 = "tbs";
-    else if (strcmp(network, "testnet4") == 0) pfx2 = "tb";
-    strncpy(inv.network, pfx2, sizeof(inv.network) - 1);
-    inv.amount_msat = amount_msat;
-    inv.has_amount = (amount_msat > 0);
-    inv.timestamp = e2->created_at;
-    inv.expiry = e2->expiry;
-    inv.min_final_cltv_expiry = 18;
-    memcpy(inv.payment_hash, e2->payment_hash, 32);
-    memcpy(inv.payment_secret, e2->payment_secret, 32);
-    inv.has_payment_secret = 1;
-    memcpy(inv.metadata, e2->stateless_nonce, 32);
-    inv.metadata_len = 32;
-    inv.has_metadata = 1;
-    if (description)
-        strncpy(inv.description, description, sizeof(inv.description) - 1);
-    inv.features = (1 << BOLT11_FEATURE_PAYMENT_SECRET);
-
-    /* Add route hint */
-    bolt11_route_hint_t *h = &inv.hints[0];
-    memcpy(h->hops[0].pubkey, hint_pubkey, 33);
-    h->hops[0].short_channel_id = hint_scid;
-    h->hops[0].fee_base_msat = hint_fee_base;
-    h->hops[0].fee_ppm = hint_fee_ppm;
-    h->hops[0].cltv_expiry_delta = hint_cltv_delta;
-    h->n_hops = 1;
-    inv.n_hints = 1;
-
-    if (!bolt11_encode(&inv, node_privkey, ctx, bech32_out, out_cap)) {
-        e2->active = 0;
+    if (!bolt11_encode(&inv, node_privkey, ctx, bech32_out, out_cap))
         return 0;
-    }
-    tbl->count++;
+
+    if (!invoice_add(tbl, &e)) return 0;
+    if (entry_out) *entry_out = e;
     return 1;
 }
 
@@ -219,39 +449,35 @@ int invoice_claim(bolt11_invoice_table_t *tbl,
     if (!tbl || !payment_hash || !preimage_out) return 0;
 
     uint32_t now = (uint32_t)time(NULL);
+    int ok = 0;
 
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
-        bolt11_invoice_entry_t *e = &tbl->entries[i];
-        if (!e->active) continue;
-        if (memcmp(e->payment_hash, payment_hash, 32) != 0) continue;
+    pthread_mutex_lock(&tbl->lock);
+    bolt11_invoice_entry_t *e = invoice_find(tbl, payment_hash);
+    if (!e) goto out;  /* not found */
 
-        /* Already settled → reject double-claim */
-        if (e->settled) return 0;
+    /* Already settled → reject double-claim */
+    if (e->settled) goto out;
 
-        /* Expired → reject */
-        if (now >= e->created_at + e->expiry) return 0;
+    /* Expired → reject */
+    if (now >= e->created_at + e->expiry) goto out;
 
-        /* Underpayment → reject (unless any-amount invoice) */
-        if (e->amount_msat > 0 && amount_msat < e->amount_msat) return 0;
-
-        /* Success */
-        memcpy(preimage_out, e->preimage, 32);
-        e->settled = 1;
-        return 1;
-    }
+    /* Underpayment → reject (unless any-amount invoice) */
+    if (e->amount_msat > 0 && amount_msat < e->amount_msat) goto out;
 
-    return 0;  /* not found */
+    /* Success */
+    memcpy(preimage_out, e->preimage, 32);
+    e->settled = 1;
+    ok = 1;
+out:
+    pthread_mutex_unlock(&tbl->lock);
+    return ok;
 }
 
 void invoice_settle(bolt11_invoice_table_t *tbl, const unsigned char payment_hash[32])
 {
-    if (!tbl || !payment_hash) return;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
-        bolt11_invoice_entry_t *e = &tbl->entries[i];
-        if (!e->active) continue;
-        if (memcmp(e->payment_hash, payment_hash, 32) == 0) {
-            e->settled = 1;
-            return;
-        }
-    }
+    if (!tbl) return;
+    pthread_mutex_lock(&tbl->lock);
+    bolt11_invoice_entry_t *e = invoice_find(tbl, payment_hash);
+    if (e) e->settled = 1;
+    pthread_mutex_unlock(&tbl->lock);
 }
@@ -34,6 +34,7 @@
 #include "superscalar/sha256.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -52,6 +53,9 @@
 #define MSG_ERROR                  17   /* 0x0011: peer force-closing */
 #define MSG_ONION_MESSAGE        0x0201 /* 513: BOLT #4 onion message */
 
+/* update_add_htlc: type + channel_id + htlc_id + amount + hash + cltv + onion */
+#define ADD_HTLC_MIN_LEN  (2 + 32 + 8 + 8 + 32 + 4 + ONION_PACKET_SIZE)
+
 static uint16_t rd16(const unsigned char *b)
 {
     return ((uint16_t)b[0] << 8) | b[1];
@@ -123,8 +127,70 @@ static void send_channel_data_cb(uint64_t scid,
     }
 }
 
-int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
-                             const unsigned char *msg, size_t msg_len)
+/* Called per-channel from gossip_log_channels_by_scids / _in_range:
+   relays the stored announcement and update(s) as received. */
+static void send_logged_channel_cb(uint64_t scid,
+                                   const unsigned char *ann, size_t ann_len,
+                                   const unsigned char *const upd[2],
+                                   const size_t upd_len[2],
+                                   void *userdata)
+{
+    gossip_send_ctx_t *ctx = (gossip_send_ctx_t *)userdata;
+    ln_dispatch_t *d = ctx->d;
+
+    if (ctx->n_scids < 256)
+        ctx->scids[ctx->n_scids++] = scid;
+
+    if (!d->pmgr || ctx->peer_idx < 0) return;
+    peer_mgr_send(d->pmgr, ctx->peer_idx, ann, ann_len);
+    for (int dir = 0; dir <= 1; dir++)
+        if (upd[dir])
+            peer_mgr_send(d->pmgr, ctx->peer_idx, upd[dir], upd_len[dir]);
+}
+
+typedef struct {
+    ln_dispatch_t *d;
+    int            peer_idx;
+} range_reply_ctx_t;
+
+static int send_range_reply_cb(void *ctx, const unsigned char *msg, size_t len)
+{
+    range_reply_ctx_t *rc = (range_reply_ctx_t *)ctx;
+    if (!rc->d->pmgr || rc->peer_idx < 0) return 0;
+    return peer_mgr_send(rc->d->pmgr, rc->peer_idx, msg, len);
+}
+
+/* Release a resolved forward and return its circuit breaker charge to the
+ * peer and channel it was taken from. */
+static void release_forward(ln_dispatch_t *d, htlc_forward_entry_t *fe)
+{
+    if (d->cb && fe->cb_charged)
+        circuit_breaker_record_settled_ex(d->cb, fe->cb_peer, fe->cb_scid,
+                                          fe->in_amount_msat,
+                                          (uint32_t)time(NULL));
+    fe->cb_charged = 0;
+    htlc_forward_release(d->fwd, fe);
+}
+
+/* Fail a forward back on its inbound HTLC with our own failure message
+ * (BOLT #4), then release it. */
+static void fail_forward_back(ln_dispatch_t *d, htlc_forward_entry_t *fe,
+                              const unsigned char *failure_msg, size_t len)
+{
+    unsigned char err[256];
+    if (d->pmgr && htlc_forward_fail_local(fe, failure_msg, len, err))
+        htlc_commit_send_fail(d->pmgr, (int)fe->in_chan_id, fe->in_channel_id,
+                              fe->in_htlc_id, err, sizeof(err));
+    release_forward(d, fe);
+}
+
+/*
+ * Dispatch one message.  peeled, if not NULL, is the update_add_htlc
+ * onion already run through d->onion_proc.
+ */
+static int dispatch_msg(ln_dispatch_t *d, int peer_idx,
+                        const unsigned char *msg, size_t msg_len,
+                        const onion_peel_job_t *peeled)
 {
     if (!d || !msg || msg_len < 2) return -1;
 
@@ -139,7 +205,7 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
          *   payment_hash(32) + cltv_expiry(4) + onion(1366) = 1452 bytes total
          *   (excluding 2-byte type prefix → payload starts at msg+2)
          */
-        if (msg_len < 2 + 32 + 8 + 8 + 32 + 4 + ONION_PACKET_SIZE) {
+        if (msg_len < ADD_HTLC_MIN_LEN) {
             fprintf(stderr, "ln_dispatch: update_add_htlc too short (%zu)\n", msg_len);
             return -1;
         }
@@ -151,14 +217,68 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         uint32_t cltv        = rd32(p + 80);
         const unsigned char *onion = p + 84;
 
+        onion_peel_job_t job;
+        if (!peeled && d->onion_proc) {
+            job.onion_in    = onion;
+            job.cltv_expiry = cltv;
+            job.htlc_key    = onion_replay_htlc_key(p, htlc_id);
+            onion_proc_peel_batch(d->onion_proc, &job, 1);
+            peeled = &job;
+        }
+
+        /* Replayed onion, or an expiry the replay filter cannot cover */
+        if (peeled && (peeled->result == ONION_PEEL_REPLAY ||
+                       peeled->result == ONION_PEEL_EXPIRY ||
+                       peeled->result == ONION_PEEL_EXPIRY_FAR)) {
+            static const unsigned char temp_node_fail[2] = {0x20, 0x02};
+            static const unsigned char expiry_too_far[2] = {0x00, 0x15};
+            int too_far = peeled->result == ONION_PEEL_EXPIRY_FAR;
+            if (d->pmgr && peer_idx >= 0)
+                htlc_commit_send_fail(d->pmgr, peer_idx, p, htlc_id,
+                                      too_far ? expiry_too_far : temp_node_fail,
+                                      2);
+            return (int)msg_type;
+        }
+
         htlc_forward_entry_t fwd_out;
-        int result = htlc_forward_process(
-            d->fwd, d->mpp, d->our_privkey, d->ctx,
-            onion,
-            htlc_id, (uint64_t)peer_idx,
-            amount_msat, cltv,
-            &fwd_out);
+        int result;
+        if (peeled)
+            result = peeled->result != ONION_PEEL_OK ? FORWARD_FAIL :
+                htlc_forward_process_peeled(
+                    d->fwd, d->mpp, peeled->onion_out, &peeled->payload,
+                    peeled->is_final, peeled->shared_secret,
+                    htlc_id, (uint64_t)peer_idx,
+                    amount_msat, cltv,
+                    &fwd_out);
+        else
+            result = htlc_forward_process(
+                d->fwd, d->mpp, d->our_privkey, d->ctx,
+                onion,
+                htlc_id, (uint64_t)peer_idx,
+                amount_msat, cltv,
+                &fwd_out);
 
+        /* Circuit breaker: charge the inbound peer and outgoing channel.
+           The entry records whom, as the peer table may shift meanwhile. */
+        if (result == FORWARD_RELAY && d->cb && d->pmgr &&
+            peer_idx >= 0 && peer_idx < d->pmgr->count) {
+            const unsigned char *peer_pk = d->pmgr->peers[peer_idx].pubkey;
+            htlc_forward_entry_t *fe = htlc_forward_get(d->fwd, fwd_out.slot);
+            if (!circuit_breaker_check_add_ex(d->cb, peer_pk,
+                                              fwd_out.next_hop_scid, amount_msat,
+                                              (uint32_t)time(NULL))) {
+                if (fe) htlc_forward_release(d->fwd, fe);
+                static const unsigned char temp_chan_fail[2] = {0x10, 0x07};
+                htlc_commit_send_fail(d->pmgr, peer_idx, p, htlc_id,
+                                      temp_chan_fail, sizeof(temp_chan_fail));
+                return (int)msg_type;
+            }
+            if (fe) {
+                memcpy(fe->cb_peer, peer_pk, 33);
+                fe->cb_scid    = fwd_out.next_hop_scid;
+                fe->cb_charged = 1;
+            }
+        }
 
         /* Phase K / Gap 3: JIT intercept */
         if (result == FORWARD_RELAY && d->jit_pending) {
@@ -181,16 +301,11 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
             const unsigned char *channel_id   = p;      /* p[0..31] */
             const unsigned char *payment_hash = p + 48; /* p[48..79] */
             if (d->invoices) {
-                /* Locate the invoice entry for this payment_hash */
-                bolt11_invoice_entry_t *inv_entry = NULL;
-                for (int _i = 0; _i < d->invoices->count; _i++) {
-                    if (d->invoices->entries[_i].active &&
-                        memcmp(d->invoices->entries[_i].payment_hash,
-                               payment_hash, 32) == 0) {
-                        inv_entry = &d->invoices->entries[_i];
-                        break;
-                    }
-                }
+                /* Copy of the invoice entry for this payment_hash: the
+                 * admin RPC may add invoices while we hold it */
+                bolt11_invoice_entry_t inv;
+                bolt11_invoice_entry_t *inv_entry =
+                    invoice_get(d->invoices, payment_hash, &inv) ? &inv : NULL;
 
                 /* Phase C: verify HMAC-derived payment_secret (stateless Level 1)
                  * Only enforced for invoices created with has_stateless_secret=1. */
@@ -220,7 +335,6 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
                                                       payment_hash,
                                                       fwd_out.payment_secret,
                                                       preimage);
-                    if (claimed) inv_entry->settled = 1;
                 }
 
                 /* Level 1 / stored-preimage fallback */
@@ -261,10 +375,13 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
                                                 0x8003);  /* INVALID_ONION_HMAC */
             }
         }
-        /* Phase N: copy in_channel_id into forward entry */
+        /* Phase N: copy in_channel_id and payment_hash into forward entry */
         if (result == FORWARD_RELAY) {
-            htlc_forward_entry_t *fe = &d->fwd->entries[d->fwd->count - 1];
-            memcpy(fe->in_channel_id, p, 32); /* p[0..31] = channel_id */
+            htlc_forward_entry_t *fe = htlc_forward_get(d->fwd, fwd_out.slot);
+            if (fe) {
+                memcpy(fe->in_channel_id, p, 32); /* p[0..31] = channel_id */
+                htlc_forward_set_payment_hash(d->fwd, fe, p + 48);
+            }
         }
         return (int)msg_type;
     }
@@ -279,7 +396,22 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         uint64_t htlc_id       = rd64(p + 32);
         const unsigned char *preimage = p + 40;
 
-        htlc_forward_settle(d->fwd, htlc_id, (uint64_t)peer_idx, preimage);
+        htlc_forward_entry_t *fe = htlc_forward_settle(d->fwd, htlc_id,
+                                                       (uint64_t)peer_idx, preimage);
+        if (fe) {
+            /* A forward: pass the preimage back on the inbound HTLC */
+            if (d->pmgr)
+                htlc_commit_send_fulfill(d->pmgr, (int)fe->in_chan_id,
+                                         fe->in_channel_id, fe->in_htlc_id,
+                                         preimage);
+            release_forward(d, fe);
+        } else if (d->pay_engine) {
+            /* Not a forward: one of our own payments */
+            unsigned char hash[32];
+            sha256(preimage, 32, hash);
+            payment_engine_on_settle(d->pay_engine, hash, preimage,
+                                     (uint32_t)time(NULL));
+        }
         return (int)msg_type;
     }
 
@@ -296,8 +428,20 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         if (msg_len < (size_t)(2 + 32 + 8 + 2 + reason_len)) return -1;
 
         unsigned char out_error[256];
-        htlc_forward_fail(d->fwd, htlc_id, (uint64_t)peer_idx,
-                          reason, reason_len, out_error);
+        htlc_forward_entry_t *fe = htlc_forward_fail(d->fwd, htlc_id, (uint64_t)peer_idx,
+                                                     reason, reason_len, out_error);
+        if (fe) {
+            /* Pass the re-encrypted error back on the inbound HTLC */
+            if (d->pmgr)
+                htlc_commit_send_fail(d->pmgr, (int)fe->in_chan_id,
+                                      fe->in_channel_id, fe->in_htlc_id,
+                                      out_error, sizeof(out_error));
+            release_forward(d, fe);
+        } else if (d->pay_engine) {
+            /* Not a forward: an attempt of one of our own payments */
+            payment_engine_on_fail_htlc(d->pay_engine, peer_idx, htlc_id,
+                                        reason, reason_len, (uint32_t)time(NULL));
+        }
         return (int)msg_type;
     }
 
@@ -349,8 +493,18 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         if (msg_len >= 2 + 74) {
             const unsigned char *p = msg + 2;
             uint64_t htlc_id = rd64(p + 32);
-            unsigned char out_error[256];
-            htlc_forward_fail(d->fwd, htlc_id, (uint64_t)peer_idx, NULL, 0, out_error);
+            htlc_forward_entry_t *fe = htlc_forward_fail(d->fwd, htlc_id, (uint64_t)peer_idx,
+                                                         NULL, 0, NULL);
+            if (fe) {
+                /* We report it upstream: failure_code || sha256_of_onion */
+                unsigned char failure[2 + 32];
+                memcpy(failure, p + 72, 2);
+                memcpy(failure + 2, p + 40, 32);
+                fail_forward_back(d, fe, failure, sizeof(failure));
+            } else if (d->pay_engine) {
+                payment_engine_on_fail_htlc(d->pay_engine, peer_idx, htlc_id,
+                                            NULL, 0, (uint32_t)time(NULL));
+            }
         }
         return (int)msg_type;
     }
@@ -453,7 +607,7 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         return 0x6F;
     }
     case 261: { /* query_short_channel_ids */
-        if (!d->gs) return 261;
+        if (!d->gs && !d->glog) return 261;
 #define QS_MAX 256
         uint64_t scids[QS_MAX];
         int n = gossip_parse_query_scids(msg, msg_len, NULL, scids, QS_MAX);
@@ -462,7 +616,10 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         gossip_send_ctx_t gctx;
         memset(&gctx, 0, sizeof(gctx));
         gctx.d = d; gctx.peer_idx = peer_idx;
-        if (n > 0)
+        if (n > 0 && d->glog)
+            gossip_log_channels_by_scids(d->glog, scids, n,
+                                         send_logged_channel_cb, &gctx);
+        else if (n > 0)
             gossip_store_get_channels_by_scids(d->gs, scids, n,
                                                send_channel_data_cb, &gctx);
         /* reply_short_channel_ids_end: complete=1 */
@@ -477,17 +634,32 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
         return 262;
     }
     case 263: { /* query_channel_range */
-        if (!d->gs) return 263;
+        if (!d->gs && !d->glog && !d->gqi) return 263;
         uint32_t first_block = 0, num_blocks_val = 0;
         unsigned char ch32[32];
         if (!gossip_parse_query_range(msg, msg_len, ch32, &first_block, &num_blocks_val))
             return -1;
+        if (d->gqi) {
+            /* scids (+ timestamps/checksums) only; the peer follows up
+               with query_short_channel_ids for what it lacks. */
+            uint32_t query_option = 0;
+            if (!gossip_query_parse_range_options(msg, msg_len, &query_option))
+                return -1;
+            range_reply_ctx_t rc = { d, peer_idx };
+            gossip_query_reply_range(d->gqi, ch32, first_block, num_blocks_val,
+                                     query_option, send_range_reply_cb, &rc);
+            return 263;
+        }
         /* Collect SCIDs and send channel data for each */
         gossip_send_ctx_t gctx;
         memset(&gctx, 0, sizeof(gctx));
         gctx.d = d; gctx.peer_idx = peer_idx;
-        gossip_store_get_channels_in_range(d->gs, first_block, num_blocks_val,
-                                           send_channel_data_cb, &gctx);
+        if (d->glog)
+            gossip_log_channels_in_range(d->glog, first_block, num_blocks_val,
+                                         send_logged_channel_cb, &gctx);
+        else
+            gossip_store_get_channels_in_range(d->gs, first_block, num_blocks_val,
+                                               send_channel_data_cb, &gctx);
         /* reply_channel_range with the collected SCID list */
         unsigned char reply[1024];
         size_t rlen = gossip_build_reply_range(reply, sizeof(reply),
@@ -833,12 +1005,77 @@ int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
     }
 }
 
+int ln_dispatch_process_msg(ln_dispatch_t *d, int peer_idx,
+                             const unsigned char *msg, size_t msg_len)
+{
+    return dispatch_msg(d, peer_idx, msg, msg_len, NULL);
+}
+
+int ln_dispatch_process_batch(ln_dispatch_t *d, const int *peer_idx,
+                              const unsigned char *const *msgs,
+                              const size_t *msg_lens, size_t n)
+{
+    if (!d || !peer_idx || !msgs || !msg_lens) return 0;
+
+    /* Peel every onion in one go; job_of[i] = job index + 1, 0 = none */
+    onion_peel_job_t *jobs = NULL;
+    size_t *job_of = NULL;
+    size_t n_jobs = 0;
+    if (d->onion_proc && n > 1) {
+        jobs   = malloc(n * sizeof(*jobs));
+        job_of = calloc(n, sizeof(*job_of));
+        if (jobs && job_of) {
+            for (size_t i = 0; i < n; i++) {
+                if (!msgs[i] || msg_lens[i] < ADD_HTLC_MIN_LEN ||
+                    rd16(msgs[i]) != MSG_UPDATE_ADD_HTLC)
+                    continue;
+                jobs[n_jobs].onion_in    = msgs[i] + 2 + 84;
+                jobs[n_jobs].cltv_expiry = rd32(msgs[i] + 2 + 80);
+                jobs[n_jobs].htlc_key    =
+                    onion_replay_htlc_key(msgs[i] + 2, rd64(msgs[i] + 2 + 32));
+                job_of[i] = ++n_jobs;
+            }
+            if (n_jobs)
+                onion_proc_peel_batch(d->onion_proc, jobs, n_jobs);
+        }
+    }
+
+    int processed = 0;
+    for (size_t i = 0; i < n; i++) {
+        const onion_peel_job_t *peeled =
+            (job_of && job_of[i]) ? &jobs[job_of[i] - 1] : NULL;
+        if (dispatch_msg(d, peer_idx[i], msgs[i], msg_lens[i], peeled) >= 0)
+            processed++;
+    }
+    free(jobs);
+    free(job_of);
+    return processed;
+}
+
+/* Receive one message from peer i; on failure mark it for reconnect. */
+static int recv_peer_msg(ln_dispatch_t *d, int i, unsigned char *buf,
+                         size_t cap, size_t *len)
+{
+    *len = cap;
+    if (peer_mgr_recv(d->pmgr, i, buf, len, cap)) return 1;
+    /* Phase O: transient disconnect — retain slot for reconnect */
+    uint32_t backoff = (uint32_t)(5u << (d->pmgr->peers[i].reconnect_attempts < 6
+                                  ? (unsigned)d->pmgr->peers[i].reconnect_attempts : 6u));
+    if (backoff > 300) backoff = 300;
+    peer_mgr_mark_disconnected(d->pmgr, i, backoff);
+    return 0;
+}
+
 void ln_dispatch_run(ln_dispatch_t *d)
 {
     if (!d || !d->pmgr || !d->shutdown_flag) return;
 
     unsigned char msg_buf[2048];
     size_t msg_len;
+    /* With an onion processor, per-peer buffers for batched reads */
+    unsigned char (*batch_buf)[2048] = NULL;
+    if (d->onion_proc)
+        batch_buf = malloc(PEER_MGR_MAX_PEERS * sizeof(*batch_buf));
 
     while (!*d->shutdown_flag) {
         /* Build fd_set from all connected peers */
@@ -870,31 +1107,61 @@ void ln_dispatch_run(ln_dispatch_t *d)
         /* Phase O: reconnect any peers whose backoff timer has expired */
         uint32_t now_ts = (uint32_t)time(NULL);
         peer_mgr_reconnect_all(d->pmgr, d->peer_channels, now_ts);
+        /* Drop expired and settled invoices (ln_invoices keeps them) */
+        if (d->invoices) ln_dispatch_expire_invoices(d, now_ts);
+        /* Drop MPP sets past their timeout; their HTLCs resolve on their own */
+        if (d->mpp) mpp_check_timeouts(d->mpp, now_ts, NULL, 0);
+        /* Send routed payments from the current tip, act on retry delays
+           and timeouts */
+        if (d->pay_engine) {
+            if (d->block_height) d->pay_engine->block_height = *d->block_height;
+            payment_engine_tick(d->pay_engine, now_ts);
+        }
+        /* Fail back forwards whose outgoing peer never came in time */
+        if (d->block_height) ln_dispatch_expire_forwards(d, *d->block_height);
+        /* Forget circuit breaker entries that carry no state */
+        if (d->cb) circuit_breaker_evict_idle(d->cb, now_ts);
         /* Phase P: expire stale payment attempts */
         if (d->payments)
             payment_check_timeouts(d->payments, NULL, d->fwd, d->mpp,
                                     d->pmgr, d->ctx, d->our_privkey, now_ts);
         if (sel <= 0) continue;
 
+        if (batch_buf) {
+            /* One message from each ready peer, onions peeled together */
+            int idx[PEER_MGR_MAX_PEERS];
+            const unsigned char *msgs[PEER_MGR_MAX_PEERS];
+            size_t lens[PEER_MGR_MAX_PEERS];
+            size_t nb = 0;
+            for (int i = 0; i < d->pmgr->count && !*d->shutdown_flag; i++) {
+                int fd = d->pmgr->peers[i].fd;
+                if (fd < 0 || !FD_ISSET(fd, &rfds)) continue;
+                if (!recv_peer_msg(d, i, batch_buf[nb], sizeof(batch_buf[nb]),
+                                   &lens[nb]))
+                    continue;
+                idx[nb]  = i;
+                msgs[nb] = batch_buf[nb];
+                nb++;
+            }
+            if (nb) {
+                ln_dispatch_process_batch(d, idx, msgs, lens, nb);
+                ln_dispatch_flush_relay(d);
+            }
+            continue;
+        }
+
         for (int i = 0; i < d->pmgr->count && !*d->shutdown_flag; i++) {
             int fd = d->pmgr->peers[i].fd;
             if (fd < 0 || !FD_ISSET(fd, &rfds)) continue;
 
-            msg_len = sizeof(msg_buf);
-            int r = peer_mgr_recv(d->pmgr, i, msg_buf, &msg_len, sizeof(msg_buf));
-            if (!r) {
-                /* Phase O: transient disconnect — retain slot for reconnect */
-                uint32_t backoff = (uint32_t)(5u << (d->pmgr->peers[i].reconnect_attempts < 6
-                                              ? (unsigned)d->pmgr->peers[i].reconnect_attempts : 6u));
-                if (backoff > 300) backoff = 300;
-                peer_mgr_mark_disconnected(d->pmgr, i, backoff);
+            if (!recv_peer_msg(d, i, msg_buf, sizeof(msg_buf), &msg_len))
                 continue;
-            }
 
             ln_dispatch_process_msg(d, i, msg_buf, msg_len);
             ln_dispatch_flush_relay(d);
         }
     }
+    free(batch_buf);
 }
 
 /* -----------------------------------------------------------------------
@@ -903,11 +1170,12 @@ void ln_dispatch_run(ln_dispatch_t *d)
 int ln_dispatch_flush_relay(ln_dispatch_t *d)
 {
     if (!d || !d->fwd || !d->pmgr) return 0;
+    if (d->fwd->n_pending == 0) return 0;
     int sent = 0;
 
-    for (int i = 0; i < d->fwd->count; i++) {
-        htlc_forward_entry_t *e = &d->fwd->entries[i];
-        if (e->state != FORWARD_STATE_PENDING_OUT) continue;
+    for (uint32_t s = 0; s < d->fwd->n_slots; s++) {
+        htlc_forward_entry_t *e = htlc_forward_get(d->fwd, s);
+        if (!e || e->state != FORWARD_STATE_PENDING_OUT) continue;
 
         /* Find outbound peer by SCID */
         int out_idx = peer_mgr_find_by_scid(d->pmgr, e->next_hop_scid);
@@ -926,17 +1194,48 @@ int ln_dispatch_flush_relay(ln_dispatch_t *d)
                                            e->next_onion,
                                            &htlc_id_out);
         if (ok) {
-            e->out_htlc_id = htlc_id_out;
-            e->out_chan_id  = e->next_hop_scid;
-            e->state        = FORWARD_STATE_INFLIGHT;
+            /* Keyed by peer, as the fulfill/fail from out_idx will look it up */
+            htlc_forward_set_inflight(d->fwd, e, (uint64_t)out_idx, htlc_id_out);
             sent++;
         } else {
-            e->state = FORWARD_STATE_FAILED;
+            /* Outbound add refused: fail the forward back */
+            static const unsigned char temp_chan_fail[2] = {0x10, 0x07};
+            fail_forward_back(d, e, temp_chan_fail, sizeof(temp_chan_fail));
         }
     }
     return sent;
 }
 
+static void expire_forward_cb(void *ctx, htlc_forward_entry_t *fe)
+{
+    static const unsigned char temp_chan_fail[2] = {0x10, 0x07};
+    fail_forward_back((ln_dispatch_t *)ctx, fe, temp_chan_fail,
+                      sizeof(temp_chan_fail));
+}
+
+/* Settled invoices stay in ln_invoices as the record of payment; an
+   invoice that expired unpaid is deleted, or it would reload every start. */
+static void archive_invoice_cb(void *ctx, const bolt11_invoice_entry_t *e)
+{
+    ln_dispatch_t *d = (ln_dispatch_t *)ctx;
+    if (!e->settled)
+        persist_delete_ln_invoice((persist_t *)d->persist, e->payment_hash);
+}
+
+size_t ln_dispatch_expire_invoices(ln_dispatch_t *d, uint32_t now)
+{
+    if (!d || !d->invoices) return 0;
+    return invoice_expire(d->invoices, now,
+                          d->persist ? archive_invoice_cb : NULL, d);
+}
+
+size_t ln_dispatch_expire_forwards(ln_dispatch_t *d, uint32_t height)
+{
+    if (!d || !d->fwd || height == 0) return 0;
+    return htlc_forward_expire(d->fwd, height + LN_DISPATCH_FORWARD_EXPIRY_MARGIN,
+                               expire_forward_cb, d);
+}
+
 /* -----------------------------------------------------------------------
  * Startup state restore — load persisted invoices into dispatch tables.
  * Called once after d->persist and d->invoices are set, before the loop.
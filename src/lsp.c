@@ -147,11 +147,18 @@ int lsp_accept_clients(lsp_t *lsp) {
 
         /* Rate limiting: check per-IP connection rate */
         {
-            struct sockaddr_in peer;
+            struct sockaddr_storage peer;
             socklen_t peer_len = sizeof(peer);
-            char ip_str[INET_ADDRSTRLEN] = "unknown";
-            if (getpeername(fd, (struct sockaddr *)&peer, &peer_len) == 0)
-                inet_ntop(AF_INET, &peer.sin_addr, ip_str, sizeof(ip_str));
+            char ip_str[INET6_ADDRSTRLEN] = "unknown";
+            if (getpeername(fd, (struct sockaddr *)&peer, &peer_len) == 0) {
+                if (peer.ss_family == AF_INET6)
+                    inet_ntop(AF_INET6,
+                              &((struct sockaddr_in6 *)&peer)->sin6_addr,
+                              ip_str, sizeof(ip_str));
+                else
+                    inet_ntop(AF_INET, &((struct sockaddr_in *)&peer)->sin_addr,
+                              ip_str, sizeof(ip_str));
+            }
 
             if (!rate_limiter_allow(&lsp->rate_limiter, ip_str)) {
                 fprintf(stderr, "LSP: rate limited connection from %s\n", ip_str);
@@ -1367,6 +1374,7 @@ void lsp_cleanup(lsp_t *lsp) {
         lsp->listen_fd = -1;
     }
     factory_free(&lsp->factory);
+    rate_limiter_free(&lsp->rate_limiter);
 }
 
 void lsp_set_expected_bridge_pubkey(lsp_t *lsp, const secp256k1_pubkey *pk) {
@@ -11,31 +11,320 @@ void lsp_channels_set_bridge(lsp_channel_mgr_t *mgr, int bridge_fd) {
     mgr->bridge_fd = bridge_fd;
 }
 
-int lsp_channels_register_invoice(lsp_channel_mgr_t *mgr,
-                                    const unsigned char *payment_hash32,
-                                    const unsigned char *preimage32,
-                                    size_t dest_client, uint64_t amount_msat) {
-    if (dest_client >= mgr->n_channels) return 0;
+/* --- Bridge HTLC origins ---
+ * htlc_origins is a growable array; payment_hash and request_id lookups go
+ * through open-addressing indexes of slot + 1.  Index entries are never
+ * deleted -- a lookup skips slots that are inactive or whose key no longer
+ * matches -- and the indexes are rebuilt from the active origins once half
+ * full.  Slots appended by direct writes (DB recovery) are picked up
+ * lazily from origins_indexed onwards. */
+
+static size_t bridge_mix(uint64_t k, size_t mask) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static size_t bridge_hash_pos(const unsigned char *payment_hash32, size_t mask) {
+    uint64_t k;
+    memcpy(&k, payment_hash32, 8);
+    return bridge_mix(k, mask);
+}
+
+static void bridge_idx_put(uint32_t *t, size_t mask, size_t i, size_t slot) {
+    while (t[i]) i = (i + 1) & mask;
+    t[i] = (uint32_t)slot + 1;
+}
+
+static void origin_idx_add(lsp_channel_mgr_t *mgr, size_t slot) {
+    const htlc_origin_t *o = &mgr->htlc_origins[slot];
+    size_t mask = mgr->origin_idx_cap - 1;
+    bridge_idx_put(mgr->origin_by_hash, mask,
+                   bridge_hash_pos(o->payment_hash, mask), slot);
+    mgr->origin_idx_used++;
+    if (o->request_id) {
+        bridge_idx_put(mgr->origin_by_request, mask,
+                       bridge_mix(o->request_id, mask), slot);
+        mgr->origin_idx_used++;
+    }
+}
+
+static int origin_idx_rebuild(lsp_channel_mgr_t *mgr) {
+    size_t cap = 64;
+    while (cap < 4 * mgr->n_htlc_origins) cap *= 2;
+    uint32_t *by_hash = calloc(cap, sizeof(uint32_t));
+    uint32_t *by_req = calloc(cap, sizeof(uint32_t));
+    if (!by_hash || !by_req) {
+        free(by_hash); free(by_req);
+        return 0;
+    }
+    free(mgr->origin_by_hash);
+    free(mgr->origin_by_request);
+    mgr->origin_by_hash = by_hash;
+    mgr->origin_by_request = by_req;
+    mgr->origin_idx_cap = cap;
+    mgr->origin_idx_used = 0;
+    for (size_t i = 0; i < mgr->n_htlc_origins; i++)
+        if (mgr->htlc_origins[i].active) origin_idx_add(mgr, i);
+    mgr->origins_indexed = mgr->n_htlc_origins;
+    return 1;
+}
+
+/* Bring the indexes up to date; 0 if they could not be allocated. */
+static int origin_idx_sync(lsp_channel_mgr_t *mgr) {
+    if (!mgr->origin_idx_cap ||
+        (mgr->origin_idx_used + 2 * (mgr->n_htlc_origins - mgr->origins_indexed))
+            * 2 > mgr->origin_idx_cap)
+        return origin_idx_rebuild(mgr);
+    for (; mgr->origins_indexed < mgr->n_htlc_origins; mgr->origins_indexed++)
+        if (mgr->htlc_origins[mgr->origins_indexed].active)
+            origin_idx_add(mgr, mgr->origins_indexed);
+    return 1;
+}
+
+htlc_origin_t *lsp_channels_alloc_bridge_origin(lsp_channel_mgr_t *mgr) {
+    if (!mgr) return NULL;
+    if (mgr->n_origin_free == 0 && mgr->n_htlc_origins >= mgr->htlc_origins_cap) {
+        /* Table full: collect inactive slots; grow if under a quarter are */
+        uint32_t *fr = realloc(mgr->origin_free,
+                               (mgr->htlc_origins_cap ? mgr->htlc_origins_cap : 1)
+                               * sizeof(uint32_t));
+        if (!fr) return NULL;
+        mgr->origin_free = fr;
+        for (size_t i = mgr->n_htlc_origins; i-- > 0; )
+            if (!mgr->htlc_origins[i].active)
+                fr[mgr->n_origin_free++] = (uint32_t)i;
+        if (mgr->n_origin_free * 4 < mgr->htlc_origins_cap) {
+            size_t cap = mgr->htlc_origins_cap ? mgr->htlc_origins_cap * 2
+                                               : MAX_HTLC_ORIGINS;
+            htlc_origin_t *grown = realloc(mgr->htlc_origins,
+                                           cap * sizeof(htlc_origin_t));
+            if (!grown) return NULL;
+            memset(grown + mgr->htlc_origins_cap, 0,
+                   (cap - mgr->htlc_origins_cap) * sizeof(htlc_origin_t));
+            mgr->htlc_origins = grown;
+            mgr->htlc_origins_cap = cap;
+            mgr->n_origin_free = 0;
+        }
+    }
+
+    htlc_origin_t *origin = NULL;
+    while (mgr->n_origin_free > 0) {
+        uint32_t i = mgr->origin_free[--mgr->n_origin_free];
+        if (i < mgr->n_htlc_origins && !mgr->htlc_origins[i].active) {
+            origin = &mgr->htlc_origins[i];
+            break;
+        }
+    }
+    if (!origin) {
+        if (mgr->n_htlc_origins >= mgr->htlc_origins_cap) return NULL;
+        origin = &mgr->htlc_origins[mgr->n_htlc_origins++];
+        /* Indexed explicitly by the caller, not by the lazy catch-up */
+        if (mgr->origins_indexed == mgr->n_htlc_origins - 1)
+            mgr->origins_indexed = mgr->n_htlc_origins;
+    }
+    memset(origin, 0, sizeof(*origin));
+    return origin;
+}
+
+void lsp_channels_index_bridge_origin(lsp_channel_mgr_t *mgr,
+                                        htlc_origin_t *origin) {
+    if (!mgr || !origin) return;
+    if (!origin_idx_sync(mgr)) return;
+    if ((mgr->origin_idx_used + 2) * 2 > mgr->origin_idx_cap) {
+        origin_idx_rebuild(mgr);  /* indexes every active origin */
+        return;
+    }
+    origin_idx_add(mgr, (size_t)(origin - mgr->htlc_origins));
+}
+
+htlc_origin_t *lsp_channels_find_bridge_origin(lsp_channel_mgr_t *mgr,
+                                                 const unsigned char *payment_hash32) {
+    if (!mgr || !payment_hash32 || !mgr->n_htlc_origins) return NULL;
+    if (!origin_idx_sync(mgr)) return NULL;
+    size_t mask = mgr->origin_idx_cap - 1;
+    for (size_t i = bridge_hash_pos(payment_hash32, mask); mgr->origin_by_hash[i];
+         i = (i + 1) & mask) {
+        htlc_origin_t *o = &mgr->htlc_origins[mgr->origin_by_hash[i] - 1];
+        if (o->active && memcmp(o->payment_hash, payment_hash32, 32) == 0)
+            return o;
+    }
+    return NULL;
+}
+
+htlc_origin_t *lsp_channels_find_origin_by_request(lsp_channel_mgr_t *mgr,
+                                                     uint64_t request_id) {
+    if (!mgr || !mgr->n_htlc_origins) return NULL;
+    if (!origin_idx_sync(mgr)) return NULL;
+    size_t mask = mgr->origin_idx_cap - 1;
+    for (size_t i = bridge_mix(request_id, mask); mgr->origin_by_request[i];
+         i = (i + 1) & mask) {
+        htlc_origin_t *o = &mgr->htlc_origins[mgr->origin_by_request[i] - 1];
+        if (o->active && o->request_id == request_id)
+            return o;
+    }
+    return NULL;
+}
+
+void lsp_channels_free_bridge_origins(lsp_channel_mgr_t *mgr) {
+    if (!mgr) return;
+    free(mgr->htlc_origins);
+    free(mgr->origin_by_hash);
+    free(mgr->origin_by_request);
+    free(mgr->origin_free);
+    mgr->htlc_origins = NULL;
+    mgr->origin_by_hash = NULL;
+    mgr->origin_by_request = NULL;
+    mgr->origin_free = NULL;
+    mgr->n_htlc_origins = 0;
+    mgr->htlc_origins_cap = 0;
+    mgr->origin_idx_cap = 0;
+    mgr->origin_idx_used = 0;
+    mgr->origins_indexed = 0;
+    mgr->n_origin_free = 0;
+}
+
+/* --- Invoice registry ---
+ * Same layout as the origins: a growable array, a payment_hash index of
+ * slot + 1 validated on lookup, rebuilt once half full, and caught up
+ * lazily for slots appended by direct writes. */
+
+static void invoice_idx_add(lsp_channel_mgr_t *mgr, size_t slot) {
+    size_t mask = mgr->invoice_idx_cap - 1;
+    bridge_idx_put(mgr->invoice_by_hash, mask,
+                   bridge_hash_pos(mgr->invoices[slot].payment_hash, mask), slot);
+    mgr->invoice_idx_used++;
+}
+
+static int invoice_idx_rebuild(lsp_channel_mgr_t *mgr) {
+    size_t cap = 64;
+    while (cap < 4 * mgr->n_invoices) cap *= 2;
+    uint32_t *by_hash = calloc(cap, sizeof(uint32_t));
+    if (!by_hash) return 0;
+    free(mgr->invoice_by_hash);
+    mgr->invoice_by_hash = by_hash;
+    mgr->invoice_idx_cap = cap;
+    mgr->invoice_idx_used = 0;
+    for (size_t i = 0; i < mgr->n_invoices; i++)
+        if (mgr->invoices[i].active) invoice_idx_add(mgr, i);
+    mgr->invoices_indexed = mgr->n_invoices;
+    return 1;
+}
+
+static int invoice_idx_sync(lsp_channel_mgr_t *mgr) {
+    if (!mgr->invoice_idx_cap || mgr->invoices_indexed > mgr->n_invoices ||
+        (mgr->invoice_idx_used + mgr->n_invoices - mgr->invoices_indexed) * 2
+            > mgr->invoice_idx_cap)
+        return invoice_idx_rebuild(mgr);
+    for (; mgr->invoices_indexed < mgr->n_invoices; mgr->invoices_indexed++)
+        if (mgr->invoices[mgr->invoices_indexed].active)
+            invoice_idx_add(mgr, mgr->invoices_indexed);
+    return 1;
+}
+
+invoice_entry_t *lsp_channels_alloc_invoice(lsp_channel_mgr_t *mgr) {
+    if (!mgr) return NULL;
+    if (mgr->n_invoice_free == 0 && mgr->n_invoices >= mgr->invoices_cap) {
+        /* Registry full: collect inactive slots; grow if under a quarter are */
+        uint32_t *fr = realloc(mgr->invoice_free,
+                               (mgr->invoices_cap ? mgr->invoices_cap : 1)
+                               * sizeof(uint32_t));
+        if (!fr) return NULL;
+        mgr->invoice_free = fr;
+        for (size_t i = mgr->n_invoices; i-- > 0; )
+            if (!mgr->invoices[i].active)
+                fr[mgr->n_invoice_free++] = (uint32_t)i;
+        if (mgr->n_invoice_free * 4 < mgr->invoices_cap) {
+            size_t cap = mgr->invoices_cap ? mgr->invoices_cap * 2
+                                           : MAX_INVOICE_REGISTRY;
+            invoice_entry_t *grown = realloc(mgr->invoices,
+                                             cap * sizeof(invoice_entry_t));
+            if (!grown) return NULL;
+            memset(grown + mgr->invoices_cap, 0,
+                   (cap - mgr->invoices_cap) * sizeof(invoice_entry_t));
+            mgr->invoices = grown;
+            mgr->invoices_cap = cap;
+            mgr->n_invoice_free = 0;
+        }
+    }
 
-    /* Reuse an inactive slot first */
     invoice_entry_t *inv = NULL;
-    for (size_t i = 0; i < mgr->n_invoices; i++) {
-        if (!mgr->invoices[i].active) {
+    while (mgr->n_invoice_free > 0) {
+        uint32_t i = mgr->invoice_free[--mgr->n_invoice_free];
+        if (i < mgr->n_invoices && !mgr->invoices[i].active) {
             inv = &mgr->invoices[i];
             break;
         }
     }
-    /* Fall back to appending if no inactive slot */
     if (!inv) {
-        if (mgr->n_invoices >= mgr->invoices_cap) return 0;
+        if (mgr->n_invoices >= mgr->invoices_cap) return NULL;
         inv = &mgr->invoices[mgr->n_invoices++];
+        /* Indexed explicitly by the caller, not by the lazy catch-up */
+        if (mgr->invoices_indexed == mgr->n_invoices - 1)
+            mgr->invoices_indexed = mgr->n_invoices;
+    }
+    memset(inv, 0, sizeof(*inv));
+    return inv;
+}
+
+void lsp_channels_index_invoice(lsp_channel_mgr_t *mgr, invoice_entry_t *inv) {
+    if (!mgr || !inv) return;
+    if (!invoice_idx_sync(mgr)) return;
+    if ((mgr->invoice_idx_used + 1) * 2 > mgr->invoice_idx_cap) {
+        invoice_idx_rebuild(mgr);  /* indexes every active invoice */
+        return;
     }
+    invoice_idx_add(mgr, (size_t)(inv - mgr->invoices));
+}
+
+invoice_entry_t *lsp_channels_find_invoice(lsp_channel_mgr_t *mgr,
+                                             const unsigned char *payment_hash32) {
+    if (!mgr || !payment_hash32 || !mgr->n_invoices) return NULL;
+    if (!invoice_idx_sync(mgr)) return NULL;
+    size_t mask = mgr->invoice_idx_cap - 1;
+    for (size_t i = bridge_hash_pos(payment_hash32, mask); mgr->invoice_by_hash[i];
+         i = (i + 1) & mask) {
+        size_t slot = mgr->invoice_by_hash[i] - 1;
+        if (slot >= mgr->n_invoices) continue;
+        invoice_entry_t *inv = &mgr->invoices[slot];
+        if (inv->active && memcmp(inv->payment_hash, payment_hash32, 32) == 0)
+            return inv;
+    }
+    return NULL;
+}
+
+void lsp_channels_free_invoices(lsp_channel_mgr_t *mgr) {
+    if (!mgr) return;
+    free(mgr->invoices);
+    free(mgr->invoice_by_hash);
+    free(mgr->invoice_free);
+    mgr->invoices = NULL;
+    mgr->invoice_by_hash = NULL;
+    mgr->invoice_free = NULL;
+    mgr->n_invoices = 0;
+    mgr->invoices_cap = 0;
+    mgr->invoice_idx_cap = 0;
+    mgr->invoice_idx_used = 0;
+    mgr->invoices_indexed = 0;
+    mgr->n_invoice_free = 0;
+}
+
+int lsp_channels_register_invoice(lsp_channel_mgr_t *mgr,
+                                    const unsigned char *payment_hash32,
+                                    const unsigned char *preimage32,
+                                    size_t dest_client, uint64_t amount_msat) {
+    if (dest_client >= mgr->n_channels) return 0;
+
+    invoice_entry_t *inv = lsp_channels_alloc_invoice(mgr);
+    if (!inv) return 0;
     memcpy(inv->payment_hash, payment_hash32, 32);
     memcpy(inv->preimage, preimage32, 32);
     inv->dest_client = dest_client;
     inv->amount_msat = amount_msat;
     inv->bridge_htlc_id = 0;
     inv->active = 1;
+    lsp_channels_index_invoice(mgr, inv);
 
     if (mgr->persist)
         persist_save_invoice((persist_t *)mgr->persist, payment_hash32,
@@ -46,54 +335,38 @@ int lsp_channels_register_invoice(lsp_channel_mgr_t *mgr,
 int lsp_channels_lookup_invoice(lsp_channel_mgr_t *mgr,
                                   const unsigned char *payment_hash32,
                                   size_t *dest_client_out) {
-    for (size_t i = 0; i < mgr->n_invoices; i++) {
-        if (!mgr->invoices[i].active) continue;
-        if (memcmp(mgr->invoices[i].payment_hash, payment_hash32, 32) == 0) {
-            *dest_client_out = mgr->invoices[i].dest_client;
-            return 1;
-        }
-    }
-    return 0;
+    invoice_entry_t *inv = lsp_channels_find_invoice(mgr, payment_hash32);
+    if (!inv) return 0;
+    *dest_client_out = inv->dest_client;
+    return 1;
 }
 
-void lsp_channels_track_bridge_origin(lsp_channel_mgr_t *mgr,
-                                        const unsigned char *payment_hash32,
-                                        uint64_t bridge_htlc_id) {
-    /* Reuse an inactive slot first */
-    htlc_origin_t *origin = NULL;
-    for (size_t i = 0; i < mgr->n_htlc_origins; i++) {
-        if (!mgr->htlc_origins[i].active) {
-            origin = &mgr->htlc_origins[i];
-            break;
-        }
-    }
-    if (!origin) {
-        if (mgr->n_htlc_origins >= mgr->htlc_origins_cap) return;
-        origin = &mgr->htlc_origins[mgr->n_htlc_origins++];
-    }
+htlc_origin_t *lsp_channels_track_bridge_origin(lsp_channel_mgr_t *mgr,
+                                                  const unsigned char *payment_hash32,
+                                                  uint64_t bridge_htlc_id) {
+    htlc_origin_t *origin = lsp_channels_alloc_bridge_origin(mgr);
+    if (!origin) return NULL;
     memcpy(origin->payment_hash, payment_hash32, 32);
     origin->bridge_htlc_id = bridge_htlc_id;
     origin->cltv_expiry = 0;
     origin->active = 1;
+    lsp_channels_index_bridge_origin(mgr, origin);
 
     if (mgr->persist)
         persist_save_htlc_origin((persist_t *)mgr->persist, payment_hash32,
                                   bridge_htlc_id, 0, 0, 0);
+    return origin;
 }
 
 uint64_t lsp_channels_get_bridge_origin(lsp_channel_mgr_t *mgr,
                                           const unsigned char *payment_hash32) {
-    for (size_t i = 0; i < mgr->n_htlc_origins; i++) {
-        if (!mgr->htlc_origins[i].active) continue;
-        if (memcmp(mgr->htlc_origins[i].payment_hash, payment_hash32, 32) == 0) {
-            mgr->htlc_origins[i].active = 0;
-            if (mgr->persist)
-                persist_deactivate_htlc_origin((persist_t *)mgr->persist,
-                                                payment_hash32);
-            return mgr->htlc_origins[i].bridge_htlc_id;
-        }
-    }
-    return 0;
+    htlc_origin_t *o = lsp_channels_find_bridge_origin(mgr, payment_hash32);
+    if (!o) return 0;
+    o->active = 0;
+    if (mgr->persist)
+        persist_deactivate_htlc_origin((persist_t *)mgr->persist,
+                                        payment_hash32);
+    return o->bridge_htlc_id;
 }
 
 int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
@@ -243,24 +516,20 @@ int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
         }
 
         /* Track bridge origin for back-propagation (with cltv for timeout) */
-        lsp_channels_track_bridge_origin(mgr, payment_hash, htlc_id);
-        /* Store cltv_expiry and dest info for timeout cleanup.
-           Look up by payment_hash since slot reuse may place it anywhere. */
-        for (size_t oi = 0; oi < mgr->n_htlc_origins; oi++) {
-            htlc_origin_t *org = &mgr->htlc_origins[oi];
-            if (org->active && memcmp(org->payment_hash, payment_hash, 32) == 0) {
-                org->cltv_expiry = cltv_expiry;
-                org->sender_idx = dest_idx;
-                org->sender_htlc_id = dest_htlc_id;
-                /* Re-persist with updated sender/cltv fields so timeout
-                   routing works after crash (the initial persist only
-                   stored bridge_htlc_id with zeroed sender fields) */
-                if (mgr->persist)
-                    persist_save_htlc_origin((persist_t *)mgr->persist,
-                        payment_hash, htlc_id, 0,
-                        dest_idx, dest_htlc_id);
-                break;
-            }
+        htlc_origin_t *org = lsp_channels_track_bridge_origin(mgr, payment_hash,
+                                                               htlc_id);
+        /* Store cltv_expiry and dest info for timeout cleanup */
+        if (org) {
+            org->cltv_expiry = cltv_expiry;
+            org->sender_idx = dest_idx;
+            org->sender_htlc_id = dest_htlc_id;
+            /* Re-persist with updated sender/cltv fields so timeout
+               routing works after crash (the initial persist only
+               stored bridge_htlc_id with zeroed sender fields) */
+            if (mgr->persist)
+                persist_save_htlc_origin((persist_t *)mgr->persist,
+                    payment_hash, htlc_id, 0,
+                    dest_idx, dest_htlc_id);
         }
 
         /* Forward ADD_HTLC to destination client */
@@ -410,13 +679,11 @@ int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
                (unsigned long long)request_id, success);
 
         /* Find the originating HTLC by request_id */
-        for (size_t i = 0; i < mgr->n_htlc_origins; i++) {
-            if (!mgr->htlc_origins[i].active) continue;
-            if (mgr->htlc_origins[i].request_id != request_id) continue;
-
-            size_t client_idx = mgr->htlc_origins[i].sender_idx;
-            uint64_t htlc_id_val = mgr->htlc_origins[i].sender_htlc_id;
-            mgr->htlc_origins[i].active = 0;
+        htlc_origin_t *org = lsp_channels_find_origin_by_request(mgr, request_id);
+        if (org) do {
+            size_t client_idx = org->sender_idx;
+            uint64_t htlc_id_val = org->sender_htlc_id;
+            org->active = 0;
 
             if (client_idx >= mgr->n_channels) break;
             channel_t *ch = &mgr->entries[client_idx].channel;
@@ -515,8 +782,7 @@ int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
                             ch->commitment_number + 1, pcs);
                     memset(pcs, 0, 32);
 
-                    persist_deactivate_htlc_origin(db,
-                        mgr->htlc_origins[i].payment_hash);
+                    persist_deactivate_htlc_origin(db, org->payment_hash);
 
                     if (own_txn) persist_commit(db);
                 }
@@ -541,8 +807,7 @@ int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
                         ch->local_amount, ch->remote_amount,
                         ch->commitment_number);
                     persist_delete_htlc(db, (uint32_t)client_idx, htlc_id_val);
-                    persist_deactivate_htlc_origin(db,
-                        mgr->htlc_origins[i].payment_hash);
+                    persist_deactivate_htlc_origin(db, org->payment_hash);
 
                     if (own_txn) persist_commit(db);
                 }
@@ -550,8 +815,7 @@ int lsp_channels_handle_bridge_msg(lsp_channel_mgr_t *mgr, lsp_t *lsp,
                 printf("LSP: bridge pay failed for client %zu htlc %llu\n",
                        client_idx, (unsigned long long)htlc_id_val);
             }
-            break;
-        }
+        } while (0);
         return 1;
     }
 
@@ -2,6 +2,7 @@
 #include "superscalar/lsp_channels_internal.h"
 #include "superscalar/ceremony.h"
 #include "superscalar/chain_backend.h"
+#include "superscalar/chain_events.h"
 #include "superscalar/factory_recovery.h"
 #include "superscalar/sweeper.h"
 #include "superscalar/jit_channel.h"
@@ -594,14 +595,11 @@ void lsp_channels_cleanup(lsp_channel_mgr_t *mgr) {
             channel_cleanup(&mgr->entries[i].channel);
     }
     free(mgr->entries);
-    free(mgr->invoices);
-    free(mgr->htlc_origins);
+    mpp_free(&mgr->htlc_inbound.mpp);
+    lsp_channels_free_invoices(mgr);
+    lsp_channels_free_bridge_origins(mgr);
     mgr->entries = NULL;
-    mgr->invoices = NULL;
-    mgr->htlc_origins = NULL;
     mgr->n_channels = 0;
-    mgr->n_invoices = 0;
-    mgr->n_htlc_origins = 0;
 }
 
 int lsp_channels_exchange_basepoints(lsp_channel_mgr_t *mgr, lsp_t *lsp) {
@@ -1051,13 +1049,13 @@ static int handle_add_htlc(lsp_channel_mgr_t *mgr, lsp_t *lsp,
         if (!ok) return 0;
 
         /* Track origin for when PAY_RESULT comes back */
-        lsp_channels_track_bridge_origin(mgr, payment_hash, 0);
+        htlc_origin_t *origin = lsp_channels_track_bridge_origin(mgr, payment_hash, 0);
         /* Store request_id + sender info for back-propagation */
-        if (mgr->n_htlc_origins > 0) {
-            htlc_origin_t *origin = &mgr->htlc_origins[mgr->n_htlc_origins - 1];
+        if (origin) {
             origin->request_id = request_id;
             origin->sender_idx = sender_idx;
             origin->sender_htlc_id = new_htlc_id;
+            lsp_channels_index_bridge_origin(mgr, origin);
             /* Persist origin + counter atomically */
             if (mgr->persist) {
                 persist_t *db = (persist_t *)mgr->persist;
@@ -5075,12 +5073,9 @@ static int handle_fulfill_htlc(lsp_channel_mgr_t *mgr, lsp_t *lsp,
     sha256(preimage, 32, payment_hash);
 
     /* Deactivate fulfilled invoice in memory (enables slot reuse) */
-    for (size_t iv = 0; iv < mgr->n_invoices; iv++) {
-        if (mgr->invoices[iv].active &&
-            memcmp(mgr->invoices[iv].payment_hash, payment_hash, 32) == 0) {
-            mgr->invoices[iv].active = 0;
-            break;
-        }
+    {
+        invoice_entry_t *inv = lsp_channels_find_invoice(mgr, payment_hash);
+        if (inv) inv->active = 0;
     }
 
     /* Persist payee balance + deactivate invoice + delete HTLC.
@@ -5614,15 +5609,9 @@ static void replay_pending_htlcs(lsp_channel_mgr_t *mgr, lsp_t *lsp, size_t reco
 
             /* Check if HTLC is already on the dest channel (already forwarded) */
             channel_t *dest_ch = &mgr->entries[reconnected_idx].channel;
-            int already_forwarded = 0;
-            for (size_t dh = 0; dh < dest_ch->n_htlcs; dh++) {
-                if (dest_ch->htlcs[dh].state == HTLC_STATE_ACTIVE &&
-                    memcmp(dest_ch->htlcs[dh].payment_hash, htlc->payment_hash, 32) == 0) {
-                    already_forwarded = 1;
-                    break;
-                }
-            }
-            if (already_forwarded) continue;
+            if (channel_find_htlc_by_hash(dest_ch, htlc->payment_hash, HTLC_OFFERED) ||
+                channel_find_htlc_by_hash(dest_ch, htlc->payment_hash, HTLC_RECEIVED))
+                continue;
 
             /* Forward this HTLC to the reconnected client */
             uint64_t old_dest_local = dest_ch->local_amount;
@@ -7018,6 +7007,15 @@ int lsp_channels_run_daemon_loop(lsp_channel_mgr_t *mgr, lsp_t *lsp,
                         fe->update(fe);
                 }
 
+                /* Deliver new blocks to the chain event bus subscribers */
+                if (mgr->chain_events)
+                    chain_events_poll((chain_events_t *)mgr->chain_events);
+
+                /* Seal the next RGS snapshot once its interval is up */
+                if (mgr->admin_rpc && ((admin_rpc_t *)mgr->admin_rpc)->rgs_server)
+                    rgs_server_tick(((admin_rpc_t *)mgr->admin_rpc)->rgs_server,
+                                    (uint32_t)tnow);
+
                 /* Profit settlement via chain_be (works without watchtower). */
                 if (mgr->economic_mode == ECON_PROFIT_SHARED &&
                     mgr->accumulated_fees_sats > 0 &&
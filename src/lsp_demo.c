@@ -1126,18 +1126,16 @@ int lsp_channels_create_external_invoice(lsp_channel_mgr_t *mgr, lsp_t *lsp,
     /* 4. Forward the just-registered invoice to bridge */
     if (mgr->bridge_fd >= 0) {
         /* Find the invoice entry to get preimage and amount */
-        for (size_t i = 0; i < mgr->n_invoices; i++) {
-            if (!mgr->invoices[i].active) continue;
-            if (memcmp(mgr->invoices[i].payment_hash, payment_hash, 32) == 0) {
-                cJSON *reg = wire_build_bridge_register(
-                    payment_hash, mgr->invoices[i].preimage,
-                    mgr->invoices[i].amount_msat, mgr->invoices[i].dest_client);
-                wire_send(mgr->bridge_fd, MSG_BRIDGE_REGISTER, reg);
-                cJSON_Delete(reg);
-                printf("LSP: forwarded external invoice to bridge (client %zu, %llu msat)\n",
-                       client_idx, (unsigned long long)amount_msat);
-                return 1;
-            }
+        invoice_entry_t *inv = lsp_channels_find_invoice(mgr, payment_hash);
+        if (inv) {
+            cJSON *reg = wire_build_bridge_register(
+                payment_hash, inv->preimage,
+                inv->amount_msat, inv->dest_client);
+            wire_send(mgr->bridge_fd, MSG_BRIDGE_REGISTER, reg);
+            cJSON_Delete(reg);
+            printf("LSP: forwarded external invoice to bridge (client %zu, %llu msat)\n",
+                   client_idx, (unsigned long long)amount_msat);
+            return 1;
         }
         fprintf(stderr, "LSP: invoice registered but not found for bridge forward\n");
         return 0;
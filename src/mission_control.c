@@ -5,34 +5,183 @@
  */
 
 #include "superscalar/mission_control.h"
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
+#define MC_INIT_ENTRIES  64
+
 /* ---- Internal helpers ---- */
 
-static mc_entry_t *find_entry(mc_table_t *mc, uint64_t scid, int direction)
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static size_t key_home(const mc_table_t *mc, uint64_t scid, int direction)
 {
-    for (int i = 0; i < mc->count; i++) {
-        if (mc->entries[i].scid == scid &&
-            mc->entries[i].direction == direction)
-            return &mc->entries[i];
+    uint64_t key = (scid << 1) | (uint64_t)(direction & 1);
+    return (size_t)(mix64(key) & (uint64_t)(mc->n_slots - 1));
+}
+
+/* Slot holding (scid, direction), or -1. */
+static long find_slot(const mc_table_t *mc, uint64_t scid, int direction)
+{
+    if (mc->n_slots == 0) return -1;
+    size_t mask = (size_t)mc->n_slots - 1;
+    for (size_t s = key_home(mc, scid, direction); ; s = (s + 1) & mask) {
+        int32_t i = mc->slots[s];
+        if (i < 0) return -1;
+        if (mc->entries[i].scid == scid && mc->entries[i].direction == direction)
+            return (long)s;
     }
-    return NULL;
 }
 
-/* Evict oldest failure (lowest fail_time) to make room */
-static void evict_oldest(mc_table_t *mc)
+static void slot_insert(mc_table_t *mc, int idx)
+{
+    size_t mask = (size_t)mc->n_slots - 1;
+    size_t s = key_home(mc, mc->entries[idx].scid, mc->entries[idx].direction);
+    while (mc->slots[s] >= 0)
+        s = (s + 1) & mask;
+    mc->slots[s] = idx;
+}
+
+static int slots_rehash(mc_table_t *mc, int n_slots)
+{
+    int32_t *p = (int32_t *)malloc((size_t)n_slots * sizeof(int32_t));
+    if (!p) return 0;
+    free(mc->slots);
+    mc->slots = p;
+    mc->n_slots = n_slots;
+    memset(p, 0xff, (size_t)n_slots * sizeof(int32_t));
+    for (int i = 0; i < mc->count; i++)
+        slot_insert(mc, i);
+    return 1;
+}
+
+/* Backward-shift deletion keeps probe chains intact without tombstones. */
+static void slot_delete(mc_table_t *mc, size_t s)
+{
+    size_t mask = (size_t)mc->n_slots - 1;
+    size_t j = s;
+    for (;;) {
+        j = (j + 1) & mask;
+        int32_t i = mc->slots[j];
+        if (i < 0) break;
+        size_t k = key_home(mc, mc->entries[i].scid, mc->entries[i].direction);
+        if ((j > s && (k <= s || k > j)) || (j < s && k <= s && k > j)) {
+            mc->slots[s] = i;
+            s = j;
+        }
+    }
+    mc->slots[s] = -1;
+}
+
+/* Remove entries[idx]; the last entry moves into its place. */
+static void remove_entry(mc_table_t *mc, int idx)
+{
+    mc_entry_t *e = &mc->entries[idx];
+    slot_delete(mc, (size_t)find_slot(mc, e->scid, e->direction));
+    int last = mc->count - 1;
+    if (idx != last) {
+        long s = find_slot(mc, mc->entries[last].scid, mc->entries[last].direction);
+        mc->entries[idx] = mc->entries[last];
+        mc->slots[s] = idx;
+    }
+    mc->count--;
+}
+
+static uint32_t last_activity(const mc_entry_t *e)
+{
+    uint32_t t = e->fail_time;
+    if (e->success_time > t) t = e->success_time;
+    if (e->liq_min_time > t) t = e->liq_min_time;
+    if (e->liq_max_time > t) t = e->liq_max_time;
+    return t;
+}
+
+/* At capacity: drop expired failures, else the least recently updated entry. */
+static void evict_oldest(mc_table_t *mc, uint32_t now_unix)
 {
     if (mc->count == 0) return;
+    if (mc_prune_stale(mc, now_unix) > 0) return;
     int oldest = 0;
+    uint32_t oldest_t = last_activity(&mc->entries[0]);
     for (int i = 1; i < mc->count; i++) {
-        if (mc->entries[i].fail_time < mc->entries[oldest].fail_time)
-            oldest = i;
+        uint32_t t = last_activity(&mc->entries[i]);
+        if (t < oldest_t) { oldest = i; oldest_t = t; }
     }
-    /* Shift remaining entries down */
-    for (int i = oldest; i < mc->count - 1; i++)
-        mc->entries[i] = mc->entries[i + 1];
-    mc->count--;
+    remove_entry(mc, oldest);
+}
+
+static mc_entry_t *find_or_add(mc_table_t *mc, uint64_t scid, int direction,
+                               uint32_t now_unix)
+{
+    long s = find_slot(mc, scid, direction);
+    if (s >= 0) return &mc->entries[mc->slots[s]];
+
+    if (mc->count >= MC_MAX_ENTRIES)
+        evict_oldest(mc, now_unix);
+    if (mc->count == mc->cap) {
+        int nc = mc->cap ? mc->cap * 2 : MC_INIT_ENTRIES;
+        if (nc > MC_MAX_ENTRIES) nc = MC_MAX_ENTRIES;
+        mc_entry_t *p = (mc_entry_t *)realloc(mc->entries, (size_t)nc * sizeof(*p));
+        if (!p) return NULL;
+        mc->entries = p;
+        mc->cap = nc;
+    }
+    /* Keep the load factor at or below 1/2. */
+    if ((mc->count + 1) * 2 > mc->n_slots) {
+        int ns = mc->n_slots ? mc->n_slots * 2 : MC_INIT_ENTRIES * 2;
+        if (!slots_rehash(mc, ns)) return NULL;
+    }
+
+    int idx = mc->count++;
+    mc_entry_t *e = &mc->entries[idx];
+    memset(e, 0, sizeof(*e));
+    e->scid         = scid;
+    e->direction    = direction;
+    e->liq_max_msat = MC_LIQ_UNKNOWN;
+    slot_insert(mc, idx);
+    return e;
+}
+
+/* ---- Liquidity decay / probability arithmetic (Q16 fixed point) ---- */
+
+static uint32_t age_of(uint32_t then, uint32_t now_unix)
+{
+    return now_unix > then ? now_unix - then : 0;
+}
+
+/* 2^(-age / half-life) in Q16: whole half-lives by shift, chord in between. */
+static uint32_t decay_q16(uint32_t age)
+{
+    uint32_t halvings = age / MC_LIQ_HALF_LIFE_SECS;
+    if (halvings >= 16) return 0;
+    uint32_t r = age % MC_LIQ_HALF_LIFE_SECS;
+    uint64_t v = 65536u >> halvings;
+    return (uint32_t)(v - v * r / (2u * MC_LIQ_HALF_LIFE_SECS));
+}
+
+static uint64_t mul_q16(uint64_t x, uint32_t q)
+{
+    return (x >> 16) * q + (((x & 0xffff) * q) >> 16);
+}
+
+/* log2(x) in Q16 for x >= 1: exponent from clz, mantissa via
+ * log2(1 + f) ~= f + 0.3466 f (1 - f) (error < 0.005).  Cheap enough to
+ * run once per edge per route query. */
+static uint32_t log2_q16(uint64_t x)
+{
+    int e = 63 - __builtin_clzll(x);
+    uint64_t f = (e >= 16) ? (x >> (e - 16)) & 0xffff : (x << (16 - e)) & 0xffff;
+    uint64_t corr = (f * (65536 - f) * 22713u) >> 32;
+    return ((uint32_t)e << 16) + (uint32_t)(f + corr);
 }
 
 /* ---- Public API ---- */
@@ -43,44 +192,61 @@ void mc_init(mc_table_t *mc)
     memset(mc, 0, sizeof(*mc));
 }
 
+void mc_free(mc_table_t *mc)
+{
+    if (!mc) return;
+    free(mc->entries);
+    free(mc->slots);
+    memset(mc, 0, sizeof(*mc));
+}
+
 void mc_record_failure(mc_table_t *mc, uint64_t scid, int direction,
                        uint64_t amount_msat, uint32_t now_unix)
 {
     if (!mc) return;
-    mc_entry_t *e = find_entry(mc, scid, direction);
-    if (!e) {
-        if (mc->count >= MC_MAX_ENTRIES)
-            evict_oldest(mc);
-        e = &mc->entries[mc->count++];
-        memset(e, 0, sizeof(*e));
-        e->scid      = scid;
-        e->direction = direction;
-    }
+    mc_entry_t *e = find_or_add(mc, scid, direction, now_unix);
+    if (!e) return;
     e->fail_time    = now_unix;
     e->fail_count  += 1;
     /* Track the minimum failing amount */
     if (e->min_fail_msat == 0 || amount_msat < e->min_fail_msat)
         e->min_fail_msat = amount_msat;
+
+    /* A fresh failure replaces a looser bound, or one that has mostly
+     * decayed away. */
+    uint64_t upper = amount_msat ? amount_msat - 1 : 0;
+    if (e->liq_max_msat == MC_LIQ_UNKNOWN || upper <= e->liq_max_msat ||
+        age_of(e->liq_max_time, now_unix) >= MC_LIQ_HALF_LIFE_SECS) {
+        e->liq_max_msat = upper;
+        e->liq_max_time = now_unix;
+    }
+    /* Contradicts an earlier success: the old lower bound is out of date. */
+    if (e->liq_min_msat > e->liq_max_msat) {
+        e->liq_min_msat = 0;
+        e->liq_min_time = now_unix;
+    }
 }
 
 void mc_record_success(mc_table_t *mc, uint64_t scid, int direction,
                        uint64_t amount_msat, uint32_t now_unix)
 {
     if (!mc) return;
-    mc_entry_t *e = find_entry(mc, scid, direction);
-    if (!e) {
-        /* No prior failure entry: create one to track success */
-        if (mc->count >= MC_MAX_ENTRIES) return;
-        e = &mc->entries[mc->count++];
-        memset(e, 0, sizeof(*e));
-        e->scid      = scid;
-        e->direction = direction;
-    }
-    (void)amount_msat;
+    mc_entry_t *e = find_or_add(mc, scid, direction, now_unix);
+    if (!e) return;
     e->success_time = now_unix;
     e->fail_count   = 0;
     /* Reset min_fail_msat so future failures start fresh */
     e->min_fail_msat = 0;
+
+    if (amount_msat >= e->liq_min_msat ||
+        age_of(e->liq_min_time, now_unix) >= MC_LIQ_HALF_LIFE_SECS) {
+        e->liq_min_msat = amount_msat;
+        e->liq_min_time = now_unix;
+    }
+    if (e->liq_max_msat != MC_LIQ_UNKNOWN && e->liq_max_msat < amount_msat) {
+        e->liq_max_msat = MC_LIQ_UNKNOWN;
+        e->liq_max_time = now_unix;
+    }
 }
 
 int mc_is_penalized(const mc_table_t *mc, uint64_t scid, int direction,
@@ -133,9 +299,7 @@ int mc_prune_stale(mc_table_t *mc, uint32_t now_unix)
                       ((now_unix - e->fail_time) >= MC_DECAY_SECS);
         /* Prune if: expired AND no success after failure (or no success ever) */
         if (expired && (e->success_time <= e->fail_time)) {
-            for (int j = i; j < mc->count - 1; j++)
-                mc->entries[j] = mc->entries[j + 1];
-            mc->count--;
+            remove_entry(mc, i);   /* entry i is now the former last one */
             removed++;
         } else {
             i++;
@@ -147,10 +311,82 @@ int mc_prune_stale(mc_table_t *mc, uint32_t now_unix)
 const mc_entry_t *mc_find(const mc_table_t *mc, uint64_t scid, int direction)
 {
     if (!mc) return NULL;
-    for (int i = 0; i < mc->count; i++) {
-        if (mc->entries[i].scid == scid &&
-            mc->entries[i].direction == direction)
-            return &mc->entries[i];
+    long s = find_slot(mc, scid, direction);
+    return s >= 0 ? &mc->entries[mc->slots[s]] : NULL;
+}
+
+/* Decayed [lo, hi] of an entry for a channel of capacity cap. */
+static void entry_bounds(const mc_entry_t *e, uint64_t cap, uint32_t now_unix,
+                         uint64_t *lo_out, uint64_t *hi_out)
+{
+    uint64_t lo = mul_q16(e->liq_min_msat, decay_q16(age_of(e->liq_min_time, now_unix)));
+    uint64_t hi = cap;
+    if (e->liq_max_msat != MC_LIQ_UNKNOWN && e->liq_max_msat < cap)
+        hi = cap - mul_q16(cap - e->liq_max_msat,
+                           decay_q16(age_of(e->liq_max_time, now_unix)));
+    if (lo > hi) lo = hi;
+    *lo_out = lo;
+    *hi_out = hi;
+}
+
+void mc_liquidity_bounds(const mc_table_t *mc, uint64_t scid, int direction,
+                         uint64_t capacity_msat, uint32_t now_unix,
+                         uint64_t *lo_msat, uint64_t *hi_msat)
+{
+    uint64_t cap = capacity_msat ? capacity_msat : UINT64_MAX;
+    uint64_t lo = 0, hi = cap;
+    const mc_entry_t *e = mc_find(mc, scid, direction);
+    if (e) entry_bounds(e, cap, now_unix, &lo, &hi);
+    if (lo_msat) *lo_msat = lo;
+    if (hi_msat) *hi_msat = hi;
+}
+
+uint32_t mc_success_probability_ppm(const mc_table_t *mc, uint64_t scid,
+                                    int direction, uint64_t amount_msat,
+                                    uint64_t capacity_msat, uint32_t now_unix)
+{
+    const mc_entry_t *e = mc_find(mc, scid, direction);
+    if (!e) {
+        /* Nothing observed: uniform over [0, capacity]. */
+        if (capacity_msat == 0 || amount_msat == 0) return MC_PROB_PPM_ONE;
+        if (amount_msat > capacity_msat) return 0;
+        uint64_t num = capacity_msat - amount_msat + 1;
+        uint64_t den = capacity_msat + 1;
+        while (den > UINT32_MAX) { num >>= 1; den >>= 1; }
+        uint64_t ppm = num * MC_PROB_PPM_ONE / den;
+        return ppm ? (uint32_t)ppm : 1;
+    }
+
+    uint64_t cap = capacity_msat;
+    if (cap == 0) {
+        cap = amount_msat;
+        if (e->liq_min_msat > cap) cap = e->liq_min_msat;
+        if (e->liq_max_msat != MC_LIQ_UNKNOWN && e->liq_max_msat > cap)
+            cap = e->liq_max_msat;
+        cap = cap > UINT64_MAX / 2 ? UINT64_MAX - 1 : cap * 2;
     }
-    return NULL;
+
+    uint64_t lo, hi;
+    entry_bounds(e, cap, now_unix, &lo, &hi);
+    if (amount_msat <= lo) return MC_PROB_PPM_ONE;
+    if (amount_msat > hi)  return 0;
+
+    uint64_t num = hi - amount_msat + 1;
+    uint64_t den = hi - lo + 1;
+    while (den > UINT32_MAX) { num >>= 1; den >>= 1; }
+    uint64_t ppm = num * MC_PROB_PPM_ONE / den;
+    return ppm ? (uint32_t)ppm : 1;
+}
+
+uint64_t mc_probability_cost_msat(uint32_t prob_ppm, uint64_t amount_msat)
+{
+    if (prob_ppm == 0) return UINT64_MAX;
+    if (prob_ppm >= MC_PROB_PPM_ONE) return 0;
+    uint64_t neg_log2 = log2_q16(MC_PROB_PPM_ONE) - log2_q16(prob_ppm);
+    uint64_t mult = MC_LIQ_PENALTY_BASE_MSAT +
+                    amount_msat / 1000000ULL * MC_LIQ_PENALTY_AMOUNT_PPM +
+                    amount_msat % 1000000ULL * MC_LIQ_PENALTY_AMOUNT_PPM / 1000000ULL;
+    if (mult > (UINT64_MAX >> 16) / (neg_log2 ? neg_log2 : 1))
+        return UINT64_MAX - 1;
+    return (mult * neg_log2) >> 16;
 }
@@ -1,5 +1,10 @@
 /*
  * mpp.c — Multi-path payment aggregation
+ *
+ * Sets are kept in a growable array of slots.  An open-addressing index
+ * (slot + 1, 0 = empty) maps payment_secret to its slot, and a binary
+ * min-heap of slots ordered on first_received_unix gives the next set to
+ * time out.  Freed slots keep their part arrays for reuse.
  */
 
 #include "superscalar/mpp.h"
@@ -7,34 +12,229 @@
 #include <stdlib.h>
 #include <time.h>
 
-void mpp_init(mpp_table_t *tbl) {
-    if (tbl) memset(tbl, 0, sizeof(*tbl));
+#define NO_POS UINT32_MAX
+
+static int max_payments(const mpp_table_t *tbl) {
+    return tbl->max_payments > 0 ? tbl->max_payments : MPP_MAX_PAYMENTS;
+}
+
+static int max_parts(const mpp_table_t *tbl) {
+    return tbl->max_parts > 0 ? tbl->max_parts : MPP_MAX_PARTS;
+}
+
+static uint32_t timeout_secs(const mpp_table_t *tbl) {
+    return tbl->timeout_secs ? tbl->timeout_secs : MPP_TIMEOUT_SECS;
+}
+
+/* ---- payment_secret index ---- */
+
+static size_t secret_pos(const unsigned char secret[32], size_t mask) {
+    uint64_t k;
+    memcpy(&k, secret, 8);
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static void idx_insert(mpp_table_t *tbl, uint32_t slot) {
+    size_t mask = tbl->idx_cap - 1;
+    size_t i = secret_pos(tbl->entries[slot].payment_secret, mask);
+    while (tbl->idx[i]) i = (i + 1) & mask;
+    tbl->idx[i] = slot + 1;
+}
+
+static void idx_remove(mpp_table_t *tbl, uint32_t slot) {
+    uint32_t *t = tbl->idx;
+    size_t mask = tbl->idx_cap - 1;
+    size_t i = secret_pos(tbl->entries[slot].payment_secret, mask);
+    while (t[i] != slot + 1) {
+        if (!t[i]) return;
+        i = (i + 1) & mask;
+    }
+    t[i] = 0;
+    for (size_t j = (i + 1) & mask; t[j]; j = (j + 1) & mask) {
+        size_t k = secret_pos(tbl->entries[t[j] - 1].payment_secret, mask);
+        /* t[j] may move into the hole unless its home lies in (i, j] */
+        int stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        t[i] = t[j];
+        t[j] = 0;
+        i = j;
+    }
+}
+
+/* Keep the index at most half full for need live sets. */
+static int ensure_index(mpp_table_t *tbl, size_t need) {
+    if (need * 2 <= tbl->idx_cap) return 1;
+    size_t cap = tbl->idx_cap ? tbl->idx_cap * 2 : 64;
+    while (need * 2 > cap) cap *= 2;
+
+    uint32_t *idx = calloc(cap, sizeof(uint32_t));
+    if (!idx) return 0;
+    free(tbl->idx);
+    tbl->idx = idx;
+    tbl->idx_cap = cap;
+    for (size_t s = 0; s < tbl->n_slots; s++)
+        if (tbl->entries[s].active) idx_insert(tbl, (uint32_t)s);
+    return 1;
 }
 
 /* Return active entry for payment_secret, or NULL if not found. */
 static mpp_payment_t *mpp_find(mpp_table_t *tbl,
                                  const unsigned char payment_secret[32]) {
-    for (int i = 0; i < MPP_MAX_PAYMENTS; i++) {
-        if (tbl->entries[i].active &&
-            memcmp(tbl->entries[i].payment_secret, payment_secret, 32) == 0)
-            return &tbl->entries[i];
+    if (!tbl->idx_cap) return NULL;
+    size_t mask = tbl->idx_cap - 1;
+    for (size_t i = secret_pos(payment_secret, mask); tbl->idx[i];
+         i = (i + 1) & mask) {
+        mpp_payment_t *e = &tbl->entries[tbl->idx[i] - 1];
+        if (memcmp(e->payment_secret, payment_secret, 32) == 0)
+            return e;
     }
     return NULL;
 }
 
+/* ---- timeout min-heap on first_received_unix ---- */
+
+static uint32_t heap_key(const mpp_table_t *tbl, size_t i) {
+    return tbl->entries[tbl->heap[i]].first_received_unix;
+}
+
+static void heap_set(mpp_table_t *tbl, size_t i, uint32_t slot) {
+    tbl->heap[i] = slot;
+    tbl->entries[slot].heap_pos = (uint32_t)i;
+}
+
+static void heap_up(mpp_table_t *tbl, size_t i) {
+    uint32_t slot = tbl->heap[i];
+    uint32_t key = tbl->entries[slot].first_received_unix;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap_key(tbl, parent) <= key) break;
+        heap_set(tbl, i, tbl->heap[parent]);
+        i = parent;
+    }
+    heap_set(tbl, i, slot);
+}
+
+static void heap_down(mpp_table_t *tbl, size_t i) {
+    uint32_t slot = tbl->heap[i];
+    uint32_t key = tbl->entries[slot].first_received_unix;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= tbl->heap_len) break;
+        if (c + 1 < tbl->heap_len && heap_key(tbl, c + 1) < heap_key(tbl, c))
+            c++;
+        if (key <= heap_key(tbl, c)) break;
+        heap_set(tbl, i, tbl->heap[c]);
+        i = c;
+    }
+    heap_set(tbl, i, slot);
+}
+
+static void heap_remove(mpp_table_t *tbl, mpp_payment_t *e) {
+    size_t i = e->heap_pos;
+    if (e->heap_pos == NO_POS) return;
+    e->heap_pos = NO_POS;
+    size_t last = --tbl->heap_len;
+    if (i == last) return;
+    uint32_t moved = tbl->heap[last];
+    heap_set(tbl, i, moved);
+    heap_down(tbl, i);
+    heap_up(tbl, tbl->entries[moved].heap_pos);
+}
+
+/* ---- slots ---- */
+
+static int grow_slots(mpp_table_t *tbl) {
+    size_t cap = tbl->cap ? tbl->cap * 2 : 16;
+
+    mpp_payment_t *entries = realloc(tbl->entries, cap * sizeof(*entries));
+    if (!entries) return 0;
+    memset(entries + tbl->cap, 0, (cap - tbl->cap) * sizeof(*entries));
+    tbl->entries = entries;
+    uint32_t *free_slots = realloc(tbl->free_slots, cap * sizeof(uint32_t));
+    if (!free_slots) return 0;
+    tbl->free_slots = free_slots;
+    uint32_t *heap = realloc(tbl->heap, cap * sizeof(uint32_t));
+    if (!heap) return 0;
+    tbl->heap = heap;
+    tbl->cap = cap;
+    return 1;
+}
+
 /* Allocate a new entry, or return NULL if table full. */
 static mpp_payment_t *mpp_alloc(mpp_table_t *tbl) {
-    for (int i = 0; i < MPP_MAX_PAYMENTS; i++) {
-        if (!tbl->entries[i].active)
-            return &tbl->entries[i];
+    if (tbl->count >= max_payments(tbl)) return NULL;
+    if (!ensure_index(tbl, (size_t)tbl->count + 1)) return NULL;
+
+    uint32_t slot;
+    if (tbl->n_free) {
+        slot = tbl->free_slots[--tbl->n_free];
+    } else {
+        if (tbl->n_slots == tbl->cap && !grow_slots(tbl)) return NULL;
+        slot = (uint32_t)tbl->n_slots++;
     }
-    return NULL;
+    return &tbl->entries[slot];
+}
+
+/* Unlink and release an active entry, keeping its part array. */
+static void mpp_release(mpp_table_t *tbl, mpp_payment_t *e) {
+    uint32_t slot = (uint32_t)(e - tbl->entries);
+    idx_remove(tbl, slot);
+    heap_remove(tbl, e);
+    mpp_part_t *parts = e->parts;
+    int parts_cap = e->parts_cap;
+    memset(e, 0, sizeof(*e));
+    e->parts = parts;
+    e->parts_cap = parts_cap;
+    tbl->free_slots[tbl->n_free++] = slot;
+    tbl->count--;
+}
+
+void mpp_init(mpp_table_t *tbl) {
+    if (tbl) memset(tbl, 0, sizeof(*tbl));
+}
+
+void mpp_free(mpp_table_t *tbl) {
+    if (!tbl) return;
+    for (size_t s = 0; s < tbl->n_slots; s++)
+        free(tbl->entries[s].parts);
+    free(tbl->entries);
+    free(tbl->free_slots);
+    free(tbl->idx);
+    free(tbl->heap);
+
+    int mp = tbl->max_payments, mx = tbl->max_parts;
+    uint32_t to = tbl->timeout_secs;
+    memset(tbl, 0, sizeof(*tbl));
+    tbl->max_payments = mp;
+    tbl->max_parts = mx;
+    tbl->timeout_secs = to;
+}
+
+void mpp_set_limits(mpp_table_t *tbl, int max_payments, int max_parts,
+                    uint32_t timeout_secs) {
+    if (!tbl) return;
+    tbl->max_payments = max_payments > 0 ? max_payments : 0;
+    tbl->max_parts    = max_parts > 0 ? max_parts : 0;
+    tbl->timeout_secs = timeout_secs;
 }
 
 int mpp_add_part(mpp_table_t *tbl,
                  const unsigned char payment_secret[32],
                  uint64_t htlc_id, uint64_t amount_msat,
                  uint64_t total_msat, uint32_t cltv_expiry) {
+    return mpp_add_part_ex(tbl, NULL, payment_secret, htlc_id, amount_msat,
+                           total_msat, cltv_expiry, (uint32_t)time(NULL));
+}
+
+int mpp_add_part_ex(mpp_table_t *tbl,
+                    const unsigned char *payment_hash,
+                    const unsigned char payment_secret[32],
+                    uint64_t htlc_id, uint64_t amount_msat,
+                    uint64_t total_msat, uint32_t cltv_expiry,
+                    uint32_t now_unix) {
     if (!tbl || !payment_secret) return -1;
 
     mpp_payment_t *entry = mpp_find(tbl, payment_secret);
@@ -42,19 +242,44 @@ int mpp_add_part(mpp_table_t *tbl,
     if (!entry) {
         entry = mpp_alloc(tbl);
         if (!entry) return -1;
-        memset(entry, 0, sizeof(*entry));
+        uint32_t slot = (uint32_t)(entry - tbl->entries);
         memcpy(entry->payment_secret, payment_secret, 32);
+        if (payment_hash) {
+            memcpy(entry->payment_hash, payment_hash, 32);
+            entry->has_payment_hash = 1;
+        }
         entry->total_msat          = total_msat;
-        entry->first_received_unix = (uint32_t)time(NULL);
+        entry->first_received_unix = now_unix;
         entry->active              = 1;
+        idx_insert(tbl, slot);
+        size_t i = tbl->heap_len++;
+        heap_set(tbl, i, slot);
+        heap_up(tbl, i);
         tbl->count++;
+    } else if (payment_hash) {
+        /* All parts of a set must pay the same hash (BOLT #4) */
+        if (!entry->has_payment_hash) {
+            memcpy(entry->payment_hash, payment_hash, 32);
+            entry->has_payment_hash = 1;
+        } else if (memcmp(entry->payment_hash, payment_hash, 32) != 0) {
+            return -1;
+        }
     }
 
-    if (entry->n_parts >= MPP_MAX_PARTS) return -1;
+    if (entry->n_parts >= max_parts(tbl)) return -1;
 
     /* Overpayment guard: collected + this part > 2 * total → fail */
     if (entry->collected_msat + amount_msat > 2 * entry->total_msat) return -1;
 
+    if (entry->n_parts == entry->parts_cap) {
+        int cap = entry->parts_cap ? entry->parts_cap * 2 : 2;
+        if (cap > max_parts(tbl)) cap = max_parts(tbl);
+        mpp_part_t *parts = realloc(entry->parts, (size_t)cap * sizeof(*parts));
+        if (!parts) return -1;
+        entry->parts = parts;
+        entry->parts_cap = cap;
+    }
+
     entry->parts[entry->n_parts].htlc_id     = htlc_id;
     entry->parts[entry->n_parts].amount_msat = amount_msat;
     entry->parts[entry->n_parts].cltv_expiry = cltv_expiry;
@@ -68,20 +293,22 @@ int mpp_check_timeouts(mpp_table_t *tbl, uint32_t now_unix,
                        uint64_t *failed_htlc_ids_out, int max_out) {
     if (!tbl) return 0;
 
+    uint32_t timeout = timeout_secs(tbl);
     int written = 0;
-    for (int i = 0; i < MPP_MAX_PAYMENTS; i++) {
-        mpp_payment_t *e = &tbl->entries[i];
-        if (!e->active) continue;
-        if (e->first_received_unix + MPP_TIMEOUT_SECS > now_unix) continue;
-
-        /* Timed out — collect all htlc_ids for failing */
-        for (int j = 0; j < e->n_parts && written < max_out; j++) {
-            if (failed_htlc_ids_out)
-                failed_htlc_ids_out[written] = e->parts[j].htlc_id;
-            written++;
+    while (tbl->heap_len) {
+        mpp_payment_t *e = &tbl->entries[tbl->heap[0]];
+        if ((uint64_t)e->first_received_unix + timeout > now_unix) break;
+
+        /* Timed out — collect all htlc_ids for failing.  A set that does
+         * not fit waits for the next call, unless nothing fits at all. */
+        if (failed_htlc_ids_out) {
+            if (written + e->n_parts > max_out && written > 0) break;
+            for (int j = 0; j < e->n_parts && written < max_out; j++)
+                failed_htlc_ids_out[written++] = e->parts[j].htlc_id;
+        } else {
+            written += e->n_parts;
         }
-        memset(e, 0, sizeof(*e));
-        tbl->count--;
+        mpp_release(tbl, e);
     }
     return written;
 }
@@ -105,12 +332,6 @@ int mpp_get_parts(mpp_table_t *tbl, const unsigned char payment_secret[32],
 void mpp_remove(mpp_table_t *tbl, const unsigned char payment_secret[32]) {
     if (!tbl || !payment_secret) return;
 
-    for (int i = 0; i < MPP_MAX_PAYMENTS; i++) {
-        if (tbl->entries[i].active &&
-            memcmp(tbl->entries[i].payment_secret, payment_secret, 32) == 0) {
-            memset(&tbl->entries[i], 0, sizeof(tbl->entries[i]));
-            tbl->count--;
-            return;
-        }
-    }
+    mpp_payment_t *e = mpp_find(tbl, payment_secret);
+    if (e) mpp_release(tbl, e);
 }
@@ -33,19 +33,21 @@ static void bolt4_generate_key(const char *tag,
 }
 
 /* ---- ChaCha20 stream ---- */
-static int chacha20_stream(const unsigned char key[32],
-                            unsigned char *out, size_t len) {
+/*
+ * out = in XOR ChaCha20(key), zero nonce; in == out is allowed.  cipher is
+ * reused if given, else a temporary context is allocated.
+ */
+static int chacha20_xor(EVP_CIPHER_CTX *cipher, const unsigned char key[32],
+                        const unsigned char *in, unsigned char *out,
+                        size_t len) {
     if (len == 0) return 1;
-    EVP_CIPHER_CTX *ctx2 = EVP_CIPHER_CTX_new();
-    if (!ctx2) return 0;
+    EVP_CIPHER_CTX *c = cipher ? cipher : EVP_CIPHER_CTX_new();
+    if (!c) return 0;
     static const unsigned char zero_iv[16] = {0};
-    unsigned char *zeros = (unsigned char *)calloc(len, 1);
-    if (!zeros) { EVP_CIPHER_CTX_free(ctx2); return 0; }
     int outlen = 0;
-    int ok = (EVP_EncryptInit_ex(ctx2, EVP_chacha20(), NULL, key, zero_iv) == 1 &&
-              EVP_EncryptUpdate(ctx2, out, &outlen, zeros, (int)len) == 1);
-    free(zeros);
-    EVP_CIPHER_CTX_free(ctx2);
+    int ok = (EVP_EncryptInit_ex(c, EVP_chacha20(), NULL, key, zero_iv) == 1 &&
+              EVP_EncryptUpdate(c, out, &outlen, in, (int)len) == 1);
+    if (!cipher) EVP_CIPHER_CTX_free(c);
     return ok;
 }
 
@@ -261,15 +263,8 @@ int onion_build(const onion_hop_t *hops, int n_hops,
             memcpy(hops_data + framed_lens[i], next_hmac, HMAC_SIZE);
 
         /* Encrypt the entire hops_data with rho[i] */
-        unsigned char *stream = (unsigned char *)malloc(HOP_DATA_SIZE);
-        if (!stream) return 0;
-        if (!chacha20_stream(rho[i], stream, HOP_DATA_SIZE)) {
-            free(stream);
+        if (!chacha20_xor(NULL, rho[i], hops_data, hops_data, HOP_DATA_SIZE))
             return 0;
-        }
-        for (int k = 0; k < HOP_DATA_SIZE; k++)
-            hops_data[k] ^= stream[k];
-        free(stream);
 
         /*
          * Zero out the tail bytes that outer hops will shift off.
@@ -302,6 +297,18 @@ int onion_peel(const unsigned char node_priv32[32],
                unsigned char onion_out[ONION_PACKET_SIZE],
                onion_hop_payload_t *payload_out,
                int *is_final) {
+    return onion_peel_ex(node_priv32, ctx, NULL, onion_in, onion_out,
+                         payload_out, is_final, NULL);
+}
+
+int onion_peel_ex(const unsigned char node_priv32[32],
+                  secp256k1_context *ctx,
+                  struct evp_cipher_ctx_st *cipher,
+                  const unsigned char onion_in[ONION_PACKET_SIZE],
+                  unsigned char onion_out[ONION_PACKET_SIZE],
+                  onion_hop_payload_t *payload_out,
+                  int *is_final,
+                  unsigned char ss_out[32]) {
     if (!node_priv32 || !ctx || !onion_in || !onion_out || !payload_out || !is_final)
         return 0;
 
@@ -330,7 +337,7 @@ int onion_peel(const unsigned char node_priv32[32],
 
     /* Decrypt hops_data */
     unsigned char plain[HOP_DATA_SIZE];
-    if (!onion_xor_stream(hops_data, HOP_DATA_SIZE, rho, plain)) return 0;
+    if (!chacha20_xor(cipher, rho, hops_data, plain, HOP_DATA_SIZE)) return 0;
 
     /* Parse TLV hop payload from plain */
     /* BigSize(len) at plain[0..] */
@@ -384,6 +391,7 @@ int onion_peel(const unsigned char node_priv32[32],
     memcpy(onion_out + 1, next_eph, 33);
     memcpy(onion_out + 34, next_hops_data, HOP_DATA_SIZE);
     memcpy(onion_out + 34 + HOP_DATA_SIZE, next_hmac2, HMAC_SIZE);
+    if (ss_out) memcpy(ss_out, ss, 32);
     return 1;
 }
 
@@ -413,9 +421,7 @@ int onion_error_decrypt(const unsigned char (*session_keys)[32], int n_hops,
         bolt4_generate_key("ammag", ss, ammag);
 
         /* XOR cur with ChaCha20(ammag) stream of 256 bytes */
-        unsigned char stream[256];
-        if (!chacha20_stream(ammag, stream, 256)) return 0;
-        for (int k = 0; k < 256; k++) cur[k] ^= stream[k];
+        if (!chacha20_xor(NULL, ammag, cur, cur, 256)) return 0;
 
         /* Check if this layer contains a valid HMAC:
            cur[0..31] = HMAC, cur[32..255] = payload */
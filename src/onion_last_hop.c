@@ -22,8 +22,11 @@
 
 /* ---- ChaCha20 bare stream (no Poly1305 tag) ---- */
 
-static int chacha20_stream(const unsigned char key[32],
-                            unsigned char *out, size_t len) {
+/* out = in XOR ChaCha20(key): encrypting in directly needs no keystream
+   buffer. */
+static int chacha20_xor(const unsigned char key[32],
+                        const unsigned char *in, unsigned char *out,
+                        size_t len) {
     if (len == 0) return 1;
 
     EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
@@ -33,16 +36,12 @@ static int chacha20_stream(const unsigned char key[32],
     static const unsigned char zero_iv[16] = {0};
 
     int ok = 0;
-    unsigned char *zeros = (unsigned char *)calloc(len, 1);
-    if (!zeros) goto out;
-
     int outlen = 0;
     if (EVP_EncryptInit_ex(ctx, EVP_chacha20(), NULL, key, zero_iv) != 1) goto out;
-    if (EVP_EncryptUpdate(ctx, out, &outlen, zeros, (int)len) != 1) goto out;
+    if (EVP_EncryptUpdate(ctx, out, &outlen, in, (int)len) != 1) goto out;
     ok = 1;
 
 out:
-    free(zeros);
     EVP_CIPHER_CTX_free(ctx);
     return ok;
 }
@@ -86,19 +85,7 @@ int onion_xor_stream(const unsigned char *hops_data, size_t hops_len,
                      unsigned char *out) {
     if (!hops_data || !rho || !out || hops_len == 0) return 0;
 
-    unsigned char *stream = (unsigned char *)malloc(hops_len);
-    if (!stream) return 0;
-
-    if (!chacha20_stream(rho, stream, hops_len)) {
-        free(stream);
-        return 0;
-    }
-
-    for (size_t i = 0; i < hops_len; i++)
-        out[i] = hops_data[i] ^ stream[i];
-
-    free(stream);
-    return 1;
+    return chacha20_xor(rho, hops_data, out, hops_len);
 }
 
 /* ---- BigSize varint decoder ---- */
@@ -0,0 +1,283 @@
+/*
+ * onion_proc.c — Batched onion peeling and shared-secret replay filter
+ *
+ * A batch is handed out one job at a time under op->lock; workers and the
+ * calling thread claim jobs until none are left, and the caller waits
+ * until every claimed job is done before running the replay checks in
+ * order.  Workers touch only the jobs they claimed.
+ *
+ * Replay windows live in a ring indexed by window % ONION_REPLAY_WINDOWS;
+ * a slot is reused for a newer window once its own has expired.
+ */
+
+#include "superscalar/onion_proc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+/* ---- Replay filter ---- */
+
+static uint32_t window_of(uint32_t cltv_expiry) {
+    return cltv_expiry / ONION_REPLAY_WINDOW_BLOCKS + 1;
+}
+
+static void window_reset(onion_replay_window_t *w, uint32_t window) {
+    if (w->slots && w->count)
+        memset(w->slots, 0, w->cap * sizeof(onion_replay_slot_t));
+    w->count = 0;
+    w->window = window;
+}
+
+/* Insert (fp, htlc_key) (fp not present) into a table with room for it. */
+static void window_put(onion_replay_slot_t *tab, size_t cap, uint64_t fp,
+                       uint64_t htlc_key) {
+    size_t mask = cap - 1;
+    size_t i = (size_t)fp & mask;
+    while (tab[i].fp) i = (i + 1) & mask;
+    tab[i].fp = fp;
+    tab[i].htlc_key = htlc_key;
+}
+
+static int window_grow(onion_replay_window_t *w) {
+    size_t nc = w->cap ? w->cap * 2 : 64;
+    onion_replay_slot_t *t = calloc(nc, sizeof(onion_replay_slot_t));
+    if (!t) return 0;
+    for (size_t i = 0; i < w->cap; i++)
+        if (w->slots[i].fp)
+            window_put(t, nc, w->slots[i].fp, w->slots[i].htlc_key);
+    free(w->slots);
+    w->slots = t;
+    w->cap = nc;
+    return 1;
+}
+
+/* The slot holding fp in w, NULL if absent. */
+static const onion_replay_slot_t *window_find(const onion_replay_window_t *w,
+                                              uint64_t fp) {
+    if (!w->window || !w->cap) return NULL;
+    size_t mask = w->cap - 1;
+    for (size_t i = (size_t)fp & mask; w->slots[i].fp; i = (i + 1) & mask)
+        if (w->slots[i].fp == fp) return &w->slots[i];
+    return NULL;
+}
+
+void onion_replay_init(onion_replay_t *rf) {
+    memset(rf, 0, sizeof(*rf));
+}
+
+void onion_replay_free(onion_replay_t *rf) {
+    if (!rf) return;
+    for (int i = 0; i < ONION_REPLAY_WINDOWS; i++)
+        free(rf->windows[i].slots);
+    memset(rf, 0, sizeof(*rf));
+}
+
+void onion_replay_expire(onion_replay_t *rf, uint32_t height) {
+    if (!rf) return;
+    /* Window w holds cltv_expiry < w * ONION_REPLAY_WINDOW_BLOCKS */
+    uint32_t first_live = height / ONION_REPLAY_WINDOW_BLOCKS + 1;
+    for (int i = 0; i < ONION_REPLAY_WINDOWS; i++) {
+        onion_replay_window_t *w = &rf->windows[i];
+        if (w->window && w->window < first_live)
+            window_reset(w, 0);
+    }
+}
+
+uint64_t onion_replay_htlc_key(const unsigned char channel_id[32],
+                               uint64_t htlc_id) {
+    uint64_t k = htlc_id;
+    for (int i = 0; i < 32; i += 8) {
+        uint64_t v;
+        memcpy(&v, channel_id + i, 8);
+        k = (k ^ v) * 0x9E3779B97F4A7C15ULL;
+        k ^= k >> 29;
+    }
+    return k ? k : 1;
+}
+
+onion_peel_result_t onion_replay_check_add(onion_replay_t *rf,
+                                           const unsigned char shared_secret[32],
+                                           uint32_t cltv_expiry,
+                                           uint32_t height,
+                                           uint64_t htlc_key) {
+    if (!rf || !shared_secret) return ONION_PEEL_BAD;
+
+    uint32_t win = window_of(cltv_expiry);
+    if (height) {
+        uint32_t first_live = height / ONION_REPLAY_WINDOW_BLOCKS + 1;
+        if (win < first_live) return ONION_PEEL_EXPIRY;
+        if (win - first_live >= ONION_REPLAY_WINDOWS) return ONION_PEEL_EXPIRY_FAR;
+    }
+
+    /* The shared secret is a SHA256 output: its first bytes are uniform */
+    uint64_t fp;
+    memcpy(&fp, shared_secret, 8);
+    if (fp == 0) fp = 1;
+
+    /* The same onion under another outer cltv_expiry is still a replay:
+       look in every live window, not just this expiry's */
+    for (int i = 0; i < ONION_REPLAY_WINDOWS; i++) {
+        const onion_replay_slot_t *hit = window_find(&rf->windows[i], fp);
+        if (!hit) continue;
+        /* The same HTLC sent again (BOLT #2 retransmission on reconnect) */
+        if (htlc_key && hit->htlc_key == htlc_key) return ONION_PEEL_OK;
+        rf->n_replays++;
+        return ONION_PEEL_REPLAY;
+    }
+
+    /* Without a tip the window cannot be placed: checked, not recorded */
+    if (!height) return ONION_PEEL_OK;
+
+    onion_replay_window_t *w = &rf->windows[win % ONION_REPLAY_WINDOWS];
+    if (w->window != win) {
+        /* The slot holds an older window (expired by now) or a newer one
+           (then this HTLC's window was dropped long ago) */
+        if (w->window > win) return ONION_PEEL_EXPIRY;
+        window_reset(w, win);
+    }
+    if ((w->count + 1) * 2 > w->cap && !window_grow(w))
+        return ONION_PEEL_BAD;
+    window_put(w->slots, w->cap, fp, htlc_key);
+    w->count++;
+    return ONION_PEEL_OK;
+}
+
+/* ---- Worker pool ---- */
+
+static void peel_one(onion_proc_t *op, EVP_CIPHER_CTX *cipher,
+                     onion_peel_job_t *j) {
+    j->result = onion_peel_ex(op->node_priv, op->ctx, cipher, j->onion_in,
+                              j->onion_out, &j->payload, &j->is_final,
+                              j->shared_secret)
+                ? ONION_PEEL_OK : ONION_PEEL_BAD;
+}
+
+/* Claim and peel jobs until the batch is handed out.  Called with
+   op->lock held; returns with it held. */
+static void peel_claimed(onion_proc_t *op, EVP_CIPHER_CTX *cipher) {
+    while (op->jobs && op->next_job < op->n_jobs) {
+        onion_peel_job_t *j = &op->jobs[op->next_job++];
+        pthread_mutex_unlock(&op->lock);
+        peel_one(op, cipher, j);
+        pthread_mutex_lock(&op->lock);
+        if (++op->n_done == op->n_jobs)
+            pthread_cond_signal(&op->done_cv);
+    }
+}
+
+static void *peel_worker(void *arg) {
+    onion_proc_t *op = (onion_proc_t *)arg;
+    EVP_CIPHER_CTX *cipher = EVP_CIPHER_CTX_new();  /* NULL: per-call contexts */
+    pthread_mutex_lock(&op->lock);
+    for (;;) {
+        while (!op->stop && (!op->jobs || op->next_job >= op->n_jobs))
+            pthread_cond_wait(&op->work_cv, &op->lock);
+        if (op->stop) break;
+        peel_claimed(op, cipher);
+    }
+    pthread_mutex_unlock(&op->lock);
+    EVP_CIPHER_CTX_free(cipher);
+    return NULL;
+}
+
+/* ---- Public API ---- */
+
+int onion_proc_init(onion_proc_t *op, secp256k1_context *ctx,
+                    const unsigned char node_priv32[32], int n_workers) {
+    if (!op || !ctx || !node_priv32 || n_workers < 0) return 0;
+    memset(op, 0, sizeof(*op));
+    memcpy(op->node_priv, node_priv32, 32);
+    op->ctx = ctx;
+    onion_replay_init(&op->replay);
+    if (pthread_mutex_init(&op->lock, NULL) != 0) return 0;
+    pthread_mutex_init(&op->batch_lock, NULL);
+    pthread_cond_init(&op->work_cv, NULL);
+    pthread_cond_init(&op->done_cv, NULL);
+    op->cipher = EVP_CIPHER_CTX_new();
+    if (!op->cipher) {
+        onion_proc_free(op);
+        return 0;
+    }
+
+    if (n_workers > 0) {
+        op->workers = calloc((size_t)n_workers, sizeof(pthread_t));
+        if (!op->workers) {
+            onion_proc_free(op);
+            return 0;
+        }
+        for (int i = 0; i < n_workers; i++) {
+            if (pthread_create(&op->workers[i], NULL, peel_worker, op) != 0) {
+                onion_proc_free(op);
+                return 0;
+            }
+            op->n_workers++;
+        }
+    }
+    return 1;
+}
+
+void onion_proc_free(onion_proc_t *op) {
+    if (!op) return;
+    pthread_mutex_lock(&op->lock);
+    op->stop = 1;
+    pthread_cond_broadcast(&op->work_cv);
+    pthread_mutex_unlock(&op->lock);
+    for (int i = 0; i < op->n_workers; i++)
+        pthread_join(op->workers[i], NULL);
+    free(op->workers);
+
+    EVP_CIPHER_CTX_free(op->cipher);
+    onion_replay_free(&op->replay);
+    pthread_mutex_destroy(&op->lock);
+    pthread_mutex_destroy(&op->batch_lock);
+    pthread_cond_destroy(&op->work_cv);
+    pthread_cond_destroy(&op->done_cv);
+    memset(op->node_priv, 0, 32);
+    memset(op, 0, sizeof(*op));
+}
+
+void onion_proc_set_height(onion_proc_t *op, uint32_t height) {
+    if (!op) return;
+    pthread_mutex_lock(&op->batch_lock);
+    if (height > op->block_height) {
+        op->block_height = height;
+        onion_replay_expire(&op->replay, height);
+    }
+    pthread_mutex_unlock(&op->batch_lock);
+}
+
+size_t onion_proc_peel_batch(onion_proc_t *op, onion_peel_job_t *jobs,
+                             size_t n) {
+    if (!op || !jobs || n == 0) return 0;
+    pthread_mutex_lock(&op->batch_lock);
+
+    pthread_mutex_lock(&op->lock);
+    op->jobs = jobs;
+    op->n_jobs = n;
+    op->next_job = 0;
+    op->n_done = 0;
+    /* A single onion is not worth a thread hand-off */
+    if (n > 1 && op->n_workers > 0)
+        pthread_cond_broadcast(&op->work_cv);
+    peel_claimed(op, op->cipher);
+    while (op->n_done < op->n_jobs)
+        pthread_cond_wait(&op->done_cv, &op->lock);
+    op->jobs = NULL;
+    op->n_jobs = 0;
+    pthread_mutex_unlock(&op->lock);
+
+    /* Replay checks in batch order */
+    size_t ok = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (jobs[i].result != ONION_PEEL_OK) continue;
+        jobs[i].result = onion_replay_check_add(&op->replay,
+                                                jobs[i].shared_secret,
+                                                jobs[i].cltv_expiry,
+                                                op->block_height,
+                                                jobs[i].htlc_key);
+        if (jobs[i].result == ONION_PEEL_OK) ok++;
+    }
+
+    pthread_mutex_unlock(&op->batch_lock);
+    return ok;
+}
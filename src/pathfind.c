@@ -4,28 +4,35 @@
  * Loads channel graph from gossip_store_t (SQLite).
  * Cost function: fee_base_msat + fee_ppm*amount/1e6 + cltv_delta*amount*RISK/1e9
  *
+ * Graph layout: nodes, channels and directed edges live in growable arrays
+ * (no fixed caps).  Nodes are found by pubkey and channels by scid through
+ * open-addressing hashes, so incremental patches and the live-graph updates
+ * applied by gossip_ingest are O(1).  Before a search the out-edges are packed into a
+ * compressed sparse row (CSR) index, rebuilt only when the topology changed,
+ * and Dijkstra runs with a binary min-heap (decrease-key via a position
+ * table): O((V + E) log V) instead of the old O(V^2 + V*E) scans.
+ *
  * Reference: LDK lightning/src/routing/router.rs,
  *            CLN plugins/askrene/algorithm.c
  */
 
 #include "superscalar/pathfind.h"
 #include "superscalar/gossip_store.h"
+#include "superscalar/gossip_log.h"
 #include "superscalar/mission_control.h"
 #include "superscalar/pathfind_exclude.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #include <sqlite3.h>
 
-/* ---- Maximum graph size ---- */
-#define MAX_NODES   4096
-#define MAX_EDGES   32768
-
-typedef struct {
-    unsigned char pubkey[33];
-    int           index;
-} node_entry_t;
+/* ---- Initial capacities (arrays double on demand) ---- */
+#define INIT_NODES  256
+#define INIT_EDGES  1024
 
 typedef struct {
     int      from_idx;
@@ -34,103 +41,483 @@ typedef struct {
     uint32_t fee_base_msat;
     uint32_t fee_ppm;
     uint16_t cltv_delta;
+    uint8_t  dir;         /* 0: node1 -> node2, 1: node2 -> node1 */
+    uint8_t  disabled;    /* channel_flags bit 1 */
     uint64_t htlc_min_msat;
     uint64_t htlc_max_msat;
 } edge_t;
 
+/* One announced channel; its directed edges exist once a channel_update
+ * has been seen for that direction. */
+typedef struct {
+    uint64_t scid;
+    int      node[2];     /* node1, node2 indices */
+    int      edge[2];     /* edge index per direction, -1 = no update yet */
+    uint64_t capacity_sat;
+} chan_t;
+
+typedef struct alt_table alt_table_t;
+static void alt_free(alt_table_t *t);
+
 /* ---- Graph ---- */
 struct pathfind_graph_s {
-    node_entry_t nodes[MAX_NODES];
-    int          n_nodes;
-    edge_t       edges[MAX_EDGES];
-    int          n_edges;
+    unsigned char (*pubkeys)[33];   /* node index -> pubkey */
+    int            n_nodes;
+    int            cap_nodes;
+    int           *node_slots;      /* hash: node index + 1, 0 = empty */
+    int            node_slots_cap;  /* power of two */
+
+    chan_t        *chans;
+    int            n_chans;
+    int            cap_chans;
+    int           *chan_slots;      /* hash on scid: channel index + 1 */
+    int            chan_slots_cap;  /* power of two */
+
+    edge_t        *edges;
+    int            n_edges;
+    int            cap_edges;
+
+    /* CSR out-adjacency: out-edges of node u are
+     * adj_edge[adj_off[u] .. adj_off[u+1]), in insertion order. */
+    int           *adj_off;
+    int           *adj_edge;
+    int            csr_valid;
+
+    /* ALT landmark table; used only while alt->epoch == alt_epoch. */
+    alt_table_t   *alt;
+    uint64_t       alt_epoch;      /* bumped by any change that may shorten a path */
+
+    /* Serialises the public live-graph API (pathfind_graph_*). */
+    pthread_mutex_t lock;
+    int             has_lock;
+
+    /* Background landmark refresher (pathfind_graph_alt_start). */
+    pthread_t       alt_tid;
+    pthread_cond_t  alt_cond;
+    int             alt_running;
+    int             alt_n_landmarks;
+    uint64_t        alt_ref_msat;
+    uint32_t        alt_interval_ms;
 };
 typedef struct pathfind_graph_s graph_t;
 
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t pubkey_hash(const unsigned char pk[33]) {
+    uint64_t h = pk[0];
+    for (int w = 0; w < 4; w++) {
+        uint64_t v;
+        memcpy(&v, pk + 1 + w * 8, 8);
+        h = mix64(h ^ v);
+    }
+    return h;
+}
+
+static uint64_t scid_hash(uint64_t scid) {
+    return mix64(scid ^ 0x9e3779b97f4a7c15ULL);
+}
+
+/* Release all storage but keep the struct (and its lock) itself. */
+static void graph_release(graph_t *g) {
+    free(g->pubkeys);
+    free(g->node_slots);
+    free(g->chans);
+    free(g->chan_slots);
+    free(g->edges);
+    free(g->adj_off);
+    free(g->adj_edge);
+    alt_free(g->alt);
+    g->alt = NULL;
+    g->alt_epoch++;
+    g->pubkeys = NULL;    g->n_nodes = g->cap_nodes = 0;
+    g->node_slots = NULL; g->node_slots_cap = 0;
+    g->chans = NULL;      g->n_chans = g->cap_chans = 0;
+    g->chan_slots = NULL; g->chan_slots_cap = 0;
+    g->edges = NULL;      g->n_edges = g->cap_edges = 0;
+    g->adj_off = NULL;    g->adj_edge = NULL;
+    g->csr_valid = 0;
+}
+
+/* Empty the graph, keeping allocated capacity for the next load. */
+static void graph_clear(graph_t *g) {
+    alt_free(g->alt);
+    g->alt = NULL;
+    g->alt_epoch++;
+    g->n_nodes = 0;
+    g->n_chans = 0;
+    g->n_edges = 0;
+    g->csr_valid = 0;
+    if (g->node_slots)
+        memset(g->node_slots, 0, (size_t)g->node_slots_cap * sizeof(int));
+    if (g->chan_slots)
+        memset(g->chan_slots, 0, (size_t)g->chan_slots_cap * sizeof(int));
+}
+
+static int node_slots_rehash(graph_t *g, int new_cap) {
+    int *slots = (int *)calloc((size_t)new_cap, sizeof(int));
+    if (!slots) return 0;
+    for (int i = 0; i < g->n_nodes; i++) {
+        size_t s = (size_t)pubkey_hash(g->pubkeys[i]) & (size_t)(new_cap - 1);
+        while (slots[s]) s = (s + 1) & (size_t)(new_cap - 1);
+        slots[s] = i + 1;
+    }
+    free(g->node_slots);
+    g->node_slots = slots;
+    g->node_slots_cap = new_cap;
+    return 1;
+}
+
+static int chan_slots_rehash(graph_t *g, int new_cap) {
+    int *slots = (int *)calloc((size_t)new_cap, sizeof(int));
+    if (!slots) return 0;
+    for (int i = 0; i < g->n_chans; i++) {
+        size_t s = (size_t)scid_hash(g->chans[i].scid) & (size_t)(new_cap - 1);
+        while (slots[s]) s = (s + 1) & (size_t)(new_cap - 1);
+        slots[s] = i + 1;
+    }
+    free(g->chan_slots);
+    g->chan_slots = slots;
+    g->chan_slots_cap = new_cap;
+    return 1;
+}
+
+/* Returns node index, or -1 if absent. */
+static int node_find(const graph_t *g, const unsigned char pubkey[33]) {
+    if (!g->node_slots_cap) return -1;
+    size_t mask = (size_t)(g->node_slots_cap - 1);
+    size_t s = (size_t)pubkey_hash(pubkey) & mask;
+    while (g->node_slots[s]) {
+        int i = g->node_slots[s] - 1;
+        if (memcmp(g->pubkeys[i], pubkey, 33) == 0) return i;
+        s = (s + 1) & mask;
+    }
+    return -1;
+}
+
 static int node_find_or_add(graph_t *g, const unsigned char pubkey[33]) {
-    for (int i = 0; i < g->n_nodes; i++)
-        if (memcmp(g->nodes[i].pubkey, pubkey, 33) == 0) return i;
-    if (g->n_nodes >= MAX_NODES) return -1;
-    memcpy(g->nodes[g->n_nodes].pubkey, pubkey, 33);
-    g->nodes[g->n_nodes].index = g->n_nodes;
-    return g->n_nodes++;
+    int i = node_find(g, pubkey);
+    if (i >= 0) return i;
+
+    if (g->n_nodes == g->cap_nodes) {
+        int nc = g->cap_nodes ? g->cap_nodes * 2 : INIT_NODES;
+        void *p = realloc(g->pubkeys, (size_t)nc * 33);
+        if (!p) return -1;
+        g->pubkeys = (unsigned char (*)[33])p;
+        g->cap_nodes = nc;
+    }
+    /* Keep the load factor at or below 1/2. */
+    if ((g->n_nodes + 1) * 2 > g->node_slots_cap &&
+        !node_slots_rehash(g, g->node_slots_cap ? g->node_slots_cap * 2
+                                                : INIT_NODES * 2))
+        return -1;
+
+    i = g->n_nodes++;
+    memcpy(g->pubkeys[i], pubkey, 33);
+    size_t mask = (size_t)(g->node_slots_cap - 1);
+    size_t s = (size_t)pubkey_hash(pubkey) & mask;
+    while (g->node_slots[s]) s = (s + 1) & mask;
+    g->node_slots[s] = i + 1;
+    g->csr_valid = 0;
+    return i;
 }
 
-/* ---- Load graph from gossip_store ---- */
-static int load_graph(gossip_store_t *gs, graph_t *g) {
-    if (!gs || !gs->db) return 0;
-    memset(g, 0, sizeof(*g));
+/* Returns the hash slot holding scid, or -1 if absent. */
+static long chan_slot(const graph_t *g, uint64_t scid) {
+    if (!g->chan_slots_cap) return -1;
+    size_t mask = (size_t)(g->chan_slots_cap - 1);
+    size_t s = (size_t)scid_hash(scid) & mask;
+    while (g->chan_slots[s]) {
+        if (g->chans[g->chan_slots[s] - 1].scid == scid) return (long)s;
+        s = (s + 1) & mask;
+    }
+    return -1;
+}
 
-    /* Join channels with channel_updates to build directed edges */
-    const char *sql =
-        "SELECT c.scid, c.node1_hex, c.node2_hex, "
-        "       u.direction, u.fee_base_msat, u.fee_ppm, u.cltv_delta, "
-        "       c.capacity_sat "
-        "FROM gossip_channels c "
-        "JOIN gossip_channel_updates u ON c.scid = u.scid "
-        "WHERE c.pruned_at = 0";
+static chan_t *chan_find(const graph_t *g, uint64_t scid) {
+    long s = chan_slot(g, scid);
+    return (s < 0) ? NULL : &g->chans[g->chan_slots[s] - 1];
+}
 
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(gs->db, sql, -1, &stmt, NULL) != SQLITE_OK)
-        return 0;
+/* Add a channel with endpoints n1/n2 (node indices).  Returns the
+ * existing record if scid is already known, NULL on OOM. */
+static chan_t *chan_add(graph_t *g, uint64_t scid, int n1, int n2) {
+    chan_t *c = chan_find(g, scid);
+    if (c) return c;
+
+    if (g->n_chans == g->cap_chans) {
+        int nc = g->cap_chans ? g->cap_chans * 2 : INIT_EDGES / 2;
+        chan_t *p = (chan_t *)realloc(g->chans, (size_t)nc * sizeof(chan_t));
+        if (!p) return NULL;
+        g->chans = p;
+        g->cap_chans = nc;
+    }
+    if ((g->n_chans + 1) * 2 > g->chan_slots_cap &&
+        !chan_slots_rehash(g, g->chan_slots_cap ? g->chan_slots_cap * 2
+                                                : INIT_EDGES))
+        return NULL;
+
+    int ci = g->n_chans++;
+    c = &g->chans[ci];
+    c->scid         = scid;
+    c->node[0]      = n1;
+    c->node[1]      = n2;
+    c->edge[0]      = -1;
+    c->edge[1]      = -1;
+    c->capacity_sat = 0;
+
+    size_t mask = (size_t)(g->chan_slots_cap - 1);
+    size_t s = (size_t)scid_hash(scid) & mask;
+    while (g->chan_slots[s]) s = (s + 1) & mask;
+    g->chan_slots[s] = ci + 1;
+    return c;
+}
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        uint64_t scid        = (uint64_t)sqlite3_column_int64(stmt, 0);
-        const char *n1_hex   = (const char *)sqlite3_column_text(stmt, 1);
-        const char *n2_hex   = (const char *)sqlite3_column_text(stmt, 2);
-        int direction        = sqlite3_column_int(stmt, 3);
-        uint32_t fee_base    = (uint32_t)sqlite3_column_int64(stmt, 4);
-        uint32_t fee_ppm_val = (uint32_t)sqlite3_column_int64(stmt, 5);
-        uint16_t cltv        = (uint16_t)sqlite3_column_int(stmt, 6);
-        uint64_t cap_sat     = (uint64_t)sqlite3_column_int64(stmt, 7);
-
-        if (!n1_hex || !n2_hex) continue;
-
-        /* Decode hex pubkeys */
-        unsigned char pk1[33], pk2[33];
-        for (int i = 0; i < 33; i++) {
-            unsigned int v1, v2;
-            if (sscanf(n1_hex + i*2, "%02x", &v1) != 1) { v1 = 0; }
-            if (sscanf(n2_hex + i*2, "%02x", &v2) != 1) { v2 = 0; }
-            pk1[i] = (unsigned char)v1;
-            pk2[i] = (unsigned char)v2;
-        }
+/* Linear-probing delete with backward shift (no tombstones). */
+static void chan_slot_delete(graph_t *g, size_t s) {
+    size_t mask = (size_t)(g->chan_slots_cap - 1);
+    size_t i = s;
+    g->chan_slots[i] = 0;
+    for (size_t j = (i + 1) & mask; g->chan_slots[j]; j = (j + 1) & mask) {
+        size_t home = (size_t)scid_hash(g->chans[g->chan_slots[j] - 1].scid) & mask;
+        int stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays) continue;
+        g->chan_slots[i] = g->chan_slots[j];
+        g->chan_slots[j] = 0;
+        i = j;
+    }
+}
 
-        int idx1 = node_find_or_add(g, pk1);
-        int idx2 = node_find_or_add(g, pk2);
-        if (idx1 < 0 || idx2 < 0) continue;
-        if (g->n_edges >= MAX_EDGES) continue;
-
-        /* direction 0 = node1→node2, direction 1 = node2→node1 */
-        edge_t *e = &g->edges[g->n_edges++];
-        e->scid         = scid;
-        e->fee_base_msat = fee_base;
-        e->fee_ppm      = fee_ppm_val;
-        e->cltv_delta   = cltv;
-        e->htlc_min_msat = 1;
-        e->htlc_max_msat = cap_sat * 1000; /* conservative: full capacity */
-        if (direction == 0) {
-            e->from_idx = idx1;
-            e->to_idx   = idx2;
-        } else {
-            e->from_idx = idx2;
-            e->to_idx   = idx1;
-        }
+/* Swap-delete edge ei, fixing up the channel that owned the moved edge. */
+static void edge_remove(graph_t *g, int ei) {
+    int last = g->n_edges - 1;
+    if (ei != last) {
+        g->edges[ei] = g->edges[last];
+        chan_t *mc = chan_find(g, g->edges[ei].scid);
+        if (mc) mc->edge[g->edges[ei].dir] = ei;
     }
-    sqlite3_finalize(stmt);
+    g->n_edges--;
+    g->csr_valid = 0;
+}
+
+/* Remove a channel and both of its edges.  Returns 1 if it existed. */
+static int chan_remove(graph_t *g, uint64_t scid) {
+    long s = chan_slot(g, scid);
+    if (s < 0) return 0;
+    int ci = g->chan_slots[s] - 1;
+
+    /* Re-read after each removal: the first may relocate the second. */
+    for (int d = 0; d < 2; d++) {
+        int ei = g->chans[ci].edge[d];
+        if (ei >= 0) edge_remove(g, ei);
+        g->chans[ci].edge[d] = -1;
+    }
+
+    chan_slot_delete(g, (size_t)s);
+    int last = g->n_chans - 1;
+    if (ci != last) {
+        long ls = chan_slot(g, g->chans[last].scid);
+        g->chans[ci] = g->chans[last];
+        if (ls >= 0) g->chan_slots[ls] = ci + 1;
+    }
+    g->n_chans--;
+    return 1;
+}
+
+/* Return the directed edge for (channel, dir), appending it if needed. */
+static edge_t *chan_edge(graph_t *g, chan_t *c, int dir) {
+    if (c->edge[dir] >= 0) return &g->edges[c->edge[dir]];
+
+    if (g->n_edges == g->cap_edges) {
+        int nc = g->cap_edges ? g->cap_edges * 2 : INIT_EDGES;
+        edge_t *p = (edge_t *)realloc(g->edges, (size_t)nc * sizeof(edge_t));
+        if (!p) return NULL;
+        g->edges = p;
+        g->cap_edges = nc;
+    }
+    int ei = g->n_edges++;
+    edge_t *e = &g->edges[ei];
+    memset(e, 0, sizeof(*e));
+    e->scid     = c->scid;
+    e->dir      = (uint8_t)dir;
+    e->from_idx = c->node[dir];
+    e->to_idx   = c->node[1 - dir];
+    c->edge[dir] = ei;
+    g->csr_valid = 0;
+    g->alt_epoch++;
+    return e;
+}
+
+/* Set an edge's fee policy.  A cheaper policy can shorten paths, which
+ * invalidates the ALT lower bounds. */
+static void edge_set_fees(graph_t *g, edge_t *e, uint32_t fee_base_msat,
+                          uint32_t fee_ppm, uint16_t cltv_delta) {
+    if (fee_base_msat < e->fee_base_msat || fee_ppm < e->fee_ppm ||
+        cltv_delta < e->cltv_delta)
+        g->alt_epoch++;
+    e->fee_base_msat = fee_base_msat;
+    e->fee_ppm       = fee_ppm;
+    e->cltv_delta    = cltv_delta;
+}
+
+/* Pack out-edges into CSR form.  Counting sort keeps each node's edges in
+ * insertion order, so relaxation order matches the edge list. */
+static int graph_build_csr(graph_t *g) {
+    if (g->csr_valid) return 1;
+    int *off = (int *)realloc(g->adj_off, ((size_t)g->n_nodes + 1) * sizeof(int));
+    if (!off) return 0;
+    g->adj_off = off;
+    int *adj = (int *)realloc(g->adj_edge,
+                              (size_t)(g->n_edges ? g->n_edges : 1) * sizeof(int));
+    if (!adj) return 0;
+    g->adj_edge = adj;
+
+    memset(off, 0, ((size_t)g->n_nodes + 1) * sizeof(int));
+    for (int ei = 0; ei < g->n_edges; ei++)
+        off[g->edges[ei].from_idx + 1]++;
+    for (int u = 0; u < g->n_nodes; u++)
+        off[u + 1] += off[u];
+    for (int ei = 0; ei < g->n_edges; ei++) {
+        int u = g->edges[ei].from_idx;
+        adj[off[u]++] = ei;
+    }
+    /* off[u] now holds the end of u's run; shift back to starts. */
+    for (int u = g->n_nodes; u > 0; u--)
+        off[u] = off[u - 1];
+    off[0] = 0;
+    g->csr_valid = 1;
+    return 1;
+}
+
+/* Add or overwrite a directed edge given by endpoint pubkeys (store rows
+ * carry src/dst rather than a direction bit).  A channel first seen here
+ * is oriented node1 < node2, as BOLT #7 requires.  Returns 1 on success. */
+static int graph_upsert_edge(graph_t *g, uint64_t scid,
+                             const unsigned char src_pubkey[33],
+                             const unsigned char dst_pubkey[33],
+                             uint32_t fee_base_msat, uint32_t fee_ppm,
+                             uint16_t cltv_delta,
+                             uint64_t htlc_min_msat, uint64_t htlc_max_msat) {
+    int idx_src = node_find_or_add(g, src_pubkey);
+    int idx_dst = node_find_or_add(g, dst_pubkey);
+    if (idx_src < 0 || idx_dst < 0) return 0;
+
+    chan_t *c = chan_find(g, scid);
+    if (!c) {
+        int src_first = memcmp(src_pubkey, dst_pubkey, 33) <= 0;
+        c = chan_add(g, scid, src_first ? idx_src : idx_dst,
+                              src_first ? idx_dst : idx_src);
+        if (!c) return 0;
+    }
+    int dir;
+    if (c->node[0] == idx_src && c->node[1] == idx_dst)      dir = 0;
+    else if (c->node[1] == idx_src && c->node[0] == idx_dst) dir = 1;
+    else return 0;   /* endpoints disagree with the known channel */
+
+    edge_t *e = chan_edge(g, c, dir);
+    if (!e) return 0;
+    edge_set_fees(g, e, fee_base_msat, fee_ppm, cltv_delta);
+    e->htlc_min_msat = htlc_min_msat;
+    e->htlc_max_msat = htlc_max_msat;
     return 1;
 }
 
-/* ---- Dijkstra ---- */
+/* ---- Load graph from gossip_store ---- */
 
-#define DIST_INF  UINT64_MAX
+static void load_edge_cb(uint64_t scid,
+                          const unsigned char src_pubkey[33],
+                          const unsigned char dst_pubkey[33],
+                          uint32_t fee_base_msat,
+                          uint32_t fee_ppm,
+                          uint16_t cltv_delta,
+                          uint64_t htlc_min_msat,
+                          uint64_t htlc_max_msat,
+                          uint64_t capacity_sat,
+                          void *ctx);
+
+typedef struct {
+    graph_t *g;
+    int      count;
+} load_ctx_t;
+
+static int load_graph(gossip_store_t *gs, graph_t *g) {
+    if (!gs || !gs->db) return 0;
+    graph_clear(g);
+    load_ctx_t lc = { g, 0 };
+    return gossip_store_enumerate_channels(gs, load_edge_cb, &lc) >= 0;
+}
+
+/* ---- Dijkstra / A* ---- */
+
+#define DIST_INF         UINT64_MAX
+#define PENALTY_EXCLUDE  UINT64_MAX   /* per-edge penalty: never use the edge */
 
 typedef struct {
     uint64_t dist;
+    uint64_t key;         /* heap key: dist, or dist + h(v) under A* */
     int      prev_edge;   /* index into g->edges, -1 for source */
-    int      visited;
+    int      heap_pos;    /* -1 = never queued, -2 = settled */
 } dijk_node_t;
 
+/* Binary min-heap of node indices keyed by dn[].key; ties go to the
+ * lower node index so results are deterministic. */
+typedef struct {
+    int         *a;
+    int          n;
+    dijk_node_t *dn;
+} heap_t;
+
+static int heap_less(const heap_t *h, int x, int y) {
+    uint64_t kx = h->dn[x].key, ky = h->dn[y].key;
+    return kx < ky || (kx == ky && x < y);
+}
+
+static void heap_set(heap_t *h, int pos, int v) {
+    h->a[pos] = v;
+    h->dn[v].heap_pos = pos;
+}
+
+static void heap_sift_up(heap_t *h, int pos) {
+    int v = h->a[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!heap_less(h, v, h->a[parent])) break;
+        heap_set(h, pos, h->a[parent]);
+        pos = parent;
+    }
+    heap_set(h, pos, v);
+}
+
+static void heap_sift_down(heap_t *h, int pos) {
+    int v = h->a[pos];
+    for (;;) {
+        int c = 2 * pos + 1;
+        if (c >= h->n) break;
+        if (c + 1 < h->n && heap_less(h, h->a[c + 1], h->a[c])) c++;
+        if (!heap_less(h, h->a[c], v)) break;
+        heap_set(h, pos, h->a[c]);
+        pos = c;
+    }
+    heap_set(h, pos, v);
+}
+
+static int heap_pop(heap_t *h) {
+    int top = h->a[0];
+    h->n--;
+    if (h->n > 0) {
+        heap_set(h, 0, h->a[h->n]);
+        heap_sift_down(h, 0);
+    }
+    h->dn[top].heap_pos = -2;
+    return top;
+}
+
 static uint64_t edge_cost(const edge_t *e, uint64_t amount_msat) {
     uint64_t fee = (uint64_t)e->fee_base_msat +
                    (uint64_t)e->fee_ppm * amount_msat / 1000000ULL;
@@ -139,51 +526,336 @@ static uint64_t edge_cost(const edge_t *e, uint64_t amount_msat) {
     return fee + cltv_pen + 1; /* +1 to prefer fewer hops on tie */
 }
 
-static int dijkstra(const graph_t *g,
+/* ---- ALT (A*, Landmarks, Triangle inequality) ----
+ *
+ * For each landmark L the table holds d(v -> L) and d(L -> v) for every
+ * node, computed over ALL edges (disabled ones too) at ref_amount_msat.
+ * Edge cost is non-decreasing in amount, so for any query amount >= ref and
+ * any subset of those edges
+ *     h(v) = max_L max(d(v,L) - d(t,L), d(L,t) - d(L,v))
+ * is a consistent lower bound on d(v, t).  Changes that can only lengthen
+ * paths (fee increase, disable, closure, MC exclusion) keep the table
+ * valid; anything that can shorten one (new edge, fee decrease, reload)
+ * bumps g->alt_epoch and the table is ignored until rebuilt.
+ */
+
+#define ALT_INF  UINT32_MAX   /* unreachable, or too far to store */
+
+struct alt_table {
+    int        n_landmarks;
+    int        n_nodes;          /* nodes covered: index < n_nodes */
+    uint64_t   epoch;            /* g->alt_epoch of the snapshot */
+    uint64_t   ref_amount_msat;
+    int       *landmark;         /* node index per landmark */
+    uint32_t  *to;               /* [v * n_landmarks + l] = d(v -> L_l) */
+    uint32_t  *from;             /* [v * n_landmarks + l] = d(L_l -> v) */
+};
+
+static void alt_free(alt_table_t *t) {
+    if (!t) return;
+    free(t->landmark);
+    free(t->to);
+    free(t->from);
+    free(t);
+}
+
+static int alt_usable(const graph_t *g, int src, int dst, uint64_t amount_msat) {
+    const alt_table_t *t = g->alt;
+    return t && t->epoch == g->alt_epoch && amount_msat >= t->ref_amount_msat &&
+           src < t->n_nodes && dst < t->n_nodes;
+}
+
+/* Per-query A* state: the few landmarks that bound d(src, dst) best. */
+typedef struct {
+    const alt_table_t *t;
+    int      n_active;
+    int      active[PATHFIND_ALT_ACTIVE];
+    uint32_t to_t[PATHFIND_ALT_ACTIVE];     /* d(t -> L) */
+    uint32_t from_t[PATHFIND_ALT_ACTIVE];   /* d(L -> t) */
+} alt_query_t;
+
+static uint64_t alt_bound_l(const alt_table_t *t, int v, int l,
+                            uint32_t to_t, uint32_t from_t) {
+    uint64_t best = 0;
+    uint32_t to_v   = t->to[(size_t)v * (size_t)t->n_landmarks + (size_t)l];
+    uint32_t from_v = t->from[(size_t)v * (size_t)t->n_landmarks + (size_t)l];
+    if (to_v != ALT_INF && to_t != ALT_INF && to_v > to_t)
+        best = to_v - to_t;
+    if (from_t != ALT_INF && from_v != ALT_INF && from_t > from_v &&
+        (uint64_t)(from_t - from_v) > best)
+        best = from_t - from_v;
+    return best;
+}
+
+static uint64_t alt_h(const alt_query_t *q, int v) {
+    uint64_t best = 0;
+    for (int i = 0; i < q->n_active; i++) {
+        uint64_t b = alt_bound_l(q->t, v, q->active[i], q->to_t[i], q->from_t[i]);
+        if (b > best) best = b;
+    }
+    return best;
+}
+
+static void alt_query_init(alt_query_t *q, const alt_table_t *t, int src, int dst) {
+    q->t = t;
+    q->n_active = 0;
+    uint64_t score[PATHFIND_ALT_ACTIVE];
+    for (int l = 0; l < t->n_landmarks; l++) {
+        size_t ti = (size_t)dst * (size_t)t->n_landmarks + (size_t)l;
+        uint64_t s = alt_bound_l(t, src, l, t->to[ti], t->from[ti]);
+        /* Keep the PATHFIND_ALT_ACTIVE landmarks with the largest bound. */
+        int pos = q->n_active;
+        if (pos == PATHFIND_ALT_ACTIVE) {
+            if (s <= score[pos - 1]) continue;
+            pos--;
+        } else {
+            q->n_active++;
+        }
+        while (pos > 0 && score[pos - 1] < s) {
+            score[pos] = score[pos - 1];
+            q->active[pos] = q->active[pos - 1];
+            pos--;
+        }
+        score[pos] = s;
+        q->active[pos] = l;
+    }
+    for (int i = 0; i < q->n_active; i++) {
+        size_t ti = (size_t)dst * (size_t)t->n_landmarks + (size_t)q->active[i];
+        q->to_t[i]   = t->to[ti];
+        q->from_t[i] = t->from[ti];
+    }
+}
+
+/*
+ * dijkstra -- single-source search from src, stopping once dst is settled.
+ * penalty (may be NULL) is a per-edge extra cost in msat added to the edge
+ * weight; PENALTY_EXCLUDE skips the edge.  first_edge >= 0 restricts the
+ * source's out-edges to that one (a fixed first hop).
+ * With alt non-NULL the heap is keyed by dist + h(v) (A*); the heuristic is
+ * consistent, so settled nodes are final exactly as in plain Dijkstra.
+ */
+static int dijkstra(graph_t *g,
                     int src, int dst, uint64_t amount_msat,
+                    const uint64_t *penalty,
+                    const alt_query_t *alt,
+                    int first_edge,
                     dijk_node_t *nodes_out) {
+    if (!graph_build_csr(g)) return 0;
+    heap_t h;
+    h.a = (int *)malloc((size_t)g->n_nodes * sizeof(int));
+    if (!h.a) return 0;
+    h.n  = 0;
+    h.dn = nodes_out;
+
     for (int i = 0; i < g->n_nodes; i++) {
         nodes_out[i].dist      = DIST_INF;
+        nodes_out[i].key       = DIST_INF;
         nodes_out[i].prev_edge = -1;
-        nodes_out[i].visited   = 0;
+        nodes_out[i].heap_pos  = -1;
     }
     nodes_out[src].dist = 0;
+    nodes_out[src].key  = alt ? alt_h(alt, src) : 0;
+    heap_set(&h, h.n++, src);
 
-    for (int iter = 0; iter < g->n_nodes; iter++) {
-        /* Find unvisited node with minimum dist */
-        int u = -1;
-        for (int i = 0; i < g->n_nodes; i++) {
-            if (!nodes_out[i].visited && nodes_out[i].dist != DIST_INF) {
-                if (u == -1 || nodes_out[i].dist < nodes_out[u].dist)
-                    u = i;
-            }
-        }
-        if (u == -1 || u == dst) break;
-        nodes_out[u].visited = 1;
+    while (h.n > 0) {
+        int u = heap_pop(&h);
+        if (u == dst) break;
 
         /* Relax outgoing edges */
-        for (int ei = 0; ei < g->n_edges; ei++) {
+        for (int k = g->adj_off[u]; k < g->adj_off[u + 1]; k++) {
+            int ei = g->adj_edge[k];
             const edge_t *e = &g->edges[ei];
-            if (e->from_idx != u) continue;
             int v = e->to_idx;
-            if (nodes_out[v].visited) continue;
+            if (nodes_out[v].heap_pos == -2) continue;
+            if (e->disabled) continue;
+            if (penalty && penalty[ei] == PENALTY_EXCLUDE) continue;
+            if (u == src && first_edge >= 0 && ei != first_edge) continue;
 
             /* HTLC amount constraints */
             if (amount_msat < e->htlc_min_msat) continue;
             if (e->htlc_max_msat > 0 && amount_msat > e->htlc_max_msat) continue;
 
             uint64_t w = edge_cost(e, amount_msat);
+            if (penalty) {
+                w += penalty[ei];
+                if (w < penalty[ei]) w = DIST_INF; /* overflow guard */
+            }
             uint64_t nd = nodes_out[u].dist + w;
             if (nd < nodes_out[u].dist) nd = DIST_INF; /* overflow guard */
             if (nd < nodes_out[v].dist) {
+                uint64_t key = nd;
+                if (alt) {
+                    key = nd + alt_h(alt, v);
+                    if (key < nd) key = DIST_INF;
+                }
                 nodes_out[v].dist      = nd;
+                nodes_out[v].key       = key;
                 nodes_out[v].prev_edge = ei;
+                if (nodes_out[v].heap_pos < 0)
+                    heap_set(&h, h.n++, v);
+                heap_sift_up(&h, nodes_out[v].heap_pos);
             }
         }
     }
+    free(h.a);
     return (nodes_out[dst].dist != DIST_INF) ? 1 : 0;
 }
 
+/* ---- ALT table construction ---- */
+
+/* Plain Dijkstra over a standalone CSR (off/tgt/w), full settle. */
+static void sssp_full(int n, const int *off, const int *tgt, const uint64_t *w,
+                      int src, dijk_node_t *dn, int *heap_buf) {
+    heap_t h = { heap_buf, 0, dn };
+    for (int i = 0; i < n; i++) {
+        dn[i].dist = dn[i].key = DIST_INF;
+        dn[i].prev_edge = -1;
+        dn[i].heap_pos  = -1;
+    }
+    dn[src].dist = dn[src].key = 0;
+    heap_set(&h, h.n++, src);
+    while (h.n > 0) {
+        int u = heap_pop(&h);
+        for (int k = off[u]; k < off[u + 1]; k++) {
+            int v = tgt[k];
+            if (dn[v].heap_pos == -2) continue;
+            uint64_t nd = dn[u].dist + w[k];
+            if (nd < dn[v].dist) {
+                dn[v].dist = dn[v].key = nd;
+                if (dn[v].heap_pos < 0) heap_set(&h, h.n++, v);
+                heap_sift_up(&h, dn[v].heap_pos);
+            }
+        }
+    }
+}
+
+/* Snapshot of the graph topology with reference-amount weights. */
+typedef struct {
+    int       n_nodes, n_edges;
+    uint64_t  epoch;
+    int      *from, *to;
+    uint64_t *w;
+} alt_snap_t;
+
+static void alt_snap_free(alt_snap_t *s) {
+    free(s->from); free(s->to); free(s->w);
+}
+
+/* Build a CSR from the snapshot, forward (reverse = 0) or reversed. */
+static int alt_csr(const alt_snap_t *s, int reverse,
+                   int **off_out, int **tgt_out, uint64_t **w_out) {
+    int *off = (int *)calloc((size_t)s->n_nodes + 1, sizeof(int));
+    int *tgt = (int *)malloc((size_t)(s->n_edges ? s->n_edges : 1) * sizeof(int));
+    uint64_t *w = (uint64_t *)malloc((size_t)(s->n_edges ? s->n_edges : 1) * sizeof(uint64_t));
+    if (!off || !tgt || !w) { free(off); free(tgt); free(w); return 0; }
+    for (int i = 0; i < s->n_edges; i++)
+        off[(reverse ? s->to[i] : s->from[i]) + 1]++;
+    for (int u = 0; u < s->n_nodes; u++)
+        off[u + 1] += off[u];
+    for (int i = 0; i < s->n_edges; i++) {
+        int u = reverse ? s->to[i] : s->from[i];
+        int k = off[u]++;
+        tgt[k] = reverse ? s->from[i] : s->to[i];
+        w[k]   = s->w[i];
+    }
+    for (int u = s->n_nodes; u > 0; u--)
+        off[u] = off[u - 1];
+    off[0] = 0;
+    *off_out = off; *tgt_out = tgt; *w_out = w;
+    return 1;
+}
+
+static uint32_t alt_clamp(uint64_t d) {
+    return (d >= (uint64_t)ALT_INF) ? ALT_INF : (uint32_t)d;
+}
+
+/*
+ * Compute a landmark table from a snapshot (no graph lock held).
+ * Landmarks: highest-degree node first, then repeatedly the node farthest
+ * from all landmarks chosen so far ("farthest" selection), which spreads
+ * them around the periphery where their bounds are tightest.
+ */
+static alt_table_t *alt_compute(const alt_snap_t *s, int n_landmarks,
+                                uint64_t ref_amount_msat) {
+    int n = s->n_nodes;
+    if (n == 0 || n_landmarks <= 0) return NULL;
+    if (n_landmarks > n) n_landmarks = n;
+
+    alt_table_t *t = (alt_table_t *)calloc(1, sizeof(*t));
+    int *foff = NULL, *ftgt = NULL, *roff = NULL, *rtgt = NULL;
+    uint64_t *fw = NULL, *rw = NULL, *mind = NULL;
+    dijk_node_t *dn = (dijk_node_t *)malloc((size_t)n * sizeof(dijk_node_t));
+    int *heap_buf = (int *)malloc((size_t)n * sizeof(int));
+    int ok = t && dn && heap_buf &&
+             alt_csr(s, 0, &foff, &ftgt, &fw) && alt_csr(s, 1, &roff, &rtgt, &rw);
+    if (ok) {
+        t->landmark = (int *)malloc((size_t)n_landmarks * sizeof(int));
+        t->to   = (uint32_t *)malloc((size_t)n * (size_t)n_landmarks * sizeof(uint32_t));
+        t->from = (uint32_t *)malloc((size_t)n * (size_t)n_landmarks * sizeof(uint32_t));
+        mind    = (uint64_t *)malloc((size_t)n * sizeof(uint64_t));
+        ok = t->landmark && t->to && t->from && mind;
+    }
+    if (!ok) goto fail;
+
+    t->n_landmarks     = n_landmarks;
+    t->n_nodes         = n;
+    t->epoch           = s->epoch;
+    t->ref_amount_msat = ref_amount_msat;
+
+    int next = 0;
+    for (int v = 1; v < n; v++) {
+        int dv = (foff[v + 1] - foff[v]) + (roff[v + 1] - roff[v]);
+        int db = (foff[next + 1] - foff[next]) + (roff[next + 1] - roff[next]);
+        if (dv > db) next = v;
+    }
+    for (int v = 0; v < n; v++) mind[v] = DIST_INF;
+
+    for (int l = 0; l < n_landmarks; l++) {
+        t->landmark[l] = next;
+        sssp_full(n, foff, ftgt, fw, next, dn, heap_buf);
+        for (int v = 0; v < n; v++) {
+            t->from[(size_t)v * (size_t)n_landmarks + (size_t)l] = alt_clamp(dn[v].dist);
+            if (dn[v].dist < mind[v]) mind[v] = dn[v].dist;
+        }
+        sssp_full(n, roff, rtgt, rw, next, dn, heap_buf);
+        for (int v = 0; v < n; v++)
+            t->to[(size_t)v * (size_t)n_landmarks + (size_t)l] = alt_clamp(dn[v].dist);
+
+        /* Farthest node from every chosen landmark; nodes no landmark
+         * reaches yet (other components) come first. */
+        mind[next] = 0;
+        int best = -1;
+        for (int v = 0; v < n; v++) {
+            if (mind[v] == 0 || foff[v + 1] - foff[v] + roff[v + 1] - roff[v] == 0)
+                continue;
+            if (best < 0 || mind[v] > mind[best]) best = v;
+        }
+        if (best < 0) { t->n_landmarks = l + 1; break; }
+        next = best;
+    }
+    if (t->n_landmarks < n_landmarks) {
+        /* Fewer usable landmarks than asked: repack rows. */
+        int k = t->n_landmarks;
+        for (int v = 0; v < n; v++)
+            for (int l = 0; l < k; l++) {
+                t->to[(size_t)v * (size_t)k + (size_t)l] =
+                    t->to[(size_t)v * (size_t)n_landmarks + (size_t)l];
+                t->from[(size_t)v * (size_t)k + (size_t)l] =
+                    t->from[(size_t)v * (size_t)n_landmarks + (size_t)l];
+            }
+    }
+
+    free(foff); free(ftgt); free(fw); free(roff); free(rtgt); free(rw);
+    free(mind); free(dn); free(heap_buf);
+    return t;
+
+fail:
+    free(foff); free(ftgt); free(fw); free(roff); free(rtgt); free(rw);
+    free(mind); free(dn); free(heap_buf);
+    alt_free(t);
+    return NULL;
+}
+
 /* ---- Extract path ---- */
 static int extract_path(const graph_t *g, const dijk_node_t *dn,
                          int src, int dst,
@@ -217,7 +889,8 @@ static int extract_path(const graph_t *g, const dijk_node_t *dn,
         const edge_t *e = &g->edges[path_edges[i]];
         pathfind_hop_t *hop = &out->hops[i];
         hop->scid             = e->scid;
-        memcpy(hop->node_id, g->nodes[e->to_idx].pubkey, 33);
+        hop->direction        = e->dir;
+        memcpy(hop->node_id, g->pubkeys[e->to_idx], 33);
         hop->fee_base_msat    = e->fee_base_msat;
         hop->fee_ppm          = e->fee_ppm;
         hop->cltv_expiry_delta = e->cltv_delta;
@@ -234,6 +907,449 @@ static int extract_path(const graph_t *g, const dijk_node_t *dn,
     return 1;
 }
 
+/* Resolve endpoints, run Dijkstra and extract the route. */
+static int route_on_graph(graph_t *g,
+                          const unsigned char our_node[33],
+                          const unsigned char dest_pubkey[33],
+                          uint64_t amount_msat,
+                          const uint64_t *penalty,
+                          pathfind_route_t *out) {
+    int src = node_find(g, our_node);
+    int dst = node_find(g, dest_pubkey);
+    if (src < 0 || dst < 0 || src == dst) return 0;
+
+    dijk_node_t *dn = (dijk_node_t *)malloc((size_t)g->n_nodes * sizeof(dijk_node_t));
+    if (!dn) return 0;
+
+    alt_query_t q;
+    const alt_query_t *alt = NULL;
+    if (alt_usable(g, src, dst, amount_msat)) {
+        alt_query_init(&q, g->alt, src, dst);
+        alt = &q;
+    }
+
+    int ok = dijkstra(g, src, dst, amount_msat, penalty, alt, -1, dn);
+    if (ok) ok = extract_path(g, dn, src, dst, amount_msat, out);
+
+    free(dn);
+    return ok;
+}
+
+/* Channel capacity for liquidity estimates: the announced capacity, else
+ * the edge's htlc_maximum_msat (0 = unknown). */
+static uint64_t edge_cap_msat(const chan_t *c, const edge_t *e) {
+    return c->capacity_sat ? c->capacity_sat * 1000ULL : e->htlc_max_msat;
+}
+
+/*
+ * Per-edge mission-control penalties for amount_msat (malloc'd, NULL on
+ * OOM).  Every edge costs an extra mc_probability_cost_msat() of its
+ * success probability -- the capacity prior, narrowed by mc's liquidity
+ * bounds where it has history -- so the search trades fees against the
+ * chance each hop can carry the amount.  Channels mc currently penalises
+ * are excluded in both directions.  The penalties only ever add cost, so
+ * ALT bounds stay valid.
+ */
+static uint64_t *mc_penalties(const graph_t *g, uint64_t amount_msat,
+                              uint32_t current_height, mc_table_t *mc) {
+    uint64_t *penalty = (uint64_t *)malloc((size_t)(g->n_edges ? g->n_edges : 1) *
+                                           sizeof(uint64_t));
+    if (!penalty) return NULL;
+
+    /* Capacity prior for every edge (htlc_maximum_msat if no capacity). */
+    for (int ci = 0; ci < g->n_chans; ci++) {
+        const chan_t *c = &g->chans[ci];
+        for (int d = 0; d < 2; d++) {
+            int ei = c->edge[d];
+            if (ei < 0) continue;
+            uint32_t p = mc_success_probability_ppm(NULL, c->scid, d, amount_msat,
+                                                    edge_cap_msat(c, &g->edges[ei]),
+                                                    current_height);
+            penalty[ei] = mc_probability_cost_msat(p, amount_msat);
+        }
+    }
+
+    /* Observed channels: penalised ones out, the rest by their bounds. */
+    for (int i = 0; i < mc->count; i++) {
+        const mc_entry_t *m = &mc->entries[i];
+        const chan_t *c = chan_find(g, m->scid);
+        if (!c) continue;
+        if (mc_is_penalized(mc, m->scid, m->direction, amount_msat,
+                            current_height)) {
+            if (c->edge[0] >= 0) penalty[c->edge[0]] = PENALTY_EXCLUDE;
+            if (c->edge[1] >= 0) penalty[c->edge[1]] = PENALTY_EXCLUDE;
+            continue;
+        }
+        int ei = c->edge[m->direction & 1];
+        if (ei < 0 || penalty[ei] == PENALTY_EXCLUDE) continue;
+        uint32_t p = mc_success_probability_ppm(mc, m->scid, m->direction,
+                                                amount_msat,
+                                                edge_cap_msat(c, &g->edges[ei]),
+                                                current_height);
+        penalty[ei] = mc_probability_cost_msat(p, amount_msat);
+    }
+    return penalty;
+}
+
+/* Route with mission-control penalties (see mc_penalties). */
+static int route_on_graph_mc(graph_t *g,
+                             const unsigned char our_node[33],
+                             const unsigned char dest_pubkey[33],
+                             uint64_t amount_msat,
+                             uint32_t current_height,
+                             mc_table_t *mc,
+                             pathfind_route_t *out) {
+    uint64_t *penalty = mc_penalties(g, amount_msat, current_height, mc);
+    if (!penalty) return 0;
+    int ok = route_on_graph(g, our_node, dest_pubkey, amount_msat, penalty, out);
+    free(penalty);
+    return ok;
+}
+
+/* ---- Multi-part payment planning ----
+ *
+ * Candidates are the cheapest route through each of the source's cheapest
+ * first hops (Yen-style: fix the prefix, search the rest), plus the
+ * cheapest route overall.  The searches are independent and run on a
+ * worker pool over the graph, which stays frozen for the whole plan (lock
+ * held, or a private graph), so a plan costs about one search.  Routes are
+ * taken in cost order while channel-disjoint from those already chosen;
+ * candidates that collided are searched again with the chosen channels
+ * excluded.  Amounts follow each route's bottleneck liquidity.
+ */
+
+#define MPP_MAX_WORKERS     8
+#define MPP_MAX_CANDIDATES 16   /* searches per round */
+#define MPP_ROUNDS          3
+
+typedef struct {
+    int              first_edge;    /* forced first hop, -1 = free */
+    int              ok;
+    uint64_t         cost;
+    pathfind_route_t route;
+} mpp_cand_t;
+
+typedef struct {
+    graph_t           *g;
+    int                src, dst;
+    uint64_t           amount_msat;
+    const uint64_t    *penalty;
+    const alt_query_t *alt;
+    mpp_cand_t        *cands;
+    int                n_cands;
+    int                next;
+    pthread_mutex_t    lock;
+} mpp_pool_t;
+
+static void *mpp_worker(void *arg) {
+    mpp_pool_t *p = (mpp_pool_t *)arg;
+    dijk_node_t *dn = (dijk_node_t *)malloc((size_t)p->g->n_nodes * sizeof(dijk_node_t));
+    if (!dn) return NULL;
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        int i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+        if (i >= p->n_cands) break;
+        mpp_cand_t *c = &p->cands[i];
+        c->ok = dijkstra(p->g, p->src, p->dst, p->amount_msat, p->penalty,
+                         p->alt, c->first_edge, dn) &&
+                extract_path(p->g, dn, p->src, p->dst, p->amount_msat, &c->route);
+        c->cost = c->ok ? dn[p->dst].dist : DIST_INF;
+    }
+    free(dn);
+    return NULL;
+}
+
+/* Run every candidate search; the calling thread takes a share too. */
+static void mpp_run(mpp_pool_t *p) {
+    for (int i = 0; i < p->n_cands; i++) p->cands[i].ok = 0;
+    p->next = 0;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int n_helpers = (ncpu < 1 ? 1 : ncpu > MPP_MAX_WORKERS ? MPP_MAX_WORKERS : (int)ncpu);
+    if (n_helpers > p->n_cands) n_helpers = p->n_cands;
+    n_helpers--;
+
+    pthread_t tids[MPP_MAX_WORKERS];
+    int started = 0;
+    for (int i = 0; i < n_helpers; i++)
+        if (pthread_create(&tids[started], NULL, mpp_worker, p) == 0)
+            started++;
+    mpp_worker(p);
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+}
+
+static int cand_cmp(const void *a, const void *b) {
+    const mpp_cand_t *x = (const mpp_cand_t *)a, *y = (const mpp_cand_t *)b;
+    if (x->ok != y->ok) return x->ok ? -1 : 1;
+    if (x->cost != y->cost) return x->cost < y->cost ? -1 : 1;
+    return x->first_edge - y->first_edge;
+}
+
+/* Edge a route hop used, or -1 if its channel is gone. */
+static int hop_edge(const graph_t *g, const pathfind_hop_t *h) {
+    const chan_t *c = chan_find(g, h->scid);
+    return c ? c->edge[h->direction & 1] : -1;
+}
+
+/* Smallest liquidity upper bound along a route; UINT64_MAX if unknown. */
+static uint64_t route_bottleneck(const graph_t *g, const pathfind_route_t *r,
+                                 mc_table_t *mc, uint32_t now_unix) {
+    uint64_t b = UINT64_MAX;
+    for (int i = 0; i < r->n_hops; i++) {
+        const pathfind_hop_t *h = &r->hops[i];
+        const chan_t *c = chan_find(g, h->scid);
+        int ei = c ? c->edge[h->direction & 1] : -1;
+        if (ei < 0) continue;
+        const edge_t *e = &g->edges[ei];
+        uint64_t hi;
+        mc_liquidity_bounds(mc, h->scid, h->direction, edge_cap_msat(c, e),
+                            now_unix, NULL, &hi);
+        if (e->htlc_max_msat && e->htlc_max_msat < hi) hi = e->htlc_max_msat;
+        if (hi < b) b = hi;
+    }
+    return b;
+}
+
+/* Split total in proportion to bottlenecks (unknown ones count as the
+ * largest known; all unknown = equal shares); rounding goes to the widest. */
+static void mpp_split(uint64_t total, const uint64_t *caps, int n, uint64_t *out) {
+    uint64_t known_max = 0;
+    for (int i = 0; i < n; i++)
+        if (caps[i] != UINT64_MAX && caps[i] > known_max) known_max = caps[i];
+
+    /* Weights scaled below 2^20 so the products below cannot overflow. */
+    int shift = 0;
+    while ((known_max >> shift) >= (1u << 20)) shift++;
+    uint64_t w[PATHFIND_MPP_MAX_PARTS], sum = 0;
+    int widest = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t c = (caps[i] == UINT64_MAX || known_max == 0) ? known_max : caps[i];
+        w[i] = known_max ? (c >> shift) : 1;
+        if (w[i] == 0) w[i] = 1;
+        if (w[i] > w[widest]) widest = i;
+        sum += w[i];
+    }
+    uint64_t given = 0;
+    for (int i = 0; i < n; i++) {
+        out[i] = total / sum * w[i] + total % sum * w[i] / sum;
+        given += out[i];
+    }
+    out[widest] += total - given;
+}
+
+/* Route fee for delivering amt (ppm term split so it cannot overflow). */
+static uint64_t route_fee_at(const pathfind_route_t *r, uint64_t amt) {
+    uint64_t fee = 0;
+    for (int h = 0; h < r->n_hops; h++) {
+        const pathfind_hop_t *hp = &r->hops[h];
+        fee += hp->fee_base_msat + amt / 1000000ULL * hp->fee_ppm +
+               amt % 1000000ULL * hp->fee_ppm / 1000000ULL;
+    }
+    return fee;
+}
+
+/* Largest part a route can deliver: its bottleneck less the route fee at
+ * that amount, so every hop's forwarded amount (the part plus the fees
+ * still to be paid downstream) stays within the hop's bound. */
+static uint64_t route_part_cap(const pathfind_route_t *r, uint64_t bottleneck) {
+    if (bottleneck == UINT64_MAX) return UINT64_MAX;
+    uint64_t fee = route_fee_at(r, bottleneck);
+    return bottleneck > fee ? bottleneck - fee : 0;
+}
+
+/* Smallest part every hop accepts (largest htlc_minimum_msat). */
+static uint64_t route_part_floor(const pathfind_route_t *r) {
+    uint64_t f = 0;
+    for (int h = 0; h < r->n_hops; h++)
+        if (r->hops[h].htlc_min_msat > f) f = r->hops[h].htlc_min_msat;
+    return f;
+}
+
+/* Split total over n routes in proportion to their caps, then move what
+ * exceeds a route's cap onto the routes with room left, in proportion to
+ * that room, until nothing exceeds.  Returns 0 if the caps cannot hold
+ * total. */
+static int mpp_fill(uint64_t total, const uint64_t *caps, int n, uint64_t *out) {
+    uint64_t room = 0;
+    for (int i = 0; i < n; i++)
+        room = (caps[i] > UINT64_MAX - room) ? UINT64_MAX : room + caps[i];
+    if (room < total) return 0;
+
+    int full[PATHFIND_MPP_MAX_PARTS];
+    for (int i = 0; i < n; i++) {
+        out[i] = 0;
+        full[i] = caps[i] == 0;
+    }
+    uint64_t left = total;
+    while (left > 0) {
+        uint64_t sub_caps[PATHFIND_MPP_MAX_PARTS], sub[PATHFIND_MPP_MAX_PARTS];
+        int idx[PATHFIND_MPP_MAX_PARTS], m = 0;
+        for (int i = 0; i < n; i++) {
+            if (full[i]) continue;
+            idx[m] = i;
+            sub_caps[m++] = caps[i] == UINT64_MAX ? UINT64_MAX : caps[i] - out[i];
+        }
+        if (m == 0) return 0;
+        mpp_split(left, sub_caps, m, sub);
+        left = 0;
+        for (int k = 0; k < m; k++) {
+            int i = idx[k];
+            out[i] += sub[k];
+            if (out[i] >= caps[i]) {
+                left += out[i] - caps[i];
+                out[i] = caps[i];
+                full[i] = 1;
+            }
+        }
+    }
+    return 1;
+}
+
+static int mpp_plan(graph_t *g,
+                    const unsigned char our_node[33],
+                    const unsigned char dest_pubkey[33],
+                    uint64_t total_msat, int max_parts,
+                    uint32_t now_unix, mc_table_t *mc,
+                    pathfind_route_t *routes_out, uint64_t *amounts_out) {
+    int src = node_find(g, our_node);
+    int dst = node_find(g, dest_pubkey);
+    if (src < 0 || dst < 0 || src == dst) return 0;
+    if (!graph_build_csr(g)) return 0;
+
+    uint64_t shard = total_msat / (uint64_t)max_parts;
+    if (shard == 0) shard = 1;
+
+    uint64_t *penalty = mc ? mc_penalties(g, shard, now_unix, mc)
+                           : (uint64_t *)calloc((size_t)(g->n_edges ? g->n_edges : 1),
+                                                sizeof(uint64_t));
+    mpp_cand_t *cands = (mpp_cand_t *)malloc(MPP_MAX_CANDIDATES * sizeof(mpp_cand_t));
+    if (!penalty || !cands) { free(penalty); free(cands); return 0; }
+
+    /* Round 0: one search through each of the cheapest usable first hops
+     * (half again as many as parts), plus a free search if any first hop
+     * was left out, so the best route overall is always a candidate. */
+    int limit = max_parts > 1 ? max_parts + max_parts / 2 : 0;
+    if (limit > MPP_MAX_CANDIDATES - 1) limit = MPP_MAX_CANDIDATES - 1;
+    int n = 0, n_usable = 0;
+    uint64_t first_cost[MPP_MAX_CANDIDATES];
+    for (int k = g->adj_off[src]; k < g->adj_off[src + 1]; k++) {
+        int ei = g->adj_edge[k];
+        const edge_t *e = &g->edges[ei];
+        if (e->disabled || penalty[ei] == PENALTY_EXCLUDE) continue;
+        if (shard < e->htlc_min_msat) continue;
+        if (e->htlc_max_msat > 0 && shard > e->htlc_max_msat) continue;
+        n_usable++;
+        if (limit == 0) continue;
+        uint64_t fc = edge_cost(e, shard) + penalty[ei];
+        int pos = n;
+        if (pos == limit) {
+            if (fc >= first_cost[pos - 1]) continue;
+            pos--;
+        } else {
+            n++;
+        }
+        while (pos > 0 && first_cost[pos - 1] > fc) {
+            first_cost[pos] = first_cost[pos - 1];
+            cands[pos] = cands[pos - 1];
+            pos--;
+        }
+        first_cost[pos] = fc;
+        cands[pos].first_edge = ei;
+    }
+    if (n_usable > n) cands[n++].first_edge = -1;
+
+    alt_query_t q;
+    const alt_query_t *alt = NULL;
+    if (alt_usable(g, src, dst, shard)) {
+        alt_query_init(&q, g->alt, src, dst);
+        alt = &q;
+    }
+
+    mpp_pool_t pool;
+    pool.g = g;
+    pool.src = src;
+    pool.dst = dst;
+    pool.amount_msat = shard;
+    pool.penalty = penalty;
+    pool.alt = alt;
+    pool.cands = cands;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    int chosen = 0;
+    int free_first = -1;        /* first hop of the unconstrained route */
+    for (int round = 0; round < MPP_ROUNDS && n > 0 && chosen < max_parts; round++) {
+        pool.n_cands = n;
+        mpp_run(&pool);
+        if (round == 0 && cands[n - 1].first_edge < 0 && cands[n - 1].ok)
+            free_first = hop_edge(g, &cands[n - 1].route.hops[0]);
+        qsort(cands, (size_t)n, sizeof(mpp_cand_t), cand_cmp);
+
+        int retry = 0;
+        for (int i = 0; i < n && cands[i].ok; i++) {
+            mpp_cand_t *c = &cands[i];
+            /* The forced search through the free route's first hop
+             * duplicates it. */
+            if (c->first_edge >= 0 && c->first_edge == free_first && round == 0)
+                continue;
+            int clash = 0;
+            for (int h = 0; h < c->route.n_hops && !clash; h++) {
+                int ei = hop_edge(g, &c->route.hops[h]);
+                clash = ei < 0 || penalty[ei] == PENALTY_EXCLUDE;
+            }
+            if (clash) {
+                /* Re-search through the same first hop, avoiding the
+                 * channels already taken. */
+                if (c->first_edge >= 0 && penalty[c->first_edge] != PENALTY_EXCLUDE)
+                    cands[retry++].first_edge = c->first_edge;
+                continue;
+            }
+            if (chosen == max_parts) continue;
+            routes_out[chosen++] = c->route;
+            for (int h = 0; h < c->route.n_hops; h++) {
+                const chan_t *ch = chan_find(g, c->route.hops[h].scid);
+                if (ch->edge[0] >= 0) penalty[ch->edge[0]] = PENALTY_EXCLUDE;
+                if (ch->edge[1] >= 0) penalty[ch->edge[1]] = PENALTY_EXCLUDE;
+            }
+        }
+        n = retry;
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    /* Routes were searched at total / max_parts; their final amounts must
+     * fit each route's bottleneck and meet its htlc minimums.  A route
+     * whose share falls below its floor is dropped and the rest refilled;
+     * if the remaining routes cannot carry the total, there is no plan. */
+    if (chosen > 0 && amounts_out) {
+        uint64_t caps[PATHFIND_MPP_MAX_PARTS];
+        for (int i = 0; i < chosen; i++)
+            caps[i] = route_part_cap(&routes_out[i],
+                                     route_bottleneck(g, &routes_out[i], mc, now_unix));
+        while (chosen > 0) {
+            if (!mpp_fill(total_msat, caps, chosen, amounts_out)) {
+                chosen = 0;
+                break;
+            }
+            int drop = -1;
+            for (int i = 0; i < chosen; i++)
+                if (amounts_out[i] < route_part_floor(&routes_out[i]) &&
+                    (drop < 0 || amounts_out[i] < amounts_out[drop]))
+                    drop = i;
+            if (drop < 0) break;
+            for (int i = drop; i + 1 < chosen; i++) {
+                routes_out[i] = routes_out[i + 1];
+                caps[i] = caps[i + 1];
+            }
+            chosen--;
+        }
+        for (int i = 0; i < chosen; i++)
+            routes_out[i].total_fee_msat = route_fee_at(&routes_out[i], amounts_out[i]);
+    }
+    free(penalty);
+    free(cands);
+    return chosen;
+}
+
 /* ---- Public API ---- */
 
 int pathfind_route(gossip_store_t *gs,
@@ -243,25 +1359,11 @@ int pathfind_route(gossip_store_t *gs,
                    pathfind_route_t *out) {
     if (!gs || !our_node || !dest_pubkey || !out || amount_msat == 0) return 0;
 
-    graph_t *g = (graph_t *)malloc(sizeof(graph_t));
-    if (!g) return 0;
-    if (!load_graph(gs, g)) { free(g); return 0; }
-
-    int src = -1, dst = -1;
-    for (int i = 0; i < g->n_nodes; i++) {
-        if (memcmp(g->nodes[i].pubkey, our_node, 33) == 0)  src = i;
-        if (memcmp(g->nodes[i].pubkey, dest_pubkey, 33) == 0) dst = i;
-    }
-    if (src < 0 || dst < 0 || src == dst) { free(g); return 0; }
-
-    dijk_node_t *dn = (dijk_node_t *)malloc(g->n_nodes * sizeof(dijk_node_t));
-    if (!dn) { free(g); return 0; }
-
-    int ok = dijkstra(g, src, dst, amount_msat, dn);
-    if (ok) ok = extract_path(g, dn, src, dst, amount_msat, out);
-
-    free(dn);
-    free(g);
+    graph_t g;
+    memset(&g, 0, sizeof(g));
+    int ok = load_graph(gs, &g) &&
+             route_on_graph(&g, our_node, dest_pubkey, amount_msat, NULL, out);
+    graph_release(&g);
     return ok;
 }
 
@@ -274,23 +1376,23 @@ int pathfind_mpp_routes(gossip_store_t *gs,
                         int max_out) {
     if (!gs || !our_node || !dest_pubkey || !routes_out || max_paths <= 0) return 0;
     if (max_paths > max_out) max_paths = max_out;
-
-    uint64_t shard = total_msat / (uint64_t)max_paths;
-    if (shard == 0) shard = 1;
-
-    int found = 0;
-    for (int i = 0; i < max_paths; i++) {
-        if (pathfind_route(gs, our_node, dest_pubkey, shard, &routes_out[found]))
-            found++;
-    }
+    if (max_paths > PATHFIND_MPP_MAX_PARTS) max_paths = PATHFIND_MPP_MAX_PARTS;
+
+    graph_t g;
+    memset(&g, 0, sizeof(g));
+    int found = load_graph(gs, &g)
+              ? mpp_plan(&g, our_node, dest_pubkey, total_msat, max_paths,
+                         0, NULL, routes_out, NULL)
+              : 0;
+    graph_release(&g);
     return found;
 }
 
-/* ---- pathfind_route_ex: route with MC exclusion ---- */
 /*
- * Runs Dijkstra over the gossip graph, skipping edges whose (scid, direction)
- * is currently penalised by mc.  This lets the router avoid failed channels
- * on the INITIAL route attempt rather than only on retries.
+ * Runs Dijkstra over the gossip graph, skipping edges whose scid is
+ * currently penalised by mc (in either direction).  This lets the router
+ * avoid failed channels on the INITIAL route attempt rather than only on
+ * retries.
  */
 int pathfind_route_ex(gossip_store_t *gs,
                       const unsigned char our_node[33],
@@ -306,55 +1408,14 @@ int pathfind_route_ex(gossip_store_t *gs,
 
     if (!gs || !our_node || !dest_pubkey || !out || amount_msat == 0) return 0;
 
-    /* Build exclusion list from mission control */
-    pathfind_exclude_t ex;
-    pathfind_exclude_init(&ex);
-    pathfind_exclude_from_mc(&ex, mc, amount_msat, current_height);
-
     /* Load graph */
-    graph_t *g = (graph_t *)malloc(sizeof(graph_t));
-    if (!g) return 0;
-    if (!load_graph(gs, g)) { free(g); return 0; }
-
-    int src = -1, dst = -1;
-    for (int i = 0; i < g->n_nodes; i++) {
-        if (memcmp(g->nodes[i].pubkey, our_node,    33) == 0) src = i;
-        if (memcmp(g->nodes[i].pubkey, dest_pubkey, 33) == 0) dst = i;
-    }
-    if (src < 0 || dst < 0 || src == dst) { free(g); return 0; }
+    graph_t g;
+    memset(&g, 0, sizeof(g));
+    if (!load_graph(gs, &g)) { graph_release(&g); return 0; }
 
-    /* Mark excluded edges so Dijkstra skips them.
-     * We temporarily set htlc_max_msat=0 for excluded edges; Dijkstra
-     * already skips edges where amount_msat > htlc_max_msat > 0.
-     * We save/restore to avoid corrupting the graph for future calls.
-     */
-    uint64_t saved_max[MAX_EDGES];
-    for (int ei = 0; ei < g->n_edges; ei++) {
-        edge_t *e = &g->edges[ei];
-        saved_max[ei] = e->htlc_max_msat;
-        /* Determine direction for this edge: direction 0 means from < to */
-        int dir = (e->from_idx < e->to_idx) ? 0 : 1;
-        if (pathfind_exclude_is_excluded(&ex, e->scid, dir) ||
-            pathfind_exclude_is_excluded(&ex, e->scid, 1 - dir) ||
-            pathfind_exclude_is_excluded(&ex, e->scid, -1)) {
-            /* Poison edge: set max below amount so Dijkstra skips it */
-            e->htlc_max_msat = (amount_msat > 0) ? (amount_msat - 1) : 0;
-        }
-    }
-
-    dijk_node_t *dn = (dijk_node_t *)malloc(g->n_nodes * sizeof(dijk_node_t));
-    int ok = 0;
-    if (dn) {
-        ok = dijkstra(g, src, dst, amount_msat, dn);
-        if (ok) ok = extract_path(g, dn, src, dst, amount_msat, out);
-        free(dn);
-    }
-
-    /* Restore poisoned edge max values */
-    for (int ei = 0; ei < g->n_edges; ei++)
-        g->edges[ei].htlc_max_msat = saved_max[ei];
-
-    free(g);
+    int ok = route_on_graph_mc(&g, our_node, dest_pubkey, amount_msat,
+                               current_height, mc, out);
+    graph_release(&g);
     return ok;
 }
 
@@ -362,13 +1423,31 @@ int pathfind_route_ex(gossip_store_t *gs,
 
 pathfind_graph_t *pathfind_graph_alloc(void) {
     graph_t *g = (graph_t *)calloc(1, sizeof(graph_t));
+    if (!g) return NULL;
+    if (pthread_mutex_init(&g->lock, NULL) != 0) { free(g); return NULL; }
+    if (pthread_cond_init(&g->alt_cond, NULL) != 0) {
+        pthread_mutex_destroy(&g->lock);
+        free(g);
+        return NULL;
+    }
+    g->has_lock = 1;
     return (pathfind_graph_t *)g;
 }
 
 void pathfind_graph_free(pathfind_graph_t *g) {
+    if (!g) return;
+    pathfind_graph_alt_stop(g);
+    graph_release((graph_t *)g);
+    if (g->has_lock) {
+        pthread_cond_destroy(&g->alt_cond);
+        pthread_mutex_destroy(&g->lock);
+    }
     free(g);
 }
 
+static void graph_lock(graph_t *g)   { if (g->has_lock) pthread_mutex_lock(&g->lock); }
+static void graph_unlock(graph_t *g) { if (g->has_lock) pthread_mutex_unlock(&g->lock); }
+
 /*
  * pathfind_graph_load_from_gossip — populate a graph from live gossip data.
  *
@@ -379,11 +1458,6 @@ void pathfind_graph_free(pathfind_graph_t *g) {
  * Returns number of directed edges loaded, or -1 on error.
  */
 
-typedef struct {
-    graph_t *g;
-    int      count;
-} load_ctx_t;
-
 static void load_edge_cb(uint64_t scid,
                           const unsigned char src_pubkey[33],
                           const unsigned char dst_pubkey[33],
@@ -396,40 +1470,301 @@ static void load_edge_cb(uint64_t scid,
                           void *ctx)
 {
     load_ctx_t *lc = (load_ctx_t *)ctx;
-    graph_t    *g  = lc->g;
-
-    (void)capacity_sat; /* already encoded in htlc_max_msat */
 
-    int idx_src = node_find_or_add(g, src_pubkey);
-    int idx_dst = node_find_or_add(g, dst_pubkey);
-    if (idx_src < 0 || idx_dst < 0) return;
-    if (g->n_edges >= MAX_EDGES) return;
-
-    edge_t *e       = &g->edges[g->n_edges++];
-    e->scid         = scid;
-    e->from_idx     = idx_src;
-    e->to_idx       = idx_dst;
-    e->fee_base_msat = fee_base_msat;
-    e->fee_ppm      = fee_ppm;
-    e->cltv_delta   = cltv_delta;
-    e->htlc_min_msat = htlc_min_msat;
-    e->htlc_max_msat = htlc_max_msat;
-
-    lc->count++;
+    if (graph_upsert_edge(lc->g, scid, src_pubkey, dst_pubkey,
+                          fee_base_msat, fee_ppm, cltv_delta,
+                          htlc_min_msat, htlc_max_msat)) {
+        chan_t *c = chan_find(lc->g, scid);
+        if (c) c->capacity_sat = capacity_sat;
+        lc->count++;
+    }
 }
 
 int pathfind_graph_load_from_gossip(pathfind_graph_t *g, gossip_store_t *gs)
 {
     if (!g || !gs) return -1;
+    graph_lock(g);
     /* Clear the graph */
-    memset(g, 0, sizeof(graph_t));
+    graph_clear(g);
 
-    load_ctx_t lc = { (graph_t *)g, 0 };
+    load_ctx_t lc = { g, 0 };
     int ret = gossip_store_enumerate_channels(gs, load_edge_cb, &lc);
+    graph_unlock(g);
     if (ret < 0) return -1;
     return lc.count;
 }
 
+int pathfind_graph_load_from_log(pathfind_graph_t *g, gossip_log_t *gl)
+{
+    if (!g || !gl) return -1;
+    graph_lock(g);
+    graph_clear(g);
+
+    load_ctx_t lc = { g, 0 };
+    int ret = gossip_log_enumerate_channels(gl, load_edge_cb, &lc);
+    graph_unlock(g);
+    if (ret < 0) return -1;
+    return lc.count;
+}
+
+/* ---- Live graph maintenance (driven by gossip_ingest) ---- */
+
+int pathfind_graph_add_channel(pathfind_graph_t *g, uint64_t scid,
+                               const unsigned char node1[33],
+                               const unsigned char node2[33],
+                               uint64_t capacity_sat)
+{
+    if (!g || !node1 || !node2) return 0;
+    graph_lock(g);
+    int ok = 0;
+    int n1 = node_find_or_add(g, node1);
+    int n2 = node_find_or_add(g, node2);
+    if (n1 >= 0 && n2 >= 0) {
+        chan_t *c = chan_add(g, scid, n1, n2);
+        if (c) {
+            if (capacity_sat) c->capacity_sat = capacity_sat;
+            ok = 1;
+        }
+    }
+    graph_unlock(g);
+    return ok;
+}
+
+int pathfind_graph_update_channel(pathfind_graph_t *g, uint64_t scid,
+                                  int direction,
+                                  uint32_t fee_base_msat, uint32_t fee_ppm,
+                                  uint16_t cltv_delta,
+                                  uint64_t htlc_min_msat, uint64_t htlc_max_msat,
+                                  int disabled)
+{
+    if (!g || (direction != 0 && direction != 1)) return 0;
+    graph_lock(g);
+    int ok = 0;
+    chan_t *c = chan_find(g, scid);
+    edge_t *e = c ? chan_edge(g, c, direction) : NULL;
+    if (e) {
+        edge_set_fees(g, e, fee_base_msat, fee_ppm, cltv_delta);
+        e->htlc_min_msat = htlc_min_msat;
+        /* No htlc_maximum_msat: fall back to capacity (0 = unlimited). */
+        e->htlc_max_msat = htlc_max_msat ? htlc_max_msat : c->capacity_sat * 1000ULL;
+        e->disabled      = disabled ? 1 : 0;
+        ok = 1;
+    }
+    graph_unlock(g);
+    return ok;
+}
+
+int pathfind_graph_remove_channel(pathfind_graph_t *g, uint64_t scid)
+{
+    if (!g) return 0;
+    graph_lock(g);
+    int ok = chan_remove(g, scid);
+    graph_unlock(g);
+    return ok;
+}
+
+int pathfind_graph_get_channel(pathfind_graph_t *g, uint64_t scid,
+                               unsigned char node1_out[33],
+                               unsigned char node2_out[33],
+                               uint64_t *capacity_out)
+{
+    if (!g) return 0;
+    graph_lock(g);
+    const chan_t *c = chan_find(g, scid);
+    if (c) {
+        if (node1_out)    memcpy(node1_out, g->pubkeys[c->node[0]], 33);
+        if (node2_out)    memcpy(node2_out, g->pubkeys[c->node[1]], 33);
+        if (capacity_out) *capacity_out = c->capacity_sat;
+    }
+    graph_unlock(g);
+    return c != NULL;
+}
+
+int pathfind_graph_has_node(pathfind_graph_t *g, const unsigned char pubkey[33])
+{
+    if (!g || !pubkey) return 0;
+    graph_lock(g);
+    int found = node_find(g, pubkey) >= 0;
+    graph_unlock(g);
+    return found;
+}
+
+void pathfind_graph_counts(pathfind_graph_t *g,
+                           int *n_nodes, int *n_channels, int *n_edges)
+{
+    if (!g) return;
+    graph_lock(g);
+    if (n_nodes)    *n_nodes    = g->n_nodes;
+    if (n_channels) *n_channels = g->n_chans;
+    if (n_edges)    *n_edges    = g->n_edges;
+    graph_unlock(g);
+}
+
+int pathfind_graph_route(pathfind_graph_t *g,
+                         const unsigned char our_node[33],
+                         const unsigned char dest_pubkey[33],
+                         uint64_t amount_msat,
+                         pathfind_route_t *out)
+{
+    if (!g || !our_node || !dest_pubkey || !out || amount_msat == 0) return 0;
+    graph_lock(g);
+    int ok = route_on_graph(g, our_node, dest_pubkey, amount_msat, NULL, out);
+    graph_unlock(g);
+    return ok;
+}
+
+int pathfind_graph_route_ex(pathfind_graph_t *g,
+                            const unsigned char our_node[33],
+                            const unsigned char dest_pubkey[33],
+                            uint64_t amount_msat,
+                            uint32_t current_height,
+                            mc_table_t *mc,
+                            pathfind_route_t *out)
+{
+    if (!mc)
+        return pathfind_graph_route(g, our_node, dest_pubkey, amount_msat, out);
+    if (!g || !our_node || !dest_pubkey || !out || amount_msat == 0) return 0;
+    graph_lock(g);
+    int ok = route_on_graph_mc(g, our_node, dest_pubkey, amount_msat,
+                               current_height, mc, out);
+    graph_unlock(g);
+    return ok;
+}
+
+int pathfind_graph_mpp_plan(pathfind_graph_t *g,
+                            const unsigned char our_node[33],
+                            const unsigned char dest_pubkey[33],
+                            uint64_t total_msat,
+                            int max_parts,
+                            uint32_t now_unix,
+                            mc_table_t *mc,
+                            pathfind_route_t *routes_out,
+                            uint64_t *amounts_out,
+                            int max_out)
+{
+    if (!g || !our_node || !dest_pubkey || !routes_out || !amounts_out ||
+        max_parts <= 0 || total_msat == 0) return 0;
+    if (max_parts > max_out) max_parts = max_out;
+    if (max_parts > PATHFIND_MPP_MAX_PARTS) max_parts = PATHFIND_MPP_MAX_PARTS;
+    graph_lock(g);
+    int n = mpp_plan(g, our_node, dest_pubkey, total_msat, max_parts,
+                     now_unix, mc, routes_out, amounts_out);
+    graph_unlock(g);
+    return n;
+}
+
+/* ---- ALT landmark maintenance ---- */
+
+int pathfind_graph_alt_refresh(pathfind_graph_t *g, int n_landmarks,
+                               uint64_t ref_amount_msat)
+{
+    if (!g || n_landmarks <= 0) return 0;
+    if (n_landmarks > PATHFIND_ALT_MAX_LANDMARKS)
+        n_landmarks = PATHFIND_ALT_MAX_LANDMARKS;
+
+    /* Snapshot topology + reference weights under the lock ... */
+    alt_snap_t snap;
+    memset(&snap, 0, sizeof(snap));
+    graph_lock(g);
+    snap.n_nodes = g->n_nodes;
+    snap.n_edges = g->n_edges;
+    snap.epoch   = g->alt_epoch;
+    size_t ne = (size_t)(g->n_edges ? g->n_edges : 1);
+    snap.from = (int *)malloc(ne * sizeof(int));
+    snap.to   = (int *)malloc(ne * sizeof(int));
+    snap.w    = (uint64_t *)malloc(ne * sizeof(uint64_t));
+    if (snap.from && snap.to && snap.w) {
+        for (int i = 0; i < g->n_edges; i++) {
+            snap.from[i] = g->edges[i].from_idx;
+            snap.to[i]   = g->edges[i].to_idx;
+            snap.w[i]    = edge_cost(&g->edges[i], ref_amount_msat);
+        }
+    }
+    graph_unlock(g);
+    if (!snap.from || !snap.to || !snap.w) { alt_snap_free(&snap); return 0; }
+
+    /* ... compute without it ... */
+    alt_table_t *t = alt_compute(&snap, n_landmarks, ref_amount_msat);
+    alt_snap_free(&snap);
+    if (!t) return 0;
+
+    /* ... and install only if nothing shortened a path meanwhile. */
+    graph_lock(g);
+    int ok = (g->alt_epoch == t->epoch);
+    if (ok) {
+        alt_free(g->alt);
+        g->alt = t;
+    }
+    graph_unlock(g);
+    if (!ok) alt_free(t);
+    return ok;
+}
+
+int pathfind_graph_alt_ready(pathfind_graph_t *g)
+{
+    if (!g) return 0;
+    graph_lock(g);
+    int ready = g->alt && g->alt->epoch == g->alt_epoch;
+    graph_unlock(g);
+    return ready;
+}
+
+static void *alt_worker(void *arg)
+{
+    graph_t *g = (graph_t *)arg;
+    pthread_mutex_lock(&g->lock);
+    while (g->alt_running) {
+        int stale = !g->alt || g->alt->epoch != g->alt_epoch;
+        if (stale && g->n_edges > 0) {
+            int      nl  = g->alt_n_landmarks;
+            uint64_t ref = g->alt_ref_msat;
+            pthread_mutex_unlock(&g->lock);
+            pathfind_graph_alt_refresh(g, nl, ref);
+            pthread_mutex_lock(&g->lock);
+            if (!g->alt_running) break;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec  += g->alt_interval_ms / 1000;
+        ts.tv_nsec += (long)(g->alt_interval_ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+        pthread_cond_timedwait(&g->alt_cond, &g->lock, &ts);
+    }
+    pthread_mutex_unlock(&g->lock);
+    return NULL;
+}
+
+int pathfind_graph_alt_start(pathfind_graph_t *g, int n_landmarks,
+                             uint64_t ref_amount_msat, uint32_t interval_ms)
+{
+    if (!g || !g->has_lock || n_landmarks <= 0) return 0;
+    pthread_mutex_lock(&g->lock);
+    g->alt_n_landmarks = n_landmarks;
+    g->alt_ref_msat    = ref_amount_msat;
+    g->alt_interval_ms = interval_ms ? interval_ms : 1000;
+    int ok = 1;
+    if (!g->alt_running) {
+        g->alt_running = 1;
+        if (pthread_create(&g->alt_tid, NULL, alt_worker, g) != 0) {
+            g->alt_running = 0;
+            ok = 0;
+        }
+    }
+    pthread_mutex_unlock(&g->lock);
+    return ok;
+}
+
+void pathfind_graph_alt_stop(pathfind_graph_t *g)
+{
+    if (!g || !g->has_lock) return;
+    pthread_mutex_lock(&g->lock);
+    int was_running = g->alt_running;
+    g->alt_running = 0;
+    pthread_cond_signal(&g->alt_cond);
+    pthread_mutex_unlock(&g->lock);
+    if (was_running) pthread_join(g->alt_tid, NULL);
+}
+
 /* ================================================================== */
 /* PR #70: Incremental graph cache                                     */
 /* ================================================================== */
@@ -450,7 +1785,7 @@ pathfind_graph_cache_t *pathfind_graph_cache_create(void)
 void pathfind_graph_cache_destroy(pathfind_graph_cache_t *c)
 {
     if (!c) return;
-    free(c->g);
+    pathfind_graph_free((pathfind_graph_t *)c->g);
     free(c);
 }
 
@@ -463,9 +1798,9 @@ typedef struct {
 /*
  * patch_edge_cb -- update an existing edge in-place or append a new edge.
  * Called by gossip_store_enumerate_channels_since() for each updated edge.
- * If the (scid, direction encoded as from_idx == idx_src, to_idx == idx_dst)
- * edge already exists, its fee/cltv fields are overwritten.
- * Otherwise a new edge is appended.
+ * The channel table is hashed by scid, so finding the existing edge is
+ * O(1) (the source pubkey only picks the direction); only a new channel
+ * or direction invalidates the CSR adjacency.
  */
 static void patch_edge_cb(uint64_t scid,
                            const unsigned char src_pubkey[33],
@@ -479,45 +1814,14 @@ static void patch_edge_cb(uint64_t scid,
                            void *ctx)
 {
     patch_ctx_t *pc = (patch_ctx_t *)ctx;
-    graph_t     *g  = pc->g;
 
     (void)capacity_sat;
 
-    int idx_src = node_find_or_add(g, src_pubkey);
-    int idx_dst = node_find_or_add(g, dst_pubkey);
-    if (idx_src < 0 || idx_dst < 0) return;
-
-    /* Search for existing edge with same scid and same direction */
-    for (int ei = 0; ei < g->n_edges; ei++) {
-        edge_t *e = &g->edges[ei];
-        if (e->scid == scid &&
-            e->from_idx == idx_src &&
-            e->to_idx   == idx_dst) {
-            /* Update in-place */
-            e->fee_base_msat  = fee_base_msat;
-            e->fee_ppm        = fee_ppm;
-            e->cltv_delta     = cltv_delta;
-            e->htlc_min_msat  = htlc_min_msat;
-            e->htlc_max_msat  = htlc_max_msat;
-            pc->count++;
-            return;
-        }
-    }
-
-    /* New edge -- append */
-    if (g->n_edges >= MAX_EDGES) return;
-    edge_t *e       = &g->edges[g->n_edges++];
-    e->scid         = scid;
-    e->from_idx     = idx_src;
-    e->to_idx       = idx_dst;
-    e->fee_base_msat = fee_base_msat;
-    e->fee_ppm      = fee_ppm;
-    e->cltv_delta   = cltv_delta;
-    e->htlc_min_msat = htlc_min_msat;
-    e->htlc_max_msat = htlc_max_msat;
-    pc->count++;
+    if (graph_upsert_edge(pc->g, scid, src_pubkey, dst_pubkey,
+                          fee_base_msat, fee_ppm, cltv_delta,
+                          htlc_min_msat, htlc_max_msat))
+        pc->count++;
 }
-
 /*
  * query_max_ts -- query MAX(timestamp) from gossip_channel_updates.
  * If since_ts == 0, returns the global max (used after full reload).
@@ -566,10 +1870,10 @@ int pathfind_route_cached(gossip_store_t *gs,
     if (need_full) {
         /* Full reload */
         if (!c->g) {
-            c->g = (graph_t *)malloc(sizeof(graph_t));
+            c->g = (graph_t *)calloc(1, sizeof(graph_t));
             if (!c->g) return 0;
         }
-        memset(c->g, 0, sizeof(graph_t));
+        graph_clear(c->g);
 
         load_ctx_t lc = { c->g, 0 };
         gossip_store_enumerate_channels(gs, load_edge_cb, &lc);
@@ -594,21 +1898,7 @@ int pathfind_route_cached(gossip_store_t *gs,
     graph_t *g = c->g;
     if (!g || g->n_nodes == 0) return 0;
 
-    int src = -1, dst = -1;
-    for (int i = 0; i < g->n_nodes; i++) {
-        if (memcmp(g->nodes[i].pubkey, our_node,    33) == 0) src = i;
-        if (memcmp(g->nodes[i].pubkey, dest_pubkey, 33) == 0) dst = i;
-    }
-    if (src < 0 || dst < 0 || src == dst) return 0;
-
-    dijk_node_t *dn = (dijk_node_t *)malloc(g->n_nodes * sizeof(dijk_node_t));
-    if (!dn) return 0;
-
-    int ok = dijkstra(g, src, dst, amount_msat, dn);
-    if (ok) ok = extract_path(g, dn, src, dst, amount_msat, out);
-
-    free(dn);
-    return ok;
+    return route_on_graph(g, our_node, dest_pubkey, amount_msat, NULL, out);
 }
 
 /* ---- Cache accessors (used by tests) ---- */
@@ -26,6 +26,49 @@ void payment_init(payment_table_t *pt) {
     memset(pt, 0, sizeof(*pt));
     pt->mc = NULL;
     pt->gi = NULL;
+    pt->gi_lock = NULL;
+}
+
+/*
+ * Route lookup: use the live routing graph maintained by gossip ingest when
+ * one is attached, otherwise load the graph from gossip_store.
+ */
+static pathfind_graph_t *live_graph(const payment_table_t *pt) {
+    return (pt && pt->gi) ? pt->gi->graph : NULL;
+}
+
+static int pay_route(const payment_table_t *pt, gossip_store_t *gs,
+                     const unsigned char our_pub[33],
+                     const unsigned char dest[33],
+                     uint64_t amount_msat, pathfind_route_t *out) {
+    pathfind_graph_t *g = live_graph(pt);
+    if (g) return pathfind_graph_route(g, our_pub, dest, amount_msat, out);
+    return pathfind_route(gs, our_pub, dest, amount_msat, out);
+}
+
+/* Mission control is recorded and queried on the wall clock. */
+static int pay_route_ex(const payment_table_t *pt, gossip_store_t *gs,
+                        const unsigned char our_pub[33],
+                        const unsigned char dest[33],
+                        uint64_t amount_msat, pathfind_route_t *out) {
+    pathfind_graph_t *g = live_graph(pt);
+    uint32_t now = (uint32_t)time(NULL);
+    if (g) return pathfind_graph_route_ex(g, our_pub, dest, amount_msat,
+                                          now, pt->mc, out);
+    return pathfind_route_ex(gs, our_pub, dest, amount_msat,
+                             now, pt->mc, out);
+}
+
+/* Amount each hop forwards: the payment plus the fees of the hops after it. */
+static void route_hop_amounts(const pathfind_route_t *route, uint64_t amount_msat,
+                              uint64_t amounts[PATHFIND_MAX_HOPS]) {
+    if (route->n_hops <= 0) return;
+    amounts[route->n_hops - 1] = amount_msat;
+    for (int i = route->n_hops - 2; i >= 0; i--) {
+        const pathfind_hop_t *next = &route->hops[i + 1];
+        amounts[i] = amounts[i + 1] + (uint64_t)next->fee_base_msat +
+                     (uint64_t)next->fee_ppm * amounts[i + 1] / 1000000ULL;
+    }
 }
 
 /* Build onion hops from a pathfind_route + invoice fields */
@@ -41,19 +84,12 @@ static int build_onion_hops(const pathfind_route_t *route,
     /* Compute per-hop amounts (BOLT #4: include fees from inner hops outward) */
     uint64_t amounts[PATHFIND_MAX_HOPS];
     uint32_t cltvs[PATHFIND_MAX_HOPS];
+    route_hop_amounts(route, amount_msat, amounts);
 
-    /* Final hop gets the actual amount */
-    amounts[route->n_hops - 1] = amount_msat;
-    cltvs[route->n_hops - 1]   = final_cltv;
-
-    /* Work backwards: each hop's amount includes the fee for the next hop */
-    for (int i = route->n_hops - 2; i >= 0; i--) {
-        const pathfind_hop_t *next = &route->hops[i + 1];
-        uint64_t fee = (uint64_t)next->fee_base_msat +
-                       (uint64_t)next->fee_ppm * amounts[i + 1] / 1000000ULL;
-        amounts[i] = amounts[i + 1] + fee;
-        cltvs[i]   = cltvs[i + 1] + next->cltv_expiry_delta;
-    }
+    /* Work backwards: each hop's CLTV includes the next hop's delta */
+    cltvs[route->n_hops - 1] = final_cltv;
+    for (int i = route->n_hops - 2; i >= 0; i--)
+        cltvs[i] = cltvs[i + 1] + route->hops[i + 1].cltv_expiry_delta;
 
     for (int i = 0; i < route->n_hops; i++) {
         onion_hop_t *h = &hops_out[i];
@@ -76,6 +112,95 @@ static int build_onion_hops(const pathfind_route_t *route,
     return 1;
 }
 
+/* Fresh random onion session key. */
+static int new_session_key(unsigned char out[32]) {
+    FILE *f = fopen("/dev/urandom", "rb");
+    if (!f || fread(out, 1, 32, f) != 32) {
+        if (f) fclose(f);
+        return 0;
+    }
+    fclose(f);
+    return 1;
+}
+
+/* Send update_add_htlc to the first peer with a channel, if any, numbering
+   it from that peer's HTLC counter.  Returns the peer index (-1 = not sent)
+   and the htlc_id used in *htlc_id_out (may be NULL). */
+static int send_update_add(peer_mgr_t *pmgr,
+                           const unsigned char payment_hash[32],
+                           uint64_t amount_msat, uint32_t first_cltv,
+                           const unsigned char onion_pkt[ONION_PACKET_SIZE],
+                           uint64_t *htlc_id_out) {
+    /* BOLT #2 update_add_htlc: type(2) + chan_id(8) + htlc_id(8) +
+                                 amount(8) + payment_hash(32) + cltv(4) + onion(1366) */
+    int peer_idx = -1;
+    if (pmgr) {
+        for (int i = 0; i < pmgr->count; i++) {
+            if (pmgr->peers[i].has_channel) { peer_idx = i; break; }
+        }
+    }
+    if (peer_idx < 0) return -1;
+
+    uint64_t htlc_id = pmgr->peers[peer_idx].next_htlc_id++;
+    if (htlc_id_out) *htlc_id_out = htlc_id;
+
+    unsigned char htlc_msg[1440];
+    size_t pos = 0;
+    htlc_msg[pos++] = 0x00; htlc_msg[pos++] = 0x80; /* type 128: update_add_htlc */
+    memset(htlc_msg + pos, 0, 8); pos += 8;          /* channel_id */
+    for (int i = 7; i >= 0; i--) htlc_msg[pos++] = (unsigned char)(htlc_id >> (i*8));
+    for (int i = 7; i >= 0; i--) htlc_msg[pos++] = (unsigned char)(amount_msat >> (i*8));
+    memcpy(htlc_msg + pos, payment_hash, 32); pos += 32;
+    /* cltv_expiry = first hop's absolute CLTV (BOLT #2 update_add_htlc) */
+    htlc_msg[pos++] = (unsigned char)(first_cltv >> 24);
+    htlc_msg[pos++] = (unsigned char)(first_cltv >> 16);
+    htlc_msg[pos++] = (unsigned char)(first_cltv >> 8);
+    htlc_msg[pos++] = (unsigned char)(first_cltv);
+    memcpy(htlc_msg + pos, onion_pkt, ONION_PACKET_SIZE); pos += ONION_PACKET_SIZE;
+    peer_mgr_send(pmgr, peer_idx, htlc_msg, pos);
+    return peer_idx;
+}
+
+void payment_mc_record(mc_table_t *mc, const pathfind_route_t *route,
+                       uint64_t amount_msat, int failing_hop, uint32_t now) {
+    if (!mc || !route || route->n_hops <= 0) return;
+    uint64_t amounts[PATHFIND_MAX_HOPS];
+    route_hop_amounts(route, amount_msat, amounts);
+    int n_ok = (failing_hop >= 0 && failing_hop < route->n_hops)
+               ? failing_hop : route->n_hops;
+    for (int h = 0; h < n_ok; h++)
+        mc_record_success(mc, route->hops[h].scid, route->hops[h].direction,
+                          amounts[h], now);
+    if (n_ok < route->n_hops)
+        mc_record_failure(mc, route->hops[n_ok].scid, route->hops[n_ok].direction,
+                          amounts[n_ok], now);
+}
+
+int payment_send_route(peer_mgr_t *pmgr, secp256k1_context *ctx,
+                       const pathfind_route_t *route, uint64_t amount_msat,
+                       uint32_t final_cltv,
+                       const unsigned char payment_hash[32],
+                       const unsigned char *payment_secret,
+                       const unsigned char *keysend_preimage,
+                       unsigned char session_key_out[32],
+                       int *peer_out, uint64_t *htlc_id_out) {
+    if (!ctx || !route || !payment_hash || !session_key_out) return 0;
+
+    onion_hop_t hops[PATHFIND_MAX_HOPS];
+    if (!build_onion_hops(route, amount_msat, final_cltv, payment_secret,
+                          keysend_preimage != NULL, keysend_preimage, hops))
+        return 0;
+    if (!new_session_key(session_key_out)) return 0;
+
+    unsigned char onion_pkt[ONION_PACKET_SIZE];
+    if (!onion_build(hops, route->n_hops, session_key_out, ctx, onion_pkt))
+        return 0;
+    int peer_idx = send_update_add(pmgr, payment_hash, amount_msat,
+                                   hops[0].cltv_expiry, onion_pkt, htlc_id_out);
+    if (peer_out) *peer_out = peer_idx;
+    return 1;
+}
+
 /* ---- Internal: initiate a single payment shard ---- */
 static int do_payment_send(payment_t *pay,
                             gossip_store_t *gs,
@@ -112,14 +237,7 @@ static int do_payment_send(payment_t *pay,
 
     /* Generate session key */
     unsigned char session_key[32];
-    {
-        FILE *f = fopen("/dev/urandom", "rb");
-        if (!f || fread(session_key, 1, 32, f) != 32) {
-            if (f) fclose(f);
-            return 0;
-        }
-        fclose(f);
-    }
+    if (!new_session_key(session_key)) return 0;
     memcpy(pay->session_keys[route_idx], session_key, 32);
 
     /* Build onion */
@@ -127,32 +245,8 @@ static int do_payment_send(payment_t *pay,
     if (!onion_build(hops, route->n_hops, session_key, ctx, onion_pkt)) return 0;
 
     /* Find the first-hop peer and send update_add_htlc */
-    /* BOLT #2 update_add_htlc: type(2) + chan_id(8) + htlc_id(8) +
-                                 amount(8) + payment_hash(32) + cltv(4) + onion(1366) */
-    int peer_idx = -1;
-    if (pmgr) {
-        for (int i = 0; i < pmgr->count; i++) {
-            if (pmgr->peers[i].has_channel) { peer_idx = i; break; }
-        }
-    }
-
-    if (peer_idx >= 0 && pmgr) {
-        unsigned char htlc_msg[1440];
-        size_t pos = 0;
-        htlc_msg[pos++] = 0x00; htlc_msg[pos++] = 0x80; /* type 128: update_add_htlc */
-        memset(htlc_msg + pos, 0, 8); pos += 8;          /* channel_id */
-        memset(htlc_msg + pos, 0, 8); pos += 8;          /* htlc_id */
-        for (int i = 7; i >= 0; i--) htlc_msg[pos++] = (unsigned char)(shard_msat >> (i*8));
-        memcpy(htlc_msg + pos, pay->payment_hash, 32); pos += 32;
-        /* cltv_expiry = first hop's absolute CLTV (BOLT #2 update_add_htlc) */
-        uint32_t first_cltv = hops[0].cltv_expiry;
-        htlc_msg[pos++] = (unsigned char)(first_cltv >> 24);
-        htlc_msg[pos++] = (unsigned char)(first_cltv >> 16);
-        htlc_msg[pos++] = (unsigned char)(first_cltv >> 8);
-        htlc_msg[pos++] = (unsigned char)(first_cltv);
-        memcpy(htlc_msg + pos, onion_pkt, ONION_PACKET_SIZE); pos += ONION_PACKET_SIZE;
-        peer_mgr_send(pmgr, peer_idx, htlc_msg, pos);
-    }
+    send_update_add(pmgr, pay->payment_hash, shard_msat, hops[0].cltv_expiry,
+                    onion_pkt, NULL);
 
     (void)our_node;
     (void)gs;
@@ -199,9 +293,8 @@ int payment_send(payment_table_t *pt,
     int n_routes;
     if (pt->mc) {
         pathfind_route_t single_route;
-        int r = pathfind_route_ex(gs, our_pub, inv->payee_pubkey,
-                                   inv->amount_msat, current_block_height,
-                                   pt->mc, &single_route);
+        int r = pay_route_ex(pt, gs, our_pub, inv->payee_pubkey,
+                              inv->amount_msat, &single_route);
         if (r <= 0) {
             snprintf(pay->last_error, sizeof(pay->last_error), "no route found");
             pay->state = PAY_STATE_FAILED;
@@ -210,9 +303,14 @@ int payment_send(payment_table_t *pt,
         pay->routes[0] = single_route;
         n_routes = 1;
     } else {
-        n_routes = pathfind_mpp_routes(gs, our_pub, inv->payee_pubkey,
-                                        inv->amount_msat, 1,
-                                        pay->routes, PAYMENT_MAX_ROUTES);
+        if (live_graph(pt))
+            n_routes = pathfind_graph_route(live_graph(pt), our_pub,
+                                            inv->payee_pubkey, inv->amount_msat,
+                                            &pay->routes[0]);
+        else
+            n_routes = pathfind_mpp_routes(gs, our_pub, inv->payee_pubkey,
+                                            inv->amount_msat, 1,
+                                            pay->routes, PAYMENT_MAX_ROUTES);
         if (n_routes <= 0) {
             snprintf(pay->last_error, sizeof(pay->last_error), "no route found");
             pay->state = PAY_STATE_FAILED;
@@ -279,9 +377,8 @@ int payment_keysend(payment_table_t *pt,
     pay->min_final_cltv = 18; /* BOLT #11 default for spontaneous payments (CLN/LDK use 18) */
 
     /* Find route -- apply MC exclusions on initial attempt */
-    int n_routes = pathfind_route_ex(gs, our_pub, dest_pubkey, amount_msat,
-                                      current_block_height, pt->mc,
-                                      &pay->routes[0]);
+    int n_routes = pay_route_ex(pt, gs, our_pub, dest_pubkey, amount_msat,
+                                 &pay->routes[0]);
     if (!n_routes) {
         snprintf(pay->last_error, sizeof(pay->last_error), "keysend: no route");
         pay->state = PAY_STATE_FAILED;
@@ -301,14 +398,9 @@ int payment_keysend(payment_table_t *pt,
     }
 
     unsigned char session_key[32];
-    {
-        FILE *f = fopen("/dev/urandom", "rb");
-        if (!f || fread(session_key, 1, 32, f) != 32) {
-            if (f) fclose(f);
-            pay->state = PAY_STATE_FAILED;
-            return pt->count++;
-        }
-        fclose(f);
+    if (!new_session_key(session_key)) {
+        pay->state = PAY_STATE_FAILED;
+        return pt->count++;
     }
     memcpy(pay->session_keys[0], session_key, 32);
 
@@ -322,29 +414,8 @@ int payment_keysend(payment_table_t *pt,
     pay->n_attempts++;
 
     /* Send to first-hop peer if connected */
-    if (pmgr) {
-        int peer_idx = -1;
-        for (int i = 0; i < pmgr->count; i++) {
-            if (pmgr->peers[i].has_channel) { peer_idx = i; break; }
-        }
-        if (peer_idx >= 0) {
-            unsigned char htlc_msg[1440];
-            size_t pos = 0;
-            htlc_msg[pos++] = 0x00; htlc_msg[pos++] = 0x80;
-            memset(htlc_msg + pos, 0, 8); pos += 8;
-            memset(htlc_msg + pos, 0, 8); pos += 8;
-            for (int i = 7; i >= 0; i--) htlc_msg[pos++] = (unsigned char)(amount_msat >> (i*8));
-            memcpy(htlc_msg + pos, payment_hash, 32); pos += 32;
-            /* cltv_expiry = first hop's absolute CLTV */
-            uint32_t first_cltv = hops[0].cltv_expiry;
-            htlc_msg[pos++] = (unsigned char)(first_cltv >> 24);
-            htlc_msg[pos++] = (unsigned char)(first_cltv >> 16);
-            htlc_msg[pos++] = (unsigned char)(first_cltv >> 8);
-            htlc_msg[pos++] = (unsigned char)(first_cltv);
-            memcpy(htlc_msg + pos, onion_pkt, ONION_PACKET_SIZE); pos += ONION_PACKET_SIZE;
-            peer_mgr_send(pmgr, peer_idx, htlc_msg, pos);
-        }
-    }
+    send_update_add(pmgr, payment_hash, amount_msat, hops[0].cltv_expiry,
+                    onion_pkt, NULL);
 
     (void)fwd; (void)mpp;
     return pt->count++;
@@ -363,11 +434,9 @@ void payment_on_settle(payment_table_t *pt,
             p->state = PAY_STATE_SUCCESS;
             if (preimage) memcpy(p->payment_preimage, preimage, 32);
             /* Record success in mission control for each hop */
-            if (pt->mc && p->n_routes > 0) {
-                for (int h = 0; h < p->routes[0].n_hops; h++)
-                    mc_record_success(pt->mc, p->routes[0].hops[h].scid,
-                                      0, p->amount_msat, (uint32_t)time(NULL));
-            }
+            if (pt->mc && p->n_routes > 0)
+                payment_mc_record(pt->mc, &p->routes[0], p->amount_msat, -1,
+                                  (uint32_t)time(NULL));
             return;
         }
     }
@@ -420,19 +489,26 @@ int payment_on_fail(payment_table_t *pt,
                 return 0;
             }
             /* Apply embedded channel_update if present */
-            if (failure.has_channel_update && failure.channel_update_len > 0 && pt->gi)
+            if (failure.has_channel_update && failure.channel_update_len > 0 && pt->gi) {
+                if (pt->gi_lock) pthread_mutex_lock(pt->gi_lock);
                 gossip_ingest_channel_update(pt->gi, failure.channel_update_buf,
                                              failure.channel_update_len,
                                              (uint32_t)time(NULL));
+                if (pt->gi_lock) pthread_mutex_unlock(pt->gi_lock);
+            }
         }
         if (failing_hop >= 0 && failing_hop < pay->routes[0].n_hops) {
             uint64_t bad_scid = pay->routes[0].hops[failing_hop].scid;
             if (gs && bad_scid)
                 gossip_store_mark_channel_spent(gs, bad_scid, (uint32_t)time(NULL));
-            /* Record failure in mission control */
+            if (live_graph(pt) && bad_scid)
+                pathfind_graph_remove_channel(live_graph(pt), bad_scid);
+            /* Record failure in mission control.  The hops before the
+             * failing one carried the HTLC, which bounds their liquidity
+             * from below. */
             if (pt->mc && bad_scid)
-                mc_record_failure(pt->mc, bad_scid, 0,
-                                  pay->amount_msat, (uint32_t)time(NULL));
+                payment_mc_record(pt->mc, &pay->routes[0], pay->amount_msat,
+                                  failing_hop, (uint32_t)time(NULL));
         }
     }
 
@@ -454,7 +530,7 @@ int payment_on_fail(payment_table_t *pt,
                     unsigned char dest[33];
                     memcpy(dest, pay->routes[0].hops[pay->routes[0].n_hops-1].node_id, 33);
                     pathfind_route_t new_route;
-                    if (pathfind_route(gs, our_pub, dest, pay->amount_msat, &new_route)) {
+                    if (pay_route(pt, gs, our_pub, dest, pay->amount_msat, &new_route)) {
                         /* Check MC exclusions before accepting route */
                         int excluded = 0;
                         if (pt->mc) {
@@ -534,8 +610,8 @@ int payment_check_timeouts(payment_table_t *pt,
                 if (last >= 0)
                     memcpy(dest, p->routes[0].hops[last].node_id, 33);
                 pathfind_route_t new_route;
-                if (last >= 0 && pathfind_route(gs, our_pub, dest,
-                                                 p->amount_msat, &new_route)) {
+                if (last >= 0 && pay_route(pt, gs, our_pub, dest,
+                                           p->amount_msat, &new_route)) {
                     p->routes[0] = new_route;
                     p->state = PAY_STATE_INFLIGHT;
                     uint32_t retry_cltv2 = (pt->last_block_height > 0
@@ -597,7 +673,30 @@ int payment_send_amp(payment_table_t *pt,
     size_t pub_len = 33;
     secp256k1_ec_pubkey_serialize(ctx, our_pub, &pub_len, &pub, SECP256K1_EC_COMPRESSED);
 
-    /* Generate random root_shares */
+    /* Find routes before committing the entry.  On the live graph the
+       shards are planned together: channel-disjoint routes with amounts
+       sized to each route's capacity, possibly fewer than asked for.
+       Otherwise each shard gets an equal split and its own search. */
+    pathfind_route_t routes[PAYMENT_MAX_ROUTES];
+    uint64_t amounts[PAYMENT_MAX_ROUTES];
+    pathfind_graph_t *g = live_graph(pt);
+    if (g) {
+        n_shards = pathfind_graph_mpp_plan(g, our_pub, dest_pubkey, amount_msat,
+                                           n_shards, (uint32_t)time(NULL),
+                                           pt->mc, routes, amounts,
+                                           PAYMENT_MAX_ROUTES);
+        if (n_shards <= 0) return 0;
+    } else {
+        uint64_t shard_msat = amount_msat / (uint64_t)n_shards;
+        for (int i = 0; i < n_shards; i++) {
+            amounts[i] = (i == n_shards - 1) ?
+                amount_msat - shard_msat * (uint64_t)(n_shards - 1) : shard_msat;
+            if (!pay_route(pt, gs, our_pub, dest_pubkey, amounts[i], &routes[i]))
+                return 0;  /* no route for this shard — fail before committing */
+        }
+    }
+
+    /* Generate random root_shares, one per shard */
     unsigned char shares[PAYMENT_MAX_ROUTES][32];
     for (int i = 0; i < n_shards; i++) {
         if (channel_read_random_bytes(shares[i], 32) != 1) return 0;
@@ -615,16 +714,6 @@ int payment_send_amp(payment_table_t *pt,
     unsigned char set_id[32];
     memcpy(set_id, payment_hash, 32);
 
-    /* Find route per shard before committing the entry */
-    uint64_t shard_msat = amount_msat / (uint64_t)n_shards;
-    pathfind_route_t routes[PAYMENT_MAX_ROUTES];
-    for (int i = 0; i < n_shards; i++) {
-        uint64_t s = (i == n_shards - 1) ?
-            amount_msat - shard_msat * (uint64_t)(n_shards - 1) : shard_msat;
-        if (!pathfind_route(gs, our_pub, dest_pubkey, s, &routes[i]))
-            return 0;  /* no route for this shard — fail before committing */
-    }
-
     /* Commit the payment entry */
     payment_t *pay = &pt->entries[pt->count];
     memset(pay, 0, sizeof(*pay));
@@ -644,12 +733,11 @@ int payment_send_amp(payment_table_t *pt,
 
     /* Dispatch each shard via the existing HTLC send path */
     for (int i = 0; i < n_shards; i++) {
-        uint64_t s = (i == n_shards - 1) ?
-            amount_msat - shard_msat * (uint64_t)(n_shards - 1) : shard_msat;
         uint32_t amp_cltv = (pt->last_block_height > 0
                              ? pt->last_block_height
                              : (uint32_t)(time(NULL) / 600)) + 18;
-        do_payment_send(pay, gs, NULL, NULL, pmgr, ctx, our_privkey, our_pub, s, i, amp_cltv);
+        do_payment_send(pay, gs, NULL, NULL, pmgr, ctx, our_privkey, our_pub,
+                        amounts[i], i, amp_cltv);
     }
 
     return 1;
@@ -678,9 +766,8 @@ int payment_send_trampoline(payment_table_t *pt,
 
     /* Route to the trampoline node — it handles routing to final_dest */
     pathfind_route_t route;
-    int r = pathfind_route_ex(gs, our_pub, tp->trampoline_pubkey,
-                               tp->amount_msat, current_block_height,
-                               pt->mc, &route);
+    int r = pay_route_ex(pt, gs, our_pub, tp->trampoline_pubkey,
+                          tp->amount_msat, &route);
     if (r <= 0) return -1; /* no path to trampoline */
 
     /* Commit the payment entry */
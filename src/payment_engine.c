@@ -0,0 +1,683 @@
+/*
+ * payment_engine.c — Concurrent outbound payment engine
+ *
+ * Entries live in a growable slot array.  Open-addressing indexes
+ * (slot + 1, 0 = empty) find payments by payment_hash and by the
+ * (peer, htlc_id) of their outstanding HTLC, and destination records by
+ * pubkey; a binary min-heap orders INFLIGHT timeouts and
+ * RETRY_WAIT delays.  Singly linked lists through entry->next carry the
+ * routing queue, the worker -> engine done list and each destination's
+ * wait queue (an entry is on at most one of them).
+ *
+ * Workers only touch an entry between popping it off the routing queue
+ * and pushing it onto the done list, copying inputs and writing results
+ * under pe->lock; the engine thread owns every other entry.
+ */
+
+#include "superscalar/payment_engine.h"
+#include "superscalar/bolt4_failure.h"
+#include "superscalar/onion.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define NO_SLOT UINT32_MAX
+
+enum { IDX_HASH, IDX_DEST, IDX_HTLC };
+
+static int max_per_dest(const payment_engine_t *pe) {
+    return pe->max_per_dest > 0 ? pe->max_per_dest : PAYMENT_ENGINE_MAX_PER_DEST;
+}
+
+static int max_attempts(const payment_engine_t *pe) {
+    return pe->max_attempts > 0 ? pe->max_attempts : PAYMENT_MAX_ATTEMPTS;
+}
+
+static uint32_t timeout_secs(const payment_engine_t *pe) {
+    return pe->timeout_secs ? pe->timeout_secs : PAYMENT_TIMEOUT_SECS;
+}
+
+static uint32_t retry_base_secs(const payment_engine_t *pe) {
+    return pe->retry_base_secs ? pe->retry_base_secs : PAYMENT_ENGINE_RETRY_BASE_SECS;
+}
+
+/* ---- indexes ---- */
+
+static size_t mix(uint64_t k, size_t mask) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static size_t key_pos(const unsigned char *key, size_t mask) {
+    uint64_t k;
+    memcpy(&k, key, 8);
+    return mix(k, mask);
+}
+
+/* Hash key of a slot: payment_hash, pubkey bytes past the parity byte,
+   or the HTLC key. */
+static const unsigned char *slot_key(const payment_engine_t *pe, int kind,
+                                     uint32_t slot) {
+    if (kind == IDX_HTLC)
+        return (const unsigned char *)&pe->entries[slot].htlc_key;
+    return kind == IDX_HASH ? pe->entries[slot].payment_hash
+                            : pe->dests[slot].node + 1;
+}
+
+static uint32_t *idx_table(payment_engine_t *pe, int kind) {
+    if (kind == IDX_HTLC) return pe->idx_htlc;
+    return kind == IDX_HASH ? pe->idx_hash : pe->idx_dest;
+}
+
+static uint64_t htlc_key(int peer, uint64_t htlc_id) {
+    return htlc_id * 0x9E3779B97F4A7C15ULL ^ (uint64_t)(uint32_t)peer;
+}
+
+static void idx_insert(payment_engine_t *pe, int kind, uint32_t slot) {
+    uint32_t *t = idx_table(pe, kind);
+    size_t mask = pe->idx_cap - 1;
+    size_t i = key_pos(slot_key(pe, kind, slot), mask);
+    while (t[i]) i = (i + 1) & mask;
+    t[i] = slot + 1;
+}
+
+static void idx_remove(payment_engine_t *pe, int kind, uint32_t slot) {
+    uint32_t *t = idx_table(pe, kind);
+    size_t mask = pe->idx_cap - 1;
+    size_t i = key_pos(slot_key(pe, kind, slot), mask);
+    while (t[i] != slot + 1) {
+        if (!t[i]) return;
+        i = (i + 1) & mask;
+    }
+    t[i] = 0;
+    for (size_t j = (i + 1) & mask; t[j]; j = (j + 1) & mask) {
+        size_t k = key_pos(slot_key(pe, kind, t[j] - 1), mask);
+        /* t[j] may move into the hole unless its home lies in (i, j] */
+        int stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (stays) continue;
+        t[i] = t[j];
+        t[j] = 0;
+        i = j;
+    }
+}
+
+static payment_engine_entry_t *find_payment(payment_engine_t *pe,
+                                            const unsigned char hash[32]) {
+    if (!pe->idx_cap) return NULL;
+    size_t mask = pe->idx_cap - 1;
+    for (size_t i = key_pos(hash, mask); pe->idx_hash[i]; i = (i + 1) & mask) {
+        payment_engine_entry_t *e = &pe->entries[pe->idx_hash[i] - 1];
+        if (memcmp(e->payment_hash, hash, 32) == 0) return e;
+    }
+    return NULL;
+}
+
+static payment_engine_entry_t *find_htlc(payment_engine_t *pe, int peer,
+                                         uint64_t htlc_id) {
+    if (!pe->idx_cap) return NULL;
+    size_t mask = pe->idx_cap - 1;
+    uint64_t k = htlc_key(peer, htlc_id);
+    for (size_t i = mix(k, mask); pe->idx_htlc[i]; i = (i + 1) & mask) {
+        payment_engine_entry_t *e = &pe->entries[pe->idx_htlc[i] - 1];
+        if (e->out_peer == peer && e->out_htlc_id == htlc_id) return e;
+    }
+    return NULL;
+}
+
+static uint32_t find_dest(payment_engine_t *pe, const unsigned char node[33]) {
+    if (!pe->idx_cap) return NO_SLOT;
+    size_t mask = pe->idx_cap - 1;
+    for (size_t i = key_pos(node + 1, mask); pe->idx_dest[i]; i = (i + 1) & mask) {
+        uint32_t d = pe->idx_dest[i] - 1;
+        if (memcmp(pe->dests[d].node, node, 33) == 0) return d;
+    }
+    return NO_SLOT;
+}
+
+/* Keep the indexes at most half full for need live entries. */
+static int ensure_index(payment_engine_t *pe, size_t need) {
+    if (need * 2 <= pe->idx_cap) return 1;
+    size_t cap = pe->idx_cap ? pe->idx_cap * 2 : 64;
+    while (need * 2 > cap) cap *= 2;
+
+    uint32_t *hash = calloc(cap, sizeof(uint32_t));
+    uint32_t *dest = calloc(cap, sizeof(uint32_t));
+    uint32_t *htlc = calloc(cap, sizeof(uint32_t));
+    if (!hash || !dest || !htlc) {
+        free(hash); free(dest); free(htlc);
+        return 0;
+    }
+    free(pe->idx_hash); free(pe->idx_dest); free(pe->idx_htlc);
+    pe->idx_hash = hash;
+    pe->idx_dest = dest;
+    pe->idx_htlc = htlc;
+    pe->idx_cap = cap;
+
+    for (size_t s = 0; s < pe->n_slots; s++) {
+        if (pe->entries[s].dest_slot == NO_SLOT) continue;
+        idx_insert(pe, IDX_HASH, (uint32_t)s);
+        if (pe->entries[s].htlc_indexed) idx_insert(pe, IDX_HTLC, (uint32_t)s);
+    }
+    for (size_t d = 0; d < pe->n_dest_slots; d++)
+        if (pe->dests[d].n_entries) idx_insert(pe, IDX_DEST, (uint32_t)d);
+    return 1;
+}
+
+/* ---- deadline min-heap ---- */
+
+static uint32_t heap_key(const payment_engine_t *pe, size_t i) {
+    return pe->entries[pe->heap[i]].deadline;
+}
+
+static void heap_set(payment_engine_t *pe, size_t i, uint32_t slot) {
+    pe->heap[i] = slot;
+    pe->entries[slot].heap_pos = (uint32_t)i;
+}
+
+static void heap_up(payment_engine_t *pe, size_t i) {
+    uint32_t slot = pe->heap[i];
+    uint32_t key = pe->entries[slot].deadline;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap_key(pe, parent) <= key) break;
+        heap_set(pe, i, pe->heap[parent]);
+        i = parent;
+    }
+    heap_set(pe, i, slot);
+}
+
+static void heap_down(payment_engine_t *pe, size_t i) {
+    uint32_t slot = pe->heap[i];
+    uint32_t key = pe->entries[slot].deadline;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= pe->heap_len) break;
+        if (c + 1 < pe->heap_len && heap_key(pe, c + 1) < heap_key(pe, c))
+            c++;
+        if (key <= heap_key(pe, c)) break;
+        heap_set(pe, i, pe->heap[c]);
+        i = c;
+    }
+    heap_set(pe, i, slot);
+}
+
+static void heap_push(payment_engine_t *pe, payment_engine_entry_t *e,
+                      uint32_t deadline) {
+    e->deadline = deadline;
+    size_t i = pe->heap_len++;
+    heap_set(pe, i, (uint32_t)(e - pe->entries));
+    heap_up(pe, i);
+}
+
+static void heap_remove(payment_engine_t *pe, payment_engine_entry_t *e) {
+    size_t i = e->heap_pos;
+    if (e->heap_pos == NO_SLOT) return;
+    e->heap_pos = NO_SLOT;
+    size_t last = --pe->heap_len;
+    if (i == last) return;
+    uint32_t moved = pe->heap[last];
+    heap_set(pe, i, moved);
+    heap_down(pe, i);
+    heap_up(pe, pe->entries[moved].heap_pos);
+}
+
+/* ---- slots ---- */
+
+/* Grow every per-slot array together.  Called with pe->lock held. */
+static int grow_slots(payment_engine_t *pe) {
+    size_t cap = pe->cap ? pe->cap * 2 : 64;
+
+    payment_engine_entry_t *entries = realloc(pe->entries, cap * sizeof(*entries));
+    if (!entries) return 0;
+    pe->entries = entries;
+    payment_engine_dest_t *dests = realloc(pe->dests, cap * sizeof(*dests));
+    if (!dests) return 0;
+    pe->dests = dests;
+    uint32_t *free_slots = realloc(pe->free_slots, cap * sizeof(uint32_t));
+    if (!free_slots) return 0;
+    pe->free_slots = free_slots;
+    uint32_t *free_dests = realloc(pe->free_dests, cap * sizeof(uint32_t));
+    if (!free_dests) return 0;
+    pe->free_dests = free_dests;
+    uint32_t *heap = realloc(pe->heap, cap * sizeof(uint32_t));
+    if (!heap) return 0;
+    pe->heap = heap;
+    pe->cap = cap;
+    return 1;
+}
+
+static uint32_t dest_acquire(payment_engine_t *pe, const unsigned char node[33]) {
+    uint32_t d = find_dest(pe, node);
+    if (d != NO_SLOT) return d;
+    d = pe->n_free_dests ? pe->free_dests[--pe->n_free_dests]
+                         : (uint32_t)pe->n_dest_slots++;
+    payment_engine_dest_t *ds = &pe->dests[d];
+    memset(ds, 0, sizeof(*ds));
+    memcpy(ds->node, node, 33);
+    ds->wait_head = ds->wait_tail = NO_SLOT;
+    idx_insert(pe, IDX_DEST, d);
+    return d;
+}
+
+static void dest_release(payment_engine_t *pe, uint32_t d) {
+    idx_remove(pe, IDX_DEST, d);
+    pe->free_dests[pe->n_free_dests++] = d;
+}
+
+/* ---- state transitions (engine thread) ---- */
+
+/* The attempt's HTLC is resolved: stop finding the payment by it. */
+static void htlc_unindex(payment_engine_t *pe, payment_engine_entry_t *e) {
+    if (!e->htlc_indexed) return;
+    idx_remove(pe, IDX_HTLC, (uint32_t)(e - pe->entries));
+    e->htlc_indexed = 0;
+}
+
+static void start_routing(payment_engine_t *pe, payment_engine_entry_t *e,
+                          uint32_t now) {
+    uint32_t slot = (uint32_t)(e - pe->entries);
+    pthread_mutex_lock(&pe->lock);
+    e->state    = PAY_ENGINE_ROUTING;
+    e->route_at = now;
+    e->route_ok = 0;
+    e->next     = NO_SLOT;
+    e->n_attempts++;
+    if (pe->route_tail == NO_SLOT) pe->route_head = slot;
+    else pe->entries[pe->route_tail].next = slot;
+    pe->route_tail = slot;
+    pthread_cond_signal(&pe->work_cv);
+    pthread_mutex_unlock(&pe->lock);
+}
+
+static void finish(payment_engine_t *pe, payment_engine_entry_t *e,
+                   pay_engine_state_t state, uint32_t now) {
+    uint32_t slot = (uint32_t)(e - pe->entries);
+    heap_remove(pe, e);
+    htlc_unindex(pe, e);
+    e->state = state;
+    if (state == PAY_ENGINE_SUCCESS) pe->n_succeeded++;
+    else pe->n_failed++;
+    if (pe->on_result) pe->on_result(pe->result_ctx, e);
+
+    idx_remove(pe, IDX_HASH, slot);
+    uint32_t d = e->dest_slot;
+    e->dest_slot = NO_SLOT;
+    pe->count--;
+
+    /* Hand the destination slot to the next queued payment */
+    payment_engine_dest_t *ds = &pe->dests[d];
+    ds->n_active--;
+    ds->n_entries--;
+    if (ds->wait_head != NO_SLOT) {
+        payment_engine_entry_t *w = &pe->entries[ds->wait_head];
+        ds->wait_head = w->next;
+        if (ds->wait_head == NO_SLOT) ds->wait_tail = NO_SLOT;
+        ds->n_active++;
+        start_routing(pe, w, now);
+    }
+    if (!ds->n_entries) dest_release(pe, d);
+
+    pthread_mutex_lock(&pe->lock);
+    pe->free_slots[pe->n_free++] = slot;
+    pthread_mutex_unlock(&pe->lock);
+}
+
+/* One attempt failed: back off and retry, or give up. */
+static void attempt_failed(payment_engine_t *pe, payment_engine_entry_t *e,
+                           int permanent, const char *why, uint32_t now) {
+    snprintf(e->last_error, sizeof(e->last_error), "%s", why);
+    heap_remove(pe, e);
+    htlc_unindex(pe, e);
+    if (permanent || e->n_attempts >= max_attempts(pe)) {
+        finish(pe, e, PAY_ENGINE_FAILED, now);
+        return;
+    }
+    e->state = PAY_ENGINE_RETRY_WAIT;
+    int shift = e->n_attempts - 1 < 16 ? e->n_attempts - 1 : 16;
+    heap_push(pe, e, now + (retry_base_secs(pe) << shift));
+}
+
+static int route_search(payment_engine_t *pe, const unsigned char dest[33],
+                        uint64_t amount_msat, uint32_t at,
+                        pathfind_route_t *out) {
+    pthread_rwlock_rdlock(&pe->mc_lock);
+    int ok = pathfind_graph_route_ex(pe->graph, pe->our_node, dest,
+                                     amount_msat, at, pe->mc, out);
+    pthread_rwlock_unlock(&pe->mc_lock);
+    return ok;
+}
+
+/* Pop the routing queue and search; pe->lock held on entry and exit. */
+static void route_one(payment_engine_t *pe) {
+    uint32_t slot = pe->route_head;
+    payment_engine_entry_t *e = &pe->entries[slot];
+    pe->route_head = e->next;
+    if (pe->route_head == NO_SLOT) pe->route_tail = NO_SLOT;
+
+    unsigned char dest[33];
+    memcpy(dest, e->dest, 33);
+    uint64_t amount = e->amount_msat;
+    uint32_t at = e->route_at;
+    pthread_mutex_unlock(&pe->lock);
+
+    pathfind_route_t route;
+    int ok = route_search(pe, dest, amount, at, &route);
+
+    pthread_mutex_lock(&pe->lock);
+    e = &pe->entries[slot];
+    if (ok) e->route = route;
+    e->route_ok = ok;
+    e->state    = PAY_ENGINE_ROUTED;
+    e->next     = pe->done_head;
+    pe->done_head = slot;
+}
+
+static void *route_worker(void *arg) {
+    payment_engine_t *pe = (payment_engine_t *)arg;
+    pthread_mutex_lock(&pe->lock);
+    for (;;) {
+        while (!pe->stop && pe->route_head == NO_SLOT)
+            pthread_cond_wait(&pe->work_cv, &pe->lock);
+        if (pe->stop) break;
+        route_one(pe);
+    }
+    pthread_mutex_unlock(&pe->lock);
+    return NULL;
+}
+
+static int send_attempt(payment_engine_t *pe, payment_engine_entry_t *e,
+                        uint32_t now) {
+    /* final_cltv: tip + min_final_cltv_expiry (BOLT #11 §8) */
+    uint32_t tip = pe->block_height ? pe->block_height : now / 600;
+    uint32_t final_cltv = tip + e->min_final_cltv;
+    e->out_peer = -1;
+    e->out_htlc_id = 0;
+    int ok;
+    if (pe->send)
+        ok = pe->send(pe->send_ctx, e, final_cltv, e->session_key,
+                      &e->out_peer, &e->out_htlc_id);
+    else
+        ok = payment_send_route(pe->pmgr, pe->ctx, &e->route, e->amount_msat,
+                                final_cltv, e->payment_hash,
+                                e->has_payment_secret ? e->payment_secret : NULL,
+                                e->is_keysend ? e->keysend_preimage : NULL,
+                                e->session_key, &e->out_peer, &e->out_htlc_id);
+    if (ok && e->out_peer >= 0) {
+        e->htlc_key = htlc_key(e->out_peer, e->out_htlc_id);
+        idx_insert(pe, IDX_HTLC, (uint32_t)(e - pe->entries));
+        e->htlc_indexed = 1;
+    }
+    return ok;
+}
+
+/* ---- public API ---- */
+
+int payment_engine_init(payment_engine_t *pe, pathfind_graph_t *graph,
+                        mc_table_t *mc, const unsigned char our_node[33],
+                        int n_workers) {
+    if (!pe || !graph || !our_node || n_workers < 0) return 0;
+    memset(pe, 0, sizeof(*pe));
+    pe->graph = graph;
+    pe->mc = mc;
+    memcpy(pe->our_node, our_node, 33);
+    pe->route_head = pe->route_tail = pe->done_head = NO_SLOT;
+    if (pthread_mutex_init(&pe->lock, NULL) != 0) return 0;
+    pthread_cond_init(&pe->work_cv, NULL);
+    pthread_rwlock_init(&pe->mc_lock, NULL);
+
+    if (n_workers > 0) {
+        pe->workers = calloc((size_t)n_workers, sizeof(pthread_t));
+        if (!pe->workers) {
+            payment_engine_free(pe);
+            return 0;
+        }
+        for (int i = 0; i < n_workers; i++) {
+            if (pthread_create(&pe->workers[i], NULL, route_worker, pe) != 0) {
+                payment_engine_free(pe);
+                return 0;
+            }
+            pe->n_workers++;
+        }
+    }
+    return 1;
+}
+
+void payment_engine_free(payment_engine_t *pe) {
+    if (!pe) return;
+    pthread_mutex_lock(&pe->lock);
+    pe->stop = 1;
+    pthread_cond_broadcast(&pe->work_cv);
+    pthread_mutex_unlock(&pe->lock);
+    for (int i = 0; i < pe->n_workers; i++)
+        pthread_join(pe->workers[i], NULL);
+    free(pe->workers);
+
+    free(pe->entries);
+    free(pe->dests);
+    free(pe->free_slots);
+    free(pe->free_dests);
+    free(pe->idx_hash);
+    free(pe->idx_dest);
+    free(pe->idx_htlc);
+    free(pe->heap);
+    pthread_mutex_destroy(&pe->lock);
+    pthread_cond_destroy(&pe->work_cv);
+    pthread_rwlock_destroy(&pe->mc_lock);
+    memset(pe, 0, sizeof(*pe));
+}
+
+void payment_engine_set_limits(payment_engine_t *pe, int max_per_dest,
+                               int max_attempts, uint32_t timeout_secs,
+                               uint32_t retry_base_secs) {
+    if (!pe) return;
+    pe->max_per_dest    = max_per_dest > 0 ? max_per_dest : 0;
+    pe->max_attempts    = max_attempts > 0 ? max_attempts : 0;
+    pe->timeout_secs    = timeout_secs;
+    pe->retry_base_secs = retry_base_secs;
+}
+
+int payment_engine_pay(payment_engine_t *pe,
+                       const unsigned char dest[33], uint64_t amount_msat,
+                       const unsigned char payment_hash[32],
+                       const unsigned char *payment_secret,
+                       const unsigned char *keysend_preimage,
+                       uint32_t min_final_cltv, uint32_t now) {
+    if (!pe || !dest || !payment_hash || amount_msat == 0) return 0;
+    if (find_payment(pe, payment_hash)) return 0;
+    if (!ensure_index(pe, pe->count + 1)) return 0;
+
+    pthread_mutex_lock(&pe->lock);
+    uint32_t slot;
+    if (pe->n_free) {
+        slot = pe->free_slots[--pe->n_free];
+    } else if (pe->n_slots < pe->cap || grow_slots(pe)) {
+        slot = (uint32_t)pe->n_slots++;
+    } else {
+        pthread_mutex_unlock(&pe->lock);
+        return 0;
+    }
+    payment_engine_entry_t *e = &pe->entries[slot];
+    memset(e, 0, sizeof(*e));
+    pthread_mutex_unlock(&pe->lock);
+
+    memcpy(e->payment_hash, payment_hash, 32);
+    if (payment_secret) {
+        memcpy(e->payment_secret, payment_secret, 32);
+        e->has_payment_secret = 1;
+    }
+    if (keysend_preimage) {
+        memcpy(e->keysend_preimage, keysend_preimage, 32);
+        e->is_keysend = 1;
+    }
+    memcpy(e->dest, dest, 33);
+    e->amount_msat    = amount_msat;
+    /* BOLT #11 default 'c' is 18; keysend uses the same (CLN/LDK) */
+    e->min_final_cltv = min_final_cltv ? min_final_cltv : 18;
+    e->heap_pos       = NO_SLOT;
+    e->next           = NO_SLOT;
+    e->state          = PAY_ENGINE_QUEUED;
+
+    uint32_t d = dest_acquire(pe, dest);
+    e->dest_slot = d;
+    idx_insert(pe, IDX_HASH, slot);
+    pe->count++;
+
+    payment_engine_dest_t *ds = &pe->dests[d];
+    ds->n_entries++;
+    if (ds->n_active < max_per_dest(pe)) {
+        ds->n_active++;
+        start_routing(pe, e, now);
+    } else {
+        if (ds->wait_tail == NO_SLOT) ds->wait_head = slot;
+        else pe->entries[ds->wait_tail].next = slot;
+        ds->wait_tail = slot;
+    }
+    return 1;
+}
+
+int payment_engine_pay_invoice(payment_engine_t *pe,
+                               const bolt11_invoice_t *inv, uint32_t now) {
+    if (!inv) return 0;
+    return payment_engine_pay(pe, inv->payee_pubkey, inv->amount_msat,
+                              inv->payment_hash,
+                              inv->has_payment_secret ? inv->payment_secret : NULL,
+                              NULL,
+                              inv->min_final_cltv_expiry > 0
+                                  ? (uint32_t)inv->min_final_cltv_expiry : 0,
+                              now);
+}
+
+int payment_engine_tick(payment_engine_t *pe, uint32_t now) {
+    if (!pe) return 0;
+
+    pthread_mutex_lock(&pe->lock);
+    if (!pe->n_workers)
+        while (pe->route_head != NO_SLOT) route_one(pe);
+    uint32_t done = pe->done_head;
+    pe->done_head = NO_SLOT;
+    pthread_mutex_unlock(&pe->lock);
+
+    int sent = 0;
+    while (done != NO_SLOT) {
+        payment_engine_entry_t *e = &pe->entries[done];
+        done = e->next;
+        e->next = NO_SLOT;
+        if (!e->route_ok) {
+            attempt_failed(pe, e, 0, "no route", now);
+        } else if (!send_attempt(pe, e, now)) {
+            attempt_failed(pe, e, 0, "onion build failed", now);
+        } else {
+            e->state = PAY_ENGINE_INFLIGHT;
+            heap_push(pe, e, now + timeout_secs(pe));
+            pe->n_sent++;
+            sent++;
+        }
+    }
+
+    while (pe->heap_len) {
+        payment_engine_entry_t *e = &pe->entries[pe->heap[0]];
+        if (e->deadline > now) break;
+        heap_remove(pe, e);
+        if (e->state == PAY_ENGINE_INFLIGHT) {
+            /* The HTLC may still settle, so it is never resent: give up
+               on the payment and free its destination slot */
+            snprintf(e->last_error, sizeof(e->last_error), "timeout");
+            finish(pe, e, PAY_ENGINE_FAILED, now);
+        } else {
+            start_routing(pe, e, now);
+        }
+    }
+    return sent;
+}
+
+int payment_engine_on_settle(payment_engine_t *pe,
+                             const unsigned char payment_hash[32],
+                             const unsigned char preimage[32], uint32_t now) {
+    if (!pe || !payment_hash) return 0;
+    payment_engine_entry_t *e = find_payment(pe, payment_hash);
+    if (!e || e->state != PAY_ENGINE_INFLIGHT) return 0;
+
+    if (preimage) memcpy(e->preimage, preimage, 32);
+    if (pe->mc) {
+        pthread_rwlock_wrlock(&pe->mc_lock);
+        payment_mc_record(pe->mc, &e->route, e->amount_msat, -1, now);
+        pthread_rwlock_unlock(&pe->mc_lock);
+    }
+    finish(pe, e, PAY_ENGINE_SUCCESS, now);
+    return 1;
+}
+
+/* The attempt's HTLC failed: feed the failure onion to mission control,
+   then retry or fail the payment. */
+static int htlc_failed(payment_engine_t *pe, payment_engine_entry_t *e,
+                       const unsigned char *onion_error, size_t err_len,
+                       uint32_t now) {
+    int permanent = 0;
+    const char *why = "htlc failed";
+    if (onion_error && err_len >= 256) {
+        unsigned char plaintext[256];
+        int failing_hop = -1;
+        if (pe->ctx) {
+            onion_error_decrypt((const unsigned char (*)[32])e->session_key, 1,
+                                pe->ctx, onion_error, plaintext, &failing_hop);
+        } else {
+            /* ctx=NULL: onion_error is the plaintext (as payment_on_fail) */
+            memcpy(plaintext, onion_error, 256);
+            failing_hop = 0;
+        }
+
+        bolt4_failure_t failure;
+        if (bolt4_failure_parse(plaintext, 256, &failure)) {
+            why = bolt4_failure_str(failure.failure_code);
+            permanent = failure.is_permanent || failure.is_node_failure;
+            if (failure.has_channel_update && failure.channel_update_len > 0 && pe->gi) {
+                if (pe->gi_lock) pthread_mutex_lock(pe->gi_lock);
+                gossip_ingest_channel_update(pe->gi, failure.channel_update_buf,
+                                             failure.channel_update_len, now);
+                if (pe->gi_lock) pthread_mutex_unlock(pe->gi_lock);
+            }
+        }
+        if (pe->mc && failing_hop >= 0 && failing_hop < e->route.n_hops) {
+            pthread_rwlock_wrlock(&pe->mc_lock);
+            payment_mc_record(pe->mc, &e->route, e->amount_msat, failing_hop, now);
+            pthread_rwlock_unlock(&pe->mc_lock);
+        }
+    }
+
+    attempt_failed(pe, e, permanent, why, now);
+    return e->state == PAY_ENGINE_RETRY_WAIT;
+}
+
+int payment_engine_on_fail(payment_engine_t *pe,
+                           const unsigned char payment_hash[32],
+                           const unsigned char *onion_error, size_t err_len,
+                           uint32_t now) {
+    if (!pe || !payment_hash) return 0;
+    payment_engine_entry_t *e = find_payment(pe, payment_hash);
+    if (!e || e->state != PAY_ENGINE_INFLIGHT) return 0;
+    return htlc_failed(pe, e, onion_error, err_len, now);
+}
+
+int payment_engine_on_fail_htlc(payment_engine_t *pe, int peer_idx,
+                                uint64_t htlc_id,
+                                const unsigned char *onion_error, size_t err_len,
+                                uint32_t now) {
+    if (!pe || peer_idx < 0) return 0;
+    payment_engine_entry_t *e = find_htlc(pe, peer_idx, htlc_id);
+    if (!e || e->state != PAY_ENGINE_INFLIGHT) return 0;
+    return htlc_failed(pe, e, onion_error, err_len, now);
+}
+
+int payment_engine_state(payment_engine_t *pe,
+                         const unsigned char payment_hash[32]) {
+    if (!pe || !payment_hash) return -1;
+    payment_engine_entry_t *e = find_payment(pe, payment_hash);
+    if (!e) return -1;
+    pthread_mutex_lock(&pe->lock);
+    int state = (int)e->state;
+    pthread_mutex_unlock(&pe->lock);
+    return state;
+}
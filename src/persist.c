@@ -1383,6 +1383,34 @@ int persist_open(persist_t *p, const char *path) {
             NULL, NULL, NULL);
     }
 
+    /* v40: start-up only reloads open invoices; a partial index keeps that
+       independent of how many settled ones have piled up in ln_invoices. */
+    if (db_version < 40) {
+        sqlite3_exec(p->db,
+            "CREATE INDEX IF NOT EXISTS idx_ln_invoices_open "
+            "ON ln_invoices(created_at) WHERE settled = 0;",
+            NULL, NULL, NULL);
+    }
+
+    /* v41: fwd_history rollup buckets (minute / hour / day per channel
+       pair), so forwarding statistics survive a restart. */
+    if (db_version < 41) {
+        sqlite3_exec(p->db,
+            "CREATE TABLE IF NOT EXISTS fwd_rollups ("
+            "  scid_in    INTEGER NOT NULL,"    /* 0 = any */
+            "  scid_out   INTEGER NOT NULL,"    /* 0 = any */
+            "  level      INTEGER NOT NULL,"    /* 0 = minute, 1 = hour, 2 = day */
+            "  start      INTEGER NOT NULL,"    /* bucket start, Unix time */
+            "  fee_msat   INTEGER NOT NULL,"
+            "  in_msat    INTEGER NOT NULL,"
+            "  out_msat   INTEGER NOT NULL,"
+            "  n_settled  INTEGER NOT NULL,"
+            "  n_failed   INTEGER NOT NULL,"
+            "  PRIMARY KEY (scid_in, scid_out, level, start)"
+            ");",
+            NULL, NULL, NULL);
+    }
+
     /* Record the current version if not already present */
     if (db_version < PERSIST_SCHEMA_VERSION) {
         char vsql[128];
@@ -4029,6 +4057,8 @@ int persist_log_broadcast(persist_t *p, const char *txid,
 }
 
 /* Retry failed penalty broadcasts. Returns count re-broadcast. */
+#define RETRY_BROADCAST_BATCH 16   /* matches the LIMIT in the SELECT below */
+
 int persist_retry_pending_broadcasts(persist_t *p, chain_backend_t *chain) {
     if (!p || !p->db || !chain) return 0;
 
@@ -4041,11 +4071,29 @@ int persist_retry_pending_broadcasts(persist_t *p, chain_backend_t *chain) {
     if (sqlite3_prepare_v2(p->db, sql, -1, &stmt, NULL) != SQLITE_OK)
         return 0;
 
-    int retried = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int row_id = sqlite3_column_int(stmt, 0);
+    /* Collect the pending rows first so the SF-RR #150 outpoint checks
+       can go to the backend as one batch instead of one RPC per row. */
+    struct {
+        int      row_id;
+        char    *raw_hex;
+        char     prev_txid_disp[65];
+        uint32_t prev_vout;
+        uint32_t nseq;
+        int      have_parsed;
+        int      unspent;
+    } rows[RETRY_BROADCAST_BATCH];
+    size_t n_rows = 0;
+
+    while (n_rows < RETRY_BROADCAST_BATCH && sqlite3_step(stmt) == SQLITE_ROW) {
         const char *raw_hex = (const char *)sqlite3_column_text(stmt, 1);
         if (!raw_hex) continue;
+        char *raw_copy = strdup(raw_hex);
+        if (!raw_copy) continue;
+
+        memset(&rows[n_rows], 0, sizeof(rows[n_rows]));
+        rows[n_rows].row_id = sqlite3_column_int(stmt, 0);
+        rows[n_rows].raw_hex = raw_copy;
+        rows[n_rows].unspent = -1;
 
         /* Parse the first input from raw_hex.  Shared by:
              - SF-RR #150 outpoint-unspent staleness check
@@ -4053,10 +4101,9 @@ int persist_retry_pending_broadcasts(persist_t *p, chain_backend_t *chain) {
                must reach required_depth before retrying)
            SuperScalar txs are always segwit with empty scriptSig (single byte
            0x00), so we don't handle multi-byte scriptSig varints. */
-        char     prev_txid_disp[65] = {0};
-        uint32_t prev_vout = 0;
-        uint32_t nseq = 0;
-        int      have_parsed = 0;
+        char     *prev_txid_disp = rows[n_rows].prev_txid_disp;
+        uint32_t  prev_vout = 0;
+        uint32_t  nseq = 0;
         {
             size_t hex_len = strlen(raw_hex);
             if (hex_len >= 84) {
@@ -4085,37 +4132,74 @@ int persist_retry_pending_broadcasts(persist_t *p, chain_backend_t *chain) {
                                            raw_hex[vin_ofs + 74 + j*2 + 1], 0 };
                             nseq |= (uint32_t)strtoul(hb, NULL, 16) << (j * 8);
                         }
-                        have_parsed = 1;
+                        rows[n_rows].have_parsed = 1;
                     }
                 }
             }
         }
+        rows[n_rows].prev_vout = prev_vout;
+        rows[n_rows].nseq = nseq;
+        n_rows++;
+    }
+    sqlite3_finalize(stmt);
+
+    /* SF-RR #150: if backend supports outpoint queries, check each row's
+       first-input outpoint before re-broadcasting — batched when the
+       backend can answer the whole sweep in one round-trip. */
+    if (chain->is_outpoint_unspent_batch || chain->is_outpoint_unspent) {
+        const char *q_txids[RETRY_BROADCAST_BATCH];
+        uint32_t    q_vouts[RETRY_BROADCAST_BATCH];
+        int         q_res[RETRY_BROADCAST_BATCH];
+        size_t      q_row[RETRY_BROADCAST_BATCH];
+        size_t      n_q = 0;
+        for (size_t r = 0; r < n_rows; r++) {
+            if (!rows[r].have_parsed) continue;
+            q_txids[n_q] = rows[r].prev_txid_disp;
+            q_vouts[n_q] = rows[r].prev_vout;
+            q_row[n_q]   = r;
+            n_q++;
+        }
+        int batched = 0;
+        if (n_q > 0 && chain->is_outpoint_unspent_batch)
+            batched = chain->is_outpoint_unspent_batch(chain, q_txids, q_vouts,
+                                                       n_q, q_res);
+        for (size_t k = 0; k < n_q; k++) {
+            if (!batched)
+                q_res[k] = chain->is_outpoint_unspent
+                    ? chain->is_outpoint_unspent(chain, q_txids[k], q_vouts[k])
+                    : -1;
+            rows[q_row[k]].unspent = q_res[k];
+        }
+    }
 
-        /* SF-RR #150: if backend supports outpoint queries, check the first
-           input's outpoint before re-broadcasting. If it has been spent
-           (state moved on while we were down), mark stale and skip — prevents
-           infinite retry on dead pending entries. */
-        if (have_parsed && chain->is_outpoint_unspent) {
-            int unspent = chain->is_outpoint_unspent(chain,
-                            prev_txid_disp, prev_vout);
-            if (unspent == 0) {
-                fprintf(stderr,
-                    "SF-RR #150: outpoint %s:%u already spent, "
-                    "marking broadcast_log row %d stale_input_spent\n",
-                    prev_txid_disp, prev_vout, row_id);
-                const char *upd_stale =
-                    "UPDATE broadcast_log "
-                    "SET result='stale_input_spent' WHERE id=?;";
-                sqlite3_stmt *us;
-                if (sqlite3_prepare_v2(p->db, upd_stale, -1, &us, NULL)
-                        == SQLITE_OK) {
-                    sqlite3_bind_int(us, 1, row_id);
-                    sqlite3_step(us);
-                    sqlite3_finalize(us);
-                }
-                continue;  /* skip this row */
+    int retried = 0;
+    for (size_t r = 0; r < n_rows; r++) {
+        int         row_id         = rows[r].row_id;
+        const char *raw_hex        = rows[r].raw_hex;
+        const char *prev_txid_disp = rows[r].prev_txid_disp;
+        uint32_t    nseq           = rows[r].nseq;
+        int         have_parsed    = rows[r].have_parsed;
+
+        /* SF-RR #150: the first input's outpoint has been spent (state
+           moved on while we were down) — mark stale and skip, preventing
+           infinite retry on dead pending entries.  unspent==1 (good) or
+           unspent==-1 (RPC error / no backend support) falls through. */
+        if (have_parsed && rows[r].unspent == 0) {
+            fprintf(stderr,
+                "SF-RR #150: outpoint %s:%u already spent, "
+                "marking broadcast_log row %d stale_input_spent\n",
+                prev_txid_disp, rows[r].prev_vout, row_id);
+            const char *upd_stale =
+                "UPDATE broadcast_log "
+                "SET result='stale_input_spent' WHERE id=?;";
+            sqlite3_stmt *us;
+            if (sqlite3_prepare_v2(p->db, upd_stale, -1, &us, NULL)
+                    == SQLITE_OK) {
+                sqlite3_bind_int(us, 1, row_id);
+                sqlite3_step(us);
+                sqlite3_finalize(us);
             }
-            /* unspent==1 (good) or unspent==-1 (RPC error) → fall through */
+            continue;  /* skip this row */
         }
 
         /* SF-CSV-WAIT #299 (followup to #247): if the tx encumbers a BIP-68
@@ -4153,7 +4237,8 @@ int persist_retry_pending_broadcasts(persist_t *p, chain_backend_t *chain) {
             fprintf(stderr, "Watchtower: retry broadcast still failing (id=%d)\n", row_id);
         }
     }
-    sqlite3_finalize(stmt);
+    for (size_t r = 0; r < n_rows; r++)
+        free(rows[r].raw_hex);
     return retried;
 }
 
@@ -4631,6 +4716,22 @@ int persist_deactivate_invoice(persist_t *p,
     return ok5;
 }
 
+size_t persist_count_invoices(persist_t *p) {
+    if (!p || !p->db) return 0;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(p->db,
+            "SELECT COUNT(*) FROM invoice_registry WHERE active = 1;",
+            -1, &stmt, NULL) != SQLITE_OK)
+        return 0;
+
+    size_t count = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        count = (size_t)sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return count;
+}
+
 size_t persist_load_invoices(persist_t *p,
                               unsigned char (*hashes_out)[32],
                               size_t *dest_clients_out,
@@ -6265,14 +6366,14 @@ int persist_load_ln_invoices(persist_t *p, bolt11_invoice_table_t *tbl) {
             "SELECT payment_hash, preimage, payment_secret, amount_msat, "
             "       description, expiry, created_at, settled, active, "
             "       has_stateless_secret, has_stateless_preimage, stateless_nonce "
-            "  FROM ln_invoices;",
+            "  FROM ln_invoices WHERE settled = 0 ORDER BY created_at;",
             -1, &stmt, NULL) != SQLITE_OK)
         return -1;
 
     int n = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW &&
-           tbl->count < INVOICE_TABLE_MAX) {
-        bolt11_invoice_entry_t *e = &tbl->entries[tbl->count];
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        bolt11_invoice_entry_t row;
+        bolt11_invoice_entry_t *e = &row;
         memset(e, 0, sizeof(*e));
 
         const void *ph = sqlite3_column_blob(stmt, 0);
@@ -6302,7 +6403,11 @@ int persist_load_ln_invoices(persist_t *p, bolt11_invoice_table_t *tbl) {
         if (nonce && e->has_stateless_preimage)
             memcpy(e->stateless_nonce, nonce, 32);
 
-        tbl->count++;
+        if (!e->active) continue;
+        if (!invoice_add(tbl, e)) {
+            if (tbl->count >= (int)INVOICE_TABLE_MAX) break;
+            continue;  /* duplicate payment_hash */
+        }
         n++;
     }
     sqlite3_finalize(stmt);
@@ -6463,6 +6568,110 @@ int persist_load_circuit_breaker_peers(persist_t *p, circuit_breaker_t *cb) {
     return count;
 }
 
+/* === Forwarding rollups (schema v41) === */
+
+#include "superscalar/fwd_history.h"
+
+int persist_save_fwd_rollups(persist_t *p, fwd_history_t *h) {
+    if (!p || !p->db || !h) return -1;
+
+    int own_txn = !p->in_transaction;
+    if (own_txn && !persist_begin(p)) return -1;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(p->db,
+            "INSERT OR REPLACE INTO fwd_rollups "
+            "(scid_in, scid_out, level, start, fee_msat, in_msat, out_msat, "
+            " n_settled, n_failed) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);",
+            -1, &stmt, NULL) != SQLITE_OK) {
+        if (own_txn) persist_rollback(p);
+        return -1;
+    }
+
+    int count = 0;
+    for (uint32_t i = 0; i < h->n_bucket_slots; i++) {
+        const fwd_bucket_t *b = &h->buckets[i];
+        if (b->level >= FWD_ROLLUP_LEVELS || !b->dirty) continue;  /* free / clean */
+        const fwd_series_t *se = &h->series[b->series];
+
+        sqlite3_bind_int64(stmt, 1, (sqlite3_int64)se->scid_in);
+        sqlite3_bind_int64(stmt, 2, (sqlite3_int64)se->scid_out);
+        sqlite3_bind_int  (stmt, 3, (int)b->level);
+        sqlite3_bind_int64(stmt, 4, (sqlite3_int64)b->start);
+        sqlite3_bind_int64(stmt, 5, (sqlite3_int64)b->r.fee_msat);
+        sqlite3_bind_int64(stmt, 6, (sqlite3_int64)b->r.in_msat);
+        sqlite3_bind_int64(stmt, 7, (sqlite3_int64)b->r.out_msat);
+        sqlite3_bind_int64(stmt, 8, (sqlite3_int64)b->r.n_settled);
+        sqlite3_bind_int64(stmt, 9, (sqlite3_int64)b->r.n_failed);
+        int ok = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_reset(stmt);
+        if (!ok) {
+            sqlite3_finalize(stmt);
+            if (own_txn) persist_rollback(p);
+            return -1;
+        }
+        count++;
+    }
+    sqlite3_finalize(stmt);
+
+    /* Minute / hour buckets the history has dropped */
+    if (sqlite3_prepare_v2(p->db,
+            "DELETE FROM fwd_rollups "
+            "WHERE (level = 0 AND start < ?) OR (level = 1 AND start < ?);",
+            -1, &stmt, NULL) != SQLITE_OK) {
+        if (own_txn) persist_rollback(p);
+        return -1;
+    }
+    sqlite3_bind_int64(stmt, 1, (sqlite3_int64)fwd_history_level_cutoff(h, 0));
+    sqlite3_bind_int64(stmt, 2, (sqlite3_int64)fwd_history_level_cutoff(h, 1));
+    int rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        if (own_txn) persist_rollback(p);
+        return -1;
+    }
+
+    if (own_txn && !persist_commit(p)) return -1;
+    for (uint32_t i = 0; i < h->n_bucket_slots; i++)
+        h->buckets[i].dirty = 0;
+    return count;
+}
+
+int persist_load_fwd_rollups(persist_t *p, fwd_history_t *h) {
+    if (!p || !p->db || !h) return -1;
+
+    /* Oldest first within each level, as fwd_history_restore_bucket needs */
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(p->db,
+            "SELECT scid_in, scid_out, level, start, fee_msat, in_msat, "
+            "       out_msat, n_settled, n_failed "
+            "  FROM fwd_rollups ORDER BY level, start;",
+            -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+
+    int count = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        fwd_rollup_t r;
+        r.fee_msat  = (uint64_t)sqlite3_column_int64(stmt, 4);
+        r.in_msat   = (uint64_t)sqlite3_column_int64(stmt, 5);
+        r.out_msat  = (uint64_t)sqlite3_column_int64(stmt, 6);
+        r.n_settled = (uint64_t)sqlite3_column_int64(stmt, 7);
+        r.n_failed  = (uint64_t)sqlite3_column_int64(stmt, 8);
+        if (!fwd_history_restore_bucket(h,
+                (uint64_t)sqlite3_column_int64(stmt, 0),
+                (uint64_t)sqlite3_column_int64(stmt, 1),
+                (uint32_t)sqlite3_column_int(stmt, 2),
+                (uint32_t)sqlite3_column_int64(stmt, 3), &r)) {
+            sqlite3_finalize(stmt);
+            return -1;
+        }
+        count++;
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
 /* === PTLC persistence (schema v10) === */
 
 int persist_save_ptlc(persist_t *p, uint32_t channel_id, const ptlc_t *ptlc) {
@@ -1,6 +1,18 @@
 #include "superscalar/rate_limit.h"
+#include <arpa/inet.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define NO_ENTRY  UINT32_MAX
+
+enum {
+    KEY_V4 = 1,       /* IPv4 address */
+    KEY_V4_NET,       /* IPv4 /24 */
+    KEY_V6,           /* IPv6 /64 */
+    KEY_V6_NET,       /* IPv6 /48 */
+    KEY_STR           /* hash of a non-address string */
+};
+
 void rate_limiter_init(rate_limiter_t *rl, int max_per_window,
                        int window_secs, int max_handshakes) {
     memset(rl, 0, sizeof(*rl));
@@ -8,52 +20,261 @@ void rate_limiter_init(rate_limiter_t *rl, int max_per_window,
     rl->window_secs = window_secs > 0 ? window_secs : 60;
     rl->max_handshakes = max_handshakes > 0 ? max_handshakes : 4;
     rl->active_handshakes = 0;
+    rl->max_sources = RATE_LIMIT_MAX_SOURCES;
+    rl->max_per_subnet = RATE_LIMIT_SUBNET_FACTOR * rl->max_per_window;
+    rl->lru_head = rl->lru_tail = NO_ENTRY;
 }
 
-/* Simple hash of IP string to bucket index. */
-static uint32_t hash_ip(const char *ip) {
-    uint32_t h = 5381;
-    for (const char *p = ip; *p; p++)
-        h = ((h << 5) + h) ^ (uint32_t)(unsigned char)*p;
-    return h;
+void rate_limiter_free(rate_limiter_t *rl) {
+    if (!rl) return;
+    free(rl->entries);
+    free(rl->idx);
+    rl->entries = NULL;
+    rl->idx = NULL;
+    rl->n_entries = rl->cap = rl->idx_cap = 0;
+    rl->lru_head = rl->lru_tail = NO_ENTRY;
 }
 
-int rate_limiter_allow(rate_limiter_t *rl, const char *ip_addr) {
-    if (!rl || !ip_addr) return 0;
+void rate_limiter_set_limits(rate_limiter_t *rl, uint32_t max_sources,
+                             int max_per_subnet) {
+    if (!rl) return;
+    if (max_sources == 0) max_sources = RATE_LIMIT_MAX_SOURCES;
+    if (max_sources < 16) max_sources = 16;
+    /* Shrinking below what is stored would strand entries */
+    if (max_sources < rl->n_entries) max_sources = rl->n_entries;
+    rl->max_sources = max_sources;
+    if (max_per_subnet == 0)
+        rl->max_per_subnet = RATE_LIMIT_SUBNET_FACTOR * rl->max_per_window;
+    else
+        rl->max_per_subnet = max_per_subnet > 0 ? max_per_subnet : 0;
+}
+
+/* ---- Internal helpers ---- */
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t load64(const unsigned char *b) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | b[i];
+    return v;
+}
 
-    uint32_t h = hash_ip(ip_addr);
-    size_t idx = h % RATE_LIMIT_BUCKETS;
-    rate_limit_bucket_t *b = &rl->buckets[idx];
+static uint64_t key_hash(uint8_t kind, const unsigned char key[16]) {
+    return mix64(load64(key) ^ mix64(load64(key + 8) ^ kind));
+}
+
+/*
+ * Source key for ip_addr and, for addresses, the key of its subnet.
+ * Returns 1 if a subnet key was produced.
+ */
+static int make_keys(const char *ip, uint8_t *kind, unsigned char key[16],
+                     uint8_t *net_kind, unsigned char net_key[16]) {
+    unsigned char a[16];
+    memset(key, 0, 16);
+    memset(net_key, 0, 16);
 
-    time_t now = time(NULL);
-    time_t cutoff = now - rl->window_secs;
+    if (inet_pton(AF_INET, ip, a) == 1) {
+        *kind = KEY_V4;     memcpy(key, a, 4);
+        *net_kind = KEY_V4_NET; memcpy(net_key, a, 3);
+        return 1;
+    }
+    if (inet_pton(AF_INET6, ip, a) == 1) {
+        static const unsigned char v4_mapped[12] =
+            { 0,0,0,0, 0,0,0,0, 0,0,0xff,0xff };
+        if (memcmp(a, v4_mapped, 12) == 0) {
+            *kind = KEY_V4;     memcpy(key, a + 12, 4);
+            *net_kind = KEY_V4_NET; memcpy(net_key, a + 12, 3);
+        } else {
+            *kind = KEY_V6;     memcpy(key, a, 8);
+            *net_kind = KEY_V6_NET; memcpy(net_key, a, 6);
+        }
+        return 1;
+    }
 
-    /* If bucket is for a different IP (collision), reset it */
-    if (b->count > 0 && b->ip_hash != h) {
-        b->count = 0;
-        b->head = 0;
+    /* Any other string: FNV-1a in two lanes, 128 bits */
+    uint64_t h1 = 0xcbf29ce484222325ULL, h2 = 0x84222325cbf29ce4ULL;
+    for (const unsigned char *p = (const unsigned char *)ip; *p; p++) {
+        h1 = (h1 ^ *p) * 0x100000001b3ULL;
+        h2 = (h2 ^ *p) * 0x100000001b3ULL + 1;
+    }
+    h1 = mix64(h1);
+    h2 = mix64(h2 ^ h1);
+    for (int i = 0; i < 8; i++) {
+        key[i]     = (unsigned char)(h1 >> (56 - 8 * i));
+        key[8 + i] = (unsigned char)(h2 >> (56 - 8 * i));
     }
-    b->ip_hash = h;
+    *kind = KEY_STR;
+    return 0;
+}
 
-    /* Count recent timestamps within window */
-    int recent = 0;
-    for (size_t i = 0; i < b->count && i < RATE_LIMIT_RING_SIZE; i++) {
-        if (b->timestamps[i] >= cutoff)
-            recent++;
+static long find_entry(const rate_limiter_t *rl, uint8_t kind,
+                       const unsigned char key[16]) {
+    if (rl->idx_cap == 0) return -1;
+    uint32_t mask = rl->idx_cap - 1;
+    for (uint32_t s = (uint32_t)key_hash(kind, key) & mask; ; s = (s + 1) & mask) {
+        uint32_t v = rl->idx[s];
+        if (v == 0) return -1;
+        const rate_limit_entry_t *e = &rl->entries[v - 1];
+        if (e->kind == kind && memcmp(e->key, key, 16) == 0)
+            return (long)(v - 1);
     }
+}
 
-    if (recent >= rl->max_per_window)
-        return 0;  /* rate limited */
+static void idx_put(rate_limiter_t *rl, uint32_t i) {
+    uint32_t mask = rl->idx_cap - 1;
+    uint32_t s = (uint32_t)key_hash(rl->entries[i].kind, rl->entries[i].key) & mask;
+    while (rl->idx[s] != 0) s = (s + 1) & mask;
+    rl->idx[s] = i + 1;
+}
 
-    /* Record this connection */
-    b->timestamps[b->head] = now;
-    b->head = (b->head + 1) % RATE_LIMIT_RING_SIZE;
-    if (b->count < RATE_LIMIT_RING_SIZE)
-        b->count++;
+static void idx_del(rate_limiter_t *rl, uint32_t i) {
+    uint32_t mask = rl->idx_cap - 1;
+    uint32_t s = (uint32_t)key_hash(rl->entries[i].kind, rl->entries[i].key) & mask;
+    while (rl->idx[s] != i + 1) s = (s + 1) & mask;
+
+    /* Backward-shift deletion keeps probe chains intact */
+    uint32_t hole = s;
+    for (uint32_t j = (hole + 1) & mask; rl->idx[j] != 0; j = (j + 1) & mask) {
+        const rate_limit_entry_t *o = &rl->entries[rl->idx[j] - 1];
+        uint32_t home = (uint32_t)key_hash(o->kind, o->key) & mask;
+        int stays = (hole <= j) ? (hole < home && home <= j)
+                                : (hole < home || home <= j);
+        if (stays) continue;
+        rl->idx[hole] = rl->idx[j];
+        hole = j;
+    }
+    rl->idx[hole] = 0;
+}
 
+static void lru_unlink(rate_limiter_t *rl, uint32_t i) {
+    rate_limit_entry_t *e = &rl->entries[i];
+    if (e->lru_prev != NO_ENTRY) rl->entries[e->lru_prev].lru_next = e->lru_next;
+    else rl->lru_head = e->lru_next;
+    if (e->lru_next != NO_ENTRY) rl->entries[e->lru_next].lru_prev = e->lru_prev;
+    else rl->lru_tail = e->lru_prev;
+}
+
+static void lru_push_front(rate_limiter_t *rl, uint32_t i) {
+    rate_limit_entry_t *e = &rl->entries[i];
+    e->lru_prev = NO_ENTRY;
+    e->lru_next = rl->lru_head;
+    if (rl->lru_head != NO_ENTRY) rl->entries[rl->lru_head].lru_prev = i;
+    else rl->lru_tail = i;
+    rl->lru_head = i;
+}
+
+/* Entry for key, created (evicting the LRU entry if full); -1 on OOM. */
+static long get_entry(rate_limiter_t *rl, uint8_t kind,
+                      const unsigned char key[16]) {
+    long f = find_entry(rl, kind, key);
+    if (f >= 0) {
+        if (rl->lru_head != (uint32_t)f) {
+            lru_unlink(rl, (uint32_t)f);
+            lru_push_front(rl, (uint32_t)f);
+        }
+        return f;
+    }
+
+    uint32_t i;
+    if (rl->n_entries >= rl->max_sources && rl->lru_tail != NO_ENTRY) {
+        i = rl->lru_tail;
+        idx_del(rl, i);
+        lru_unlink(rl, i);
+        rl->n_evicted++;
+    } else {
+        if (rl->n_entries == rl->cap) {
+            uint32_t nc = rl->cap ? rl->cap * 2 : 256;
+            if (nc > rl->max_sources) nc = rl->max_sources;
+            rate_limit_entry_t *ne = realloc(rl->entries, (size_t)nc * sizeof(*ne));
+            if (!ne) return -1;
+            rl->entries = ne;
+            rl->cap = nc;
+        }
+        if ((rl->n_entries + 1) * 2 > rl->idx_cap) {
+            uint32_t nc = rl->idx_cap ? rl->idx_cap * 2 : 512;
+            uint32_t *ni = calloc(nc, sizeof(*ni));
+            if (!ni) return -1;
+            free(rl->idx);
+            rl->idx = ni;
+            rl->idx_cap = nc;
+            for (uint32_t k = 0; k < rl->n_entries; k++)
+                idx_put(rl, k);
+        }
+        i = rl->n_entries++;
+    }
+
+    rate_limit_entry_t *e = &rl->entries[i];
+    memcpy(e->key, key, 16);
+    e->kind   = kind;
+    e->tat_us = 0;
+    idx_put(rl, i);
+    lru_push_front(rl, i);
+    return (long)i;
+}
+
+/*
+ * GCRA: each connection advances the theoretical arrival time by the
+ * emission interval; one is allowed while that stays within the window.
+ * Returns the new TAT, or 0 if the connection is over the limit.
+ */
+static uint64_t gcra_next(uint64_t tat, uint64_t now_us, int limit,
+                          uint64_t window_us) {
+    uint64_t interval = window_us / (uint64_t)limit;
+    if (interval == 0) interval = 1;
+    uint64_t base = tat > now_us ? tat : now_us;
+    if (base + interval - now_us > interval * (uint64_t)limit) return 0;
+    return base + interval;
+}
+
+/* ---- Public API ---- */
+
+int rate_limiter_allow_at(rate_limiter_t *rl, const char *ip_addr,
+                          uint64_t now_us) {
+    if (!rl || !ip_addr) return 0;
+
+    uint8_t kind, net_kind = 0;
+    unsigned char key[16], net_key[16];
+    int has_net = make_keys(ip_addr, &kind, key, &net_kind, net_key)
+                  && rl->max_per_subnet > 0;
+    uint64_t window_us = (uint64_t)rl->window_secs * 1000000;
+
+    /* The source is moved to the LRU head, so creating the subnet entry
+     * (max_sources >= 16) never evicts it */
+    long si = get_entry(rl, kind, key);
+    if (si < 0) return 0;
+    uint64_t tat = gcra_next(rl->entries[si].tat_us, now_us,
+                             rl->max_per_window, window_us);
+    if (tat == 0) return 0;  /* rate limited */
+
+    if (has_net) {
+        long ni = get_entry(rl, net_kind, net_key);
+        if (ni < 0) return 0;
+        uint64_t net_tat = gcra_next(rl->entries[ni].tat_us, now_us,
+                                     rl->max_per_subnet, window_us);
+        if (net_tat == 0) return 0;  /* subnet over its limit */
+        rl->entries[ni].tat_us = net_tat;
+    }
+
+    /* Record this connection */
+    rl->entries[si].tat_us = tat;
     return 1;
 }
 
+int rate_limiter_allow(rate_limiter_t *rl, const char *ip_addr) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return rate_limiter_allow_at(rl, ip_addr,
+                                 (uint64_t)ts.tv_sec * 1000000
+                                 + (uint64_t)ts.tv_nsec / 1000);
+}
+
 int rate_limiter_handshake_start(rate_limiter_t *rl) {
     if (!rl) return 0;
     if (rl->active_handshakes >= rl->max_handshakes)
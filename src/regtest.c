@@ -1,4 +1,6 @@
 #include "superscalar/regtest.h"
+#include "superscalar/rpc_client.h"
+#include "superscalar/block_cache.h"
 #include "cJSON.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +37,8 @@ static inline bool regtest_err_is_expected_poll_miss(int code) {
    regtest_exec() to detect -18 "Requested wallet does not exist" and trigger
    a one-shot reload + retry. See task #298. */
 static __thread int g_regtest_last_http_error = 0;
+/* Set when the last HTTP call was sent but not answered in time. */
+static __thread int g_regtest_last_http_timeout = 0;
 
 /* Auto-recovery rate limit. bitcoind's "wallet not loaded" state can drive
    long polling loops, so we coalesce concurrent -18 errors into at most one
@@ -363,41 +367,45 @@ static void free_argv(char **argv, size_t n) {
 /* -----------------------------------------------------------------------
  * HTTP JSON-RPC client for Bitcoin Core
  *
- * Replaces fork+exec(bitcoin-cli) with a direct HTTP/1.0 POST to
- * 127.0.0.1:rpcport.  One TCP connection per call; no external deps.
+ * Replaces fork+exec(bitcoin-cli) with JSON-RPC to 127.0.0.1:rpcport
+ * through the shared keep-alive client (rpc_client.h): pooled HTTP/1.1
+ * connections, auth header built once, array batching for sweeps.
  * Falls back to fork+exec when rpcport == 0.
  * --------------------------------------------------------------------- */
 
 #ifdef _POSIX_VERSION
 
-/* RFC 4648 base64 encoder. Writes NUL-terminated string to out[0..out_cap).
-   Returns number of output chars written (excluding NUL), or -1 on overflow. */
-static int regtest_base64(const char *in, size_t in_len, char *out, size_t out_cap)
+/* Shared client for this regtest_t's endpoint.  regtest_t is routinely
+   copied by value, so the client is looked up by endpoint rather than
+   stored in the struct. */
+static rpc_client_t *regtest_rpc_client(const regtest_t *rt)
 {
-    static const char b64[] =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    size_t olen = ((in_len + 2) / 3) * 4;
-    if (olen + 1 > out_cap) return -1;
-    size_t i, j;
-    for (i = 0, j = 0; i + 2 < in_len; i += 3) {
-        unsigned c0 = (unsigned char)in[i];
-        unsigned c1 = (unsigned char)in[i+1];
-        unsigned c2 = (unsigned char)in[i+2];
-        out[j++] = b64[(c0 >> 2) & 0x3f];
-        out[j++] = b64[((c0 << 4) | (c1 >> 4)) & 0x3f];
-        out[j++] = b64[((c1 << 2) | (c2 >> 6)) & 0x3f];
-        out[j++] = b64[c2 & 0x3f];
-    }
-    if (i < in_len) {
-        unsigned c0 = (unsigned char)in[i];
-        unsigned c1 = (i + 1 < in_len) ? (unsigned char)in[i+1] : 0;
-        out[j++] = b64[(c0 >> 2) & 0x3f];
-        out[j++] = b64[((c0 << 4) | (c1 >> 4)) & 0x3f];
-        out[j++] = (i + 1 < in_len) ? b64[(c1 << 2) & 0x3f] : '=';
-        out[j++] = '=';
-    }
-    out[j] = '\0';
-    return (int)j;
+    int port = (rt->rpcport > 0) ? rt->rpcport : 18443;
+    return rpc_client_shared("127.0.0.1", port, rt->rpcuser, rt->rpcpassword);
+}
+
+/* Serialize an RPC result the way bitcoin-cli prints it. */
+static char *regtest_format_result(const cJSON *result)
+{
+    char *out = NULL;
+    if (cJSON_IsString(result)) {
+        /* Return with outer quotes: matches bitcoin-cli "value"\n format */
+        size_t vlen = strlen(result->valuestring);
+        out = malloc(vlen + 3);
+        if (out) {
+            out[0] = '"';
+            memcpy(out + 1, result->valuestring, vlen);
+            out[vlen + 1] = '"';
+            out[vlen + 2] = '\0';
+        }
+    } else if (cJSON_IsNumber(result)) {
+        out = malloc(64);
+        if (out) snprintf(out, 64, "%g", result->valuedouble);
+    } else {
+        /* Object, array, bool, null: compact JSON */
+        out = cJSON_PrintUnformatted(result);
+    }
+    return out;
 }
 
 /* Convert space-tokenized params string (same format as build_argv) into
@@ -503,7 +511,7 @@ static int params_to_json_array(const char *params, char *out, size_t out_cap)
     return 1;
 }
 
-/* HTTP/1.0 JSON-RPC POST to Bitcoin Core.
+/* JSON-RPC call to Bitcoin Core over the shared keep-alive client.
    Returns malloc'd string containing the serialized "result" field,
    or NULL on error (caller falls back to fork+exec).
    Return format mirrors bitcoin-cli output:
@@ -514,17 +522,10 @@ static int params_to_json_array(const char *params, char *out, size_t out_cap)
 static char *regtest_http_rpc(const regtest_t *rt,
                                const char *method, const char *params)
 {
-    int port = (rt->rpcport > 0) ? rt->rpcport : 18443;
-
-    /* Build Basic Auth header */
-    char credentials[512];
-    snprintf(credentials, sizeof(credentials), "%s:%s", rt->rpcuser, rt->rpcpassword);
-    char auth_b64[512];
-    if (regtest_base64(credentials, strlen(credentials), auth_b64, sizeof(auth_b64)) < 0)
-        return NULL;
+    rpc_client_t *client = regtest_rpc_client(rt);
+    if (!client) return NULL;
 
-    /* Build JSON-RPC body — heap-allocated to handle large params (e.g. raw tx hex).
-       params_json capacity: params length * 2 + 32 covers worst-case escaping. */
+    /* params_json capacity: params length * 2 + 64 covers worst-case escaping. */
     size_t params_len = params ? strlen(params) : 0;
     size_t pjcap = params_len * 2 + 64;
     char *params_json = malloc(pjcap);
@@ -532,133 +533,29 @@ static char *regtest_http_rpc(const regtest_t *rt,
     if (!params_to_json_array(params, params_json, pjcap)) {
         free(params_json); return NULL;
     }
-
-    /* Wallet path: /wallet/NAME or / */
-    char path[256] = "/";
-    if (rt->wallet[0] != '\0')
-        snprintf(path, sizeof(path), "/wallet/%s", rt->wallet);
-
-    size_t bodycap = strlen(params_json) + 128;
-    char *body = malloc(bodycap);
-    if (!body) { free(params_json); return NULL; }
-    int body_len = snprintf(body, bodycap,
-        "{\"jsonrpc\":\"1.0\",\"id\":1,\"method\":\"%s\",\"params\":%s}",
-        method, params_json);
+    cJSON *jparams = cJSON_Parse(params_json);
     free(params_json);
-    if (body_len <= 0 || (size_t)body_len >= bodycap) { free(body); return NULL; }
-
-    /* Build HTTP request */
-    size_t reqcap = (size_t)body_len + 512;
-    char *req = malloc(reqcap);
-    if (!req) { free(body); return NULL; }
-    int req_len = snprintf(req, reqcap,
-        "POST %s HTTP/1.0\r\n"
-        "Host: 127.0.0.1:%d\r\n"
-        "Authorization: Basic %s\r\n"
-        "Content-Type: application/json\r\n"
-        "Content-Length: %d\r\n"
-        "Connection: close\r\n"
-        "\r\n"
-        "%s",
-        path, port, auth_b64, body_len, body);
-    free(body);
-    if (req_len <= 0 || (size_t)req_len >= reqcap) { free(req); return NULL; }
-
-    /* Connect to 127.0.0.1:port */
-    struct addrinfo hints, *res = NULL;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family   = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    char port_str[16];
-    snprintf(port_str, sizeof(port_str), "%d", port);
-    if (getaddrinfo("127.0.0.1", port_str, &hints, &res) != 0) { free(req); return NULL; }
-
-    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (fd < 0) { freeaddrinfo(res); free(req); return NULL; }
-    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
-        close(fd); freeaddrinfo(res); free(req); return NULL;
-    }
-    freeaddrinfo(res);
-
-    /* Send request */
-    ssize_t sent_bytes = send(fd, req, (size_t)req_len, 0);
-    free(req);
-    if (sent_bytes != (ssize_t)req_len) {
-        close(fd); return NULL;
-    }
-
-    /* Read full response */
-    size_t cap = 65536, used = 0;
-    char *resp = malloc(cap);
-    if (!resp) { close(fd); return NULL; }
-    ssize_t n;
-    while ((n = recv(fd, resp + used, cap - used - 1, 0)) > 0) {
-        used += (size_t)n;
-        if (used + 1 >= cap) {
-            cap *= 2;
-            char *tmp = realloc(resp, cap);
-            if (!tmp) { free(resp); close(fd); return NULL; }
-            resp = tmp;
-        }
-    }
-    close(fd);
-    resp[used] = '\0';
-
-    /* Find HTTP body (after blank line) */
-    char *bodyp = strstr(resp, "\r\n\r\n");
-    if (!bodyp) { free(resp); return NULL; }
-    bodyp += 4;
-
-    /* Parse JSON-RPC response */
-    cJSON *jresp = cJSON_Parse(bodyp);
-    free(resp);
-    if (!jresp) return NULL;
-
-    /* Check for error */
-    cJSON *err = cJSON_GetObjectItem(jresp, "error");
-    if (err && !cJSON_IsNull(err)) {
-        cJSON *ecode = cJSON_GetObjectItem(err, "code");
-        int code = (ecode && cJSON_IsNumber(ecode)) ? ecode->valueint : 0;
-        g_regtest_last_http_error = code;
-        /* In poll-quiet scope, swallow the codes that are the normal negative
-           answer (tx not in mempool/chain; wallet path wrong because tx not
-           in this wallet). Real errors (-32700 parse, -32601 method missing,
-           etc.) still surface. See task #200. */
-        if (!(g_regtest_poll_quiet && regtest_err_is_expected_poll_miss(code))) {
-            char *errstr = cJSON_PrintUnformatted(err);
-            if (errstr) {
-                fprintf(stderr, "HTTP RPC %s error: %s\n", method, errstr);
-                free(errstr);
-            }
+    if (!jparams) return NULL;
+
+    rpc_error_t err;
+    cJSON *result = rpc_client_call(client, rt->wallet, method, jparams, &err);
+    if (!result) {
+        g_regtest_last_http_timeout = err.timed_out;
+        if (err.code != 0) {
+            g_regtest_last_http_error = err.code;
+            /* In poll-quiet scope, swallow the codes that are the normal
+               negative answer (tx not in mempool/chain; wallet path wrong
+               because tx not in this wallet). Real errors (-32700 parse,
+               -32601 method missing, etc.) still surface. See task #200. */
+            if (!(g_regtest_poll_quiet && regtest_err_is_expected_poll_miss(err.code)))
+                fprintf(stderr, "HTTP RPC %s error: {\"code\":%d,\"message\":\"%s\"}\n",
+                        method, err.code, err.message);
         }
-        cJSON_Delete(jresp);
         return NULL;
     }
 
-    cJSON *result = cJSON_GetObjectItem(jresp, "result");
-    if (!result) { cJSON_Delete(jresp); return NULL; }
-
-    /* Serialize result to match bitcoin-cli output format */
-    char *out = NULL;
-    if (cJSON_IsString(result)) {
-        /* Return with outer quotes: matches bitcoin-cli "value"\n format */
-        size_t vlen = strlen(result->valuestring);
-        out = malloc(vlen + 3);
-        if (out) {
-            out[0] = '"';
-            memcpy(out + 1, result->valuestring, vlen);
-            out[vlen + 1] = '"';
-            out[vlen + 2] = '\0';
-        }
-    } else if (cJSON_IsNumber(result)) {
-        out = malloc(64);
-        if (out) snprintf(out, 64, "%g", result->valuedouble);
-    } else {
-        /* Object, array, bool, null: compact JSON */
-        out = cJSON_PrintUnformatted(result);
-    }
-
-    cJSON_Delete(jresp);
+    char *out = regtest_format_result(result);
+    cJSON_Delete(result);
     return out;
 }
 
@@ -690,6 +587,56 @@ static int regtest_try_reload_wallet(const regtest_t *rt) {
     return 0;
 }
 
+/* Send items as one JSON-RPC batch on rt's endpoint (wallet path when
+   set).  Returns 1 if bitcoind answered; per-item errors are reported
+   like regtest_http_rpc (quiet-scope codes swallowed).  Returns 0 when
+   the HTTP path is unavailable or any item hit -18 "wallet not loaded"
+   — results are freed and callers fall back to per-call regtest_exec,
+   which owns the wallet reload + CLI fallback logic. */
+static int regtest_http_batch(const regtest_t *rt,
+                               rpc_batch_item_t *items, size_t n_items)
+{
+    rpc_client_t *client = (rt->rpcport > 0) ? regtest_rpc_client(rt) : NULL;
+    if (!client) {
+        for (size_t i = 0; i < n_items; i++) {
+            cJSON_Delete(items[i].params);
+            items[i].params = NULL;
+            items[i].result = NULL;
+        }
+        return 0;
+    }
+    if (!rpc_client_batch(client, rt->wallet, items, n_items))
+        return 0;
+
+    int need_fallback = 0;
+    for (size_t i = 0; i < n_items; i++) {
+        int code = items[i].err.code;
+        if (code == 0) continue;
+        if (code == -18) need_fallback = 1;
+        if (!(g_regtest_poll_quiet && regtest_err_is_expected_poll_miss(code)))
+            fprintf(stderr, "HTTP RPC %s error: {\"code\":%d,\"message\":\"%s\"}\n",
+                    items[i].method, code, items[i].err.message);
+    }
+    if (need_fallback) {
+        for (size_t i = 0; i < n_items; i++) {
+            cJSON_Delete(items[i].result);
+            items[i].result = NULL;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+static void regtest_batch_free(rpc_batch_item_t *items, size_t n_items)
+{
+    if (!items) return;
+    for (size_t i = 0; i < n_items; i++) {
+        cJSON_Delete(items[i].params);
+        cJSON_Delete(items[i].result);
+    }
+    free(items);
+}
+
 #endif /* _POSIX_VERSION (HTTP RPC) */
 
 char *regtest_exec(const regtest_t *rt, const char *method, const char *params) {
@@ -702,8 +649,16 @@ char *regtest_exec(const regtest_t *rt, const char *method, const char *params)
        Falls back to fork/execvp when rpcport == 0 or HTTP fails. */
     if (rt->rpcport > 0) {
         g_regtest_last_http_error = 0;
+        g_regtest_last_http_timeout = 0;
         char *result = regtest_http_rpc(rt, method, params);
         if (result) return result;
+        /* bitcoind took the call but did not answer in time: it may
+           still run it, so bitcoin-cli must not send it again */
+        if (g_regtest_last_http_timeout) {
+            fprintf(stderr, "regtest: %s timed out over HTTP, not retried\n",
+                    method);
+            return NULL;
+        }
         /* -18 "Requested wallet does not exist": bitcoind unloaded the wallet
            (manual unload, restart, etc.). Reload once and retry; on persistent
            failure we fall through to the fork+exec path which will surface
@@ -1010,6 +965,148 @@ int regtest_send_raw_tx(regtest_t *rt, const char *tx_hex, char *txid_out) {
     return 1;
 }
 
+/* Cache the tx array of a getblock verbosity-1 result as a txid-only
+   block_cache entry.  Returns the pinned entry, or NULL. */
+static block_cache_entry_t *regtest_cache_block_txids(const char *block_hash,
+                                                      int height,
+                                                      const cJSON *block)
+{
+    block_cache_t *bc = block_cache_shared();
+    const cJSON *txs = cJSON_GetObjectItem(block, "tx");
+    if (!bc || !txs || !cJSON_IsArray(txs)) return NULL;
+
+    size_t n = (size_t)cJSON_GetArraySize(txs);
+    const char **ids = calloc(n ? n : 1, sizeof(*ids));
+    if (!ids) return NULL;
+    size_t k = 0;
+    const cJSON *txid_j = NULL;
+    cJSON_ArrayForEach(txid_j, txs) {
+        if (cJSON_IsString(txid_j)) ids[k++] = txid_j->valuestring;
+    }
+    block_cache_entry_t *e = block_cache_put_txids(bc, block_hash, height, ids, k);
+    free(ids);
+    return e;
+}
+
+/* Mark every still-unplaced txid found in a cached block with blk_confs.
+   Returns the number placed. */
+static size_t regtest_match_cached_block(const block_cache_entry_t *e,
+                                         int blk_confs,
+                                         const char **txids_hex, size_t n_txids,
+                                         int *confs_out)
+{
+    size_t placed = 0;
+    for (size_t i = 0; i < n_txids; i++) {
+        if (confs_out[i] != -1) continue;
+        if (block_cache_find_tx(e, txids_hex[i]) >= 0) {
+            confs_out[i] = blk_confs;
+            placed++;
+        }
+    }
+    return placed;
+}
+
+/* Mark every still-unplaced txid in a getblock verbosity-1 result's tx
+   array with blk_confs, straight from the JSON: used when the block could
+   not be cached (no shared cache, malformed hash, out of memory).
+   Returns the number placed. */
+static size_t regtest_match_block_json(const cJSON *block, int blk_confs,
+                                       const char **txids_hex, size_t n_txids,
+                                       int *confs_out)
+{
+    size_t placed = 0;
+    const cJSON *txs = cJSON_GetObjectItem(block, "tx");
+    const cJSON *txid_j = NULL;
+    cJSON_ArrayForEach(txid_j, txs) {
+        if (!cJSON_IsString(txid_j)) continue;
+        for (size_t i = 0; i < n_txids; i++) {
+            if (confs_out[i] != -1) continue;
+            if (strcasecmp(txid_j->valuestring, txids_hex[i]) == 0) {
+                confs_out[i] = blk_confs;
+                placed++;
+            }
+        }
+    }
+    return placed;
+}
+
+/* Cache a verbosity-1 block and place the txids found in it. */
+static size_t regtest_match_new_block(const char *block_hash, int height,
+                                      const cJSON *block, int blk_confs,
+                                      const char **txids_hex, size_t n_txids,
+                                      int *confs_out)
+{
+    block_cache_entry_t *cached = regtest_cache_block_txids(block_hash, height,
+                                                            block);
+    if (!cached)
+        return regtest_match_block_json(block, blk_confs, txids_hex, n_txids,
+                                        confs_out);
+    size_t placed = regtest_match_cached_block(cached, blk_confs, txids_hex,
+                                               n_txids, confs_out);
+    block_cache_release(block_cache_shared(), cached);
+    return placed;
+}
+
+/* Scan the last scan_depth blocks below height for the txids whose
+   confs_out is still -1: one getblockhash + one getblock per block,
+   checking every txid against the block's tx array in memory.  Blocks
+   already in the shared block cache skip the getblock.  Returns the
+   number of txids placed. */
+static size_t regtest_scan_recent_blocks(regtest_t *rt, int height,
+                                         const char **txids_hex, size_t n_txids,
+                                         int *confs_out, size_t n_remaining)
+{
+    size_t placed = 0;
+    int depth = rt->scan_depth > 0 ? rt->scan_depth : 20;
+    for (int blk = 0; blk < depth && blk <= height && placed < n_remaining; blk++) {
+        char params[256];
+        snprintf(params, sizeof(params), "%d", height - blk);
+        char *hash_result = regtest_exec(rt, "getblockhash", params);
+        if (!hash_result) continue;
+
+        char blockhash[65];
+        char *s = hash_result;
+        while (*s == ' ' || *s == '\n' || *s == '"') s++;
+        char *e = s + strlen(s) - 1;
+        while (e > s && (*e == ' ' || *e == '\n' || *e == '"' || *e == '\r'))
+            *e-- = '\0';
+        strncpy(blockhash, s, 64);
+        blockhash[64] = '\0';
+        free(hash_result);
+
+        block_cache_entry_t *cached = block_cache_get(block_cache_shared(),
+                                                      blockhash);
+        if (cached) {
+            placed += regtest_match_cached_block(cached, blk + 1, txids_hex,
+                                                 n_txids, confs_out);
+            block_cache_release(block_cache_shared(), cached);
+            continue;
+        }
+
+        /* getblock hash 1 — returns tx as array of txid strings, much lighter
+           than verbosity 2 (no decoded script data needed here) */
+        snprintf(params, sizeof(params), "\"%s\" 1", blockhash);
+        char *blk_result = regtest_exec(rt, "getblock", params);
+        if (!blk_result) continue;
+
+        cJSON *block = cJSON_Parse(blk_result);
+        free(blk_result);
+        if (!block) continue;
+
+        /* Use the block's own confirmations field for accuracy */
+        int blk_confs = blk + 1;
+        cJSON *conf_j = cJSON_GetObjectItem(block, "confirmations");
+        if (conf_j && cJSON_IsNumber(conf_j))
+            blk_confs = conf_j->valueint;
+
+        placed += regtest_match_new_block(blockhash, height - blk, block,
+                                          blk_confs, txids_hex, n_txids,
+                                          confs_out);
+        cJSON_Delete(block);
+    }
+    return placed;
+}
+
 /* Inner worker — flag-clearing wrapper below ensures g_regtest_poll_quiet
    is reset on every return path (poll-loop quiet scope, task #200). */
 static int regtest_get_confirmations_inner(regtest_t *rt, const char *txid) {
@@ -1055,47 +1152,17 @@ static int regtest_get_confirmations_inner(regtest_t *rt, const char *txid) {
         }
     }
 
-    /* Fallback: scan recent blocks with getrawtransaction + blockhash */
+    /* Fallback: scan recent blocks through the shared block cache, so a
+       sweeper or recovery poll of an unindexed tx costs one getblockhash
+       per block once the window has been fetched */
     result = regtest_exec(rt, "getblockcount", "");
     if (!result) return -1;
     int height = atoi(result);
     free(result);
 
-    int depth = rt->scan_depth > 0 ? rt->scan_depth : 20;
-    for (int i = 0; i < depth && i <= height; i++) {
-        snprintf(params, sizeof(params), "%d", height - i);
-        char *hash_result = regtest_exec(rt, "getblockhash", params);
-        if (!hash_result) continue;
-
-        /* Trim whitespace */
-        char blockhash[65];
-        char *s = hash_result;
-        while (*s == ' ' || *s == '\n' || *s == '"') s++;
-        char *e = s + strlen(s) - 1;
-        while (e > s && (*e == ' ' || *e == '\n' || *e == '"' || *e == '\r'))
-            *e-- = '\0';
-        strncpy(blockhash, s, 64);
-        blockhash[64] = '\0';
-        free(hash_result);
-
-        snprintf(params, sizeof(params), "\"%s\" true \"%s\"", txid, blockhash);
-        char *tx_result = regtest_exec(rt, "getrawtransaction", params);
-        if (!tx_result) continue;
-
-        cJSON *json = cJSON_Parse(tx_result);
-        free(tx_result);
-        if (!json) continue;
-
-        cJSON *conf = cJSON_GetObjectItem(json, "confirmations");
-        if (conf && cJSON_IsNumber(conf)) {
-            int val = conf->valueint;
-            cJSON_Delete(json);
-            return val;
-        }
-        cJSON_Delete(json);
-    }
-
-    return -1;
+    int conf_out = -1;
+    regtest_scan_recent_blocks(rt, height, &txid, 1, &conf_out, 1);
+    return conf_out;
 }
 
 int regtest_get_confirmations(regtest_t *rt, const char *txid) {
@@ -1107,23 +1174,15 @@ int regtest_get_confirmations(regtest_t *rt, const char *txid) {
     return r;
 }
 
-int regtest_get_confirmations_batch(regtest_t *rt,
-                                    const char **txids_hex, size_t n_txids,
-                                    int *confs_out)
+/* Per-call fallback for regtest_get_confirmations_batch (CLI path or
+   HTTP unavailable).  confs_out must be pre-filled with -1. */
+static int regtest_confirmations_batch_serial(regtest_t *rt,
+                                              const char **txids_hex,
+                                              size_t n_txids,
+                                              int *confs_out)
 {
-    if (!rt || !txids_hex || !confs_out || n_txids == 0) return 0;
-
-    for (size_t i = 0; i < n_txids; i++)
-        confs_out[i] = -1;
-
     size_t n_remaining = n_txids;
 
-    /* Poll-loop quiet scope: suppress -5/-19 noise. Task #200.
-       Restored at every return point below. */
-    int _ss_prev_quiet = g_regtest_poll_quiet;
-    g_regtest_poll_quiet = 1;
-    #define SS_RET_BATCH(v) do { g_regtest_poll_quiet = _ss_prev_quiet; return (v); } while (0)
-
     /* Step 1: gettransaction for each txid (cheap for wallet txs) */
     for (size_t i = 0; i < n_txids; i++) {
         char params[256];
@@ -1141,7 +1200,7 @@ int regtest_get_confirmations_batch(regtest_t *rt,
         cJSON_Delete(json);
     }
 
-    if (n_remaining == 0) SS_RET_BATCH(1);
+    if (n_remaining == 0) return 1;
 
     /* Step 1b: getrawtransaction for remaining txids (works with -txindex=1
        or for mempool TXs).  Same approach as CLN/LND/LDK. */
@@ -1164,69 +1223,180 @@ int regtest_get_confirmations_batch(regtest_t *rt,
         n_remaining--;
     }
 
-    if (n_remaining == 0) SS_RET_BATCH(1);
+    if (n_remaining == 0) return 1;
 
-    /* Step 2: scan recent blocks — one getblockhash + one getblock per block,
-       then check all remaining txids against the block's tx array in memory.
-       O(scan_depth) RPCs regardless of n_txids. */
+    /* Step 2: scan recent blocks — O(scan_depth) RPCs regardless of n_txids */
     char *hcnt = regtest_exec(rt, "getblockcount", "");
-    if (!hcnt) SS_RET_BATCH(1);
+    if (!hcnt) return 1;
     int height = atoi(hcnt);
     free(hcnt);
 
+    regtest_scan_recent_blocks(rt, height, txids_hex, n_txids, confs_out,
+                               n_remaining);
+    return 1;
+}
+
+#ifdef _POSIX_VERSION
+/* Match the remaining txids against the tx arrays of recent blocks.
+   getblockhash for the whole scan window goes out as one batch; the
+   verbosity-1 getblock calls follow in REGTEST_BLOCK_BATCH chunks so a
+   1000-block mainnet window never lands in a single response, and the
+   scan stops as soon as every txid is placed. */
+#define REGTEST_BLOCK_BATCH 16
+
+static int regtest_confirmations_scan_blocks_batched(regtest_t *rt,
+                                                     const char **txids_hex,
+                                                     size_t n_txids,
+                                                     int *confs_out,
+                                                     size_t n_remaining,
+                                                     int height)
+{
     int depth = rt->scan_depth > 0 ? rt->scan_depth : 20;
-    for (int blk = 0; blk < depth && blk <= height && n_remaining > 0; blk++) {
-        char params[256];
-        snprintf(params, sizeof(params), "%d", height - blk);
-        char *hash_result = regtest_exec(rt, "getblockhash", params);
-        if (!hash_result) continue;
+    if (depth > height + 1) depth = height + 1;
+    if (depth <= 0) return 1;
+
+    rpc_batch_item_t *hashes = calloc((size_t)depth, sizeof(*hashes));
+    if (!hashes) return 0;
+    for (int blk = 0; blk < depth; blk++) {
+        hashes[blk].method = "getblockhash";
+        hashes[blk].params = cJSON_CreateArray();
+        cJSON_AddItemToArray(hashes[blk].params,
+                             cJSON_CreateNumber(height - blk));
+    }
+    if (!regtest_http_batch(rt, hashes, (size_t)depth)) {
+        regtest_batch_free(hashes, (size_t)depth);
+        return 0;
+    }
 
-        char blockhash[65];
-        char *s = hash_result;
-        while (*s == ' ' || *s == '\n' || *s == '"') s++;
-        char *e = s + strlen(s) - 1;
-        while (e > s && (*e == ' ' || *e == '\n' || *e == '"' || *e == '\r'))
-            *e-- = '\0';
-        strncpy(blockhash, s, 64);
-        blockhash[64] = '\0';
-        free(hash_result);
+    for (int base = 0; base < depth && n_remaining > 0;
+         base += REGTEST_BLOCK_BATCH) {
+        size_t n_chunk = 0;
+        rpc_batch_item_t chunk[REGTEST_BLOCK_BATCH];
+        int chunk_blk[REGTEST_BLOCK_BATCH];
+        for (int blk = base; blk < depth && blk < base + REGTEST_BLOCK_BATCH &&
+                             n_remaining > 0; blk++) {
+            if (!cJSON_IsString(hashes[blk].result)) continue;
+            block_cache_entry_t *cached = block_cache_get(block_cache_shared(),
+                                             hashes[blk].result->valuestring);
+            if (cached) {
+                n_remaining -= regtest_match_cached_block(cached, blk + 1,
+                                                          txids_hex, n_txids,
+                                                          confs_out);
+                block_cache_release(block_cache_shared(), cached);
+                continue;
+            }
+            chunk[n_chunk].method = "getblock";
+            chunk[n_chunk].params = cJSON_CreateArray();
+            cJSON_AddItemToArray(chunk[n_chunk].params,
+                cJSON_CreateString(hashes[blk].result->valuestring));
+            cJSON_AddItemToArray(chunk[n_chunk].params, cJSON_CreateNumber(1));
+            chunk_blk[n_chunk] = blk;
+            n_chunk++;
+        }
+        if (n_chunk == 0) continue;
+        if (!regtest_http_batch(rt, chunk, n_chunk)) {
+            regtest_batch_free(hashes, (size_t)depth);
+            return 0;
+        }
 
-        /* getblock hash 1 — returns tx as array of txid strings, much lighter
-           than verbosity 2 (no decoded script data needed here) */
-        snprintf(params, sizeof(params), "\"%s\" 1", blockhash);
-        char *blk_result = regtest_exec(rt, "getblock", params);
-        if (!blk_result) continue;
+        for (size_t k = 0; k < n_chunk; k++) {
+            cJSON *block = chunk[k].result;
+            if (!block) continue;
+            /* Use the block's own confirmations field for accuracy */
+            int blk_confs = chunk_blk[k] + 1;
+            cJSON *conf_j = cJSON_GetObjectItem(block, "confirmations");
+            if (conf_j && cJSON_IsNumber(conf_j))
+                blk_confs = conf_j->valueint;
+
+            int blk = chunk_blk[k];
+            n_remaining -= regtest_match_new_block(
+                hashes[blk].result->valuestring, height - blk, block,
+                blk_confs, txids_hex, n_txids, confs_out);
+        }
+        for (size_t k = 0; k < n_chunk; k++)
+            cJSON_Delete(chunk[k].result);
+    }
 
-        cJSON *block = cJSON_Parse(blk_result);
-        free(blk_result);
-        if (!block) continue;
+    regtest_batch_free(hashes, (size_t)depth);
+    return 1;
+}
 
-        /* Use the block's own confirmations field for accuracy */
-        int blk_confs = blk + 1;
-        cJSON *conf_j = cJSON_GetObjectItem(block, "confirmations");
-        if (conf_j && cJSON_IsNumber(conf_j))
-            blk_confs = conf_j->valueint;
+/* Batched path: one round-trip carries gettransaction + getrawtransaction
+   for every txid plus getblockcount, which settles wallet, -txindex and
+   mempool txs.  Only txids still unplaced pay for the block scan.
+   Returns 0 if the HTTP path is unavailable (caller falls back). */
+static int regtest_confirmations_batch_rpc(regtest_t *rt,
+                                           const char **txids_hex,
+                                           size_t n_txids,
+                                           int *confs_out)
+{
+    size_t n_items = n_txids * 2 + 1;
+    rpc_batch_item_t *items = calloc(n_items, sizeof(*items));
+    if (!items) return 0;
+    for (size_t i = 0; i < n_txids; i++) {
+        items[2*i].method = "gettransaction";
+        items[2*i].params = cJSON_CreateArray();
+        cJSON_AddItemToArray(items[2*i].params, cJSON_CreateString(txids_hex[i]));
+        cJSON_AddItemToArray(items[2*i].params, cJSON_CreateBool(1));
+        items[2*i+1].method = "getrawtransaction";
+        items[2*i+1].params = cJSON_CreateArray();
+        cJSON_AddItemToArray(items[2*i+1].params, cJSON_CreateString(txids_hex[i]));
+        cJSON_AddItemToArray(items[2*i+1].params, cJSON_CreateBool(1));
+    }
+    items[n_items - 1].method = "getblockcount";
+    if (!regtest_http_batch(rt, items, n_items)) {
+        regtest_batch_free(items, n_items);
+        return 0;
+    }
 
-        cJSON *txs = cJSON_GetObjectItem(block, "tx");
-        if (txs && cJSON_IsArray(txs)) {
-            cJSON *txid_j = NULL;
-            cJSON_ArrayForEach(txid_j, txs) {
-                if (!cJSON_IsString(txid_j)) continue;
-                const char *block_txid = txid_j->valuestring;
-                for (size_t i = 0; i < n_txids; i++) {
-                    if (confs_out[i] != -1) continue;
-                    if (strcasecmp(block_txid, txids_hex[i]) == 0) {
-                        confs_out[i] = blk_confs;
-                        n_remaining--;
-                    }
-                }
-            }
+    size_t n_remaining = n_txids;
+    for (size_t i = 0; i < n_txids; i++) {
+        cJSON *conf = cJSON_GetObjectItem(items[2*i].result, "confirmations");
+        if (conf && cJSON_IsNumber(conf)) {
+            confs_out[i] = conf->valueint;
+            n_remaining--;
+            continue;
+        }
+        if (cJSON_IsObject(items[2*i+1].result)) {
+            conf = cJSON_GetObjectItem(items[2*i+1].result, "confirmations");
+            /* No confirmations field = in mempool, not yet confirmed */
+            confs_out[i] = (conf && cJSON_IsNumber(conf)) ? conf->valueint : 0;
+            n_remaining--;
         }
-        cJSON_Delete(block);
     }
+    cJSON *hcnt = items[n_items - 1].result;
+    int height = cJSON_IsNumber(hcnt) ? (int)hcnt->valuedouble : -1;
+    regtest_batch_free(items, n_items);
 
-    SS_RET_BATCH(1);
-    #undef SS_RET_BATCH
+    if (n_remaining == 0 || height < 0) return 1;
+    /* A transport failure mid-scan leaves confs_out as far as it got;
+       the answers already collected are still correct. */
+    regtest_confirmations_scan_blocks_batched(rt, txids_hex, n_txids,
+                                              confs_out, n_remaining, height);
+    return 1;
+}
+#endif /* _POSIX_VERSION */
+
+int regtest_get_confirmations_batch(regtest_t *rt,
+                                    const char **txids_hex, size_t n_txids,
+                                    int *confs_out)
+{
+    if (!rt || !txids_hex || !confs_out || n_txids == 0) return 0;
+
+    for (size_t i = 0; i < n_txids; i++)
+        confs_out[i] = -1;
+
+    /* Poll-loop quiet scope: suppress -5/-19 noise. Task #200. */
+    int prev_quiet = g_regtest_poll_quiet;
+    g_regtest_poll_quiet = 1;
+    int ok = 0;
+#ifdef _POSIX_VERSION
+    ok = regtest_confirmations_batch_rpc(rt, txids_hex, n_txids, confs_out);
+#endif
+    if (!ok)
+        ok = regtest_confirmations_batch_serial(rt, txids_hex, n_txids, confs_out);
+    g_regtest_poll_quiet = prev_quiet;
+    return ok;
 }
 
 bool regtest_is_in_mempool(regtest_t *rt, const char *txid) {
@@ -1386,6 +1556,46 @@ int regtest_outpoint_unspent(regtest_t *rt, const char *txid_hex_display,
     return spent ? 0 : 1;
 }
 
+int regtest_outpoints_unspent_batch(regtest_t *rt,
+                                    const char **txids_hex_display,
+                                    const uint32_t *vouts, size_t n,
+                                    int *unspent_out)
+{
+    if (!rt || !txids_hex_display || !vouts || !unspent_out || n == 0)
+        return 0;
+
+#ifdef _POSIX_VERSION
+    rpc_batch_item_t *items = calloc(n, sizeof(*items));
+    if (items) {
+        for (size_t i = 0; i < n; i++) {
+            items[i].method = "gettxout";
+            items[i].params = cJSON_CreateArray();
+            cJSON_AddItemToArray(items[i].params,
+                                 cJSON_CreateString(txids_hex_display[i]));
+            cJSON_AddItemToArray(items[i].params, cJSON_CreateNumber(vouts[i]));
+            cJSON_AddItemToArray(items[i].params, cJSON_CreateBool(1));
+        }
+        if (regtest_http_batch(rt, items, n)) {
+            /* gettxout answers JSON null for spent / unknown outpoints. */
+            for (size_t i = 0; i < n; i++) {
+                if (items[i].err.code != 0 || !items[i].result)
+                    unspent_out[i] = -1;
+                else
+                    unspent_out[i] = cJSON_IsNull(items[i].result) ? 0 : 1;
+            }
+            regtest_batch_free(items, n);
+            return 1;
+        }
+        regtest_batch_free(items, n);
+    }
+#endif
+
+    for (size_t i = 0; i < n; i++)
+        unspent_out[i] = regtest_outpoint_unspent(rt, txids_hex_display[i],
+                                                  vouts[i]);
+    return 1;
+}
+
 int regtest_get_raw_tx(regtest_t *rt, const char *txid,
                          char *tx_hex_out, size_t max_len) {
     if (!rt || !txid || !tx_hex_out || max_len == 0) return 0;
@@ -2222,6 +2432,34 @@ int regtest_get_block_hash(regtest_t *rt, int height,
     return 1;
 }
 
+int regtest_get_raw_block(regtest_t *rt, const char *block_hash,
+                           unsigned char **block_out, size_t *block_len_out)
+{
+    if (!block_hash || !block_out || !block_len_out) return 0;
+    /* getblock <hash> 0 returns the serialized block as one hex string */
+    char params[200];
+    snprintf(params, sizeof(params), "\"%s\" 0", block_hash);
+    char *result = regtest_exec(rt, "getblock", params);
+    if (!result) return 0;
+
+    char *start = result;
+    while (*start == '"' || *start == ' ' || *start == '\n') start++;
+    size_t hlen = 0;
+    while (start[hlen] && start[hlen] != '"' && start[hlen] != '\n') hlen++;
+    start[hlen] = '\0';
+
+    unsigned char *blk = (hlen && hlen % 2 == 0) ? malloc(hlen / 2) : NULL;
+    if (!blk || hex_decode(start, blk, hlen / 2) != (int)(hlen / 2)) {
+        free(blk);
+        free(result);
+        return 0;
+    }
+    free(result);
+    *block_out = blk;
+    *block_len_out = hlen / 2;
+    return 1;
+}
+
 int regtest_get_block_filter(regtest_t *rt, const char *block_hash,
                               unsigned char *filter_bytes_out,
                               size_t        *filter_len_out,
@@ -0,0 +1,397 @@
+/*
+ * rgs_server.c — Precomputed Rapid Gossip Sync snapshots and deltas.
+ *
+ * Reference: LDK rapid-gossip-sync-server
+ */
+
+#include "superscalar/rgs_server.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INIT_SLOTS  256u
+
+/* ---- Channel table (linear probing, backward-shift delete) ---- */
+
+static size_t mix(uint64_t k, size_t mask)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k & mask;
+}
+
+static rgs_server_chan_t *chan_find(const rgs_server_t *srv, uint64_t scid)
+{
+    if (!srv->n_slots || !scid) return NULL;
+    size_t mask = srv->n_slots - 1;
+    for (size_t i = mix(scid, mask); srv->chans[i].scid; i = (i + 1) & mask)
+        if (srv->chans[i].scid == scid) return &srv->chans[i];
+    return NULL;
+}
+
+static int chan_grow(rgs_server_t *srv)
+{
+    size_t n = srv->n_slots ? srv->n_slots * 2 : INIT_SLOTS;
+    rgs_server_chan_t *t = (rgs_server_chan_t *)calloc(n, sizeof(*t));
+    if (!t) return 0;
+    for (size_t i = 0; i < srv->n_slots; i++) {
+        if (!srv->chans[i].scid) continue;
+        size_t j = mix(srv->chans[i].scid, n - 1);
+        while (t[j].scid) j = (j + 1) & (n - 1);
+        t[j] = srv->chans[i];
+    }
+    free(srv->chans);
+    srv->chans = t;
+    srv->n_slots = n;
+    return 1;
+}
+
+/* Slot for scid, inserting a zeroed entry if new.  NULL on OOM. */
+static rgs_server_chan_t *chan_add(rgs_server_t *srv, uint64_t scid, int *added)
+{
+    *added = 0;
+    rgs_server_chan_t *c = chan_find(srv, scid);
+    if (c) return c;
+    if ((srv->n_chans + 1) * 2 > srv->n_slots && !chan_grow(srv)) return NULL;
+    size_t mask = srv->n_slots - 1;
+    size_t i = mix(scid, mask);
+    while (srv->chans[i].scid) i = (i + 1) & mask;
+    memset(&srv->chans[i], 0, sizeof(srv->chans[i]));
+    srv->chans[i].scid = scid;
+    srv->n_chans++;
+    *added = 1;
+    return &srv->chans[i];
+}
+
+static void chan_del(rgs_server_t *srv, rgs_server_chan_t *c)
+{
+    size_t mask = srv->n_slots - 1;
+    size_t i = (size_t)(c - srv->chans);
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!srv->chans[j].scid) break;
+        size_t home = mix(srv->chans[j].scid, mask);
+        /* Move j back into the hole at i unless its home lies in (i, j]. */
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+            srv->chans[i] = srv->chans[j];
+            i = j;
+        }
+    }
+    memset(&srv->chans[i], 0, sizeof(srv->chans[i]));
+    srv->n_chans--;
+}
+
+/* ---- Encoding ---- */
+
+static int scid_cmp(const void *a, const void *b)
+{
+    uint64_t x = (*(const rgs_server_chan_t *const *)a)->scid;
+    uint64_t y = (*(const rgs_server_chan_t *const *)b)->scid;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t node_key(const unsigned char id[33])
+{
+    uint64_t k = 0;
+    for (int i = 1; i < 9; i++) k = (k << 8) | id[i];
+    return k;
+}
+
+/* Index of id in nodes[], appending it if there is room; -1 if full. */
+static int node_idx(rgs_node_id_t *nodes, uint32_t *n_nodes,
+                    int32_t *slots, size_t mask, const unsigned char id[33])
+{
+    size_t i = mix(node_key(id), mask);
+    for (; slots[i] >= 0; i = (i + 1) & mask)
+        if (memcmp(nodes[slots[i]].pubkey, id, 33) == 0) return slots[i];
+    if (*n_nodes >= RGS_MAX_NODE_IDS) return -1;
+    memcpy(nodes[*n_nodes].pubkey, id, 33);
+    slots[i] = (int32_t)*n_nodes;
+    return (int)(*n_nodes)++;
+}
+
+/*
+ * Encode the channels (sorted by scid) changed after since -- all of them
+ * if full -- stamped with boundary.  Returns 1 with out filled, 0 on OOM.
+ */
+static int encode(rgs_server_chan_t *const *sorted, size_t n_sorted,
+                  uint32_t since, int full, uint32_t boundary,
+                  rgs_server_blob_t *out)
+{
+    size_t cap_chans = n_sorted < RGS_MAX_CHANNELS ? n_sorted : RGS_MAX_CHANNELS;
+    size_t n_slots = 2 * RGS_MAX_NODE_IDS;
+    rgs_node_id_t *nodes = (rgs_node_id_t *)malloc(RGS_MAX_NODE_IDS * sizeof(rgs_node_id_t));
+    rgs_channel_t *chans = (rgs_channel_t *)malloc((cap_chans ? cap_chans : 1) *
+                                                   sizeof(rgs_channel_t));
+    int32_t *slots = (int32_t *)malloc(n_slots * sizeof(int32_t));
+    unsigned char *blob = NULL;
+    int ok = 0;
+    if (!nodes || !chans || !slots) goto out;
+    memset(slots, 0xff, n_slots * sizeof(int32_t));
+
+    uint32_t n_nodes = 0, n_chans = 0;
+    size_t len = RGS_MAGIC_LEN + 4 + 3 + 4;
+    for (size_t i = 0; i < n_sorted && n_chans < cap_chans; i++) {
+        const rgs_server_chan_t *c = sorted[i];
+        rgs_channel_t *ch = &chans[n_chans];
+        memset(ch, 0, sizeof(*ch));
+        for (int d = 0; d < 2; d++)
+            if (c->upd_seen[d] && (full || c->upd_seen[d] > since))
+                ch->updates[ch->update_count++] = c->upd[d];
+        if (!full && ch->update_count == 0 && c->ann_seen <= since)
+            continue;
+
+        uint32_t saved = n_nodes;
+        int i1 = node_idx(nodes, &n_nodes, slots, n_slots - 1, c->node1);
+        int i2 = node_idx(nodes, &n_nodes, slots, n_slots - 1, c->node2);
+        if (i1 < 0 || i2 < 0) {
+            n_nodes = saved;    /* out of node ids: stop here */
+            break;
+        }
+        ch->short_channel_id = c->scid;
+        ch->node_id_1_idx = (uint32_t)i1;
+        ch->node_id_2_idx = (uint32_t)i2;
+        ch->funding_satoshis = c->funding_sat;
+        len += 25 + 33 * (size_t)ch->update_count;
+        n_chans++;
+    }
+    len += 33 * (size_t)n_nodes;
+
+    blob = (unsigned char *)malloc(len);
+    if (!blob) goto out;
+    rgs_snapshot_t snap;
+    snap.last_sync_timestamp = boundary;
+    snap.node_id_count = n_nodes;
+    snap.node_ids = nodes;
+    snap.channel_count = n_chans;
+    snap.channels = chans;
+    if (rgs_build(&snap, nodes, chans, blob, len) != len) goto out;
+
+    free(out->blob);
+    out->blob = blob;
+    out->len = len;
+    out->since = since;
+    blob = NULL;
+    ok = 1;
+out:
+    free(blob);
+    free(nodes);
+    free(chans);
+    free(slots);
+    return ok;
+}
+
+/* Blob to serve for since.  Lock held. */
+static const rgs_server_blob_t *pick(const rgs_server_t *srv, uint32_t since)
+{
+    if (!srv->full.blob) return NULL;
+    for (int i = 0; i < srv->n_deltas; i++)
+        if (srv->deltas[i].since <= since)
+            return &srv->deltas[i];
+    return &srv->full;
+}
+
+/* ---- Public API ---- */
+
+int rgs_server_init(rgs_server_t *srv, uint32_t interval_secs)
+{
+    if (!srv) return 0;
+    memset(srv, 0, sizeof(*srv));
+    srv->interval = interval_secs ? interval_secs : RGS_SERVER_DEFAULT_INTERVAL;
+    pthread_mutex_init(&srv->lock, NULL);
+    return 1;
+}
+
+void rgs_server_free(rgs_server_t *srv)
+{
+    if (!srv) return;
+    free(srv->chans);
+    free(srv->full.blob);
+    for (int i = 0; i < srv->n_deltas; i++)
+        free(srv->deltas[i].blob);
+    pthread_mutex_destroy(&srv->lock);
+    memset(srv, 0, sizeof(*srv));
+}
+
+int rgs_server_seed(rgs_server_t *srv, const unsigned char *blob, size_t len)
+{
+    if (!srv || !blob) return -1;
+    rgs_node_id_t *nodes = (rgs_node_id_t *)calloc(RGS_MAX_NODE_IDS, sizeof(rgs_node_id_t));
+    rgs_channel_t *chans = (rgs_channel_t *)calloc(RGS_MAX_CHANNELS, sizeof(rgs_channel_t));
+    int loaded = -1;
+    rgs_snapshot_t snap;
+    if (nodes && chans &&
+        rgs_parse(blob, len, &snap, nodes, RGS_MAX_NODE_IDS, chans, RGS_MAX_CHANNELS)) {
+        loaded = 0;
+        pthread_mutex_lock(&srv->lock);
+        for (uint32_t i = 0; i < snap.channel_count; i++) {
+            const rgs_channel_t *ch = &chans[i];
+            if (ch->node_id_1_idx >= snap.node_id_count ||
+                ch->node_id_2_idx >= snap.node_id_count)
+                continue;
+            int added;
+            rgs_server_chan_t *c = chan_add(srv, ch->short_channel_id, &added);
+            if (!c) break;
+            memcpy(c->node1, nodes[ch->node_id_1_idx].pubkey, 33);
+            memcpy(c->node2, nodes[ch->node_id_2_idx].pubkey, 33);
+            c->funding_sat = ch->funding_satoshis;
+            for (int u = 0; u < ch->update_count; u++) {
+                int d = ch->updates[u].direction & 1;
+                c->upd[d] = ch->updates[u];
+                c->upd_seen[d] = 1;     /* present, older than any boundary */
+            }
+            loaded++;
+        }
+        pthread_mutex_unlock(&srv->lock);
+    }
+    free(nodes);
+    free(chans);
+    return loaded;
+}
+
+int rgs_server_add_channel(rgs_server_t *srv, uint64_t scid,
+                           const unsigned char node1[33],
+                           const unsigned char node2[33],
+                           uint64_t funding_sat, uint32_t now_unix)
+{
+    if (!srv || !scid || !node1 || !node2) return 0;
+    pthread_mutex_lock(&srv->lock);
+    int added;
+    rgs_server_chan_t *c = chan_add(srv, scid, &added);
+    if (c && added) {
+        memcpy(c->node1, node1, 33);
+        memcpy(c->node2, node2, 33);
+        c->funding_sat = funding_sat;
+        c->ann_seen = now_unix;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return c != NULL;
+}
+
+int rgs_server_apply_update(rgs_server_t *srv, uint64_t scid,
+                            const rgs_channel_update_t *upd, uint32_t now_unix)
+{
+    if (!srv || !upd) return 0;
+    pthread_mutex_lock(&srv->lock);
+    rgs_server_chan_t *c = chan_find(srv, scid);
+    int d = upd->direction & 1;
+    int applied = c && (!c->upd_seen[d] || upd->timestamp > c->upd[d].timestamp);
+    if (applied) {
+        c->upd[d] = *upd;
+        c->upd[d].direction = d;
+        c->upd_seen[d] = now_unix ? now_unix : 1;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return applied;
+}
+
+int rgs_server_remove_channel(rgs_server_t *srv, uint64_t scid)
+{
+    if (!srv) return 0;
+    pthread_mutex_lock(&srv->lock);
+    rgs_server_chan_t *c = chan_find(srv, scid);
+    if (c) chan_del(srv, c);
+    pthread_mutex_unlock(&srv->lock);
+    return c != NULL;
+}
+
+int rgs_server_tick(rgs_server_t *srv, uint32_t now_unix)
+{
+    if (!srv) return 0;
+    uint32_t boundary = now_unix - now_unix % srv->interval;
+    pthread_mutex_lock(&srv->lock);
+    if (boundary <= srv->last_boundary) {
+        pthread_mutex_unlock(&srv->lock);
+        return 0;
+    }
+
+    int ret = -1;
+    rgs_server_chan_t **sorted = (rgs_server_chan_t **)malloc(
+        (srv->n_chans ? srv->n_chans : 1) * sizeof(*sorted));
+    if (!sorted) goto out;
+    size_t n = 0;
+    for (size_t i = 0; i < srv->n_slots; i++)
+        if (srv->chans[i].scid) sorted[n++] = &srv->chans[i];
+    qsort(sorted, n, sizeof(*sorted), scid_cmp);
+
+    /* Boundaries to keep deltas for: this one, then the retained ones. */
+    uint32_t hist[RGS_SERVER_HISTORY];
+    int n_hist = 0;
+    hist[n_hist++] = boundary;
+    for (int i = 0; i < srv->n_history && n_hist < RGS_SERVER_HISTORY; i++)
+        hist[n_hist++] = srv->history[i];
+
+    rgs_server_blob_t full = { 0, NULL, 0 };
+    rgs_server_blob_t deltas[RGS_SERVER_HISTORY];
+    memset(deltas, 0, sizeof(deltas));
+    int built = encode(sorted, n, 0, 1, boundary, &full);
+    for (int i = 0; built && i < n_hist; i++)
+        built = encode(sorted, n, hist[i], 0, boundary, &deltas[i]);
+    free(sorted);
+    if (!built) {
+        free(full.blob);
+        for (int i = 0; i < n_hist; i++) free(deltas[i].blob);
+        goto out;
+    }
+
+    free(srv->full.blob);
+    for (int i = 0; i < srv->n_deltas; i++) free(srv->deltas[i].blob);
+    srv->full = full;
+    memcpy(srv->deltas, deltas, sizeof(deltas));
+    srv->n_deltas = n_hist;
+    memcpy(srv->history, hist, sizeof(hist));
+    srv->n_history = n_hist;
+    srv->last_boundary = boundary;
+    srv->n_seals++;
+    ret = 1;
+out:
+    pthread_mutex_unlock(&srv->lock);
+    return ret;
+}
+
+size_t rgs_server_get(rgs_server_t *srv, uint32_t since,
+                      unsigned char *out, size_t out_cap)
+{
+    if (!srv || !out) return 0;
+    pthread_mutex_lock(&srv->lock);
+    const rgs_server_blob_t *b = pick(srv, since);
+    size_t len = 0;
+    if (b && b->len <= out_cap) {
+        memcpy(out, b->blob, b->len);
+        len = b->len;
+        if (b == &srv->full) srv->n_served_full++;
+        else                 srv->n_served_delta++;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return len;
+}
+
+size_t rgs_server_blob_len(rgs_server_t *srv, uint32_t since)
+{
+    if (!srv) return 0;
+    pthread_mutex_lock(&srv->lock);
+    const rgs_server_blob_t *b = pick(srv, since);
+    size_t len = b ? b->len : 0;
+    pthread_mutex_unlock(&srv->lock);
+    return len;
+}
+
+unsigned char *rgs_server_get_copy(rgs_server_t *srv, uint32_t since,
+                                   size_t *len_out)
+{
+    if (len_out) *len_out = 0;
+    if (!srv || !len_out) return NULL;
+    pthread_mutex_lock(&srv->lock);
+    const rgs_server_blob_t *b = pick(srv, since);
+    unsigned char *out = (b && b->len) ? (unsigned char *)malloc(b->len) : NULL;
+    if (out) {
+        memcpy(out, b->blob, b->len);
+        *len_out = b->len;
+        if (b == &srv->full) srv->n_served_full++;
+        else                 srv->n_served_delta++;
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return out;
+}
@@ -0,0 +1,610 @@
+/*
+ * rpc_client.c — shared keep-alive JSON-RPC client for Bitcoin Core.
+ *
+ * A small per-endpoint pool of persistent HTTP/1.1 connections with a
+ * cached Basic-auth header, plus JSON-RPC array batching.  Replaces the
+ * two hand-rolled "connect, POST, read to EOF, close" clients that
+ * regtest.c and chain_backend_rpc.c used to carry.
+ *
+ * Connection handling:
+ *   - conn_acquire() hands out an idle pooled socket, lazily connects an
+ *     empty slot, or (pool exhausted) opens a transient socket that is
+ *     closed after the call.
+ *   - bitcoind closes idle keep-alive sockets after -rpcservertimeout
+ *     (default 30 s).  A reused socket that fails before any response
+ *     byte arrives is treated as stale and the request is retried on a
+ *     fresh connection.
+ *   - Responses are framed by Content-Length or chunked encoding; a
+ *     response with neither (or "Connection: close") is read to EOF and
+ *     the socket is not returned to the pool.
+ */
+
+#include "superscalar/rpc_client.h"
+#include "cJSON.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/* ------------------------------------------------------------------ */
+/* Base64 encoder (for HTTP Basic Auth)                                 */
+/* ------------------------------------------------------------------ */
+
+static int rpc_base64(const char *in, size_t in_len, char *out, size_t out_cap)
+{
+    static const char b64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t olen = ((in_len + 2) / 3) * 4;
+    if (olen + 1 > out_cap) return -1;
+    size_t i, j;
+    for (i = 0, j = 0; i + 2 < in_len; i += 3) {
+        unsigned c0 = (unsigned char)in[i];
+        unsigned c1 = (unsigned char)in[i+1];
+        unsigned c2 = (unsigned char)in[i+2];
+        out[j++] = b64[(c0 >> 2) & 0x3f];
+        out[j++] = b64[((c0 << 4) | (c1 >> 4)) & 0x3f];
+        out[j++] = b64[((c1 << 2) | (c2 >> 6)) & 0x3f];
+        out[j++] = b64[c2 & 0x3f];
+    }
+    if (i < in_len) {
+        unsigned c0 = (unsigned char)in[i];
+        unsigned c1 = (i + 1 < in_len) ? (unsigned char)in[i+1] : 0;
+        out[j++] = b64[(c0 >> 2) & 0x3f];
+        out[j++] = b64[((c0 << 4) | (c1 >> 4)) & 0x3f];
+        out[j++] = (i + 1 < in_len) ? b64[(c1 << 2) & 0x3f] : '=';
+        out[j++] = '=';
+    }
+    out[j] = '\0';
+    return (int)j;
+}
+
+static void rpc_set_error(rpc_error_t *err, int code, const char *msg)
+{
+    if (!err) return;
+    err->code = code;
+    err->timed_out = 0;
+    snprintf(err->message, sizeof(err->message), "%s", msg ? msg : "");
+}
+
+/* ------------------------------------------------------------------ */
+/* Lifecycle                                                            */
+/* ------------------------------------------------------------------ */
+
+int rpc_client_init(rpc_client_t *c, const char *host, int port,
+                     const char *rpcuser, const char *rpcpassword)
+{
+    if (!c || !host || !rpcuser || !rpcpassword || port <= 0) return 0;
+
+    memset(c, 0, sizeof(*c));
+    strncpy(c->host, host, sizeof(c->host) - 1);
+    c->port = port;
+    strncpy(c->rpcuser, rpcuser, sizeof(c->rpcuser) - 1);
+    strncpy(c->rpcpassword, rpcpassword, sizeof(c->rpcpassword) - 1);
+
+    char credentials[260];
+    snprintf(credentials, sizeof(credentials), "%s:%s",
+             c->rpcuser, c->rpcpassword);
+    char auth_b64[352];
+    if (rpc_base64(credentials, strlen(credentials),
+                   auth_b64, sizeof(auth_b64)) < 0)
+        return 0;
+    snprintf(c->auth_header, sizeof(c->auth_header),
+             "Authorization: Basic %s\r\n", auth_b64);
+
+    for (size_t i = 0; i < RPC_CLIENT_POOL_SIZE; i++) {
+        c->conns[i].fd = -1;
+        c->conns[i].in_use = 0;
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    return 1;
+}
+
+void rpc_client_close(rpc_client_t *c)
+{
+    if (!c) return;
+    pthread_mutex_lock(&c->lock);
+    for (size_t i = 0; i < RPC_CLIENT_POOL_SIZE; i++) {
+        if (!c->conns[i].in_use && c->conns[i].fd >= 0) {
+            close(c->conns[i].fd);
+            c->conns[i].fd = -1;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static rpc_client_t    g_shared[RPC_CLIENT_MAX_SHARED];
+static size_t          g_n_shared = 0;
+static pthread_mutex_t g_shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+rpc_client_t *rpc_client_shared(const char *host, int port,
+                                 const char *rpcuser, const char *rpcpassword)
+{
+    if (!host || !rpcuser || !rpcpassword || port <= 0) return NULL;
+
+    rpc_client_t *found = NULL;
+    pthread_mutex_lock(&g_shared_lock);
+    for (size_t i = 0; i < g_n_shared; i++) {
+        rpc_client_t *c = &g_shared[i];
+        if (c->port == port &&
+            strcmp(c->host, host) == 0 &&
+            strcmp(c->rpcuser, rpcuser) == 0 &&
+            strcmp(c->rpcpassword, rpcpassword) == 0) {
+            found = c;
+            break;
+        }
+    }
+    if (!found && g_n_shared < RPC_CLIENT_MAX_SHARED &&
+        rpc_client_init(&g_shared[g_n_shared], host, port,
+                        rpcuser, rpcpassword))
+        found = &g_shared[g_n_shared++];
+    pthread_mutex_unlock(&g_shared_lock);
+    return found;
+}
+
+/* ------------------------------------------------------------------ */
+/* Connection pool                                                      */
+/* ------------------------------------------------------------------ */
+
+static int rpc_connect(const rpc_client_t *c)
+{
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    char port_str[16];
+    snprintf(port_str, sizeof(port_str), "%d", c->port);
+    if (getaddrinfo(c->host, port_str, &hints, &res) != 0) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) { freeaddrinfo(res); return -1; }
+    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd); freeaddrinfo(res); return -1;
+    }
+    freeaddrinfo(res);
+
+    struct timeval tv = { RPC_CLIENT_TIMEOUT_SECS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    /* Requests are small and latency-bound; don't let Nagle hold them
+       back waiting for the previous response's delayed ACK. */
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/* Grab a connection.  Returns the pool slot (>= 0) or -1 for a transient
+   socket the pool does not own.  *fd_out is -1 if connecting failed.
+   *reused_out is 1 when the socket was an existing keep-alive one. */
+static int conn_acquire(rpc_client_t *c, int *fd_out, int *reused_out)
+{
+    int slot = -1;
+    *reused_out = 0;
+
+    pthread_mutex_lock(&c->lock);
+    for (int i = 0; i < RPC_CLIENT_POOL_SIZE; i++) {
+        if (!c->conns[i].in_use && c->conns[i].fd >= 0) {
+            c->conns[i].in_use = 1;
+            *fd_out = c->conns[i].fd;
+            *reused_out = 1;
+            pthread_mutex_unlock(&c->lock);
+            return i;
+        }
+    }
+    for (int i = 0; i < RPC_CLIENT_POOL_SIZE; i++) {
+        if (!c->conns[i].in_use) {
+            c->conns[i].in_use = 1;
+            slot = i;
+            break;
+        }
+    }
+    c->n_connects++;
+    pthread_mutex_unlock(&c->lock);
+
+    *fd_out = rpc_connect(c);
+    if (*fd_out < 0 && slot >= 0) {
+        pthread_mutex_lock(&c->lock);
+        c->conns[slot].in_use = 0;
+        pthread_mutex_unlock(&c->lock);
+    }
+    return slot;
+}
+
+static void conn_release(rpc_client_t *c, int slot, int fd, int keep)
+{
+    if (slot < 0) {
+        close(fd);
+        return;
+    }
+    pthread_mutex_lock(&c->lock);
+    if (keep) {
+        c->conns[slot].fd = fd;
+    } else {
+        close(fd);
+        c->conns[slot].fd = -1;
+    }
+    c->conns[slot].in_use = 0;
+    pthread_mutex_unlock(&c->lock);
+}
+
+/* ------------------------------------------------------------------ */
+/* HTTP/1.1 framing                                                     */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    int    fd;
+    char  *buf;
+    size_t len;
+    size_t cap;
+    int    closed;  /* peer closed or reset the socket (not a timeout) */
+} rpc_rbuf_t;
+
+/* Receive more bytes.  Returns 1 if at least one byte arrived, 0 on
+   EOF, error, timeout or OOM; r->closed is set on EOF or ECONNRESET. */
+static int rbuf_fill(rpc_rbuf_t *r)
+{
+    if (r->len + 1 >= r->cap) {
+        size_t ncap = r->cap * 2;
+        char *tmp = realloc(r->buf, ncap);
+        if (!tmp) return 0;
+        r->buf = tmp;
+        r->cap = ncap;
+    }
+    ssize_t n = recv(r->fd, r->buf + r->len, r->cap - r->len - 1, 0);
+    if (n == 0 || (n < 0 && errno == ECONNRESET)) r->closed = 1;
+    if (n <= 0) return 0;
+    r->len += (size_t)n;
+    r->buf[r->len] = '\0';
+    return 1;
+}
+
+/* Ensure at least need bytes are buffered. */
+static int rbuf_want(rpc_rbuf_t *r, size_t need)
+{
+    while (r->len < need)
+        if (!rbuf_fill(r)) return 0;
+    return 1;
+}
+
+/* Case-insensitive header lookup within [hdr, hdr_end).  Returns a
+   pointer to the value (leading spaces skipped) or NULL. */
+static const char *find_header(const char *hdr, const char *hdr_end,
+                                const char *name)
+{
+    size_t nlen = strlen(name);
+    const char *p = hdr;
+    while (p < hdr_end) {
+        const char *eol = strstr(p, "\r\n");
+        if (!eol || eol > hdr_end) eol = hdr_end;
+        if ((size_t)(eol - p) > nlen && strncasecmp(p, name, nlen) == 0 &&
+            p[nlen] == ':') {
+            const char *v = p + nlen + 1;
+            while (v < eol && *v == ' ') v++;
+            return v;
+        }
+        p = eol + 2;
+    }
+    return NULL;
+}
+
+/* Send req and read one full response.  Returns the malloc'd,
+   NUL-terminated body or NULL.  *keep_out says whether the socket may
+   carry another request; *stale_out whether the peer had closed the
+   socket before any response byte came back (a stale keep-alive socket,
+   safe to retry).  A receive timeout is not stale: the request may still
+   be executing. */
+static char *http_roundtrip(int fd, const char *req, size_t req_len,
+                             int *keep_out, int *stale_out,
+                             rpc_error_t *err)
+{
+    *keep_out = 0;
+    *stale_out = 0;
+
+    size_t sent = 0;
+    while (sent < req_len) {
+        ssize_t n = send(fd, req + sent, req_len - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            /* Nothing of a partly sent request was executed yet */
+            *stale_out = (n < 0 && (errno == EPIPE || errno == ECONNRESET));
+            rpc_set_error(err, 0, "send failed");
+            return NULL;
+        }
+        sent += (size_t)n;
+    }
+
+    rpc_rbuf_t r = { fd, malloc(16384), 0, 16384, 0 };
+    if (!r.buf) { rpc_set_error(err, 0, "out of memory"); return NULL; }
+    r.buf[0] = '\0';
+
+    char *hdr_end = NULL;
+    while (!(hdr_end = strstr(r.buf, "\r\n\r\n"))) {
+        if (!rbuf_fill(&r)) {
+            *stale_out = (r.len == 0 && r.closed);
+            free(r.buf);
+            rpc_set_error(err, 0, r.closed ? "connection closed before response"
+                                           : "timed out waiting for response");
+            if (err) err->timed_out = !r.closed;
+            return NULL;
+        }
+    }
+    size_t body_ofs = (size_t)(hdr_end - r.buf) + 4;
+
+    int http_minor = 0, status = 0;
+    if (sscanf(r.buf, "HTTP/1.%d %d", &http_minor, &status) != 2) {
+        free(r.buf);
+        rpc_set_error(err, 0, "malformed HTTP status line");
+        return NULL;
+    }
+
+    const char *cl  = find_header(r.buf, hdr_end, "Content-Length");
+    const char *te  = find_header(r.buf, hdr_end, "Transfer-Encoding");
+    const char *con = find_header(r.buf, hdr_end, "Connection");
+    int chunked = te && strncasecmp(te, "chunked", 7) == 0;
+    int keep = (http_minor >= 1);
+    if (con && strncasecmp(con, "close", 5) == 0) keep = 0;
+    if (con && strncasecmp(con, "keep-alive", 10) == 0) keep = 1;
+
+    char *body = NULL;
+    if (chunked) {
+        size_t out_cap = 16384, out_len = 0;
+        body = malloc(out_cap);
+        size_t pos = body_ofs;
+        for (;;) {
+            char *eol;
+            while (!(eol = strstr(r.buf + pos, "\r\n")))
+                if (!rbuf_fill(&r)) goto fail;
+            unsigned long csz = strtoul(r.buf + pos, NULL, 16);
+            pos = (size_t)(eol - r.buf) + 2;
+            if (!rbuf_want(&r, pos + csz + 2)) goto fail;
+            if (csz == 0) break;
+            if (!body) goto fail;
+            if (out_len + csz + 1 > out_cap) {
+                while (out_len + csz + 1 > out_cap) out_cap *= 2;
+                char *tmp = realloc(body, out_cap);
+                if (!tmp) goto fail;
+                body = tmp;
+            }
+            memcpy(body + out_len, r.buf + pos, csz);
+            out_len += csz;
+            pos += csz + 2;
+        }
+        if (!body) goto fail;
+        body[out_len] = '\0';
+        free(r.buf);
+    } else if (cl) {
+        size_t clen = (size_t)strtoull(cl, NULL, 10);
+        if (!rbuf_want(&r, body_ofs + clen)) goto fail;
+        memmove(r.buf, r.buf + body_ofs, clen);
+        r.buf[clen] = '\0';
+        body = r.buf;
+    } else {
+        /* No framing: the body runs to EOF and the socket is spent. */
+        while (rbuf_fill(&r)) {}
+        memmove(r.buf, r.buf + body_ofs, r.len - body_ofs);
+        r.buf[r.len - body_ofs] = '\0';
+        body = r.buf;
+        keep = 0;
+    }
+
+    /* bitcoind answers RPC errors with 404/500 plus a JSON body; auth
+       failures come back as 401 with an empty body. */
+    if (status == 401 || status == 403) {
+        free(body);
+        rpc_set_error(err, 0, "HTTP authorization rejected");
+        return NULL;
+    }
+    *keep_out = keep;
+    return body;
+
+fail:
+    free(body);
+    free(r.buf);
+    rpc_set_error(err, 0, "truncated HTTP response");
+    return NULL;
+}
+
+/* POST body to the endpoint, reusing a pooled connection when possible.
+   Returns the response body (caller frees) or NULL. */
+static char *rpc_exchange(rpc_client_t *c, const char *wallet,
+                           const char *body, size_t n_calls,
+                           rpc_error_t *err)
+{
+    char path[256] = "/";
+    if (wallet && wallet[0] != '\0')
+        snprintf(path, sizeof(path), "/wallet/%s", wallet);
+
+    size_t body_len = strlen(body);
+    size_t reqcap = body_len + strlen(c->auth_header) + strlen(c->host) + 512;
+    char *req = malloc(reqcap);
+    if (!req) { rpc_set_error(err, 0, "out of memory"); return NULL; }
+    int req_len = snprintf(req, reqcap,
+        "POST %s HTTP/1.1\r\n"
+        "Host: %s:%d\r\n"
+        "%s"
+        "Content-Type: application/json\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "%s",
+        path, c->host, c->port, c->auth_header, body_len, body);
+    if (req_len <= 0 || (size_t)req_len >= reqcap) {
+        free(req);
+        rpc_set_error(err, 0, "request too large");
+        return NULL;
+    }
+
+    char *resp = NULL;
+    /* Every pooled socket may have been closed by bitcoind while idle
+       (restart, -rpcservertimeout), so allow one stale hit per slot
+       plus one fresh connect. */
+    for (int attempt = 0; attempt <= RPC_CLIENT_POOL_SIZE; attempt++) {
+        int fd, reused, keep = 0, stale = 0;
+        int slot = conn_acquire(c, &fd, &reused);
+        if (fd < 0) {
+            rpc_set_error(err, 0, "connect failed");
+            break;
+        }
+        resp = http_roundtrip(fd, req, (size_t)req_len, &keep, &stale, err);
+        conn_release(c, slot, fd, resp != NULL && keep);
+        if (resp) {
+            pthread_mutex_lock(&c->lock);
+            c->n_requests++;
+            c->n_calls += n_calls;
+            pthread_mutex_unlock(&c->lock);
+            break;
+        }
+        /* Only a socket bitcoind had already closed is retried: after a
+           timeout the call may have run, and a second sendrawtransaction
+           or generatetoaddress must not go out */
+        if (!reused || !stale) break;
+    }
+    free(req);
+    return resp;
+}
+
+/* ------------------------------------------------------------------ */
+/* JSON-RPC                                                             */
+/* ------------------------------------------------------------------ */
+
+static cJSON *rpc_build_request(const char *method, cJSON *params, int id)
+{
+    cJSON *req = cJSON_CreateObject();
+    if (!req) { cJSON_Delete(params); return NULL; }
+    cJSON_AddStringToObject(req, "jsonrpc", "1.0");
+    cJSON_AddNumberToObject(req, "id", id);
+    cJSON_AddStringToObject(req, "method", method);
+    cJSON_AddItemToObject(req, "params", params ? params : cJSON_CreateArray());
+    return req;
+}
+
+/* Split one response object into result / error.  Returns the detached
+   result or NULL with err filled. */
+static cJSON *rpc_take_result(cJSON *resp, rpc_error_t *err)
+{
+    cJSON *e = cJSON_GetObjectItem(resp, "error");
+    if (e && !cJSON_IsNull(e)) {
+        cJSON *ecode = cJSON_GetObjectItem(e, "code");
+        cJSON *emsg  = cJSON_GetObjectItem(e, "message");
+        rpc_set_error(err,
+                      (ecode && cJSON_IsNumber(ecode)) ? ecode->valueint : 0,
+                      (emsg && cJSON_IsString(emsg)) ? emsg->valuestring
+                                                     : "unknown");
+        return NULL;
+    }
+    cJSON *result = cJSON_DetachItemFromObject(resp, "result");
+    if (!result) {
+        rpc_set_error(err, 0, "response has no result");
+        return NULL;
+    }
+    rpc_set_error(err, 0, "");
+    return result;
+}
+
+cJSON *rpc_client_call(rpc_client_t *c, const char *wallet,
+                        const char *method, cJSON *params,
+                        rpc_error_t *err_out)
+{
+    rpc_error_t scratch;
+    rpc_error_t *err = err_out ? err_out : &scratch;
+    if (!c || !method) {
+        cJSON_Delete(params);
+        rpc_set_error(err, 0, "bad arguments");
+        return NULL;
+    }
+
+    cJSON *req = rpc_build_request(method, params, 1);
+    char *body = req ? cJSON_PrintUnformatted(req) : NULL;
+    cJSON_Delete(req);
+    if (!body) { rpc_set_error(err, 0, "out of memory"); return NULL; }
+
+    char *resp = rpc_exchange(c, wallet, body, 1, err);
+    free(body);
+    if (!resp) return NULL;
+
+    cJSON *jresp = cJSON_Parse(resp);
+    free(resp);
+    if (!jresp || !cJSON_IsObject(jresp)) {
+        cJSON_Delete(jresp);
+        rpc_set_error(err, 0, "unparseable response");
+        return NULL;
+    }
+    cJSON *result = rpc_take_result(jresp, err);
+    cJSON_Delete(jresp);
+    return result;
+}
+
+int rpc_client_batch(rpc_client_t *c, const char *wallet,
+                      rpc_batch_item_t *items, size_t n_items)
+{
+    if (!items) return 0;
+    for (size_t i = 0; i < n_items; i++) {
+        items[i].result = NULL;
+        rpc_set_error(&items[i].err, 0, "not sent");
+    }
+    if (!c || n_items == 0) goto fail;
+
+    cJSON *arr = cJSON_CreateArray();
+    if (!arr) goto fail;
+    for (size_t i = 0; i < n_items; i++) {
+        cJSON *req = rpc_build_request(items[i].method, items[i].params, (int)i);
+        items[i].params = NULL;
+        if (!req) { cJSON_Delete(arr); goto fail; }
+        cJSON_AddItemToArray(arr, req);
+    }
+    char *body = cJSON_PrintUnformatted(arr);
+    cJSON_Delete(arr);
+    if (!body) return 0;
+
+    rpc_error_t terr;
+    char *resp = rpc_exchange(c, wallet, body, n_items, &terr);
+    free(body);
+    if (!resp) {
+        for (size_t i = 0; i < n_items; i++) items[i].err = terr;
+        return 0;
+    }
+
+    cJSON *jresp = cJSON_Parse(resp);
+    free(resp);
+    if (!jresp) {
+        for (size_t i = 0; i < n_items; i++)
+            rpc_set_error(&items[i].err, 0, "unparseable response");
+        return 0;
+    }
+
+    /* A whole-batch rejection comes back as a single error object. */
+    if (cJSON_IsObject(jresp)) {
+        rpc_error_t berr;
+        cJSON *r = rpc_take_result(jresp, &berr);
+        cJSON_Delete(r);
+        for (size_t i = 0; i < n_items; i++) items[i].err = berr;
+        cJSON_Delete(jresp);
+        return 1;
+    }
+
+    for (size_t i = 0; i < n_items; i++)
+        rpc_set_error(&items[i].err, 0, "missing from batch response");
+    cJSON *entry = NULL;
+    cJSON_ArrayForEach(entry, jresp) {
+        cJSON *id = cJSON_GetObjectItem(entry, "id");
+        if (!id || !cJSON_IsNumber(id)) continue;
+        int idx = id->valueint;
+        if (idx < 0 || (size_t)idx >= n_items || items[idx].result) continue;
+        items[idx].result = rpc_take_result(entry, &items[idx].err);
+    }
+    cJSON_Delete(jresp);
+    return 1;
+
+fail:
+    for (size_t i = 0; i < n_items; i++) {
+        cJSON_Delete(items[i].params);
+        items[i].params = NULL;
+    }
+    return 0;
+}
@@ -5,7 +5,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sys/socket.h>
+#include "superscalar/sha256.h"
 
 /*
  * Unit tests for BIP 158 GCS filter decoder, SipHash-2-4, and script registry.
@@ -693,6 +696,141 @@ int test_bip158_compute_filter_header(void)
     return 1;
 }
 
+/* -------------------------------------------------------------------------
+ * Fast-path matcher: multi-lane SipHash, word-at-a-time Golomb-Rice decode
+ * ------------------------------------------------------------------------- */
+
+extern void _bip158_test_hash_batch(const unsigned char *key16,
+                                     const bip158_script_t *scripts, size_t n,
+                                     uint64_t F, uint64_t *out);
+
+/* Deterministic script of the given length, distinct per seed. */
+static void make_script(bip158_script_t *s, uint32_t seed, size_t len)
+{
+    memset(s, 0, sizeof(*s));
+    for (size_t i = 0; i < len; i++)
+        s->spk[i] = (unsigned char)((seed * 2654435761u) >> ((i % 4) * 8)) ^ (unsigned char)i;
+    s->spk[0] = (unsigned char)seed;
+    s->spk[1] = (unsigned char)(seed >> 8);
+    s->spk_len = len;
+}
+
+/* Test 19: batch hashing (multi-lane runs + scalar fallback) is bit-identical
+ * to the scalar hash for every length from 0 to 40 and for mixed runs. */
+int test_bip158_hash_batch_matches_scalar(void)
+{
+    static const unsigned char key[16] = {
+        0x10,0x32,0x54,0x76,0x98,0xba,0xdc,0xfe,
+        0x01,0x23,0x45,0x67,0x89,0xab,0xcd,0xef
+    };
+    const uint64_t F = 5000 * (uint64_t)BIP158_M;
+
+    static bip158_script_t scripts[41 * 4 + 13];
+    uint64_t out[41 * 4 + 13];
+    size_t n = 0;
+    for (size_t len = 0; len <= 40; len++)       /* equal-length lanes */
+        for (int l = 0; l < 4; l++, n++)
+            make_script(&scripts[n], (uint32_t)n, len);
+    static const size_t mixed[13] = { 34, 22, 34, 34, 34, 34, 25, 22, 22, 1, 34, 34, 0 };
+    for (int i = 0; i < 13; i++, n++)           /* ragged run + tail */
+        make_script(&scripts[n], (uint32_t)n, mixed[i]);
+
+    _bip158_test_hash_batch(key, scripts, n, F, out);
+    for (size_t i = 0; i < n; i++) {
+        ASSERT(out[i] == _bip158_test_hash(key, scripts[i].spk,
+                                           scripts[i].spk_len, F),
+               "batch hash matches scalar hash");
+        ASSERT(out[i] < F, "hash in range");
+    }
+    return 1;
+}
+
+/* Test 20: large mixed-length watch set against a built filter.  Exercises
+ * the radix-sort path (>= 64 queries) and reuse of the backend scratch
+ * across calls to bip158_scan_filter. */
+int test_bip158_gcs_large_watch_set(void)
+{
+    static const unsigned char key[16] = { 0x5a };
+    enum { N_IN = 300, N_WATCH = 500 };
+
+    static bip158_script_t in[N_IN];
+    for (int i = 0; i < N_IN; i++)
+        make_script(&in[i], 100000u + (uint32_t)i, (i % 3) ? 34 : 22);
+
+    size_t cap = bip158_gcs_build_size(N_IN);
+    unsigned char *filter = malloc(cap);
+    ASSERT(filter != NULL, "malloc failed");
+    size_t filter_len = bip158_gcs_build(in, N_IN, key, filter, cap);
+    ASSERT(filter_len > 3, "build");
+
+    bip158_backend_t *b = calloc(1, sizeof(*b));
+    ASSERT(b != NULL, "calloc backend");
+    ASSERT(bip158_backend_init(b, "regtest"), "init");
+
+    /* Watch set of absent scripts: no match. */
+    for (int i = 0; i < N_WATCH; i++) {
+        make_script(&b->scripts[i], 900000u + (uint32_t)i, (i % 4) ? 34 : 22);
+    }
+    b->n_scripts = N_WATCH;
+    ASSERT(bip158_scan_filter(b, filter, filter_len, key) == 0,
+           "absent watch set does not match");
+    uint64_t *scratch = b->match_scratch;
+    ASSERT(scratch != NULL && b->match_scratch_cap >= 2 * N_WATCH, "scratch sized");
+
+    /* Plant one included script at the start, middle, and end in turn. */
+    static const int at[3] = { 0, N_WATCH / 2, N_WATCH - 1 };
+    for (int k = 0; k < 3; k++) {
+        bip158_script_t saved = b->scripts[at[k]];
+        b->scripts[at[k]] = in[(k * 97) % N_IN];
+        ASSERT(bip158_scan_filter(b, filter, filter_len, key) == 1,
+               "planted script matches");
+        b->scripts[at[k]] = saved;
+    }
+    ASSERT(b->match_scratch == scratch, "scratch reused across scans");
+
+    /* Truncated filter: decode overruns cleanly, never matches past the end. */
+    b->scripts[0] = in[N_IN - 1];
+    bip158_scan_filter(b, filter, filter_len / 2, key);
+
+    bip158_backend_free(b);
+    ASSERT(b->match_scratch == NULL, "scratch freed");
+    free(b);
+    free(filter);
+    return 1;
+}
+
+/* Test 21: a unary quotient longer than one 64-bit word decodes correctly. */
+int test_bip158_gcs_long_quotient(void)
+{
+    unsigned char key[16] = {0};
+    const uint64_t N = 1000;
+    const uint64_t F = N * BIP158_M;
+
+    /* Find a script whose hash has a quotient in [100, 400]: its unary
+       prefix spans two or more refill words. */
+    bip158_script_t s;
+    uint64_t h = 0;
+    uint32_t seed = 0;
+    for (; seed < 100000; seed++) {
+        make_script(&s, seed, 34);
+        h = _bip158_test_hash(key, s.spk, 34, F);
+        if ((h >> BIP158_P) >= 100 && (h >> BIP158_P) <= 400) break;
+    }
+    ASSERT(seed < 100000, "found long-quotient script");
+
+    bit_writer_t bw;
+    memset(&bw, 0, sizeof(bw));
+    write_golomb_rice(&bw, h, BIP158_P);
+    size_t gcs_bytes = (bw.bit_pos + 7) / 8;
+    ASSERT(bip158_gcs_match_any(bw.buf, gcs_bytes, N, key, &s, 1) == 1,
+           "long quotient decodes to the right value");
+
+    /* Cut inside the unary prefix: overrun, no match. */
+    ASSERT(bip158_gcs_match_any(bw.buf, 8, N, key, &s, 1) == 0,
+           "truncated unary prefix does not match");
+    return 1;
+}
+
 /* -----------------------------------------------------------------------
  * Phase D: multi-peer concurrent filter queries
  * --------------------------------------------------------------------- */
@@ -778,6 +916,252 @@ int test_multi_peer_round_robin(void)
     return 1;
 }
 
+/* -----------------------------------------------------------------------
+ * Phase 8: parallel pipelined P2P scan (bip158_scan_p2p_range)
+ *
+ * Fake peers on socketpairs serve getcfilters/getdata from an in-memory
+ * chain whose coinbase at a few heights pays a watched script.
+ * --------------------------------------------------------------------- */
+
+#define PS_HEIGHTS   600
+#define PS_BLOCK_LEN (80 + 1 + 4 + 1 + 36 + 1 + 4 + 1 + 8 + 1 + 22 + 4)
+
+typedef struct {
+    uint8_t  blocks[PS_HEIGHTS][PS_BLOCK_LEN];
+    uint8_t  hashes[PS_HEIGHTS][32];
+    uint8_t  filters[PS_HEIGHTS][64];
+    size_t   filter_len[PS_HEIGHTS];
+    uint8_t  filter_hdrs[PS_HEIGHTS][32];
+    uint8_t  watched[22];
+} ps_chain_t;
+
+static int ps_is_hit(int h) { return h == 5 || h == 260 || h == 599; }
+
+static void ps_build_chain(ps_chain_t *c, uint8_t salt)
+{
+    memset(c, 0, sizeof(*c));
+    c->watched[0] = 0x00; c->watched[1] = 0x14;
+    memset(c->watched + 2, 0x77 ^ salt, 20);
+    uint8_t prev_fh[32] = {0};
+
+    for (int h = 0; h < PS_HEIGHTS; h++) {
+        uint8_t *b = c->blocks[h];
+        b[0] = 1;
+        if (h > 0) memcpy(b + 4, c->hashes[h - 1], 32);
+        b[72] = salt;
+        b[76] = (uint8_t)h; b[77] = (uint8_t)(h >> 8);
+        size_t n = 80;
+        b[n++] = 1;                                  /* tx count  */
+        b[n++] = 1; n += 3;                          /* version   */
+        b[n++] = 1;                                  /* vin       */
+        memset(b + n, 0, 32); n += 32;
+        memset(b + n, 0xff, 4); n += 4;
+        b[n++] = 0;                                  /* scriptSig */
+        memset(b + n, 0xff, 4); n += 4;
+        b[n++] = 1;                                  /* vout      */
+        b[n] = 0x10; n += 8;                         /* value     */
+        b[n++] = 22;
+        if (ps_is_hit(h)) {
+            memcpy(b + n, c->watched, 22);
+        } else {
+            b[n] = 0x00; b[n + 1] = 0x14;
+            b[n + 2] = (uint8_t)h; b[n + 3] = (uint8_t)(h >> 8); b[n + 4] = salt;
+        }
+        n += 22;
+        b[n] = (uint8_t)h; b[n + 1] = (uint8_t)(h >> 8);  /* locktime: unique txid */
+        n += 4;
+        sha256_double(b, 80, c->hashes[h]);
+
+        bip158_script_t sc;
+        memcpy(sc.spk, b + 80 + 1 + 4 + 1 + 36 + 1 + 4 + 1 + 8 + 1, 22);
+        sc.spk_len = 22;
+        c->filter_len[h] = bip158_gcs_build(&sc, 1, c->hashes[h],
+                                            c->filters[h], sizeof(c->filters[h]));
+        bip158_compute_filter_header(c->filters[h], c->filter_len[h], prev_fh,
+                                     c->filter_hdrs[h]);
+        memcpy(prev_fh, c->filter_hdrs[h], 32);
+    }
+}
+
+typedef struct {
+    const ps_chain_t *chain;
+    int               fd;
+    int               corrupt;     /* serve filters that fail header checks */
+    int               slow;        /* pause per filter so the other peer gets work */
+    int               n_getcfilters;
+    int               n_getdata;
+} ps_peer_t;
+
+static int ps_find(const ps_chain_t *c, const uint8_t *hash)
+{
+    for (int h = 0; h < PS_HEIGHTS; h++)
+        if (memcmp(c->hashes[h], hash, 32) == 0) return h;
+    return -1;
+}
+
+static void *ps_peer_thread(void *arg)
+{
+    ps_peer_t  *pp = (ps_peer_t *)arg;
+    p2p_conn_t  conn;
+    memset(&conn, 0, sizeof(conn));
+    conn.fd = pp->fd;
+    memcpy(conn.magic, "\xfa\xbf\xb5\xda", 4);
+
+    for (;;) {
+        char     cmd[13];
+        uint8_t *pl = NULL;
+        int      plen = p2p_recv_msg(&conn, cmd, &pl);
+        if (plen < 0) { free(pl); break; }
+        if (strcmp(cmd, "getcfilters") == 0 && plen >= 37) {
+            pp->n_getcfilters++;
+            int start = pl[1] | (pl[2] << 8) | (pl[3] << 16) | (pl[4] << 24);
+            int stop  = ps_find(pp->chain, pl + 5);
+            for (int h = start; stop >= 0 && h <= stop; h++) {
+                uint8_t msg[1 + 32 + 1 + 64];
+                size_t  fl = pp->chain->filter_len[h];
+                msg[0] = 0;
+                memcpy(msg + 1, pp->chain->hashes[h], 32);
+                msg[33] = (uint8_t)fl;
+                memcpy(msg + 34, pp->chain->filters[h], fl);
+                if (pp->corrupt) msg[34 + fl - 1] ^= 0x5a;
+                if (pp->slow) usleep(200);
+                p2p_send_msg(&conn, "cfilter", msg, (uint32_t)(34 + fl));
+            }
+        } else if (strcmp(cmd, "getdata") == 0 && plen >= 37) {
+            pp->n_getdata++;
+            int h = ps_find(pp->chain, pl + 5);
+            if (h >= 0)
+                p2p_send_msg(&conn, "block", pp->chain->blocks[h], PS_BLOCK_LEN);
+        }
+        free(pl);
+    }
+    return NULL;
+}
+
+typedef struct {
+    int n;
+    int heights[PS_HEIGHTS];
+    int n_found;
+    int found_heights[8];
+    bip158_backend_t *grow;    /* register a script per block on this */
+} ps_rec_t;
+
+static void ps_connected_cb(uint32_t height, void *ctx)
+{
+    ps_rec_t *r = (ps_rec_t *)ctx;
+    if (r->n < PS_HEIGHTS) r->heights[r->n++] = (int)height;
+    if (r->grow && height < 400) {
+        unsigned char spk[22] = { 0x00, 0x14 };
+        spk[2] = 0xee;
+        spk[3] = (unsigned char)height;
+        spk[4] = (unsigned char)(height >> 8);
+        r->grow->base.register_script(&r->grow->base, spk, sizeof(spk));
+    }
+}
+
+static void ps_utxo_cb(const char *txid_hex, uint32_t vout, uint64_t amount,
+                       const unsigned char *spk, size_t spk_len, void *ctx)
+{
+    (void)txid_hex; (void)vout; (void)amount; (void)spk; (void)spk_len;
+    ps_rec_t *r = (ps_rec_t *)ctx;
+    /* Heights commit in order from 0, so r->n is the height being committed. */
+    if (r->n_found < 8) r->found_heights[r->n_found++] = r->n;
+}
+
+static int ps_run(int corrupt_second, int grow_scripts, uint8_t salt)
+{
+    static ps_chain_t chain;
+    ps_build_chain(&chain, salt);
+    /* Fake peers may still be writing to a socket the scan just closed. */
+    signal(SIGPIPE, SIG_IGN);
+
+    bip158_backend_t *b = calloc(1, sizeof(*b));
+    ASSERT(b != NULL, "calloc");
+    ASSERT(bip158_backend_init(b, "regtest"), "init");
+    for (int h = 0; h < PS_HEIGHTS; h++) {
+        memcpy(b->header_hashes[h % BIP158_HEADER_WINDOW], chain.hashes[h], 32);
+        memcpy(b->filter_headers[h % BIP158_HEADER_WINDOW], chain.filter_hdrs[h], 32);
+    }
+    b->headers_synced        = PS_HEIGHTS - 1;
+    b->filter_headers_synced = PS_HEIGHTS - 1;
+    ASSERT(b->base.register_script(&b->base, chain.watched, 22), "register");
+
+    int sv[2][2];
+    ps_peer_t peers[2];
+    pthread_t tids[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, sv[i]) == 0, "socketpair");
+        memset(&peers[i], 0, sizeof(peers[i]));
+        peers[i].chain   = &chain;
+        peers[i].fd      = sv[i][1];
+        peers[i].corrupt = (i == 1) && corrupt_second;
+        peers[i].slow    = (i == 0) && corrupt_second;
+        b->peers[i].fd = sv[i][0];
+        memcpy(b->peers[i].magic, "\xfa\xbf\xb5\xda", 4);
+        b->peer_connected[i] = 1;
+        ASSERT(pthread_create(&tids[i], NULL, ps_peer_thread, &peers[i]) == 0,
+               "peer thread");
+    }
+    b->n_peers = b->n_connected = 2;
+
+    ps_rec_t *rec = calloc(1, sizeof(*rec));
+    ASSERT(rec != NULL, "calloc rec");
+    if (grow_scripts) rec->grow = b;
+    bip158_backend_set_block_connected_cb(b, ps_connected_cb, rec);
+    bip158_backend_set_utxo_cb(b, ps_utxo_cb, NULL, rec);
+
+    int matched = bip158_scan_p2p_range(b, 0, PS_HEIGHTS - 1);
+
+    ASSERT(matched == 3, "three watched blocks matched");
+    ASSERT(b->tip_height == PS_HEIGHTS - 1, "tip advanced to end of range");
+    ASSERT(rec->n == PS_HEIGHTS, "every height committed once");
+    for (int i = 0; i < rec->n; i++)
+        ASSERT(rec->heights[i] == i, "block_connected_cb in height order");
+    ASSERT(rec->n_found == 3, "utxo callback per hit block");
+    ASSERT(rec->found_heights[0] == 5 && rec->found_heights[1] == 260 &&
+           rec->found_heights[2] == 599, "utxo callbacks fire at their height");
+    ASSERT(b->n_tx_cache == 3, "hit txids cached");
+    if (grow_scripts)
+        ASSERT(b->n_scripts == 401, "scripts registered mid-scan kept");
+
+    if (corrupt_second) {
+        ASSERT(b->peers[1].fd < 0 && !b->peer_connected[1],
+               "peer serving bad filters disconnected");
+        ASSERT(b->peers[0].fd >= 0, "honest peer kept");
+    }
+
+    bip158_backend_free(b);   /* closes our ends; fake peers see EOF */
+    for (int i = 0; i < 2; i++) {
+        pthread_join(tids[i], NULL);
+        close(sv[i][1]);
+    }
+    if (corrupt_second)
+        ASSERT(peers[1].n_getcfilters > 0, "bad peer was asked");
+    free(rec);
+    free(b);
+    return 1;
+}
+
+/* Test P1: two honest peers — every height committed in order, all hits found */
+int test_bip158_parallel_scan_ordered(void)
+{
+    return ps_run(0, 0, 0x11);
+}
+
+/* Test P2: one peer serves filters failing BIP 157 header validation — it is
+ * dropped and the honest peer completes the range */
+int test_bip158_parallel_scan_bad_peer(void)
+{
+    return ps_run(1, 0, 0x22);
+}
+
+/* Test P3: block_connected_cb registers a script at every height while the
+ * scan runs — the workers match a snapshot and never outgrow their scratch */
+int test_bip158_parallel_scan_register_in_cb(void)
+{
+    return ps_run(0, 1, 0x33);
+}
+
 /* ================================================================== */
 /* PR #64: Mempool cache — cb_is_in_mempool tests                    */
 /* ================================================================== */
@@ -0,0 +1,262 @@
+/*
+ * test_block_cache.c — Unit tests for the parsed-block LRU cache
+ *
+ * BC1: test_block_cache_parse_raw        — txids, outputs and spends parsed from a raw block
+ * BC2: test_block_cache_lru_eviction     — least-recently-used block evicted at capacity
+ * BC3: test_block_cache_pinned_survives  — pinned entry stays valid after eviction/invalidate
+ * BC4: test_block_cache_txid_only        — txid-only entries upgrade to raw, never downgrade
+ * BC5: test_block_cache_invalidate_stats — reorg invalidation by height + hit-rate metrics
+ */
+
+#include "superscalar/block_cache.h"
+#include "superscalar/sha256.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+/* ------------------------------------------------------------------ */
+/* Raw block builder: coinbase (2 outputs) + one spend (1 in, 1 out)    */
+/* ------------------------------------------------------------------ */
+
+static size_t put_le64(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(v >> (8 * i));
+    return 8;
+}
+
+static size_t build_block(unsigned char *b, uint8_t tag,
+                          const unsigned char prev_block[32],
+                          const unsigned char spent_txid[32], uint32_t spent_vout)
+{
+    size_t n = 0;
+    memset(b, 0, 80);
+    b[0] = 1;
+    if (prev_block) memcpy(b + 4, prev_block, 32);
+    b[76] = tag;
+    n = 80;
+    b[n++] = 2;                                  /* tx count */
+
+    /* coinbase */
+    b[n++] = 1; b[n++] = 0; b[n++] = 0; b[n++] = 0;
+    b[n++] = 1;                                  /* vin */
+    memset(b + n, 0, 32); n += 32;               /* null prevout txid */
+    memset(b + n, 0xff, 4); n += 4;              /* vout 0xffffffff */
+    b[n++] = 1; b[n++] = tag;                    /* scriptSig */
+    memset(b + n, 0xff, 4); n += 4;              /* sequence */
+    b[n++] = 2;                                  /* vout */
+    n += put_le64(b + n, 5000000000ULL);
+    b[n++] = 1; b[n++] = 0x51;
+    n += put_le64(b + n, 0);
+    b[n++] = 2; b[n++] = 0x6a; b[n++] = tag;
+    memset(b + n, 0, 4); n += 4;                 /* locktime */
+
+    /* spend */
+    b[n++] = 2; b[n++] = 0; b[n++] = 0; b[n++] = 0;
+    b[n++] = 1;
+    memcpy(b + n, spent_txid, 32); n += 32;
+    b[n++] = (unsigned char)spent_vout; b[n++] = 0; b[n++] = 0; b[n++] = 0;
+    b[n++] = 0;                                  /* empty scriptSig */
+    memset(b + n, 0xff, 4); n += 4;
+    b[n++] = 1;
+    n += put_le64(b + n, 12345);
+    b[n++] = 3; b[n++] = 0x00; b[n++] = 0x01; b[n++] = tag;
+    memset(b + n, 0, 4); n += 4;
+    return n;
+}
+
+static void block_hash_hex(const unsigned char *raw, char out[65])
+{
+    unsigned char h[32];
+    sha256_double(raw, 80, h);
+    for (int i = 0; i < 32; i++)
+        sprintf(out + i * 2, "%02x", h[31 - i]);
+    out[64] = '\0';
+}
+
+/* Fake 64-char hash for txid-only tests. */
+static void fake_hash(char out[65], char fill)
+{
+    memset(out, fill, 64);
+    out[64] = '\0';
+}
+
+/* ------------------------------------------------------------------ */
+/* Tests                                                               */
+/* ------------------------------------------------------------------ */
+
+/* BC1 */
+int test_block_cache_parse_raw(void)
+{
+    block_cache_t c;
+    ASSERT(block_cache_init(&c, 4), "init");
+
+    unsigned char prev[32], spent[32], raw[512];
+    memset(prev, 0xab, 32);
+    memset(spent, 0x42, 32);
+    size_t len = build_block(raw, 7, prev, spent, 3);
+    char hx[65];
+    block_hash_hex(raw, hx);
+
+    block_cache_entry_t *e = block_cache_put_raw(&c, hx, 100, raw, len);
+    ASSERT(e != NULL, "put_raw");
+    ASSERT(e->has_io, "has_io");
+    ASSERT(e->height == 100, "height");
+    ASSERT(strcmp(e->prev_hash_hex,
+                  "abababababababababababababababababababababababababababababababab") == 0,
+           "prev hash from header");
+    ASSERT(e->n_tx == 2, "two txs");
+    ASSERT(e->n_outputs == 3, "three outputs");
+    ASSERT(e->outputs[0].tx_index == 0 && e->outputs[0].amount_sats == 5000000000ULL,
+           "coinbase output");
+    ASSERT(e->outputs[2].tx_index == 1 && e->outputs[2].amount_sats == 12345,
+           "spend output");
+    ASSERT(e->outputs[2].spk_len == 3 &&
+           e->spk_data[e->outputs[2].spk_off + 2] == 7, "spk bytes");
+    ASSERT(e->n_spends == 1, "coinbase input not recorded");
+    ASSERT(e->spends[0].tx_index == 1 && e->spends[0].prev_vout == 3,
+           "spent outpoint vout");
+    ASSERT(memcmp(e->spends[0].prev_txid, spent, 32) == 0, "spent outpoint txid");
+    ASSERT(block_cache_find_tx(e, e->txids[1]) == 1, "find tx");
+    block_cache_release(&c, e);
+
+    ASSERT(block_cache_put_raw(&c, hx, 100, raw, 40) == NULL, "short block rejected");
+    block_cache_free(&c);
+    return 1;
+}
+
+/* BC2 */
+int test_block_cache_lru_eviction(void)
+{
+    block_cache_t c;
+    ASSERT(block_cache_init(&c, 2), "init");
+    char a[65], b[65], d[65];
+    fake_hash(a, 'a'); fake_hash(b, 'b'); fake_hash(d, 'd');
+    const char *tx[1] = { a };
+
+    block_cache_release(&c, block_cache_put_txids(&c, a, 1, tx, 1));
+    block_cache_release(&c, block_cache_put_txids(&c, b, 2, tx, 1));
+    block_cache_entry_t *e = block_cache_get(&c, a);   /* a is now MRU */
+    ASSERT(e != NULL, "a cached");
+    block_cache_release(&c, e);
+
+    block_cache_release(&c, block_cache_put_txids(&c, d, 3, tx, 1));
+    e = block_cache_get(&c, b);
+    ASSERT(e == NULL, "b (LRU) evicted");
+    e = block_cache_get(&c, a);
+    ASSERT(e != NULL, "a kept");
+    block_cache_release(&c, e);
+
+    block_cache_stats_t st;
+    block_cache_get_stats(&c, &st);
+    ASSERT(st.evictions == 1, "one eviction");
+    ASSERT(st.n_entries == 2 && st.capacity == 2, "size bounded");
+    block_cache_free(&c);
+    return 1;
+}
+
+/* BC3 */
+int test_block_cache_pinned_survives(void)
+{
+    block_cache_t c;
+    ASSERT(block_cache_init(&c, 1), "init");
+    char a[65], b[65];
+    fake_hash(a, 'a'); fake_hash(b, 'b');
+    const char *tx[2] = { a, b };
+
+    block_cache_entry_t *pinned = block_cache_put_txids(&c, a, 1, tx, 2);
+    ASSERT(pinned != NULL, "put a");
+    block_cache_release(&c, block_cache_put_txids(&c, b, 2, tx, 2)); /* evicts a */
+    ASSERT(block_cache_get(&c, a) == NULL, "a no longer in table");
+    ASSERT(pinned->n_tx == 2 && block_cache_find_tx(pinned, b) == 1,
+           "pinned data still readable");
+    block_cache_release(&c, pinned);   /* frees the detached entry */
+
+    block_cache_entry_t *pb = block_cache_get(&c, b);
+    ASSERT(pb != NULL, "b cached");
+    ASSERT(block_cache_invalidate(&c, b), "invalidate b");
+    ASSERT(strcmp(pb->hash_hex, b) == 0, "pinned across invalidate");
+    block_cache_release(&c, pb);
+    block_cache_free(&c);
+    return 1;
+}
+
+/* BC4 */
+int test_block_cache_txid_only(void)
+{
+    block_cache_t c;
+    ASSERT(block_cache_init(&c, 4), "init");
+
+    unsigned char spent[32], raw[512];
+    memset(spent, 0x11, 32);
+    size_t len = build_block(raw, 1, NULL, spent, 0);
+    char hx[65];
+    block_hash_hex(raw, hx);
+
+    /* Seed a txid-only entry with the real txids, upper-cased. */
+    block_cache_entry_t *full = block_cache_put_raw(&c, hx, 5, raw, len);
+    ASSERT(full != NULL, "parse");
+    char t0[65], t1[65];
+    memcpy(t0, full->txids[0], 65);
+    memcpy(t1, full->txids[1], 65);
+    block_cache_release(&c, full);
+    ASSERT(block_cache_invalidate(&c, hx), "reset");
+
+    for (int i = 0; i < 64; i++)
+        if (t1[i] >= 'a' && t1[i] <= 'f') t1[i] = (char)(t1[i] - 32);
+    const char *ids[2] = { t0, t1 };
+    block_cache_entry_t *e = block_cache_put_txids(&c, hx, 5, ids, 2);
+    ASSERT(e && !e->has_io, "txid-only entry");
+    ASSERT(block_cache_find_tx(e, t1) == 1, "case-insensitive lookup");
+    block_cache_release(&c, e);
+
+    e = block_cache_put_raw(&c, hx, 5, raw, len);
+    ASSERT(e && e->has_io, "raw replaces txid-only");
+    block_cache_release(&c, e);
+
+    e = block_cache_put_txids(&c, hx, 5, ids, 2);
+    ASSERT(e && e->has_io, "txid-only does not downgrade");
+    block_cache_release(&c, e);
+
+    block_cache_stats_t st;
+    block_cache_get_stats(&c, &st);
+    ASSERT(st.n_entries == 1, "one entry for the hash");
+    block_cache_free(&c);
+    return 1;
+}
+
+/* BC5 */
+int test_block_cache_invalidate_stats(void)
+{
+    block_cache_t c;
+    ASSERT(block_cache_init(&c, 8), "init");
+    char h[4][65];
+    const char *tx[1];
+    for (int i = 0; i < 4; i++) {
+        fake_hash(h[i], (char)('a' + i));
+        tx[0] = h[i];
+        block_cache_release(&c, block_cache_put_txids(&c, h[i], 10 + i, tx, 1));
+    }
+
+    ASSERT(block_cache_invalidate_from(&c, 12) == 2, "heights 12, 13 dropped");
+    block_cache_entry_t *e = block_cache_get(&c, h[1]);
+    ASSERT(e != NULL, "height 11 kept");
+    block_cache_release(&c, e);
+    ASSERT(block_cache_get(&c, h[2]) == NULL, "height 12 gone");
+    ASSERT(block_cache_get(&c, h[3]) == NULL, "height 13 gone");
+
+    block_cache_stats_t st;
+    block_cache_get_stats(&c, &st);
+    ASSERT(st.hits == 1 && st.misses == 2, "hit/miss counters");
+    ASSERT(st.invalidations == 2, "invalidation counter");
+    double pct = block_cache_hit_rate_pct(&st);
+    ASSERT(pct > 33.0 && pct < 34.0, "hit rate 1/3");
+    block_cache_free(&c);
+    return 1;
+}
@@ -236,7 +236,7 @@ int test_bridge_invoice_registry(void) {
     /* Look up non-existing */
     TEST_ASSERT(!lsp_channels_lookup_invoice(&mgr, hash3, &dest), "lookup unknown");
 
-    free(mgr.invoices);
+    lsp_channels_free_invoices(&mgr);
     return 1;
 }
 
@@ -377,7 +377,7 @@ int test_bridge_unknown_hash(void) {
     TEST_ASSERT_EQ(hid, 5, "fail htlc_id");
     cJSON_Delete(fail);
 
-    free(mgr.invoices);
+    lsp_channels_free_invoices(&mgr);
     return 1;
 }
 
@@ -570,8 +570,8 @@ int test_lsp_inbound_via_bridge(void) {
     cJSON_Delete(msg.json);
     close(sv[0]);
     close(sv[1]);
-    free(mgr.invoices);
-    free(mgr.htlc_origins);
+    lsp_channels_free_invoices(&mgr);
+    lsp_channels_free_bridge_origins(&mgr);
     return 1;
 }
 
@@ -662,7 +662,74 @@ int test_bridge_htlc_timeout(void) {
     close(sv[0]);
     close(sv[1]);
     free(mgr.entries);
-    free(mgr.htlc_origins);
+    lsp_channels_free_bridge_origins(&mgr);
+    return 1;
+}
+
+/* ---- Test 11b: bridge origin table grows, indexed lookups ---- */
+
+int test_bridge_origin_index(void) {
+    lsp_channel_mgr_t mgr;
+    memset(&mgr, 0, sizeof(mgr));
+    mgr.bridge_fd = -1;
+    mgr.htlc_origins = calloc(MAX_HTLC_ORIGINS, sizeof(htlc_origin_t));
+    mgr.htlc_origins_cap = MAX_HTLC_ORIGINS;
+
+    /* Well past the initial capacity */
+    const uint32_t n = 4 * MAX_HTLC_ORIGINS + 7;
+    unsigned char ph[32];
+    memset(ph, 0, 32);
+    for (uint32_t i = 0; i < n; i++) {
+        memcpy(ph, &i, sizeof(i));
+        htlc_origin_t *o = lsp_channels_track_bridge_origin(&mgr, ph, 1000 + i);
+        TEST_ASSERT(o != NULL, "track");
+        if (i % 3 == 0) {
+            o->request_id = 50000 + i;
+            lsp_channels_index_bridge_origin(&mgr, o);
+        }
+    }
+    TEST_ASSERT(mgr.htlc_origins_cap >= n, "origin table grew");
+
+    for (uint32_t i = 0; i < n; i += 17) {
+        memcpy(ph, &i, sizeof(i));
+        htlc_origin_t *o = lsp_channels_find_bridge_origin(&mgr, ph);
+        TEST_ASSERT(o && o->bridge_htlc_id == 1000 + i, "find by hash");
+    }
+    htlc_origin_t *r = lsp_channels_find_origin_by_request(&mgr, 50000 + 300);
+    TEST_ASSERT(r && r->bridge_htlc_id == 1300, "find by request_id");
+    TEST_ASSERT(lsp_channels_find_origin_by_request(&mgr, 50000 + 301) == NULL,
+                "no such request");
+
+    /* Consume the first half; the freed slots are reused before growing */
+    for (uint32_t i = 0; i < n / 2; i++) {
+        memcpy(ph, &i, sizeof(i));
+        TEST_ASSERT_EQ(lsp_channels_get_bridge_origin(&mgr, ph), 1000 + i,
+                       "consume origin");
+    }
+    size_t cap = mgr.htlc_origins_cap;
+    for (uint32_t i = n; i < n + n / 2; i++) {
+        memcpy(ph, &i, sizeof(i));
+        TEST_ASSERT(lsp_channels_track_bridge_origin(&mgr, ph, 1000 + i),
+                    "re-track");
+    }
+    TEST_ASSERT_EQ(mgr.htlc_origins_cap, cap, "slots reused, no growth");
+    memcpy(ph, &(uint32_t){5}, 4);
+    TEST_ASSERT(lsp_channels_find_bridge_origin(&mgr, ph) == NULL,
+                "consumed origin gone");
+    memcpy(ph, &(uint32_t){n + 3}, 4);
+    TEST_ASSERT(lsp_channels_find_bridge_origin(&mgr, ph) != NULL,
+                "reused slot found under new hash");
+
+    /* Directly appended origins (DB recovery path) are found lazily */
+    htlc_origin_t *d = &mgr.htlc_origins[mgr.n_htlc_origins++];
+    memset(d, 0, sizeof(*d));
+    memset(d->payment_hash, 0xEE, 32);
+    d->request_id = 777;
+    d->active = 1;
+    TEST_ASSERT(lsp_channels_find_origin_by_request(&mgr, 777) == d,
+                "direct append indexed");
+
+    lsp_channels_free_bridge_origins(&mgr);
     return 1;
 }
 
@@ -2662,8 +2729,8 @@ int test_bridge_keysend_inbound(void) {
     close(sv[0]);
     close(sv[1]);
     free(mgr.entries);
-    free(mgr.invoices);
-    free(mgr.htlc_origins);
+    lsp_channels_free_invoices(&mgr);
+    lsp_channels_free_bridge_origins(&mgr);
     secp256k1_context_destroy(ctx);
     return 1;
 }
@@ -0,0 +1,443 @@
+/*
+ * test_chain_events.c — Unit tests for the chain event bus
+ *
+ * CE1: test_chain_events_connect_order     — new blocks delivered once, in height order
+ * CE2: test_chain_events_fetch_once        — two body subscribers share one get_block per block
+ * CE3: test_chain_events_reorg_order       — disconnects tip..fork+1, then connects new branch
+ * CE4: test_chain_events_header_only       — no get_block: header-only events, no fetches
+ * CE5: test_chain_events_mempool_mask      — mempool push honours masks and unsubscribe
+ * CE6: test_chain_events_shared_cache      — second bus served from the block cache; reorg evicts
+ * CE7: test_chain_events_deep_rewind       — rewind past the window lands on the new tip
+ */
+
+#include "superscalar/chain_events.h"
+#include "superscalar/sha256.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+/* ------------------------------------------------------------------ */
+/* In-memory chain backend                                             */
+/* ------------------------------------------------------------------ */
+
+#define FAKE_MAX_HEIGHT 192
+#define FAKE_BLOCK_LEN  (80 + 1 + 61)
+
+typedef struct {
+    unsigned char blocks[FAKE_MAX_HEIGHT][FAKE_BLOCK_LEN];
+    unsigned char hashes[FAKE_MAX_HEIGHT][32];   /* internal order */
+    int           tip;
+    int           n_get_block;
+} fake_chain_t;
+
+static void hash_to_hex(const unsigned char h[32], char out[65])
+{
+    for (int i = 0; i < 32; i++)
+        sprintf(out + i * 2, "%02x", h[31 - i]);
+    out[64] = '\0';
+}
+
+/* Build block `height` on top of the current block at height-1.  `branch`
+   varies the coinbase so competing blocks get distinct hashes/txids. */
+static void fake_mine(fake_chain_t *fc, int height, uint8_t branch)
+{
+    unsigned char *b = fc->blocks[height];
+    memset(b, 0, FAKE_BLOCK_LEN);
+    b[0] = 1;                                     /* version */
+    if (height > 0)
+        memcpy(b + 4, fc->hashes[height - 1], 32); /* hashPrevBlock */
+    b[68] = (unsigned char)height;                 /* nTime */
+    b[76] = branch;                                /* nNonce */
+
+    unsigned char *tx = b + 81;
+    b[80] = 1;                  /* tx count */
+    tx[0] = 1;                  /* version */
+    tx[4] = 1;                  /* vin count */
+    memset(tx + 5, 0xff, 36);   /* null prevout */
+    tx[41] = 0;                 /* scriptSig len */
+    memset(tx + 42, 0xff, 4);   /* sequence */
+    tx[46] = 1;                 /* vout count */
+    tx[47] = (unsigned char)height;  /* value */
+    tx[48] = branch;
+    tx[55] = 1;                 /* spk len */
+    tx[56] = 0x51;              /* OP_TRUE */
+    /* locktime tx[57..60] = 0 */
+
+    sha256_double(b, 80, fc->hashes[height]);
+    fc->tip = height;
+}
+
+static int fake_get_block_height(chain_backend_t *self)
+{
+    return ((fake_chain_t *)self->ctx)->tip;
+}
+
+static int fake_get_block_hash(chain_backend_t *self, int height,
+                               char *hash_hex_out)
+{
+    fake_chain_t *fc = (fake_chain_t *)self->ctx;
+    if (height < 0 || height > fc->tip) return 0;
+    hash_to_hex(fc->hashes[height], hash_hex_out);
+    return 1;
+}
+
+static int fake_get_block(chain_backend_t *self, const char *hash_hex,
+                          unsigned char **block_out, size_t *block_len_out)
+{
+    fake_chain_t *fc = (fake_chain_t *)self->ctx;
+    for (int h = 0; h <= fc->tip; h++) {
+        char hx[65];
+        hash_to_hex(fc->hashes[h], hx);
+        if (strcmp(hx, hash_hex) != 0) continue;
+        *block_out = malloc(FAKE_BLOCK_LEN);
+        if (!*block_out) return 0;
+        memcpy(*block_out, fc->blocks[h], FAKE_BLOCK_LEN);
+        *block_len_out = FAKE_BLOCK_LEN;
+        fc->n_get_block++;
+        return 1;
+    }
+    return 0;
+}
+
+static void fake_backend_init(chain_backend_t *be, fake_chain_t *fc,
+                              int with_bodies)
+{
+    memset(be, 0, sizeof(*be));
+    be->get_block_height = fake_get_block_height;
+    be->get_block_hash   = fake_get_block_hash;
+    be->get_block        = with_bodies ? fake_get_block : NULL;
+    be->ctx              = fc;
+}
+
+/* Fake chains at equal heights produce identical blocks across tests, so
+   each test gets an empty cache instead of block_cache_shared(). */
+static block_cache_t *fresh_cache(void)
+{
+    static block_cache_t cache;
+    static int inited;
+    if (inited) block_cache_free(&cache);
+    inited = block_cache_init(&cache, 16);
+    return &cache;
+}
+
+/* ------------------------------------------------------------------ */
+/* Recording subscriber                                                */
+/* ------------------------------------------------------------------ */
+
+#define REC_MAX 64
+
+typedef struct {
+    int  n;
+    chain_event_type_t type[REC_MAX];
+    int  height[REC_MAX];
+    char hash[REC_MAX][65];
+    int  n_tx[REC_MAX];
+    int  has_body[REC_MAX];
+} recorder_t;
+
+static void record_cb(const chain_event_t *ev, void *ctx)
+{
+    recorder_t *r = (recorder_t *)ctx;
+    if (r->n >= REC_MAX) return;
+    r->type[r->n] = ev->type;
+    if (ev->block) {
+        r->height[r->n]   = ev->block->height;
+        memcpy(r->hash[r->n], ev->block->hash_hex, 65);
+        r->n_tx[r->n]     = (int)ev->block->n_tx;
+        r->has_body[r->n] = ev->block->parsed != NULL;
+    }
+    r->n++;
+}
+
+/* ------------------------------------------------------------------ */
+/* Tests                                                               */
+/* ------------------------------------------------------------------ */
+
+/* CE1: blocks mined after the first poll are delivered once each, ascending */
+int test_chain_events_connect_order(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    for (int h = 0; h <= 3; h++) fake_mine(&fc, h, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 1);
+    chain_events_t bus;
+    ASSERT(chain_events_init(&bus, &be, -1), "init");
+    chain_events_set_cache(&bus, fresh_cache());
+    recorder_t rec;
+    memset(&rec, 0, sizeof(rec));
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_ALL, 1, record_cb, &rec),
+           "subscribe");
+
+    ASSERT(chain_events_poll(&bus) == 0, "first poll anchors at tip");
+    ASSERT(chain_events_tip_height(&bus) == 3, "tip 3");
+    ASSERT(rec.n == 0, "no replay without start_height");
+
+    for (int h = 4; h <= 6; h++) fake_mine(&fc, h, 0);
+    ASSERT(chain_events_poll(&bus) == 3, "three blocks delivered");
+    ASSERT(rec.n == 3, "three events");
+    for (int i = 0; i < 3; i++) {
+        ASSERT(rec.type[i] == CHAIN_EVENT_BLOCK_CONNECTED, "connected");
+        ASSERT(rec.height[i] == 4 + i, "ascending heights");
+        ASSERT(rec.has_body[i] && rec.n_tx[i] == 1, "parsed body");
+    }
+    ASSERT(chain_events_poll(&bus) == 0, "idle poll delivers nothing");
+    ASSERT(rec.n == 3, "still three events");
+    return 1;
+}
+
+/* CE2: body fetched once per block regardless of subscriber count */
+int test_chain_events_fetch_once(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    for (int h = 0; h <= 2; h++) fake_mine(&fc, h, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 1);
+    chain_events_t bus;
+    ASSERT(chain_events_init(&bus, &be, 1), "init with replay from 1");
+    chain_events_set_cache(&bus, fresh_cache());
+    recorder_t a, b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_BLOCK_CONNECTED, 1,
+                                  record_cb, &a), "sub a");
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_BLOCK_CONNECTED, 1,
+                                  record_cb, &b), "sub b");
+
+    ASSERT(chain_events_poll(&bus) == 2, "replays heights 1..2");
+    ASSERT(a.n == 2 && b.n == 2, "both subscribers saw both blocks");
+    ASSERT(strcmp(a.hash[1], b.hash[1]) == 0, "same block delivered");
+    ASSERT(fc.n_get_block == 2, "one get_block per block");
+    ASSERT(bus.n_blocks_fetched == 2, "fetch counter");
+    return 1;
+}
+
+/* CE3: reorg replacing 4..5 with 4'..6' → DISC 5, DISC 4, CONN 4', 5', 6' */
+int test_chain_events_reorg_order(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    for (int h = 0; h <= 5; h++) fake_mine(&fc, h, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 1);
+    chain_events_t bus;
+    ASSERT(chain_events_init(&bus, &be, 4), "init");
+    chain_events_set_cache(&bus, fresh_cache());
+    recorder_t rec;
+    memset(&rec, 0, sizeof(rec));
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_ALL, 1, record_cb, &rec),
+           "subscribe");
+    ASSERT(chain_events_poll(&bus) == 2, "connect 4, 5");
+    char old4[65], old5[65];
+    memcpy(old4, rec.hash[0], 65);
+    memcpy(old5, rec.hash[1], 65);
+
+    for (int h = 4; h <= 6; h++) fake_mine(&fc, h, 1);
+    memset(&rec, 0, sizeof(rec));
+    ASSERT(chain_events_poll(&bus) == 5, "2 disconnects + 3 connects");
+
+    ASSERT(rec.type[0] == CHAIN_EVENT_BLOCK_DISCONNECTED && rec.height[0] == 5,
+           "disconnect old tip first");
+    ASSERT(strcmp(rec.hash[0], old5) == 0, "old 5 hash");
+    ASSERT(rec.type[1] == CHAIN_EVENT_BLOCK_DISCONNECTED && rec.height[1] == 4,
+           "then old 4");
+    ASSERT(strcmp(rec.hash[1], old4) == 0, "old 4 hash");
+    for (int i = 2; i < 5; i++) {
+        ASSERT(rec.type[i] == CHAIN_EVENT_BLOCK_CONNECTED, "connected");
+        ASSERT(rec.height[i] == 2 + i, "new branch ascending");
+    }
+    ASSERT(strcmp(rec.hash[2], old4) != 0, "new 4 differs");
+    ASSERT(chain_events_tip_height(&bus) == 6, "tip 6");
+
+    /* Same-height reorg: replace the tip only. */
+    fake_mine(&fc, 6, 2);
+    memset(&rec, 0, sizeof(rec));
+    ASSERT(chain_events_poll(&bus) == 2, "disconnect + connect at 6");
+    ASSERT(rec.type[0] == CHAIN_EVENT_BLOCK_DISCONNECTED && rec.height[0] == 6,
+           "same-height disconnect");
+    ASSERT(rec.type[1] == CHAIN_EVENT_BLOCK_CONNECTED && rec.height[1] == 6,
+           "same-height connect");
+    return 1;
+}
+
+/* CE4: backend without get_block yields header-only events */
+int test_chain_events_header_only(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    for (int h = 0; h <= 1; h++) fake_mine(&fc, h, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 0);
+    chain_events_t bus;
+    ASSERT(chain_events_init(&bus, &be, -1), "init");
+    chain_events_set_cache(&bus, fresh_cache());
+    recorder_t rec;
+    memset(&rec, 0, sizeof(rec));
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_BLOCK_CONNECTED, 1,
+                                  record_cb, &rec), "subscribe");
+    chain_events_poll(&bus);
+    fake_mine(&fc, 2, 0);
+    ASSERT(chain_events_poll(&bus) == 1, "one block");
+    ASSERT(rec.n == 1 && rec.height[0] == 2, "height 2");
+    ASSERT(!rec.has_body[0] && rec.n_tx[0] == 0, "header-only");
+    ASSERT(bus.n_blocks_fetched == 0, "no fetches");
+
+    chain_backend_t bare;
+    memset(&bare, 0, sizeof(bare));
+    bare.get_block_height = fake_get_block_height;
+    ASSERT(!chain_events_init(&bus, &bare, -1), "get_block_hash required");
+    return 1;
+}
+
+/* CE5: mempool pushes reach only subscribers whose mask includes them */
+int test_chain_events_mempool_mask(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    fake_mine(&fc, 0, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 1);
+    chain_events_t bus;
+    ASSERT(chain_events_init(&bus, &be, -1), "init");
+    chain_events_set_cache(&bus, fresh_cache());
+    recorder_t blocks_only, mempool;
+    memset(&blocks_only, 0, sizeof(blocks_only));
+    memset(&mempool, 0, sizeof(mempool));
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_BLOCK_CONNECTED, 0,
+                                  record_cb, &blocks_only), "sub blocks");
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_MEMPOOL_TX, 0,
+                                  record_cb, &mempool), "sub mempool");
+
+    char txid[65];
+    memset(txid, 'a', 64);
+    txid[64] = '\0';
+    chain_events_mempool_cb(txid, &bus);
+    ASSERT(mempool.n == 1 && mempool.type[0] == CHAIN_EVENT_MEMPOOL_TX,
+           "mempool subscriber notified");
+    ASSERT(blocks_only.n == 0, "block subscriber not notified");
+
+    ASSERT(chain_events_unsubscribe(&bus, record_cb, &mempool), "unsubscribe");
+    chain_events_push_mempool(&bus, txid);
+    ASSERT(mempool.n == 1, "no delivery after unsubscribe");
+    ASSERT(bus.n_mempool == 2, "counter");
+    ASSERT(!chain_events_unsubscribe(&bus, record_cb, &mempool),
+           "second unsubscribe misses");
+    return 1;
+}
+
+/* CE6: a second bus on the same cache reuses parsed bodies; a disconnect
+   drops the reorged-out block from the cache */
+int test_chain_events_shared_cache(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    for (int h = 0; h <= 3; h++) fake_mine(&fc, h, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 1);
+    block_cache_t *cache = fresh_cache();
+    chain_events_t a, b;
+    ASSERT(chain_events_init(&a, &be, 2), "init a");
+    ASSERT(chain_events_init(&b, &be, 2), "init b");
+    chain_events_set_cache(&a, cache);
+    chain_events_set_cache(&b, cache);
+    recorder_t ra, rb;
+    memset(&ra, 0, sizeof(ra));
+    memset(&rb, 0, sizeof(rb));
+    ASSERT(chain_events_subscribe(&a, CHAIN_EVENT_ALL, 1, record_cb, &ra), "sub a");
+    ASSERT(chain_events_subscribe(&b, CHAIN_EVENT_ALL, 1, record_cb, &rb), "sub b");
+
+    ASSERT(chain_events_poll(&a) == 2, "a connects 2, 3");
+    ASSERT(chain_events_poll(&b) == 2, "b connects 2, 3");
+    ASSERT(fc.n_get_block == 2, "b served from cache");
+    ASSERT(b.n_blocks_fetched == 0, "b downloaded nothing");
+    ASSERT(rb.has_body[1] && rb.n_tx[1] == 1, "b got parsed body");
+
+    char old3[65];
+    memcpy(old3, ra.hash[1], 65);
+    fake_mine(&fc, 3, 1);
+    memset(&ra, 0, sizeof(ra));
+    ASSERT(chain_events_poll(&a) == 2, "same-height reorg");
+    ASSERT(ra.type[0] == CHAIN_EVENT_BLOCK_DISCONNECTED && ra.has_body[0],
+           "disconnect carries cached body");
+
+    block_cache_entry_t *e = block_cache_get(cache, old3);
+    ASSERT(e == NULL, "reorged-out block invalidated");
+    block_cache_stats_t st;
+    block_cache_get_stats(cache, &st);
+    ASSERT(st.hits >= 2, "hits recorded");
+    return 1;
+}
+
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    int n_disc, n_conn, n_empty_hash;
+    int last_conn_height;
+} counter_t;
+
+static void count_cb(const chain_event_t *ev, void *ctx)
+{
+    counter_t *c = (counter_t *)ctx;
+    if (!ev->block) return;
+    if (!ev->block->hash_hex[0]) c->n_empty_hash++;
+    if (ev->type == CHAIN_EVENT_BLOCK_DISCONNECTED) c->n_disc++;
+    if (ev->type == CHAIN_EVENT_BLOCK_CONNECTED) {
+        c->n_conn++;
+        c->last_conn_height = ev->block->height;
+    }
+}
+
+/* CE7: the chain rewinds from 160 to 11' (deeper than REORG_DEPTH and
+   below the window) → every remembered block disconnected, then 11'
+   connected; later polls stay quiet */
+int test_chain_events_deep_rewind(void)
+{
+    static fake_chain_t fc;
+    memset(&fc, 0, sizeof(fc));
+    for (int h = 0; h <= 5; h++) fake_mine(&fc, h, 0);
+
+    chain_backend_t be;
+    fake_backend_init(&be, &fc, 0);
+    chain_events_t bus;
+    ASSERT(chain_events_init(&bus, &be, -1), "init");
+    counter_t cnt;
+    memset(&cnt, 0, sizeof(cnt));
+    ASSERT(chain_events_subscribe(&bus, CHAIN_EVENT_ALL, 0, count_cb, &cnt),
+           "subscribe");
+    ASSERT(chain_events_poll(&bus) == 0, "anchor at 5");
+
+    for (int h = 6; h <= 160; h++) fake_mine(&fc, h, 0);
+    while (chain_events_tip_height(&bus) < 160)
+        ASSERT(chain_events_poll(&bus) > 0, "catch up");
+    ASSERT(cnt.n_conn == 155, "6..160 connected");
+
+    fc.tip = 10;
+    fake_mine(&fc, 11, 1);
+    memset(&cnt, 0, sizeof(cnt));
+    ASSERT(chain_events_poll(&bus) == CHAIN_EVENTS_REORG_DEPTH + 1,
+           "window disconnected, new tip connected");
+    ASSERT(cnt.n_disc == CHAIN_EVENTS_REORG_DEPTH, "remembered blocks only");
+    ASSERT(cnt.n_conn == 1 && cnt.last_conn_height == 11, "11' connected");
+    ASSERT(cnt.n_empty_hash == 0, "no event without a hash");
+    ASSERT(chain_events_tip_height(&bus) == 11, "tip clamped to new chain");
+
+    ASSERT(chain_events_poll(&bus) == 0, "next poll quiet");
+    fake_mine(&fc, 12, 1);
+    ASSERT(chain_events_poll(&bus) == 1, "chain continues from 11'");
+    ASSERT(cnt.n_empty_hash == 0, "still no empty hashes");
+    return 1;
+}
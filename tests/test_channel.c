@@ -4326,6 +4326,89 @@ int test_channel_dynamic_growth(void) {
     return 1;
 }
 
+/* HTLC lookups at the BOLT #2 limit: id binary search, payment_hash index,
+   order-preserving removal, and a timeout pass that fails every expired
+   HTLC (not every other one). */
+int test_channel_htlc_index(void) {
+    channel_t ch;
+    memset(&ch, 0, sizeof(ch));
+    ch.local_amount = 500000000;
+    ch.remote_amount = 500000000;
+    ch.fee_rate_sat_per_kvb = 1000;
+    ch.funder_is_local = 1;
+
+    unsigned char pre[32], hash[32];
+    for (int i = 0; i < MAX_HTLCS; i++) {
+        memset(pre, 0, 32);
+        memcpy(pre, &i, sizeof(i));
+        sha256(pre, 32, hash);
+        uint64_t id;
+        TEST_ASSERT(channel_add_htlc(&ch, (i & 1) ? HTLC_RECEIVED : HTLC_OFFERED,
+                                       1000 + i, hash, 1000 + i, &id),
+                    "add htlc");
+        TEST_ASSERT_EQ(id, (uint64_t)i, "sequential id");
+    }
+    TEST_ASSERT(!channel_add_htlc(&ch, HTLC_OFFERED, 1000, hash, 1, NULL),
+                "refused past MAX_HTLCS");
+
+    for (int i = 0; i < MAX_HTLCS; i += 7) {
+        htlc_t *h = channel_find_htlc(&ch, (uint64_t)i);
+        TEST_ASSERT(h && h->amount_sats == (uint64_t)(1000 + i), "find by id");
+        memset(pre, 0, 32);
+        memcpy(pre, &i, sizeof(i));
+        sha256(pre, 32, hash);
+        htlc_direction_t dir = (i & 1) ? HTLC_RECEIVED : HTLC_OFFERED;
+        TEST_ASSERT(channel_find_htlc_by_hash(&ch, hash, dir) == h, "find by hash");
+        TEST_ASSERT(channel_find_htlc_by_hash(&ch, hash, !dir) == NULL,
+                    "hash lookup honours direction");
+    }
+    TEST_ASSERT(channel_find_htlc(&ch, MAX_HTLCS + 5) == NULL, "unknown id");
+
+    /* Fulfill every third HTLC, fail every third + 1 */
+    size_t left = MAX_HTLCS;
+    for (int i = 0; i < MAX_HTLCS; i++) {
+        memset(pre, 0, 32);
+        memcpy(pre, &i, sizeof(i));
+        if (i % 3 == 0) {
+            TEST_ASSERT(channel_fulfill_htlc(&ch, (uint64_t)i, pre), "fulfill");
+            left--;
+        } else if (i % 3 == 1) {
+            TEST_ASSERT(channel_fail_htlc(&ch, (uint64_t)i), "fail");
+            left--;
+        }
+    }
+    TEST_ASSERT_EQ(ch.n_htlcs, left, "resolved HTLCs removed");
+    for (size_t i = 0; i < ch.n_htlcs; i++) {
+        TEST_ASSERT_EQ(ch.htlcs[i].id % 3, 2, "only the unresolved remain");
+        if (i > 0)
+            TEST_ASSERT(ch.htlcs[i - 1].id < ch.htlcs[i].id, "id order kept");
+    }
+    int gone = 3;
+    memset(pre, 0, 32);
+    memcpy(pre, &gone, sizeof(gone));
+    sha256(pre, 32, hash);
+    TEST_ASSERT(channel_find_htlc_by_hash(&ch, hash, HTLC_RECEIVED) == NULL,
+                "resolved HTLC no longer indexed");
+    int kept = 5;
+    memset(pre, 0, 32);
+    memcpy(pre, &kept, sizeof(kept));
+    sha256(pre, 32, hash);
+    TEST_ASSERT(channel_find_htlc_by_hash(&ch, hash, HTLC_RECEIVED) ==
+                channel_find_htlc(&ch, 5), "survivor still indexed");
+
+    /* Remaining expiries are 1002, 1005, ...: all up to 1200 go at once */
+    size_t expected = 0;
+    for (size_t i = 0; i < ch.n_htlcs; i++)
+        if (ch.htlcs[i].cltv_expiry <= 1200) expected++;
+    TEST_ASSERT_EQ(channel_check_htlc_timeouts(&ch, 1200), (int)expected,
+                   "every expired HTLC failed");
+    TEST_ASSERT_EQ(ch.n_htlcs, left - expected, "expired removed");
+    TEST_ASSERT(ch.htlcs[0].cltv_expiry > 1200, "survivors unexpired");
+
+    channel_cleanup(&ch);
+    return 1;
+}
+
 /* Gap 3: Wrong HTLC preimage rejected by Bitcoin consensus.
    Bypasses the application-layer hash check (channel_fulfill_htlc) and writes
    a wrong preimage directly into h->payment_preimage. Builds the HTLC success
@@ -33,6 +33,7 @@ int test_cb_init(void)
            "default pending htlcs set");
     ASSERT(cb.default_max_pending_msat == CIRCUIT_BREAKER_DEFAULT_MAX_MSAT,
            "default pending msat set");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -53,6 +54,7 @@ int test_cb_check_add_accepts(void)
     ASSERT(circuit_breaker_get_peer_state(&cb, pk, &count, &msat), "state found");
     ASSERT(count == 1, "pending count = 1");
     ASSERT(msat == 1000000, "pending msat = 1000000");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -67,6 +69,7 @@ int test_cb_check_add_rejects_count(void)
     ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 1, "1st OK");
     ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 1, "2nd OK");
     ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 0, "3rd rejected (count full)");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -81,6 +84,7 @@ int test_cb_check_add_rejects_msat(void)
     circuit_breaker_set_peer_limits(&cb, pk, 100, 5000, 9999);
     ASSERT(circuit_breaker_check_add(&cb, pk, 3000, 0) == 1, "3000 msat OK");
     ASSERT(circuit_breaker_check_add(&cb, pk, 3000, 0) == 0, "6000 msat rejected");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -104,6 +108,7 @@ int test_cb_record_settled(void)
     circuit_breaker_get_peer_state(&cb, pk, &count, &msat);
     ASSERT(count == 1, "one pending after settle");
     ASSERT(msat == 1000000, "1M msat after settle");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -120,6 +125,7 @@ int test_cb_token_bucket_rate_limit(void)
     ASSERT(circuit_breaker_check_add(&cb, pk, 100, 0) == 1, "token 1 used");
     ASSERT(circuit_breaker_check_add(&cb, pk, 100, 0) == 1, "token 2 used");
     ASSERT(circuit_breaker_check_add(&cb, pk, 100, 0) == 0, "no tokens left");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -140,6 +146,7 @@ int test_cb_token_refill(void)
     /* Advance time by 1 hour → tokens refilled */
     ASSERT(circuit_breaker_check_add(&cb, pk, 0, CIRCUIT_BREAKER_SECS_PER_HOUR) == 1,
            "tokens refilled after 1 hour");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -210,6 +217,7 @@ int test_cb_unknown_peer_defaults(void)
     uint16_t count; uint64_t msat;
     ASSERT(circuit_breaker_get_peer_state(&cb, pk, &count, &msat), "peer created");
     ASSERT(count == 1, "pending count tracked");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -246,6 +254,7 @@ int test_cb_set_limits_clamp_tokens(void)
     /* Reduce limit to 5 — tokens should clamp */
     circuit_breaker_set_peer_limits(&cb, pk, 10, 0, 5);
     ASSERT(p->tokens == 5, "tokens clamped to new max=5");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -280,6 +289,7 @@ int test_cb_htlc_interceptor_iface(void)
     circuit_breaker_set_peer_limits(&cb, pk, 0, 0, 0);  /* all zeros = reject all */
     ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 0,
            "zero-limit peer always rejected = INTERCEPT_FAIL");
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -322,7 +332,7 @@ int test_cb_ban_fn_called_on_token_exhaustion(void)
     ASSERT(memcmp(g_ban_last_pubkey, pk, 33) == 0,
            "CB_BAN1: ban_fn called with correct pubkey");
     ASSERT(g_ban_duration == 600, "CB_BAN1: ban_duration_secs correct");
-
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -346,7 +356,7 @@ int test_cb_ban_fn_not_called_with_tokens(void)
                "CB_BAN2: HTLC accepted");
     }
     ASSERT(g_ban_call_count == 0, "CB_BAN2: ban_fn not called");
-
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -367,7 +377,7 @@ int test_cb_ban_fn_null_no_crash(void)
     /* Second HTLC with tokens=0, ban_fn=NULL → just return 0, no crash */
     ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 0,
            "CB_BAN3: null ban_fn + no tokens → 0, no crash");
-
+    circuit_breaker_free(&cb);
     return 1;
 }
 
@@ -391,6 +401,110 @@ int test_cb_ban_fn_repeated_exhaustion(void)
     ASSERT(circuit_breaker_check_add(&cb, pk, 500, 0) == 0, "rejected 2");
     ASSERT(circuit_breaker_check_add(&cb, pk, 500, 0) == 0, "rejected 3");
     ASSERT(g_ban_call_count == 3, "CB_BAN4: ban_fn called 3 times");
+    circuit_breaker_free(&cb);
+    return 1;
+}
+
+/* CB_HASH1: hundreds of peers, each tracked independently */
+int test_cb_many_peers(void)
+{
+    circuit_breaker_t cb;
+    circuit_breaker_init(&cb);
+    cb.default_max_pending_htlcs = 2;
+
+    /* Far more peers than the old fixed table held */
+    for (int i = 0; i < 1000; i++) {
+        unsigned char pk[33];
+        make_pubkey(pk, 0);
+        pk[1] = (unsigned char)(i >> 8);
+        pk[2] = (unsigned char)i;
+        ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 1, "1st OK");
+        ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 1, "2nd OK");
+        ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 0) == 0, "3rd rejected");
+    }
+    ASSERT(cb.n_live_peers == 1000, "1000 peers tracked");
+
+    unsigned char pk[33];
+    make_pubkey(pk, 0);
+    pk[1] = 3; pk[2] = 0xE7;   /* peer 999 */
+    uint16_t count; uint64_t msat;
+    ASSERT(circuit_breaker_get_peer_state(&cb, pk, &count, &msat), "peer 999 found");
+    ASSERT(count == 2 && msat == 2000, "peer 999 state");
+
+    /* Settle both on even peers; only those become evictable */
+    for (int i = 0; i < 1000; i += 2) {
+        pk[1] = (unsigned char)(i >> 8);
+        pk[2] = (unsigned char)i;
+        circuit_breaker_record_settled_ex(&cb, pk, 0, 1000, 10);
+        circuit_breaker_record_settled_ex(&cb, pk, 0, 1000, 10);
+    }
+    ASSERT(circuit_breaker_evict_idle(&cb, 10) == 0, "nothing idle yet");
+    ASSERT(circuit_breaker_evict_idle(&cb, 10 + CIRCUIT_BREAKER_IDLE_SECS) == 500,
+           "settled peers evicted");
+    ASSERT(cb.n_live_peers == 500, "500 peers left");
+    pk[1] = 3; pk[2] = 0xE7;
+    ASSERT(circuit_breaker_get_peer_state(&cb, pk, &count, NULL) && count == 2,
+           "peer with HTLCs in flight kept");
+    pk[2] = 0xE6;
+    ASSERT(!circuit_breaker_get_peer_state(&cb, pk, NULL, NULL), "idle peer gone");
+
+    /* Evicted slots are reused */
+    int slots = cb.n_peers;
+    ASSERT(circuit_breaker_check_add(&cb, pk, 1000, 20000) == 1, "re-admitted");
+    ASSERT(cb.n_peers == slots, "slot reused");
+    circuit_breaker_free(&cb);
+    return 1;
+}
+
+/* CB_HASH2: outgoing channel limits apply across peers */
+int test_cb_channel_limits(void)
+{
+    circuit_breaker_t cb;
+    circuit_breaker_init(&cb);
+    unsigned char a[33], b[33];
+    make_pubkey(a, 0xA1);
+    make_pubkey(b, 0xB2);
+
+    circuit_breaker_set_channel_limits(&cb, 777, 3, 5000, 100);
+    ASSERT(circuit_breaker_check_add_ex(&cb, a, 777, 2000, 0) == 1, "a: 2000");
+    ASSERT(circuit_breaker_check_add_ex(&cb, b, 777, 2000, 0) == 1, "b: 2000");
+    ASSERT(circuit_breaker_check_add_ex(&cb, b, 777, 2000, 0) == 0,
+           "channel value cap shared across peers");
+    ASSERT(circuit_breaker_check_add_ex(&cb, b, 778, 2000, 0) == 1,
+           "other channel unaffected");
+
+    uint16_t count;
+    circuit_breaker_get_peer_state(&cb, b, &count, NULL);
+    ASSERT(count == 2, "rejected HTLC not charged to peer");
+
+    circuit_breaker_record_settled_ex(&cb, a, 777, 2000, 0);
+    ASSERT(circuit_breaker_check_add_ex(&cb, b, 777, 2000, 0) == 1,
+           "room again after settle");
+    ASSERT(circuit_breaker_check_add_ex(&cb, a, 777, 1, 0) == 1, "third slot");
+    ASSERT(circuit_breaker_check_add_ex(&cb, a, 777, 1, 0) == 0,
+           "channel HTLC slots full");
+    circuit_breaker_free(&cb);
+    return 1;
+}
 
+/* CB_HASH3: tokens refill continuously, keeping fractional credit */
+int test_cb_lazy_refill(void)
+{
+    circuit_breaker_t cb;
+    circuit_breaker_init(&cb);
+    unsigned char pk[33]; make_pubkey(pk, 0xC3);
+
+    /* 4 per hour: one token every 900 s */
+    circuit_breaker_set_peer_limits(&cb, pk, 100, 0, 4);
+    for (int i = 0; i < 4; i++)
+        ASSERT(circuit_breaker_check_add(&cb, pk, 0, 1000) == 1, "initial tokens");
+    ASSERT(circuit_breaker_check_add(&cb, pk, 0, 1000) == 0, "exhausted");
+    ASSERT(circuit_breaker_check_add(&cb, pk, 0, 1899) == 0, "not yet");
+    ASSERT(circuit_breaker_check_add(&cb, pk, 0, 1900) == 1, "one token at +900s");
+    ASSERT(circuit_breaker_check_add(&cb, pk, 0, 1900) == 0, "only one");
+    /* 600 s + 600 s: the first partial credit is not lost */
+    ASSERT(circuit_breaker_check_add(&cb, pk, 0, 2500) == 0, "partial");
+    ASSERT(circuit_breaker_check_add(&cb, pk, 0, 2800) == 1, "credit carried");
+    circuit_breaker_free(&cb);
     return 1;
 }
@@ -9,6 +9,10 @@
  * CW6: test_cltv_watchdog_expire           — expire fails truly-expired HTLCs
  * CW7: test_cltv_watchdog_earliest_expiry  — returns lowest cltv_expiry of inbound HTLCs
  * CW8: test_cltv_watchdog_multi_htlc       — multiple HTLCs: correct at-risk count
+ * CW13: test_cltv_deadlines_heap           — node-wide heap: hooked adds, report once,
+ *                                            stale entries skipped, reorg guard
+ * CW14: test_cltv_deadlines_threads        — pushes from one thread while
+ *                                            another checks and expires
  */
 
 #include "superscalar/cltv_watchdog.h"
@@ -22,6 +26,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 /* ------------------------------------------------------------------ */
 /* Helpers                                                             */
@@ -482,6 +487,81 @@ int test_cltv_watchdog_block_connected_mixed(void)
     return 1;
 }
 
+/* ================================================================== */
+/* CW13 — node-wide deadline heap across two channels                  */
+/* ================================================================== */
+static void cw13_at_risk(void *ctx, channel_t *ch, const htlc_t *h)
+{
+    (void)ch; (void)h;
+    (*(int *)ctx)++;
+}
+
+int test_cltv_deadlines_heap(void)
+{
+    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN |
+                                                       SECP256K1_CONTEXT_VERIFY);
+    channel_t ch1, ch2;
+    ASSERT(cw_setup_channel(&ch1, ctx, 5000000, 5000000), "ch1 init");
+    ASSERT(cw_setup_channel(&ch2, ctx, 5000000, 5000000), "ch2 init");
+
+    /* Present before watching: picked up by the initial scan */
+    cw_inject_htlc(&ch1, HTLC_RECEIVED, 100000, 800030, 1);
+
+    cltv_deadlines_t dl;
+    cltv_deadlines_init(&dl, 0);
+    ASSERT(dl.expiry_delta == CLTV_EXPIRY_DELTA, "default delta");
+    ASSERT(cltv_deadlines_watch(&dl, &ch1), "watch ch1");
+    ASSERT(cltv_deadlines_watch(&dl, &ch2), "watch ch2");
+    ASSERT(cltv_deadlines_watch(&dl, &ch1), "watch ch1 again");
+    ASSERT(dl.n_chans == 2 && dl.n_pending == 1, "second watch is a no-op");
+
+    /* Added later: pushed by channel_add_htlc */
+    unsigned char hash_in[32], hash_out[32];
+    memset(hash_in, 0xA1, 32);
+    memset(hash_out, 0xA2, 32);
+    uint64_t id_in, id_out;
+    ASSERT(channel_add_htlc(&ch2, HTLC_RECEIVED, 10000, hash_in, 800010, &id_in),
+           "add inbound");
+    ASSERT(channel_add_htlc(&ch2, HTLC_OFFERED, 10000, hash_out, 800005, &id_out),
+           "add outbound");
+    ASSERT(dl.n_pending == 3, "hook pushed both");
+
+    int reported = 0;
+    ASSERT(cltv_deadlines_check(&dl, 799980, cw13_at_risk, &reported) == 0,
+           "nothing within delta");
+    /* 800005 is within delta but outbound: moved, not reported */
+    ASSERT(cltv_deadlines_check(&dl, 799990, cw13_at_risk, &reported) == 0,
+           "outbound not reported");
+    ASSERT(dl.n_at_risk == 1, "outbound moved to at_risk");
+    ASSERT(cltv_deadlines_check(&dl, 799995, cw13_at_risk, &reported) == 1,
+           "ch2 inbound reported");
+    ASSERT(cltv_deadlines_check(&dl, 799996, cw13_at_risk, &reported) == 0,
+           "reported once");
+    ASSERT(reported == 1, "callback fired once");
+
+    /* Resolved elsewhere: its entry is stale and skipped on expiry */
+    ASSERT(channel_fail_htlc(&ch2, id_in), "fail inbound");
+    ASSERT(cltv_deadlines_expire(&dl, 800010) == 1, "outbound expired");
+    ASSERT(ch2.n_htlcs == 0, "ch2 empty");
+    ASSERT(ch1.n_htlcs == 1, "ch1 untouched");
+
+    ASSERT(cltv_deadlines_check(&dl, 800012, cw13_at_risk, &reported) == 1,
+           "ch1 inbound reported");
+    ASSERT(cltv_deadlines_expire(&dl, 800000) == 0, "reorg: height went back");
+    ASSERT(cltv_deadlines_expire(&dl, 800030) == 1, "ch1 inbound expired");
+    ASSERT(ch1.n_htlcs == 0, "ch1 empty");
+    ASSERT(dl.n_pending == 0 && dl.n_at_risk == 0, "heaps drained");
+
+    cltv_deadlines_free(&dl);
+    ASSERT(ch1.cltv_deadlines == NULL && ch2.cltv_deadlines == NULL,
+           "free detaches channels");
+
+    channel_cleanup(&ch1);
+    channel_cleanup(&ch2);
+    secp256k1_context_destroy(ctx);
+    return 1;
+}
+
 /* ================================================================== */
 /* WT1 — watchtower_init + watchtower_check with no entries → 0       */
 /* ================================================================== */
@@ -600,3 +680,52 @@ int test_watchtower_oracular_pre_signed(void)
     watchtower_cleanup(&wt);
     return 1;
 }
+
+/* ================================================================== */
+/* CW14 — HTLCs pushed on one thread while blocks pop on another       */
+/* ================================================================== */
+#define CW14_N 20000
+
+typedef struct {
+    cltv_deadlines_t *dl;
+    channel_t        *ch;
+    int               failed;
+} cw14_pusher_t;
+
+static void *cw14_push(void *arg)
+{
+    cw14_pusher_t *p = arg;
+    for (uint32_t i = 0; i < CW14_N; i++)
+        if (!cltv_deadlines_add(p->dl, p->ch, i, 800000 + (i % 500)))
+            p->failed = 1;
+    return NULL;
+}
+
+int test_cltv_deadlines_threads(void)
+{
+    /* No HTLCs on the channel: every popped entry is stale and dropped */
+    channel_t ch;
+    memset(&ch, 0, sizeof(ch));
+    cltv_deadlines_t dl;
+    cltv_deadlines_init(&dl, 0);
+    ASSERT(cltv_deadlines_watch(&dl, &ch), "watch");
+
+    cw14_pusher_t p = { &dl, &ch, 0 };
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, cw14_push, &p) == 0, "thread");
+    for (uint32_t h = 799900; h < 800600; h++) {
+        cltv_deadlines_check(&dl, h, NULL, NULL);
+        cltv_deadlines_expire(&dl, h);
+    }
+    pthread_join(t, NULL);
+    ASSERT(!p.failed, "every push stored");
+
+    cltv_deadlines_check(&dl, 800600, NULL, NULL);
+    cltv_deadlines_expire(&dl, 800600);
+    ASSERT(dl.n_pending == 0 && dl.n_at_risk == 0, "heaps drained");
+
+    cltv_deadlines_free(&dl);
+    ASSERT(ch.cltv_deadlines == NULL, "free detaches the channel");
+    ASSERT(dl.expiry_delta == 0, "free leaves the set uninitialised");
+    return 1;
+}
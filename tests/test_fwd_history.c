@@ -28,6 +28,7 @@ int test_fwd_history_init(void)
     ASSERT(h.count == 0, "count = 0 after init");
     ASSERT(h.total_settled == 0, "total_settled = 0");
     ASSERT(h.total_failed == 0, "total_failed = 0");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -40,6 +41,7 @@ int test_fwd_history_add_settled(void)
     ASSERT(h.count == 1, "count = 1");
     ASSERT(h.total_settled == 1, "total_settled = 1");
     ASSERT(h.entries[0].fee_msat == 10000, "fee_msat = 10000");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -51,6 +53,7 @@ int test_fwd_history_add_failed(void)
     fwd_history_add(&h, 100, 200, 50000, 50000, NOW, zero_hash, FWD_STATUS_FAILED);
     ASSERT(h.total_failed == 1, "total_failed = 1");
     ASSERT(h.entries[0].fee_msat == 0, "no fee for failed");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -69,6 +72,7 @@ int test_fwd_history_fee_total(void)
     /* Time range filter */
     uint64_t half = fwd_history_fee_total(&h, NOW + 50, 0);
     ASSERT(half == 20000, "fee from t+50 = 20000");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -88,6 +92,7 @@ int test_fwd_history_volume(void)
     /* Only scid_out=10 */
     uint64_t chan10 = fwd_history_volume(&h, 10, 0, 0);
     ASSERT(chan10 == 300000, "chan10 volume = 300000");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -104,6 +109,7 @@ int test_fwd_history_count(void)
     ASSERT(fwd_history_count(&h, 5, 0, 0) == 2, "scid_in=5 settled count = 2");
     ASSERT(fwd_history_count(&h, 6, 0, 0) == 1, "scid_in=6 settled count = 1");
     ASSERT(fwd_history_count(&h, 0, 0, 0) == 3, "all settled = 3");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -122,6 +128,8 @@ int test_fwd_history_avg_fee(void)
     fwd_history_t h2;
     fwd_history_init(&h2);
     ASSERT(fwd_history_avg_fee(&h2, 0, 0) == 0, "empty → 0");
+    fwd_history_free(&h);
+    fwd_history_free(&h2);
     return 1;
 }
 
@@ -141,6 +149,7 @@ int test_fwd_history_top_channel(void)
     uint64_t top = fwd_history_top_channel(&h, 0, 0, &si, &so);
     ASSERT(top == 3000, "top fee = 3000");
     ASSERT(si == 100 && so == 200, "top pair = (100, 200)");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -157,6 +166,7 @@ int test_fwd_history_prune(void)
     ASSERT(pruned == 1, "1 entry pruned");
     ASSERT(h.count == 1, "1 entry remains");
     ASSERT(h.entries[0].resolved_at == NOW + 100, "recent entry kept");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -172,6 +182,7 @@ int test_fwd_history_ring_wrap(void)
                          100000, 99000, NOW + i, zero_hash, FWD_STATUS_SETTLED);
     }
     ASSERT(h.count == FWD_HISTORY_MAX, "count caps at FWD_HISTORY_MAX");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -184,6 +195,7 @@ int test_fwd_history_range_all(void)
     fwd_history_add(&h, 1, 2, 101000, 100000, UINT32_MAX, zero_hash, FWD_STATUS_SETTLED);
     uint64_t total = fwd_history_fee_total(&h, 0, 0);
     ASSERT(total == 2000, "range [0,0] includes all entries");
+    fwd_history_free(&h);
     return 1;
 }
 
@@ -197,9 +209,72 @@ int test_fwd_history_null_safety(void)
     fwd_history_count(NULL, 0, 0, 0);
     fwd_history_avg_fee(NULL, 0, 0);
     fwd_history_prune(NULL, 0);
+    fwd_history_free(NULL);
     /* top_channel with NULL */
     fwd_history_top_channel(NULL, 0, 0, NULL, NULL);
     fwd_history_t h; fwd_history_init(&h);
     fwd_history_top_channel(&h, 0, 0, NULL, NULL);  /* empty + NULL outs → ok */
+    fwd_history_free(&h);
+    return 1;
+}
+
+/* FH13: rollups answer windowed and per-pair queries across tiers */
+int test_fwd_history_rollup_windows(void)
+{
+    fwd_history_t h;
+    fwd_history_init(&h);
+    const uint32_t day0 = NOW / 86400 * 86400;
+
+    /* One settled forward per minute for 30 days: 43200 forwards, far more
+     * than the ring holds.  Pairs alternate (1,2) / (3,2); every tenth
+     * forward out of channel 2 fails instead. */
+    uint32_t n = 30 * 1440;
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t in = (i & 1) ? 3 : 1;
+        fwd_status_t st = (i % 10 == 9) ? FWD_STATUS_FAILED : FWD_STATUS_SETTLED;
+        fwd_history_add(&h, in, 2, 101000, 100000, day0 + i * 60,
+                        zero_hash, st);
+    }
+    uint64_t settled = n - n / 10;
+    ASSERT(h.count == FWD_HISTORY_MAX, "ring capped");
+    ASSERT(fwd_history_fee_total(&h, 0, 0) == settled * 1000, "all-time fees");
+    ASSERT(fwd_history_volume(&h, 2, 0, 0) == settled * 100000, "all-time volume");
+
+    /* Minute tier: the last 10 minutes */
+    uint32_t last = day0 + (n - 1) * 60;
+    fwd_rollup_t r;
+    ASSERT(fwd_history_stats(&h, 0, 0, last - 9 * 60, 0, &r), "node series");
+    ASSERT(r.n_settled + r.n_failed == 10, "10 forwards in last 10 min");
+    ASSERT(r.n_failed == 1, "one failure in last 10 min");
+
+    /* Hour tier: day 5 in full, then a window starting mid-hour */
+    uint32_t d5 = day0 + 5 * 86400;
+    ASSERT(fwd_history_stats(&h, 0, 0, d5, d5 + 86399, &r), "day 5");
+    ASSERT(r.n_settled + r.n_failed == 1440, "1440 forwards on day 5");
+    ASSERT(r.fee_msat == r.n_settled * 1000, "fee per settle");
+    fwd_history_stats(&h, 0, 0, d5 + 1800, d5 + 7199, &r);
+    ASSERT(r.n_settled + r.n_failed == 60, "hour-tier edges snap to hours");
+
+    /* Per pair and per side */
+    fwd_rollup_t p1, p3;
+    ASSERT(fwd_history_stats(&h, 1, 2, d5, d5 + 86399, &p1), "pair (1,2)");
+    ASSERT(fwd_history_stats(&h, 3, 2, d5, d5 + 86399, &p3), "pair (3,2)");
+    ASSERT(p1.n_settled + p1.n_failed == 720, "pair (1,2) half the traffic");
+    ASSERT(p1.n_failed + p3.n_failed == 144, "failures split across pairs");
+    ASSERT(fwd_history_count(&h, 3, d5, d5 + 86399) == (int)p3.n_settled,
+           "count matches inbound side");
+    ASSERT(fwd_history_failure_rate_ppm(&h, 2, 0, 0) == 100000,
+           "10% failure rate out of channel 2");
+    ASSERT(!fwd_history_stats(&h, 9, 9, 0, 0, &r), "unknown pair");
+
+    uint64_t si, so;
+    uint64_t top = fwd_history_top_channel(&h, d5, d5 + 86399, &si, &so);
+    ASSERT(top == (p1.fee_msat > p3.fee_msat ? p1.fee_msat : p3.fee_msat),
+           "top pair by window fee");
+
+    /* Minute buckets older than a day are gone; hour buckets remain */
+    ASSERT(h.n_buckets < 6u * (FWD_ROLLUP_MINUTE_KEEP + 30 * 24 + 31),
+           "buckets bounded by retention");
+    fwd_history_free(&h);
     return 1;
 }
@@ -131,6 +131,7 @@ int test_gossip_ingest_channel_ann_ok(void)
 
     gossip_store_close(&gs);
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -163,6 +164,7 @@ int test_gossip_ingest_channel_ann_bad_sig(void)
     ASSERT(gi.n_rejected_sig == 1, "n_rejected_sig == 1");
 
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -205,6 +207,7 @@ int test_gossip_ingest_node_ann_ok(void)
 
     gossip_store_close(&gs);
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -236,6 +239,7 @@ int test_gossip_ingest_node_ann_bad_sig(void)
     ASSERT(gi.n_rejected_sig == 1, "n_rejected_sig == 1");
 
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -290,6 +294,7 @@ int test_gossip_ingest_chan_update_ok(void)
 
     gossip_store_close(&gs);
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -335,6 +340,7 @@ int test_gossip_ingest_chan_update_bad_sig(void)
 
     gossip_store_close(&gs);
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -369,6 +375,7 @@ int test_gossip_ingest_chan_update_orphan(void)
 
     gossip_store_close(&gs);
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -395,12 +402,16 @@ int test_gossip_ingest_rate_limit(void)
     int r1 = gossip_ingest_node_announcement(&gi, msg, len, NOW);
     ASSERT(r1 == GOSSIP_INGEST_NO_VERIFY, "first accepted (no verify)");
 
-    /* Second ingest within interval — rate limited */
+    /* Newer announcement within interval — rate limited */
+    len = gossip_build_node_announcement(
+        msg, sizeof(msg), ctx, priv, NOW + 30, rgb, "RateTest", NULL, 0);
+    ASSERT(len > 0, "built second");
     int r2 = gossip_ingest_node_announcement(&gi, msg, len, NOW + 30);
     ASSERT(r2 == GOSSIP_INGEST_RATE_LIMITED, "GI8: rate limited");
     ASSERT(gi.n_rejected_rate == 1, "n_rejected_rate == 1");
 
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -426,13 +437,19 @@ int test_gossip_ingest_rate_limit_expired(void)
     /* First ingest */
     gossip_ingest_node_announcement(&gi, msg, len, NOW);
 
-    /* Ingest after interval expires — should be accepted */
+    /* Newer announcement after interval expires — should be accepted
+     * (re-sending the identical one would be answered by the seen cache) */
+    len = gossip_build_node_announcement(
+        msg, sizeof(msg), ctx, priv, NOW + GOSSIP_INGEST_MIN_INTERVAL + 1,
+        rgb, "RateExp", NULL, 0);
+    ASSERT(len > 0, "built second");
     int r = gossip_ingest_node_announcement(&gi, msg, len,
                                              NOW + GOSSIP_INGEST_MIN_INTERVAL + 1);
     ASSERT(r == GOSSIP_INGEST_NO_VERIFY, "GI9: rate limit expired, accepted");
     ASSERT(gi.n_rejected_rate == 0, "no rate rejections");
 
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -461,6 +478,7 @@ int test_gossip_ingest_timestamp_filter(void)
     ASSERT(memcmp(chain, GOSSIP_CHAIN_HASH_MAINNET, 32) == 0, "chain_hash matches");
     ASSERT(first == 1700000000u, "first_timestamp correct");
     ASSERT(rng == 86400u, "range correct");
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -494,6 +512,7 @@ int test_gossip_ingest_message_dispatch(void)
     ASSERT(r == GOSSIP_INGEST_UNKNOWN_TYPE, "unknown type handled");
 
     secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -527,6 +546,7 @@ int test_gossip_ingest_malformed(void)
     r = gossip_ingest_timestamp_filter(&gi, short_ts, sizeof(short_ts), NULL, NULL, NULL);
     ASSERT(r == GOSSIP_INGEST_MALFORMED, "truncated timestamp_filter → malformed");
 
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -626,3 +646,348 @@ int test_ge_en2_enumerate_empty(void)
     gossip_store_close(&gs);
     return 1;
 }
+
+/* ================================================================== */
+/* Live routing graph fed by ingest                                   */
+/* ================================================================== */
+
+/* Unsigned channel_update (type 258) with optional htlc_maximum_msat. */
+static size_t build_raw_chan_update(unsigned char *out, uint64_t scid,
+                                    uint32_t ts, uint8_t chan_flags,
+                                    uint32_t fee_base, uint32_t fee_ppm,
+                                    uint64_t htlc_max)
+{
+    memset(out, 0, 138);
+    out[0] = 0x01; out[1] = 0x02;
+    for (int i = 0; i < 8; i++) out[98 + i]  = (unsigned char)(scid >> (56 - 8 * i));
+    for (int i = 0; i < 4; i++) out[106 + i] = (unsigned char)(ts >> (24 - 8 * i));
+    out[110] = htlc_max ? 0x01 : 0x00;
+    out[111] = chan_flags;
+    out[113] = 40;                                   /* cltv_expiry_delta */
+    out[121] = 1;                                    /* htlc_minimum_msat */
+    for (int i = 0; i < 4; i++) out[122 + i] = (unsigned char)(fee_base >> (24 - 8 * i));
+    for (int i = 0; i < 4; i++) out[126 + i] = (unsigned char)(fee_ppm  >> (24 - 8 * i));
+    if (!htlc_max) return 130;
+    for (int i = 0; i < 8; i++) out[130 + i] = (unsigned char)(htlc_max >> (56 - 8 * i));
+    return 138;
+}
+
+/* GI_G1: announcement + updates land in the attached graph immediately;
+ * a disable bit and a closure take effect on the next route. */
+int test_gossip_ingest_updates_live_graph(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "GI_G1: open gs");
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "GI_G1: graph");
+
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, &gs);
+    gi.graph = g;
+
+    unsigned char n1[33], n2[33], b1[33], b2[33];
+    memset(n1, 0x02, 33); n1[1] = 0x11;
+    memset(n2, 0x03, 33); n2[1] = 0x22;
+    memset(b1, 0x02, 33); b1[1] = 0x33;
+    memset(b2, 0x02, 33); b2[1] = 0x44;
+    uint64_t scid = ((uint64_t)700002 << 40) | 5;
+
+    unsigned char ann[512];
+    size_t ann_len = gossip_build_channel_announcement_unsigned(
+        ann, sizeof(ann), GOSSIP_CHAIN_HASH_MAINNET, scid, n1, n2, b1, b2);
+    ASSERT(gossip_ingest_channel_announcement(&gi, ann, ann_len, NOW)
+           == GOSSIP_INGEST_NO_VERIFY, "announcement accepted");
+    ASSERT(pathfind_graph_get_channel(g, scid, NULL, NULL, NULL), "channel in graph");
+
+    unsigned char upd[138];
+    size_t ul = build_raw_chan_update(upd, scid, NOW, 0x00, 7, 11, 5000000);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW)
+           == GOSSIP_INGEST_NO_VERIFY, "update accepted");
+
+    pathfind_route_t r;
+    ASSERT(pathfind_graph_route(g, n1, n2, 1000, &r), "routable after update");
+    ASSERT(r.hops[0].fee_base_msat == 7 && r.hops[0].fee_ppm == 11, "policy applied");
+    ASSERT(r.hops[0].htlc_max_msat == 5000000, "htlc_maximum_msat applied");
+    ASSERT(!pathfind_graph_route(g, n2, n1, 1000, &r), "reverse has no policy yet");
+
+    /* Disable bit (after the rate-limit window). */
+    ul = build_raw_chan_update(upd, scid, NOW + 61, 0x02, 7, 11, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 61)
+           == GOSSIP_INGEST_NO_VERIFY, "disable accepted");
+    ASSERT(!pathfind_graph_route(g, n1, n2, 1000, &r), "disabled edge skipped");
+
+    ul = build_raw_chan_update(upd, scid, NOW + 122, 0x00, 9, 11, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 122)
+           == GOSSIP_INGEST_NO_VERIFY, "re-enable accepted");
+    ASSERT(pathfind_graph_route(g, n1, n2, 1000, &r) && r.hops[0].fee_base_msat == 9,
+           "re-enabled with new fee");
+
+    gossip_ingest_channel_closed(&gi, scid, NOW + 200);
+    ASSERT(!pathfind_graph_get_channel(g, scid, NULL, NULL, NULL), "closed: gone");
+    ASSERT(!pathfind_graph_route(g, n1, n2, 1000, &r), "closed: no route");
+
+    pathfind_graph_free(g);
+    gossip_store_close(&gs);
+    gossip_ingest_free(&gi);
+    return 1;
+}
+
+/* GI_G2: a channel already in the store when the graph is attached is
+ * seeded from the store on its next channel_update. */
+int test_gossip_ingest_graph_seeds_from_store(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "GI_G2: open gs");
+
+    unsigned char n1[33], n2[33];
+    memset(n1, 0x02, 33); n1[1] = 0x55;
+    memset(n2, 0x03, 33); n2[1] = 0x66;
+    uint64_t scid = ((uint64_t)700003 << 40) | 2;
+    gossip_store_upsert_channel(&gs, scid, n1, n2, 0, NOW);
+
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "GI_G2: graph");
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, &gs);
+    gi.graph = g;
+
+    unsigned char upd[138];
+    size_t ul = build_raw_chan_update(upd, scid, NOW, 0x01, 3, 4, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW)
+           == GOSSIP_INGEST_NO_VERIFY, "update accepted");
+
+    unsigned char g1[33], g2[33];
+    ASSERT(pathfind_graph_get_channel(g, scid, g1, g2, NULL), "seeded from store");
+    ASSERT(memcmp(g1, n1, 33) == 0 && memcmp(g2, n2, 33) == 0, "endpoints");
+    pathfind_route_t r;
+    ASSERT(pathfind_graph_route(g, n2, n1, 1000, &r), "direction 1 routable");
+
+    pathfind_graph_free(g);
+    gossip_store_close(&gs);
+    gossip_ingest_free(&gi);
+    return 1;
+}
+
+/* ================================================================== */
+/* Batch ingest                                                       */
+/* ================================================================== */
+
+/* GI_B1: newest channel_update per direction wins, superseded copies and
+ * re-announcements are DUPLICATE, an update ahead of its announcement in
+ * the same batch is accepted, and the store + graph see the result. */
+int test_gossip_ingest_batch_dedupe(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "GI_B1: open gs");
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "GI_B1: graph");
+
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, &gs);
+    gi.graph = g;
+
+    unsigned char n1[33], n2[33], b1[33], b2[33];
+    memset(n1, 0x02, 33); n1[1] = 0x71;
+    memset(n2, 0x03, 33); n2[1] = 0x72;
+    memset(b1, 0x02, 33); b1[1] = 0x73;
+    memset(b2, 0x02, 33); b2[1] = 0x74;
+    uint64_t scid = ((uint64_t)700010 << 40) | 1;
+
+    unsigned char ann[512];
+    size_t ann_len = gossip_build_channel_announcement_unsigned(
+        ann, sizeof(ann), GOSSIP_CHAIN_HASH_MAINNET, scid, n1, n2, b1, b2);
+    ASSERT(ann_len >= 432, "built announcement");
+
+    unsigned char u_old[138], u_new[138], u_mid[138], u_rev[138], u_orph[138];
+    size_t l_old  = build_raw_chan_update(u_old,  scid, NOW,     0x00, 1, 1, 0);
+    size_t l_new  = build_raw_chan_update(u_new,  scid, NOW + 5, 0x00, 5, 5, 0);
+    size_t l_mid  = build_raw_chan_update(u_mid,  scid, NOW + 2, 0x00, 2, 2, 0);
+    size_t l_rev  = build_raw_chan_update(u_rev,  scid, NOW,     0x01, 9, 9, 0);
+    size_t l_orph = build_raw_chan_update(u_orph, scid + 1, NOW, 0x00, 1, 1, 0);
+    unsigned char junk[3] = { 0x01, 0x02, 0x00 };
+
+    const unsigned char *msgs[] = { u_old, ann, u_new, u_mid, ann, u_rev, u_orph, junk };
+    size_t lens[] = { l_old, ann_len, l_new, l_mid, ann_len, l_rev, l_orph, sizeof(junk) };
+    int res[8];
+    size_t acc = gossip_ingest_batch(&gi, msgs, lens, 8, NOW, res);
+
+    ASSERT(acc == 3, "announcement + one update per direction accepted");
+    ASSERT(res[0] == GOSSIP_INGEST_DUPLICATE, "oldest update superseded");
+    ASSERT(res[1] == GOSSIP_INGEST_NO_VERIFY, "announcement stored");
+    ASSERT(res[2] == GOSSIP_INGEST_NO_VERIFY, "newest update stored");
+    ASSERT(res[3] == GOSSIP_INGEST_DUPLICATE, "middle update superseded");
+    ASSERT(res[4] == GOSSIP_INGEST_DUPLICATE, "repeated announcement");
+    ASSERT(res[5] == GOSSIP_INGEST_NO_VERIFY, "reverse direction stored");
+    ASSERT(res[6] == GOSSIP_INGEST_ORPHAN, "unknown channel orphaned");
+    ASSERT(res[7] == GOSSIP_INGEST_MALFORMED, "short message malformed");
+    ASSERT(gi.n_rejected_dup == 3, "dup counter");
+    ASSERT(gi.n_channel_ann == 1 && gi.n_chan_update == 2, "accept counters");
+
+    uint32_t fb, fp, ts; uint16_t cd;
+    ASSERT(gossip_store_get_channel_update(&gs, scid, 0, &fb, &fp, &cd, &ts),
+           "policy in store");
+    ASSERT(fb == 5 && fp == 5, "newest policy stored");
+    pathfind_route_t r;
+    ASSERT(pathfind_graph_route(g, n1, n2, 1000, &r), "graph routable");
+    ASSERT(r.hops[0].fee_base_msat == 5, "graph has newest policy");
+    ASSERT(pathfind_graph_route(g, n2, n1, 1000, &r) &&
+           r.hops[0].fee_base_msat == 9, "graph has reverse policy");
+
+    /* A later batch re-announcing the channel skips it outright. */
+    const unsigned char *again[] = { ann };
+    size_t again_len[] = { ann_len };
+    ASSERT(gossip_ingest_batch(&gi, again, again_len, 1, NOW + 100, res) == 0,
+           "known channel not re-stored");
+    ASSERT(res[0] == GOSSIP_INGEST_DUPLICATE, "known channel duplicate");
+
+    pathfind_graph_free(g);
+    gossip_store_close(&gs);
+    gossip_ingest_free(&gi);
+    return 1;
+}
+
+/* GI_B2: signatures checked on the worker pool give the same verdicts as
+ * ingesting the messages one at a time; forged ones are rejected. */
+int test_gossip_ingest_batch_matches_serial(void)
+{
+    secp256k1_context *ctx = secp256k1_context_create(
+        SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+
+    enum { N_CHAN = 40, N_MSG = N_CHAN * 3 };
+    unsigned char *buf = (unsigned char *)calloc(N_MSG, 512);
+    ASSERT(buf != NULL, "alloc");
+    const unsigned char *msgs[N_MSG];
+    size_t lens[N_MSG];
+    int forged[N_MSG];
+
+    for (int c = 0; c < N_CHAN; c++) {
+        unsigned char n1p[32], n2p[32], b1p[32], b2p[32];
+        memset(n1p, 0x11, 32); n1p[31] = (unsigned char)(c + 1);
+        memset(n2p, 0x22, 32); n2p[31] = (unsigned char)(c + 1);
+        memset(b1p, 0x33, 32); b1p[31] = (unsigned char)(c + 1);
+        memset(b2p, 0x44, 32); b2p[31] = (unsigned char)(c + 1);
+        uint64_t scid = ((uint64_t)(710000 + c) << 40) | 1;
+
+        unsigned char *ann = buf + (size_t)(3 * c) * 512;
+        lens[3 * c] = build_signed_channel_ann(ctx, ann, 512,
+                                               n1p, n2p, b1p, b2p, scid);
+        for (int d = 0; d < 2; d++) {
+            unsigned char *u = buf + (size_t)(3 * c + 1 + d) * 512;
+            lens[3 * c + 1 + d] = gossip_build_channel_update(
+                u, 512, ctx, d ? n2p : n1p, GOSSIP_CHAIN_HASH_MAINNET,
+                scid, NOW, 0, (uint8_t)d, 40, 1000, 100 + (uint32_t)c, 10, 0);
+        }
+    }
+    for (int i = 0; i < N_MSG; i++) {
+        msgs[i] = buf + (size_t)i * 512;
+        forged[i] = (i % 7 == 3);
+        if (forged[i]) ((unsigned char *)msgs[i])[10] ^= 0x5a;
+    }
+
+    gossip_store_t gs_a, gs_b;
+    ASSERT(gossip_store_open_in_memory(&gs_a), "open a");
+    ASSERT(gossip_store_open_in_memory(&gs_b), "open b");
+    gossip_ingest_t serial, batch;
+    gossip_ingest_init(&serial, ctx, &gs_a);
+    gossip_ingest_init(&batch,  ctx, &gs_b);
+
+    int want[N_MSG], got[N_MSG];
+    for (int i = 0; i < N_MSG; i++)
+        want[i] = gossip_ingest_message(&serial, msgs[i], lens[i], NOW);
+    size_t acc = gossip_ingest_batch(&batch, msgs, lens, N_MSG, NOW, got);
+
+    size_t want_acc = 0;
+    for (int i = 0; i < N_MSG; i++) {
+        ASSERT(got[i] == want[i], "batch verdict matches serial");
+        if (forged[i])
+            ASSERT(got[i] == GOSSIP_INGEST_BAD_SIG ||
+                   got[i] == GOSSIP_INGEST_ORPHAN, "forged message rejected");
+        if (want[i] == GOSSIP_INGEST_OK) want_acc++;
+    }
+    ASSERT(acc == want_acc, "accepted count matches");
+    ASSERT(batch.n_rejected_sig == serial.n_rejected_sig, "sig rejects match");
+    ASSERT(batch.n_channel_ann == serial.n_channel_ann &&
+           batch.n_chan_update == serial.n_chan_update, "accept counters match");
+    ASSERT(want[0] == GOSSIP_INGEST_OK && want[1] == GOSSIP_INGEST_OK,
+           "signed messages accepted");
+
+    gossip_store_close(&gs_a);
+    gossip_store_close(&gs_b);
+    free(buf);
+    secp256k1_context_destroy(ctx);
+    gossip_ingest_free(&serial);
+    gossip_ingest_free(&batch);
+    return 1;
+}
+
+/* GI_C1: the seen cache answers relayed copies and stale channel_updates
+ * without reprocessing, remembers forgeries, and stays bounded. */
+int test_gossip_ingest_seen_cache(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "GI_C1: open gs");
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, &gs);
+
+    unsigned char n1[33], n2[33];
+    memset(n1, 0x02, 33); n1[1] = 0x81;
+    memset(n2, 0x03, 33); n2[1] = 0x82;
+    uint64_t scid = ((uint64_t)700020 << 40) | 1;
+    gossip_store_upsert_channel(&gs, scid, n1, n2, 0, NOW);
+
+    unsigned char upd[138];
+    size_t ul = build_raw_chan_update(upd, scid, NOW, 0x00, 5, 5, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW)
+           == GOSSIP_INGEST_NO_VERIFY, "first copy stored");
+    ASSERT(gi.n_seen_miss == 1 && gi.n_seen_hit == 0, "first is a miss");
+
+    /* Same update relayed by another peer, outside the rate window. */
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 100)
+           == GOSSIP_INGEST_DUPLICATE, "relayed copy is a duplicate");
+    ASSERT(gi.n_seen_hit == 1, "hit counted");
+
+    /* Different bytes but older timestamp: stale. */
+    ul = build_raw_chan_update(upd, scid, NOW - 10, 0x00, 7, 7, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 200)
+           == GOSSIP_INGEST_DUPLICATE, "older update dropped");
+    uint32_t fb, fp, ts; uint16_t cd;
+    ASSERT(gossip_store_get_channel_update(&gs, scid, 0, &fb, &fp, &cd, &ts) &&
+           fb == 5, "store keeps the newer policy");
+
+    ul = build_raw_chan_update(upd, scid, NOW + 300, 0x00, 9, 9, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 300)
+           == GOSSIP_INGEST_NO_VERIFY, "newer update stored");
+    ASSERT(gi.n_seen_hit == 2 && gi.n_seen_miss == 2, "counters");
+    gossip_ingest_free(&gi);
+
+    /* A forgery is answered from the cache the second time. */
+    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_VERIFY);
+    gossip_ingest_init(&gi, ctx, &gs);
+    ul = build_raw_chan_update(upd, scid, NOW + 400, 0x01, 1, 1, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 400)
+           == GOSSIP_INGEST_BAD_SIG, "unsigned update rejected");
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 500)
+           == GOSSIP_INGEST_BAD_SIG, "rejected again");
+    ASSERT(gi.n_seen_hit == 1 && gi.n_rejected_sig == 2, "second from cache");
+    gossip_ingest_free(&gi);
+    secp256k1_context_destroy(ctx);
+
+    /* Bounded: one generation's worth of distinct updates rotates it. */
+    gossip_ingest_init(&gi, NULL, NULL);
+    uint32_t n = GOSSIP_INGEST_SEEN_MAX / 2 + 1;
+    for (uint32_t i = 0; i < n; i++) {
+        ul = build_raw_chan_update(upd, ((uint64_t)800000 << 40) | i,
+                                   NOW, 0x00, 1, 1, 0);
+        gossip_ingest_channel_update(&gi, upd, ul, NOW);
+    }
+    ASSERT(gi.seen_msg.gen[0].count == 1, "current generation restarted");
+    ASSERT(gi.seen_msg.gen[1].count == GOSSIP_INGEST_SEEN_MAX / 2,
+           "previous generation full");
+    ul = build_raw_chan_update(upd, (uint64_t)800000 << 40, NOW, 0x00, 1, 1, 0);
+    ASSERT(gossip_ingest_channel_update(&gi, upd, ul, NOW + 100)
+           == GOSSIP_INGEST_DUPLICATE, "still found in previous generation");
+    gossip_ingest_free(&gi);
+
+    gossip_store_close(&gs);
+    return 1;
+}
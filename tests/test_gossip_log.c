@@ -0,0 +1,419 @@
+/*
+ * test_gossip_log.c — Tests for the binary, memory-mapped gossip log
+ */
+
+#include "superscalar/gossip_log.h"
+#include "superscalar/gossip_ingest.h"
+#include "superscalar/gossip.h"
+#include "superscalar/pathfind.h"
+#include "superscalar/rgs.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+#define GL_PATH  "/tmp/test_gossip_log.ssgl"
+#define SCID(b, t, o)  (((uint64_t)(b) << 40) | ((uint64_t)(t) << 16) | (o))
+
+static void fill_node(unsigned char id[33], unsigned char tag)
+{
+    memset(id, tag, 33);
+    id[0] = 0x02;
+}
+
+static size_t build_ann(unsigned char *out, size_t cap, uint64_t scid,
+                        unsigned char tag1, unsigned char tag2)
+{
+    unsigned char n1[33], n2[33];
+    fill_node(n1, tag1);
+    fill_node(n2, tag2);
+    return gossip_build_channel_announcement_unsigned(
+        out, cap, GOSSIP_CHAIN_HASH_MAINNET, scid, n1, n2, n1, n2);
+}
+
+/* Unsigned channel_update with htlc_maximum_msat. */
+static size_t build_upd(unsigned char *out, uint64_t scid, uint32_t ts,
+                        uint8_t chan_flags, uint32_t fee_base, uint32_t fee_ppm)
+{
+    memset(out, 0, 138);
+    out[0] = 0x01; out[1] = 0x02;
+    for (int i = 0; i < 8; i++) out[98 + i]  = (unsigned char)(scid >> (56 - 8 * i));
+    for (int i = 0; i < 4; i++) out[106 + i] = (unsigned char)(ts >> (24 - 8 * i));
+    out[110] = 0x01;
+    out[111] = chan_flags;
+    out[113] = 40;                                   /* cltv_expiry_delta */
+    out[121] = 1;                                    /* htlc_minimum_msat */
+    for (int i = 0; i < 4; i++) out[122 + i] = (unsigned char)(fee_base >> (24 - 8 * i));
+    for (int i = 0; i < 4; i++) out[126 + i] = (unsigned char)(fee_ppm  >> (24 - 8 * i));
+    out[134] = 0x3B; out[135] = 0x9A; out[136] = 0xCA; out[137] = 0x00;  /* 1e9 msat */
+    return 138;
+}
+
+/* Unsigned node_announcement, no features or addresses. */
+static size_t build_node(unsigned char *out, unsigned char tag, uint32_t ts)
+{
+    memset(out, 0, 142);
+    out[0] = 0x01; out[1] = 0x01;
+    for (int i = 0; i < 4; i++) out[68 + i] = (unsigned char)(ts >> (24 - 8 * i));
+    fill_node(out + 72, tag);
+    memcpy(out + 72 + 33 + 3, "alias", 5);
+    return 142;
+}
+
+typedef struct {
+    int      n;
+    uint64_t fee_base[2];
+    uint64_t cap;
+    uint64_t htlc_max;
+} edge_ctx_t;
+
+static void edge_cb(uint64_t scid, const unsigned char src[33],
+                    const unsigned char dst[33], uint32_t fee_base,
+                    uint32_t fee_ppm, uint16_t cltv, uint64_t htlc_min,
+                    uint64_t htlc_max, uint64_t cap_sat, void *ctx)
+{
+    (void)scid; (void)dst; (void)fee_ppm; (void)cltv; (void)htlc_min;
+    edge_ctx_t *e = (edge_ctx_t *)ctx;
+    e->fee_base[src[1] == 0xBB] = fee_base;
+    e->cap = cap_sat;
+    e->htlc_max = htlc_max;
+    e->n++;
+}
+
+typedef struct {
+    int      n;
+    uint64_t scids[16];
+    int      n_upd;
+} chan_ctx_t;
+
+static void chan_cb(uint64_t scid, const unsigned char *ann, size_t ann_len,
+                    const unsigned char *const upd[2], const size_t upd_len[2],
+                    void *ud)
+{
+    chan_ctx_t *c = (chan_ctx_t *)ud;
+    if (ann_len >= 2 && ann[0] == 0x01 && ann[1] == 0x00 && c->n < 16)
+        c->scids[c->n++] = scid;
+    for (int d = 0; d < 2; d++)
+        if (upd[d] && upd_len[d] >= 130) c->n_upd++;
+}
+
+/* GL1: supersede rules, lookup, capacity and edge enumeration */
+int test_gossip_log_append_supersede(void)
+{
+    unlink(GL_PATH);
+    gossip_log_t gl;
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL1: open");
+
+    unsigned char ann[512], upd[138], node[142];
+    uint64_t scid = SCID(700000, 1, 0);
+    size_t alen = build_ann(ann, sizeof(ann), scid, 0xAA, 0xBB);
+    ASSERT(alen >= 432, "GL1: build ann");
+
+    build_upd(upd, SCID(700000, 9, 0), 100, 0, 1, 1);
+    ASSERT(!gossip_log_append(&gl, upd, 138, 1), "GL1: update before ann dropped");
+    ASSERT(gossip_log_append(&gl, ann, alen, 1), "GL1: ann appended");
+    ASSERT(!gossip_log_append(&gl, ann, alen, 2), "GL1: repeated ann dropped");
+
+    build_upd(upd, scid, 100, 0, 1000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 3), "GL1: update dir 0");
+    build_upd(upd, scid, 90, 0, 5000, 10);
+    ASSERT(!gossip_log_append(&gl, upd, 138, 4), "GL1: older update dropped");
+    build_upd(upd, scid, 110, 0, 2000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 5), "GL1: newer update replaces");
+    build_upd(upd, scid, 100, 1, 3000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 6), "GL1: update dir 1");
+    ASSERT(gl.dead_bytes == 8 + 138, "GL1: superseded update marked deleted");
+
+    build_node(node, 0xAA, 50);
+    ASSERT(gossip_log_append(&gl, node, 142, 7), "GL1: node ann");
+    ASSERT(!gossip_log_append(&gl, node, 142, 8), "GL1: same node ann dropped");
+    build_node(node, 0xAA, 51);
+    ASSERT(gossip_log_append(&gl, node, 142, 9), "GL1: newer node ann");
+
+    ASSERT(gossip_log_set_amount(&gl, scid, 250000), "GL1: set amount");
+    unsigned char n1[33], n2[33];
+    uint64_t cap = 0;
+    ASSERT(gossip_log_get_channel(&gl, scid, n1, n2, &cap), "GL1: get channel");
+    ASSERT(n1[1] == 0xAA && n2[1] == 0xBB, "GL1: endpoints");
+    ASSERT(cap == 250000, "GL1: capacity");
+    ASSERT(!gossip_log_get_channel(&gl, scid + 1, NULL, NULL, NULL), "GL1: unknown scid");
+    ASSERT(gossip_log_channel_count(&gl) == 1, "GL1: one channel");
+
+    edge_ctx_t e;
+    memset(&e, 0, sizeof(e));
+    ASSERT(gossip_log_enumerate_channels(&gl, edge_cb, &e) == 2, "GL1: two edges");
+    ASSERT(e.fee_base[0] == 2000, "GL1: dir 0 has newest policy");
+    ASSERT(e.fee_base[1] == 3000, "GL1: dir 1 policy");
+    ASSERT(e.cap == 250000, "GL1: edge capacity");
+    ASSERT(e.htlc_max == 1000000000ULL, "GL1: advertised htlc_max");
+
+    /* Disabled direction is not routable */
+    build_upd(upd, scid, 120, 0x03, 3000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 10), "GL1: disable dir 1");
+    memset(&e, 0, sizeof(e));
+    ASSERT(gossip_log_enumerate_channels(&gl, edge_cb, &e) == 1, "GL1: one edge left");
+
+    ASSERT(gossip_log_mark_spent(&gl, scid), "GL1: mark spent");
+    ASSERT(!gossip_log_get_channel(&gl, scid, NULL, NULL, NULL), "GL1: spent gone");
+    ASSERT(gossip_log_channel_count(&gl) == 0, "GL1: no channels");
+    ASSERT(!gossip_log_mark_spent(&gl, scid), "GL1: spent twice");
+
+    gossip_log_close(&gl);
+    unlink(GL_PATH);
+    return 1;
+}
+
+/* GL2: index rebuilt on reopen; torn tail truncated; bad magic refused */
+int test_gossip_log_reopen_torn_tail(void)
+{
+    unlink(GL_PATH);
+    gossip_log_t gl;
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL2: open");
+
+    unsigned char ann[512], upd[138];
+    uint64_t scid = SCID(700001, 2, 1);
+    size_t alen = build_ann(ann, sizeof(ann), scid, 0xAA, 0xBB);
+    ASSERT(gossip_log_append(&gl, ann, alen, 1), "GL2: ann");
+    build_upd(upd, scid, 100, 0, 1000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 2), "GL2: upd 100");
+    build_upd(upd, scid, 200, 0, 2000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 3), "GL2: upd 200");
+    ASSERT(gossip_log_set_amount(&gl, scid, 77777), "GL2: amount");
+    uint64_t good_len = gl.file_len;
+    uint64_t live = gl.live_bytes, dead = gl.dead_bytes;
+    gossip_log_close(&gl);
+
+    /* Crash mid-append: header promises more bytes than were written */
+    int fd = open(GL_PATH, O_WRONLY | O_APPEND);
+    ASSERT(fd >= 0, "GL2: open raw");
+    unsigned char torn[20] = { 0x00, 0x00, 0x00, 0x8A, 0, 0, 0, 9, 0x01, 0x02 };
+    ASSERT(write(fd, torn, sizeof(torn)) == (ssize_t)sizeof(torn), "GL2: write torn");
+    close(fd);
+
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL2: reopen");
+    ASSERT(gl.file_len == good_len, "GL2: torn record dropped");
+    struct stat st;
+    ASSERT(stat(GL_PATH, &st) == 0 && (uint64_t)st.st_size == good_len,
+           "GL2: file truncated");
+    ASSERT(gl.live_bytes == live && gl.dead_bytes == dead, "GL2: byte accounting");
+
+    uint64_t cap = 0;
+    ASSERT(gossip_log_get_channel(&gl, scid, NULL, NULL, &cap), "GL2: channel back");
+    ASSERT(cap == 77777, "GL2: capacity back");
+    edge_ctx_t e;
+    memset(&e, 0, sizeof(e));
+    ASSERT(gossip_log_enumerate_channels(&gl, edge_cb, &e) == 1, "GL2: one edge");
+    ASSERT(e.fee_base[0] == 2000, "GL2: newest update kept");
+
+    /* Appends continue after the reopen */
+    build_upd(upd, scid, 300, 1, 3000, 10);
+    ASSERT(gossip_log_append(&gl, upd, 138, 4), "GL2: append after reopen");
+    gossip_log_close(&gl);
+
+    fd = open(GL_PATH, O_WRONLY);
+    ASSERT(fd >= 0 && write(fd, "XXXX", 4) == 4, "GL2: clobber magic");
+    close(fd);
+    ASSERT(!gossip_log_open(&gl, GL_PATH), "GL2: bad magic refused");
+
+    unlink(GL_PATH);
+    return 1;
+}
+
+/* GL3: heavy update churn triggers compaction; contents survive it */
+int test_gossip_log_compaction(void)
+{
+    unlink(GL_PATH);
+    gossip_log_t gl;
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL3: open");
+
+    unsigned char ann[512], upd[138];
+    uint64_t scid = SCID(700002, 3, 0);
+    size_t alen = build_ann(ann, sizeof(ann), scid, 0xAA, 0xBB);
+    ASSERT(gossip_log_append(&gl, ann, alen, 1), "GL3: ann");
+
+    /* ~1.5 MB of superseded updates */
+    uint32_t n_upd = (3u * GOSSIP_LOG_COMPACT_MIN / 2) / (8 + 138) + 1;
+    for (uint32_t i = 1; i <= n_upd; i++) {
+        build_upd(upd, scid, i, (uint8_t)(i & 1), i, 10);
+        ASSERT(gossip_log_append(&gl, upd, 138, i), "GL3: churn append");
+    }
+    ASSERT(gl.n_compactions >= 1, "GL3: compacted automatically");
+    ASSERT(gl.file_len < GOSSIP_LOG_COMPACT_MIN + 4096, "GL3: file bounded");
+
+    ASSERT(gossip_log_compact(&gl), "GL3: explicit compact");
+    ASSERT(gl.dead_bytes == 0, "GL3: nothing dead");
+    ASSERT(gl.file_len == GOSSIP_LOG_HDR_LEN + 8 + alen + 2 * (8 + 138),
+           "GL3: only ann + 2 updates left");
+
+    edge_ctx_t e;
+    memset(&e, 0, sizeof(e));
+    ASSERT(gossip_log_enumerate_channels(&gl, edge_cb, &e) == 2, "GL3: two edges");
+    ASSERT(e.fee_base[n_upd & 1] == n_upd, "GL3: newest policy kept");
+
+    /* An older update is still refused after compaction */
+    build_upd(upd, scid, 5, 0, 5, 10);
+    ASSERT(!gossip_log_append(&gl, upd, 138, 5), "GL3: stale after compact");
+    gossip_log_close(&gl);
+
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL3: reopen");
+    ASSERT(gossip_log_channel_count(&gl) == 1, "GL3: channel after reopen");
+    gossip_log_close(&gl);
+    unlink(GL_PATH);
+    return 1;
+}
+
+/* GL4: range/scid queries, RGS export and graph load from the log */
+int test_gossip_log_queries_export(void)
+{
+    unlink(GL_PATH);
+    gossip_log_t gl;
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL4: open");
+
+    unsigned char ann[512], upd[138];
+    uint32_t blocks[5] = { 700300, 700100, 700200, 700100, 700400 };
+    uint64_t scids[5];
+    for (int i = 0; i < 5; i++) {
+        scids[i] = SCID(blocks[i], i + 1, 0);
+        size_t alen = build_ann(ann, sizeof(ann), scids[i],
+                                (unsigned char)(0xA0 + i), 0xBB);
+        ASSERT(gossip_log_append(&gl, ann, alen, 1), "GL4: ann");
+        build_upd(upd, scids[i], 100, 0, 1000 + (uint32_t)i, 10);
+        ASSERT(gossip_log_append(&gl, upd, 138, 2), "GL4: upd");
+        ASSERT(gossip_log_set_amount(&gl, scids[i], 100000), "GL4: amount");
+    }
+    build_upd(upd, scids[2], 100, 0x03, 1, 1);   /* disabled dir 1 */
+    ASSERT(gossip_log_append(&gl, upd, 138, 3), "GL4: disabled upd");
+
+    chan_ctx_t c;
+    memset(&c, 0, sizeof(c));
+    ASSERT(gossip_log_channels_in_range(&gl, 700100, 101, chan_cb, &c) == 3,
+           "GL4: three channels in [700100, 700200]");
+    ASSERT(c.n == 3, "GL4: raw announcements handed out");
+    ASSERT(c.scids[0] < c.scids[1] && c.scids[1] < c.scids[2], "GL4: scid order");
+    ASSERT((c.scids[2] >> 40) == 700200, "GL4: range end");
+    ASSERT(c.n_upd == 4, "GL4: raw updates handed out");
+
+    memset(&c, 0, sizeof(c));
+    ASSERT(gossip_log_channels_in_range(&gl, 700101, 99, chan_cb, &c) == 0,
+           "GL4: empty range");
+
+    uint64_t want[3] = { scids[4], SCID(1, 1, 1), scids[0] };
+    memset(&c, 0, sizeof(c));
+    ASSERT(gossip_log_channels_by_scids(&gl, want, 3, chan_cb, &c) == 2,
+           "GL4: two known scids");
+
+    /* Spent channels drop out of range answers */
+    ASSERT(gossip_log_mark_spent(&gl, scids[3]), "GL4: spend");
+    memset(&c, 0, sizeof(c));
+    ASSERT(gossip_log_channels_in_range(&gl, 700100, 1, chan_cb, &c) == 1,
+           "GL4: spent channel gone from range");
+
+    static unsigned char blob[64 * 1024];
+    size_t blen = gossip_log_export_rgs(&gl, blob, sizeof(blob));
+    ASSERT(blen > 0, "GL4: export");
+    rgs_node_id_t nodes[16];
+    rgs_channel_t chans[16];
+    rgs_snapshot_t snap;
+    ASSERT(rgs_parse(blob, blen, &snap, nodes, 16, chans, 16), "GL4: parse export");
+    ASSERT(snap.channel_count == 4, "GL4: four channels exported");
+    ASSERT(snap.node_id_count == 5, "GL4: node ids deduplicated");
+    const rgs_channel_t *ch = rgs_find_channel(&snap, chans, scids[2]);
+    ASSERT(ch && ch->update_count == 2, "GL4: both updates exported");
+    ASSERT(ch->funding_satoshis == 100000, "GL4: capacity exported");
+    ASSERT(rgs_get_update(ch, 0) && rgs_get_update(ch, 0)->fee_base_msat == 1002,
+           "GL4: dir 0 policy");
+    ASSERT(rgs_get_update(ch, 1) == NULL, "GL4: disabled dir 1");
+
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g, "GL4: graph alloc");
+    ASSERT(pathfind_graph_load_from_log(g, &gl) == 4, "GL4: graph edges");
+    ASSERT(pathfind_graph_get_channel(g, scids[0], NULL, NULL, NULL), "GL4: in graph");
+    pathfind_graph_free(g);
+
+    gossip_log_close(&gl);
+    unlink(GL_PATH);
+    return 1;
+}
+
+/* GL5: gossip_ingest appends accepted gossip and knows channels from the log */
+int test_gossip_log_ingest(void)
+{
+    unlink(GL_PATH);
+    gossip_log_t gl;
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL5: open");
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, NULL);
+    gi.log = &gl;
+
+    unsigned char ann[512], upd[138];
+    uint64_t scid = SCID(700500, 1, 0);
+    size_t alen = build_ann(ann, sizeof(ann), scid, 0xAA, 0xBB);
+
+    build_upd(upd, scid, 100, 0, 1000, 10);
+    ASSERT(gossip_ingest_message(&gi, upd, 138, 1000) == GOSSIP_INGEST_ORPHAN,
+           "GL5: orphan without announcement");
+    ASSERT(gossip_ingest_message(&gi, ann, alen, 1000) == GOSSIP_INGEST_NO_VERIFY,
+           "GL5: ann accepted");
+    ASSERT(gossip_log_channel_count(&gl) == 1, "GL5: ann in log");
+    /* the orphaned attempt counted against the rate limit */
+    ASSERT(gossip_ingest_message(&gi, upd, 138, 1000 + GOSSIP_INGEST_MIN_INTERVAL)
+           == GOSSIP_INGEST_NO_VERIFY, "GL5: update accepted via log lookup");
+
+    const unsigned char *msgs[1] = { ann };
+    size_t lens[1] = { alen };
+    int res[1];
+    ASSERT(gossip_ingest_batch(&gi, msgs, lens, 1, 5000, res) == 0 &&
+           res[0] == GOSSIP_INGEST_DUPLICATE, "GL5: batch knows logged channel");
+
+    edge_ctx_t e;
+    memset(&e, 0, sizeof(e));
+    ASSERT(gossip_log_enumerate_channels(&gl, edge_cb, &e) == 1, "GL5: edge logged");
+
+    gossip_ingest_channel_closed(&gi, scid, 2000);
+    ASSERT(gossip_log_channel_count(&gl) == 0, "GL5: closed channel spent");
+
+    gossip_ingest_free(&gi);
+    gossip_log_close(&gl);
+    unlink(GL_PATH);
+    return 1;
+}
+
+/* GL6: appends and lookups reuse the mapping; it is replaced only when
+ * the file outgrows it, doubling each time */
+int test_gossip_log_map_growth(void)
+{
+    unlink(GL_PATH);
+    gossip_log_t gl;
+    ASSERT(gossip_log_open(&gl, GL_PATH), "GL6: open");
+    ASSERT(gl.n_maps == 1, "GL6: mapped once on open");
+
+    unsigned char ann[512], n1[33];
+    const uint32_t n = 8000;   /* ~3.5 MB of announcements */
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t scid = SCID(700600 + i, 1, 0);
+        size_t alen = build_ann(ann, sizeof(ann), scid, 0xAA, 0xBB);
+        ASSERT(gossip_log_append(&gl, ann, alen, i), "GL6: append");
+        ASSERT(gossip_log_get_channel(&gl, scid, n1, NULL, NULL) && n1[1] == 0xAA,
+               "GL6: new record readable through the mapping");
+        ASSERT(gl.map_len >= gl.file_len, "GL6: mapping covers the file");
+    }
+    ASSERT(gl.file_len > 2 * (1u << 20), "GL6: file outgrew the first mapping");
+    ASSERT(gl.n_maps <= 3, "GL6: remapped only to double");
+    ASSERT(gossip_log_get_channel(&gl, SCID(700600, 1, 0), NULL, NULL, NULL),
+           "GL6: first record still readable");
+    ASSERT(gossip_log_channel_count(&gl) == n, "GL6: all channels");
+
+    gossip_log_close(&gl);
+    unlink(GL_PATH);
+    return 1;
+}
@@ -5,10 +5,12 @@
  *   Commit 2 (base): timestamp strategy, reconnect backoff/jitter, peer parse
  *   Commit 3 (added via Edit): prune, rejection cache, 4-sig, waiting proof
  *   Commit 4 (added via Edit): rate limit, refill, embargo
+ *   Batched ingest: peer batches flushed through gossip_ingest_batch
  */
 
 #include "superscalar/gossip_peer.h"
 #include "superscalar/gossip_store.h"
+#include "superscalar/gossip_ingest.h"
 #include "superscalar/gossip.h"
 #include "superscalar/sha256.h"
 #include "superscalar/bolt8.h"
@@ -434,3 +436,62 @@ int test_gossip_peer_embargo(void) {
 
     return 1;
 }
+
+/* -----------------------------------------------------------------------
+ * Batched ingest: what a peer sends is verified and stored per batch
+ * ----------------------------------------------------------------------- */
+
+int test_gossip_peer_batch_flush(void) {
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "open gs");
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, &gs);   /* no ctx: stored unverified */
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+    gossip_peer_mgr_cfg_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.store   = &gs;
+    cfg.gi      = &gi;
+    cfg.gi_lock = &lock;
+
+    unsigned char n1[33], n2[33], b1[33], b2[33];
+    memset(n1, 0x02, 33); n1[1] = 0x11;
+    memset(n2, 0x03, 33); n2[1] = 0x22;
+    memset(b1, 0x02, 33); b1[1] = 0x33;
+    memset(b2, 0x02, 33); b2[1] = 0x44;
+
+    gossip_peer_batch_t *b = calloc(1, sizeof(*b));
+    ASSERT(b, "alloc");
+    unsigned char ann[512];
+    uint64_t base = (uint64_t)700100 << 40;
+    for (size_t i = 0; i < GOSSIP_PEER_BATCH_MAX; i++) {
+        size_t len = gossip_build_channel_announcement_unsigned(
+            ann, sizeof(ann), GOSSIP_CHAIN_HASH_MAINNET, base | i, n1, n2, b1, b2);
+        ASSERT(len > 0, "build");
+        int full = gossip_peer_batch_add(b, ann, len, 1000 + i);
+        ASSERT(full == (i + 1 == GOSSIP_PEER_BATCH_MAX), "full only at the end");
+    }
+    ASSERT(b->first_ms == 1000, "oldest arrival kept");
+    ASSERT(gossip_peer_batch_add(b, ann, 10, 5000) == -1, "no room past full");
+
+    ASSERT(gossip_peer_batch_flush(&cfg, b, 1700000000u) == GOSSIP_PEER_BATCH_MAX,
+           "whole batch accepted");
+    ASSERT(b->n == 0, "batch emptied");
+    ASSERT(gi.n_channel_ann == GOSSIP_PEER_BATCH_MAX, "went through ingest");
+    ASSERT(gossip_store_get_channel(&gs, base | 7, NULL, NULL, NULL, NULL),
+           "stored");
+
+    /* The same announcements again are duplicates */
+    for (size_t i = 0; i < 3; i++) {
+        size_t len = gossip_build_channel_announcement_unsigned(
+            ann, sizeof(ann), GOSSIP_CHAIN_HASH_MAINNET, base | i, n1, n2, b1, b2);
+        gossip_peer_batch_add(b, ann, len, 9000);
+    }
+    ASSERT(gossip_peer_batch_flush(&cfg, b, 1700000001u) == 0, "duplicates dropped");
+    ASSERT(gossip_peer_batch_flush(&cfg, b, 1700000002u) == 0, "empty flush");
+
+    free(b);
+    gossip_ingest_free(&gi);
+    gossip_store_close(&gs);
+    return 1;
+}
@@ -0,0 +1,246 @@
+/*
+ * test_gossip_query.c — Tests for the indexed query_channel_range responder
+ */
+
+#include "superscalar/gossip_query.h"
+#include "superscalar/gossip_ingest.h"
+#include "superscalar/gossip.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+#define SCID(b, t)  (((uint64_t)(b) << 40) | ((uint64_t)(t) << 16))
+
+static uint32_t rd32(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* Bitwise CRC32C, independent of the table-driven one under test. */
+static uint32_t ref_crc32c(uint32_t crc, const unsigned char *p, size_t n)
+{
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static size_t build_upd(unsigned char *out, uint64_t scid, int dir,
+                        uint32_t ts, uint32_t fee_base)
+{
+    memset(out, 0, 130);
+    out[0] = 0x01; out[1] = 0x02;
+    memset(out + 2, 0x5A, 64);                       /* "signature" */
+    for (int i = 0; i < 8; i++) out[98 + i]  = (unsigned char)(scid >> (56 - 8 * i));
+    for (int i = 0; i < 4; i++) out[106 + i] = (unsigned char)(ts >> (24 - 8 * i));
+    out[111] = (unsigned char)dir;
+    out[113] = 40;
+    for (int i = 0; i < 4; i++) out[122 + i] = (unsigned char)(fee_base >> (24 - 8 * i));
+    return 130;
+}
+
+/* GQ1: sorted index, bucket lookups, update timestamps/checksums */
+int test_gossip_query_index(void)
+{
+    unsigned char v[9] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    ASSERT(ref_crc32c(0, v, 9) == 0xE3069283u, "GQ1: reference CRC32C vector");
+
+    gossip_query_index_t qi;
+    ASSERT(gossip_query_index_init(&qi), "GQ1: init");
+    uint32_t blocks[7] = { 700000, 1023, 1024, 2047, 700000, 650000, 2048 };
+    for (int i = 0; i < 7; i++)
+        ASSERT(gossip_query_index_add(&qi, SCID(blocks[i], i + 1)), "GQ1: add");
+    ASSERT(gossip_query_index_add(&qi, SCID(1024, 3)), "GQ1: re-add is a no-op");
+    ASSERT(qi.n == 7, "GQ1: seven entries");
+    for (size_t i = 1; i < qi.n; i++)
+        ASSERT(qi.entries[i - 1].scid < qi.entries[i].scid, "GQ1: sorted");
+
+    ASSERT(gossip_query_index_count(&qi, 0, UINT32_MAX) == 7, "GQ1: everything");
+    ASSERT(gossip_query_index_count(&qi, 1024, 1024) == 2, "GQ1: one bucket");
+    ASSERT(gossip_query_index_count(&qi, 1023, 2) == 2, "GQ1: across bucket edge");
+    ASSERT(gossip_query_index_count(&qi, 2048, 1) == 1, "GQ1: single block");
+    ASSERT(gossip_query_index_count(&qi, 3000, 600000) == 0, "GQ1: gap");
+    ASSERT(gossip_query_index_count(&qi, 700000, 1) == 2, "GQ1: two in one block");
+    ASSERT(gossip_query_index_count(&qi, 800000, 10) == 0, "GQ1: past the tip");
+
+    unsigned char upd[130];
+    uint64_t scid = SCID(1024, 3);
+    build_upd(upd, scid, 1, 500, 1000);
+    ASSERT(gossip_query_index_update(&qi, upd, 130), "GQ1: update");
+    uint32_t expect = ref_crc32c(ref_crc32c(0, upd + 66, 40), upd + 110, 20);
+    ASSERT(gossip_query_update_checksum(upd, 130) == expect, "GQ1: checksum");
+    build_upd(upd, scid, 1, 400, 9999);
+    ASSERT(!gossip_query_index_update(&qi, upd, 130), "GQ1: older update ignored");
+    build_upd(upd, SCID(5, 5), 0, 600, 1);
+    ASSERT(!gossip_query_index_update(&qi, upd, 130), "GQ1: unknown channel");
+
+    /* Signature and timestamp don't enter the checksum; policy does. */
+    unsigned char u2[130];
+    build_upd(upd, scid, 1, 700, 1000);
+    build_upd(u2, scid, 1, 800, 1000);
+    memset(u2 + 2, 0x11, 64);
+    ASSERT(gossip_query_update_checksum(upd, 130) == gossip_query_update_checksum(u2, 130),
+           "GQ1: sig/timestamp excluded");
+    build_upd(u2, scid, 1, 700, 1001);
+    ASSERT(gossip_query_update_checksum(upd, 130) != gossip_query_update_checksum(u2, 130),
+           "GQ1: fee change alters checksum");
+
+    ASSERT(gossip_query_index_remove(&qi, SCID(2047, 4)), "GQ1: remove");
+    ASSERT(!gossip_query_index_remove(&qi, SCID(2047, 4)), "GQ1: remove twice");
+    ASSERT(gossip_query_index_count(&qi, 1024, 1024) == 1, "GQ1: bucket after remove");
+
+    gossip_query_index_free(&qi);
+    return 1;
+}
+
+typedef struct {
+    int      n_msgs;
+    size_t   n_scids;
+    uint64_t last_scid;
+    uint32_t prev_first;
+    uint64_t covered_to;
+    int      ok;
+    uint32_t ts_of_probe[2];
+    uint32_t cs_of_probe[2];
+    uint64_t probe;
+} reply_ctx_t;
+
+static int collect(void *ctx, const unsigned char *m, size_t len)
+{
+    reply_ctx_t *rc = (reply_ctx_t *)ctx;
+    if (len > GOSSIP_QUERY_MAX_MSG || len < 46 || m[0] != 0x01 || m[1] != 0x08 ||
+        m[42] != 1 || m[45] != 0x00) {
+        rc->ok = 0;
+        return 0;
+    }
+    uint32_t first = rd32(m + 34), num = rd32(m + 38);
+    if (rc->n_msgs && first < rc->prev_first) rc->ok = 0;
+    rc->prev_first = first;
+    if ((uint64_t)first + num > rc->covered_to) rc->covered_to = (uint64_t)first + num;
+
+    size_t n = (((size_t)m[43] << 8 | m[44]) - 1) / 8;
+    size_t off = 46;
+    size_t probe_i = (size_t)-1;
+    for (size_t i = 0; i < n; i++, off += 8) {
+        uint64_t s = ((uint64_t)rd32(m + off) << 32) | rd32(m + off + 4);
+        uint32_t blk = (uint32_t)(s >> 40);
+        if (s <= rc->last_scid || blk < first || blk >= (uint64_t)first + num) rc->ok = 0;
+        if (s == rc->probe) probe_i = i;
+        rc->last_scid = s;
+    }
+    rc->n_scids += n;
+
+    /* timestamps_tlv (1), checksums_tlv (3): bigsize 0xFD lengths here */
+    if (off + 4 > len || m[off] != 1 || m[off + 1] != 0xFD ||
+        (((size_t)m[off + 2] << 8) | m[off + 3]) != 1 + 8 * n) {
+        rc->ok = 0;
+        return 0;
+    }
+    size_t ts_off = off + 5;
+    off = ts_off + 8 * n;
+    if (off + 4 > len || m[off] != 3 ||
+        (((size_t)m[off + 2] << 8) | m[off + 3]) != 8 * n) {
+        rc->ok = 0;
+        return 0;
+    }
+    size_t cs_off = off + 4;
+    if (cs_off + 8 * n != len) rc->ok = 0;
+    if (probe_i != (size_t)-1) {
+        rc->ts_of_probe[0] = rd32(m + ts_off + 8 * probe_i);
+        rc->ts_of_probe[1] = rd32(m + ts_off + 8 * probe_i + 4);
+        rc->cs_of_probe[0] = rd32(m + cs_off + 8 * probe_i);
+        rc->cs_of_probe[1] = rd32(m + cs_off + 8 * probe_i + 4);
+    }
+    rc->n_msgs++;
+    return 1;
+}
+
+/* GQ2: a large range is split into <=65535-byte replies covering the query */
+int test_gossip_query_reply_chunks(void)
+{
+    gossip_query_index_t qi;
+    ASSERT(gossip_query_index_init(&qi), "GQ2: init");
+    for (uint32_t i = 0; i < 6000; i++)
+        ASSERT(gossip_query_index_add(&qi, SCID(600000 + i / 3, i % 3 + 1)), "GQ2: add");
+    uint64_t probe = SCID(600000 + 4000 / 3, 4000 % 3 + 1);
+    unsigned char upd[130];
+    build_upd(upd, probe, 1, 1234, 77);
+    ASSERT(gossip_query_index_update(&qi, upd, 130), "GQ2: update probe");
+
+    reply_ctx_t rc;
+    memset(&rc, 0, sizeof(rc));
+    rc.ok = 1;
+    rc.probe = probe;
+    int sent = gossip_query_reply_range(&qi, GOSSIP_CHAIN_HASH_MAINNET, 590000, 20000,
+                                        GOSSIP_QUERY_WANT_TIMESTAMPS |
+                                        GOSSIP_QUERY_WANT_CHECKSUMS, collect, &rc);
+    ASSERT(sent == 3 && rc.n_msgs == 3, "GQ2: three replies");
+    ASSERT(rc.ok, "GQ2: replies well-formed and ordered");
+    ASSERT(rc.n_scids == 6000, "GQ2: every scid once");
+    ASSERT(rc.covered_to == 610000, "GQ2: final reply reaches end of query");
+    ASSERT(rc.ts_of_probe[0] == 0 && rc.ts_of_probe[1] == 1234, "GQ2: timestamps");
+    ASSERT(rc.cs_of_probe[1] == gossip_query_update_checksum(upd, 130), "GQ2: checksum");
+
+    /* Empty range still gets one (empty) reply */
+    int n_empty = 0;
+    memset(&rc, 0, sizeof(rc));
+    rc.ok = 1;
+    n_empty = gossip_query_reply_range(&qi, NULL, 100, 10,
+                                       GOSSIP_QUERY_WANT_TIMESTAMPS |
+                                       GOSSIP_QUERY_WANT_CHECKSUMS, collect, &rc);
+    ASSERT(n_empty == 1 && rc.n_scids == 0 && rc.covered_to == 110, "GQ2: empty range");
+    ASSERT(qi.n_replies == 4, "GQ2: reply counter");
+
+    gossip_query_index_free(&qi);
+    return 1;
+}
+
+/* GQ3: query_option TLV parsing; ingest feeds an attached index */
+int test_gossip_query_options_ingest(void)
+{
+    unsigned char q[64];
+    memset(q, 0, sizeof(q));
+    q[0] = 0x01; q[1] = 0x07;
+    uint32_t opt = 99;
+    ASSERT(gossip_query_parse_range_options(q, 42, &opt) && opt == 0, "GQ3: no tlv");
+    q[42] = 0x01; q[43] = 0x01; q[44] = 0x03;
+    ASSERT(gossip_query_parse_range_options(q, 45, &opt) && opt == 3, "GQ3: query_option");
+    q[45] = 0x05; q[46] = 0x02; q[47] = 0xAA; q[48] = 0xBB;   /* unknown odd tlv */
+    ASSERT(gossip_query_parse_range_options(q, 49, &opt) && opt == 3, "GQ3: skip unknown");
+    ASSERT(!gossip_query_parse_range_options(q, 48, &opt), "GQ3: truncated tlv");
+
+    gossip_query_index_t qi;
+    ASSERT(gossip_query_index_init(&qi), "GQ3: init");
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, NULL);
+    gi.qidx = &qi;
+
+    unsigned char n1[33], n2[33], ann[512], upd[130];
+    memset(n1, 0x22, 33); n1[0] = 0x02;
+    memset(n2, 0x33, 33); n2[0] = 0x03;
+    uint64_t scid = SCID(750000, 9);
+    size_t alen = gossip_build_channel_announcement_unsigned(
+        ann, sizeof(ann), GOSSIP_CHAIN_HASH_MAINNET, scid, n1, n2, n1, n2);
+    ASSERT(gossip_ingest_message(&gi, ann, alen, 1000) == GOSSIP_INGEST_NO_VERIFY, "GQ3: ann");
+    build_upd(upd, scid, 0, 4321, 5);
+    ASSERT(gossip_ingest_message(&gi, upd, 130, 1000) == GOSSIP_INGEST_NO_VERIFY, "GQ3: upd");
+    ASSERT(qi.n == 1 && qi.entries[0].ts[0] == 4321, "GQ3: indexed with timestamp");
+    gossip_ingest_channel_closed(&gi, scid, 2000);
+    ASSERT(qi.n == 0, "GQ3: closed channel dropped");
+
+    gossip_ingest_free(&gi);
+    gossip_query_index_free(&qi);
+    return 1;
+}
@@ -77,19 +77,24 @@ int test_htlc_forward_settle(void)
     htlc_forward_init(&fwd);
 
     /* Manually add an in-flight entry */
-    htlc_forward_entry_t *e = &fwd.entries[fwd.count++];
-    memset(e, 0, sizeof(*e));
-    e->in_htlc_id  = 100;
-    e->in_chan_id  = 200;
-    e->out_htlc_id = 300;
-    e->out_chan_id = 400;
-    e->state       = FORWARD_STATE_INFLIGHT;
+    htlc_forward_entry_t t;
+    memset(&t, 0, sizeof(t));
+    t.in_htlc_id  = 100;
+    t.in_chan_id  = 200;
+    t.out_htlc_id = 300;
+    t.out_chan_id = 400;
+    t.state       = FORWARD_STATE_INFLIGHT;
+    htlc_forward_entry_t *e = htlc_forward_add(&fwd, &t);
+    ASSERT(e != NULL, "entry added");
 
     unsigned char preimage[32];
     memset(preimage, 0xAA, 32);
-    htlc_forward_settle(&fwd, 300, 400, preimage);
+    ASSERT(htlc_forward_settle(&fwd, 300, 400, preimage) == e, "settle finds entry");
 
-    ASSERT(fwd.entries[0].state == FORWARD_STATE_SETTLED, "entry settled");
+    ASSERT(e->state == FORWARD_STATE_SETTLED, "entry settled");
+    ASSERT(htlc_forward_settle(&fwd, 300, 400, preimage) == NULL,
+           "second settle is a no-op");
+    htlc_forward_free(&fwd);
     return 1;
 }
 
@@ -99,25 +104,29 @@ int test_htlc_forward_fail(void)
     htlc_forward_table_t fwd;
     htlc_forward_init(&fwd);
 
-    htlc_forward_entry_t *e = &fwd.entries[fwd.count++];
-    memset(e, 0, sizeof(*e));
-    e->in_htlc_id  = 10;
-    e->in_chan_id  = 20;
-    e->out_htlc_id = 30;
-    e->out_chan_id = 40;
-    e->state       = FORWARD_STATE_INFLIGHT;
-    memset(e->onion_shared_secret, 0x55, 32);
+    htlc_forward_entry_t t;
+    memset(&t, 0, sizeof(t));
+    t.in_htlc_id  = 10;
+    t.in_chan_id  = 20;
+    t.out_htlc_id = 30;
+    t.out_chan_id = 40;
+    t.state       = FORWARD_STATE_INFLIGHT;
+    memset(t.onion_shared_secret, 0x55, 32);
+    htlc_forward_entry_t *e = htlc_forward_add(&fwd, &t);
+    ASSERT(e != NULL, "entry added");
 
     unsigned char error_in[256];
     memset(error_in, 0x99, 256);
     unsigned char error_out[256];
 
-    htlc_forward_fail(&fwd, 30, 40, error_in, 256, error_out);
+    ASSERT(htlc_forward_fail(&fwd, 30, 40, error_in, 256, error_out) == e,
+           "fail finds entry");
 
-    ASSERT(fwd.entries[0].state == FORWARD_STATE_FAILED, "entry failed");
+    ASSERT(e->state == FORWARD_STATE_FAILED, "entry failed");
     /* Error should be re-encrypted (different from input) */
     ASSERT(memcmp(error_in, error_out, 256) != 0, "error was re-encrypted");
 
+    htlc_forward_free(&fwd);
     return 1;
 }
 
@@ -215,3 +224,128 @@ int test_htlc_forward_find_by_scid_found(void)
     ASSERT(idx2 == -1, "HF9: wrong scid returns -1");
     return 1;
 }
+
+/* ================================================================== */
+/* HF10 — 20k concurrent HTLCs: indexed lookups, settle, slot reuse    */
+/* ================================================================== */
+int test_htlc_forward_scale(void)
+{
+    enum { N = 20000 };
+    htlc_forward_table_t fwd;
+    htlc_forward_init(&fwd);
+
+    htlc_forward_entry_t t;
+    memset(&t, 0, sizeof(t));
+    for (uint32_t i = 0; i < N; i++) {
+        t.in_chan_id  = i % 7;
+        t.in_htlc_id  = i;
+        t.out_chan_id = 100 + i % 13;
+        t.out_htlc_id = 5000 + i;
+        t.in_cltv     = 800000 + i;
+        t.state       = FORWARD_STATE_INFLIGHT;
+        memset(t.payment_hash, 0, 32);
+        memcpy(t.payment_hash, &i, sizeof(i));
+        htlc_forward_entry_t *e = htlc_forward_add(&fwd, &t);
+        ASSERT(e != NULL, "HF10: add");
+    }
+    ASSERT(fwd.count == N, "HF10: all live");
+    ASSERT(N > 256, "HF10: beyond the old fixed table");
+
+    /* Entry addresses survive slab growth */
+    htlc_forward_entry_t *first = htlc_forward_find_in(&fwd, 0, 0);
+    ASSERT(first != NULL && first->out_htlc_id == 5000, "HF10: first by in");
+
+    for (uint32_t i = 0; i < N; i += 97) {
+        htlc_forward_entry_t *a = htlc_forward_find_in(&fwd, i % 7, i);
+        htlc_forward_entry_t *b = htlc_forward_find_out(&fwd, 100 + i % 13, 5000 + i);
+        unsigned char h[32] = {0};
+        memcpy(h, &i, sizeof(i));
+        htlc_forward_entry_t *c[2];
+        ASSERT(a && a == b, "HF10: in/out agree");
+        ASSERT(htlc_forward_find_by_hash(&fwd, h, c, 2) == 1 && c[0] == a,
+               "HF10: hash lookup");
+    }
+    ASSERT(htlc_forward_find_out(&fwd, 100, 4999) == NULL, "HF10: miss");
+
+    /* Settle every even HTLC and release it */
+    unsigned char pre[32] = {0};
+    for (uint32_t i = 0; i < N; i += 2) {
+        htlc_forward_entry_t *e = htlc_forward_settle(&fwd, 5000 + i, 100 + i % 13, pre);
+        ASSERT(e && e->in_htlc_id == i, "HF10: settle");
+        htlc_forward_release(&fwd, e);
+    }
+    ASSERT(fwd.count == N / 2, "HF10: half left");
+    for (uint32_t i = 1; i < N; i += 202)
+        ASSERT(htlc_forward_find_out(&fwd, 100 + i % 13, 5000 + i) != NULL,
+               "HF10: odd survive backward-shift deletes");
+    ASSERT(htlc_forward_find_in(&fwd, 0, 0) == NULL, "HF10: released gone");
+
+    /* Released slots are reused before the slab grows */
+    uint32_t slots = fwd.n_slots;
+    t.in_chan_id = 99; t.in_htlc_id = 1; t.out_chan_id = 99; t.out_htlc_id = 1;
+    ASSERT(htlc_forward_add(&fwd, &t) != NULL, "HF10: re-add");
+    ASSERT(fwd.n_slots == slots, "HF10: slot reused");
+    ASSERT(htlc_forward_find_out(&fwd, 99, 1) != NULL, "HF10: re-added found");
+
+    htlc_forward_free(&fwd);
+    ASSERT(fwd.count == 0 && fwd.chunks == NULL, "HF10: freed");
+    return 1;
+}
+
+/* ================================================================== */
+/* HF11 — only never-relayed HTLCs expire, in in_cltv order          */
+/* ================================================================== */
+static void collect_expired(void *ctx, htlc_forward_entry_t *e)
+{
+    uint32_t *log = ctx;
+    log[1 + log[0]++] = e->in_cltv;
+}
+
+int test_htlc_forward_expiry(void)
+{
+    htlc_forward_table_t fwd;
+    htlc_forward_init(&fwd);
+    ASSERT(htlc_forward_next_expiry(&fwd) == 0, "HF11: empty");
+
+    static const uint32_t cltvs[] = { 950, 700, 820, 610, 990, 700, 880, 640 };
+    htlc_forward_entry_t t;
+    memset(&t, 0, sizeof(t));
+    for (uint32_t i = 0; i < 8; i++) {
+        t.in_htlc_id  = i;
+        t.out_htlc_id = i;
+        t.in_cltv     = cltvs[i];
+        t.state       = (i & 1) ? FORWARD_STATE_INFLIGHT : FORWARD_STATE_PENDING_OUT;
+        ASSERT(htlc_forward_add(&fwd, &t), "HF11: add");
+    }
+    ASSERT(fwd.n_pending == 4, "HF11: pending count");
+    ASSERT(htlc_forward_next_expiry(&fwd) == 610, "HF11: earliest");
+
+    /* Settle the 640 one (in flight, htlc 7) — it leaves the heap */
+    unsigned char pre[32] = {0};
+    ASSERT(htlc_forward_settle(&fwd, 7, 0, pre) != NULL, "HF11: settle");
+
+    /* A pending one goes out: stays in the heap */
+    htlc_forward_set_inflight(&fwd, htlc_forward_find_in(&fwd, 0, 2), 9, 42);
+    ASSERT(fwd.n_pending == 3, "HF11: pending after send");
+    ASSERT(htlc_forward_find_out(&fwd, 9, 42) != NULL, "HF11: out indexed");
+
+    /* Everything at or below 820 is in flight: nothing to fail back */
+    uint32_t log[16] = {0};
+    ASSERT(htlc_forward_expire(&fwd, 820, collect_expired, log) == 0,
+           "HF11: in-flight never expired");
+    ASSERT(htlc_forward_find_out(&fwd, 9, 42) != NULL, "HF11: still indexed");
+
+    ASSERT(htlc_forward_expire(&fwd, 960, collect_expired, log) == 2,
+           "HF11: two pending expire at 960");
+    ASSERT(log[0] == 2 && log[1] == 880 && log[2] == 950, "HF11: earliest first");
+    ASSERT(htlc_forward_find_in(&fwd, 0, 6) == NULL, "HF11: expired released");
+    ASSERT(htlc_forward_next_expiry(&fwd) == 610, "HF11: in-flight stay queued");
+    ASSERT(fwd.count == 6, "HF11: settled + in-flight + one pending remain");
+
+    ASSERT(htlc_forward_expire(&fwd, 2000, NULL, NULL) == 1, "HF11: rest");
+    ASSERT(fwd.n_pending == 0, "HF11: no pending");
+    ASSERT(fwd.n_expiry == 4, "HF11: four in flight in the heap");
+
+    htlc_forward_free(&fwd);
+    return 1;
+}
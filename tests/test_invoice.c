@@ -7,7 +7,9 @@
  * IV4: second invoice_claim returns 0 after first claim (no double-redeem)
  * IV5: expired invoice rejected by claim
  * IV6: invoice_settle marks invoice as settled
- * IV7: invoice_create fills table → INVOICE_TABLE_MAX limit enforced
+ * IV7: any-amount invoice accepts any positive amount
+ * IV8: thousands of invoices — hashed lookup, expiry wheel, slot reuse
+ * IV9: invoices added on one thread while another claims and expires
  */
 
 #include "superscalar/invoice.h"
@@ -19,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <pthread.h>
 
 #define ASSERT(cond, msg) do { \
     if (!(cond)) { \
@@ -62,7 +65,7 @@ int test_invoice_create_decode(void)
 
     /* The table entry's payment_hash must match decoded payment_hash */
     int found = 0;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (!tbl.entries[i].active) continue;
         if (memcmp(tbl.entries[i].payment_hash, decoded.payment_hash, 32) == 0) {
             found = 1;
@@ -96,7 +99,7 @@ int test_invoice_claim_success(void)
 
     /* Find the entry to get the payment_hash */
     bolt11_invoice_entry_t *entry = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { entry = &tbl.entries[i]; break; }
     }
     ASSERT(entry != NULL, "entry exists");
@@ -129,7 +132,7 @@ int test_invoice_claim_underpay(void)
            "create");
 
     bolt11_invoice_entry_t *entry = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { entry = &tbl.entries[i]; break; }
     }
     ASSERT(entry != NULL, "entry exists");
@@ -159,7 +162,7 @@ int test_invoice_claim_double(void)
            "create");
 
     bolt11_invoice_entry_t *entry = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { entry = &tbl.entries[i]; break; }
     }
     ASSERT(entry != NULL, "entry");
@@ -190,7 +193,7 @@ int test_invoice_claim_expired(void)
            "create");
 
     bolt11_invoice_entry_t *entry = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { entry = &tbl.entries[i]; break; }
     }
     ASSERT(entry != NULL, "entry");
@@ -221,7 +224,7 @@ int test_invoice_settle(void)
            "create");
 
     bolt11_invoice_entry_t *entry = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { entry = &tbl.entries[i]; break; }
     }
     ASSERT(entry != NULL, "entry");
@@ -254,7 +257,7 @@ int test_invoice_any_amount(void)
            "create any-amount");
 
     bolt11_invoice_entry_t *entry = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { entry = &tbl.entries[i]; break; }
     }
     ASSERT(entry != NULL, "entry");
@@ -269,6 +272,168 @@ int test_invoice_any_amount(void)
 }
 
 
+/* ================================================================== */
+/* IV8 — hashed lookup and expiry wheel at scale                      */
+/* ================================================================== */
+#define IV8_N     5000
+#define IV8_BASE  1700000000u
+
+static void iv8_key(int i, unsigned char hash[32])
+{
+    unsigned char pre[32];
+    memset(pre, 0, 32);
+    memcpy(pre, &i, sizeof(i));
+    sha256(pre, 32, hash);
+}
+
+static uint32_t iv8_deadline(int i)
+{
+    return IV8_BASE + 60 + (uint32_t)(i % 100) * 60;
+}
+
+static int iv8_gone(int i, uint32_t now)
+{
+    uint32_t d = iv8_deadline(i);
+    /* Settled ones go as soon as the sweep passes their bucket */
+    return d <= now || (i % 10 == 0 &&
+                        (d >> INVOICE_WHEEL_TICK_SHIFT) <= (now >> INVOICE_WHEEL_TICK_SHIFT));
+}
+
+typedef struct { size_t n; int bad; uint32_t now; } iv8_archive_t;
+
+static void iv8_archive(void *ctx, const bolt11_invoice_entry_t *e)
+{
+    iv8_archive_t *a = ctx;
+    a->n++;
+    if (!(e->settled || e->created_at + e->expiry <= a->now)) a->bad = 1;
+}
+
+int test_invoice_table_scale(void)
+{
+    bolt11_invoice_table_t tbl;
+    invoice_init(&tbl);
+
+    for (int i = 0; i < IV8_N; i++) {
+        bolt11_invoice_entry_t e;
+        memset(&e, 0, sizeof(e));
+        iv8_key(i, e.payment_hash);
+        e.preimage[0] = (unsigned char)i;
+        e.amount_msat = 1000 + (uint64_t)i;
+        e.created_at = IV8_BASE;
+        e.expiry = iv8_deadline(i) - IV8_BASE;
+        ASSERT(invoice_add(&tbl, &e) != NULL, "add");
+    }
+    ASSERT(tbl.count == IV8_N, "count past the old 64-entry limit");
+
+    unsigned char h[32];
+    iv8_key(IV8_N - 1, h);
+    ASSERT(invoice_last(&tbl) && memcmp(invoice_last(&tbl)->payment_hash, h, 32) == 0,
+           "invoice_last is the newest");
+
+    bolt11_invoice_entry_t dup;
+    memset(&dup, 0, sizeof(dup));
+    iv8_key(42, dup.payment_hash);
+    ASSERT(invoice_add(&tbl, &dup) == NULL, "duplicate payment_hash refused");
+
+    for (int i = 0; i < IV8_N; i++) {
+        iv8_key(i, h);
+        bolt11_invoice_entry_t *e = invoice_find(&tbl, h);
+        ASSERT(e && e->amount_msat == 1000 + (uint64_t)i, "find by payment_hash");
+        if (i % 10 == 0) invoice_settle(&tbl, h);
+    }
+    iv8_key(IV8_N, h);
+    ASSERT(invoice_find(&tbl, h) == NULL, "unknown hash not found");
+
+    /* Sweep part-way: expired and settled-in-passed-buckets go */
+    uint32_t now = IV8_BASE + 3000;
+    iv8_archive_t a = { 0, 0, now };
+    size_t dropped = invoice_expire(&tbl, now, iv8_archive, &a);
+    size_t expect = 0;
+    for (int i = 0; i < IV8_N; i++) {
+        iv8_key(i, h);
+        int gone = iv8_gone(i, now);
+        expect += (size_t)gone;
+        ASSERT((invoice_find(&tbl, h) == NULL) == gone, "survivors match deadlines");
+    }
+    ASSERT(dropped == expect && a.n == expect, "dropped count");
+    ASSERT(!a.bad, "only expired or settled invoices archived");
+    ASSERT(tbl.count == (int)(IV8_N - expect), "count after sweep");
+
+    /* Freed slots are reused before the table grows */
+    size_t slots = tbl.n_slots;
+    bolt11_invoice_entry_t e;
+    memset(&e, 0, sizeof(e));
+    iv8_key(IV8_N, e.payment_hash);
+    e.created_at = IV8_BASE + 3000;
+    e.expiry = 600;
+    ASSERT(invoice_add(&tbl, &e) != NULL, "add after sweep");
+    ASSERT(tbl.n_slots == slots, "slot reused");
+
+    /* Well past every deadline: table drains */
+    a.now = IV8_BASE + 10000;
+    invoice_expire(&tbl, a.now, iv8_archive, &a);
+    ASSERT(tbl.count == 0, "all expired");
+    ASSERT(a.n == IV8_N + 1, "every invoice archived once");
+    ASSERT(!a.bad, "no live invoice archived");
+
+    invoice_free(&tbl);
+    return 1;
+}
+
+/* ================================================================== */
+/* IV9 — add on one thread, claim and expire on another               */
+/* ================================================================== */
+#define IV9_N 20000
+
+static void *iv9_adder(void *arg)
+{
+    bolt11_invoice_table_t *tbl = arg;
+    uint32_t now = (uint32_t)time(NULL);
+    for (int i = 0; i < IV9_N; i++) {
+        bolt11_invoice_entry_t e;
+        memset(&e, 0, sizeof(e));
+        iv8_key(i, e.payment_hash);
+        e.created_at = now;
+        e.expiry = 3600;
+        invoice_add(tbl, &e);
+    }
+    return NULL;
+}
+
+int test_invoice_table_threads(void)
+{
+    bolt11_invoice_table_t tbl;
+    invoice_init(&tbl);
+
+    pthread_t t;
+    ASSERT(pthread_create(&t, NULL, iv9_adder, &tbl) == 0, "thread");
+    /* Claims race the adder (and the index growing under it) */
+    size_t claimed = 0;
+    unsigned char h[32], pre[32];
+    uint32_t now = (uint32_t)time(NULL);
+    for (int pass = 0; pass < 4; pass++) {
+        for (int i = pass; i < IV9_N; i += 4) {
+            iv8_key(i, h);
+            claimed += (size_t)invoice_claim(&tbl, h, 1, pre);
+        }
+        invoice_expire(&tbl, now, NULL, NULL);
+    }
+    pthread_join(t, NULL);
+
+    /* Every invoice not claimed while racing is still there */
+    for (int i = 0; i < IV9_N; i++) {
+        iv8_key(i, h);
+        claimed += (size_t)invoice_claim(&tbl, h, 1, pre);
+    }
+    ASSERT(claimed == IV9_N, "each invoice claimed once");
+    /* Settled ones leave when their bucket is swept */
+    invoice_expire(&tbl, now + 3600 + 64, NULL, NULL);
+    ASSERT(tbl.count == 0, "settled invoices dropped");
+
+    invoice_free(&tbl);
+    return 1;
+}
+
 /* ================================================================== */
 /* SI_W1 — invoice_create: payment_secret == derived HMAC secret     */
 /* ================================================================== */
@@ -289,7 +454,7 @@ int test_stateless_invoice_secret_derived(void)
            "SI_W1: create");
 
     bolt11_invoice_entry_t *e = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { e = &tbl.entries[i]; break; }
     }
     ASSERT(e != NULL, "SI_W1: entry exists");
@@ -325,7 +490,7 @@ int test_stateless_invoice_secrets_differ(void)
                            2000, "inv2", 3600, b2, sizeof(b2)), "create 2");
 
     bolt11_invoice_entry_t *e1 = NULL, *e2 = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) {
             if (!e1) e1 = &tbl.entries[i];
             else if (!e2) { e2 = &tbl.entries[i]; break; }
@@ -406,7 +571,7 @@ int test_sl2_invoice_has_nonce(void)
            "SL2_1: create");
 
     bolt11_invoice_entry_t *e = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { e = &tbl.entries[i]; break; }
     }
     ASSERT(e != NULL, "SL2_1: entry exists");
@@ -440,7 +605,7 @@ int test_sl2_nonce_in_metadata(void)
            "SL2_2: create");
 
     bolt11_invoice_entry_t *e = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { e = &tbl.entries[i]; break; }
     }
     ASSERT(e != NULL, "SL2_2: entry");
@@ -540,7 +705,7 @@ int test_sl2_end_to_end(void)
            "SL2_6: create");
 
     bolt11_invoice_entry_t *e = NULL;
-    for (int i = 0; i < INVOICE_TABLE_MAX; i++) {
+    for (size_t i = 0; i < tbl.n_slots; i++) {
         if (tbl.entries[i].active) { e = &tbl.entries[i]; break; }
     }
     ASSERT(e != NULL, "SL2_6: entry");
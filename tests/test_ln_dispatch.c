@@ -311,15 +311,14 @@ int test_ln_dispatch_invoice_claim(void)
     memset(payment_hash, 0xCC, 32);
     bolt11_invoice_table_t tbl;
     invoice_init(&tbl);
-    bolt11_invoice_entry_t *e = &tbl.entries[0];
-    e->active      = 1;
-    e->settled     = 0;
-    memcpy(e->payment_hash, payment_hash, 32);
-    memset(e->preimage, 0xDD, 32);
-    e->amount_msat = 0;           /* accept any amount */
-    e->created_at  = (uint32_t)time(NULL);
-    e->expiry      = 3600;
-    tbl.count      = 1;
+    bolt11_invoice_entry_t inv;
+    memset(&inv, 0, sizeof(inv));
+    memcpy(inv.payment_hash, payment_hash, 32);
+    memset(inv.preimage, 0xDD, 32);
+    inv.amount_msat = 0;          /* accept any amount */
+    inv.created_at  = (uint32_t)time(NULL);
+    inv.expiry      = 3600;
+    ASSERT(invoice_add(&tbl, &inv), "add invoice");
 
     /* Build update_add_htlc with our payment_hash */
     htlc_forward_table_t fwd;
@@ -348,6 +347,7 @@ int test_ln_dispatch_invoice_claim(void)
     /* Invoice should be settled (invoice_claim sets settled=1) */
     ASSERT(tbl.entries[0].settled == 1, "invoice settled after final-hop claim");
 
+    invoice_free(&tbl);
     secp256k1_context_destroy(ctx);
     return 1;
 }
@@ -1419,6 +1419,7 @@ int test_ln_dispatch_gossip_type256_gi(void)
     ASSERT(r == 256, "GD1: type 256 returns 256");
 
     gossip_store_close(&gs);
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -1438,6 +1439,7 @@ int test_ln_dispatch_gossip_type257_gi(void)
     msg[0] = 0x01; msg[1] = 0x01; /* type 257 */
     int r = ln_dispatch_process_msg(&d, 0, msg, sizeof(msg));
     ASSERT(r == 257, "GD2: type 257 returns 257");
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -1457,6 +1459,7 @@ int test_ln_dispatch_gossip_type258_gi(void)
     msg[0] = 0x01; msg[1] = 0x02; /* type 258 */
     int r = ln_dispatch_process_msg(&d, 0, msg, sizeof(msg));
     ASSERT(r == 258, "GD3: type 258 returns 258");
+    gossip_ingest_free(&gi);
     return 1;
 }
 
@@ -1579,7 +1582,7 @@ int test_ln_dispatch_boot2_load_one_invoice(void)
     ASSERT(persist_save_ln_invoice(&db, &inv), "BOOT2: save invoice");
 
     bolt11_invoice_table_t tbl;
-    memset(&tbl, 0, sizeof(tbl));
+    invoice_init(&tbl);
 
     ln_dispatch_t d;
     memset(&d, 0, sizeof(d));
@@ -1591,6 +1594,7 @@ int test_ln_dispatch_boot2_load_one_invoice(void)
     ASSERT(tbl.count == 1, "BOOT2: invoice_table has 1 entry");
     ASSERT(memcmp(tbl.entries[0].payment_hash, inv.payment_hash, 32) == 0,
            "BOOT2: payment_hash matches");
+    invoice_free(&tbl);
 
     persist_close(&db);
     return 1;
@@ -1608,7 +1612,7 @@ int test_ln_dispatch_boot3_load_three_invoices(void)
     }
 
     bolt11_invoice_table_t tbl;
-    memset(&tbl, 0, sizeof(tbl));
+    invoice_init(&tbl);
 
     ln_dispatch_t d;
     memset(&d, 0, sizeof(d));
@@ -1618,6 +1622,7 @@ int test_ln_dispatch_boot3_load_three_invoices(void)
     int r = ln_dispatch_load_state(&d);
     ASSERT(r == 3, "BOOT3: load_state returns 3");
     ASSERT(tbl.count == 3, "BOOT3: invoice_table has 3 entries");
+    invoice_free(&tbl);
 
     persist_close(&db);
     return 1;
@@ -1708,6 +1713,56 @@ int test_ln_dispatch_boot6_null_channels_no_crash(void)
     return 1;
 }
 
+/* BOOT7: an invoice that expired unpaid leaves ln_invoices, a settled
+   one stays as the record of payment */
+int test_ln_dispatch_boot7_expired_invoice_deleted(void)
+{
+    persist_t db;
+    ASSERT(persist_open(&db, NULL), "BOOT7: persist_open");
+
+    bolt11_invoice_entry_t unpaid = boot_make_invoice(0x31);
+    bolt11_invoice_entry_t paid   = boot_make_invoice(0x32);
+    ASSERT(persist_save_ln_invoice(&db, &unpaid), "BOOT7: save unpaid");
+    ASSERT(persist_save_ln_invoice(&db, &paid), "BOOT7: save paid");
+
+    bolt11_invoice_table_t tbl;
+    invoice_init(&tbl);
+    ln_dispatch_t d;
+    memset(&d, 0, sizeof(d));
+    d.persist  = (struct persist_t *)&db;
+    d.invoices = &tbl;
+    ASSERT(ln_dispatch_load_state(&d) == 2, "BOOT7: both loaded");
+
+    invoice_settle(&tbl, paid.payment_hash);
+    paid.settled = 1;
+    ASSERT(persist_save_ln_invoice(&db, &paid), "BOOT7: save settled");
+
+    ASSERT(ln_dispatch_expire_invoices(&d, unpaid.created_at + 60) == 0,
+           "BOOT7: nothing due yet");
+    ASSERT(ln_dispatch_expire_invoices(&d, unpaid.created_at + 7200) == 2,
+           "BOOT7: both dropped");
+    ASSERT(tbl.count == 0, "BOOT7: table empty");
+
+    sqlite3_stmt *st;
+    ASSERT(sqlite3_prepare_v2(db.db, "SELECT settled FROM ln_invoices;",
+                              -1, &st, NULL) == SQLITE_OK, "BOOT7: query");
+    ASSERT(sqlite3_step(st) == SQLITE_ROW && sqlite3_column_int(st, 0) == 1,
+           "BOOT7: settled row kept");
+    ASSERT(sqlite3_step(st) == SQLITE_DONE, "BOOT7: unpaid row deleted");
+    sqlite3_finalize(st);
+
+    /* Nothing left to reload at the next start */
+    bolt11_invoice_table_t again;
+    invoice_init(&again);
+    d.invoices = &again;
+    ASSERT(ln_dispatch_load_state(&d) == 0, "BOOT7: nothing reloaded");
+    invoice_free(&again);
+    invoice_free(&tbl);
+
+    persist_close(&db);
+    return 1;
+}
+
 /* ================================================================== */
 /* PR #74: UF1 -- update_fee sets ch->fee_rate_sat_per_kvb            */
 /* ================================================================== */
@@ -1772,3 +1827,237 @@ int test_ln_dispatch_uf3_null_channels(void)
     ASSERT(r == 134, "UF3: NULL peer_channels returns 134, no crash");
     return 1;
 }
+
+/* ================================================================== */
+/* RF1/RF2: relayed HTLCs resolve back upstream                        */
+/* ================================================================== */
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* Two connected peers: 0 upstream, 1 downstream on scid 0x123.  far[i]
+   reads what we send to peer i through rs[i]. */
+typedef struct {
+    peer_mgr_t    pmgr;
+    int           far[2];
+    bolt8_state_t rs[2];
+} rf_peers_t;
+
+static int rf_peers_open(rf_peers_t *rp)
+{
+    memset(rp, 0, sizeof(*rp));
+    for (int i = 0; i < 2; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return 0;
+        peer_entry_t *pe = &rp->pmgr.peers[i];
+        pe->fd = sv[0];
+        rp->far[i] = sv[1];
+        memset(pe->pubkey, 0x02 + i, 33);
+        memset(pe->bolt8.sk, 0x30 + i, 32);
+        memset(pe->bolt8.ck, 0x50 + i, 32);
+        memcpy(rp->rs[i].rk, pe->bolt8.sk, 32);
+        memcpy(rp->rs[i].ck, pe->bolt8.ck, 32);
+    }
+    rp->pmgr.peers[1].channel_scid = 0x123;
+    rp->pmgr.count = 2;
+    return 1;
+}
+
+static void rf_peers_close(rf_peers_t *rp)
+{
+    for (int i = 0; i < 2; i++) {
+        close(rp->pmgr.peers[i].fd);
+        close(rp->far[i]);
+    }
+}
+
+/* Next message we sent to peer i, 0 if none arrives */
+static size_t rf_recv(rf_peers_t *rp, int i, unsigned char *buf, size_t cap)
+{
+    struct pollfd pfd = { rp->far[i], POLLIN, 0 };
+    size_t len = 0;
+    if (poll(&pfd, 1, 1000) != 1 ||
+        !bolt8_recv(&rp->rs[i], rp->far[i], buf, &len, cap))
+        return 0;
+    return len;
+}
+
+/* A forward from peer 0 (htlc 5 on channel 0xAB..) towards scid 0x123,
+   as update_add_htlc processing leaves it */
+static htlc_forward_entry_t *rf_add_forward(htlc_forward_table_t *fwd,
+                                            uint64_t in_htlc_id, uint32_t in_cltv)
+{
+    htlc_forward_entry_t t;
+    memset(&t, 0, sizeof(t));
+    t.in_chan_id      = 0;
+    t.in_htlc_id      = in_htlc_id;
+    t.in_amount_msat  = 101000;
+    t.out_amount_msat = 100000;
+    t.in_cltv         = in_cltv;
+    t.out_cltv        = in_cltv - 40;
+    t.next_hop_scid   = 0x123;
+    t.state           = FORWARD_STATE_PENDING_OUT;
+    memset(t.in_channel_id, 0xAB, 32);
+    memset(t.onion_shared_secret, 0x5C, 32);
+    return htlc_forward_add(fwd, &t);
+}
+
+/* RF1: fulfill from the downstream peer goes out as update_fulfill_htlc
+   on the inbound HTLC, and the forward is released */
+int test_ln_dispatch_relay_fulfill_upstream(void)
+{
+    htlc_forward_table_t fwd;
+    htlc_forward_init(&fwd);
+    rf_peers_t rp;
+    ASSERT(rf_peers_open(&rp), "RF1: socketpairs");
+    ln_dispatch_t d = make_dispatch(NULL, &fwd, NULL);
+    d.pmgr = &rp.pmgr;
+
+    htlc_forward_entry_t *fe = rf_add_forward(&fwd, 5, 800100);
+    ASSERT(fe, "RF1: forward stored");
+    ASSERT(htlc_forward_find_in(&fwd, 0, 5) == fe, "RF1: keyed by inbound peer");
+    /* ln_dispatch_flush_relay after the outbound add on peer 1 got id 9 */
+    htlc_forward_set_inflight(&fwd, fe, 1, 9);
+
+    unsigned char preimage[32], msg[128];
+    memset(preimage, 0x77, 32);
+    size_t len = build_update_fulfill_htlc(msg, 9, preimage);
+    ASSERT(ln_dispatch_process_msg(&d, 1, msg, len) == 130, "RF1: fulfill handled");
+
+    unsigned char up[512];
+    size_t up_len = rf_recv(&rp, 0, up, sizeof(up));
+    ASSERT(up_len == 2 + 32 + 8 + 32, "RF1: upstream message");
+    ASSERT(up[0] == 0 && up[1] == 130, "RF1: update_fulfill_htlc");
+    unsigned char chan[32];
+    memset(chan, 0xAB, 32);
+    ASSERT(memcmp(up + 2, chan, 32) == 0, "RF1: inbound channel_id");
+    ASSERT(up[2 + 32 + 7] == 5, "RF1: inbound htlc_id");
+    ASSERT(memcmp(up + 2 + 40, preimage, 32) == 0, "RF1: preimage");
+    ASSERT(fwd.count == 0, "RF1: forward released");
+
+    /* A fulfill for the same outbound id again matches nothing */
+    ASSERT(ln_dispatch_process_msg(&d, 1, msg, len) == 130, "RF1: duplicate");
+    ASSERT(rf_recv(&rp, 0, up, sizeof(up)) == 0, "RF1: nothing sent twice");
+
+    rf_peers_close(&rp);
+    htlc_forward_free(&fwd);
+    return 1;
+}
+
+/* RF2: a refused outbound add, a downstream update_fail_htlc and an
+   expired never-relayed forward all fail the inbound HTLC back */
+int test_ln_dispatch_relay_fail_upstream(void)
+{
+    secp256k1_context *ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
+    htlc_forward_table_t fwd;
+    htlc_forward_init(&fwd);
+    rf_peers_t rp;
+    ASSERT(rf_peers_open(&rp), "RF2: socketpairs");
+    ln_dispatch_t d = make_dispatch(ctx, &fwd, NULL);
+    d.pmgr = &rp.pmgr;
+
+    /* Downstream channel frozen: the add is refused */
+    channel_t ch;
+    memset(&ch, 0, sizeof(ch));
+    ch.funding_pending_reorg = 1;
+    channel_t *channels[PEER_MGR_MAX_PEERS];
+    memset(channels, 0, sizeof(channels));
+    channels[1] = &ch;
+    d.peer_channels = channels;
+
+    ASSERT(rf_add_forward(&fwd, 5, 800100), "RF2: forward");
+    ASSERT(ln_dispatch_flush_relay(&d) == 0, "RF2: nothing sent");
+    unsigned char up[512];
+    size_t up_len = rf_recv(&rp, 0, up, sizeof(up));
+    ASSERT(up_len == 2 + 32 + 8 + 2 + 256, "RF2: upstream fail");
+    ASSERT(up[0] == 0 && up[1] == 131, "RF2: update_fail_htlc");
+    ASSERT(up[2 + 32 + 7] == 5, "RF2: inbound htlc_id");
+    /* Our own failure: the origin decrypts temporary_channel_failure */
+    unsigned char ss[1][32], plain[256];
+    memset(ss[0], 0x5C, 32);
+    int hop = -1;
+    ASSERT(onion_error_decrypt((const unsigned char (*)[32])ss, 1, ctx,
+                               up + 2 + 32 + 8 + 2, plain, &hop), "RF2: decrypts");
+    ASSERT(hop == 0 && plain[0] == 0 && plain[1] == 2 &&
+           plain[2] == 0x10 && plain[3] == 0x07, "RF2: temporary_channel_failure");
+    ASSERT(fwd.count == 0 && fwd.n_pending == 0, "RF2: released");
+
+    /* Downstream failure is re-encrypted and passed back */
+    htlc_forward_entry_t *fe = rf_add_forward(&fwd, 6, 800100);
+    htlc_forward_set_inflight(&fwd, fe, 1, 3);
+    unsigned char reason[256], msg[512];
+    memset(reason, 0xEE, sizeof(reason));
+    size_t len = build_update_fail_htlc(msg, 3, reason, sizeof(reason));
+    ASSERT(ln_dispatch_process_msg(&d, 1, msg, len) == 131, "RF2: fail handled");
+    up_len = rf_recv(&rp, 0, up, sizeof(up));
+    ASSERT(up_len == 2 + 32 + 8 + 2 + 256 && up[1] == 131, "RF2: fail passed back");
+    ASSERT(up[2 + 32 + 7] == 6, "RF2: inbound htlc_id 6");
+    ASSERT(fwd.count == 0, "RF2: released after fail");
+
+    /* No channel to peer 1 at all: waits, then expires before in_cltv */
+    d.peer_channels = NULL;
+    ASSERT(rf_add_forward(&fwd, 7, 800100), "RF2: pending forward");
+    ASSERT(ln_dispatch_flush_relay(&d) == 0, "RF2: still pending");
+    ASSERT(ln_dispatch_expire_forwards(&d, 800000) == 0, "RF2: not yet due");
+    ASSERT(rf_recv(&rp, 0, up, sizeof(up)) == 0, "RF2: nothing sent early");
+    ASSERT(ln_dispatch_expire_forwards(&d, 800100 - LN_DISPATCH_FORWARD_EXPIRY_MARGIN)
+           == 1, "RF2: expired at the margin");
+    up_len = rf_recv(&rp, 0, up, sizeof(up));
+    ASSERT(up_len > 0 && up[1] == 131 && up[2 + 32 + 7] == 7, "RF2: expiry failed back");
+    ASSERT(fwd.count == 0, "RF2: released after expiry");
+
+    rf_peers_close(&rp);
+    htlc_forward_free(&fwd);
+    secp256k1_context_destroy(ctx);
+    return 1;
+}
+
+/* RF3: the circuit breaker charge taken at update_add is returned when
+   the forward resolves, by fulfill or by expiry */
+int test_ln_dispatch_relay_cb_refund(void)
+{
+    htlc_forward_table_t fwd;
+    htlc_forward_init(&fwd);
+    rf_peers_t rp;
+    ASSERT(rf_peers_open(&rp), "RF3: socketpairs");
+    circuit_breaker_t cb;
+    circuit_breaker_init(&cb);
+    ln_dispatch_t d = make_dispatch(NULL, &fwd, NULL);
+    d.pmgr = &rp.pmgr;
+    d.cb   = &cb;
+
+    /* Charged as update_add_htlc processing does */
+    uint32_t now = (uint32_t)time(NULL);
+    htlc_forward_entry_t *fe[2];
+    for (int i = 0; i < 2; i++) {
+        fe[i] = rf_add_forward(&fwd, 20 + (uint64_t)i, 800100 + (uint32_t)i * 500);
+        ASSERT(fe[i], "RF3: forward");
+        ASSERT(circuit_breaker_check_add_ex(&cb, rp.pmgr.peers[0].pubkey, 0x123,
+                                            fe[i]->in_amount_msat, now), "RF3: admitted");
+        memcpy(fe[i]->cb_peer, rp.pmgr.peers[0].pubkey, 33);
+        fe[i]->cb_scid    = 0x123;
+        fe[i]->cb_charged = 1;
+    }
+    uint16_t n = 0;
+    uint64_t msat = 0;
+    ASSERT(circuit_breaker_get_peer_state(&cb, rp.pmgr.peers[0].pubkey, &n, &msat) &&
+           n == 2 && msat == 202000, "RF3: two charged");
+
+    htlc_forward_set_inflight(&fwd, fe[0], 1, 4);
+    unsigned char preimage[32], msg[128], up[512];
+    memset(preimage, 0x42, 32);
+    size_t len = build_update_fulfill_htlc(msg, 4, preimage);
+    ASSERT(ln_dispatch_process_msg(&d, 1, msg, len) == 130, "RF3: fulfill");
+    ASSERT(rf_recv(&rp, 0, up, sizeof(up)) > 0, "RF3: fulfilled upstream");
+    ASSERT(circuit_breaker_get_peer_state(&cb, rp.pmgr.peers[0].pubkey, &n, &msat) &&
+           n == 1 && msat == 101000, "RF3: refunded on fulfill");
+
+    ASSERT(ln_dispatch_expire_forwards(&d, 800600) == 1, "RF3: expired");
+    ASSERT(circuit_breaker_get_peer_state(&cb, rp.pmgr.peers[0].pubkey, &n, &msat) &&
+           n == 0 && msat == 0, "RF3: refunded on expiry");
+
+    circuit_breaker_free(&cb);
+    rf_peers_close(&rp);
+    htlc_forward_free(&fwd);
+    return 1;
+}
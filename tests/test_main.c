@@ -123,11 +123,17 @@ extern int test_bip158_checkpoint_passthrough(void);
 extern int test_bip158_gcs_build_empty(void);
 extern int test_bip158_gcs_build_round_trip(void);
 extern int test_bip158_compute_filter_header(void);
+extern int test_bip158_hash_batch_matches_scalar(void);
+extern int test_bip158_gcs_large_watch_set(void);
+extern int test_bip158_gcs_long_quotient(void);
 
 /* Phase D: multi-peer */
 extern int test_multi_peer_filter_header_crosscheck(void);
 extern int test_multi_peer_sybil_detection(void);
 extern int test_multi_peer_round_robin(void);
+extern int test_bip158_parallel_scan_ordered(void);
+extern int test_bip158_parallel_scan_bad_peer(void);
+extern int test_bip158_parallel_scan_register_in_cb(void);
 /* PR #64: Mempool cache */
 extern int test_mempool_cache_empty_returns_false(void);
 extern int test_mempool_cache_hit(void);
@@ -203,6 +209,7 @@ extern int test_gossip_waiting_proof_buffer(void);
 extern int test_gossip_rate_limit_token_bucket(void);
 extern int test_gossip_rate_refill(void);
 extern int test_gossip_peer_embargo(void);
+extern int test_gossip_peer_batch_flush(void);
 
 /* PR #19 Commit 5: MPP aggregation */
 extern int test_mpp_single_part(void);
@@ -210,6 +217,7 @@ extern int test_mpp_three_parts(void);
 extern int test_mpp_timeout(void);
 extern int test_mpp_overpayment_guard(void);
 extern int test_mpp_table_full(void);
+extern int test_mpp_table_scale(void);
 
 /* Phase J: LSPS1 order state machine */
 extern int test_lsps1_order_fund_pending(void);
@@ -312,6 +320,7 @@ extern int test_pathfind_mc1_null_mc(void);
 extern int test_pathfind_mc2_empty_mc(void);
 extern int test_pathfind_mc3_penalised_only_path(void);
 extern int test_pathfind_mc4_parallel_paths(void);
+extern int test_pathfind_mc5_liquidity_cost(void);
 /* PR #69: gossip_store -> pathfind_graph_load_from_gossip */
 extern int test_gs_pf1_load_one_edge(void);
 extern int test_gs_pf2_empty_store(void);
@@ -321,6 +330,18 @@ extern int test_pf_cache1_empty_no_crash(void);
 extern int test_pf_cache2_route_found(void);
 extern int test_pf_cache3_reuse_cache(void);
 extern int test_pf_cache4_full_reload_on_stale(void);
+/* Large graphs: dynamic capacity, CSR + heap Dijkstra */
+extern int test_pathfind_large_graph(void);
+extern int test_pathfind_cheapest_longer_path(void);
+/* Live routing graph */
+extern int test_pathfind_live_graph_updates(void);
+extern int test_pathfind_live_graph_remove_many(void);
+/* ALT landmarks / A* */
+extern int test_pathfind_alt_matches_dijkstra(void);
+extern int test_pathfind_alt_staleness(void);
+extern int test_pathfind_mpp_plan_disjoint(void);
+extern int test_pathfind_mpp_plan_random(void);
+extern int test_pathfind_mpp_plan_bounds(void);
 
 /* PR #20 Phase 2: Multi-hop Onion + HTLC Forwarding */
 extern int test_onion_single_hop(void);
@@ -328,6 +349,9 @@ extern int test_onion_two_hops(void);
 extern int test_onion_keysend(void);
 extern int test_onion_amp_tlv14_present(void);
 extern int test_onion_amp_no_tlv14_when_disabled(void);
+extern int test_onion_replay_windows(void);
+extern int test_onion_replay_growth(void);
+extern int test_onion_proc_batch(void);
 extern int test_htlc_forward_final(void);
 extern int test_htlc_forward_settle(void);
 extern int test_htlc_forward_fail(void);
@@ -339,6 +363,8 @@ extern int test_htlc_forward_relay_state_pending(void);
 extern int test_htlc_forward_in_channel_id_field(void);
 extern int test_htlc_forward_find_by_scid_empty(void);
 extern int test_htlc_forward_find_by_scid_found(void);
+extern int test_htlc_forward_scale(void);
+extern int test_htlc_forward_expiry(void);
 
 /* PR #20 Phase 3: Peer Manager + BOLT #2 Channel Open */
 extern int test_peer_mgr_init(void);
@@ -376,6 +402,9 @@ extern int test_payment_pa5_settle_mc_success(void);
 extern int test_payment_pa6_mc_excludes_retry(void);
 extern int test_payment_pa7_bolt4_parse_perm(void);
 extern int test_payment_pa8_null_mc_gi_no_crash(void);
+extern int test_payment_engine_lifecycle(void);
+extern int test_payment_engine_dest_limit(void);
+extern int test_payment_engine_workers(void);
 
 /* PR #60: Payment CLTV fix */
 extern int test_payment_pc1_min_final_cltv_stored(void);
@@ -530,6 +559,9 @@ extern int test_cb_ban_fn_called_on_token_exhaustion(void);
 extern int test_cb_ban_fn_not_called_with_tokens(void);
 extern int test_cb_ban_fn_null_no_crash(void);
 extern int test_cb_ban_fn_repeated_exhaustion(void);
+extern int test_cb_many_peers(void);
+extern int test_cb_channel_limits(void);
+extern int test_cb_lazy_refill(void);
 /* PR #33: BOLT #1 Fundamental Messages */
 extern int test_bolt1_init_roundtrip(void);
 extern int test_bolt1_init_parse_fields(void);
@@ -675,6 +707,10 @@ extern int test_mc_multiple_failures(void);
 extern int test_mc_penalty_scales_with_count(void);
 extern int test_mc_unknown_channel(void);
 extern int test_mc_null_safety(void);
+extern int test_mc_hash_scales(void);
+extern int test_mc_evicts_at_capacity(void);
+extern int test_mc_liquidity_probability(void);
+extern int test_mc_probability_cost(void);
 /* PR #42: Route Policy Enforcement (BOLT #7 channel_update) */
 extern int test_route_policy_fee_ok(void);
 extern int test_route_policy_fee_insufficient(void);
@@ -703,6 +739,7 @@ extern int test_fwd_history_prune(void);
 extern int test_fwd_history_ring_wrap(void);
 extern int test_fwd_history_range_all(void);
 extern int test_fwd_history_null_safety(void);
+extern int test_fwd_history_rollup_windows(void);
 /* PR #44: HTLC Inbound Acceptance (BOLT #4 final-hop validation) */
 extern int test_htlc_accept_ok(void);
 extern int test_htlc_accept_unknown_hash(void);
@@ -731,6 +768,23 @@ extern int test_gossip_ingest_timestamp_filter(void);
 extern int test_gossip_ingest_message_dispatch(void);
 extern int test_gossip_ingest_malformed(void);
 extern int test_gossip_ingest_null_safety(void);
+extern int test_gossip_ingest_updates_live_graph(void);
+extern int test_gossip_ingest_graph_seeds_from_store(void);
+extern int test_gossip_ingest_batch_dedupe(void);
+extern int test_gossip_ingest_batch_matches_serial(void);
+extern int test_gossip_ingest_seen_cache(void);
+extern int test_gossip_log_append_supersede(void);
+extern int test_gossip_log_reopen_torn_tail(void);
+extern int test_gossip_log_compaction(void);
+extern int test_gossip_log_queries_export(void);
+extern int test_gossip_log_ingest(void);
+extern int test_gossip_log_map_growth(void);
+extern int test_rgs_server_delta_cycle(void);
+extern int test_rgs_server_history_seed(void);
+extern int test_rgs_server_ingest(void);
+extern int test_gossip_query_index(void);
+extern int test_gossip_query_reply_chunks(void);
+extern int test_gossip_query_options_ingest(void);
 /* PR #69: gossip_store_enumerate_channels */
 extern int test_ge_en1_enumerate_after_update(void);
 extern int test_ge_en2_enumerate_empty(void);
@@ -855,10 +909,14 @@ extern int test_ln_dispatch_boot4_null_invoices(void);
 /* PR #73: channel restore on boot */
 extern int test_ln_dispatch_boot5_channel_restore(void);
 extern int test_ln_dispatch_boot6_null_channels_no_crash(void);
+extern int test_ln_dispatch_boot7_expired_invoice_deleted(void);
 /* PR #74: update_fee handler */
 extern int test_ln_dispatch_uf1_feerate_updated(void);
 extern int test_ln_dispatch_uf2_truncated_update_fee(void);
 extern int test_ln_dispatch_uf3_null_channels(void);
+extern int test_ln_dispatch_relay_fulfill_upstream(void);
+extern int test_ln_dispatch_relay_fail_upstream(void);
+extern int test_ln_dispatch_relay_cb_refund(void);
 extern int test_ln_dispatch_fulfill(void);
 extern int test_ln_dispatch_unknown_type(void);
 extern int test_ln_dispatch_fail(void);
@@ -903,6 +961,8 @@ extern int test_invoice_claim_double(void);
 extern int test_invoice_claim_expired(void);
 extern int test_invoice_settle(void);
 extern int test_invoice_any_amount(void);
+extern int test_invoice_table_scale(void);
+extern int test_invoice_table_threads(void);
 extern int test_sl2_invoice_has_nonce(void);
 extern int test_sl2_nonce_in_metadata(void);
 extern int test_sl2_from_nonce_check_preimage(void);
@@ -943,6 +1003,8 @@ extern int test_cltv_watchdog_block_cb(void);
 extern int test_cltv_watchdog_block_connected_multi(void);
 extern int test_cltv_watchdog_block_connected_empty(void);
 extern int test_cltv_watchdog_block_connected_mixed(void);
+extern int test_cltv_deadlines_heap(void);
+extern int test_cltv_deadlines_threads(void);
 extern int test_watchtower_init_empty(void);
 extern int test_watchtower_watch_no_breach(void);
 extern int test_watchtower_ready_guard(void);
@@ -1072,6 +1134,7 @@ extern int test_factory_cooperative_close_balances(void);
 extern int test_channel_cooperative_close(void);
 extern int test_channel_unlimited_commitments(void);
 extern int test_channel_dynamic_growth(void);
+extern int test_channel_htlc_index(void);
 extern int test_regtest_factory_coop_close(void);
 extern int test_regtest_channel_coop_close(void);
 
@@ -1271,6 +1334,7 @@ extern int test_lsp_inbound_via_bridge(void);
 extern int test_bridge_register_forward(void);
 extern int test_bridge_set_nk_pubkey(void);
 extern int test_bridge_htlc_timeout(void);
+extern int test_bridge_origin_index(void);
 extern int test_bridge_invoice_bolt11_round_trip(void);
 extern int test_bridge_bolt11_plugin_to_lsp(void);
 extern int test_bridge_preimage_passthrough(void);
@@ -1735,7 +1799,7 @@ extern int test_bridge_keysend_inbound(void);
 extern int test_prop_keysend_wire_roundtrip(void);
 extern int test_prop_keysend_preimage_verify(void);
 extern int test_prop_rebalance_conservation(void);
-extern int test_prop_invoice_registry_exhaustion(void);
+extern int test_prop_invoice_registry_growth(void);
 extern int test_prop_keysend_bridge_e2e(void);
 extern int test_prop_cli_command_fuzzing(void);
 extern int test_prop_batch_rebalance_partial_fail(void);
@@ -1816,6 +1880,9 @@ extern int test_rate_limit_under_limit(void);
 extern int test_rate_limit_over_limit(void);
 extern int test_rate_limit_window_config(void);
 extern int test_rate_limit_handshake_cap(void);
+extern int test_rate_limit_gcra_refill(void);
+extern int test_rate_limit_subnet(void);
+extern int test_rate_limit_many_sources(void);
 
 /* Shell-Free Execution Tests */
 extern int test_regtest_exec_no_shell_interp(void);
@@ -1854,6 +1921,7 @@ extern int test_cb_p1_save_load_limits(void);
 extern int test_cb_p2_save_3_peers(void);
 extern int test_cb_p3_upsert_limits(void);
 extern int test_cb_p4_null_persist(void);
+extern int test_fwd_p1_rollups_roundtrip(void);
 extern int test_ptlc_p1_persist_roundtrip(void);
 extern int test_ptlc_p2_delete(void);
 extern int test_ps_blob1_roundtrip(void);
@@ -2073,11 +2141,17 @@ static void run_unit_tests(void) {
     RUN_TEST(test_bip158_gcs_build_empty);
     RUN_TEST(test_bip158_gcs_build_round_trip);
     RUN_TEST(test_bip158_compute_filter_header);
+    RUN_TEST(test_bip158_hash_batch_matches_scalar);
+    RUN_TEST(test_bip158_gcs_large_watch_set);
+    RUN_TEST(test_bip158_gcs_long_quotient);
 
     printf("\n=== Phase D: Multi-Peer Filter Queries ===\n");
     RUN_TEST(test_multi_peer_filter_header_crosscheck);
     RUN_TEST(test_multi_peer_sybil_detection);
     RUN_TEST(test_multi_peer_round_robin);
+    RUN_TEST(test_bip158_parallel_scan_ordered);
+    RUN_TEST(test_bip158_parallel_scan_bad_peer);
+    RUN_TEST(test_bip158_parallel_scan_register_in_cb);
 
     printf("\n=== PR #64: Mempool Cache (cb_is_in_mempool) ===\n");
     RUN_TEST(test_mempool_cache_empty_returns_false);
@@ -2193,6 +2267,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_gossip_rate_limit_token_bucket);
     RUN_TEST(test_gossip_rate_refill);
     RUN_TEST(test_gossip_peer_embargo);
+    RUN_TEST(test_gossip_peer_batch_flush);
 
     printf("\n=== PR #19: MPP Aggregation ===\n");
     RUN_TEST(test_mpp_single_part);
@@ -2200,6 +2275,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_mpp_timeout);
     RUN_TEST(test_mpp_overpayment_guard);
     RUN_TEST(test_mpp_table_full);
+    RUN_TEST(test_mpp_table_scale);
 
     printf("\n=== PR #19: LSPS2 Deferred Broadcast ===\n");
     RUN_TEST(test_lsps2_deferred_no_immediate_channel);
@@ -2271,6 +2347,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_pathfind_mc2_empty_mc);
     RUN_TEST(test_pathfind_mc3_penalised_only_path);
     RUN_TEST(test_pathfind_mc4_parallel_paths);
+    RUN_TEST(test_pathfind_mc5_liquidity_cost);
     printf("=== PR #69: Gossip-Store -> Pathfind Graph Loading ===\n");
     RUN_TEST(test_gs_pf1_load_one_edge);
     RUN_TEST(test_gs_pf2_empty_store);
@@ -2280,6 +2357,15 @@ static void run_unit_tests(void) {
     RUN_TEST(test_pf_cache2_route_found);
     RUN_TEST(test_pf_cache3_reuse_cache);
     RUN_TEST(test_pf_cache4_full_reload_on_stale);
+    RUN_TEST(test_pathfind_large_graph);
+    RUN_TEST(test_pathfind_cheapest_longer_path);
+    RUN_TEST(test_pathfind_live_graph_updates);
+    RUN_TEST(test_pathfind_live_graph_remove_many);
+    RUN_TEST(test_pathfind_alt_matches_dijkstra);
+    RUN_TEST(test_pathfind_alt_staleness);
+    RUN_TEST(test_pathfind_mpp_plan_disjoint);
+    RUN_TEST(test_pathfind_mpp_plan_random);
+    RUN_TEST(test_pathfind_mpp_plan_bounds);
 
     printf("\n=== Multi-Hop Onion (BOLT #4) ===\n");
     RUN_TEST(test_onion_single_hop);
@@ -2287,6 +2373,9 @@ static void run_unit_tests(void) {
     RUN_TEST(test_onion_keysend);
     RUN_TEST(test_onion_amp_tlv14_present);
     RUN_TEST(test_onion_amp_no_tlv14_when_disabled);
+    RUN_TEST(test_onion_replay_windows);
+    RUN_TEST(test_onion_replay_growth);
+    RUN_TEST(test_onion_proc_batch);
 
     printf("\n=== HTLC Forwarding ===\n");
     RUN_TEST(test_htlc_forward_init);
@@ -2300,6 +2389,8 @@ static void run_unit_tests(void) {
     RUN_TEST(test_htlc_forward_final);
     RUN_TEST(test_htlc_forward_settle);
     RUN_TEST(test_htlc_forward_fail);
+    RUN_TEST(test_htlc_forward_scale);
+    RUN_TEST(test_htlc_forward_expiry);
 
     printf("\n=== Peer Manager ===\n");
     RUN_TEST(test_peer_mgr_init);
@@ -2351,6 +2442,9 @@ static void run_unit_tests(void) {
     RUN_TEST(test_payment_pa6_mc_excludes_retry);
     RUN_TEST(test_payment_pa7_bolt4_parse_perm);
     RUN_TEST(test_payment_pa8_null_mc_gi_no_crash);
+    RUN_TEST(test_payment_engine_lifecycle);
+    RUN_TEST(test_payment_engine_dest_limit);
+    RUN_TEST(test_payment_engine_workers);
 
     printf("\n=== PR #60: Payment CLTV Fix ===\n");
     RUN_TEST(test_payment_pc1_min_final_cltv_stored);
@@ -2520,6 +2614,9 @@ static void run_unit_tests(void) {
     RUN_TEST(test_cb_ban_fn_not_called_with_tokens);
     RUN_TEST(test_cb_ban_fn_null_no_crash);
     RUN_TEST(test_cb_ban_fn_repeated_exhaustion);
+    RUN_TEST(test_cb_many_peers);
+    RUN_TEST(test_cb_channel_limits);
+    RUN_TEST(test_cb_lazy_refill);
 
     printf("\n=== PR #33: BOLT #1 Fundamental Messages ===\n");
     RUN_TEST(test_bolt1_init_roundtrip);
@@ -2660,6 +2757,10 @@ static void run_unit_tests(void) {
     RUN_TEST(test_mc_penalty_scales_with_count);
     RUN_TEST(test_mc_unknown_channel);
     RUN_TEST(test_mc_null_safety);
+    RUN_TEST(test_mc_hash_scales);
+    RUN_TEST(test_mc_evicts_at_capacity);
+    RUN_TEST(test_mc_liquidity_probability);
+    RUN_TEST(test_mc_probability_cost);
 
     printf("\n=== PR #42: Route Policy Enforcement (BOLT #7 channel_update) ===\n");
     RUN_TEST(test_route_policy_fee_ok);
@@ -2690,6 +2791,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_fwd_history_ring_wrap);
     RUN_TEST(test_fwd_history_range_all);
     RUN_TEST(test_fwd_history_null_safety);
+    RUN_TEST(test_fwd_history_rollup_windows);
 
     printf("\n=== PR #44: HTLC Inbound Acceptance (BOLT #4 final-hop) ===\n");
     RUN_TEST(test_htlc_accept_ok);
@@ -2720,6 +2822,23 @@ static void run_unit_tests(void) {
     RUN_TEST(test_gossip_ingest_message_dispatch);
     RUN_TEST(test_gossip_ingest_malformed);
     RUN_TEST(test_gossip_ingest_null_safety);
+    RUN_TEST(test_gossip_ingest_updates_live_graph);
+    RUN_TEST(test_gossip_ingest_graph_seeds_from_store);
+    RUN_TEST(test_gossip_ingest_batch_dedupe);
+    RUN_TEST(test_gossip_ingest_batch_matches_serial);
+    RUN_TEST(test_gossip_ingest_seen_cache);
+    RUN_TEST(test_gossip_log_append_supersede);
+    RUN_TEST(test_gossip_log_reopen_torn_tail);
+    RUN_TEST(test_gossip_log_compaction);
+    RUN_TEST(test_gossip_log_queries_export);
+    RUN_TEST(test_gossip_log_ingest);
+    RUN_TEST(test_gossip_log_map_growth);
+    RUN_TEST(test_rgs_server_delta_cycle);
+    RUN_TEST(test_rgs_server_history_seed);
+    RUN_TEST(test_rgs_server_ingest);
+    RUN_TEST(test_gossip_query_index);
+    RUN_TEST(test_gossip_query_reply_chunks);
+    RUN_TEST(test_gossip_query_options_ingest);
     printf("=== PR #69: gossip_store_enumerate_channels ===\n");
     RUN_TEST(test_ge_en1_enumerate_after_update);
     RUN_TEST(test_ge_en2_enumerate_empty);
@@ -2873,6 +2992,8 @@ static void run_unit_tests(void) {
     RUN_TEST(test_cltv_watchdog_block_connected_multi);
     RUN_TEST(test_cltv_watchdog_block_connected_empty);
     RUN_TEST(test_cltv_watchdog_block_connected_mixed);
+    RUN_TEST(test_cltv_deadlines_heap);
+    RUN_TEST(test_cltv_deadlines_threads);
     RUN_TEST(test_watchtower_init_empty);
     RUN_TEST(test_watchtower_watch_no_breach);
     RUN_TEST(test_watchtower_ready_guard);
@@ -2951,6 +3072,8 @@ static void run_unit_tests(void) {
     RUN_TEST(test_invoice_claim_expired);
     RUN_TEST(test_invoice_settle);
     RUN_TEST(test_invoice_any_amount);
+    RUN_TEST(test_invoice_table_scale);
+    RUN_TEST(test_invoice_table_threads);
 
     printf("\n=== PR #56: Stateless Invoice Level 2 ===\n");
     RUN_TEST(test_sl2_invoice_has_nonce);
@@ -3181,6 +3304,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_bridge_register_forward);
     RUN_TEST(test_bridge_set_nk_pubkey);
     RUN_TEST(test_bridge_htlc_timeout);
+    RUN_TEST(test_bridge_origin_index);
     RUN_TEST(test_bridge_invoice_bolt11_round_trip);
     RUN_TEST(test_bridge_bolt11_plugin_to_lsp);
     RUN_TEST(test_bridge_preimage_passthrough);
@@ -3251,6 +3375,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_fd_table_grows_beyond_16);
     RUN_TEST(test_channel_unlimited_commitments);
     RUN_TEST(test_channel_dynamic_growth);
+    RUN_TEST(test_channel_htlc_index);
 
     printf("\n=== Demo Polish (Phase 17) ===\n");
     RUN_TEST(test_create_invoice_wire);
@@ -3621,7 +3746,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_prop_keysend_wire_roundtrip);
     RUN_TEST(test_prop_keysend_preimage_verify);
     RUN_TEST(test_prop_rebalance_conservation);
-    RUN_TEST(test_prop_invoice_registry_exhaustion);
+    RUN_TEST(test_prop_invoice_registry_growth);
     RUN_TEST(test_prop_keysend_bridge_e2e);
     RUN_TEST(test_prop_cli_command_fuzzing);
     RUN_TEST(test_prop_batch_rebalance_partial_fail);
@@ -3713,6 +3838,9 @@ static void run_unit_tests(void) {
     RUN_TEST(test_rate_limit_over_limit);
     RUN_TEST(test_rate_limit_window_config);
     RUN_TEST(test_rate_limit_handshake_cap);
+    RUN_TEST(test_rate_limit_gcra_refill);
+    RUN_TEST(test_rate_limit_subnet);
+    RUN_TEST(test_rate_limit_many_sources);
 
     printf("\n=== Shell-Free Execution ===\n");
     RUN_TEST(test_regtest_exec_no_shell_interp);
@@ -3751,6 +3879,7 @@ static void run_unit_tests(void) {
     RUN_TEST(test_cb_p2_save_3_peers);
     RUN_TEST(test_cb_p3_upsert_limits);
     RUN_TEST(test_cb_p4_null_persist);
+    RUN_TEST(test_fwd_p1_rollups_roundtrip);
     RUN_TEST(test_ptlc_p1_persist_roundtrip);
     RUN_TEST(test_ptlc_p2_delete);
     RUN_TEST(test_ps_blob1_roundtrip);
@@ -3873,10 +4002,14 @@ static void run_unit_tests(void) {
     /* PR #73: channel restore on boot */
     RUN_TEST(test_ln_dispatch_boot5_channel_restore);
     RUN_TEST(test_ln_dispatch_boot6_null_channels_no_crash);
+    RUN_TEST(test_ln_dispatch_boot7_expired_invoice_deleted);
     /* PR #74: update_fee handler */
     RUN_TEST(test_ln_dispatch_uf1_feerate_updated);
     RUN_TEST(test_ln_dispatch_uf2_truncated_update_fee);
     RUN_TEST(test_ln_dispatch_uf3_null_channels);
+    RUN_TEST(test_ln_dispatch_relay_fulfill_upstream);
+    RUN_TEST(test_ln_dispatch_relay_fail_upstream);
+    RUN_TEST(test_ln_dispatch_relay_cb_refund);
     RUN_TEST(test_queue_ln_dispatch_done_empty);
     RUN_TEST(test_queue_ln_dispatch_done_too_short);
 
@@ -3920,6 +4053,48 @@ static void run_unit_tests(void) {
     RUN_TEST(test_reorg_bip158_callback_fires);
     RUN_TEST(test_reorg_htlc_timeout_no_premature_fail);
     RUN_TEST(test_reorg_bip158_noop);
+
+    printf("\n=== Keep-Alive JSON-RPC Client ===\n");
+    extern int test_rpc_client_keepalive_reuse(void);
+    extern int test_rpc_client_batch_by_id(void);
+    extern int test_rpc_client_stale_reconnect(void);
+    extern int test_rpc_client_chunked_response(void);
+    extern int test_rpc_client_shared_lookup(void);
+    extern int test_rpc_backend_batch_one_trip(void);
+    RUN_TEST(test_rpc_client_keepalive_reuse);
+    RUN_TEST(test_rpc_client_batch_by_id);
+    RUN_TEST(test_rpc_client_stale_reconnect);
+    RUN_TEST(test_rpc_client_chunked_response);
+    RUN_TEST(test_rpc_client_shared_lookup);
+    RUN_TEST(test_rpc_backend_batch_one_trip);
+
+    printf("\n=== Chain Event Bus ===\n");
+    extern int test_chain_events_connect_order(void);
+    extern int test_chain_events_fetch_once(void);
+    extern int test_chain_events_reorg_order(void);
+    extern int test_chain_events_header_only(void);
+    extern int test_chain_events_mempool_mask(void);
+    extern int test_chain_events_shared_cache(void);
+    extern int test_chain_events_deep_rewind(void);
+    RUN_TEST(test_chain_events_connect_order);
+    RUN_TEST(test_chain_events_fetch_once);
+    RUN_TEST(test_chain_events_reorg_order);
+    RUN_TEST(test_chain_events_header_only);
+    RUN_TEST(test_chain_events_mempool_mask);
+    RUN_TEST(test_chain_events_shared_cache);
+    RUN_TEST(test_chain_events_deep_rewind);
+
+    printf("\n=== Block Cache ===\n");
+    extern int test_block_cache_parse_raw(void);
+    extern int test_block_cache_lru_eviction(void);
+    extern int test_block_cache_pinned_survives(void);
+    extern int test_block_cache_txid_only(void);
+    extern int test_block_cache_invalidate_stats(void);
+    RUN_TEST(test_block_cache_parse_raw);
+    RUN_TEST(test_block_cache_lru_eviction);
+    RUN_TEST(test_block_cache_pinned_survives);
+    RUN_TEST(test_block_cache_txid_only);
+    RUN_TEST(test_block_cache_invalidate_stats);
 }
 
 extern int regtest_init_faucet(void);
@@ -2,6 +2,7 @@
  * test_mission_control.c — Tests for payment failure channel scoring
  *
  * PR #41: Mission Control (LDK-style payment failure tracking)
+ * MC15-18: hashed table, eviction, liquidity bounds and probability costs
  */
 
 #include "superscalar/mission_control.h"
@@ -25,6 +26,7 @@ int test_mc_init(void)
     mc_init(&mc);
     ASSERT(mc.count == 0, "count = 0 after init");
     ASSERT(mc_find(&mc, 12345, 0) == NULL, "no entries after init");
+    mc_free(&mc);
     return 1;
 }
 
@@ -40,6 +42,7 @@ int test_mc_record_failure_stores(void)
     ASSERT(e->fail_time == NOW, "fail_time set");
     ASSERT(e->min_fail_msat == 50000, "min_fail_msat set");
     ASSERT(e->fail_count == 1, "fail_count = 1");
+    mc_free(&mc);
     return 1;
 }
 
@@ -53,6 +56,7 @@ int test_mc_is_penalized_recent(void)
     ASSERT(mc_is_penalized(&mc, 2000, 1, 100000, NOW), "penalized immediately after failure");
     /* Query with amount >= min_fail_msat still penalized */
     ASSERT(mc_is_penalized(&mc, 2000, 1, 200000, NOW), "penalized for larger amount");
+    mc_free(&mc);
     return 1;
 }
 
@@ -68,6 +72,7 @@ int test_mc_is_penalized_decayed(void)
     /* Just before decay: still penalized */
     ASSERT(mc_is_penalized(&mc, 3000, 0, 75000, NOW + MC_DECAY_SECS - 1),
            "still penalized just before decay");
+    mc_free(&mc);
     return 1;
 }
 
@@ -81,6 +86,7 @@ int test_mc_success_clears_penalty(void)
 
     mc_record_success(&mc, 4000, 0, 50000, NOW + 100);
     ASSERT(!mc_is_penalized(&mc, 4000, 0, 50000, NOW + 100), "not penalized after success");
+    mc_free(&mc);
     return 1;
 }
 
@@ -97,6 +103,7 @@ int test_mc_amount_threshold(void)
     /* Amount at threshold: penalized */
     ASSERT(mc_is_penalized(&mc, 5000, 0, 100000, NOW),
            "exact failure amount penalized");
+    mc_free(&mc);
     return 1;
 }
 
@@ -109,6 +116,7 @@ int test_mc_direction_independent(void)
 
     ASSERT(mc_is_penalized(&mc, 6000, 0, 50000, NOW), "dir 0 penalized");
     ASSERT(!mc_is_penalized(&mc, 6000, 1, 50000, NOW), "dir 1 not penalized");
+    mc_free(&mc);
     return 1;
 }
 
@@ -126,6 +134,7 @@ int test_mc_penalty_decays(void)
     ASSERT(p0 > 0, "penalty > 0 at t=0");
     ASSERT(p1 < p0, "penalty decreases at half decay");
     ASSERT(p2 == 0, "penalty = 0 at full decay");
+    mc_free(&mc);
     return 1;
 }
 
@@ -142,6 +151,7 @@ int test_mc_prune_stale(void)
     int pruned = mc_prune_stale(&mc, NOW + MC_DECAY_SECS + 1);
     ASSERT(pruned == 2, "2 entries pruned");
     ASSERT(mc.count == 0, "table empty after prune");
+    mc_free(&mc);
     return 1;
 }
 
@@ -157,6 +167,7 @@ int test_mc_prune_keeps_success(void)
     int pruned = mc_prune_stale(&mc, NOW + MC_DECAY_SECS + 1);
     /* success_time > fail_time → not pruned */
     ASSERT(pruned == 0, "not pruned when success after failure");
+    mc_free(&mc);
     return 1;
 }
 
@@ -174,6 +185,7 @@ int test_mc_multiple_failures(void)
     ASSERT(e->fail_count == 3, "fail_count = 3");
     /* min_fail_msat should be 50000 (smallest failure) */
     ASSERT(e->min_fail_msat == 50000, "min_fail_msat updated to smallest");
+    mc_free(&mc);
     return 1;
 }
 
@@ -189,6 +201,7 @@ int test_mc_penalty_scales_with_count(void)
     uint64_t p2 = mc_get_penalty_msat(&mc, 12000, 0, 100000, NOW + 1);
 
     ASSERT(p2 > p1, "penalty increases with fail_count");
+    mc_free(&mc);
     return 1;
 }
 
@@ -201,6 +214,7 @@ int test_mc_unknown_channel(void)
     ASSERT(!mc_is_penalized(&mc, 99999, 0, 50000, NOW), "unknown = not penalized");
     ASSERT(mc_get_penalty_msat(&mc, 99999, 0, 50000, NOW) == 0,
            "unknown = 0 penalty");
+    mc_free(&mc);
     return 1;
 }
 
@@ -217,3 +231,112 @@ int test_mc_null_safety(void)
     mc_find(NULL, 1, 0);
     return 1;
 }
+
+/* MC15: hash table scales past the old fixed array; prune keeps lookups
+ * consistent after swap-removal and backward-shift deletes */
+int test_mc_hash_scales(void)
+{
+    mc_table_t mc;
+    mc_init(&mc);
+    const int n = 200000;
+    for (int i = 0; i < n; i++)
+        mc_record_failure(&mc, 500000 + (uint64_t)(i / 2), i & 1, 10000, NOW);
+    ASSERT(mc.count == n, "all pairs tracked");
+    for (int i = 0; i < n; i += 2)
+        mc_record_success(&mc, 500000 + (uint64_t)(i / 2), 0, 5000, NOW + 10);
+    ASSERT(mc.count == n, "successes update in place");
+
+    int pruned = mc_prune_stale(&mc, NOW + MC_DECAY_SECS + 1);
+    ASSERT(pruned == n / 2, "direction-1 failures pruned");
+    ASSERT(mc.count == n / 2, "half remain");
+    for (int i = 0; i < n; i++) {
+        const mc_entry_t *e = mc_find(&mc, 500000 + (uint64_t)(i / 2), i & 1);
+        ASSERT((e != NULL) == !(i & 1), "only successful direction remains");
+        if (e) ASSERT(e->liq_min_msat == 5000, "lower bound kept");
+    }
+    mc_free(&mc);
+    ASSERT(mc.count == 0 && mc_find(&mc, 500000, 0) == NULL, "empty after free");
+    return 1;
+}
+
+/* MC16: at capacity the least recently updated pair is evicted */
+int test_mc_evicts_at_capacity(void)
+{
+    mc_table_t mc;
+    mc_init(&mc);
+    for (int i = 0; i < MC_MAX_ENTRIES; i++)
+        mc_record_failure(&mc, 1 + (uint64_t)i, 0, 10000, NOW + (uint32_t)(i % 1000));
+    mc_record_failure(&mc, 1, 0, 10000, NOW + 2000);        /* refresh scid 1 */
+    ASSERT(mc.count == MC_MAX_ENTRIES, "full");
+
+    mc_record_failure(&mc, 999999999, 1, 10000, NOW + 2001);
+    ASSERT(mc.count == MC_MAX_ENTRIES, "size bounded");
+    ASSERT(mc_find(&mc, 999999999, 1) != NULL, "new pair tracked");
+    ASSERT(mc_find(&mc, 1, 0) != NULL, "refreshed pair kept");
+    ASSERT(mc_find(&mc, 1001, 0) == NULL, "oldest pair evicted");
+    mc_free(&mc);
+    return 1;
+}
+
+/* MC17: liquidity bounds -> success probability, with decay */
+int test_mc_liquidity_probability(void)
+{
+    mc_table_t mc;
+    mc_init(&mc);
+    const uint64_t cap = 1000000;
+
+    ASSERT(mc_success_probability_ppm(&mc, 42, 0, 250000, cap, NOW) == 750000,
+           "uniform prior for unknown channel");
+    ASSERT(mc_success_probability_ppm(&mc, 42, 0, 250000, 0, NOW) == MC_PROB_PPM_ONE,
+           "no capacity, no history: certain");
+
+    mc_record_failure(&mc, 42, 0, 600000, NOW);
+    ASSERT(mc_success_probability_ppm(&mc, 42, 0, 700000, cap, NOW) == 0,
+           "above failed amount: impossible");
+    uint32_t p = mc_success_probability_ppm(&mc, 42, 0, 300000, cap, NOW);
+    ASSERT(p >= 499000 && p <= 501000, "half of [0, 600k)");
+
+    mc_record_success(&mc, 42, 0, 200000, NOW);
+    ASSERT(mc_success_probability_ppm(&mc, 42, 0, 200000, cap, NOW) == MC_PROB_PPM_ONE,
+           "at known liquidity: certain");
+    p = mc_success_probability_ppm(&mc, 42, 0, 400000, cap, NOW);
+    ASSERT(p >= 499000 && p <= 501000, "half of [200k, 600k)");
+    ASSERT(mc_success_probability_ppm(&mc, 42, 1, 400000, cap, NOW) == 600000,
+           "other direction untouched");
+
+    /* One half-life: upper bound relaxes halfway to capacity, lower
+     * bound halfway to zero. */
+    p = mc_success_probability_ppm(&mc, 42, 0, 700000, cap,
+                                   NOW + MC_LIQ_HALF_LIFE_SECS);
+    ASSERT(p > 0, "decayed upper bound admits more");
+    ASSERT(mc_success_probability_ppm(&mc, 42, 0, 150000, cap,
+                                      NOW + MC_LIQ_HALF_LIFE_SECS) < MC_PROB_PPM_ONE,
+           "decayed lower bound no longer certain");
+    p = mc_success_probability_ppm(&mc, 42, 0, 400000, cap, NOW + 40 * MC_LIQ_HALF_LIFE_SECS);
+    ASSERT(p == 600000, "fully decayed: back to the prior");
+
+    /* A failure below a known success overrides the stale lower bound. */
+    mc_record_failure(&mc, 42, 0, 100000, NOW + 100);
+    ASSERT(mc_success_probability_ppm(&mc, 42, 0, 150000, cap, NOW + 100) == 0,
+           "fresh failure wins");
+    mc_free(&mc);
+    return 1;
+}
+
+/* MC18: probability -> additive routing cost */
+int test_mc_probability_cost(void)
+{
+    uint64_t base = MC_LIQ_PENALTY_BASE_MSAT;
+    ASSERT(mc_probability_cost_msat(MC_PROB_PPM_ONE, 1000) == 0, "certain: free");
+    ASSERT(mc_probability_cost_msat(0, 1000) == UINT64_MAX, "impossible: excluded");
+
+    uint64_t half = mc_probability_cost_msat(500000, 0);
+    uint64_t quarter = mc_probability_cost_msat(250000, 0);
+    ASSERT(half >= base * 99 / 100 && half <= base * 101 / 100, "-log2(1/2) = 1");
+    ASSERT(quarter >= half * 2 - base / 50 && quarter <= half * 2 + base / 50,
+           "costs add like log-probabilities");
+    ASSERT(mc_probability_cost_msat(900000, 0) < half, "likelier is cheaper");
+    ASSERT(mc_probability_cost_msat(500000, 100000000) > half,
+           "amount-scaled component");
+    return 1;
+}
@@ -42,6 +42,7 @@ int test_mpp_single_part(void) {
     ASSERT(mpp_get_parts(&tbl, secret, ids, MPP_MAX_PARTS) == 0,
            "entry removed after mpp_remove");
 
+    mpp_free(&tbl);
     return 1;
 }
 
@@ -70,6 +71,7 @@ int test_mpp_three_parts(void) {
     int n = mpp_get_parts(&tbl, secret, ids, MPP_MAX_PARTS);
     ASSERT(n == 3, "three htlc_ids stored");
 
+    mpp_free(&tbl);
     return 1;
 }
 
@@ -85,21 +87,13 @@ int test_mpp_timeout(void) {
     make_secret(secret, 3);
 
     uint32_t now = 1800000000u;
+    uint32_t then = now - MPP_TIMEOUT_SECS - 1;
 
-    /* Add partial payment (only half collected) */
-    mpp_add_part(&tbl, secret, 3001, 30000, 100000, 700000);
-    mpp_add_part(&tbl, secret, 3002, 30000, 100000, 700001);
+    /* Add partial payment (only half collected), received in the past */
+    mpp_add_part_ex(&tbl, NULL, secret, 3001, 30000, 100000, 700000, then);
+    mpp_add_part_ex(&tbl, NULL, secret, 3002, 30000, 100000, 700001, then);
 
-    /* Force the received timestamp to the past */
-    for (int i = 0; i < MPP_MAX_PAYMENTS; i++) {
-        if (tbl.entries[i].active &&
-            memcmp(tbl.entries[i].payment_secret, secret, 32) == 0) {
-            tbl.entries[i].first_received_unix = now - MPP_TIMEOUT_SECS - 1;
-            break;
-        }
-    }
-
-    uint64_t failed[MPP_MAX_PAYMENTS * MPP_MAX_PARTS];
+    uint64_t failed[2 * MPP_MAX_PARTS];
     int n = mpp_check_timeouts(&tbl, now, failed, (int)(sizeof(failed)/sizeof(failed[0])));
     ASSERT(n == 2, "both parts returned as timed-out htlc_ids");
     ASSERT(failed[0] == 3001 || failed[1] == 3001, "htlc 3001 in failed list");
@@ -110,6 +104,7 @@ int test_mpp_timeout(void) {
     ASSERT(mpp_get_parts(&tbl, secret, ids, MPP_MAX_PARTS) == 0,
            "timed-out entry removed");
 
+    mpp_free(&tbl);
     return 1;
 }
 
@@ -133,11 +128,12 @@ int test_mpp_overpayment_guard(void) {
     int ret = mpp_add_part(&tbl, secret, 4002, 2 * total + 1, total, 700001);
     ASSERT(ret == -1, "overpayment (> 2x total) rejected");
 
+    mpp_free(&tbl);
     return 1;
 }
 
 /* -----------------------------------------------------------------------
- * Table full: 32 concurrent payments, 33rd rejected
+ * Table full: MPP_MAX_PAYMENTS concurrent payments, one more rejected
  * ----------------------------------------------------------------------- */
 
 int test_mpp_table_full(void) {
@@ -156,14 +152,14 @@ int test_mpp_table_full(void) {
         /* Do NOT remove — keep the entry active by re-adding new parts */
     }
 
-    /* 33rd payment with a brand-new secret → table full → -1 */
+    /* One more payment with a brand-new secret → table full → -1 */
     unsigned char extra[32];
     make_secret(extra, 255);
     /* These entries are all complete, so they're still active until removed.
      * We need an incomplete set to keep entries. Let's use a 2-part scenario. */
 
     /* Re-test: fill with incomplete 2-part sets */
-    mpp_init(&tbl);
+    mpp_free(&tbl);
     for (int i = 0; i < MPP_MAX_PAYMENTS; i++) {
         unsigned char secret[32];
         make_secret(secret, 10 + i);
@@ -174,9 +170,116 @@ int test_mpp_table_full(void) {
         ASSERT(ret == 0, "first partial part stored");
     }
 
-    /* Now 33rd distinct secret is rejected */
+    /* Now one more distinct secret is rejected */
     int ret = mpp_add_part(&tbl, extra, 7000, 100000, 100000, 700000);
-    ASSERT(ret == -1, "33rd concurrent payment rejected (table full)");
+    ASSERT(ret == -1, "extra concurrent payment rejected (table full)");
+
+    mpp_free(&tbl);
+    return 1;
+}
+
+/* -----------------------------------------------------------------------
+ * Scale: many open sets, custom limits, hash check, oldest-first timeouts
+ * ----------------------------------------------------------------------- */
+
+int test_mpp_table_scale(void) {
+    enum { N = 5000, PARTS = 40 };
+    mpp_table_t tbl;
+    mpp_init(&tbl);
+    mpp_set_limits(&tbl, N, PARTS, 30);
+
+    uint32_t t0 = 1800000000u;
+    unsigned char secret[32], hash[32];
+
+    /* N incomplete sets, set i opened at t0 + i (inserted newest-last,
+     * but every 7th one back-dated so the heap has to reorder) */
+    for (int i = 0; i < N; i++) {
+        make_secret(secret, i);
+        secret[31] = 0xA5;
+        memset(hash, 0, 32);
+        memcpy(hash, &i, sizeof(i));
+        uint32_t at = (i % 7 == 0) ? t0 - 100000 + (uint32_t)i : t0 + (uint32_t)i;
+        ASSERT(mpp_add_part_ex(&tbl, hash, secret, (uint64_t)i * 100,
+                               1000, 1000000, 700000, at) == 0,
+               "first part stored");
+    }
+    ASSERT(tbl.count == N, "all sets open");
+
+    make_secret(secret, N);
+    secret[31] = 0xA5;
+    ASSERT(mpp_add_part_ex(&tbl, NULL, secret, 1, 1000, 1000000, 700000,
+                           t0) == -1, "max_payments limit applied");
+
+    /* Set 1 grows past the default part limit, up to PARTS */
+    make_secret(secret, 1);
+    secret[31] = 0xA5;
+    int one = 1;
+    memset(hash, 0, 32);
+    memcpy(hash, &one, sizeof(one));
+    for (int j = 1; j < PARTS; j++)
+        ASSERT(mpp_add_part_ex(&tbl, hash, secret, 100 + (uint64_t)j,
+                               1000, 1000000, 700000, t0) == 0,
+               "extra part stored");
+    ASSERT(mpp_add_part_ex(&tbl, hash, secret, 999, 1000, 1000000, 700000,
+                           t0) == -1, "max_parts limit applied");
+    uint64_t ids[PARTS];
+    ASSERT(mpp_get_parts(&tbl, secret, ids, PARTS) == PARTS, "all parts kept");
+    ASSERT(ids[0] == 100 && ids[PARTS - 1] == 100 + PARTS - 1,
+           "parts kept in arrival order");
+
+    /* A part for the same secret but a different payment_hash is refused */
+    hash[0] ^= 1;
+    make_secret(secret, 2);
+    secret[31] = 0xA5;
+    ASSERT(mpp_add_part_ex(&tbl, hash, secret, 7, 1000, 1000000, 700000,
+                           t0) == -1, "payment_hash mismatch rejected");
+
+    /* Only back-dated sets have timed out at t0; a small buffer takes them
+     * whole sets at a time, oldest first */
+    uint64_t failed[8];
+    int n_back = (N + 6) / 7, seen = 0;
+    uint64_t prev = 0;
+    for (;;) {
+        int n = mpp_check_timeouts(&tbl, t0, failed, 8);
+        if (n == 0) break;
+        for (int k = 0; k < n; k++) {
+            ASSERT(failed[k] % 700 == 0, "only back-dated sets time out");
+            ASSERT(seen == 0 || failed[k] > prev, "oldest set first");
+            prev = failed[k];
+            seen++;
+        }
+    }
+    ASSERT(seen == n_back, "every back-dated set failed");
+    ASSERT(tbl.count == N - n_back, "timed-out sets removed");
+
+    /* Freed slots are reused; lookups still hit survivors */
+    make_secret(secret, N + 1);
+    secret[31] = 0xA5;
+    ASSERT(mpp_add_part_ex(&tbl, NULL, secret, 42, 1000, 1000, 700000,
+                           t0) == 1, "new set after timeouts");
+    ASSERT(tbl.n_slots == N, "slot reused, no growth");
+    make_secret(secret, N - 1);
+    secret[31] = 0xA5;
+    ASSERT(mpp_get_parts(&tbl, secret, ids, PARTS) == 1, "survivor found");
+
+    /* Removal keeps the rest consistent */
+    for (int i = 0; i < N; i += 2) {
+        make_secret(secret, i);
+        secret[31] = 0xA5;
+        mpp_remove(&tbl, secret);
+    }
+    for (int i = 1; i < N; i += 2) {
+        make_secret(secret, i);
+        secret[31] = 0xA5;
+        int expect = (i == 1) ? PARTS : (i % 7 == 0) ? 0 : 1;
+        ASSERT(mpp_get_parts(&tbl, secret, ids, PARTS) == expect,
+               "odd sets intact after removing even ones");
+    }
+
+    /* Everything times out eventually, with NULL output just dropping */
+    mpp_check_timeouts(&tbl, t0 + N + 60, NULL, 0);
+    ASSERT(tbl.count == 0, "table drained");
 
+    mpp_free(&tbl);
     return 1;
 }
@@ -0,0 +1,200 @@
+/*
+ * test_onion_proc.c — Unit tests for batched onion peeling and the
+ * shared-secret replay filter
+ *
+ * OP1: test_onion_replay_windows — duplicates across windows, retransmits,
+ *                                  horizon, unknown tip, expiry
+ * OP2: test_onion_replay_growth  — many secrets in one window, no false hits
+ * OP3: test_onion_proc_batch     — batch peel on workers matches onion_peel,
+ *                                  replays and bad onions flagged
+ */
+
+#include "superscalar/onion_proc.h"
+#include "superscalar/onion.h"
+#include <secp256k1.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+static void op_secret(unsigned char ss[32], uint32_t seed) {
+    for (int i = 0; i < 32; i++)
+        ss[i] = (unsigned char)((seed * 2654435761u) >> ((i % 4) * 8)) ^ (unsigned char)i;
+}
+
+/* ---- OP1 ---- */
+int test_onion_replay_windows(void)
+{
+    onion_replay_t rf;
+    onion_replay_init(&rf);
+    unsigned char a[32], b[32], c[32], chan[32];
+    op_secret(a, 1);
+    op_secret(b, 2);
+    op_secret(c, 3);
+    memset(chan, 0xC1, 32);
+    uint64_t ka = onion_replay_htlc_key(chan, 1), kb = onion_replay_htlc_key(chan, 2);
+    ASSERT(ka != kb && ka != 0, "distinct HTLC keys");
+    uint32_t h = 800000;
+
+    ASSERT(onion_replay_check_add(&rf, a, h + 40, h, ka) == ONION_PEEL_OK, "a new");
+    ASSERT(onion_replay_check_add(&rf, a, h + 40, h, kb) == ONION_PEEL_REPLAY,
+           "a replayed on another HTLC");
+    /* The same update_add_htlc retransmitted after a reconnect */
+    ASSERT(onion_replay_check_add(&rf, a, h + 40, h, ka) == ONION_PEEL_OK,
+           "a retransmitted");
+    ASSERT(onion_replay_check_add(&rf, a, h + 40, h, 0) == ONION_PEEL_REPLAY,
+           "a replayed without key");
+    /* Same onion with a different outer cltv_expiry is still a replay
+       while both windows are live */
+    ASSERT(onion_replay_check_add(&rf, b, h + 40, h, kb) == ONION_PEEL_OK, "b new");
+    ASSERT(onion_replay_check_add(&rf, b, h + 40 + 3 * ONION_REPLAY_WINDOW_BLOCKS, h, 0)
+           == ONION_PEEL_REPLAY, "b replayed in another window");
+    ASSERT(rf.n_replays == 3, "three replays counted");
+
+    /* Horizon: already expired, or beyond the kept windows */
+    ASSERT(onion_replay_check_add(&rf, c, h - 2 * ONION_REPLAY_WINDOW_BLOCKS, h, 0)
+           == ONION_PEEL_EXPIRY, "past window refused");
+    ASSERT(onion_replay_check_add(&rf, c,
+                                  h + ONION_REPLAY_WINDOWS * ONION_REPLAY_WINDOW_BLOCKS,
+                                  h, 0)
+           == ONION_PEEL_EXPIRY_FAR, "too far refused");
+
+    /* Tip unknown: checked against what is kept, never recorded */
+    ASSERT(onion_replay_check_add(&rf, a, 5000000, 0, 0) == ONION_PEEL_REPLAY,
+           "replay caught without a tip");
+    ASSERT(onion_replay_check_add(&rf, c, 5000000, 0, 0) == ONION_PEEL_OK, "c passes");
+    ASSERT(onion_replay_check_add(&rf, c, h + 100, h, 0) == ONION_PEEL_OK,
+           "c was not recorded");
+
+    /* A far window recorded later in the slot of b's window */
+    unsigned char d[32];
+    op_secret(d, 4);
+    uint32_t hb = h + 40 + 3 * ONION_REPLAY_WINDOW_BLOCKS;
+    ASSERT(onion_replay_check_add(&rf, d, hb, h, 0) == ONION_PEEL_OK, "d new");
+
+    /* Once the tip passes a window, its secrets are forgotten */
+    uint32_t h2 = h + 41 + ONION_REPLAY_WINDOW_BLOCKS;
+    onion_replay_expire(&rf, h2);
+    ASSERT(onion_replay_check_add(&rf, a, h + 40, h2, 0) == ONION_PEEL_EXPIRY,
+           "expired window not usable");
+    ASSERT(onion_replay_check_add(&rf, a, hb, h2, 0) == ONION_PEEL_OK,
+           "a forgotten with its window");
+    ASSERT(onion_replay_check_add(&rf, d, hb, h2, 0) == ONION_PEEL_REPLAY,
+           "later window kept");
+
+    onion_replay_free(&rf);
+    return 1;
+}
+
+/* ---- OP2 ---- */
+int test_onion_replay_growth(void)
+{
+    onion_replay_t rf;
+    onion_replay_init(&rf);
+    unsigned char ss[32];
+    uint32_t h = 800000, cltv = h + 100;
+    const uint32_t n = 20000;
+
+    for (uint32_t i = 0; i < n; i++) {
+        op_secret(ss, i + 10);
+        ASSERT(onion_replay_check_add(&rf, ss, cltv, h, 0) == ONION_PEEL_OK,
+               "distinct secrets accepted");
+    }
+    for (uint32_t i = 0; i < n; i += 97) {
+        op_secret(ss, i + 10);
+        ASSERT(onion_replay_check_add(&rf, ss, cltv, h, 0) == ONION_PEEL_REPLAY,
+               "recorded secret found after growth");
+    }
+    const onion_replay_window_t *w =
+        &rf.windows[(cltv / ONION_REPLAY_WINDOW_BLOCKS + 1) % ONION_REPLAY_WINDOWS];
+    ASSERT(w->count == n, "one fingerprint per secret");
+    ASSERT(w->cap >= 2 * n && w->cap <= 8 * n, "table at most half full");
+
+    onion_replay_free(&rf);
+    return 1;
+}
+
+/* ---- OP3 ---- */
+int test_onion_proc_batch(void)
+{
+    secp256k1_context *ctx = secp256k1_context_create(
+        SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    ASSERT(ctx, "ctx");
+
+    unsigned char node_priv[32], node_pub[33];
+    memset(node_priv, 0x21, 32);
+    secp256k1_pubkey pub;
+    ASSERT(secp256k1_ec_pubkey_create(ctx, &pub, node_priv), "pub");
+    size_t pub_len = 33;
+    secp256k1_ec_pubkey_serialize(ctx, node_pub, &pub_len, &pub,
+                                  SECP256K1_EC_COMPRESSED);
+
+    enum { N = 24 };
+    unsigned char (*pkts)[ONION_PACKET_SIZE] = malloc(N * sizeof(*pkts));
+    onion_peel_job_t *jobs = calloc(N + 2, sizeof(*jobs));
+    ASSERT(pkts && jobs, "alloc");
+
+    for (int i = 0; i < N; i++) {
+        onion_hop_t hop;
+        memset(&hop, 0, sizeof(hop));
+        memcpy(hop.pubkey, node_pub, 33);
+        hop.amount_msat = 1000 + (uint64_t)i;
+        hop.cltv_expiry = 800100;
+        hop.is_final    = 1;
+        hop.total_msat  = hop.amount_msat;
+        memset(hop.payment_secret, 0x40 + i, 32);
+        unsigned char session_key[32];
+        memset(session_key, 0x60 + i, 32);
+        ASSERT(onion_build(&hop, 1, session_key, ctx, pkts[i]), "build");
+        jobs[i].onion_in    = pkts[i];
+        jobs[i].cltv_expiry = 800100;
+    }
+    /* A replay of onion 3 inside the batch, and a corrupted onion */
+    jobs[N].onion_in    = pkts[3];
+    jobs[N].cltv_expiry = 800100;
+    unsigned char bad[ONION_PACKET_SIZE];
+    memcpy(bad, pkts[5], ONION_PACKET_SIZE);
+    bad[100] ^= 0x01;
+    jobs[N + 1].onion_in    = bad;
+    jobs[N + 1].cltv_expiry = 800100;
+
+    onion_proc_t op;
+    ASSERT(onion_proc_init(&op, ctx, node_priv, 3), "init");
+    onion_proc_set_height(&op, 800000);
+    ASSERT(onion_proc_peel_batch(&op, jobs, N + 2) == N, "N peeled");
+
+    for (int i = 0; i < N; i++) {
+        ASSERT(jobs[i].result == ONION_PEEL_OK, "peeled");
+        unsigned char next[ONION_PACKET_SIZE], ss[32];
+        onion_hop_payload_t payload;
+        int is_final = 0;
+        ASSERT(onion_peel_ex(node_priv, ctx, NULL, pkts[i], next, &payload,
+                             &is_final, ss), "serial peel");
+        ASSERT(jobs[i].is_final == is_final && is_final, "final");
+        ASSERT(jobs[i].payload.amt_to_forward == 1000 + (uint64_t)i, "amount");
+        ASSERT(memcmp(jobs[i].shared_secret, ss, 32) == 0, "shared secret");
+        ASSERT(memcmp(jobs[i].onion_out, next, ONION_PACKET_SIZE) == 0, "next onion");
+    }
+    ASSERT(jobs[N].result == ONION_PEEL_REPLAY, "in-batch replay flagged");
+    ASSERT(jobs[N + 1].result == ONION_PEEL_BAD, "bad HMAC flagged");
+
+    /* A later batch replaying an earlier onion */
+    onion_peel_job_t again;
+    memset(&again, 0, sizeof(again));
+    again.onion_in    = pkts[7];
+    again.cltv_expiry = 800100;
+    ASSERT(onion_proc_peel_batch(&op, &again, 1) == 0, "replay rejected");
+    ASSERT(again.result == ONION_PEEL_REPLAY, "replay across batches");
+
+    onion_proc_free(&op);
+    free(pkts);
+    free(jobs);
+    secp256k1_context_destroy(ctx);
+    return 1;
+}
@@ -7,6 +7,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sqlite3.h>
+#include <time.h>
 
 #define ASSERT(cond, msg) do { \
     if (!(cond)) { \
@@ -182,6 +184,7 @@ int test_pathfind_mc2_empty_mc(void)
     ASSERT(route.n_hops == 2, "two hops");
 
     gossip_store_close(&gs);
+    mc_free(&mc);
     return 1;
 }
 
@@ -209,6 +212,7 @@ int test_pathfind_mc3_penalised_only_path(void)
     ASSERT(ok == 0, "no route when only channel is penalised");
 
     gossip_store_close(&gs);
+    mc_free(&mc);
     return 1;
 }
 
@@ -259,6 +263,62 @@ int test_pathfind_mc4_parallel_paths(void)
     }
 
     gossip_store_close(&gs);
+    mc_free(&mc);
+    return 1;
+}
+
+/* ---- PF_MC5: liquidity estimates steer between parallel paths ----
+ * A -1- B direct (cheapest) and A -3- D -4- B.  A failure at 600k on the
+ * direct hop leaves 500k possible but unlikely, so the longer path wins;
+ * a later 500k success makes the direct hop certain again. */
+int test_pathfind_mc5_liquidity_cost(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "open in-memory store");
+
+    unsigned char pka[33], pkb[33], pkd[33];
+    make_pubkey(pka, 1);
+    make_pubkey(pkb, 2);
+    make_pubkey(pkd, 4);
+    uint32_t now = 1700000000u;
+
+    gossip_store_upsert_node(&gs, pka, "A", "127.0.0.1:9735", now);
+    gossip_store_upsert_node(&gs, pkb, "B", "127.0.0.1:9736", now);
+    gossip_store_upsert_node(&gs, pkd, "D", "127.0.0.1:9738", now);
+    gossip_store_upsert_channel(&gs, 1, pka, pkb, 1000, now);
+    gossip_store_upsert_channel_update(&gs, 1, 0, 1000, 100, 40, now);
+    gossip_store_upsert_channel_update(&gs, 1, 1, 1000, 100, 40, now);
+    gossip_store_upsert_channel(&gs, 3, pka, pkd, 1000, now);
+    gossip_store_upsert_channel_update(&gs, 3, 0, 1000, 100, 40, now);
+    gossip_store_upsert_channel_update(&gs, 3, 1, 1000, 100, 40, now);
+    gossip_store_upsert_channel(&gs, 4, pkd, pkb, 1000, now);
+    gossip_store_upsert_channel_update(&gs, 4, 0, 1000, 100, 40, now);
+    gossip_store_upsert_channel_update(&gs, 4, 1, 1000, 100, 40, now);
+
+    mc_table_t mc;
+    mc_init(&mc);
+    pathfind_route_t route;
+    ASSERT(pathfind_route_ex(&gs, pka, pkb, 500000, now, &mc, &route), "route");
+    ASSERT(route.n_hops == 1 && route.hops[0].scid == 1, "direct hop first");
+    int dir = route.hops[0].direction;
+
+    mc_record_failure(&mc, 1, dir, 600000, now);
+    ASSERT(!mc_is_penalized(&mc, 1, dir, 500000, now), "500k not excluded");
+    ASSERT(pathfind_route_ex(&gs, pka, pkb, 500000, now, &mc, &route), "route");
+    ASSERT(route.n_hops == 2, "likely path preferred over cheap unlikely hop");
+    ASSERT(route.hops[0].scid == 3 && route.hops[1].scid == 4, "via D");
+
+    /* Both bounds have decayed most of the way after four half-lives. */
+    uint32_t later = now + 4 * MC_LIQ_HALF_LIFE_SECS;
+    ASSERT(pathfind_route_ex(&gs, pka, pkb, 500000, later, &mc, &route), "route");
+    ASSERT(route.n_hops == 1, "decayed failure no longer steers");
+
+    mc_record_success(&mc, 1, dir, 500000, now + 10);
+    ASSERT(pathfind_route_ex(&gs, pka, pkb, 500000, now + 10, &mc, &route), "route");
+    ASSERT(route.n_hops == 1 && route.hops[0].scid == 1, "known liquidity: direct");
+
+    gossip_store_close(&gs);
+    mc_free(&mc);
     return 1;
 }
 
@@ -479,3 +539,584 @@ int test_pf_cache4_full_reload_on_stale(void)
     gossip_store_close(&gs);
     return 1;
 }
+
+/* ================================================================== */
+/* Large graphs: no fixed node/edge caps, heap-based Dijkstra         */
+/* ================================================================== */
+
+/* PF_LARGE1: 5002 nodes / 34002 directed edges (past the old 4096/32768
+ * caps).  The destination hangs off the hub via the last channel added. */
+int test_pathfind_large_graph(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "PF_LARGE1: open in-memory store");
+    sqlite3_exec(gs.db, "BEGIN", NULL, NULL, NULL);
+
+    const int n_leaves = 5000;
+    uint32_t now = 1700000000u;
+    unsigned char hub[33], a[33], b[33];
+    make_pubkey(hub, 1);
+
+    /* Hub <-> every leaf, cheap. */
+    for (int i = 0; i < n_leaves; i++) {
+        make_pubkey(a, 10 + i);
+        gossip_store_upsert_channel(&gs, (uint64_t)(1 + i), hub, a, 1000000, now);
+        gossip_store_upsert_channel_update(&gs, (uint64_t)(1 + i), 0, 10, 1, 10, now);
+        gossip_store_upsert_channel_update(&gs, (uint64_t)(1 + i), 1, 10, 1, 10, now);
+    }
+    /* Leaf <-> leaf mesh, expensive. */
+    uint64_t scid = 10001;
+    for (int k = 0; k < 12000; k++) {
+        int i = k % n_leaves;
+        int j = (i * 31 + k * 977 + 1) % n_leaves;
+        if (j == i) j = (j + 1) % n_leaves;
+        make_pubkey(a, 10 + i);
+        make_pubkey(b, 10 + j);
+        gossip_store_upsert_channel(&gs, scid, a, b, 1000000, now);
+        gossip_store_upsert_channel_update(&gs, scid, 0, 5000, 500, 144, now);
+        gossip_store_upsert_channel_update(&gs, scid, 1, 5000, 500, 144, now);
+        scid++;
+    }
+    unsigned char dest[33];
+    make_pubkey(dest, 6000);
+    gossip_store_upsert_channel(&gs, 30000, hub, dest, 1000000, now);
+    gossip_store_upsert_channel_update(&gs, 30000, 0, 10, 1, 10, now);
+    gossip_store_upsert_channel_update(&gs, 30000, 1, 10, 1, 10, now);
+    sqlite3_exec(gs.db, "COMMIT", NULL, NULL, NULL);
+
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "PF_LARGE1: graph alloc");
+    ASSERT(pathfind_graph_load_from_gossip(g, &gs) == 2 * (n_leaves + 12000 + 1),
+           "PF_LARGE1: every directed edge loaded");
+    pathfind_graph_free(g);
+
+    unsigned char src[33];
+    make_pubkey(src, 10 + 4321);
+    pathfind_route_t route;
+    ASSERT(pathfind_route(&gs, src, dest, 100000, &route), "PF_LARGE1: route found");
+    ASSERT(route.n_hops == 2, "PF_LARGE1: leaf -> hub -> dest");
+    ASSERT(route.hops[0].scid == (uint64_t)(1 + 4321), "PF_LARGE1: leaf/hub channel");
+    ASSERT(route.hops[1].scid == 30000, "PF_LARGE1: last-inserted channel used");
+    ASSERT(memcmp(route.hops[1].node_id, dest, 33) == 0, "PF_LARGE1: ends at dest");
+
+    gossip_store_close(&gs);
+    return 1;
+}
+
+/* PF_LARGE2: the cheapest route is the longer one.
+ *   A -> B -> D          (expensive)
+ *   A -> C -> E -> F -> D (cheap)
+ * and a fee update through the cache flips the choice back. */
+int test_pathfind_cheapest_longer_path(void)
+{
+    gossip_store_t gs;
+    ASSERT(gossip_store_open_in_memory(&gs), "PF_LARGE2: open in-memory store");
+
+    unsigned char pk[7][33];
+    for (int i = 1; i <= 6; i++) make_pubkey(pk[i], i);
+    enum { A = 1, B, C, D, E, F };
+    uint32_t now = 1700000000u;
+
+    struct { uint64_t scid; int n1, n2; uint32_t base; } ch[] = {
+        { 1, A, B, 20000 }, { 2, B, D, 20000 },
+        { 3, A, C, 100 }, { 4, C, E, 100 }, { 5, E, F, 100 }, { 6, F, D, 100 },
+    };
+    for (size_t i = 0; i < sizeof(ch) / sizeof(ch[0]); i++) {
+        gossip_store_upsert_channel(&gs, ch[i].scid, pk[ch[i].n1], pk[ch[i].n2],
+                                    1000000, now);
+        gossip_store_upsert_channel_update(&gs, ch[i].scid, 0, ch[i].base, 10, 40, now);
+    }
+
+    pathfind_graph_cache_t *c = pathfind_graph_cache_create();
+    ASSERT(c != NULL, "PF_LARGE2: cache alloc");
+    pathfind_route_t route;
+    ASSERT(pathfind_route_cached(&gs, c, pk[A], pk[D], 50000, now, &route),
+           "PF_LARGE2: route found");
+    ASSERT(route.n_hops == 4, "PF_LARGE2: four cheap hops");
+    ASSERT(route.hops[0].scid == 3 && route.hops[3].scid == 6, "PF_LARGE2: via C/E/F");
+
+    /* Make C -> E expensive; the incremental patch must take effect. */
+    gossip_store_upsert_channel_update(&gs, 4, 0, 90000, 10, 40, now + 5);
+    ASSERT(pathfind_route_cached(&gs, c, pk[A], pk[D], 50000, now + 10, &route),
+           "PF_LARGE2: route after update");
+    ASSERT(route.n_hops == 2, "PF_LARGE2: back to the two-hop route");
+    ASSERT(route.hops[0].scid == 1 && route.hops[1].scid == 2, "PF_LARGE2: via B");
+
+    pathfind_graph_cache_destroy(c);
+    gossip_store_close(&gs);
+    return 1;
+}
+
+/* ================================================================== */
+/* Live routing graph: in-place updates                               */
+/* ================================================================== */
+
+/* PF_LIVE1: fee/disable updates and closures are visible to the next route
+ * without any reload.   A -1- B -2- C   and   A -3- D -4- C */
+int test_pathfind_live_graph_updates(void)
+{
+    unsigned char pa[33], pb[33], pc[33], pd[33];
+    make_pubkey(pa, 1); make_pubkey(pb, 2); make_pubkey(pc, 3); make_pubkey(pd, 4);
+
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "PF_LIVE1: alloc");
+    ASSERT(pathfind_graph_add_channel(g, 1, pa, pb, 100000), "add 1");
+    ASSERT(pathfind_graph_add_channel(g, 2, pb, pc, 100000), "add 2");
+    ASSERT(pathfind_graph_add_channel(g, 3, pa, pd, 100000), "add 3");
+    ASSERT(pathfind_graph_add_channel(g, 4, pd, pc, 100000), "add 4");
+    ASSERT(!pathfind_graph_update_channel(g, 99, 0, 1, 1, 1, 1, 0, 0),
+           "update of unknown scid rejected");
+
+    for (uint64_t s = 1; s <= 4; s++) {
+        uint32_t base = (s <= 2) ? 100 : 500;
+        ASSERT(pathfind_graph_update_channel(g, s, 0, base, 10, 40, 1, 0, 0), "dir 0");
+        ASSERT(pathfind_graph_update_channel(g, s, 1, base, 10, 40, 1, 0, 0), "dir 1");
+    }
+    int nn = 0, nc = 0, ne = 0;
+    pathfind_graph_counts(g, &nn, &nc, &ne);
+    ASSERT(nn == 4 && nc == 4 && ne == 8, "PF_LIVE1: counts");
+
+    pathfind_route_t r;
+    ASSERT(pathfind_graph_route(g, pa, pc, 50000, &r), "route");
+    ASSERT(r.n_hops == 2 && r.hops[0].scid == 1 && r.hops[1].scid == 2, "via B");
+    ASSERT(r.hops[0].htlc_max_msat == 100000000ULL, "htlc_max from capacity");
+
+    /* Disable B->C: the next query goes via D. */
+    ASSERT(pathfind_graph_update_channel(g, 2, 0, 100, 10, 40, 1, 0, 1), "disable");
+    ASSERT(pathfind_graph_route(g, pa, pc, 50000, &r), "route (disabled)");
+    ASSERT(r.hops[0].scid == 3 && r.hops[1].scid == 4, "via D");
+
+    /* Re-enable: back via B. */
+    ASSERT(pathfind_graph_update_channel(g, 2, 0, 100, 10, 40, 1, 0, 0), "enable");
+    ASSERT(pathfind_graph_route(g, pa, pc, 50000, &r), "route (enabled)");
+    ASSERT(r.hops[0].scid == 1, "via B again");
+
+    /* Fee hike on A->B: via D. */
+    ASSERT(pathfind_graph_update_channel(g, 1, 0, 90000, 10, 40, 1, 0, 0), "fee");
+    ASSERT(pathfind_graph_route(g, pa, pc, 50000, &r), "route (fee)");
+    ASSERT(r.hops[0].scid == 3, "fee update visible");
+
+    /* Close D-C: only the expensive path remains. */
+    ASSERT(pathfind_graph_remove_channel(g, 4), "remove 4");
+    ASSERT(!pathfind_graph_remove_channel(g, 4), "remove twice");
+    ASSERT(!pathfind_graph_get_channel(g, 4, NULL, NULL, NULL), "4 gone");
+    ASSERT(pathfind_graph_route(g, pa, pc, 50000, &r), "route (closed)");
+    ASSERT(r.hops[0].scid == 1 && r.hops[1].scid == 2, "via B after close");
+    pathfind_graph_counts(g, &nn, &nc, &ne);
+    ASSERT(nc == 3 && ne == 6, "PF_LIVE1: counts after close");
+
+    /* Re-announcing a known channel keeps its policy. */
+    ASSERT(pathfind_graph_add_channel(g, 1, pa, pb, 0), "re-announce");
+    ASSERT(pathfind_graph_route(g, pa, pb, 50000, &r) && r.hops[0].fee_base_msat == 90000,
+           "policy kept");
+
+    pathfind_graph_free(g);
+    return 1;
+}
+
+/* PF_LIVE2: many closures -- scid lookups and routes stay consistent
+ * after swap-deletes and hash backward shifts. */
+int test_pathfind_live_graph_remove_many(void)
+{
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "PF_LIVE2: alloc");
+
+    const int n = 3000;
+    unsigned char hub[33], leaf[33];
+    make_pubkey(hub, 1);
+    for (int i = 0; i < n; i++) {
+        make_pubkey(leaf, 10 + i);
+        uint64_t scid = ((uint64_t)(700000 + i) << 40) | 1;
+        ASSERT(pathfind_graph_add_channel(g, scid, hub, leaf, 1000), "add");
+        ASSERT(pathfind_graph_update_channel(g, scid, 0, 1, 1, 10, 1, 0, 0), "upd 0");
+        ASSERT(pathfind_graph_update_channel(g, scid, 1, 1, 1, 10, 1, 0, 0), "upd 1");
+    }
+    for (int i = 0; i < n; i += 2)
+        ASSERT(pathfind_graph_remove_channel(g, ((uint64_t)(700000 + i) << 40) | 1),
+               "remove even");
+
+    int nc = 0, ne = 0;
+    pathfind_graph_counts(g, NULL, &nc, &ne);
+    ASSERT(nc == n / 2 && ne == n, "PF_LIVE2: half remain");
+
+    for (int i = 0; i < n; i++) {
+        uint64_t scid = ((uint64_t)(700000 + i) << 40) | 1;
+        unsigned char n1[33], n2[33];
+        int found = pathfind_graph_get_channel(g, scid, n1, n2, NULL);
+        ASSERT(found == (i & 1), "only odd channels remain");
+        if (!found) continue;
+        make_pubkey(leaf, 10 + i);
+        ASSERT(memcmp(n1, hub, 33) == 0 && memcmp(n2, leaf, 33) == 0, "endpoints");
+    }
+
+    unsigned char src[33], dst[33];
+    make_pubkey(src, 10 + 7);
+    make_pubkey(dst, 10 + 2999);
+    pathfind_route_t r;
+    ASSERT(pathfind_graph_route(g, src, dst, 1000, &r), "route between odd leaves");
+    ASSERT(r.n_hops == 2 && r.hops[0].scid == (((uint64_t)700007 << 40) | 1) &&
+           r.hops[1].scid == (((uint64_t)702999 << 40) | 1), "PF_LIVE2: hops");
+    make_pubkey(dst, 10 + 8);
+    ASSERT(!pathfind_graph_route(g, src, dst, 1000, &r), "closed leaf unreachable");
+
+    pathfind_graph_free(g);
+    return 1;
+}
+
+/* ================================================================== */
+/* ALT landmarks: A* must return routes as cheap as plain Dijkstra    */
+/* ================================================================== */
+
+static uint32_t alt_rng_state;
+static uint32_t alt_rng(void)
+{
+    alt_rng_state = alt_rng_state * 1103515245u + 12345u;
+    return alt_rng_state >> 8;
+}
+
+/* Same edge weight as pathfind.c's cost function. */
+static uint64_t route_cost(const pathfind_route_t *r, uint64_t amount_msat)
+{
+    uint64_t c = 0;
+    for (int i = 0; i < r->n_hops; i++) {
+        const pathfind_hop_t *h = &r->hops[i];
+        c += (uint64_t)h->fee_base_msat + (uint64_t)h->fee_ppm * amount_msat / 1000000ULL +
+             (uint64_t)h->cltv_expiry_delta * amount_msat * PATHFIND_RISK_FACTOR /
+             1000000000ULL + 1;
+    }
+    return c;
+}
+
+/* Random graph applied identically to every graph in gs[0..n_g). */
+static int alt_build_random(pathfind_graph_t **gs, int n_g, int n_nodes, int n_chans)
+{
+    alt_rng_state = 12345;
+    for (int k = 0; k < n_chans; k++) {
+        int a = (int)(alt_rng() % (uint32_t)n_nodes);
+        int b = (int)(alt_rng() % (uint32_t)n_nodes);
+        if (a == b) b = (b + 1) % n_nodes;
+        unsigned char pa[33], pb[33];
+        make_pubkey(pa, 100 + a);
+        make_pubkey(pb, 100 + b);
+        uint64_t scid = 1000 + (uint64_t)k;
+        uint32_t base[2], ppm[2]; uint16_t cltv[2];
+        for (int d = 0; d < 2; d++) {
+            base[d] = alt_rng() % 2000;
+            ppm[d]  = alt_rng() % 2000;
+            cltv[d] = (uint16_t)(10 + alt_rng() % 135);
+        }
+        for (int i = 0; i < n_g; i++) {
+            if (!pathfind_graph_add_channel(gs[i], scid, pa, pb, 0)) return 0;
+            for (int d = 0; d < 2; d++)
+                if (!pathfind_graph_update_channel(gs[i], scid, d, base[d], ppm[d],
+                                                   cltv[d], 1, 0, 0))
+                    return 0;
+        }
+    }
+    return 1;
+}
+
+/* Compare n_q random queries on plain vs alt graphs. */
+static int alt_compare(pathfind_graph_t *plain, pathfind_graph_t *alt,
+                       int n_nodes, int n_q, mc_table_t *mc)
+{
+    for (int q = 0; q < n_q; q++) {
+        unsigned char s[33], t[33];
+        int a = (int)(alt_rng() % (uint32_t)n_nodes);
+        int b = (int)(alt_rng() % (uint32_t)n_nodes);
+        if (a == b) continue;
+        make_pubkey(s, 100 + a);
+        make_pubkey(t, 100 + b);
+        uint64_t amt = 1000 + (uint64_t)(alt_rng() % 100000000u);
+        pathfind_route_t r1, r2;
+        int ok1 = pathfind_graph_route_ex(plain, s, t, amt, 800000, mc, &r1);
+        int ok2 = pathfind_graph_route_ex(alt,   s, t, amt, 800000, mc, &r2);
+        if (ok1 != ok2) return 0;
+        if (ok1 && route_cost(&r1, amt) != route_cost(&r2, amt)) return 0;
+    }
+    return 1;
+}
+
+/* PF_ALT1: 1500 nodes / 6000 channels, 80 random queries -- A* costs equal
+ * Dijkstra costs, including with disabled edges, fee increases, closures
+ * and MC exclusions applied after the table was built. */
+int test_pathfind_alt_matches_dijkstra(void)
+{
+    pathfind_graph_t *g[2] = { pathfind_graph_alloc(), pathfind_graph_alloc() };
+    ASSERT(g[0] && g[1], "PF_ALT1: alloc");
+    const int n_nodes = 1500;
+    ASSERT(alt_build_random(g, 2, n_nodes, 6000), "PF_ALT1: build");
+
+    ASSERT(!pathfind_graph_alt_ready(g[1]), "no table yet");
+    ASSERT(pathfind_graph_alt_refresh(g[1], PATHFIND_ALT_LANDMARKS, 0), "refresh");
+    ASSERT(pathfind_graph_alt_ready(g[1]), "table ready");
+    ASSERT(alt_compare(g[0], g[1], n_nodes, 80, NULL), "PF_ALT1: fresh table");
+
+    /* Path-lengthening changes keep the table in use. */
+    for (int k = 0; k < 300; k++) {
+        uint64_t scid = 1000 + (uint64_t)(alt_rng() % 6000u);
+        int d = (int)(alt_rng() & 1);
+        for (int i = 0; i < 2; i++) {
+            if (k % 3 == 0)
+                pathfind_graph_remove_channel(g[i], scid);
+            else
+                pathfind_graph_update_channel(g[i], scid, d, 5000, 5000, 200, 1, 0,
+                                              k % 3 == 1);
+        }
+    }
+    ASSERT(pathfind_graph_alt_ready(g[1]), "still ready after increases/closures");
+    ASSERT(alt_compare(g[0], g[1], n_nodes, 80, NULL), "PF_ALT1: after changes");
+
+    mc_table_t mc;
+    mc_init(&mc);
+    for (int k = 0; k < 40; k++)
+        mc_record_failure(&mc, 1000 + (uint64_t)(alt_rng() % 6000u), 0, 10000,
+                          1700000000u);
+    ASSERT(alt_compare(g[0], g[1], n_nodes, 80, &mc), "PF_ALT1: with MC exclusions");
+
+    pathfind_graph_free(g[0]);
+    pathfind_graph_free(g[1]);
+    mc_free(&mc);
+    return 1;
+}
+
+/* PF_ALT2: path-shortening changes set the table aside (routes stay
+ * optimal) until refreshed; the background refresher restores it. */
+int test_pathfind_alt_staleness(void)
+{
+    pathfind_graph_t *g[2] = { pathfind_graph_alloc(), pathfind_graph_alloc() };
+    ASSERT(g[0] && g[1], "PF_ALT2: alloc");
+    const int n_nodes = 400;
+    ASSERT(alt_build_random(g, 2, n_nodes, 1600), "PF_ALT2: build");
+    ASSERT(pathfind_graph_alt_refresh(g[1], 8, 0), "refresh");
+
+    /* Fee decrease. */
+    for (int i = 0; i < 2; i++)
+        pathfind_graph_update_channel(g[i], 1000, 0, 0, 0, 0, 1, 0, 0);
+    ASSERT(!pathfind_graph_alt_ready(g[1]), "decrease marks table stale");
+    ASSERT(alt_compare(g[0], g[1], n_nodes, 40, NULL), "stale table not used");
+    ASSERT(pathfind_graph_alt_refresh(g[1], 8, 0), "refresh again");
+    ASSERT(pathfind_graph_alt_ready(g[1]), "ready again");
+
+    /* New channel, picked up by the background refresher. */
+    ASSERT(pathfind_graph_alt_start(g[1], 8, 0, 5), "start refresher");
+    unsigned char pa[33], pb[33];
+    make_pubkey(pa, 100 + 1);
+    make_pubkey(pb, 100 + 2);
+    for (int i = 0; i < 2; i++) {
+        pathfind_graph_add_channel(g[i], 999999, pa, pb, 0);
+        pathfind_graph_update_channel(g[i], 999999, 0, 0, 0, 0, 1, 0, 0);
+    }
+    int ready = 0;
+    for (int spin = 0; spin < 400 && !ready; spin++) {
+        struct timespec ts = { 0, 5000000L };
+        nanosleep(&ts, NULL);
+        ready = pathfind_graph_alt_ready(g[1]);
+    }
+    ASSERT(ready, "background refresh installed a new table");
+    ASSERT(alt_compare(g[0], g[1], n_nodes, 40, NULL), "PF_ALT2: after refresh");
+    pathfind_graph_alt_stop(g[1]);
+
+    /* Amounts below the reference amount fall back to Dijkstra. */
+    ASSERT(pathfind_graph_alt_refresh(g[1], 8, 50000000ULL), "refresh at 50k sat");
+    ASSERT(alt_compare(g[0], g[1], n_nodes, 40, NULL), "PF_ALT2: mixed amounts");
+
+    pathfind_graph_free(g[0]);
+    pathfind_graph_free(g[1]);
+    return 1;
+}
+
+/* ================================================================== */
+/* MPP planning: channel-disjoint routes, amounts by bottleneck        */
+/* ================================================================== */
+
+/* Live-graph channel with the same policy both ways (htlc_max = capacity). */
+static int mpp_chan(pathfind_graph_t *g, uint64_t scid, int a, int b,
+                    uint64_t cap_sat, uint32_t fee_base)
+{
+    unsigned char pa[33], pb[33];
+    make_pubkey(pa, a);
+    make_pubkey(pb, b);
+    return pathfind_graph_add_channel(g, scid, pa, pb, cap_sat) &&
+           pathfind_graph_update_channel(g, scid, 0, fee_base, 0, 10, 1, 0, 0) &&
+           pathfind_graph_update_channel(g, scid, 1, fee_base, 0, 10, 1, 0, 0);
+}
+
+static int routes_disjoint(const pathfind_route_t *r, int n)
+{
+    for (int i = 0; i < n; i++)
+        for (int h = 0; h < r[i].n_hops; h++)
+            for (int j = i + 1; j < n; j++)
+                for (int k = 0; k < r[j].n_hops; k++)
+                    if (r[i].hops[h].scid == r[j].hops[k].scid) return 0;
+    return 1;
+}
+
+/* PF_MPP2: S -> M1..M3 -> D, and S -> M4 whose cheapest way on is through
+ * M1 -> D (taken by the M1 route), so M4 is re-searched via E.
+ *   bottlenecks: M1-D 100k, M2-D 200k, M3-D 300k, E-D 50k sat */
+int test_pathfind_mpp_plan_disjoint(void)
+{
+    enum { S = 1, D = 2, M1 = 11, M2 = 12, M3 = 13, M4 = 14, E = 15 };
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "alloc");
+    ASSERT(mpp_chan(g, 1, S, M1, 1000000, 1000) && mpp_chan(g, 2, S, M2, 1000000, 1000) &&
+           mpp_chan(g, 3, S, M3, 1000000, 1000) && mpp_chan(g, 4, S, M4, 1000000, 1000),
+           "first hops");
+    ASSERT(mpp_chan(g, 11, M1, D, 100000, 100) && mpp_chan(g, 12, M2, D, 200000, 200) &&
+           mpp_chan(g, 13, M3, D, 300000, 300), "last hops");
+    ASSERT(mpp_chan(g, 14, M4, M1, 1000000, 10) && mpp_chan(g, 15, M4, E, 1000000, 500) &&
+           mpp_chan(g, 16, E, D, 50000, 500), "M4 detours");
+
+    unsigned char s[33], d[33];
+    make_pubkey(s, S);
+    make_pubkey(d, D);
+    pathfind_route_t routes[8];
+    uint64_t amounts[8];
+    const uint64_t total = 65000000;   /* msat */
+
+    int n = pathfind_graph_mpp_plan(g, s, d, total, 4, 0, NULL, routes, amounts, 8);
+    ASSERT(n == 4, "four parts");
+    ASSERT(routes_disjoint(routes, n), "channel-disjoint");
+    ASSERT(routes[0].n_hops == 2 && routes[0].hops[1].scid == 11, "cheapest first");
+    uint64_t sum = 0, via[17] = { 0 };
+    int dir13 = -1;
+    for (int i = 0; i < n; i++) {
+        const pathfind_hop_t *last = &routes[i].hops[routes[i].n_hops - 1];
+        sum += amounts[i];
+        via[last->scid] = amounts[i];
+        if (last->scid == 13) dir13 = last->direction;
+    }
+    ASSERT(sum == total, "amounts sum to total");
+    ASSERT(routes[3].n_hops == 3 && routes[3].hops[1].scid == 15, "M4 re-searched via E");
+    /* Proportional to 100k : 200k : 300k : 50k sat (to 0.1%). */
+    ASSERT(via[11] > 9990000 && via[11] < 10010000, "M1 share");
+    ASSERT(via[12] > 19980000 && via[12] < 20020000, "M2 share");
+    ASSERT(via[13] > 29970000 && via[13] < 30030000, "M3 share");
+    ASSERT(via[16] > 4995000 && via[16] < 5005000, "E share");
+
+    /* Liquidity history narrows a bottleneck: M3 -> D failed at 20M msat
+     * (above the per-part search amount, so the channel stays usable). */
+    mc_table_t mc;
+    mc_init(&mc);
+    ASSERT(dir13 >= 0, "M3 route seen");
+    mc_record_failure(&mc, 13, dir13, 20000000, 1700000000u);
+    n = pathfind_graph_mpp_plan(g, s, d, total, 4, 1700000000u, &mc, routes, amounts, 8);
+    ASSERT(n == 4, "still four parts");
+    ASSERT(routes_disjoint(routes, n), "disjoint with mc");
+    sum = 0;
+    uint64_t m3 = 0;
+    for (int i = 0; i < n; i++) {
+        sum += amounts[i];
+        if (routes[i].hops[routes[i].n_hops - 1].scid == 13) m3 = amounts[i];
+    }
+    ASSERT(sum == total, "amounts sum to total (mc)");
+    /* 20M : 100M : 200M : 50M -> about 3.5M msat */
+    ASSERT(m3 > 3400000 && m3 < 3600000, "M3 share follows the failure bound");
+
+    /* One part is the plain route. */
+    pathfind_route_t single;
+    ASSERT(pathfind_graph_route(g, s, d, total, &single), "single route");
+    n = pathfind_graph_mpp_plan(g, s, d, total, 1, 0, NULL, routes, amounts, 8);
+    ASSERT(n == 1 && amounts[0] == total, "one part");
+    ASSERT(routes[0].n_hops == single.n_hops &&
+           routes[0].hops[0].scid == single.hops[0].scid &&
+           routes[0].hops[1].scid == single.hops[1].scid, "same as single route");
+
+    mc_free(&mc);
+    pathfind_graph_free(g);
+    return 1;
+}
+
+/* PF_MPP3: on a random graph every plan is channel-disjoint, sums to the
+ * total, and its first route is as cheap as the single-path search. */
+int test_pathfind_mpp_plan_random(void)
+{
+    const int n_nodes = 800;
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "alloc");
+    ASSERT(alt_build_random(&g, 1, n_nodes, 4000), "build");
+
+    int multi = 0;
+    for (int q = 0; q < 60; q++) {
+        unsigned char s[33], t[33];
+        int a = (int)(alt_rng() % (uint32_t)n_nodes);
+        int b = (int)(alt_rng() % (uint32_t)n_nodes);
+        if (a == b) continue;
+        make_pubkey(s, 100 + a);
+        make_pubkey(t, 100 + b);
+        uint64_t total = 100000 + (uint64_t)(alt_rng() % 10000000u);
+
+        pathfind_route_t routes[6], single;
+        uint64_t amounts[6];
+        int n = pathfind_graph_mpp_plan(g, s, t, total, 6, 0, NULL, routes, amounts, 6);
+        int ok = pathfind_graph_route(g, s, t, total / 6 ? total / 6 : 1, &single);
+        ASSERT((n > 0) == ok, "plan exists iff a route exists");
+        if (!n) continue;
+        ASSERT(routes_disjoint(routes, n), "PF_MPP3: disjoint");
+        uint64_t sum = 0;
+        for (int i = 0; i < n; i++) sum += amounts[i];
+        ASSERT(sum == total, "PF_MPP3: sum");
+        ASSERT(route_cost(&routes[0], total / 6) == route_cost(&single, total / 6),
+               "PF_MPP3: first route optimal");
+        if (n > 1) multi++;
+    }
+    ASSERT(multi > 20, "most plans split");
+    pathfind_graph_free(g);
+    return 1;
+}
+
+/* PF_MPP4: final amounts respect each route's bounds.
+ *   a) S-A-D has no known capacity, S-B-D tops out at 12k sat: the split
+ *      that treats them alike is capped on S-B-D, the rest moved to S-A-D.
+ *   b) 20k + 10k sat of capacity cannot carry 40k sat: no plan.
+ *   c) S-E-D demands 3M msat per HTLC but its share is far smaller: the
+ *      route is dropped and S-C-D carries everything. */
+int test_pathfind_mpp_plan_bounds(void)
+{
+    enum { S = 1, D = 2, A = 21, B = 22, C = 23, E = 24 };
+    unsigned char s[33], d[33];
+    make_pubkey(s, S);
+    make_pubkey(d, D);
+    pathfind_route_t routes[8];
+    uint64_t amounts[8];
+
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "alloc a");
+    ASSERT(mpp_chan(g, 1, S, A, 0, 1) && mpp_chan(g, 2, A, D, 0, 1) &&
+           mpp_chan(g, 3, S, B, 0, 1) && mpp_chan(g, 4, B, D, 12000, 1), "channels a");
+    uint64_t total = 30000000;
+    int n = pathfind_graph_mpp_plan(g, s, d, total, 4, 0, NULL, routes, amounts, 8);
+    ASSERT(n == 2, "two parts");
+    uint64_t sum = 0, via_b = 0;
+    for (int i = 0; i < n; i++) {
+        sum += amounts[i];
+        if (routes[i].hops[0].scid == 3) via_b = amounts[i];
+    }
+    ASSERT(sum == total, "sum a");
+    ASSERT(via_b > 0 && via_b + 2 <= 12000000, "S-B-D within its capacity");
+    pathfind_graph_free(g);
+
+    g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "alloc b");
+    ASSERT(mpp_chan(g, 1, S, A, 20000, 1) && mpp_chan(g, 2, A, D, 20000, 1) &&
+           mpp_chan(g, 3, S, B, 10000, 1) && mpp_chan(g, 4, B, D, 10000, 1), "channels b");
+    ASSERT(pathfind_graph_mpp_plan(g, s, d, 40000000, 4, 0, NULL, routes, amounts, 8) == 0,
+           "total beyond capacity");
+    ASSERT(pathfind_graph_mpp_plan(g, s, d, 25000000, 4, 0, NULL, routes, amounts, 8) == 2,
+           "total within capacity");
+    pathfind_graph_free(g);
+
+    g = pathfind_graph_alloc();
+    ASSERT(g != NULL, "alloc c");
+    ASSERT(mpp_chan(g, 1, S, C, 1000000, 1) && mpp_chan(g, 2, C, D, 1000000, 1) &&
+           mpp_chan(g, 3, S, E, 1000000, 5) && mpp_chan(g, 4, E, D, 10000, 5), "channels c");
+    ASSERT(pathfind_graph_update_channel(g, 4, 0, 5, 0, 10, 3000000, 0, 0) &&
+           pathfind_graph_update_channel(g, 4, 1, 5, 0, 10, 3000000, 0, 0), "E-D minimum");
+    total = 20000000;
+    n = pathfind_graph_mpp_plan(g, s, d, total, 2, 0, NULL, routes, amounts, 8);
+    ASSERT(n == 1, "small-share route dropped");
+    ASSERT(routes[0].hops[0].scid == 1 && amounts[0] == total, "S-C-D carries all");
+    pathfind_graph_free(g);
+    return 1;
+}
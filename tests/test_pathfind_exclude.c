@@ -134,6 +134,7 @@ int test_pe_from_mc_penalized(void)
     int added = pathfind_exclude_from_mc(&ex, &mc, 100000, NOW + 1);
     ASSERT(added == 1, "PE6: 1 entry added from penalized mc");
     ASSERT(pathfind_exclude_is_excluded(&ex, scid, 0), "scid excluded");
+    mc_free(&mc);
     return 1;
 }
 
@@ -154,6 +155,7 @@ int test_pe_from_mc_clean(void)
     int added = pathfind_exclude_from_mc(&ex, &mc, 100000, NOW);
     ASSERT(added == 0, "PE7: no entries added for clean mc");
     ASSERT(!pathfind_exclude_is_excluded(&ex, scid, 0), "scid not excluded");
+    mc_free(&mc);
     return 1;
 }
 
@@ -175,6 +177,7 @@ int test_pe_from_mc_success_cleared(void)
 
     int added = pathfind_exclude_from_mc(&ex, &mc, 100000, NOW + 10);
     ASSERT(added == 0, "PE8: success-cleared channel not excluded");
+    mc_free(&mc);
     return 1;
 }
 
@@ -202,6 +205,7 @@ int test_pe_from_mc_amount_threshold(void)
     int added2 = pathfind_exclude_from_mc(&ex, &mc, 100000, NOW + 1);
     ASSERT(added2 == 1, "at threshold, excluded");
     ASSERT(pathfind_exclude_is_excluded(&ex, scid, 0), "scid excluded at threshold");
+    mc_free(&mc);
     return 1;
 }
 
@@ -545,6 +545,7 @@ int test_payment_pa3_update_fail_mc(void)
     payment_on_fail(&pt, NULL, NULL, NULL, NULL, NULL, NULL,
                     pay->payment_hash, plain, 256);
     ASSERT(mc.count > 0, "PA3: MC recorded failure");
+    mc_free(&mc);
     return 1;
 }
 
@@ -591,6 +592,7 @@ int test_payment_pa5_settle_mc_success(void)
     payment_on_settle(&pt, pay->payment_hash, pre);
     ASSERT(pay->state == PAY_STATE_SUCCESS, "PA5: SUCCESS");
     ASSERT(mc.count >= 1,                   "PA5: MC has success entry");
+    mc_free(&mc);
     return 1;
 }
 
@@ -618,6 +620,7 @@ int test_payment_pa6_mc_excludes_retry(void)
                              pay->payment_hash, plain, 256);
     ASSERT(r == 0,                         "PA6: no retry");
     ASSERT(pay->state == PAY_STATE_FAILED, "PA6: FAILED");
+    mc_free(&mc);
     return 1;
 }
 
@@ -0,0 +1,294 @@
+/*
+ * test_payment_engine.c — Unit tests for the concurrent payment engine
+ */
+
+#include "superscalar/payment_engine.h"
+#include "superscalar/pathfind.h"
+#include "superscalar/mission_control.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+static void make_pubkey(unsigned char pk[33], int seed) {
+    memset(pk, 0, 33);
+    pk[0] = 0x02;
+    pk[1] = (unsigned char)seed;
+    pk[2] = (unsigned char)(seed >> 8);
+}
+
+static void make_hash(unsigned char h[32], int seed) {
+    memset(h, 0, 32);
+    h[0] = (unsigned char)seed;
+    h[1] = (unsigned char)(seed >> 8);
+    h[31] = 0x5A;
+}
+
+/* A -1- B -2- C, plus A -3- D -4- C (dearer); D is a dead end otherwise. */
+static pathfind_graph_t *build_graph(void) {
+    unsigned char pa[33], pb[33], pc[33], pd[33];
+    make_pubkey(pa, 1); make_pubkey(pb, 2); make_pubkey(pc, 3); make_pubkey(pd, 4);
+    pathfind_graph_t *g = pathfind_graph_alloc();
+    if (!g) return NULL;
+    pathfind_graph_add_channel(g, 1, pa, pb, 1000000);
+    pathfind_graph_add_channel(g, 2, pb, pc, 1000000);
+    pathfind_graph_add_channel(g, 3, pa, pd, 1000000);
+    pathfind_graph_add_channel(g, 4, pd, pc, 1000000);
+    for (uint64_t s = 1; s <= 4; s++) {
+        uint32_t base = (s <= 2) ? 100 : 500;
+        pathfind_graph_update_channel(g, s, 0, base, 10, 40, 1, 0, 0);
+        pathfind_graph_update_channel(g, s, 1, base, 10, 40, 1, 0, 0);
+    }
+    return g;
+}
+
+typedef struct {
+    int      n_sent;
+    int      fail_sends;
+    uint64_t last_first_scid;
+    int      n_success;
+    int      n_failed;
+    unsigned char last_hash[32];
+} engine_log_t;
+
+/* Sends on peer 0, numbering HTLCs 1, 2, ... */
+static int stub_send(void *ctx, const payment_engine_entry_t *e,
+                     uint32_t final_cltv, unsigned char session_key_out[32],
+                     int *peer_out, uint64_t *htlc_id_out) {
+    engine_log_t *log = (engine_log_t *)ctx;
+    (void)final_cltv;
+    if (log->fail_sends) return 0;
+    log->n_sent++;
+    log->last_first_scid = e->route.hops[0].scid;
+    memset(session_key_out, 0x33, 32);
+    *peer_out = 0;
+    *htlc_id_out = (uint64_t)log->n_sent;
+    return 1;
+}
+
+static void on_result(void *ctx, const payment_engine_entry_t *e) {
+    engine_log_t *log = (engine_log_t *)ctx;
+    if (e->state == PAY_ENGINE_SUCCESS) log->n_success++;
+    else log->n_failed++;
+    memcpy(log->last_hash, e->payment_hash, 32);
+}
+
+static void attach_log(payment_engine_t *pe, engine_log_t *log) {
+    memset(log, 0, sizeof(*log));
+    pe->send = stub_send;
+    pe->send_ctx = log;
+    pe->on_result = on_result;
+    pe->result_ctx = log;
+}
+
+/* PE1: settle, temporary failure with backoff retry, permanent failure,
+ * a timed-out HTLC failing its payment, route exhaustion, routing inline
+ * (no workers). */
+int test_payment_engine_lifecycle(void) {
+    pathfind_graph_t *g = build_graph();
+    ASSERT(g, "graph");
+    mc_table_t mc;
+    mc_init(&mc);
+    unsigned char pa[33], pc[33], nowhere[33];
+    make_pubkey(pa, 1); make_pubkey(pc, 3); make_pubkey(nowhere, 99);
+
+    payment_engine_t pe;
+    ASSERT(payment_engine_init(&pe, g, &mc, pa, 0), "init");
+    payment_engine_set_limits(&pe, 0, 3, 30, 5);
+    engine_log_t log;
+    attach_log(&pe, &log);
+
+    uint32_t now = 1800000000u;
+    unsigned char h1[32], h2[32], h3[32], h4[32];
+    make_hash(h1, 1); make_hash(h2, 2); make_hash(h3, 3); make_hash(h4, 4);
+    ASSERT(payment_engine_pay(&pe, pc, 50000, h1, NULL, NULL, 0, now), "pay 1");
+    ASSERT(payment_engine_pay(&pe, pc, 50000, h2, NULL, NULL, 0, now), "pay 2");
+    ASSERT(payment_engine_pay(&pe, pc, 50000, h3, NULL, NULL, 0, now), "pay 3");
+    ASSERT(!payment_engine_pay(&pe, pc, 50000, h1, NULL, NULL, 0, now),
+           "duplicate unfinished hash rejected");
+    ASSERT(payment_engine_pay(&pe, nowhere, 50000, h4, NULL, NULL, 0, now),
+           "pay to unroutable destination queued");
+    ASSERT(payment_engine_state(&pe, h1) == PAY_ENGINE_ROUTING, "routing");
+
+    ASSERT(payment_engine_tick(&pe, now) == 3, "three HTLCs sent");
+    ASSERT(log.last_first_scid == 1, "cheapest route via B");
+    ASSERT(payment_engine_state(&pe, h1) == PAY_ENGINE_INFLIGHT, "inflight");
+    ASSERT(payment_engine_state(&pe, h4) == PAY_ENGINE_RETRY_WAIT,
+           "no route: retry later");
+
+    /* Settle h1: reported and forgotten */
+    unsigned char pre[32];
+    memset(pre, 0x77, 32);
+    ASSERT(payment_engine_on_settle(&pe, h1, pre, now + 1), "settle");
+    ASSERT(log.n_success == 1 && memcmp(log.last_hash, h1, 32) == 0, "reported");
+    ASSERT(payment_engine_state(&pe, h1) == -1, "finished payment dropped");
+    ASSERT(!payment_engine_on_settle(&pe, h1, pre, now + 1), "settle once");
+    ASSERT(mc_find(&mc, 1, 0) || mc_find(&mc, 1, 1), "success fed to MC");
+
+    /* Temporary channel failure at the first hop: retry after backoff */
+    unsigned char plain[256];
+    memset(plain, 0, sizeof(plain));
+    plain[0] = 0x10; plain[1] = 0x07;   /* TEMPORARY_CHANNEL_FAILURE */
+    ASSERT(payment_engine_on_fail(&pe, h2, plain, 256, now + 1) == 1, "retrying");
+    ASSERT(payment_engine_state(&pe, h2) == PAY_ENGINE_RETRY_WAIT, "backing off");
+    ASSERT(payment_engine_tick(&pe, now + 5) == 0, "not before the delay");
+    ASSERT(payment_engine_state(&pe, h2) == PAY_ENGINE_RETRY_WAIT, "still waiting");
+    payment_engine_tick(&pe, now + 6);     /* delay over: re-routed */
+    ASSERT(payment_engine_tick(&pe, now + 6) == 1, "retry sent");
+    ASSERT(log.last_first_scid == 3, "retry avoids the failed channel");
+
+    /* Permanent failure: no retry */
+    plain[0] = 0x40; plain[1] = 0x09;   /* PERMANENT_CHANNEL_FAILURE */
+    ASSERT(payment_engine_on_fail(&pe, h3, plain, 256, now + 7) == 0, "no retry");
+    ASSERT(log.n_failed == 1 && memcmp(log.last_hash, h3, 32) == 0, "h3 failed");
+
+    /* h2's second HTLC times out: the payment fails without a new HTLC,
+       freeing its destination slot.  h4 never finds a route (attempt
+       limit 3). */
+    uint64_t h2_htlc = (uint64_t)log.n_sent;
+    for (uint32_t t = now + 7; t < now + 200; t++) payment_engine_tick(&pe, t);
+    ASSERT(payment_engine_state(&pe, h2) == -1, "h2 timed out");
+    ASSERT(log.n_sent == 4, "no new HTLC for a timed-out attempt");
+    ASSERT(payment_engine_state(&pe, h4) == -1, "h4 finished");
+    ASSERT(log.n_failed == 3 && pe.count == 0, "h2 and h4 failed");
+
+    plain[0] = 0x10; plain[1] = 0x07;
+    ASSERT(payment_engine_on_fail_htlc(&pe, 0, h2_htlc, plain, 256, now + 200) == 0,
+           "late failure of a timed-out HTLC ignored");
+
+    /* An update_fail_htlc, found by (peer, htlc_id), allows the retry */
+    unsigned char h5[32];
+    make_hash(h5, 5);
+    ASSERT(payment_engine_pay(&pe, pc, 50000, h5, NULL, NULL, 0, now + 200), "pay 5");
+    ASSERT(payment_engine_tick(&pe, now + 200) == 1, "h5 sent");
+    uint64_t h5_htlc = (uint64_t)log.n_sent;
+    ASSERT(payment_engine_on_fail_htlc(&pe, 0, h5_htlc + 1, plain, 256, now + 200) == 0,
+           "unknown HTLC ignored");
+    ASSERT(payment_engine_on_fail_htlc(&pe, 0, h5_htlc, plain, 256, now + 200) == 1,
+           "retry once the HTLC failed");
+    ASSERT(payment_engine_on_fail_htlc(&pe, 0, h5_htlc, plain, 256, now + 200) == 0,
+           "HTLC resolved once");
+    for (uint32_t t = now + 200; t < now + 220; t++) payment_engine_tick(&pe, t);
+    ASSERT(log.n_sent == 6 && payment_engine_state(&pe, h5) == PAY_ENGINE_INFLIGHT,
+           "second attempt sent");
+    plain[0] = 0x40; plain[1] = 0x09;
+    ASSERT(payment_engine_on_fail_htlc(&pe, 0, 6, plain, 256, now + 220) == 0,
+           "permanent failure");
+    ASSERT(payment_engine_state(&pe, h5) == -1 && log.n_failed == 4, "h5 failed");
+    ASSERT(pe.count == 0, "engine empty");
+    ASSERT(pe.n_sent == 6, "three first sends, h2's retry, then two for h5");
+
+    /* A send error counts as a failed attempt */
+    log.fail_sends = 1;
+    ASSERT(payment_engine_pay(&pe, pc, 50000, h1, NULL, NULL, 0, now + 300),
+           "hash reusable after finish");
+    payment_engine_set_limits(&pe, 0, 1, 30, 5);
+    payment_engine_tick(&pe, now + 300);
+    ASSERT(payment_engine_state(&pe, h1) == -1 && log.n_failed == 5,
+           "send failure fails the payment");
+
+    payment_engine_free(&pe);
+    mc_free(&mc);
+    pathfind_graph_free(g);
+    return 1;
+}
+
+/* PE2: per-destination concurrency limit with FIFO hand-over. */
+int test_payment_engine_dest_limit(void) {
+    pathfind_graph_t *g = build_graph();
+    ASSERT(g, "graph");
+    unsigned char pa[33], pb[33], pc[33];
+    make_pubkey(pa, 1); make_pubkey(pb, 2); make_pubkey(pc, 3);
+
+    payment_engine_t pe;
+    ASSERT(payment_engine_init(&pe, g, NULL, pa, 0), "init");
+    payment_engine_set_limits(&pe, 2, 0, 0, 0);
+    engine_log_t log;
+    attach_log(&pe, &log);
+
+    uint32_t now = 1800000000u;
+    unsigned char h[8][32];
+    for (int i = 0; i < 5; i++) {
+        make_hash(h[i], 10 + i);
+        ASSERT(payment_engine_pay(&pe, pc, 1000, h[i], NULL, NULL, 0, now), "pay C");
+    }
+    make_hash(h[5], 20);
+    ASSERT(payment_engine_pay(&pe, pb, 1000, h[5], NULL, NULL, 0, now), "pay B");
+
+    ASSERT(payment_engine_tick(&pe, now) == 3, "two to C, one to B");
+    ASSERT(payment_engine_state(&pe, h[2]) == PAY_ENGINE_QUEUED, "third C queued");
+    ASSERT(payment_engine_state(&pe, h[4]) == PAY_ENGINE_QUEUED, "fifth C queued");
+
+    ASSERT(payment_engine_on_settle(&pe, h[0], NULL, now), "settle C #1");
+    ASSERT(payment_engine_state(&pe, h[2]) == PAY_ENGINE_ROUTING, "FIFO hand-over");
+    ASSERT(payment_engine_state(&pe, h[3]) == PAY_ENGINE_QUEUED, "others wait");
+    ASSERT(payment_engine_tick(&pe, now) == 1, "one more to C");
+
+    ASSERT(payment_engine_on_settle(&pe, h[5], NULL, now), "settle B");
+    ASSERT(payment_engine_tick(&pe, now) == 0, "B's slot does not serve C");
+
+    for (int i = 1; i < 5; i++) {
+        payment_engine_on_settle(&pe, h[i], NULL, now);
+        payment_engine_tick(&pe, now);
+    }
+    ASSERT(log.n_success == 6 && pe.count == 0, "all settled");
+    ASSERT(log.n_sent == 6, "each sent once");
+
+    payment_engine_free(&pe);
+    pathfind_graph_free(g);
+    return 1;
+}
+
+/* PE3: thousands of payments routed on worker threads. */
+int test_payment_engine_workers(void) {
+    enum { N = 2000 };
+    pathfind_graph_t *g = build_graph();
+    ASSERT(g, "graph");
+    mc_table_t mc;
+    mc_init(&mc);
+    unsigned char pa[33], pb[33], pc[33], pd[33];
+    make_pubkey(pa, 1); make_pubkey(pb, 2); make_pubkey(pc, 3); make_pubkey(pd, 4);
+    const unsigned char *dests[3] = { pb, pc, pd };
+
+    payment_engine_t pe;
+    ASSERT(payment_engine_init(&pe, g, &mc, pa, PAYMENT_ENGINE_WORKERS), "init");
+    payment_engine_set_limits(&pe, 64, 0, 0, 0);
+    engine_log_t log;
+    attach_log(&pe, &log);
+
+    uint32_t now = 1800000000u;
+    for (int i = 0; i < N; i++) {
+        unsigned char hash[32];
+        make_hash(hash, i);
+        ASSERT(payment_engine_pay(&pe, dests[i % 3], 1000 + (uint64_t)i, hash,
+                                  NULL, NULL, 0, now), "pay");
+    }
+    ASSERT(pe.count == N, "all queued");
+
+    /* Settle whatever is in flight until everything has gone through */
+    struct timespec nap = { 0, 1000000 };
+    for (int round = 0; round < 20000 && log.n_success < N; round++) {
+        if (!payment_engine_tick(&pe, now)) nanosleep(&nap, NULL);
+        for (int i = 0; i < N; i++) {
+            unsigned char hash[32];
+            make_hash(hash, i);
+            if (payment_engine_state(&pe, hash) == PAY_ENGINE_INFLIGHT)
+                payment_engine_on_settle(&pe, hash, NULL, now);
+        }
+    }
+    ASSERT(log.n_success == N, "every payment settled");
+    ASSERT(log.n_sent == N && log.n_failed == 0, "one attempt each");
+    ASSERT(pe.count == 0 && pe.heap_len == 0, "engine drained");
+
+    payment_engine_free(&pe);
+    mc_free(&mc);
+    pathfind_graph_free(g);
+    return 1;
+}
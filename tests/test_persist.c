@@ -2865,12 +2865,13 @@ int test_ps_n1_save_load_invoice(void) {
     TEST_ASSERT(persist_save_ln_invoice(&db, &inv), "save invoice");
 
     bolt11_invoice_table_t tbl;
-    memset(&tbl, 0, sizeof(tbl));
+    invoice_init(&tbl);
     int n = persist_load_ln_invoices(&db, &tbl);
     TEST_ASSERT(n >= 0, "load ok");
     TEST_ASSERT_EQ(tbl.count, 1, "count == 1");
     TEST_ASSERT(memcmp(tbl.entries[0].payment_hash, inv.payment_hash, 32) == 0,
                 "payment_hash matches");
+    invoice_free(&tbl);
 
     persist_close(&db);
     return 1;
@@ -2887,10 +2888,11 @@ int test_ps_n2_save_3_invoices(void) {
     }
 
     bolt11_invoice_table_t tbl;
-    memset(&tbl, 0, sizeof(tbl));
+    invoice_init(&tbl);
     int n = persist_load_ln_invoices(&db, &tbl);
     TEST_ASSERT(n >= 0, "load ok");
     TEST_ASSERT_EQ(tbl.count, 3, "count == 3");
+    invoice_free(&tbl);
 
     persist_close(&db);
     return 1;
@@ -2906,10 +2908,11 @@ int test_ps_n3_delete_invoice(void) {
     TEST_ASSERT(persist_delete_ln_invoice(&db, inv.payment_hash), "delete invoice");
 
     bolt11_invoice_table_t tbl;
-    memset(&tbl, 0, sizeof(tbl));
+    invoice_init(&tbl);
     int n = persist_load_ln_invoices(&db, &tbl);
     TEST_ASSERT(n >= 0, "load ok");
     TEST_ASSERT_EQ(tbl.count, 0, "count == 0 after delete");
+    invoice_free(&tbl);
 
     persist_close(&db);
     return 1;
@@ -2926,11 +2929,12 @@ int test_ps_n4_upsert_invoice(void) {
     TEST_ASSERT(persist_save_ln_invoice(&db, &inv), "save second (upsert)");
 
     bolt11_invoice_table_t tbl;
-    memset(&tbl, 0, sizeof(tbl));
+    invoice_init(&tbl);
     int n = persist_load_ln_invoices(&db, &tbl);
     TEST_ASSERT(n >= 0, "load ok");
     TEST_ASSERT_EQ(tbl.count, 1, "count == 1 after upsert");
     TEST_ASSERT_EQ((long long)tbl.entries[0].amount_msat, 999999LL, "updated amount");
+    invoice_free(&tbl);
 
     persist_close(&db);
     return 1;
@@ -3194,6 +3198,7 @@ int test_cb_p1_save_load_limits(void) {
     }
     TEST_ASSERT(found, "CB_P1: peer slot found in circuit breaker");
 
+    circuit_breaker_free(&cb);
     persist_close(&db);
     return 1;
 }
@@ -3221,6 +3226,7 @@ int test_cb_p2_save_3_peers(void) {
     TEST_ASSERT(n == 3, "CB_P2: loaded 3 peers");
     TEST_ASSERT(cb.n_peers == 3, "CB_P2: n_peers == 3");
 
+    circuit_breaker_free(&cb);
     persist_close(&db);
     return 1;
 }
@@ -3255,6 +3261,7 @@ int test_cb_p3_upsert_limits(void) {
     }
     TEST_ASSERT(found, "CB_P3: upserted peer found");
 
+    circuit_breaker_free(&cb);
     persist_close(&db);
     return 1;
 }
@@ -3273,6 +3280,79 @@ int test_cb_p4_null_persist(void) {
     return 1;
 }
 
+/* ==========================================================================
+ * Forwarding rollup persistence (FWD_P1)
+ * ========================================================================== */
+
+/* FWD_P1: save rollups -> reload into a fresh history -> same statistics;
+   only changed buckets are rewritten and expired minute rows are deleted */
+int test_fwd_p1_rollups_roundtrip(void) {
+    persist_t db;
+    TEST_ASSERT(persist_open(&db, NULL), "FWD_P1: open");
+
+    const uint32_t day0 = 1700000000u / 86400 * 86400;
+    unsigned char hash[32] = {0};
+    fwd_history_t h;
+    fwd_history_init(&h);
+    /* One forward every 10 minutes for 3 days; every fifth fails */
+    for (uint32_t i = 0; i < 3 * 144; i++)
+        fwd_history_add(&h, (i & 1) ? 3 : 1, 2, 101000, 100000, day0 + i * 600,
+                        hash, (i % 5 == 4) ? FWD_STATUS_FAILED : FWD_STATUS_SETTLED);
+
+    int n = persist_save_fwd_rollups(&db, &h);
+    TEST_ASSERT(n > 0, "FWD_P1: buckets written");
+    TEST_ASSERT_EQ(persist_save_fwd_rollups(&db, &h), 0, "FWD_P1: nothing dirty");
+
+    /* A new minute: 4 series (node, both sides, pair) x 3 levels */
+    uint32_t last = day0 + 3 * 86400 - 60;
+    fwd_history_add(&h, 1, 2, 101000, 100000, last, hash, FWD_STATUS_SETTLED);
+    TEST_ASSERT_EQ(persist_save_fwd_rollups(&db, &h), 12, "FWD_P1: 12 dirty buckets");
+
+    fwd_history_t h2;
+    fwd_history_init(&h2);
+    TEST_ASSERT(persist_load_fwd_rollups(&db, &h2) > 0, "FWD_P1: load");
+
+    fwd_rollup_t a, b;
+    TEST_ASSERT(fwd_history_stats(&h2, 0, 0, 0, 0, &b), "FWD_P1: node totals");
+    fwd_history_stats(&h, 0, 0, 0, 0, &a);
+    TEST_ASSERT(memcmp(&a, &b, sizeof(a)) == 0, "FWD_P1: all-time totals match");
+    uint32_t windows[3][2] = {
+        { last - 3600, 0 },                     /* minute tier */
+        { day0 + 86400, day0 + 2 * 86400 - 1 }, /* day 1 */
+        { day0 + 3600, day0 + 3 * 3600 - 1 },   /* hour tier */
+    };
+    for (int w = 0; w < 3; w++) {
+        fwd_history_stats(&h, 3, 2, windows[w][0], windows[w][1], &a);
+        fwd_history_stats(&h2, 3, 2, windows[w][0], windows[w][1], &b);
+        TEST_ASSERT(a.n_settled > 0, "FWD_P1: window has forwards");
+        TEST_ASSERT(memcmp(&a, &b, sizeof(a)) == 0, "FWD_P1: window matches");
+    }
+    TEST_ASSERT_EQ(fwd_history_failure_rate_ppm(&h2, 2, 0, 0),
+                   fwd_history_failure_rate_ppm(&h, 2, 0, 0),
+                   "FWD_P1: failure rate");
+    fwd_history_free(&h2);
+
+    /* Two days later the old minute buckets are dropped from the DB too */
+    fwd_history_add(&h, 1, 2, 101000, 100000, last + 2 * 86400, hash,
+                    FWD_STATUS_SETTLED);
+    TEST_ASSERT(persist_save_fwd_rollups(&db, &h) == 12, "FWD_P1: save again");
+    sqlite3_stmt *stmt;
+    TEST_ASSERT(sqlite3_prepare_v2(db.db,
+                    "SELECT COUNT(*) FROM fwd_rollups WHERE level = 0;",
+                    -1, &stmt, NULL) == SQLITE_OK, "FWD_P1: prepare");
+    TEST_ASSERT(sqlite3_step(stmt) == SQLITE_ROW, "FWD_P1: step");
+    int n_minute = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    TEST_ASSERT_EQ(n_minute, 4, "FWD_P1: only the newest minute kept");
+
+    TEST_ASSERT_EQ(persist_save_fwd_rollups(NULL, &h), -1, "FWD_P1: NULL persist");
+    TEST_ASSERT_EQ(persist_load_fwd_rollups(&db, NULL), -1, "FWD_P1: NULL history");
+
+    fwd_history_free(&h);
+    persist_close(&db);
+    return 1;
+}
+
 /* ==========================================================================
  * PR #78 tests: PTLC persistence, peer storage, RGS export,
  * BIP 353, dynamic commitments, BIP 158 RPC elimination
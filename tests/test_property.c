@@ -680,7 +680,7 @@ int test_prop_keysend_preimage_verify(void) {
     }
 
     free(mgr.entries);
-    free(mgr.invoices);
+    lsp_channels_free_invoices(&mgr);
     secp256k1_context_destroy(ctx);
     return 1;
 }
@@ -742,9 +742,10 @@ int test_prop_rebalance_conservation(void) {
     return 1;
 }
 
-/* Test 4: Invoice registry exhaustion.
-   Fill all 64 slots, verify 65th returns 0, verify keysend fails gracefully. */
-int test_prop_invoice_registry_exhaustion(void) {
+/* Test 4: Invoice registry growth.
+   Register well past the initial capacity; every insert succeeds, the
+   registry grows, and lookups and slot reuse still work. */
+int test_prop_invoice_registry_growth(void) {
     secp256k1_context *ctx = secp256k1_context_create(
         SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
 
@@ -756,9 +757,10 @@ int test_prop_invoice_registry_exhaustion(void) {
     mgr.invoices = calloc(MAX_INVOICE_REGISTRY, sizeof(invoice_entry_t));
     mgr.invoices_cap = MAX_INVOICE_REGISTRY;
 
-    /* Fill all slots */
+    /* Fill four times the initial capacity */
+    const int n_reg = 4 * MAX_INVOICE_REGISTRY;
     unsigned int seed = 55;
-    for (int i = 0; i < (int)mgr.invoices_cap; i++) {
+    for (int i = 0; i < n_reg; i++) {
         unsigned char pre[32], hash[32];
         for (int j = 0; j < 32; j++)
             pre[j] = (unsigned char)(rand_r(&seed) & 0xff);
@@ -766,30 +768,12 @@ int test_prop_invoice_registry_exhaustion(void) {
         int ok = lsp_channels_register_invoice(&mgr, hash, pre, i % 4, 50000);
         TEST_ASSERT(ok, "register should succeed");
     }
-    TEST_ASSERT_EQ((long)mgr.n_invoices, (long)mgr.invoices_cap,
-                   "should be full");
-
-    /* 65th should fail */
-    {
-        unsigned char pre[32], hash[32];
-        memset(pre, 0xEE, 32);
-        sha256(pre, 32, hash);
-        int ok = lsp_channels_register_invoice(&mgr, hash, pre, 0, 50000);
-        TEST_ASSERT(!ok, "65th register should fail");
-    }
-
-    /* Keysend-style registration also fails when full */
-    {
-        unsigned char pre[32], hash[32];
-        memset(pre, 0xDD, 32);
-        sha256(pre, 32, hash);
-        int ok = lsp_channels_register_invoice(&mgr, hash, pre, 0, 10000);
-        TEST_ASSERT(!ok, "keysend register when full should fail");
-    }
+    TEST_ASSERT_EQ((long)mgr.n_invoices, (long)n_reg, "all registered");
+    TEST_ASSERT(mgr.invoices_cap >= (size_t)n_reg, "registry grew");
 
     /* Verify all original invoices are still lookupable */
     seed = 55;  /* reset seed to regenerate same hashes */
-    for (int i = 0; i < (int)mgr.invoices_cap; i++) {
+    for (int i = 0; i < n_reg; i++) {
         unsigned char pre[32], hash[32];
         for (int j = 0; j < 32; j++)
             pre[j] = (unsigned char)(rand_r(&seed) & 0xff);
@@ -800,16 +784,28 @@ int test_prop_invoice_registry_exhaustion(void) {
         TEST_ASSERT_EQ((long)dest, (long)(i % 4), "dest mismatch");
     }
 
-    /* Deactivate one and verify it's no longer found */
-    mgr.invoices[0].active = 0;
+    /* Deactivate half: no longer found, and the next registration
+       reuses one of their slots instead of growing */
+    size_t cap = mgr.invoices_cap;
+    for (size_t i = 0; i < mgr.n_invoices; i += 2)
+        mgr.invoices[i].active = 0;
     {
         size_t dest;
         int ok = lsp_channels_lookup_invoice(&mgr, mgr.invoices[0].payment_hash,
                     &dest);
         TEST_ASSERT(!ok, "deactivated invoice should not be found");
+
+        unsigned char pre[32], hash[32];
+        memset(pre, 0xDD, 32);
+        sha256(pre, 32, hash);
+        TEST_ASSERT(lsp_channels_register_invoice(&mgr, hash, pre, 3, 10000),
+                    "register after deactivation");
+        TEST_ASSERT_EQ((long)mgr.invoices_cap, (long)cap, "inactive slot reused");
+        TEST_ASSERT(lsp_channels_lookup_invoice(&mgr, hash, &dest), "new invoice found");
+        TEST_ASSERT_EQ((long)dest, 3L, "new invoice dest");
     }
 
-    free(mgr.invoices);
+    lsp_channels_free_invoices(&mgr);
     secp256k1_context_destroy(ctx);
     return 1;
 }
@@ -900,6 +896,7 @@ int test_prop_keysend_bridge_e2e(void) {
 
         cJSON_Delete(recv_msg.json);
         cJSON_Delete(ful_recv.json);
+        free(mgr.invoice_by_hash);
     }
 
     free(invoices_buf);
@@ -982,8 +979,8 @@ int test_prop_cli_command_fuzzing(void) {
         "pay \x00hidden", &shutdown_flag);
 
     free(mgr.entries);
-    free(mgr.invoices);
-    free(mgr.htlc_origins);
+    lsp_channels_free_invoices(&mgr);
+    lsp_channels_free_bridge_origins(&mgr);
     free(lsp->client_fds);
     free(lsp->client_pubkeys);
     free(lsp);
@@ -1125,6 +1122,7 @@ int test_prop_keysend_invoice_collision(void) {
         mgr.invoices[1].active = 0;
         TEST_ASSERT(!lsp_channels_lookup_invoice(&mgr, hash, &lookup_dest),
                     "lookup after both deactivated");
+        free(mgr.invoice_by_hash);
     }
 
     free(invoices_buf);
@@ -19,6 +19,7 @@ int test_rate_limit_under_limit(void) {
         TEST_ASSERT(rate_limiter_allow(&rl, "192.168.1.1"),
                     "connection under limit should be allowed");
     }
+    rate_limiter_free(&rl);
 
     return 1;
 }
@@ -41,6 +42,7 @@ int test_rate_limit_over_limit(void) {
     /* Different IP should still be allowed */
     TEST_ASSERT(rate_limiter_allow(&rl, "10.0.0.2"),
                 "different IP should be allowed");
+    rate_limiter_free(&rl);
 
     return 1;
 }
@@ -59,6 +61,7 @@ int test_rate_limit_window_config(void) {
     TEST_ASSERT(rate_limiter_allow(&rl, "1.2.3.4"), "first ok");
     TEST_ASSERT(rate_limiter_allow(&rl, "1.2.3.4"), "second ok");
     TEST_ASSERT(!rate_limiter_allow(&rl, "1.2.3.4"), "third should fail");
+    rate_limiter_free(&rl);
 
     return 1;
 }
@@ -89,6 +92,110 @@ int test_rate_limit_handshake_cap(void) {
     /* Extra end should not go negative */
     rate_limiter_handshake_end(&rl);
     TEST_ASSERT(rl.active_handshakes == 0, "should not go negative");
+    rate_limiter_free(&rl);
 
     return 1;
 }
+
+/* Test 5: GCRA refills one connection per window / limit. */
+int test_rate_limit_gcra_refill(void) {
+    rate_limiter_t rl;
+    rate_limiter_init(&rl, 4, 60, 4);  /* burst 4, then one per 15 s */
+    const uint64_t t0 = 1000000000ULL;
+
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT(rate_limiter_allow_at(&rl, "10.1.1.1", t0), "burst allowed");
+    TEST_ASSERT(!rate_limiter_allow_at(&rl, "10.1.1.1", t0), "burst exhausted");
+    TEST_ASSERT(!rate_limiter_allow_at(&rl, "10.1.1.1", t0 + 14999999),
+                "not yet");
+    TEST_ASSERT(rate_limiter_allow_at(&rl, "10.1.1.1", t0 + 15000000),
+                "one more after 15 s");
+    TEST_ASSERT(!rate_limiter_allow_at(&rl, "10.1.1.1", t0 + 15000000),
+                "only one");
+    TEST_ASSERT(rate_limiter_allow_at(&rl, "10.1.1.1", t0 + 200000000),
+                "idle source starts fresh");
+
+    /* IPv4-mapped IPv6 is the same source */
+    for (int i = 0; i < 3; i++)
+        rate_limiter_allow_at(&rl, "10.1.1.1", t0 + 200000000);
+    TEST_ASSERT(!rate_limiter_allow_at(&rl, "::ffff:10.1.1.1", t0 + 200000000),
+                "mapped address shares the counter");
+
+    rate_limiter_free(&rl);
+    return 1;
+}
+
+/* Test 6: a /24 or /48 is limited as a whole. */
+int test_rate_limit_subnet(void) {
+    rate_limiter_t rl;
+    rate_limiter_init(&rl, 2, 60, 4);
+    rate_limiter_set_limits(&rl, 0, 5);
+    char ip[64];
+
+    /* 5 connections from different hosts in 192.0.2.0/24 */
+    for (int i = 0; i < 5; i++) {
+        snprintf(ip, sizeof(ip), "192.0.2.%d", i + 1);
+        TEST_ASSERT(rate_limiter_allow_at(&rl, ip, 0), "within subnet limit");
+    }
+    TEST_ASSERT(!rate_limiter_allow_at(&rl, "192.0.2.99", 0),
+                "subnet exhausted for a fresh host");
+    TEST_ASSERT(rate_limiter_allow_at(&rl, "192.0.3.1", 0), "next /24 is separate");
+
+    /* IPv6: hosts in one /64 are one source; /48 aggregates */
+    TEST_ASSERT(rate_limiter_allow_at(&rl, "2001:db8:1:1::1", 0), "v6 1");
+    TEST_ASSERT(rate_limiter_allow_at(&rl, "2001:db8:1:1::2", 0), "v6 same /64");
+    TEST_ASSERT(!rate_limiter_allow_at(&rl, "2001:db8:1:1::3", 0),
+                "/64 is one source");
+
+    /* Disabled subnet aggregation */
+    rate_limiter_set_limits(&rl, 0, -1);
+    TEST_ASSERT(rate_limiter_allow_at(&rl, "192.0.2.99", 0),
+                "no subnet limit when disabled");
+
+    rate_limiter_free(&rl);
+    return 1;
+}
+
+/* Test 7: many distinct sources stay exact; memory bounded by LRU. */
+int test_rate_limit_many_sources(void) {
+    rate_limiter_t rl;
+    rate_limiter_init(&rl, 1, 60, 4);
+    rate_limiter_set_limits(&rl, 0, -1);
+    char ip[64];
+
+    /* 200000 sources, each allowed once and rejected on its second try:
+       no collision between them resets or shares a counter */
+    const int n = 200000;
+    for (int i = 0; i < n; i++) {
+        snprintf(ip, sizeof(ip), "10.%d.%d.%d", (i >> 16) & 255, (i >> 8) & 255, i & 255);
+        TEST_ASSERT(rate_limiter_allow_at(&rl, ip, 0), "first connection allowed");
+    }
+    for (int i = 0; i < n; i += 997) {
+        snprintf(ip, sizeof(ip), "10.%d.%d.%d", (i >> 16) & 255, (i >> 8) & 255, i & 255);
+        TEST_ASSERT(!rate_limiter_allow_at(&rl, ip, 0), "second connection limited");
+    }
+    TEST_ASSERT(rl.n_entries == (uint32_t)n, "one entry per source");
+    TEST_ASSERT(rl.n_evicted == 0, "no evictions below the bound");
+
+    /* Bounded table: the least recently seen source is evicted */
+    rate_limiter_t small;
+    rate_limiter_init(&small, 1, 60, 4);
+    rate_limiter_set_limits(&small, 100, -1);
+    TEST_ASSERT(rate_limiter_allow_at(&small, "172.16.0.1", 0), "victim admitted");
+    for (int i = 0; i < 200; i++) {
+        snprintf(ip, sizeof(ip), "172.17.%d.%d", i >> 8, i & 255);
+        rate_limiter_allow_at(&small, ip, 0);
+        /* a source seen all along stays resident */
+        rate_limiter_allow_at(&small, "172.16.0.2", 0);
+    }
+    TEST_ASSERT(small.n_entries == 100, "table bounded");
+    TEST_ASSERT(small.n_evicted == 102, "oldest sources evicted");
+    TEST_ASSERT(!rate_limiter_allow_at(&small, "172.16.0.2", 0),
+                "recently seen source still limited");
+    TEST_ASSERT(rate_limiter_allow_at(&small, "172.16.0.1", 0),
+                "evicted source starts fresh");
+
+    rate_limiter_free(&small);
+    rate_limiter_free(&rl);
+    return 1;
+}
@@ -0,0 +1,242 @@
+/*
+ * test_rgs_server.c — Tests for precomputed RGS snapshots and deltas
+ */
+
+#include "superscalar/rgs_server.h"
+#include "superscalar/rgs.h"
+#include "superscalar/gossip_store.h"
+#include "superscalar/gossip_ingest.h"
+#include "superscalar/gossip.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while(0)
+
+#define IVL   3600u
+#define T0    1700002800u          /* multiple of IVL */
+#define SCID(b, t)  (((uint64_t)(b) << 40) | ((uint64_t)(t) << 16))
+
+static void node(unsigned char id[33], unsigned char tag)
+{
+    memset(id, tag, 33);
+    id[0] = 0x03;
+}
+
+static rgs_channel_update_t upd(int dir, uint32_t ts, uint32_t fee_base)
+{
+    rgs_channel_update_t u;
+    memset(&u, 0, sizeof(u));
+    u.direction = dir;
+    u.timestamp = ts;
+    u.fee_base_msat = fee_base;
+    u.fee_proportional_millionths = 100;
+    u.cltv_expiry_delta = 40;
+    u.htlc_minimum_msat = 1;
+    u.htlc_maximum_msat = 1000000000ULL;
+    return u;
+}
+
+static unsigned char g_blob[256 * 1024];
+static rgs_node_id_t g_nodes[64];
+static rgs_channel_t g_chans[64];
+
+/* Fetch the blob for since and parse it into g_nodes / g_chans. */
+static int fetch(rgs_server_t *srv, uint32_t since, rgs_snapshot_t *snap,
+                 size_t *len_out)
+{
+    size_t len = rgs_server_get(srv, since, g_blob, sizeof(g_blob));
+    if (len_out) *len_out = len;
+    return len && rgs_parse(g_blob, len, snap, g_nodes, 64, g_chans, 64);
+}
+
+/* RS1: full snapshot, empty delta, delta after changes; a delta on top of
+ * the previous full snapshot gives the new full snapshot. */
+int test_rgs_server_delta_cycle(void)
+{
+    rgs_server_t srv;
+    ASSERT(rgs_server_init(&srv, IVL), "RS1: init");
+    unsigned char a[33], b[33], c[33];
+    node(a, 0xA1); node(b, 0xB2); node(c, 0xC3);
+
+    rgs_channel_update_t u;
+    for (int i = 0; i < 3; i++) {
+        ASSERT(rgs_server_add_channel(&srv, SCID(800000 + i, 1), a, i ? c : b,
+                                      50000, T0 + 10), "RS1: add");
+        u = upd(0, 1000, 100 + (uint32_t)i);
+        ASSERT(rgs_server_apply_update(&srv, SCID(800000 + i, 1), &u, T0 + 11),
+               "RS1: update");
+    }
+    rgs_snapshot_t snap;
+    ASSERT(!fetch(&srv, 0, &snap, NULL), "RS1: nothing before first seal");
+
+    uint32_t b1 = T0 + IVL;
+    ASSERT(rgs_server_tick(&srv, b1 + 5) == 1, "RS1: seal b1");
+    ASSERT(rgs_server_tick(&srv, b1 + 600) == 0, "RS1: same boundary is a no-op");
+
+    ASSERT(fetch(&srv, 0, &snap, NULL), "RS1: full");
+    ASSERT(snap.last_sync_timestamp == b1, "RS1: stamped with boundary");
+    ASSERT(snap.channel_count == 3 && snap.node_id_count == 3, "RS1: full contents");
+    static unsigned char full1[4096];
+    size_t full1_len = rgs_server_get(&srv, 0, full1, sizeof(full1));
+    ASSERT(full1_len > 0, "RS1: copy full b1");
+
+    ASSERT(fetch(&srv, b1, &snap, NULL), "RS1: delta since b1");
+    ASSERT(snap.channel_count == 0, "RS1: nothing changed yet");
+
+    /* Changes during the next interval */
+    u = upd(0, 900, 999);
+    ASSERT(!rgs_server_apply_update(&srv, SCID(800001, 1), &u, b1 + 50),
+           "RS1: older update ignored");
+    u = upd(1, 2000, 777);
+    ASSERT(rgs_server_apply_update(&srv, SCID(800001, 1), &u, b1 + 100), "RS1: dir 1");
+    ASSERT(rgs_server_add_channel(&srv, SCID(800009, 2), b, c, 70000, b1 + 200),
+           "RS1: new channel");
+    ASSERT(rgs_server_add_channel(&srv, SCID(800000, 1), b, c, 1, b1 + 300),
+           "RS1: re-announce is a no-op");
+
+    uint32_t b2 = b1 + IVL;
+    ASSERT(rgs_server_tick(&srv, b2 + 1) == 1, "RS1: seal b2");
+    size_t dlen, flen;
+    ASSERT(fetch(&srv, b1, &snap, &dlen), "RS1: delta b1->b2");
+    ASSERT(snap.last_sync_timestamp == b2, "RS1: delta stamped b2");
+    ASSERT(snap.channel_count == 2, "RS1: two channels changed");
+    const rgs_channel_t *ch = rgs_find_channel(&snap, g_chans, SCID(800001, 1));
+    ASSERT(ch && ch->update_count == 1 && ch->updates[0].direction == 1,
+           "RS1: only the new update");
+    ASSERT(rgs_find_channel(&snap, g_chans, SCID(800009, 2)), "RS1: new channel in delta");
+    ASSERT(fetch(&srv, b1 + 1800, &snap, NULL) && snap.channel_count == 2,
+           "RS1: mid-interval since maps to b1");
+    ASSERT(fetch(&srv, b2, &snap, NULL) && snap.channel_count == 0, "RS1: up to date");
+    ASSERT(fetch(&srv, 12345, &snap, &flen) && snap.channel_count == 4,
+           "RS1: unknown since gets full");
+    ASSERT(dlen < flen, "RS1: delta smaller than full");
+
+    /* Client path: full(b1) + delta(b1->b2) == full(b2) */
+    gossip_store_t inc, ref;
+    ASSERT(gossip_store_open_in_memory(&inc) && gossip_store_open_in_memory(&ref),
+           "RS1: stores");
+    ASSERT(gossip_store_import_rgs(&inc, full1, full1_len) == 3, "RS1: import full b1");
+    size_t len = rgs_server_get(&srv, b1, g_blob, sizeof(g_blob));
+    ASSERT(gossip_store_import_rgs(&inc, g_blob, len) == 2, "RS1: import delta");
+    len = rgs_server_get(&srv, 0, g_blob, sizeof(g_blob));
+    ASSERT(gossip_store_import_rgs(&ref, g_blob, len) == 4, "RS1: import full b2");
+    for (int i = 0; i < 10; i++) {
+        for (int d = 0; d < 2; d++) {
+            uint64_t scid = SCID(800000 + i, i == 9 ? 2 : 1);
+            uint32_t f1 = 0, f2 = 0, p, t;
+            uint16_t cl;
+            int h1 = gossip_store_get_channel_update(&inc, scid, d, &f1, &p, &cl, &t);
+            int h2 = gossip_store_get_channel_update(&ref, scid, d, &f2, &p, &cl, &t);
+            ASSERT(h1 == h2 && f1 == f2, "RS1: incremental matches full");
+        }
+    }
+    gossip_store_close(&inc);
+    gossip_store_close(&ref);
+
+    ASSERT(srv.n_served_delta > 0 && srv.n_served_full > 0, "RS1: counters");
+    rgs_server_free(&srv);
+    return 1;
+}
+
+/* RS2: bounded history, removal, seeding, small buffers */
+int test_rgs_server_history_seed(void)
+{
+    rgs_server_t srv;
+    ASSERT(rgs_server_init(&srv, IVL), "RS2: init");
+    unsigned char a[33], b[33];
+    node(a, 0xA1); node(b, 0xB2);
+    ASSERT(rgs_server_add_channel(&srv, SCID(810000, 1), a, b, 1000, T0), "RS2: add");
+    ASSERT(rgs_server_add_channel(&srv, SCID(810001, 1), a, b, 1000, T0), "RS2: add 2");
+
+    uint32_t first = T0 + IVL;
+    for (int i = 0; i < RGS_SERVER_HISTORY + 3; i++)
+        ASSERT(rgs_server_tick(&srv, first + (uint32_t)i * IVL) == 1, "RS2: seal");
+    ASSERT(srv.n_deltas == RGS_SERVER_HISTORY, "RS2: history bounded");
+
+    rgs_snapshot_t snap;
+    ASSERT(fetch(&srv, first, &snap, NULL) && snap.channel_count == 2,
+           "RS2: expired boundary gets full snapshot");
+    uint32_t oldest = srv.history[RGS_SERVER_HISTORY - 1];
+    ASSERT(fetch(&srv, oldest, &snap, NULL) && snap.channel_count == 0,
+           "RS2: oldest retained boundary gets a delta");
+
+    unsigned char small[8];
+    ASSERT(rgs_server_get(&srv, 0, small, sizeof(small)) == 0, "RS2: small buffer");
+    ASSERT(rgs_server_blob_len(&srv, 0) > sizeof(small), "RS2: size needed");
+    size_t clen = 0;
+    unsigned char *copy = rgs_server_get_copy(&srv, 0, &clen);
+    ASSERT(copy && clen == rgs_server_blob_len(&srv, 0), "RS2: copy sized under lock");
+    ASSERT(clen == rgs_server_get(&srv, 0, g_blob, sizeof(g_blob)) &&
+           memcmp(copy, g_blob, clen) == 0, "RS2: copy matches get");
+    free(copy);
+
+    ASSERT(rgs_server_remove_channel(&srv, SCID(810000, 1)), "RS2: remove");
+    ASSERT(!rgs_server_remove_channel(&srv, SCID(810000, 1)), "RS2: remove twice");
+    ASSERT(rgs_server_tick(&srv, first + (RGS_SERVER_HISTORY + 3) * IVL) == 1, "RS2: seal");
+    size_t len = rgs_server_get(&srv, 0, g_blob, sizeof(g_blob));
+    ASSERT(len && rgs_parse(g_blob, len, &snap, g_nodes, 64, g_chans, 64) &&
+           snap.channel_count == 1, "RS2: removed channel left the full snapshot");
+
+    /* Seed a fresh server from that blob: full only, never in a delta */
+    rgs_server_t s2;
+    ASSERT(rgs_server_init(&s2, 0), "RS2: init s2");
+    ASSERT(!rgs_server_get_copy(&s2, 0, &clen) && clen == 0, "RS2: nothing sealed");
+    ASSERT(s2.interval == RGS_SERVER_DEFAULT_INTERVAL, "RS2: default interval");
+    ASSERT(rgs_server_seed(&s2, g_blob, len) == 1, "RS2: seed");
+    ASSERT(rgs_server_seed(&s2, small, sizeof(small)) == -1, "RS2: bad blob");
+    ASSERT(rgs_server_tick(&s2, T0 + 2 * RGS_SERVER_DEFAULT_INTERVAL) == 1, "RS2: seal s2");
+    ASSERT(fetch(&s2, 0, &snap, NULL) && snap.channel_count == 1, "RS2: seeded full");
+    ASSERT(fetch(&s2, s2.last_boundary, &snap, NULL) && snap.channel_count == 0,
+           "RS2: seeded state not in delta");
+    rgs_server_free(&s2);
+    rgs_server_free(&srv);
+    return 1;
+}
+
+/* RS3: gossip_ingest feeds an attached server */
+int test_rgs_server_ingest(void)
+{
+    rgs_server_t srv;
+    ASSERT(rgs_server_init(&srv, IVL), "RS3: init");
+    gossip_ingest_t gi;
+    gossip_ingest_init(&gi, NULL, NULL);
+    gi.rgs = &srv;
+
+    unsigned char n1[33], n2[33], ann[512], cu[130];
+    node(n1, 0x21); node(n2, 0x42);
+    uint64_t scid = SCID(820000, 7);
+    size_t alen = gossip_build_channel_announcement_unsigned(
+        ann, sizeof(ann), GOSSIP_CHAIN_HASH_MAINNET, scid, n1, n2, n1, n2);
+    ASSERT(gossip_ingest_message(&gi, ann, alen, T0 + 1) == GOSSIP_INGEST_NO_VERIFY,
+           "RS3: ann");
+
+    memset(cu, 0, sizeof(cu));
+    cu[0] = 0x01; cu[1] = 0x02;
+    for (int i = 0; i < 8; i++) cu[98 + i] = (unsigned char)(scid >> (56 - 8 * i));
+    cu[106] = 0x65;                       /* timestamp */
+    cu[111] = 0x01;                       /* direction 1 */
+    cu[113] = 18;                         /* cltv */
+    cu[125] = 0x2A;                       /* fee_base 42 */
+    ASSERT(gossip_ingest_message(&gi, cu, sizeof(cu), T0 + 2) == GOSSIP_INGEST_NO_VERIFY,
+           "RS3: update");
+
+    ASSERT(rgs_server_tick(&srv, T0 + IVL) == 1, "RS3: seal");
+    rgs_snapshot_t snap;
+    ASSERT(fetch(&srv, 0, &snap, NULL) && snap.channel_count == 1, "RS3: channel");
+    const rgs_channel_update_t *ru = rgs_get_update(&g_chans[0], 1);
+    ASSERT(ru && ru->fee_base_msat == 42 && ru->cltv_expiry_delta == 18, "RS3: policy");
+
+    gossip_ingest_channel_closed(&gi, scid, T0 + IVL + 5);
+    ASSERT(srv.n_chans == 0, "RS3: closed channel removed");
+
+    gossip_ingest_free(&gi);
+    rgs_server_free(&srv);
+    return 1;
+}
@@ -0,0 +1,390 @@
+/*
+ * test_rpc_client.c — shared keep-alive JSON-RPC client tests
+ *
+ * RC1: test_rpc_client_keepalive_reuse   — 5 calls ride one TCP connection
+ * RC2: test_rpc_client_batch_by_id       — batch answers re-ordered by id
+ * RC3: test_rpc_client_stale_reconnect   — server-closed socket retried once
+ * RC4: test_rpc_client_chunked_response  — chunked transfer-encoding decoded
+ * RC5: test_rpc_client_shared_lookup     — same endpoint → same client
+ * RC6: test_rpc_backend_batch_one_trip   — chain_backend_rpc batch slots are
+ *                                          one HTTP request each
+ *
+ * A tiny in-process "bitcoind" serves JSON-RPC on 127.0.0.1:<ephemeral>.
+ */
+
+#include "superscalar/rpc_client.h"
+#include "superscalar/chain_backend_rpc.h"
+#include "cJSON.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        printf("  FAIL: %s (line %d): %s\n", __func__, __LINE__, (msg)); \
+        return 0; \
+    } \
+} while (0)
+
+/* ------------------------------------------------------------------ */
+/* Fake bitcoind                                                        */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    int listen_fd;
+    int port;
+    int close_after_response;   /* drop the socket without telling the client */
+    int chunked;                /* answer with Transfer-Encoding: chunked */
+    volatile int stop;
+    int n_accepts;
+    int n_requests;
+    pthread_t tid;
+} fake_bitcoind_t;
+
+static cJSON *fake_answer_one(const cJSON *req)
+{
+    cJSON *resp = cJSON_CreateObject();
+    cJSON *id = cJSON_GetObjectItem(req, "id");
+    cJSON *m  = cJSON_GetObjectItem(req, "method");
+    cJSON *params = cJSON_GetObjectItem(req, "params");
+    const char *method = (m && cJSON_IsString(m)) ? m->valuestring : "";
+    cJSON *p0 = cJSON_GetArrayItem(params, 0);
+    cJSON *p1 = cJSON_GetArrayItem(params, 1);
+
+    cJSON *result = NULL;
+    int err_code = 0;
+    if (strcmp(method, "getblockcount") == 0) {
+        result = cJSON_CreateNumber(101);
+    } else if (strcmp(method, "getrawtransaction") == 0) {
+        const char *txid = (p0 && cJSON_IsString(p0)) ? p0->valuestring : "";
+        if (strncmp(txid, "aa", 2) == 0) {
+            result = cJSON_CreateObject();
+            cJSON_AddNumberToObject(result, "confirmations", 3);
+        } else if (strncmp(txid, "bb", 2) == 0) {
+            result = cJSON_CreateObject();   /* mempool: no confirmations */
+        } else {
+            err_code = -5;
+        }
+    } else if (strcmp(method, "gettxout") == 0) {
+        int vout = (p1 && cJSON_IsNumber(p1)) ? p1->valueint : 0;
+        if (vout == 0) {
+            result = cJSON_CreateObject();
+            cJSON_AddNumberToObject(result, "value", 1);
+        } else {
+            result = cJSON_CreateNull();
+        }
+    } else if (strcmp(method, "fail") == 0) {
+        err_code = -32601;
+    } else {
+        result = cJSON_CreateString(method);
+    }
+
+    if (err_code) {
+        cJSON_AddNullToObject(resp, "result");
+        cJSON *e = cJSON_CreateObject();
+        cJSON_AddNumberToObject(e, "code", err_code);
+        cJSON_AddStringToObject(e, "message", "fake error");
+        cJSON_AddItemToObject(resp, "error", e);
+    } else {
+        cJSON_AddItemToObject(resp, "result", result);
+        cJSON_AddNullToObject(resp, "error");
+    }
+    cJSON_AddItemToObject(resp, "id", id ? cJSON_Duplicate(id, 1) : cJSON_CreateNull());
+    return resp;
+}
+
+/* Answer a batch in reverse order so the client must match by id. */
+static cJSON *fake_answer(const cJSON *req)
+{
+    if (!cJSON_IsArray(req)) return fake_answer_one(req);
+    cJSON *arr = cJSON_CreateArray();
+    for (int i = cJSON_GetArraySize(req) - 1; i >= 0; i--)
+        cJSON_AddItemToArray(arr, fake_answer_one(cJSON_GetArrayItem(req, i)));
+    return arr;
+}
+
+static int fake_read_request(int fd, char **body_out)
+{
+    size_t cap = 8192, len = 0;
+    char *buf = malloc(cap);
+    char *hdr_end = NULL;
+    while (!hdr_end) {
+        if (len + 1 >= cap) { cap *= 2; buf = realloc(buf, cap); }
+        ssize_t n = recv(fd, buf + len, cap - len - 1, 0);
+        if (n <= 0) { free(buf); return 0; }
+        len += (size_t)n;
+        buf[len] = '\0';
+        hdr_end = strstr(buf, "\r\n\r\n");
+    }
+    size_t body_ofs = (size_t)(hdr_end - buf) + 4;
+    const char *cl = strstr(buf, "Content-Length: ");
+    size_t clen = cl ? (size_t)atoi(cl + 16) : 0;
+    while (len < body_ofs + clen) {
+        if (len + 1 >= cap) { cap *= 2; buf = realloc(buf, cap); }
+        ssize_t n = recv(fd, buf + len, cap - len - 1, 0);
+        if (n <= 0) { free(buf); return 0; }
+        len += (size_t)n;
+    }
+    char *body = malloc(clen + 1);
+    memcpy(body, buf + body_ofs, clen);
+    body[clen] = '\0';
+    free(buf);
+    *body_out = body;
+    return 1;
+}
+
+static void fake_send_all(int fd, const char *buf, size_t len)
+{
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(fd, buf + sent, len - sent, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        sent += (size_t)n;
+    }
+}
+
+static void *fake_bitcoind_thread(void *arg)
+{
+    fake_bitcoind_t *fb = (fake_bitcoind_t *)arg;
+    while (!fb->stop) {
+        int cfd = accept(fb->listen_fd, NULL, NULL);
+        if (cfd < 0) break;
+        fb->n_accepts++;
+        char *body;
+        while (!fb->stop && fake_read_request(cfd, &body)) {
+            fb->n_requests++;
+            cJSON *req = cJSON_Parse(body);
+            free(body);
+            cJSON *resp = fake_answer(req);
+            cJSON_Delete(req);
+            char *out = cJSON_PrintUnformatted(resp);
+            cJSON_Delete(resp);
+            size_t olen = strlen(out);
+
+            char hdr[256];
+            int hlen;
+            if (fb->chunked) {
+                hlen = snprintf(hdr, sizeof(hdr),
+                    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                    "Transfer-Encoding: chunked\r\n\r\n");
+                fake_send_all(cfd, hdr, (size_t)hlen);
+                /* Two chunks to exercise reassembly. */
+                size_t half = olen / 2;
+                char sz[32];
+                int n = snprintf(sz, sizeof(sz), "%zx\r\n", half);
+                fake_send_all(cfd, sz, (size_t)n);
+                fake_send_all(cfd, out, half);
+                n = snprintf(sz, sizeof(sz), "\r\n%zx\r\n", olen - half);
+                fake_send_all(cfd, sz, (size_t)n);
+                fake_send_all(cfd, out + half, olen - half);
+                fake_send_all(cfd, "\r\n0\r\n\r\n", 7);
+            } else {
+                hlen = snprintf(hdr, sizeof(hdr),
+                    "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                    "Content-Length: %zu\r\n\r\n", olen);
+                fake_send_all(cfd, hdr, (size_t)hlen);
+                fake_send_all(cfd, out, olen);
+            }
+            free(out);
+            if (fb->close_after_response) break;
+        }
+        close(cfd);
+    }
+    return NULL;
+}
+
+static int fake_bitcoind_start(fake_bitcoind_t *fb)
+{
+    fb->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fb->listen_fd < 0) return 0;
+    int one = 1;
+    setsockopt(fb->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = 0;
+    if (bind(fb->listen_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+        listen(fb->listen_fd, 8) != 0) {
+        close(fb->listen_fd);
+        return 0;
+    }
+    socklen_t sl = sizeof(sa);
+    getsockname(fb->listen_fd, (struct sockaddr *)&sa, &sl);
+    fb->port = ntohs(sa.sin_port);
+    return pthread_create(&fb->tid, NULL, fake_bitcoind_thread, fb) == 0;
+}
+
+static void fake_bitcoind_stop(fake_bitcoind_t *fb, rpc_client_t *c)
+{
+    fb->stop = 1;
+    /* Drop the client's pooled sockets so the server's recv() returns. */
+    if (c) rpc_client_close(c);
+    shutdown(fb->listen_fd, SHUT_RDWR);
+    close(fb->listen_fd);
+    pthread_join(fb->tid, NULL);
+}
+
+/* ------------------------------------------------------------------ */
+/* Tests                                                               */
+/* ------------------------------------------------------------------ */
+
+/* RC1: repeated calls reuse one pooled keep-alive connection. */
+int test_rpc_client_keepalive_reuse(void)
+{
+    fake_bitcoind_t fb;
+    memset(&fb, 0, sizeof(fb));
+    if (!fake_bitcoind_start(&fb)) return 2; /* SKIP: no loopback sockets */
+
+    rpc_client_t c;
+    ASSERT(rpc_client_init(&c, "127.0.0.1", fb.port, "u", "p"), "init");
+    ASSERT(strstr(c.auth_header, "Authorization: Basic dTpw") != NULL,
+           "auth header cached at init");
+
+    for (int i = 0; i < 5; i++) {
+        rpc_error_t err;
+        cJSON *r = rpc_client_call(&c, NULL, "getblockcount", NULL, &err);
+        ASSERT(r && cJSON_IsNumber(r), "getblockcount result");
+        ASSERT((int)r->valuedouble == 101, "height");
+        cJSON_Delete(r);
+    }
+    ASSERT(c.n_connects == 1, "one TCP connect for five calls");
+    ASSERT(c.n_requests == 5, "five round-trips");
+
+    fake_bitcoind_stop(&fb, &c);
+    ASSERT(fb.n_accepts == 1, "server saw one connection");
+    return 1;
+}
+
+/* RC2: a batch is one request and results land on the right item. */
+int test_rpc_client_batch_by_id(void)
+{
+    fake_bitcoind_t fb;
+    memset(&fb, 0, sizeof(fb));
+    if (!fake_bitcoind_start(&fb)) return 2;
+
+    rpc_client_t c;
+    ASSERT(rpc_client_init(&c, "127.0.0.1", fb.port, "u", "p"), "init");
+
+    rpc_batch_item_t items[4];
+    memset(items, 0, sizeof(items));
+    items[0].method = "alpha";
+    items[1].method = "fail";
+    items[2].method = "getblockcount";
+    items[3].method = "gettxout";
+    items[3].params = cJSON_CreateArray();
+    cJSON_AddItemToArray(items[3].params, cJSON_CreateString("00"));
+    cJSON_AddItemToArray(items[3].params, cJSON_CreateNumber(1));
+
+    ASSERT(rpc_client_batch(&c, NULL, items, 4) == 1, "batch answered");
+    ASSERT(c.n_requests == 1, "single round-trip");
+    ASSERT(c.n_calls == 4, "four calls carried");
+    ASSERT(cJSON_IsString(items[0].result) &&
+           strcmp(items[0].result->valuestring, "alpha") == 0, "item 0 by id");
+    ASSERT(items[1].result == NULL && items[1].err.code == -32601,
+           "item 1 carries its own error");
+    ASSERT(cJSON_IsNumber(items[2].result), "item 2 number");
+    ASSERT(cJSON_IsNull(items[3].result), "item 3 JSON null is a result");
+    for (int i = 0; i < 4; i++) cJSON_Delete(items[i].result);
+
+    fake_bitcoind_stop(&fb, &c);
+    return 1;
+}
+
+/* RC3: bitcoind dropped the idle socket — next call reconnects. */
+int test_rpc_client_stale_reconnect(void)
+{
+    fake_bitcoind_t fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.close_after_response = 1;
+    if (!fake_bitcoind_start(&fb)) return 2;
+
+    rpc_client_t c;
+    ASSERT(rpc_client_init(&c, "127.0.0.1", fb.port, "u", "p"), "init");
+    for (int i = 0; i < 3; i++) {
+        cJSON *r = rpc_client_call(&c, NULL, "getblockcount", NULL, NULL);
+        ASSERT(r != NULL, "call succeeds despite stale pooled socket");
+        cJSON_Delete(r);
+    }
+    ASSERT(fb.n_requests == 3, "three answered requests");
+    ASSERT(c.n_connects == 3, "reconnect per stale socket");
+
+    fake_bitcoind_stop(&fb, &c);
+    return 1;
+}
+
+/* RC4: chunked transfer-encoding is reassembled. */
+int test_rpc_client_chunked_response(void)
+{
+    fake_bitcoind_t fb;
+    memset(&fb, 0, sizeof(fb));
+    fb.chunked = 1;
+    if (!fake_bitcoind_start(&fb)) return 2;
+
+    rpc_client_t c;
+    ASSERT(rpc_client_init(&c, "127.0.0.1", fb.port, "u", "p"), "init");
+    cJSON *r = rpc_client_call(&c, "w1", "echo_method_name", NULL, NULL);
+    ASSERT(cJSON_IsString(r) &&
+           strcmp(r->valuestring, "echo_method_name") == 0, "chunked body");
+    cJSON_Delete(r);
+    r = rpc_client_call(&c, NULL, "getblockcount", NULL, NULL);
+    ASSERT(r != NULL, "keep-alive after chunked response");
+    cJSON_Delete(r);
+    ASSERT(c.n_connects == 1, "chunked response keeps the socket");
+
+    fake_bitcoind_stop(&fb, &c);
+    return 1;
+}
+
+/* RC5: shared table keys on endpoint and credentials. */
+int test_rpc_client_shared_lookup(void)
+{
+    rpc_client_t *a = rpc_client_shared("127.0.0.1", 1, "user", "pass");
+    rpc_client_t *b = rpc_client_shared("127.0.0.1", 1, "user", "pass");
+    rpc_client_t *d = rpc_client_shared("127.0.0.1", 1, "user", "other");
+    ASSERT(a != NULL && a == b, "same endpoint shares a client");
+    ASSERT(d != NULL && d != a, "different credentials get their own");
+    ASSERT(rpc_client_shared("127.0.0.1", 0, "user", "pass") == NULL,
+           "port 0 rejected");
+    return 1;
+}
+
+/* RC6: chain_backend_rpc batch slots cost one HTTP request each. */
+int test_rpc_backend_batch_one_trip(void)
+{
+    fake_bitcoind_t fb;
+    memset(&fb, 0, sizeof(fb));
+    if (!fake_bitcoind_start(&fb)) return 2;
+
+    chain_backend_t be;
+    ASSERT(chain_backend_rpc_init(&be, "127.0.0.1", fb.port, "rc6", "rc6",
+                                  NULL, "regtest"), "backend init");
+    ASSERT(be.reorg_cb == NULL, "unset optional slots are NULL");
+    chain_backend_rpc_ctx_t *rpc = (chain_backend_rpc_ctx_t *)be.ctx;
+    uint64_t before = rpc->client->n_requests;
+
+    const char *txids[3] = { "aa01", "bb02", "cc03" };
+    int confs[3] = { 0, 0, 0 };
+    ASSERT(be.get_confirmations_batch(&be, txids, 3, confs) == 1, "batch ok");
+    ASSERT(confs[0] == 3 && confs[1] == 0 && confs[2] == -1,
+           "confirmed / mempool / missing");
+    ASSERT(rpc->client->n_requests == before + 1, "one round-trip for 3 txids");
+
+    const char *outs[2] = { "dd", "ee" };
+    uint32_t vouts[2] = { 0, 1 };
+    int unspent[2] = { -1, -1 };
+    ASSERT(be.is_outpoint_unspent_batch(&be, outs, vouts, 2, unspent) == 1,
+           "outpoint batch ok");
+    ASSERT(unspent[0] == 1 && unspent[1] == 0, "unspent / spent");
+    ASSERT(rpc->client->n_requests == before + 2, "one round-trip for sweep");
+
+    fake_bitcoind_stop(&fb, rpc->client);
+    free(rpc);
+    return 1;
+}
@@ -65,9 +65,12 @@ extern void reverse_bytes(unsigned char *data, size_t len);
 #include "superscalar/htlc_forward.h"
 #include "superscalar/mpp.h"
 #include "superscalar/payment.h"
+#include "superscalar/payment_engine.h"
 #include "superscalar/cltv_watchdog.h"
+#include "superscalar/chain_events.h"
 #include "superscalar/gossip_peer.h"
 #include "superscalar/gossip_store.h"
+#include "superscalar/pathfind.h"
 #include <pthread.h>
 
 static volatile sig_atomic_t g_shutdown = 0;
@@ -98,11 +101,34 @@ static htlc_forward_table_t g_fwd;
 static mpp_table_t         g_mpp;
 static payment_table_t     g_payments;
 static ln_dispatch_t       g_ln_dispatch;
+static onion_proc_t        g_onion_proc;    /* batched peel + onion replay filter */
+static int                 g_onion_proc_ready = 0;
+static payment_engine_t    g_pay_engine;    /* concurrent outbound payments */
+static mc_table_t          g_pay_mc;        /* its mission control */
+static int                 g_pay_engine_ready = 0;
 static bolt11_invoice_table_t g_invoice_tbl;
 
 /* CLTV watchdog: pointer to the active channel manager, set after each alloc */
 static lsp_channel_mgr_t *g_channel_mgr = NULL;
 
+/* CLTV watchdog: expiry deadlines of every HTLC on g_channel_mgr's channels */
+static cltv_deadlines_t g_cltv_deadlines;
+
+/* Held by the block consumer while it uses g_channel_mgr, and by
+   set_channel_mgr(): a manager is never replaced or freed under a
+   deadline pass. */
+static pthread_mutex_t g_channel_mgr_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Install mgr for the block callback.  NULL detaches the deadline heap
+   from the old manager's channels; call it before freeing them. */
+static void set_channel_mgr(lsp_channel_mgr_t *mgr)
+{
+    pthread_mutex_lock(&g_channel_mgr_lock);
+    g_channel_mgr = mgr;
+    if (!mgr) cltv_deadlines_free(&g_cltv_deadlines);
+    pthread_mutex_unlock(&g_channel_mgr_lock);
+}
+
 /* LSPS0 context for bolt8_server callback */
 static lsps_ctx_t  g_lsps_ctx;
 
@@ -117,6 +143,11 @@ static uint32_t     g_block_height = 0;
 /* Admin RPC: JSON-RPC 2.0 Unix socket operator interface */
 static admin_rpc_t   g_admin_rpc;
 static gossip_store_t *g_gossip_store_ptr = NULL; /* set after gossip store init */
+static rgs_server_t   *g_rgs_server_ptr = NULL;   /* set with the gossip ingest */
+static gossip_ingest_t *g_gossip_ingest_ptr = NULL;     /* set after gossip ingest init */
+static gossip_log_t   *g_gossip_log_ptr = NULL;   /* binary gossip log next to the DB */
+static gossip_query_index_t *g_gossip_qidx_ptr = NULL; /* built from the gossip log */
+static pthread_mutex_t *g_gossip_ingest_lock_ptr = NULL;
 
 static void *ln_dispatch_thread(void *arg) {
     (void)arg;
@@ -210,25 +241,44 @@ static int lsps0_bolt8_cb(void *userdata, int fd, bolt8_state_t *state,
     return written;
 }
 
-/* Chain monitoring: called by bip158_backend after each new block is processed */
-static void on_block_connected(uint32_t height, void *cb_ctx)
+/* An inbound HTLC came within the expiry delta (reported once per HTLC) */
+static void on_htlc_at_risk(void *ctx, channel_t *ch, const htlc_t *h)
+{
+    uint32_t height = *(const uint32_t *)ctx;
+    /* Channels are watched in manager order, so the index matches */
+    fprintf(stderr, "LSP: block %u: channel %u HTLC %llu expires at %u,"
+            " within expiry delta — consider force-close\n",
+            (unsigned)height, (unsigned)ch->cltv_chan_idx, (unsigned long long)h->id,
+            (unsigned)h->cltv_expiry);
+}
+
+/* Chain monitoring: called for each block the chain event bus connects */
+static void on_block_connected(uint32_t height)
 {
-    (void)cb_ctx;
     g_block_height = height;
-    if (!g_channel_mgr) return;
-
-    for (size_t i = 0; i < g_channel_mgr->n_channels; i++) {
-        channel_t *ch = &g_channel_mgr->entries[i].channel;
-        cltv_watchdog_t wd;
-        cltv_watchdog_init(&wd, ch, 0);          /* 0 = CLTV_EXPIRY_DELTA default */
-        int at_risk = cltv_watchdog_check(&wd, height);
-        if (at_risk > 0)
-            fprintf(stderr, "LSP: block %u: channel %zu has %d HTLC(s)"
-                    " within expiry delta — consider force-close\n",
-                    (unsigned)height, i, at_risk);
-        cltv_watchdog_expire(&wd, height);
+    pthread_mutex_lock(&g_channel_mgr_lock);
+    if (!g_channel_mgr) {
+        pthread_mutex_unlock(&g_channel_mgr_lock);
+        return;
     }
 
+    /* Watch channels as they appear; watching is a no-op once hooked */
+    if (g_cltv_deadlines.expiry_delta == 0)
+        cltv_deadlines_init(&g_cltv_deadlines, 0);  /* 0 = CLTV_EXPIRY_DELTA default */
+    for (size_t i = 0; i < g_channel_mgr->n_channels; i++)
+        if (!cltv_deadlines_watch(&g_cltv_deadlines,
+                                  &g_channel_mgr->entries[i].channel))
+            fprintf(stderr, "LSP: block %u: cannot watch channel %zu"
+                    " HTLC expiries\n", (unsigned)height, i);
+
+    cltv_deadlines_check(&g_cltv_deadlines, height, on_htlc_at_risk, &height);
+    cltv_deadlines_expire(&g_cltv_deadlines, height);
+    pthread_mutex_unlock(&g_channel_mgr_lock);
+
+    /* Onion replay filter: forget windows of expired HTLCs */
+    if (g_onion_proc_ready)
+        onion_proc_set_height(&g_onion_proc, height);
+
     /* Phase J: advance LSPS1 order confirmations */
     lsps1_orders_tick_all(height);
 
@@ -241,6 +291,41 @@ static void on_block_connected(uint32_t height, void *cb_ctx)
     }
 }
 
+/* Chain event bus over chain_be, polled by the daemon loop */
+static chain_events_t g_chain_events;
+
+static void on_chain_event(const chain_event_t *ev, void *ctx)
+{
+    (void)ctx;
+    if (ev->type == CHAIN_EVENT_BLOCK_CONNECTED)
+        on_block_connected((uint32_t)ev->block->height);
+    else if (ev->tip_height >= 0)
+        g_block_height = (uint32_t)ev->tip_height;  /* reorg: tip went back */
+}
+
+/*
+ * Subscribe the per-block consumers to an event bus on chain_be and hand
+ * the bus to the daemon loop.  Call once chain_be is connected (after
+ * attach_light_client in light-client mode).
+ */
+static void attach_chain_events(lsp_channel_mgr_t *mgr, chain_backend_t *chain_be)
+{
+    if (!chain_events_init(&g_chain_events, chain_be, -1) ||
+        !chain_events_subscribe(&g_chain_events,
+                                CHAIN_EVENT_BLOCK_CONNECTED |
+                                CHAIN_EVENT_BLOCK_DISCONNECTED,
+                                0, on_chain_event, NULL)) {
+        fprintf(stderr, "LSP: chain backend cannot feed the event bus;"
+                " per-block checks disabled\n");
+        return;
+    }
+    /* The first poll only records the tip */
+    if (chain_events_poll(&g_chain_events) >= 0 &&
+        chain_events_tip_height(&g_chain_events) > 0)
+        g_block_height = (uint32_t)chain_events_tip_height(&g_chain_events);
+    mgr->chain_events = &g_chain_events;
+}
+
 static void sigint_handler(int sig) {
     (void)sig;
     g_shutdown = 1;
@@ -1364,9 +1449,6 @@ static int attach_light_client(watchtower_t *wt, persist_t *db_ptr,
     if (fee_est)
         bip158_backend_set_fee_estimator(&g_bip158, fee_est);
 
-    /* Wire block_connected callback for chain monitoring (CLTV watchdog) */
-    bip158_backend_set_block_connected_cb(&g_bip158, on_block_connected, NULL);
-
     watchtower_set_chain_backend(wt, &g_bip158.base);
     return 1;
 }
@@ -3155,11 +3237,12 @@ int main(int argc, char *argv[]) {
             /* Initialize channels from DB */
             lsp_channel_mgr_t *mgr = calloc(1, sizeof(lsp_channel_mgr_t));
             if (!mgr) { fprintf(stderr, "LSP: alloc failed\n"); lsp_cleanup(lsp_rp); return 1; }
-            g_channel_mgr = mgr;
+            set_channel_mgr(mgr);
             mgr->fee = fee_est;
             if (!lsp_channels_init_from_db(mgr, ctx, &lsp_rp->factory, lsp_seckey,
                                              rec_n_clients, &db)) {
                 fprintf(stderr, "LSP recovery: channel init from DB failed\n");
+                set_channel_mgr(NULL);
                 free(mgr);
                 lsp_cleanup(lsp_rp);
                 persist_close(&db);
@@ -3175,20 +3258,27 @@ int main(int argc, char *argv[]) {
             mgr->next_request_id = persist_load_counter(&db, "next_request_id", 1);
 
             {
-                unsigned char inv_hashes[MAX_INVOICE_REGISTRY][32];
-                size_t inv_dests[MAX_INVOICE_REGISTRY];
-                uint64_t inv_amounts[MAX_INVOICE_REGISTRY];
-                size_t n_inv = persist_load_invoices(&db,
-                    inv_hashes, inv_dests, inv_amounts, MAX_INVOICE_REGISTRY);
+                size_t max_inv = persist_count_invoices(&db);
+                unsigned char (*inv_hashes)[32] = calloc(max_inv + 1, 32);
+                size_t *inv_dests = calloc(max_inv + 1, sizeof(size_t));
+                uint64_t *inv_amounts = calloc(max_inv + 1, sizeof(uint64_t));
+                size_t n_inv = 0;
+                if (inv_hashes && inv_dests && inv_amounts)
+                    n_inv = persist_load_invoices(&db,
+                        inv_hashes, inv_dests, inv_amounts, max_inv);
                 for (size_t i = 0; i < n_inv; i++) {
-                    if (mgr->n_invoices >= MAX_INVOICE_REGISTRY) break;
-                    invoice_entry_t *inv = &mgr->invoices[mgr->n_invoices++];
+                    invoice_entry_t *inv = lsp_channels_alloc_invoice(mgr);
+                    if (!inv) break;
                     memcpy(inv->payment_hash, inv_hashes[i], 32);
                     inv->dest_client = inv_dests[i];
                     inv->amount_msat = inv_amounts[i];
                     inv->bridge_htlc_id = 0;
                     inv->active = 1;
+                    lsp_channels_index_invoice(mgr, inv);
                 }
+                free(inv_hashes);
+                free(inv_dests);
+                free(inv_amounts);
                 if (n_inv > 0)
                     printf("LSP recovery: loaded %zu invoices from DB\n", n_inv);
             }
@@ -3202,14 +3292,15 @@ int main(int argc, char *argv[]) {
                     orig_hashes, orig_bridge, orig_req, orig_sender, orig_htlc,
                     MAX_HTLC_ORIGINS);
                 for (size_t i = 0; i < n_orig; i++) {
-                    if (mgr->n_htlc_origins >= MAX_HTLC_ORIGINS) break;
-                    htlc_origin_t *o = &mgr->htlc_origins[mgr->n_htlc_origins++];
+                    htlc_origin_t *o = lsp_channels_alloc_bridge_origin(mgr);
+                    if (!o) break;
                     memcpy(o->payment_hash, orig_hashes[i], 32);
                     o->bridge_htlc_id = orig_bridge[i];
                     o->request_id = orig_req[i];
                     o->sender_idx = orig_sender[i];
                     o->sender_htlc_id = orig_htlc[i];
                     o->active = 1;
+                    lsp_channels_index_bridge_origin(mgr, o);
                 }
                 if (n_orig > 0)
                     printf("LSP recovery: loaded %zu HTLC origins from DB\n", n_orig);
@@ -3243,6 +3334,7 @@ int main(int argc, char *argv[]) {
                     attach_hd_wallet(&rec_wt, use_db ? &db : NULL, ctx, network,
                                      hd_mnemonic, hd_passphrase, hd_lookahead);
             }
+            attach_chain_events(mgr, chain_be);
 
             /* Initialize ladder (heap — ladder_t is ~26MB with 8 factories) */
             ladder_t *rec_lad_p = calloc(1, sizeof(ladder_t));
@@ -3484,6 +3576,7 @@ int main(int argc, char *argv[]) {
             }
 
             printf("LSP recovery: daemon shutdown complete\n");
+            set_channel_mgr(NULL);
             jit_channels_cleanup(mgr);
             free(mgr);
             persist_close(&db);
@@ -3585,12 +3678,92 @@ accept_new_factory:
             }
 
             if (s_gossip_store_opened) {
+                /* Every peer thread verifies through one ingest pipeline */
+                static gossip_ingest_t s_gossip_ingest;
+                static pthread_mutex_t s_gossip_ingest_lock = PTHREAD_MUTEX_INITIALIZER;
+                if (!s_gossip_ingest.gs) {
+                    gossip_ingest_init(&s_gossip_ingest, ctx, &s_gossip_store);
+
+                    /* Raw gossip kept mmap()ed beside the DB: graph load,
+                       exportrgs and peer gossip queries read it directly */
+                    static gossip_log_t s_gossip_log;
+                    if (db_path) {
+                        char glog_path[1024];
+                        snprintf(glog_path, sizeof(glog_path), "%s.gossip", db_path);
+                        if (gossip_log_open(&s_gossip_log, glog_path)) {
+                            s_gossip_ingest.log = &s_gossip_log;
+                            g_gossip_log_ptr = &s_gossip_log;
+                            printf("LSP: gossip log %s (%zu channels)\n", glog_path,
+                                   gossip_log_channel_count(&s_gossip_log));
+                        } else
+                            fprintf(stderr, "LSP: warning: cannot open gossip log %s\n",
+                                    glog_path);
+                    }
+
+                    /* query_channel_range answers from an scid index built
+                       from the log and kept current by ingest */
+                    static gossip_query_index_t s_gossip_qidx;
+                    if (g_gossip_log_ptr && gossip_query_index_init(&s_gossip_qidx)) {
+                        if (gossip_query_index_load_log(&s_gossip_qidx, g_gossip_log_ptr) >= 0) {
+                            s_gossip_ingest.qidx = &s_gossip_qidx;
+                            g_gossip_qidx_ptr = &s_gossip_qidx;
+                        } else {
+                            fprintf(stderr, "LSP: warning: gossip query index not built\n");
+                            gossip_query_index_free(&s_gossip_qidx);
+                        }
+                    }
+
+                    /* RGS snapshots for exportrgs: seeded from the log (or
+                       the store), then fed by ingest and sealed by the
+                       daemon tick */
+                    static rgs_server_t s_rgs_server;
+                    unsigned char *seed = (unsigned char *)malloc(RGS_MAX_BLOB_LEN);
+                    if (seed && rgs_server_init(&s_rgs_server, 0)) {
+                        size_t slen = g_gossip_log_ptr
+                            ? gossip_log_export_rgs(g_gossip_log_ptr, seed, RGS_MAX_BLOB_LEN)
+                            : gossip_store_export_rgs(&s_gossip_store, seed, RGS_MAX_BLOB_LEN);
+                        if (slen == 0)
+                            fprintf(stderr, "LSP: RGS server: no snapshot exported, "
+                                    "starting unseeded\n");
+                        else if (rgs_server_seed(&s_rgs_server, seed, slen) < 0)
+                            fprintf(stderr, "LSP: RGS server: store snapshot unreadable\n");
+                        rgs_server_tick(&s_rgs_server, (uint32_t)time(NULL));
+                        s_gossip_ingest.rgs = &s_rgs_server;
+                        g_rgs_server_ptr = &s_rgs_server;
+                    }
+                    free(seed);
+
+                    /* Routes are searched on a graph loaded once -- from the
+                       log once it holds gossip, else from the store (a DB
+                       older than the log) -- and kept current by ingest */
+                    pathfind_graph_t *graph = pathfind_graph_alloc();
+                    int loaded = -1;
+                    if (graph && g_gossip_log_ptr &&
+                        gossip_log_channel_count(g_gossip_log_ptr) > 0)
+                        loaded = pathfind_graph_load_from_log(graph, g_gossip_log_ptr);
+                    else if (graph)
+                        loaded = pathfind_graph_load_from_gossip(graph, &s_gossip_store);
+                    if (loaded >= 0) {
+                        s_gossip_ingest.graph = graph;
+                        /* Landmark bounds for A*, rebuilt in the background
+                           once gossip has made them stale */
+                        if (!pathfind_graph_alt_start(graph, PATHFIND_ALT_LANDMARKS,
+                                                      0, 30000 /* ms */))
+                            fprintf(stderr, "LSP: warning: landmark refresher failed to start\n");
+                    } else
+                        pathfind_graph_free(graph);
+                    g_gossip_ingest_ptr = &s_gossip_ingest;
+                    g_gossip_ingest_lock_ptr = &s_gossip_ingest_lock;
+                }
+
                 static gossip_peer_mgr_cfg_t s_gp_cfg;
                 memset(&s_gp_cfg, 0, sizeof(s_gp_cfg));
                 s_gp_cfg.n_peers = gossip_peer_parse_list(gossip_peers,
                     s_gp_cfg.peers, GOSSIP_PEER_MAX);
                 s_gp_cfg.ctx = ctx;
                 s_gp_cfg.store = &s_gossip_store;
+                s_gp_cfg.gi = &s_gossip_ingest;
+                s_gp_cfg.gi_lock = &s_gossip_ingest_lock;
                 memcpy(s_gp_cfg.our_priv32, lsp_p->nk_seckey, 32);
                 s_gp_cfg.network = network;
                 s_gp_cfg.shutdown_flag = (volatile int *)&g_shutdown;
@@ -3615,6 +3788,8 @@ accept_new_factory:
             htlc_forward_init(&g_fwd);
             mpp_init(&g_mpp);
             payment_init(&g_payments);
+            g_payments.gi      = g_gossip_ingest_ptr;
+            g_payments.gi_lock = g_gossip_ingest_lock_ptr;
             invoice_init(&g_invoice_tbl);
 
             memset(&g_bolt8_cfg, 0, sizeof(g_bolt8_cfg));
@@ -3644,6 +3819,48 @@ accept_new_factory:
             g_ln_dispatch.shutdown_flag = (volatile int *)&g_shutdown;
             memcpy(g_ln_dispatch.our_privkey, lsp_p->nk_seckey, 32);
             g_ln_dispatch.invoices = &g_invoice_tbl;
+            g_ln_dispatch.glog     = g_gossip_log_ptr;
+            g_ln_dispatch.gqi      = g_gossip_qidx_ptr;
+            g_ln_dispatch.block_height = &g_block_height;
+
+            /* Peel incoming onions in batches, rejecting replays.  Set up
+               once: the workers and the replay filter outlive factory
+               rotations. */
+            if (!g_onion_proc_ready) {
+                if (onion_proc_init(&g_onion_proc, ctx, lsp_p->nk_seckey,
+                                    ONION_PROC_WORKERS)) {
+                    if (g_block_height)
+                        onion_proc_set_height(&g_onion_proc, g_block_height);
+                    g_onion_proc_ready = 1;
+                } else {
+                    fprintf(stderr, "LSP: warning: onion processor init failed,"
+                            " peeling inline\n");
+                }
+            }
+            if (g_onion_proc_ready)
+                g_ln_dispatch.onion_proc = &g_onion_proc;
+
+            /* Outbound payments: routed on worker threads over the live
+               graph, sent and resolved by the dispatch loop.  Set up once,
+               like the onion processor. */
+            if (!g_pay_engine_ready && g_gossip_ingest_ptr &&
+                g_gossip_ingest_ptr->graph) {
+                mc_init(&g_pay_mc);
+                if (payment_engine_init(&g_pay_engine, g_gossip_ingest_ptr->graph,
+                                        &g_pay_mc, g_peer_mgr.our_pubkey,
+                                        PAYMENT_ENGINE_WORKERS)) {
+                    g_pay_engine.pmgr    = &g_peer_mgr;
+                    g_pay_engine.ctx     = ctx;
+                    g_pay_engine.gi      = g_gossip_ingest_ptr;
+                    g_pay_engine.gi_lock = g_gossip_ingest_lock_ptr;
+                    g_pay_engine_ready = 1;
+                } else {
+                    mc_free(&g_pay_mc);
+                    fprintf(stderr, "LSP: warning: payment engine init failed\n");
+                }
+            }
+            if (g_pay_engine_ready)
+                g_ln_dispatch.pay_engine = &g_pay_engine;
 
             /* Wire LSPS0 callback */
             memset(&g_lsps_ctx, 0, sizeof(g_lsps_ctx));
@@ -3705,6 +3922,8 @@ accept_new_factory:
             g_admin_rpc.payments     = &g_payments;
             g_admin_rpc.invoices     = &g_invoice_tbl;
             g_admin_rpc.gossip       = g_gossip_store_ptr;
+            g_admin_rpc.rgs_server   = g_rgs_server_ptr;
+            g_admin_rpc.gossip_log   = g_gossip_log_ptr;
             g_admin_rpc.fwd          = &g_fwd;
             g_admin_rpc.mpp          = &g_mpp;
             g_admin_rpc.shutdown_flag = (volatile int *)&g_shutdown;
@@ -4357,7 +4576,7 @@ accept_new_factory:
     /* === Phase 4b: Channel Operations === */
     lsp_channel_mgr_t *mgr = calloc(1, sizeof(lsp_channel_mgr_t));
     if (!mgr) { fprintf(stderr, "LSP: alloc failed\n"); lsp_cleanup(lsp_p); return 1; }
-    g_channel_mgr = mgr;
+    set_channel_mgr(mgr);
     /* Update admin RPC channel_mgr (was NULL when RPC was initialized earlier) */
     if (g_admin_rpc.ctx) {
         g_admin_rpc.channel_mgr = mgr;
@@ -4440,20 +4659,27 @@ accept_new_factory:
             mgr->next_request_id = persist_load_counter(&db, "next_request_id", 1);
 
             /* Load invoices */
-            unsigned char inv_hashes[MAX_INVOICE_REGISTRY][32];
-            size_t inv_dests[MAX_INVOICE_REGISTRY];
-            uint64_t inv_amounts[MAX_INVOICE_REGISTRY];
-            size_t n_inv = persist_load_invoices(&db,
-                inv_hashes, inv_dests, inv_amounts, MAX_INVOICE_REGISTRY);
+            size_t max_inv = persist_count_invoices(&db);
+            unsigned char (*inv_hashes)[32] = calloc(max_inv + 1, 32);
+            size_t *inv_dests = calloc(max_inv + 1, sizeof(size_t));
+            uint64_t *inv_amounts = calloc(max_inv + 1, sizeof(uint64_t));
+            size_t n_inv = 0;
+            if (inv_hashes && inv_dests && inv_amounts)
+                n_inv = persist_load_invoices(&db,
+                    inv_hashes, inv_dests, inv_amounts, max_inv);
             for (size_t i = 0; i < n_inv; i++) {
-                if (mgr->n_invoices >= MAX_INVOICE_REGISTRY) break;
-                invoice_entry_t *inv = &mgr->invoices[mgr->n_invoices++];
+                invoice_entry_t *inv = lsp_channels_alloc_invoice(mgr);
+                if (!inv) break;
                 memcpy(inv->payment_hash, inv_hashes[i], 32);
                 inv->dest_client = inv_dests[i];
                 inv->amount_msat = inv_amounts[i];
                 inv->bridge_htlc_id = 0;
                 inv->active = 1;
+                lsp_channels_index_invoice(mgr, inv);
             }
+            free(inv_hashes);
+            free(inv_dests);
+            free(inv_amounts);
             if (n_inv > 0)
                 printf("LSP: loaded %zu invoices from DB\n", n_inv);
 
@@ -4466,14 +4692,15 @@ accept_new_factory:
                 orig_hashes, orig_bridge, orig_req, orig_sender, orig_htlc,
                 MAX_HTLC_ORIGINS);
             for (size_t i = 0; i < n_orig; i++) {
-                if (mgr->n_htlc_origins >= MAX_HTLC_ORIGINS) break;
-                htlc_origin_t *origin = &mgr->htlc_origins[mgr->n_htlc_origins++];
+                htlc_origin_t *origin = lsp_channels_alloc_bridge_origin(mgr);
+                if (!origin) break;
                 memcpy(origin->payment_hash, orig_hashes[i], 32);
                 origin->bridge_htlc_id = orig_bridge[i];
                 origin->request_id = orig_req[i];
                 origin->sender_idx = orig_sender[i];
                 origin->sender_htlc_id = orig_htlc[i];
                 origin->active = 1;
+                lsp_channels_index_bridge_origin(mgr, origin);
             }
             if (n_orig > 0)
                 printf("LSP: loaded %zu HTLC origins from DB\n", n_orig);
@@ -4556,6 +4783,7 @@ accept_new_factory:
                 attach_hd_wallet(&wt, use_db ? &db : NULL, ctx, network,
                                  hd_mnemonic, hd_passphrase, hd_lookahead);
         }
+        attach_chain_events(mgr, chain_be);
 
         /* Wire ladder into channel manager (Tier 2) */
         mgr->ladder = lad;
@@ -4972,6 +5200,7 @@ accept_new_factory:
        LADDER_MAX_FACTORIES=8 since each ladder_factory_t embeds a full
        factory_t).  Both were previously leaked on the LSP success exit
        path — ASan flagged this in the testnet4 campaign 2026-05-14. */
+    set_channel_mgr(NULL);
     jit_channels_cleanup(mgr);
     lsp_channels_cleanup(mgr);
     free(mgr);
@@ -5009,6 +5238,19 @@ accept_new_factory:
         persist_close(&db);
     if (tor_control_fd >= 0)
         close(tor_control_fd);
+    if (g_gossip_ingest_ptr && g_gossip_ingest_ptr->graph)
+        pathfind_graph_alt_stop(g_gossip_ingest_ptr->graph);
+    if (g_onion_proc_ready) {
+        g_ln_dispatch.onion_proc = NULL;
+        g_onion_proc_ready = 0;
+        onion_proc_free(&g_onion_proc);
+    }
+    if (g_pay_engine_ready) {
+        g_ln_dispatch.pay_engine = NULL;
+        g_pay_engine_ready = 0;
+        payment_engine_free(&g_pay_engine);
+        mc_free(&g_pay_mc);
+    }
     memset(lsp_seckey, 0, 32);
     secp256k1_context_destroy(ctx);
     return 0;
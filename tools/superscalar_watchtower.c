@@ -1,5 +1,6 @@
 #include "superscalar/version.h"
 #include "superscalar/watchtower.h"
+#include "superscalar/chain_events.h"
 #include "superscalar/persist_wt.h"
 #include "superscalar/regtest.h"
 #include "superscalar/fee.h"
@@ -19,6 +20,25 @@ static void sigint_handler(int sig) {
     g_shutdown = 1;
 }
 
+/* Per-poll summary of chain events, filled by wt_on_chain_event. */
+typedef struct {
+    int  n_connected;
+    int  n_disconnected;
+    char old_tip_hash[65];  /* first disconnected block (the old tip) */
+    char new_tip_hash[65];  /* last connected block */
+} wt_chain_poll_t;
+
+static void wt_on_chain_event(const chain_event_t *ev, void *ctx) {
+    wt_chain_poll_t *cp = (wt_chain_poll_t *)ctx;
+    if (ev->type == CHAIN_EVENT_BLOCK_DISCONNECTED) {
+        if (cp->n_disconnected++ == 0)
+            memcpy(cp->old_tip_hash, ev->block->hash_hex, 65);
+    } else if (ev->type == CHAIN_EVENT_BLOCK_CONNECTED) {
+        cp->n_connected++;
+        memcpy(cp->new_tip_hash, ev->block->hash_hex, 65);
+    }
+}
+
 static void usage(const char *prog) {
     fprintf(stderr,
         "Usage: %s --wt-db PATH [OPTIONS]\n"
@@ -204,61 +224,51 @@ int main(int argc, char *argv[]) {
     printf("  Watching for breaches...\n");
     fflush(stdout);
 
-    int last_height = -1;
-    char last_hash[65] = {0};  /* Issue #2: same-height reorg detection */
+    /* Chain event bus: one tip query + one hash check per idle poll.
+       Height-regression, same-height and forward reorgs (R6, PR #201) all
+       surface as BLOCK_DISCONNECTED events before the replacement blocks
+       connect, so no per-kind detection is needed here. */
+    chain_events_t bus;
+    wt_chain_poll_t cp;
+    if (!chain_events_init(&bus, wt.chain, -1) ||
+        !chain_events_subscribe(&bus, CHAIN_EVENT_BLOCK_CONNECTED |
+                                      CHAIN_EVENT_BLOCK_DISCONNECTED,
+                                0, wt_on_chain_event, &cp)) {
+        fprintf(stderr, "Error: chain event bus init failed\n");
+        persist_wt_close(&wt_pdb);
+        return 1;
+    }
 
     while (!g_shutdown) {
-        int height = regtest_get_block_height(&rt);
-        char cur_hash[65] = {0};
-        regtest_get_best_block_hash(&rt, cur_hash);
-
-        /* R6 (mainnet pre-flight): mirror the LSP daemon-loop detection
-           (PR #201).  Standalone WT had SAME_HEIGHT + HEIGHT_REGRESSION but
-           missed FORWARD_REORG (competing longer chain wins; tip advances
-           but block at last_height is no longer canonical).  Detect by
-           re-querying the block hash at last_height. */
-        int reorg_kind = 0;  /* 0=none, 1=height-decrease, 2=same-height, 3=forward */
-        if (last_height > 0 && height < last_height) {
-            reorg_kind = 1;
-        } else if (last_height > 0 && height == last_height &&
-                   last_hash[0] != 0 && cur_hash[0] != 0 &&
-                   strcmp(cur_hash, last_hash) != 0) {
-            reorg_kind = 2;
-        } else if (last_height > 0 && height > last_height && last_hash[0]) {
-            char prev_hash_now[65] = {0};
-            if (regtest_get_block_hash(&rt, last_height,
-                                        prev_hash_now, sizeof(prev_hash_now)) &&
-                prev_hash_now[0] &&
-                strcmp(prev_hash_now, last_hash) != 0) {
-                reorg_kind = 3;
-            }
-        }
+        memset(&cp, 0, sizeof(cp));
+        int last_height = chain_events_tip_height(&bus);
+        chain_events_poll(&bus);
+        int height = chain_events_tip_height(&bus);
 
-        if (reorg_kind > 0) {
-            /* Reorg detected — re-validate all watchtower entries. */
+        if (cp.n_disconnected > 0) {
+            /* Reorg detected — re-validate all watchtower entries.
+               The kind string is kept for the regtest reorg scripts. */
             const char *kind_str =
-                (reorg_kind == 3) ? "FORWARD_REORG" :
-                (reorg_kind == 2) ? "SAME_HEIGHT"   :
-                                     "HEIGHT_REGRESSION";
-            fprintf(stderr, "[%ld] REORG (%s): height %d -> %d hash %.16s -> %.16s\n",
+                (height > last_height)  ? "FORWARD_REORG" :
+                (height == last_height) ? "SAME_HEIGHT"   :
+                                          "HEIGHT_REGRESSION";
+            fprintf(stderr, "[%ld] REORG (%s): height %d -> %d hash %.16s -> %.16s "
+                    "(%d block(s) disconnected)\n",
                     (long)time(NULL), kind_str, last_height, height,
-                    last_hash, cur_hash);
+                    cp.old_tip_hash, cp.new_tip_hash[0] ? cp.new_tip_hash : "?",
+                    cp.n_disconnected);
             /* Phase 2c PR-E: legacy persist_log_broadcast call removed.
                wt_db has no broadcast_log table; reorg observability lives
                in dashboard / external metrics. */
             watchtower_on_reorg(&wt, height, last_height);
-            last_height = height;
-            if (cur_hash[0]) { memcpy(last_hash, cur_hash, 65); }
             /* Run a watchtower check immediately after reorg */
             watchtower_check(&wt);
-        } else if (height > last_height) {
+        } else if (cp.n_connected > 0 || (last_height < 0 && height >= 0)) {
             int penalties = watchtower_check(&wt);
             if (penalties > 0) {
                 printf("[%ld] Block %d: %d penalty tx(s) broadcast!\n",
                        (long)time(NULL), height, penalties);
             }
-            last_height = height;
-            if (cur_hash[0]) { memcpy(last_hash, cur_hash, 65); }
         }
 
         /* Heartbeat */